@@ -0,0 +1,29 @@
+#include "ApiTrace.h"
+#include <stdio.h>
+
+// -analyzetrace away from Windows: a trace written by -capture is copied off the machine
+// that recorded it and analysed here. the report goes to stdout, the exit code is the app's
+//
+//   AnalyseTrace trace.aptr
+
+int main(int argc, char** argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: AnalyseTrace trace.aptr\n");
+        return 2;
+    }
+
+    string narrow = argv[1];
+    wstring fileName(narrow.begin(), narrow.end());
+
+    ApiTraceStats stats;
+    if (!AnalyseApiTrace(fileName.c_str(), stats))
+    {
+        fprintf(stderr, "AnalyseTrace: %s isn't an API trace this version reads\n", argv[1]);
+        return -1;
+    }
+
+    fputs(FormatApiTraceReport(stats).c_str(), stdout);
+    return stats.BadRecords ? -1 : 0;
+}
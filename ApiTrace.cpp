@@ -0,0 +1,823 @@
+#include "ApiTrace.h"
+#include <memory>
+#include <unordered_map>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+// file layout, little endian: "APTR", uint32 version, then records to the end of the file.
+// a record is a byte with the ApiCall, a varint with the size of the rest and its fields.
+// u is a varint, i a zigzag varint, f a 32 bit float and b a varint length and the bytes.
+// ids are 0 for null and otherwise numbered from 1 in the order objects were first used
+//
+//   OBJECT                   u id, u kind, u bytes, u width, u height, u format, u resource id
+//                            (bytes: whole resource, for views the viewed mip 0 of every slice)
+//   FRAME                    u frame
+//   SET_SHADER               u stage, u shader, u class instance count
+//   SET_CONSTANT_BUFFERS,
+//   SET_SHADER_RESOURCES,
+//   SET_SAMPLERS,
+//   SET_UNORDERED_ACCESS_VIEWS
+//                            u stage, u start slot, u count, u id per slot
+//   SET_INPUT_LAYOUT         u id
+//   SET_VERTEX_BUFFERS       u start slot, u count, u id, u stride, u offset per slot
+//   SET_INDEX_BUFFER         u id, u format, u offset
+//   SET_PRIMITIVE_TOPOLOGY   u topology
+//   SET_RENDER_TARGETS       u count, u id per view, u depth stencil view
+//   SET_BLEND_STATE          u id, 4 f blend factor, u sample mask
+//   SET_DEPTH_STENCIL_STATE  u id, u stencil ref
+//   SET_STREAM_OUTPUT_TARGETS u count, u id, u offset per target
+//   SET_RASTERIZER_STATE     u id
+//   SET_VIEWPORTS            u count, 6 f per viewport
+//   SET_SCISSOR_RECTS        u count, 4 i per rectangle
+//   SET_PREDICATION          u id, u value
+//   DRAW                     u vertex count, u start vertex
+//   DRAW_INDEXED             u index count, u start index, i base vertex
+//   DRAW_INSTANCED           u vertex count, u instance count, u start vertex, u start instance
+//   DRAW_INDEXED_INSTANCED   u index count, u instance count, u start index, i base vertex, u start instance
+//   DRAW_INDIRECT            u indexed, u buffer, u offset
+//   DISPATCH                 u x, u y, u z
+//   DISPATCH_INDIRECT        u buffer, u offset
+//   BEGIN_QUERY, END_QUERY   u id
+//   GET_DATA                 u id, u flags, i result
+//   MAP                      u resource, u subresource, u map type, u flags, i result, u bytes read
+//   UNMAP                    u resource, u subresource, b what was written (write maps of buffers)
+//   UPDATE_SUBRESOURCE       u resource, u subresource, u has box, [6 u box], u row pitch,
+//                            u depth pitch, b source data
+//   COPY_RESOURCE            u dest, u source, u bytes
+//   COPY_SUBRESOURCE_REGION  u dest, u dest subresource, u x, u y, u z, u source, u source subresource, u bytes
+//   COPY_STRUCTURE_COUNT     u buffer, u offset, u view
+//   CLEAR_RENDER_TARGET      u view, 4 f
+//   CLEAR_DEPTH_STENCIL      u view, u flags, f depth, u stencil
+//   CLEAR_UNORDERED_ACCESS_VIEW u view, u float, 4 u (the bits of floats)
+//   GENERATE_MIPS            u view
+//   SET_MIN_LOD              u resource, f lod
+//   RESOLVE_SUBRESOURCE      u dest, u dest subresource, u source, u source subresource, u format, u bytes
+//   EXECUTE_COMMAND_LIST     u id, u restore state
+//   FINISH_COMMAND_LIST      u restore state, i result
+//   DRAW_AUTO, CLEAR_STATE, FLUSH nothing
+static const uint32_t TRACE_VERSION = 1;
+static const char TRACE_MAGIC[4] = { 'A', 'P', 'T', 'R' };
+
+// Writes are batched up to this before going to the file
+static const size_t FLUSH_BYTES = 1 << 20;
+
+// D3D11 limits and values the analysis needs, the model doesn't include any D3D headers
+static const uint32_t MAX_CONSTANT_BUFFERS = 14;
+static const uint32_t MAX_SHADER_RESOURCES = 128;
+static const uint32_t MAX_SAMPLERS = 16;
+static const uint32_t MAX_UNORDERED_ACCESS_VIEWS = 64;
+static const uint32_t MAX_VERTEX_BUFFERS = 32;
+static const uint32_t MAX_RENDER_TARGETS = 8;
+static const uint32_t MAX_VIEWPORTS = 16;
+static const uint32_t MAX_STREAM_OUTPUT_TARGETS = 4;
+static const uint64_t FORMAT_R16_UINT = 57;
+
+static const char* CALL_NAMES[API_CALL_COUNT] =
+{
+    "object", "frame", "set_shader", "set_constant_buffers", "set_shader_resources", "set_samplers",
+    "set_unordered_access_views", "set_input_layout", "set_vertex_buffers", "set_index_buffer",
+    "set_primitive_topology", "set_render_targets", "set_blend_state", "set_depth_stencil_state",
+    "set_stream_output_targets", "set_rasterizer_state", "set_viewports", "set_scissor_rects",
+    "set_predication", "draw", "draw_indexed", "draw_instanced", "draw_indexed_instanced", "draw_auto",
+    "draw_indirect", "dispatch", "dispatch_indirect", "begin_query", "end_query", "get_data", "map", "unmap",
+    "update_subresource", "copy_resource", "copy_subresource_region", "copy_structure_count",
+    "clear_render_target", "clear_depth_stencil", "clear_unordered_access_view", "generate_mips",
+    "set_min_lod", "resolve_subresource", "execute_command_list", "finish_command_list", "clear_state", "flush",
+};
+
+static FILE* OpenFile(const wchar_t* fileName, const char* mode)
+{
+#ifdef _WIN32
+    FILE* file = nullptr;
+    return _wfopen_s(&file, fileName, mode[0] == 'w' ? L"wb" : L"rb") == 0 ? file : nullptr;
+#else
+    char path[1024];
+    if (wcstombs(path, fileName, sizeof(path)) == (size_t)-1)
+        return nullptr;
+
+    return fopen(path, mode);
+#endif
+}
+
+static void PutVarint(vector<uint8_t>& out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+// the header and floats are fixed size, little endian whatever the host is
+static void PutLittleEndian32(vector<uint8_t>& out, uint32_t value)
+{
+    uint8_t bytes[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+    out.insert(out.end(), bytes, bytes + 4);
+}
+
+static uint32_t GetLittleEndian32(const uint8_t* data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+// false when the varint runs past end
+static bool GetVarint(const uint8_t* data, size_t size, size_t* offset, uint64_t* value)
+{
+    *value = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7)
+    {
+        if (*offset >= size)
+            return false;
+
+        uint8_t byte = data[(*offset)++];
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+
+    return false;
+}
+
+//--------------------------------------------------------------------------------------
+// ApiTraceWriter
+//--------------------------------------------------------------------------------------
+ApiTraceWriter::ApiTraceWriter()
+{
+    _file = nullptr;
+    _call = API_CALL_OBJECT;
+    _written = 0;
+}
+
+ApiTraceWriter::~ApiTraceWriter()
+{
+    Close();
+}
+
+bool ApiTraceWriter::Open(const wchar_t* fileName)
+{
+    Close();
+
+    _file = OpenFile(fileName, "wb");
+    if (!_file)
+        return false;
+
+    _buffer.assign(TRACE_MAGIC, TRACE_MAGIC + sizeof(TRACE_MAGIC));
+    PutLittleEndian32(_buffer, TRACE_VERSION);
+    _written = 0;
+    return true;
+}
+
+void ApiTraceWriter::Close()
+{
+    if (!_file)
+        return;
+
+    Flush();
+    fclose(_file);
+    _file = nullptr;
+}
+
+void ApiTraceWriter::Begin(ApiCall call)
+{
+    _call = call;
+    _record.clear();
+}
+
+void ApiTraceWriter::PutUInt(uint64_t value)
+{
+    PutVarint(_record, value);
+}
+
+void ApiTraceWriter::PutInt(int64_t value)
+{
+    PutVarint(_record, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+void ApiTraceWriter::PutFloat(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    PutLittleEndian32(_record, bits);
+}
+
+void ApiTraceWriter::PutBytes(const void* data, size_t bytes)
+{
+    PutVarint(_record, bytes);
+    if (bytes)
+        _record.insert(_record.end(), (const uint8_t*)data, (const uint8_t*)data + bytes);
+}
+
+void ApiTraceWriter::End()
+{
+    _buffer.push_back((uint8_t)_call);
+    PutVarint(_buffer, _record.size());
+    _buffer.insert(_buffer.end(), _record.begin(), _record.end());
+
+    if (_buffer.size() >= FLUSH_BYTES)
+        Flush();
+}
+
+bool ApiTraceWriter::Flush()
+{
+    if (!_file)
+        return false;
+
+    bool ok = fwrite(_buffer.data(), 1, _buffer.size(), _file) == _buffer.size();
+    _written += _buffer.size();
+    _buffer.clear();
+    return ok;
+}
+
+//--------------------------------------------------------------------------------------
+// ApiTraceReader
+//--------------------------------------------------------------------------------------
+uint64_t ApiTraceRecord::GetUInt()
+{
+    uint64_t value;
+    if (!GetVarint(Data, Size, &Offset, &value))
+    {
+        Offset = Size + 1;
+        return 0;
+    }
+
+    return value;
+}
+
+int64_t ApiTraceRecord::GetInt()
+{
+    uint64_t value = GetUInt();
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+float ApiTraceRecord::GetFloat()
+{
+    float value = 0.0f;
+    if (Offset + sizeof(float) > Size)
+    {
+        Offset = Size + 1;
+        return value;
+    }
+
+    uint32_t bits = GetLittleEndian32(Data + Offset);
+    memcpy(&value, &bits, sizeof(value));
+    Offset += sizeof(float);
+    return value;
+}
+
+const uint8_t* ApiTraceRecord::GetBytes(size_t* bytes)
+{
+    uint64_t length = GetUInt();
+    if (Overrun() || length > Size - Offset)
+    {
+        Offset = Size + 1;
+        *bytes = 0;
+        return nullptr;
+    }
+
+    const uint8_t* data = Data + Offset;
+    Offset += (size_t)length;
+    *bytes = (size_t)length;
+    return data;
+}
+
+ApiTraceReader::ApiTraceReader()
+{
+    _offset = 0;
+    _truncated = false;
+}
+
+bool ApiTraceReader::Open(const wchar_t* fileName)
+{
+    _data.clear();
+    _offset = 0;
+    _truncated = false;
+
+    FILE* file = OpenFile(fileName, "rb");
+    if (!file)
+        return false;
+
+    uint8_t chunk[64 * 1024];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        _data.insert(_data.end(), chunk, chunk + read);
+    fclose(file);
+
+    if (_data.size() < 8 || memcmp(_data.data(), TRACE_MAGIC, 4) != 0)
+        return false;
+
+    if (GetLittleEndian32(_data.data() + 4) != TRACE_VERSION)
+        return false;
+
+    _offset = 8;
+    return true;
+}
+
+bool ApiTraceReader::Next(ApiTraceRecord& record)
+{
+    if (_offset >= _data.size())
+        return false;
+
+    size_t offset = _offset + 1;
+    uint64_t size;
+    if (!GetVarint(_data.data(), _data.size(), &offset, &size) || size > _data.size() - offset)
+    {
+        // a capture that was cut off, everything before it still counts
+        _truncated = true;
+        return false;
+    }
+
+    record.Call = (ApiCall)_data[_offset];
+    record.Data = _data.data() + offset;
+    record.Size = (size_t)size;
+    record.Offset = 0;
+
+    _offset = offset + (size_t)size;
+    return true;
+}
+
+//--------------------------------------------------------------------------------------
+// Analysis
+//--------------------------------------------------------------------------------------
+// what the trace has set on the pipeline so far, zero is unbound
+struct PipelineModel
+{
+    uint64_t shaders[API_SHADER_STAGES];
+    uint64_t constantBuffers[API_SHADER_STAGES][MAX_CONSTANT_BUFFERS];
+    uint64_t shaderResources[API_SHADER_STAGES][MAX_SHADER_RESOURCES];
+    uint64_t samplers[API_SHADER_STAGES][MAX_SAMPLERS];
+    uint64_t unorderedAccessViews[API_SHADER_STAGES][MAX_UNORDERED_ACCESS_VIEWS];
+    uint64_t inputLayout;
+    // id, stride and offset per slot
+    uint64_t vertexBuffers[MAX_VERTEX_BUFFERS][3];
+    uint64_t indexBuffer[3];
+    uint64_t topology;
+    uint64_t renderTargetCount;
+    uint64_t renderTargets[MAX_RENDER_TARGETS];
+    uint64_t depthStencilView;
+    uint64_t blendState;
+    float blendFactor[4];
+    uint64_t sampleMask;
+    uint64_t depthStencilState[2];
+    uint64_t streamOutputTargets[MAX_STREAM_OUTPUT_TARGETS][2];
+    uint64_t rasterizerState;
+    uint64_t viewportCount;
+    float viewports[MAX_VIEWPORTS][6];
+    uint64_t scissorCount;
+    int64_t scissorRects[MAX_VIEWPORTS][4];
+    uint64_t predication[2];
+};
+
+uint64_t GetApiPrimitiveCount(uint64_t topology, uint64_t count)
+{
+    // D3D11_PRIMITIVE_TOPOLOGY point, line and triangle lists and strips
+    switch (topology)
+    {
+    case 1: return count;
+    case 2: return count / 2;
+    case 3: return count > 1 ? count - 1 : 0;
+    case 4: return count / 3;
+    case 5: return count > 2 ? count - 2 : 0;
+    default: return 0;
+    }
+}
+
+class ApiTraceAnalyser
+{
+public:
+    ApiTraceAnalyser(ApiTraceStats& stats) : _stats(stats), _model(new PipelineModel()), _vertexStride(0) { }
+
+    void Replay(ApiTraceRecord& record);
+
+private:
+    uint64_t GetId(ApiTraceRecord& record);
+    uint64_t ObjectBytes(uint64_t id) const;
+    // reads count ids into slots from start, true when any slot changed
+    bool SetSlots(ApiTraceRecord& record, uint64_t* slots, uint32_t slotCount, uint64_t start, uint64_t count);
+    bool SetValue(uint64_t* value, uint64_t newValue);
+    void CountDraw(uint64_t count, uint64_t instances, bool indexed);
+    void UpdateVertexStride();
+
+    struct ObjectInfo
+    {
+        uint64_t kind;
+        uint64_t bytes;
+    };
+
+    ApiTraceStats& _stats;
+    unique_ptr<PipelineModel> _model;
+    unordered_map<uint64_t, ObjectInfo> _objects;
+    uint64_t _vertexStride;
+};
+
+uint64_t ApiTraceAnalyser::GetId(ApiTraceRecord& record)
+{
+    uint64_t id = record.GetUInt();
+    if (id && _objects.find(id) == _objects.end())
+        _stats.UnknownObjects++;
+
+    return id;
+}
+
+uint64_t ApiTraceAnalyser::ObjectBytes(uint64_t id) const
+{
+    auto found = _objects.find(id);
+    return found != _objects.end() ? found->second.bytes : 0;
+}
+
+bool ApiTraceAnalyser::SetValue(uint64_t* value, uint64_t newValue)
+{
+    bool changed = *value != newValue;
+    *value = newValue;
+    return changed;
+}
+
+bool ApiTraceAnalyser::SetSlots(ApiTraceRecord& record, uint64_t* slots, uint32_t slotCount, uint64_t start, uint64_t count)
+{
+    bool changed = false;
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        uint64_t id = GetId(record);
+        if (start + i < slotCount)
+            changed |= SetValue(&slots[start + i], id);
+    }
+
+    return changed;
+}
+
+void ApiTraceAnalyser::UpdateVertexStride()
+{
+    _vertexStride = 0;
+    for (uint32_t slot = 0; slot < MAX_VERTEX_BUFFERS; ++slot)
+    {
+        if (_model->vertexBuffers[slot][0])
+            _vertexStride += _model->vertexBuffers[slot][1];
+    }
+}
+
+void ApiTraceAnalyser::CountDraw(uint64_t count, uint64_t instances, bool indexed)
+{
+    _stats.Draws++;
+    _stats.Primitives += GetApiPrimitiveCount(_model->topology, count) * instances;
+    _stats.VertexBytes += count * instances * _vertexStride;
+
+    if (indexed)
+        _stats.IndexBytes += count * instances * (_model->indexBuffer[1] == FORMAT_R16_UINT ? 2 : 4);
+}
+
+void ApiTraceAnalyser::Replay(ApiTraceRecord& record)
+{
+    if (record.Call >= API_CALL_COUNT)
+    {
+        _stats.BadRecords++;
+        return;
+    }
+
+    _stats.Calls[record.Call]++;
+    PipelineModel& model = *_model;
+    bool changed = true;
+
+    switch (record.Call)
+    {
+    case API_CALL_OBJECT:
+    {
+        uint64_t id = record.GetUInt();
+        ObjectInfo info;
+        info.kind = record.GetUInt();
+        info.bytes = record.GetUInt();
+        _objects[id] = info;
+        _stats.Objects++;
+        break;
+    }
+    case API_CALL_FRAME:
+        _stats.Frames++;
+        break;
+    case API_CALL_SET_SHADER:
+    {
+        uint64_t stage = record.GetUInt();
+        uint64_t id = GetId(record);
+        if (stage < API_SHADER_STAGES)
+            changed = SetValue(&model.shaders[stage], id);
+        break;
+    }
+    case API_CALL_SET_CONSTANT_BUFFERS:
+    case API_CALL_SET_SHADER_RESOURCES:
+    case API_CALL_SET_SAMPLERS:
+    case API_CALL_SET_UNORDERED_ACCESS_VIEWS:
+    {
+        uint64_t stage = min(record.GetUInt(), (uint64_t)API_SHADER_STAGES - 1);
+        uint64_t start = record.GetUInt();
+        uint64_t count = record.GetUInt();
+
+        if (record.Call == API_CALL_SET_CONSTANT_BUFFERS)
+            changed = SetSlots(record, model.constantBuffers[stage], MAX_CONSTANT_BUFFERS, start, count);
+        else if (record.Call == API_CALL_SET_SHADER_RESOURCES)
+            changed = SetSlots(record, model.shaderResources[stage], MAX_SHADER_RESOURCES, start, count);
+        else if (record.Call == API_CALL_SET_SAMPLERS)
+            changed = SetSlots(record, model.samplers[stage], MAX_SAMPLERS, start, count);
+        else
+            changed = SetSlots(record, model.unorderedAccessViews[stage], MAX_UNORDERED_ACCESS_VIEWS, start, count);
+        break;
+    }
+    case API_CALL_SET_INPUT_LAYOUT:
+        changed = SetValue(&model.inputLayout, GetId(record));
+        break;
+    case API_CALL_SET_VERTEX_BUFFERS:
+    {
+        uint64_t start = record.GetUInt();
+        uint64_t count = record.GetUInt();
+        changed = false;
+
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            uint64_t binding[3] = { GetId(record), record.GetUInt(), record.GetUInt() };
+            if (start + i < MAX_VERTEX_BUFFERS)
+            {
+                for (int field = 0; field < 3; ++field)
+                    changed |= SetValue(&model.vertexBuffers[start + i][field], binding[field]);
+            }
+        }
+
+        UpdateVertexStride();
+        break;
+    }
+    case API_CALL_SET_INDEX_BUFFER:
+    {
+        uint64_t binding[3] = { GetId(record), record.GetUInt(), record.GetUInt() };
+        changed = false;
+        for (int field = 0; field < 3; ++field)
+            changed |= SetValue(&model.indexBuffer[field], binding[field]);
+        break;
+    }
+    case API_CALL_SET_PRIMITIVE_TOPOLOGY:
+        changed = SetValue(&model.topology, record.GetUInt());
+        break;
+    case API_CALL_SET_RENDER_TARGETS:
+    {
+        uint64_t count = record.GetUInt();
+        changed = SetValue(&model.renderTargetCount, count);
+        changed |= SetSlots(record, model.renderTargets, MAX_RENDER_TARGETS, 0, count);
+        changed |= SetValue(&model.depthStencilView, GetId(record));
+        break;
+    }
+    case API_CALL_SET_BLEND_STATE:
+    {
+        changed = SetValue(&model.blendState, GetId(record));
+        for (int i = 0; i < 4; ++i)
+        {
+            float factor = record.GetFloat();
+            changed |= factor != model.blendFactor[i];
+            model.blendFactor[i] = factor;
+        }
+        changed |= SetValue(&model.sampleMask, record.GetUInt());
+        break;
+    }
+    case API_CALL_SET_DEPTH_STENCIL_STATE:
+        changed = SetValue(&model.depthStencilState[0], GetId(record));
+        changed |= SetValue(&model.depthStencilState[1], record.GetUInt());
+        break;
+    case API_CALL_SET_STREAM_OUTPUT_TARGETS:
+    {
+        uint64_t count = record.GetUInt();
+        changed = false;
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            uint64_t id = GetId(record);
+            uint64_t offset = record.GetUInt();
+            if (i < MAX_STREAM_OUTPUT_TARGETS)
+            {
+                changed |= SetValue(&model.streamOutputTargets[i][0], id);
+                changed |= SetValue(&model.streamOutputTargets[i][1], offset);
+            }
+        }
+        break;
+    }
+    case API_CALL_SET_RASTERIZER_STATE:
+        changed = SetValue(&model.rasterizerState, GetId(record));
+        break;
+    case API_CALL_SET_VIEWPORTS:
+    {
+        uint64_t count = record.GetUInt();
+        changed = SetValue(&model.viewportCount, count);
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            for (int field = 0; field < 6; ++field)
+            {
+                float value = record.GetFloat();
+                if (i < MAX_VIEWPORTS)
+                {
+                    changed |= value != model.viewports[i][field];
+                    model.viewports[i][field] = value;
+                }
+            }
+        }
+        break;
+    }
+    case API_CALL_SET_SCISSOR_RECTS:
+    {
+        uint64_t count = record.GetUInt();
+        changed = SetValue(&model.scissorCount, count);
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            for (int field = 0; field < 4; ++field)
+            {
+                int64_t value = record.GetInt();
+                if (i < MAX_VIEWPORTS)
+                {
+                    changed |= value != model.scissorRects[i][field];
+                    model.scissorRects[i][field] = value;
+                }
+            }
+        }
+        break;
+    }
+    case API_CALL_SET_PREDICATION:
+        changed = SetValue(&model.predication[0], GetId(record));
+        changed |= SetValue(&model.predication[1], record.GetUInt());
+        break;
+    case API_CALL_DRAW:
+        CountDraw(record.GetUInt(), 1, false);
+        break;
+    case API_CALL_DRAW_INDEXED:
+        CountDraw(record.GetUInt(), 1, true);
+        break;
+    case API_CALL_DRAW_INSTANCED:
+    {
+        uint64_t count = record.GetUInt();
+        CountDraw(count, record.GetUInt(), false);
+        break;
+    }
+    case API_CALL_DRAW_INDEXED_INSTANCED:
+    {
+        uint64_t count = record.GetUInt();
+        CountDraw(count, record.GetUInt(), true);
+        break;
+    }
+    case API_CALL_DRAW_AUTO:
+    case API_CALL_DRAW_INDIRECT:
+        // the GPU decides how much, only the call is known
+        _stats.Draws++;
+        break;
+    case API_CALL_MAP:
+    {
+        GetId(record);
+        record.GetUInt();
+        record.GetUInt();
+        record.GetUInt();
+        record.GetInt();
+        _stats.ReadbackBytes += record.GetUInt();
+        break;
+    }
+    case API_CALL_UNMAP:
+    {
+        GetId(record);
+        record.GetUInt();
+        size_t bytes;
+        record.GetBytes(&bytes);
+        _stats.UploadBytes += bytes;
+        break;
+    }
+    case API_CALL_UPDATE_SUBRESOURCE:
+    {
+        GetId(record);
+        record.GetUInt();
+        if (record.GetUInt())
+        {
+            for (int i = 0; i < 6; ++i)
+                record.GetUInt();
+        }
+        record.GetUInt();
+        record.GetUInt();
+        size_t bytes;
+        record.GetBytes(&bytes);
+        _stats.UploadBytes += bytes;
+        break;
+    }
+    case API_CALL_COPY_RESOURCE:
+        GetId(record);
+        GetId(record);
+        _stats.CopyBytes += record.GetUInt() * 2;
+        break;
+    case API_CALL_COPY_SUBRESOURCE_REGION:
+    {
+        GetId(record);
+        for (int i = 0; i < 4; ++i)
+            record.GetUInt();
+        GetId(record);
+        record.GetUInt();
+        _stats.CopyBytes += record.GetUInt() * 2;
+        break;
+    }
+    case API_CALL_RESOLVE_SUBRESOURCE:
+    {
+        GetId(record);
+        record.GetUInt();
+        GetId(record);
+        record.GetUInt();
+        record.GetUInt();
+        _stats.CopyBytes += record.GetUInt() * 2;
+        break;
+    }
+    case API_CALL_CLEAR_RENDER_TARGET:
+    case API_CALL_CLEAR_DEPTH_STENCIL:
+    case API_CALL_CLEAR_UNORDERED_ACCESS_VIEW:
+        _stats.ClearBytes += ObjectBytes(GetId(record));
+        break;
+    case API_CALL_CLEAR_STATE:
+        *_model = PipelineModel();
+        _vertexStride = 0;
+        break;
+    default:
+        break;
+    }
+
+    if (record.Overrun())
+        _stats.BadRecords++;
+
+    if (!changed)
+        _stats.RedundantCalls[record.Call]++;
+}
+
+bool AnalyseApiTrace(const wchar_t* fileName, ApiTraceStats& stats)
+{
+    memset(&stats, 0, sizeof(stats));
+
+    ApiTraceReader reader;
+    if (!reader.Open(fileName))
+        return false;
+
+    stats.TraceBytes = reader.GetSize();
+
+    ApiTraceAnalyser analyser(stats);
+    ApiTraceRecord record;
+    while (reader.Next(record))
+        analyser.Replay(record);
+
+    if (reader.IsTruncated())
+        stats.BadRecords++;
+
+    return true;
+}
+
+const char* GetApiCallName(ApiCall call)
+{
+    return call < API_CALL_COUNT ? CALL_NAMES[call] : "unknown";
+}
+
+string FormatApiTraceReport(const ApiTraceStats& stats)
+{
+    string text;
+    char line[256];
+
+    double frames = (double)max(stats.Frames, (uint64_t)1);
+    uint64_t calls = 0;
+    uint64_t stateSets = 0;
+    uint64_t redundant = 0;
+    for (int call = API_CALL_SET_SHADER; call < API_CALL_COUNT; ++call)
+    {
+        calls += stats.Calls[call];
+        if (call <= API_CALL_SET_PREDICATION)
+        {
+            stateSets += stats.Calls[call];
+            redundant += stats.RedundantCalls[call];
+        }
+    }
+
+    snprintf(line, sizeof(line), "api trace: %llu frames, %llu bytes, %llu objects\n", (unsigned long long)stats.Frames,
+             (unsigned long long)stats.TraceBytes, (unsigned long long)stats.Objects);
+    text += line;
+
+    snprintf(line, sizeof(line), "per frame: %.1f calls, %.1f draws, %.1f primitives, %.1f%% of state sets redundant\n",
+             calls / frames, stats.Draws / frames, stats.Primitives / frames, stateSets ? 100.0 * redundant / stateSets : 0.0);
+    text += line;
+
+    uint64_t total = stats.UploadBytes + stats.ReadbackBytes + stats.CopyBytes + stats.ClearBytes + stats.IndexBytes + stats.VertexBytes;
+    snprintf(line, sizeof(line), "per frame traffic (estimated): upload %.1f KB, readback %.1f KB, copy %.1f KB, clear %.1f KB, "
+             "index %.1f KB, vertex %.1f KB, total %.2f MB\n", stats.UploadBytes / frames / 1024.0, stats.ReadbackBytes / frames / 1024.0,
+             stats.CopyBytes / frames / 1024.0, stats.ClearBytes / frames / 1024.0, stats.IndexBytes / frames / 1024.0,
+             stats.VertexBytes / frames / 1024.0, total / frames / (1024.0 * 1024.0));
+    text += line;
+
+    if (stats.UnknownObjects || stats.BadRecords)
+    {
+        snprintf(line, sizeof(line), "warning: %llu uses of undescribed objects, %llu bad records\n",
+                 (unsigned long long)stats.UnknownObjects, (unsigned long long)stats.BadRecords);
+        text += line;
+    }
+
+    snprintf(line, sizeof(line), "%-28s %10s %10s %10s\n", "call", "total", "per frame", "redundant");
+    text += line;
+
+    for (int call = API_CALL_SET_SHADER; call < API_CALL_COUNT; ++call)
+    {
+        if (!stats.Calls[call])
+            continue;
+
+        snprintf(line, sizeof(line), "%-28s %10llu %10.1f %9.1f%%\n", CALL_NAMES[call], (unsigned long long)stats.Calls[call],
+                 stats.Calls[call] / frames, 100.0 * stats.RedundantCalls[call] / stats.Calls[call]);
+        text += line;
+    }
+
+    return text;
+}
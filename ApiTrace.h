@@ -0,0 +1,188 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// device context calls in an API trace, the record layouts are in ApiTrace.cpp. the
+// numbering is part of the file format, new calls go on the end
+enum ApiCall
+{
+	API_CALL_OBJECT,
+	API_CALL_FRAME,
+	API_CALL_SET_SHADER,
+	API_CALL_SET_CONSTANT_BUFFERS,
+	API_CALL_SET_SHADER_RESOURCES,
+	API_CALL_SET_SAMPLERS,
+	API_CALL_SET_UNORDERED_ACCESS_VIEWS,
+	API_CALL_SET_INPUT_LAYOUT,
+	API_CALL_SET_VERTEX_BUFFERS,
+	API_CALL_SET_INDEX_BUFFER,
+	API_CALL_SET_PRIMITIVE_TOPOLOGY,
+	API_CALL_SET_RENDER_TARGETS,
+	API_CALL_SET_BLEND_STATE,
+	API_CALL_SET_DEPTH_STENCIL_STATE,
+	API_CALL_SET_STREAM_OUTPUT_TARGETS,
+	API_CALL_SET_RASTERIZER_STATE,
+	API_CALL_SET_VIEWPORTS,
+	API_CALL_SET_SCISSOR_RECTS,
+	API_CALL_SET_PREDICATION,
+	API_CALL_DRAW,
+	API_CALL_DRAW_INDEXED,
+	API_CALL_DRAW_INSTANCED,
+	API_CALL_DRAW_INDEXED_INSTANCED,
+	API_CALL_DRAW_AUTO,
+	API_CALL_DRAW_INDIRECT,
+	API_CALL_DISPATCH,
+	API_CALL_DISPATCH_INDIRECT,
+	API_CALL_BEGIN_QUERY,
+	API_CALL_END_QUERY,
+	API_CALL_GET_DATA,
+	API_CALL_MAP,
+	API_CALL_UNMAP,
+	API_CALL_UPDATE_SUBRESOURCE,
+	API_CALL_COPY_RESOURCE,
+	API_CALL_COPY_SUBRESOURCE_REGION,
+	API_CALL_COPY_STRUCTURE_COUNT,
+	API_CALL_CLEAR_RENDER_TARGET,
+	API_CALL_CLEAR_DEPTH_STENCIL,
+	API_CALL_CLEAR_UNORDERED_ACCESS_VIEW,
+	API_CALL_GENERATE_MIPS,
+	API_CALL_SET_MIN_LOD,
+	API_CALL_RESOLVE_SUBRESOURCE,
+	API_CALL_EXECUTE_COMMAND_LIST,
+	API_CALL_FINISH_COMMAND_LIST,
+	API_CALL_CLEAR_STATE,
+	API_CALL_FLUSH,
+	API_CALL_COUNT,
+};
+
+// what an object id in a trace refers to, described once by an API_CALL_OBJECT record
+// ahead of its first use
+enum ApiObjectKind
+{
+	API_OBJECT_BUFFER,
+	API_OBJECT_TEXTURE,
+	API_OBJECT_SHADER_RESOURCE_VIEW,
+	API_OBJECT_RENDER_TARGET_VIEW,
+	API_OBJECT_DEPTH_STENCIL_VIEW,
+	API_OBJECT_UNORDERED_ACCESS_VIEW,
+	API_OBJECT_SHADER,
+	API_OBJECT_INPUT_LAYOUT,
+	API_OBJECT_SAMPLER,
+	API_OBJECT_RASTERIZER_STATE,
+	API_OBJECT_BLEND_STATE,
+	API_OBJECT_DEPTH_STENCIL_STATE,
+	API_OBJECT_QUERY,
+	API_OBJECT_COMMAND_LIST,
+	API_OBJECT_COUNT,
+};
+
+// vertex, hull, domain, geometry, pixel and compute, in D3D's order
+static const uint32_t API_SHADER_STAGES = 6;
+
+// builds records in memory, Flush appends them to the file. a record is written with
+// Begin, the Put calls for its fields and End. integers are varints so ids, counts and
+// most draw arguments take a byte or two
+class ApiTraceWriter
+{
+public:
+	ApiTraceWriter();
+	~ApiTraceWriter();
+
+	bool Open(const wchar_t* fileName);
+	// flushes anything left
+	void Close();
+	bool IsOpen() const { return _file != nullptr; }
+
+	void Begin(ApiCall call);
+	void PutUInt(uint64_t value);
+	void PutInt(int64_t value);
+	void PutFloat(float value);
+	// a length and the bytes
+	void PutBytes(const void* data, size_t bytes);
+	void End();
+
+	bool Flush();
+	uint64_t GetBytesWritten() const { return _written + _buffer.size(); }
+
+private:
+	FILE* _file;
+	ApiCall _call;
+	vector<uint8_t> _record;
+	vector<uint8_t> _buffer;
+	uint64_t _written;
+};
+
+// one record, the Get calls read its fields in the order they were put and return 0
+// (or nothing) once past its end
+struct ApiTraceRecord
+{
+	ApiCall Call;
+	const uint8_t* Data;
+	size_t Size;
+	size_t Offset;
+
+	uint64_t GetUInt();
+	int64_t GetInt();
+	float GetFloat();
+	const uint8_t* GetBytes(size_t* bytes);
+	bool Overrun() const { return Offset > Size; }
+};
+
+// reads a whole trace into memory and walks its records
+class ApiTraceReader
+{
+public:
+	ApiTraceReader();
+
+	bool Open(const wchar_t* fileName);
+	// false at the end, or at a record cut short (see IsTruncated)
+	bool Next(ApiTraceRecord& record);
+	bool IsTruncated() const { return _truncated; }
+	uint64_t GetSize() const { return _data.size(); }
+
+private:
+	vector<uint8_t> _data;
+	size_t _offset;
+	bool _truncated;
+};
+
+struct ApiTraceStats
+{
+	uint64_t Frames;
+	uint64_t TraceBytes;
+	uint64_t Calls[API_CALL_COUNT];
+	// state sets that left every slot they named as it already was
+	uint64_t RedundantCalls[API_CALL_COUNT];
+	uint64_t Objects;
+	// ids used without being described, or records that didn't parse
+	uint64_t UnknownObjects;
+	uint64_t BadRecords;
+
+	uint64_t Draws;
+	uint64_t Primitives;
+	// estimated memory traffic: UpdateSubresource and write maps, read maps, both sides
+	// of copies and resolves, every texel of cleared views, index fetch and vertex fetch
+	// (one fetch per index or vertex from every bound vertex buffer, no vertex cache)
+	uint64_t UploadBytes;
+	uint64_t ReadbackBytes;
+	uint64_t CopyBytes;
+	uint64_t ClearBytes;
+	uint64_t IndexBytes;
+	uint64_t VertexBytes;
+};
+
+// replays a trace against a model of the pipeline state in place of a device, counting
+// calls, redundant state sets and memory traffic. runs anywhere, no D3D needed
+bool AnalyseApiTrace(const wchar_t* fileName, ApiTraceStats& stats);
+const char* GetApiCallName(ApiCall call);
+// primitives drawn from count vertices or indices with a D3D11_PRIMITIVE_TOPOLOGY, 0 for
+// patch lists and anything unknown
+uint64_t GetApiPrimitiveCount(uint64_t topology, uint64_t count);
+// totals and per frame averages, then a line per call that was made
+string FormatApiTraceReport(const ApiTraceStats& stats);
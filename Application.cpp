@@ -1,7 +1,112 @@
 #include "Application.h"
 
+#ifdef _DEBUG
+#include <crtdbg.h>
+#include <atomic>
+#endif
+
 using namespace std;
 
+// Compiled shader bytecode is kept here between runs, relative to the working directory
+static const wchar_t* SHADER_CACHE_DIRECTORY = L"ShaderCache";
+// Shader features the crates and the ground plane are drawn with
+static const UINT CRATE_SHADER_FEATURES = SHADER_FEATURE_DIFFUSE_TEXTURE | SHADER_FEATURE_SPECULAR | SHADER_FEATURE_POINT_LIGHTS |
+                                          SHADER_FEATURE_NORMAL_MAP | SHADER_FEATURE_SHADOWS;
+static const UINT GROUND_SHADER_FEATURES = SHADER_FEATURE_VIRTUAL_TEXTURE | SHADER_FEATURE_SPECULAR | SHADER_FEATURE_SHADOWS;
+// Normal xy in red and green, specular mask in blue, so one fetch gets all three
+static const wchar_t* CRATE_MATERIAL_TEXTURE = L"Crate_MATERIAL.dds";
+static const PackedChannel CRATE_MATERIAL_CHANNELS[4] =
+{
+    { L"Crate_NRM.dds", 0, 0 },
+    { L"Crate_NRM.dds", 1, 0 },
+    { L"Crate_SPEC.dds", 0, 0 },
+    { nullptr, 0, 255 },
+};
+// Points from the scene towards the sun, the one shadow casting light
+static const XMFLOAT3 SUN_DIRECTION = { 0.3f, 0.9f, 0.3f };
+// Cascades cover the first 60 units in front of the camera at 2048x2048 each
+static const UINT SHADOW_MAP_RESOLUTION = 2048;
+static const UINT SHADOW_CASCADE_COUNT = 3;
+static const float SHADOW_DISTANCE = 60.0f;
+// Point lights circling the scene, shaded through the light clusters
+static const UINT POINT_LIGHT_COUNT = 64;
+// GPU memory the packed material textures may take before their top mips are dropped
+static const UINT64 TEXTURE_BUDGET_BYTES = 64ull * 1024 * 1024;
+// Transient per frame data, double buffered so a frame's lists last into the next one
+static const size_t FRAME_ARENA_BYTES = 4 * 1024 * 1024;
+static const UINT FRAME_ARENA_FRAMES = 2;
+// Frames allowed to allocate while caches and scratch buffers grow to size, and how many
+// allocating frames after that get a line of their own
+static const UINT64 ALLOCATION_CHECK_WARMUP = 120;
+static const UINT64 ALLOCATION_CHECK_REPORTS = 8;
+// GPU profiler scope for each of the bodies Update animates, in _worldMatrices order
+static const char* BODY_NAMES[NAMED_BODY_COUNT] = { "Sun", "Mars", "Earth", "Earth moon", "Mars moon" };
+
+// CPU stages RunBenchmark times, in the order a frame goes through them
+enum BenchmarkStage
+{
+    BENCHMARK_UPDATE,
+    BENCHMARK_SHADOWS,
+    BENCHMARK_SCENE,
+    BENCHMARK_LIGHTING,
+    BENCHMARK_PRESENT,
+    BENCHMARK_STREAMING,
+};
+
+static const char* BENCHMARK_STAGE_NAMES[] = { "update", "shadows", "scene", "lighting", "present", "streaming" };
+
+#ifdef _DEBUG
+// Counts debug heap allocations from any thread while the frame is being checked
+static atomic<bool> s_countAllocations(false);
+static atomic<UINT> s_frameAllocations(0);
+static _CRT_ALLOC_HOOK s_previousAllocHook = nullptr;
+static bool s_allocHookInstalled = false;
+
+static int __cdecl CountAllocations(int allocType, void* userData, size_t size, int blockType, long requestNumber,
+                                    const unsigned char* fileName, int lineNumber)
+{
+    if (allocType != _HOOK_FREE && s_countAllocations.load(memory_order_relaxed))
+        s_frameAllocations.fetch_add(1, memory_order_relaxed);
+
+    return s_previousAllocHook ? s_previousAllocHook(allocType, userData, size, blockType, requestNumber, fileName, lineNumber) : TRUE;
+}
+#endif
+
+static DWORD ShaderCompileFlags()
+{
+    DWORD dwShaderFlags = D3DCOMPILE_ENABLE_STRICTNESS;
+#if defined(DEBUG) || defined(_DEBUG)
+    // Set the D3DCOMPILE_DEBUG flag to embed debug information in the shaders.
+    // Setting this flag improves the shader debugging experience, but still allows 
+    // the shaders to be optimized and to run exactly the way they will run in 
+    // the release configuration of this program.
+    dwShaderFlags |= D3DCOMPILE_DEBUG;
+#endif
+
+    return dwShaderFlags;
+}
+
+static void RequestMaterialShaders(ShaderPermutations& permutations, UINT* crate, UINT* ground, UINT* feedback)
+{
+    *crate = permutations.Request("PS", "ps_4_0", CRATE_SHADER_FEATURES);
+    *ground = permutations.Request("PS", "ps_4_0", GROUND_SHADER_FEATURES);
+    *feedback = permutations.Request("PS_Feedback", "ps_4_0", 0);
+}
+
+static void RequestUpscaleShaders(ShaderPermutations& permutations, UINT* fullscreen, UINT* upscale)
+{
+    *fullscreen = permutations.Request("VS_Fullscreen", "vs_4_0", 0);
+    *upscale = permutations.Request("PS_Upscale", "ps_4_0", 0);
+}
+
+static void RequestDeferredShaders(ShaderPermutations& permutations, UINT* crate, UINT* ground, UINT* fullscreen, UINT* lighting)
+{
+    *crate = permutations.Request("PS_GBuffer", "ps_4_0", CRATE_SHADER_FEATURES);
+    *ground = permutations.Request("PS_GBuffer", "ps_4_0", GROUND_SHADER_FEATURES);
+    *fullscreen = permutations.Request("VS_Fullscreen", "vs_4_0", 0);
+    *lighting = permutations.Request("PS_DeferredLighting", "ps_4_0", SHADER_FEATURE_SPECULAR | SHADER_FEATURE_SHADOWS);
+}
+
 LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 {
     PAINTSTRUCT ps;
@@ -33,16 +138,62 @@ Application::Application()
     _featureLevel = D3D_FEATURE_LEVEL_11_0;
     _pd3dDevice = nullptr;
     _pImmediateContext = nullptr;
-    _pSwapChain = nullptr;
+    _swapChainSettings.BufferCount = 3;
+    _swapChainSettings.MaxFrameLatency = 1;
+    _swapChainSettings.SyncInterval = 1;
+    _swapChainSettings.AllowTearing = true;
+    _targetFrameRate = 0.0;
+    _occluded = false;
     _pRenderTargetView = nullptr;
     _pVertexShader = nullptr;
-    _pPixelShader = nullptr;
+    _crateShader = 0;
+    _groundShader = 0;
+    _feedbackShader = 0;
+    _renderPath = RENDER_PATH_FORWARD;
+    _crateGBufferShader = 0;
+    _groundGBufferShader = 0;
+    _fullscreenShader = 0;
+    _deferredLightingShader = 0;
+    _dynamicResolutionEnabled = false;
+    _upscaleShader = 0;
+    _sceneTarget = nullptr;
+    _sceneDepth = nullptr;
+    _headless = false;
+    _headlessTarget = nullptr;
+    _requestedDriverType = D3D_DRIVER_TYPE_UNKNOWN;
+    _fixedTimestep = 0.0f;
+    _time = 0.0f;
+    _bodyCount = NAMED_BODY_COUNT;
+    _textureBudget = TEXTURE_BUDGET_BYTES;
+    _groundPlaneIndexCount = 0;
+    _benchmark = nullptr;
+    _allocationFrames = 0;
+    _captureContext = nullptr;
+    _captureFrames = 0;
+    _rhiVertexShader = nullptr;
+    _rhiConstantBuffer = nullptr;
+    _cubeMesh = {};
+    _pyramidMesh = {};
+    _groundMesh = {};
+    _bodyPipeline = nullptr;
+    _groundFeedbackPipeline = nullptr;
+    _groundPipeline = nullptr;
+    _WindowWidth = 0;
+    _WindowHeight = 0;
     _pVertexLayout = nullptr;
     _pVertexBuffer = nullptr;
     _pPyramidVertexBuffer = nullptr;
+    _pGroundPlaneVertexBuffer = nullptr;
     _pIndexBuffer = nullptr;
+    _pPyramidIndexBuffer = nullptr;
+    _pGroundPlaneIndexBuffer = nullptr;
     _pConstantBuffer = nullptr;
-    _pTextureRV = nullptr;
+    _depthStencilView = nullptr;
+    _depthStencilBuffer = nullptr;
+    _wireFrame = nullptr;
+    _solidObj = nullptr;
+    _crateTexture = 0;
+    _crateMaterialTexture = 0;
     _pSamplerLinear = nullptr;
 }
 
@@ -51,17 +202,53 @@ Application::~Application()
 	Cleanup();
 }
 
+void Application::SetHeadless(UINT width, UINT height)
+{
+    _headless = true;
+    _WindowWidth = width;
+    _WindowHeight = height;
+}
+
 HRESULT Application::Initialise(HINSTANCE hInstance, int nCmdShow)
 {
-    if (FAILED(InitWindow(hInstance, nCmdShow)))
+    if (!_cpuProfileFile.empty())
+        CpuProfiler::Start();
+    CPU_PROFILE_THREAD("Main");
+
+    CPU_PROFILE_FUNCTION();
+
+    _frameStats.Init(&_frameClock);
+    if (!_statsFile.empty())
+        _frameStats.Open(_statsFile.c_str());
+
+    if (!_headless)
     {
-        return E_FAIL;
+        if (FAILED(InitWindow(hInstance, nCmdShow)))
+        {
+            return E_FAIL;
+        }
+
+        RECT rc;
+        GetClientRect(_hWnd, &rc);
+        _WindowWidth = rc.right - rc.left;
+        _WindowHeight = rc.bottom - rc.top;
     }
 
-    RECT rc;
-    GetClientRect(_hWnd, &rc);
-    _WindowWidth = rc.right - rc.left;
-    _WindowHeight = rc.bottom - rc.top;
+    // Worker threads for loading, shader permutations are compiled and compressed
+    // textures decompressed on them
+    _jobSystem.Init();
+    _texturePacker.SetJobSystem(&_jobSystem);
+    _frameArena.Init(FRAME_ARENA_BYTES, FRAME_ARENA_FRAMES);
+
+#ifdef _DEBUG
+    if (!s_allocHookInstalled)
+    {
+        s_previousAllocHook = _CrtSetAllocHook(CountAllocations);
+        s_allocHookInstalled = true;
+    }
+#endif
+
+    _shaderCache.SetDirectory(SHADER_CACHE_DIRECTORY);
 
     if (FAILED(InitDevice()))
     {
@@ -70,8 +257,11 @@ HRESULT Application::Initialise(HINSTANCE hInstance, int nCmdShow)
         return E_FAIL;
     }
 
+    // Not every driver has timestamps, the frame is just not profiled without them
+    _gpuProfiler.Initialise(_pd3dDevice);
+
     // Initialize the world matrix
-    for (int i = 0; i < 5; i++)
+    for (UINT i = 0; i < _bodyCount; i++)
     {
         XMFLOAT4X4 world;
         XMStoreFloat4x4(&world, XMMatrixIdentity());
@@ -87,13 +277,92 @@ HRESULT Application::Initialise(HINSTANCE hInstance, int nCmdShow)
     
     // Initialize the projection matrix
     XMStoreFloat4x4(&_projection, XMMatrixPerspectiveFovLH(XM_PIDIV2, _WindowWidth / (FLOAT)_WindowHeight, 0.01f, 100.0f));
-    CreateDDSTextureFromFile(_pd3dDevice, L"Crate_COLOR.dds", nullptr, &_pTextureRV);
+
+    // Pack the material textures so every draw in the pass shares one texture array
+    CPU_PROFILE_SCOPE("Texture packing");
+    if (FAILED(PackMaterialTextures(false)) ||
+        FAILED(_texturePacker.AddTexture(_pd3dDevice, L"Crate_COLOR.dds", &_crateTexture)) ||
+        FAILED(_texturePacker.AddTexture(_pd3dDevice, CRATE_MATERIAL_TEXTURE, &_crateMaterialTexture)) ||
+        FAILED(_texturePacker.Build(_pd3dDevice, _pImmediateContext)))
+    {
+        Cleanup();
+
+        return E_FAIL;
+    }
+
+    // Track the packed arrays against the texture memory budget
+    _textureResidency.SetBudget(_textureBudget);
+    for (UINT group = 0; group < _texturePacker.GetGroupCount(); ++group)
+    {
+        D3D11_TEXTURE2D_DESC desc;
+        _texturePacker.GetGroupDesc(group, &desc);
+
+        UINT64 mipBytes[D3D11_REQ_MIP_LEVELS];
+        UINT mipLevels = min(desc.MipLevels, (UINT)D3D11_REQ_MIP_LEVELS);
+        for (UINT mip = 0; mip < mipLevels; ++mip)
+            mipBytes[mip] = (UINT64)GetSurfaceByteSize(max(desc.Width >> mip, 1u), max(desc.Height >> mip, 1u), desc.Format) * desc.ArraySize;
+
+        _groupResidency.push_back(_textureResidency.Register(desc.Width, desc.Height, mipBytes, mipLevels));
+    }
+
+    // The ground plane streams its texture through a virtual texture, the feedback pass runs at 1/8th resolution
+    if (FAILED(_terrainTexture.Initialise(_pd3dDevice, L"Crate_COLOR.dds", 64, 8,
+                                          max(_WindowWidth / 8, 1u), max(_WindowHeight / 8, 1u), 1.0f / 8.0f)))
+    {
+        Cleanup();
+
+        return E_FAIL;
+    }
+
+    // Same near and far planes as the projection so the cluster slices line up with it
+    if (FAILED(_clusteredLighting.Initialise(_pd3dDevice, _WindowWidth, _WindowHeight, 0.01f, 100.0f)))
+    {
+        Cleanup();
+
+        return E_FAIL;
+    }
+
+    if (FAILED(_shadowMap.Initialise(_pd3dDevice, SHADOW_MAP_RESOLUTION, SHADOW_CASCADE_COUNT, 0.01f, SHADOW_DISTANCE)))
+    {
+        Cleanup();
+
+        return E_FAIL;
+    }
+
+    if (_renderPath == RENDER_PATH_DEFERRED && FAILED(_gBuffer.Initialise(_pd3dDevice, _WindowWidth, _WindowHeight)))
+    {
+        Cleanup();
+
+        return E_FAIL;
+    }
+
+    double frameBudget = 1.0 / (_targetFrameRate > 0.0 ? _targetFrameRate : 60.0);
+    if (_dynamicResolutionEnabled && FAILED(_dynamicResolution.Initialise(_pd3dDevice, _WindowWidth, _WindowHeight, frameBudget)))
+    {
+        Cleanup();
+
+        return E_FAIL;
+    }
+
+    _pointLights.resize(POINT_LIGHT_COUNT);
+    for (UINT i = 0; i < POINT_LIGHT_COUNT; ++i)
+    {
+        // spread the colours round the hue circle, Update moves them
+        float hue = i * XM_2PI / POINT_LIGHT_COUNT;
+        _pointLights[i].Radius = 3.0f + (i % 4);
+        _pointLights[i].Colour = XMFLOAT3(0.5f + 0.5f * cosf(hue), 0.5f + 0.5f * cosf(hue - XM_2PI / 3), 0.5f + 0.5f * cosf(hue + XM_2PI / 3));
+        _pointLights[i].Intensity = 1.0f;
+    }
+
+    _frameScheduler.Init(&_frameClock, _targetFrameRate);
 
 	return S_OK;
 }
 
 HRESULT Application::InitShadersAndInputLayout()
 {
+    CPU_PROFILE_FUNCTION();
+
 	HRESULT hr;
 
     // Compile the vertex shader
@@ -116,32 +385,34 @@ HRESULT Application::InitShadersAndInputLayout()
         return hr;
 	}
 
-	// Compile the pixel shader
-	ID3DBlob* pPSBlob = nullptr;
-    hr = CompileShaderFromFile(L"DX11 Framework.fx", "PS", "ps_4_0", &pPSBlob);
+    // The RHI keeps the bytecode for the input layouts of its pipeline states
+    _rhiVertexShader = _rhiDevice.WrapVertexShader(_pVertexShader, pVSBlob->GetBufferPointer(), pVSBlob->GetBufferSize());
+
+    // Compile the pixel shader permutations the materials use
+    _shaderPermutations.Init(&_shaderCache, &_jobSystem, L"DX11 Framework.fx", ShaderCompileFlags());
+    RequestMaterialShaders(_shaderPermutations, &_crateShader, &_groundShader, &_feedbackShader);
+    if (_renderPath == RENDER_PATH_DEFERRED)
+        RequestDeferredShaders(_shaderPermutations, &_crateGBufferShader, &_groundGBufferShader, &_fullscreenShader, &_deferredLightingShader);
+    if (_dynamicResolutionEnabled)
+        RequestUpscaleShaders(_shaderPermutations, &_fullscreenShader, &_upscaleShader);
+    hr = _shaderPermutations.CompileRequested(_pd3dDevice);
 
     if (FAILED(hr))
     {
         MessageBox(nullptr,
                    L"The FX file cannot be compiled.  Please run this executable from the directory that contains the FX file.", L"Error", MB_OK);
+        pVSBlob->Release();
         return hr;
     }
 
-	// Create the pixel shader
-	hr = _pd3dDevice->CreatePixelShader(pPSBlob->GetBufferPointer(), pPSBlob->GetBufferSize(), nullptr, &_pPixelShader);
-	pPSBlob->Release();
-
-    if (FAILED(hr))
-        return hr;
-
     // Define the input layout
     D3D11_INPUT_ELEMENT_DESC layout[] =
     {
         { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
         { "NORMAL", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
         { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-     //   { "TANGENT", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-     //   { "BITANGENT", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        // the bitangent is rebuilt in the shader from the sign in w
+        { "TANGENT", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
 	};
 
 	UINT numElements = ARRAYSIZE(layout);
@@ -165,72 +436,8 @@ HRESULT Application::InitVertexBuffer()
 	HRESULT hr;
 
     // Create vertex buffer
-    SimpleVertexNormal cubeVertices[] =
-    {
-        /*
-        { XMFLOAT3( -1.0f, 1.0f, -1.0f ), XMFLOAT4(1, 1, 0, 0) },
-        { XMFLOAT3( 1.0f, 1.0f, -1.0f ), XMFLOAT4(1, 1, 0, 0) },
-        { XMFLOAT3( -1.0f, -1.0f, -1.0f ), XMFLOAT4(1, 1, 0, 0) },
-        { XMFLOAT3( 1.0f, -1.0f, -1.0f ), XMFLOAT4(1, 1, 0, 0) },
-        { XMFLOAT3(-1.0f, 1.0f, 1.0f), XMFLOAT4(1, 1, 0, 0)},
-        { XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT4(1, 1, 0, 0) },
-        { XMFLOAT3(-1.0f, -1.0f, 1.0f), XMFLOAT4(1, 1, 0, 0) },
-        { XMFLOAT3(1.0f, -1.0f, 1.0f), XMFLOAT4(1, 1, 0, 0) }
-        */
-        //front face
-        { XMFLOAT3(1, 1, 1), XMFLOAT4(0, 0, -1, 0), XMFLOAT2(1,0) /*XMFLOAT3(-1,0,0), XMFLOAT3(0,-1,0)*/ },
-        { XMFLOAT3(-1, 1, 1), XMFLOAT4(0, 0, -1, 0), XMFLOAT2(0,0)/*XMFLOAT3(-1,0,0), XMFLOAT3(0,-1,0)*/},
-        { XMFLOAT3(-1, -1, 1), XMFLOAT4(0, 0, -1, 0), XMFLOAT2(0,1)/*XMFLOAT3(-1,0,0), XMFLOAT3(0,-1,0)*/ },
-        
-        { XMFLOAT3(1, -1, 1), XMFLOAT4(0, 0, -1, 0), XMFLOAT2(1,1)/*XMFLOAT3(-1,0,0), XMFLOAT3(0,-1,0)*/ },
-        { XMFLOAT3(1, 1, 1), XMFLOAT4(0, 0, -1, 0), XMFLOAT2(1,0) /*XMFLOAT3(-1,0,0), XMFLOAT3(0,-1,0)*/},
-        { XMFLOAT3(-1, -1, 1), XMFLOAT4(0, 0, -1, 0), XMFLOAT2(0,1) /*XMFLOAT3(-1,0,0), XMFLOAT3(0,-1,0)*/},
-        
-        //back face
-        { XMFLOAT3(-1, -1, -1), XMFLOAT4(0, 0, 1, 0), XMFLOAT2(1,1) /*XMFLOAT3(1,0,0), XMFLOAT3(0,1,0)*/},
-        { XMFLOAT3(1, 1, -1), XMFLOAT4(0, 0, 1, 0), XMFLOAT2(0,0) /*XMFLOAT3(1,0,0), XMFLOAT3(0,1,0)*/},
-        { XMFLOAT3(-1, 1, -1), XMFLOAT4(0, 0, 1, 0), XMFLOAT2(1,0) /*XMFLOAT3(1,0,0), XMFLOAT3(0,1,0)*/},
-
-        { XMFLOAT3(-1, -1, -1), XMFLOAT4(0, 0, 1, 0), XMFLOAT2(1,1) /*XMFLOAT3(1,0,0), XMFLOAT3(0,1,0)*/},
-        { XMFLOAT3(1, -1, -1), XMFLOAT4(0, 0, 1, 0), XMFLOAT2(0,1) /*XMFLOAT3(1,0,0), XMFLOAT3(0,1,0)*/},
-        { XMFLOAT3(1, 1, -1), XMFLOAT4(0, 0,1, 0), XMFLOAT2(0,0) /*XMFLOAT3(1,0,0), XMFLOAT3(0,1,0)*/},
-        
-        //left face
-        { XMFLOAT3(-1, 1, 1), XMFLOAT4(1, 0, 0, 0), XMFLOAT2(1,0) /*XMFLOAT3(1,0,0), XMFLOAT3(0,1,0)*/},
-        { XMFLOAT3(-1, 1, -1), XMFLOAT4(1, 0, 0, 0), XMFLOAT2(0,0) /*XMFLOAT3(1,0,0), XMFLOAT3(0,1,0)*/},
-        { XMFLOAT3(-1, -1, -1), XMFLOAT4(1, 0, 0, 0), XMFLOAT2(0,1) /*XMFLOAT3(1,0,0), XMFLOAT3(0,1,0)*/},
-
-        { XMFLOAT3(-1, -1, -1), XMFLOAT4(1, 0, 0, 0), XMFLOAT2(0,1)/*XMFLOAT3(1,0,0), XMFLOAT3(0,1,0)*/ },
-        { XMFLOAT3(-1, -1, 1), XMFLOAT4(1, 0, 0, 0), XMFLOAT2(1,1)/*XMFLOAT3(1,0,0), XMFLOAT3(0,1,0)*/ },
-        { XMFLOAT3(-1, 1, 1), XMFLOAT4(1, 0, 0, 0), XMFLOAT2(1,0) /*XMFLOAT3(1,0,0), XMFLOAT3(0,1,0)*/},
-
-        //right face
-        { XMFLOAT3(1, 1, 1), XMFLOAT4(-1, 0, 0, 0), XMFLOAT2(0,0)/*XMFLOAT3(-1,0,0), XMFLOAT3(0,-1,0)*/ },
-        { XMFLOAT3(1, -1, -1), XMFLOAT4(-1, 0, 0, 0), XMFLOAT2(1,1)/*XMFLOAT3(-1,0,0), XMFLOAT3(0,-1,0)*/ },
-        { XMFLOAT3(1, 1, -1), XMFLOAT4(-1, 0, 0, 0), XMFLOAT2(1,0) /*XMFLOAT3(-1,0,0), XMFLOAT3(0,-1,0)*/},
-
-        { XMFLOAT3(1, -1, -1), XMFLOAT4(-1, 0, 0, 0), XMFLOAT2(1,1) /*XMFLOAT3(-1,0,0), XMFLOAT3(0,-1,0)*/},
-        { XMFLOAT3(1, 1, 1), XMFLOAT4(-1, 0, 0, 0), XMFLOAT2(0,0) /*XMFLOAT3(-1,0,0), XMFLOAT3(0,-1,0)*/},
-        { XMFLOAT3(1, -1, 1), XMFLOAT4(-1, 0, 0, 0), XMFLOAT2(0,1) /*XMFLOAT3(-1,0,0), XMFLOAT3(0,-1,0)*/},
-
-        //top face
-        { XMFLOAT3(-1, 1, -1), XMFLOAT4(0, -1, 0, 0), XMFLOAT2(0,0) /*XMFLOAT3(-1,0,0), XMFLOAT3(0,-1,0)*/},
-        { XMFLOAT3(-1, 1, 1), XMFLOAT4(0, -1, 0, 0), XMFLOAT2(0,1)/*XMFLOAT3(-1,0,0), XMFLOAT3(0,-1,0)*/ },
-        { XMFLOAT3(1, 1, -1), XMFLOAT4(0, -1, 0, 0), XMFLOAT2(1,0) /*XMFLOAT3(-1,0,0), XMFLOAT3(0,-1,0)*/},
-
-        { XMFLOAT3(1, 1, -1), XMFLOAT4(0, -1, 0, 0), XMFLOAT2(1,0)/*XMFLOAT3(-1,0,0), XMFLOAT3(0,-1,0)*/ },
-        { XMFLOAT3(-1, 1, 1), XMFLOAT4(0, -1, 0, 0), XMFLOAT2(0,1) /*XMFLOAT3(-1,0,0), XMFLOAT3(0,-1,0)*/},
-        { XMFLOAT3(1, 1, 1), XMFLOAT4(0, -1, 0, 0), XMFLOAT2(1,1)/*XMFLOAT3(-1,0,0), XMFLOAT3(0,-1,0)*/ },
-
-        //bottom face
-        { XMFLOAT3(-1, -1, -1), XMFLOAT4(0, 1, 0, 0), XMFLOAT2(1,0) /*XMFLOAT3(1,0,0), XMFLOAT3(0,1,0)*/},
-        { XMFLOAT3(-1, -1, 1), XMFLOAT4(0, 1, 0, 0), XMFLOAT2(1,1) /*XMFLOAT3(1,0,0), XMFLOAT3(0,1,0)*/},
-        { XMFLOAT3(1, -1, -1), XMFLOAT4(0, 1, 0, 0), XMFLOAT2(0,0) /*XMFLOAT3(1,0,0), XMFLOAT3(0,1,0)*/},
-
-        { XMFLOAT3(1, -1, -1), XMFLOAT4(0, 1, 0, 0), XMFLOAT2(0,0)/*XMFLOAT3(1,0,0), XMFLOAT3(0,1,0)*/ },
-        { XMFLOAT3(1, -1, 1), XMFLOAT4(0, 1, 0, 0), XMFLOAT2(0,1) /*XMFLOAT3(1,0,0), XMFLOAT3(0,1,0)*/},
-        { XMFLOAT3(-1, -1, 1), XMFLOAT4(0, 1, 0, 0), XMFLOAT2(1,1)/*XMFLOAT3(1,0,0), XMFLOAT3(0,1,0)*/ },
-    };
+    MeshVector<SimpleVertexNormal> cubeVertices;
+    GenerateCubeVertices(cubeVertices);
 
     D3D11_BUFFER_DESC bd;
 	ZeroMemory(&bd, sizeof(bd));
@@ -241,7 +448,7 @@ HRESULT Application::InitVertexBuffer()
 
     D3D11_SUBRESOURCE_DATA InitData;
 	ZeroMemory(&InitData, sizeof(InitData));
-    InitData.pSysMem = cubeVertices;
+    InitData.pSysMem = cubeVertices.data();
 
     hr = _pd3dDevice->CreateBuffer(&bd, &InitData, &_pVertexBuffer);
 
@@ -445,96 +652,43 @@ HRESULT Application::InitIndexBuffer()
 	return S_OK;
 }
 #include "iostream"
-HRESULT Application::InitPlaneIndexBuffer(int vWidth, int vHeight)
+HRESULT Application::InitPlaneIndexBuffer(UINT widthVerts, UINT depthVerts)
 {
-    HRESULT hr;
-    D3D11_BUFFER_DESC bd;
-    D3D11_SUBRESOURCE_DATA InitData;
+    MeshVector<WORD> indices;
+    GeneratePlaneIndices(widthVerts, depthVerts, indices);
+    _groundPlaneIndexCount = (UINT)indices.size();
 
-    WORD* indices = new WORD[(vWidth - 1) * (vHeight - 1) * 6];
-
-    UINT k = 0;
-    for (UINT i = 0; i < vWidth - 1; ++i)
-    {
-        for (UINT j = 0; j < vHeight - 1; ++j)
-        {
-            indices[k + 0] = i * vHeight + j;  //0
-            indices[k + 1] = i * vHeight + j + 1; //1
-            indices[k + 2] = (i + 1) * vHeight + j;  //3
-            indices[k + 3] = (i + 1) * vHeight + j;  //3
-            indices[k + 4] = i * vHeight + j + 1;  //1
-            indices[k + 5] = (i + 1) * vHeight + j + 1; //2
-            k += 6;
-        }
-    }
-    
+    D3D11_BUFFER_DESC bd;
     ZeroMemory(&bd, sizeof(bd));
-
     bd.Usage = D3D11_USAGE_DEFAULT;
-    bd.ByteWidth = sizeof(WORD) * ((vWidth-1) * (vHeight-1) * 6);
+    bd.ByteWidth = sizeof(WORD) * _groundPlaneIndexCount;
     bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
     bd.CPUAccessFlags = 0;
 
+    D3D11_SUBRESOURCE_DATA InitData;
     ZeroMemory(&InitData, sizeof(InitData));
-    InitData.pSysMem = indices;
-    hr = _pd3dDevice->CreateBuffer(&bd, &InitData, &_pGroundPlaneIndexBuffer);
+    InitData.pSysMem = indices.data();
 
-    if (FAILED(hr))
-        return hr;
-
-    return S_OK;
+    return _pd3dDevice->CreateBuffer(&bd, &InitData, &_pGroundPlaneIndexBuffer);
 }
 
-HRESULT Application::InitPlaneVertexBuffer(UINT width, UINT depth, UINT Wverts, UINT Dverts)
+HRESULT Application::InitPlaneVertexBuffer(float width, float depth, UINT widthVerts, UINT depthVerts)
 {
-    HRESULT hr;
-    D3D11_BUFFER_DESC bd;
-    D3D11_SUBRESOURCE_DATA InitData;
-
-    float vCount = Wverts * Dverts;
-
-    float hWidth = 0.5 * width;
-    float hDepth = 0.5 * depth;
-
-    float dx = width / (Wverts - 1);
-    float dz = depth / (Dverts - 1);
-
-    float du = 1.0f / (Wverts - 1);
-    float dv = 1.0f / (Dverts - 1);
-
-
-    SimpleVertexNormal* vertices = new SimpleVertexNormal[vCount];
-
-    for (UINT i = 0; i < Wverts; ++i)
-    {
-        float z = hDepth - i * dz;
-        for (UINT j = 0; j < Dverts; ++j)
-        {
-            float x = -hWidth + j * dx;
-            vertices[i * Dverts + j].Pos = XMFLOAT3(x, 0, z);
-            vertices[i * Dverts + j].normal = XMFLOAT4(0, -1, 0, 0);
-            // Ignore for now, used for texturing.
-            vertices[i * Dverts + j].TexC.x = j * du;
-            vertices[i * Dverts + j].TexC.y = i * dv;
-
-        }
-    }
+    MeshVector<SimpleVertexNormal> vertices;
+    GeneratePlaneVertices(width, depth, widthVerts, depthVerts, vertices);
 
+    D3D11_BUFFER_DESC bd;
     ZeroMemory(&bd, sizeof(bd));
-
     bd.Usage = D3D11_USAGE_DEFAULT;
-    bd.ByteWidth = sizeof(SimpleVertexNormal) * vCount;
-    bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+    bd.ByteWidth = sizeof(SimpleVertexNormal) * (UINT)vertices.size();
+    bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
     bd.CPUAccessFlags = 0;
 
+    D3D11_SUBRESOURCE_DATA InitData;
     ZeroMemory(&InitData, sizeof(InitData));
-    InitData.pSysMem = vertices;
-    hr = _pd3dDevice->CreateBuffer(&bd, &InitData, &_pGroundPlaneVertexBuffer);
-
-    if (FAILED(hr))
-        return hr;
+    InitData.pSysMem = vertices.data();
 
-    return S_OK;
+    return _pd3dDevice->CreateBuffer(&bd, &InitData, &_pGroundPlaneVertexBuffer);
 }
 
 HRESULT Application::InitWindow(HINSTANCE hInstance, int nCmdShow)
@@ -573,38 +727,109 @@ HRESULT Application::InitWindow(HINSTANCE hInstance, int nCmdShow)
 
 HRESULT Application::CompileShaderFromFile(WCHAR* szFileName, LPCSTR szEntryPoint, LPCSTR szShaderModel, ID3DBlob** ppBlobOut)
 {
-    HRESULT hr = S_OK;
-
-    DWORD dwShaderFlags = D3DCOMPILE_ENABLE_STRICTNESS;
-#if defined(DEBUG) || defined(_DEBUG)
-    // Set the D3DCOMPILE_DEBUG flag to embed debug information in the shaders.
-    // Setting this flag improves the shader debugging experience, but still allows 
-    // the shaders to be optimized and to run exactly the way they will run in 
-    // the release configuration of this program.
-    dwShaderFlags |= D3DCOMPILE_DEBUG;
-#endif
+    // Only compiles when the cache has no up to date bytecode, errors go to the debug output
+    return _shaderCache.GetShader(szFileName, szEntryPoint, szShaderModel, nullptr, ShaderCompileFlags(), ppBlobOut);
+}
 
-    ID3DBlob* pErrorBlob;
-    hr = D3DCompileFromFile(szFileName, nullptr, nullptr, szEntryPoint, szShaderModel, 
-        dwShaderFlags, 0, ppBlobOut, &pErrorBlob);
+HRESULT Application::BuildShaders()
+{
+    struct ShaderEntry
+    {
+        const char* entryPoint;
+        const char* target;
+    };
 
-    if (FAILED(hr))
+    // Entry points InitShadersAndInputLayout compiles without permutations
+    const ShaderEntry shaders[] =
     {
-        if (pErrorBlob != nullptr)
-            OutputDebugStringA((char*)pErrorBlob->GetBufferPointer());
+        { "VS", "vs_4_0" },
+    };
 
-        if (pErrorBlob) pErrorBlob->Release();
+    ShaderCache cache;
+    cache.SetDirectory(SHADER_CACHE_DIRECTORY);
 
-        return hr;
+    for (const ShaderEntry& shader : shaders)
+    {
+        HRESULT hr = cache.BuildShader(L"DX11 Framework.fx", shader.entryPoint, shader.target, nullptr, ShaderCompileFlags());
+
+        if (FAILED(hr))
+            return hr;
     }
 
-    if (pErrorBlob) pErrorBlob->Release();
+    // and every permutation the materials ask for
+    JobSystem jobs;
+    jobs.Init();
+
+    ShaderPermutations permutations;
+    permutations.Init(&cache, &jobs, L"DX11 Framework.fx", ShaderCompileFlags());
+
+    UINT crate, ground, feedback, fullscreen, lighting, upscale;
+    RequestMaterialShaders(permutations, &crate, &ground, &feedback);
+    RequestDeferredShaders(permutations, &crate, &ground, &fullscreen, &lighting);
+    RequestUpscaleShaders(permutations, &fullscreen, &upscale);
+
+    return permutations.CompileRequested(nullptr);
+}
+
+HRESULT Application::PackMaterialTextures(bool force)
+{
+    if (!force && !IsChannelPackedTextureStale(CRATE_MATERIAL_TEXTURE, CRATE_MATERIAL_CHANNELS))
+        return S_OK;
+
+    return WriteChannelPackedTexture(CRATE_MATERIAL_TEXTURE, CRATE_MATERIAL_CHANNELS);
+}
+
+HRESULT Application::InitRhiObjects()
+{
+    if (!_pVertexBuffer || !_pIndexBuffer || !_pPyramidVertexBuffer || !_pPyramidIndexBuffer || !_rhiVertexShader)
+        return E_FAIL;
+
+    UINT stride = sizeof(SimpleVertexNormal);
+    _rhiConstantBuffer = _rhiDevice.WrapBuffer(_pConstantBuffer, RHI_BUFFER_CONSTANT, 0);
+    _cubeMesh = { _rhiDevice.WrapBuffer(_pVertexBuffer, RHI_BUFFER_VERTEX, stride),
+                  _rhiDevice.WrapBuffer(_pIndexBuffer, RHI_BUFFER_INDEX, sizeof(WORD)), 36 };
+    _pyramidMesh = { _rhiDevice.WrapBuffer(_pPyramidVertexBuffer, RHI_BUFFER_VERTEX, stride),
+                     _rhiDevice.WrapBuffer(_pPyramidIndexBuffer, RHI_BUFFER_INDEX, sizeof(WORD)), 18 };
+    _groundMesh = { _rhiDevice.WrapBuffer(_pGroundPlaneVertexBuffer, RHI_BUFFER_VERTEX, stride),
+                    _rhiDevice.WrapBuffer(_pGroundPlaneIndexBuffer, RHI_BUFFER_INDEX, sizeof(WORD)), _groundPlaneIndexCount };
+
+    // Same layout and rasteriser state as the ones InitDevice makes for the other passes
+    RhiPipelineStateDesc desc = {};
+    desc.VertexShader = _rhiVertexShader;
+    desc.Elements[0] = { "POSITION", 0, RHI_FORMAT_R32G32B32_FLOAT, RHI_APPEND_ALIGNED };
+    desc.Elements[1] = { "NORMAL", 0, RHI_FORMAT_R32G32B32A32_FLOAT, RHI_APPEND_ALIGNED };
+    desc.Elements[2] = { "TEXCOORD", 0, RHI_FORMAT_R32G32_FLOAT, RHI_APPEND_ALIGNED };
+    desc.Elements[3] = { "TANGENT", 0, RHI_FORMAT_R32G32B32A32_FLOAT, RHI_APPEND_ALIGNED };
+    desc.ElementCount = 4;
+    desc.Fill = RHI_FILL_SOLID;
+    desc.Cull = RHI_CULL_NONE;
+    desc.DepthClip = false;
+    desc.DepthTest = true;
+    desc.DepthWrite = true;
+
+    bool deferred = _renderPath == RENDER_PATH_DEFERRED;
+    UINT pixelShaders[3] = { deferred ? _crateGBufferShader : _crateShader, _feedbackShader,
+                             deferred ? _groundGBufferShader : _groundShader };
+    RhiPipelineState** pipelines[3] = { &_bodyPipeline, &_groundFeedbackPipeline, &_groundPipeline };
+
+    for (int i = 0; i < 3; ++i)
+    {
+        // The pipeline state holds on to the shader, the wrapper isn't needed after
+        desc.PixelShader = _rhiDevice.WrapPixelShader(_shaderPermutations.GetPixelShader(pixelShaders[i]));
+        *pipelines[i] = _rhiDevice.CreatePipelineState(desc);
+        delete desc.PixelShader;
+
+        if (!*pipelines[i])
+            return E_FAIL;
+    }
 
     return S_OK;
 }
 
 HRESULT Application::InitDevice()
 {
+    CPU_PROFILE_FUNCTION();
+
     HRESULT hr = S_OK;
 
     UINT createDeviceFlags = 0;
@@ -631,20 +856,6 @@ HRESULT Application::InitDevice()
 
 	UINT numFeatureLevels = ARRAYSIZE(featureLevels);
 
-    DXGI_SWAP_CHAIN_DESC sd;
-    ZeroMemory(&sd, sizeof(sd));
-    sd.BufferCount = 1;
-    sd.BufferDesc.Width = _WindowWidth;
-    sd.BufferDesc.Height = _WindowHeight;
-    sd.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-    sd.BufferDesc.RefreshRate.Numerator = 60;
-    sd.BufferDesc.RefreshRate.Denominator = 1;
-    sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-    sd.OutputWindow = _hWnd;
-    sd.SampleDesc.Count = 1;
-    sd.SampleDesc.Quality = 0;
-    sd.Windowed = TRUE;
-
     D3D11_TEXTURE2D_DESC depthStencilDesc;
 
     depthStencilDesc.Width = _WindowWidth;
@@ -659,11 +870,18 @@ HRESULT Application::InitDevice()
     depthStencilDesc.CPUAccessFlags = 0;
     depthStencilDesc.MiscFlags = 0;
  
+    // an explicit driver type is the only one tried
+    if (_requestedDriverType != D3D_DRIVER_TYPE_UNKNOWN)
+    {
+        driverTypes[0] = _requestedDriverType;
+        numDriverTypes = 1;
+    }
+
     for (UINT driverTypeIndex = 0; driverTypeIndex < numDriverTypes; driverTypeIndex++)
     {
         _driverType = driverTypes[driverTypeIndex];
-        hr = D3D11CreateDeviceAndSwapChain(nullptr, _driverType, nullptr, createDeviceFlags, featureLevels, numFeatureLevels,
-                                           D3D11_SDK_VERSION, &sd, &_pSwapChain, &_pd3dDevice, &_featureLevel, &_pImmediateContext);
+        hr = D3D11CreateDevice(nullptr, _driverType, nullptr, createDeviceFlags, featureLevels, numFeatureLevels,
+                               D3D11_SDK_VERSION, &_pd3dDevice, &_featureLevel, &_pImmediateContext);
         if (SUCCEEDED(hr))
             break;
     }
@@ -671,12 +889,45 @@ HRESULT Application::InitDevice()
     if (FAILED(hr))
         return hr;
 
-    // Create a render target view
+    // Everything after this goes through the capture context, which holds the real one. it
+    // counts every frame's draws, binds and uploads, and captures them when asked to
+    _captureContext = new CaptureContext(_pImmediateContext);
+    _pImmediateContext->Release();
+    _pImmediateContext = _captureContext;
+    _captureContext->SetStats(&_frameStats);
+
+    if (!_captureFile.empty() && FAILED(_captureContext->Open(_captureFile.c_str(), _captureFrames)))
+        OutputDebugStringW(L"Couldn't open the API capture file\n");
+
+    _rhiDevice.Init(_pd3dDevice, _pImmediateContext);
+
+    // Create a render target view, headless draws into a texture of its own instead of a back buffer
     ID3D11Texture2D* pBackBuffer = nullptr;
-    hr = _pSwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (LPVOID*)&pBackBuffer);
+    if (_headless)
+    {
+        D3D11_TEXTURE2D_DESC targetDesc = depthStencilDesc;
+        targetDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        targetDesc.BindFlags = D3D11_BIND_RENDER_TARGET;
+        hr = _pd3dDevice->CreateTexture2D(&targetDesc, nullptr, &_headlessTarget);
 
-    if (FAILED(hr))
-        return hr;
+        if (FAILED(hr))
+            return hr;
+
+        pBackBuffer = _headlessTarget;
+        pBackBuffer->AddRef();
+    }
+    else
+    {
+        hr = _swapChain.Create(_pd3dDevice, _hWnd, _WindowWidth, _WindowHeight, _swapChainSettings);
+
+        if (FAILED(hr))
+            return hr;
+
+        hr = _swapChain.GetBackBuffer(&pBackBuffer);
+
+        if (FAILED(hr))
+            return hr;
+    }
 
     hr = _pd3dDevice->CreateRenderTargetView(pBackBuffer, nullptr, &_pRenderTargetView);
     pBackBuffer->Release();
@@ -715,9 +966,15 @@ HRESULT Application::InitDevice()
 
 	InitIndexBuffer();
 
-    InitPlaneVertexBuffer(10, 10, 11, 11);
+    hr = InitPlaneVertexBuffer(10, 10, 11, 11);
 
-    InitPlaneIndexBuffer(11,11);
+    if (FAILED(hr))
+        return hr;
+
+    hr = InitPlaneIndexBuffer(11, 11);
+
+    if (FAILED(hr))
+        return hr;
 
     // Set primitive topology
     _pImmediateContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
@@ -748,35 +1005,276 @@ HRESULT Application::InitDevice()
     hr = _pd3dDevice->CreateRasterizerState(&soliddesc, &_solidObj);
     _pImmediateContext->RSSetState(_solidObj);
 
-    return S_OK;
+    return InitRhiObjects();
+}
+
+// Cleanup runs again from the destructor after a failed Initialise, so everything it
+// releases is cleared as it goes
+template <class T>
+static void ReleaseObject(T*& object)
+{
+    if (object) object->Release();
+    object = nullptr;
+}
+
+template <class T>
+static void DeleteObject(T*& object)
+{
+    delete object;
+    object = nullptr;
+}
+
+static void DeleteMesh(RhiMesh& mesh)
+{
+    DeleteObject(mesh.VertexBuffer);
+    DeleteObject(mesh.IndexBuffer);
 }
 
 void Application::Cleanup()
 {
     if (_pImmediateContext) _pImmediateContext->ClearState();
-    if (_pConstantBuffer) _pConstantBuffer->Release();
-    if (_pVertexBuffer) _pVertexBuffer->Release();
-    if (_pIndexBuffer) _pIndexBuffer->Release();
-    if (_pVertexLayout) _pVertexLayout->Release();
-    if (_pVertexShader) _pVertexShader->Release();
-    if (_pPixelShader) _pPixelShader->Release();
-    if (_pRenderTargetView) _pRenderTargetView->Release();
-    if (_pSwapChain) _pSwapChain->Release();
-    if (_pImmediateContext) _pImmediateContext->Release();
-    if (_pd3dDevice) _pd3dDevice->Release();
-    if (_depthStencilView) _depthStencilView->Release();
-    if (_depthStencilBuffer) _depthStencilBuffer->Release();
-    if (_wireFrame) _wireFrame->Release();
+    DeleteObject(_bodyPipeline);
+    DeleteObject(_groundFeedbackPipeline);
+    DeleteObject(_groundPipeline);
+    DeleteMesh(_cubeMesh);
+    DeleteMesh(_pyramidMesh);
+    DeleteMesh(_groundMesh);
+    DeleteObject(_rhiConstantBuffer);
+    DeleteObject(_rhiVertexShader);
+    ReleaseObject(_pConstantBuffer);
+    ReleaseObject(_pVertexBuffer);
+    ReleaseObject(_pPyramidVertexBuffer);
+    ReleaseObject(_pGroundPlaneVertexBuffer);
+    ReleaseObject(_pIndexBuffer);
+    ReleaseObject(_pPyramidIndexBuffer);
+    ReleaseObject(_pGroundPlaneIndexBuffer);
+    ReleaseObject(_pVertexLayout);
+    ReleaseObject(_pVertexShader);
+    ReleaseObject(_pSamplerLinear);
+    _shaderPermutations.Release();
+    ReleaseObject(_pRenderTargetView);
+    ReleaseObject(_headlessTarget);
+    _swapChain.Release();
+    ReleaseObject(_depthStencilView);
+    ReleaseObject(_depthStencilBuffer);
+    ReleaseObject(_wireFrame);
+    ReleaseObject(_solidObj);
+    _texturePacker.Release();
+    _terrainTexture.Release();
+    _clusteredLighting.Release();
+    _gBuffer.Release();
+    _shadowMap.Release();
+    _dynamicResolution.Release();
+    if (!_gpuProfileFile.empty())
+        _gpuProfiler.WriteReport(_gpuProfileFile.c_str());
+    _gpuProfiler.Release();
+    _jobSystem.Shutdown();
+
+#ifdef _DEBUG
+    if (s_allocHookInstalled)
+    {
+        _CrtSetAllocHook(s_previousAllocHook);
+        s_allocHookInstalled = false;
+    }
+#endif
+
+    if (_frameArena.GetFrame() > 0)
+    {
+        wchar_t line[256];
+        swprintf_s(line, L"Frame arena: %llu frames, peak %llu of %llu bytes, %llu overflow allocations, %llu leaked, "
+                         L"%llu frames allocated from the heap\n", _frameArena.GetFrame(), (UINT64)_frameArena.GetPeakBytes(),
+                   (UINT64)_frameArena.GetBytesPerFrame(), _frameArena.GetOverflowAllocations(), _frameArena.GetLeakedAllocations(),
+                   _allocationFrames);
+        OutputDebugStringW(line);
+    }
+    _frameArena.Release();
+
+    // The device goes last, anything still holding a reference to it after this is a leak
+    ReleaseDevice();
+
+    OutputDebugStringA(MemoryTracker::FormatReport().c_str());
+
+    if (!_cpuProfileFile.empty() && CpuProfiler::IsRecording())
+    {
+        CpuProfiler::Stop();
+        CpuProfiler::WriteChromeTrace((_cpuProfileFile + L".json").c_str());
+        CpuProfiler::WriteBinary((_cpuProfileFile + L".cpuprof").c_str());
+        OutputDebugStringA(CpuProfiler::FormatSummary().c_str());
+    }
+
+    if (_frameScheduler.GetRecordedFrames() > 0)
+        OutputDebugStringA(_frameScheduler.FormatReport("frame times").c_str());
+
+    if (_frameStats.GetFrameCount() > 0)
+        OutputDebugStringA(_frameStats.FormatReport().c_str());
+    _frameStats.Close();
+}
+
+void Application::ReleaseDevice()
+{
+    if (!_pd3dDevice)
+        return;
+
+    // Only there with the debug layer, it can name whatever is left
+    ID3D11Debug* debug = nullptr;
+    _pd3dDevice->QueryInterface(__uuidof(ID3D11Debug), (void**)&debug);
+
+    if (_pImmediateContext)
+    {
+        _pImmediateContext->Flush();
+        _pImmediateContext->Release();
+        _pImmediateContext = nullptr;
+        _captureContext = nullptr;
+    }
+
+    ULONG references = _pd3dDevice->Release();
+    _pd3dDevice = nullptr;
+
+    if (debug)
+    {
+        // The debug interface holds the last reference of a clean shutdown
+        if (references > 1)
+        {
+            wchar_t line[128];
+            swprintf_s(line, L"d3d: device still has %u references after cleanup\n", references - 1);
+            OutputDebugStringW(line);
+            debug->ReportLiveDeviceObjects(D3D11_RLDO_DETAIL | D3D11_RLDO_IGNORE_INTERNAL);
+        }
+        debug->Release();
+    }
+    else if (references > 0)
+    {
+        wchar_t line[128];
+        swprintf_s(line, L"d3d: device still has %u references after cleanup\n", references);
+        OutputDebugStringW(line);
+    }
+}
+
+// rough on-screen area in pixels of a mesh with the given local radius
+static float ProjectedArea(const XMFLOAT4X4& world, const XMFLOAT4X4& view, const XMFLOAT4X4& projection, float radius, float screenHeight)
+{
+    XMMATRIX worldMatrix = XMLoadFloat4x4(&world);
+    XMVECTOR centre = XMVector3TransformCoord(XMVectorZero(), worldMatrix * XMLoadFloat4x4(&view));
+    float scale = XMVectorGetX(XMVector3Length(worldMatrix.r[0]));
+    float depth = max(XMVectorGetZ(centre), 0.01f);
+    float pixels = radius * scale * projection._22 * 0.5f * screenHeight / depth;
+    return XM_PI * pixels * pixels;
+}
+
+void Application::UpdateTextureResidency()
+{
+    CPU_PROFILE_FUNCTION();
+
+    FrameArenaVector<ResidencyChange> changes{ FrameAllocator<ResidencyChange>(&_frameArena) };
+    _textureResidency.EndFrame(changes);
+
+    for (const ResidencyChange& change : changes)
+    {
+        UINT group = 0;
+        while (group < _groupResidency.size() && _groupResidency[group] != change.Unit)
+            ++group;
+
+        if (group == _groupResidency.size() ||
+            FAILED(_texturePacker.ReloadGroup(_pd3dDevice, _pImmediateContext, group, change.NewTopMip)))
+        {
+            _textureResidency.SetTopMip(change.Unit, change.OldTopMip);
+        }
+    }
+}
+
+void Application::DrawDeferredLighting()
+{
+    CPU_PROFILE_FUNCTION();
+
+    _pImmediateContext->OMSetRenderTargets(1, &_sceneTarget, nullptr);
+
+    // The G-buffer only keeps what varies per pixel, the light and the shared
+    // material terms come from the constant buffer
+    ConstantBuffer cb;
+    ZeroMemory(&cb, sizeof(cb));
+    cb.mView = XMMatrixTranspose(XMLoadFloat4x4(&_view));
+    cb.mProjection = XMMatrixTranspose(XMLoadFloat4x4(&_projection));
+
+    cb.LightVecW = SUN_DIRECTION;
+    cb.EyePosW = { 0, 0, 25 };
+    cb.AmbientMtrl = { 1,.2,.2,.2 };
+    cb.AmbientLight = { 1,.2,.2,.2 };
+    cb.DiffuseMtrl = { 1,.5,.4,.1 };
+    cb.DiffuseLight = { 0,0,0,1 };
+    _pImmediateContext->UpdateSubresource(_pConstantBuffer, 0, nullptr, &cb, 0, 0);
+
+    _gBuffer.BindForLighting(_pImmediateContext, _view, _projection);
+    _clusteredLighting.Bind(_pImmediateContext);
+
+    _pImmediateContext->VSSetShader(_shaderPermutations.GetVertexShader(_fullscreenShader), nullptr, 0);
+    _pImmediateContext->PSSetShader(_shaderPermutations.GetPixelShader(_deferredLightingShader), nullptr, 0);
+    _pImmediateContext->Draw(3, 0);
+
+    _gBuffer.EndLighting(_pImmediateContext);
+    _pImmediateContext->OMSetRenderTargets(1, &_sceneTarget, _sceneDepth);
+}
+
+bool Application::WaitForNextFrame()
+{
+    CPU_PROFILE_FUNCTION();
+
+    // nothing on screen, tick slowly instead of spinning on a swap chain that won't block
+    bool idle = IsIconic(_hWnd) || _occluded;
+    _frameScheduler.SetThrottled(idle);
+
+    if (!_frameScheduler.WaitForNextFrame())
+        return false;
+
+    if (!idle)
+        _swapChain.WaitForNextFrame();
+
+    return true;
+}
+
+void Application::BeginAllocationCheck()
+{
+#ifdef _DEBUG
+    s_frameAllocations.store(0, memory_order_relaxed);
+    s_countAllocations.store(true, memory_order_relaxed);
+#endif
+}
+
+void Application::EndAllocationCheck()
+{
+#ifdef _DEBUG
+    s_countAllocations.store(false, memory_order_relaxed);
+    UINT allocations = s_frameAllocations.exchange(0, memory_order_relaxed);
+
+    if (allocations && _frameArena.GetFrame() >= ALLOCATION_CHECK_WARMUP)
+    {
+        // An allocation every frame would otherwise flood the output
+        if (_allocationFrames++ < ALLOCATION_CHECK_REPORTS)
+        {
+            wchar_t line[128];
+            swprintf_s(line, L"Frame %llu: %u heap allocations in Update/Draw\n", _frameArena.GetFrame(), allocations);
+            OutputDebugStringW(line);
+        }
+    }
+#endif
 }
 
 void Application::Update()
 {
-    // Update our time
-    static float t = 0.0f;
+    CPU_PROFILE_FUNCTION();
+
+    // Everything the last frame but one put in the arena goes
+    _frameArena.BeginFrame();
+    BeginAllocationCheck();
 
-    if (_driverType == D3D_DRIVER_TYPE_REFERENCE)
+    // Update our time
+    if (_fixedTimestep > 0.0f)
+    {
+        // the same tenth of a unit per second the tick count gives
+        _time += _fixedTimestep * 0.1f;
+    }
+    else if (_driverType == D3D_DRIVER_TYPE_REFERENCE)
     {
-        t += (float) XM_PI * 0.0125f;
+        _time += (float) XM_PI * 0.0125f;
     }
     else
     {
@@ -786,58 +1284,224 @@ void Application::Update()
         if (dwTimeStart == 0)
             dwTimeStart = dwTimeCur;
 
-        t = (dwTimeCur - dwTimeStart) / 10000.0f;
+        _time = (dwTimeCur - dwTimeStart) / 10000.0f;
     }
 
+    float t = _time;
+
     //
     // Animate
     //
-    XMMATRIX sun = XMMatrixIdentity();
-    sun = XMMatrixMultiply(sun, XMMatrixScaling(3,3,3) * XMMatrixTranslation(0, 0, 0) * XMMatrixRotationRollPitchYaw(t*10, t*10, t*10));
-    XMStoreFloat4x4(&_worldMatrices[0], sun);
-
-    XMMATRIX mars = XMMatrixIdentity();
-    mars = XMMatrixMultiply(mars, XMMatrixRotationRollPitchYaw(t * 4, 0, 0) * XMMatrixScaling(.6, .6, .6) * 
-    XMMatrixTranslation(6, 0, 0) * XMMatrixRotationRollPitchYaw(0, t*5, 0));
-    XMStoreFloat4x4(&_worldMatrices[1], mars);
-
-    XMMATRIX earth = XMMatrixIdentity();
-    earth = XMMatrixMultiply(earth, XMMatrixRotationRollPitchYaw(0, 0, t * 6) * XMMatrixScaling(.8, .8, .8) * 
-    XMMatrixTranslation(9, 0, 0) * XMMatrixRotationRollPitchYaw(0, t * 3.5, 0));
-    XMStoreFloat4x4(&_worldMatrices[2], earth);
-
-    XMMATRIX earthMoon = XMMatrixIdentity();
-    //translation are done backwards, so you would read the first to be the last
-    //scale the moon translate the moon to its position relative to the earth, allow the moon to rotate around the earth, 
-    //translate the mmon to the position of the eath and allow the same rotation (so it follows the earths rotatrion around the sun)
-    earthMoon = XMMatrixMultiply(earthMoon, XMMatrixScaling(.125, .125, .125) * XMMatrixTranslation(3,0,0) * 
-    XMMatrixRotationRollPitchYaw(0, t*2, t * 3) * XMMatrixTranslation(9, 0, 0) * XMMatrixRotationRollPitchYaw(0, t * 3.5, 0));
-    XMStoreFloat4x4(&_worldMatrices[3], earthMoon);
-
-    XMMATRIX marsMoon = XMMatrixIdentity();
-    marsMoon = XMMatrixMultiply(marsMoon, XMMatrixScaling(.1, .1, .1) * XMMatrixTranslation(3, 0, 0) * 
-    XMMatrixRotationRollPitchYaw(0, t * 2, t * 4) * XMMatrixTranslation(6, 0, 0) * XMMatrixRotationRollPitchYaw(0, t * 5, 0));
-    XMStoreFloat4x4(&_worldMatrices[4], marsMoon);
+    AnimateBodies(t, (float*)_worldMatrices.data(), (UINT)_worldMatrices.size());
 
     XMMATRIX floor = XMMatrixIdentity();
     floor = XMMatrixMultiply(floor, XMMatrixScaling(3, 3, 3) * XMMatrixTranslation(0, -8, 0));
     XMStoreFloat4x4(&_groundPlaneMatrix, floor);
+
+    for (UINT i = 0; i < _pointLights.size(); ++i)
+    {
+        float angle = i * XM_2PI / _pointLights.size() + t * (1.0f + (i % 3));
+        float radius = 4.0f + (i % 9);
+        _pointLights[i].Position = XMFLOAT3(radius * cosf(angle), 6.0f * sinf(angle * 2.0f + i), radius * sinf(angle));
+    }
+}
+
+// world space bounding sphere of a mesh with the given local radius
+static void CasterBounds(const XMFLOAT4X4& world, float radius, XMFLOAT3* centre, float* worldRadius)
+{
+    XMMATRIX worldMatrix = XMLoadFloat4x4(&world);
+    XMStoreFloat3(centre, worldMatrix.r[3]);
+    *worldRadius = radius * XMVectorGetX(XMVector3Length(worldMatrix.r[0]));
+}
+
+void Application::DrawShadowMaps()
+{
+    CPU_PROFILE_FUNCTION();
+
+    _shadowMap.Update(_view, _projection, SUN_DIRECTION);
+
+    XMFLOAT3 groundCentre;
+    float groundRadius;
+    CasterBounds(_groundPlaneMatrix, 7.07f, &groundCentre, &groundRadius);
+
+    UINT stride = sizeof(SimpleVertexNormal);
+    UINT offset = 0;
+
+    // The shadow pass doesn't go through a pipeline state, so it binds its own input
+    // layout and topology rather than drawing with whatever the last frame left bound
+    _pImmediateContext->IASetInputLayout(_pVertexLayout);
+    _pImmediateContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    _pImmediateContext->VSSetShader(_pVertexShader, nullptr, 0);
+    _pImmediateContext->VSSetConstantBuffers(0, 1, &_pConstantBuffer);
+    _pImmediateContext->PSSetShader(nullptr, nullptr, 0);
+
+    for (UINT cascade = 0; cascade < _shadowMap.GetCascadeCount(); ++cascade)
+    {
+        // The bodies move every frame, the ground never does
+        _shadowCasters.resize(_worldMatrices.size());
+        bool dynamicCasters = false;
+        for (UINT i = 0; i < _worldMatrices.size(); i++)
+        {
+            XMFLOAT3 centre;
+            float radius;
+            CasterBounds(_worldMatrices[i], 1.732f, &centre, &radius);
+            _shadowCasters[i] = _shadowMap.IsCasterInCascade(cascade, centre, radius);
+            dynamicCasters |= _shadowCasters[i];
+        }
+
+        if (!_shadowMap.NeedsRender(cascade, dynamicCasters))
+            continue;
+
+        _shadowMap.BeginCascade(_pImmediateContext, cascade);
+
+        ConstantBuffer cb;
+        ZeroMemory(&cb, sizeof(cb));
+        XMFLOAT4X4 cascadeView = _shadowMap.GetCascadeView(cascade);
+        XMFLOAT4X4 cascadeProjection = _shadowMap.GetCascadeProjection(cascade);
+        cb.mView = XMMatrixTranspose(XMLoadFloat4x4(&cascadeView));
+        cb.mProjection = XMMatrixTranspose(XMLoadFloat4x4(&cascadeProjection));
+
+        for (UINT i = 0; i < _worldMatrices.size(); i++)
+        {
+            if (!_shadowCasters[i])
+                continue;
+
+            cb.mWorld = XMMatrixTranspose(XMLoadFloat4x4(&_worldMatrices[i]));
+            _pImmediateContext->UpdateSubresource(_pConstantBuffer, 0, nullptr, &cb, 0, 0);
+
+            if (i >= 2)
+            {
+                _pImmediateContext->IASetVertexBuffers(0, 1, &_pPyramidVertexBuffer, &stride, &offset);
+                _pImmediateContext->IASetIndexBuffer(_pPyramidIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
+                _pImmediateContext->DrawIndexed(18, 0, 0);
+            }
+            else
+            {
+                _pImmediateContext->IASetVertexBuffers(0, 1, &_pVertexBuffer, &stride, &offset);
+                _pImmediateContext->IASetIndexBuffer(_pIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
+                _pImmediateContext->DrawIndexed(36, 0, 0);
+            }
+        }
+
+        if (_shadowMap.IsCasterInCascade(cascade, groundCentre, groundRadius))
+        {
+            cb.mWorld = XMMatrixTranspose(XMLoadFloat4x4(&_groundPlaneMatrix));
+            _pImmediateContext->UpdateSubresource(_pConstantBuffer, 0, nullptr, &cb, 0, 0);
+            _pImmediateContext->IASetVertexBuffers(0, 1, &_pGroundPlaneVertexBuffer, &stride, &offset);
+            _pImmediateContext->IASetIndexBuffer(_pGroundPlaneIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
+            _pImmediateContext->DrawIndexed(_groundPlaneIndexCount, 0, 0);
+        }
+
+        _shadowMap.EndCascade(_pImmediateContext, cascade, dynamicCasters);
+    }
+
+    // Back to the scene target
+    _pImmediateContext->RSSetViewports(1, &_sceneViewport);
+    _pImmediateContext->OMSetRenderTargets(1, &_sceneTarget, _sceneDepth);
 }
 
 void Application::Draw()
 {
+    CPU_PROFILE_FUNCTION();
+
+    // Update started the allocation check, it has to end on every way out of here
+    if (IsIconic(_hWnd))
+    {
+        EndAllocationCheck();
+        return;
+    }
+
+    if (_occluded)
+    {
+        _occluded = _swapChain.TestPresent() == DXGI_STATUS_OCCLUDED;
+        EndAllocationCheck();
+        return;
+    }
+
+    if (_captureContext)
+        _captureContext->BeginFrame();
+
+    _frameStats.BeginFrame();
+    _gpuProfiler.BeginFrame(_pImmediateContext);
+
+    // With dynamic resolution the scene goes into the corner of an offscreen target
+    // and is stretched over the back buffer at the end
+    if (_dynamicResolutionEnabled)
+    {
+        _dynamicResolution.BeginFrame(_pImmediateContext);
+        _sceneTarget = _dynamicResolution.GetSceneTarget();
+        _sceneDepth = _dynamicResolution.GetSceneDepth();
+        _sceneViewport = _dynamicResolution.GetSceneViewport();
+        _clusteredLighting.SetViewportScale(_dynamicResolution.GetScale());
+    }
+    else
+    {
+        _sceneTarget = _pRenderTargetView;
+        _sceneDepth = _depthStencilView;
+        _sceneViewport.Width = (FLOAT)_WindowWidth;
+        _sceneViewport.Height = (FLOAT)_WindowHeight;
+        _sceneViewport.MinDepth = 0.0f;
+        _sceneViewport.MaxDepth = 1.0f;
+        _sceneViewport.TopLeftX = 0;
+        _sceneViewport.TopLeftY = 0;
+    }
+
+    _gpuProfiler.BeginScope(_pImmediateContext, "Shadows");
+    DrawShadowMaps();
+    _gpuProfiler.EndScope(_pImmediateContext);
+    MarkBenchmarkStage(BENCHMARK_SHADOWS);
+
+    _gpuProfiler.BeginScope(_pImmediateContext, "Scene");
+
     //
     // Clear the back buffer
     //
     float ClearColor[4] = { 0.0f, 0.125f, 0.3f, 1.0f }; // red,green,blue,alpha
-    _pImmediateContext->ClearRenderTargetView(_pRenderTargetView, ClearColor);
-    _pImmediateContext->ClearDepthStencilView(_depthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+    _pImmediateContext->ClearRenderTargetView(_sceneTarget, ClearColor);
+    _pImmediateContext->ClearDepthStencilView(_sceneDepth, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+
+    // The deferred path draws the scene into the G-buffer and lights it at the end
+    bool deferred = _renderPath == RENDER_PATH_DEFERRED;
+    if (deferred)
+        _gBuffer.Begin(_pImmediateContext);
+
+    const MaterialTexture& crate = _texturePacker.GetMaterialTexture(_crateTexture);
+    const MaterialTexture& crateMaterial = _texturePacker.GetMaterialTexture(_crateMaterialTexture);
+    ID3D11ShaderResourceView* textureArray = _texturePacker.GetGroupView(crate.Group);
+    ID3D11ShaderResourceView* materialArray = _texturePacker.GetGroupView(crateMaterial.Group);
+
+    // Bound once for the whole pass, each draw picks its slice through the constant buffer
+    _pImmediateContext->PSSetSamplers(0, 1, &_pSamplerLinear);
+    _pImmediateContext->PSSetShaderResources(0, 1, &textureArray);
+    _pImmediateContext->PSSetShaderResources(9, 1, &materialArray);
+    _shadowMap.Bind(_pImmediateContext);
+
+    // Bin the point lights for this frame's camera
+    {
+        CPU_PROFILE_SCOPE("Light binning");
+        _gpuProfiler.BeginScope(_pImmediateContext, "Light upload");
+        _clusteredLighting.Update(_pImmediateContext, _pointLights, _view, _projection, &_jobSystem);
+        _clusteredLighting.Bind(_pImmediateContext);
+        _gpuProfiler.EndScope(_pImmediateContext);
+    }
 
-    // Set vertex buffer
-    UINT stride = sizeof(SimpleVertexNormal);
-    UINT offset = 0;
-    for (int i = 0; i < 5; i++)
+    // Bound once for the pass, the bodies only change the constants and, when it differs
+    // from the last body's, the mesh
+    RhiCommandList* commands = _rhiDevice.GetImmediateCommandList();
+    commands->SetPipelineState(_bodyPipeline);
+    commands->SetConstantBuffer(RHI_STAGE_VERTEX, 0, _rhiConstantBuffer);
+    commands->SetConstantBuffer(RHI_STAGE_PIXEL, 0, _rhiConstantBuffer);
+
+    const RhiMesh* boundMesh = nullptr;
+    _gpuProfiler.BeginScope(_pImmediateContext, "Bodies");
+    for (UINT i = 0; i < _worldMatrices.size(); i++)
     {
+        // A scope each for the named bodies, the asteroids share one however many there are
+        if (i < NAMED_BODY_COUNT)
+            _gpuProfiler.BeginScope(_pImmediateContext, BODY_NAMES[i]);
+        else if (i == NAMED_BODY_COUNT)
+            _gpuProfiler.BeginScope(_pImmediateContext, "Asteroids");
+
         XMMATRIX world = XMLoadFloat4x4(&_worldMatrices[i]);
         XMMATRIX view = XMLoadFloat4x4(&_view);
         XMMATRIX projection = XMLoadFloat4x4(&_projection);
@@ -849,7 +1513,7 @@ void Application::Draw()
         cb.mView = XMMatrixTranspose(view);
         cb.mProjection = XMMatrixTranspose(projection);
         
-        cb.LightVecW = { 0,3,25 };
+        cb.LightVecW = SUN_DIRECTION;
         cb.EyePosW = { 0, 0, 25 };
 
         //ambient is the actual colour of the object
@@ -864,32 +1528,35 @@ void Application::Draw()
         cb.SpecularLight = { 1,.8,.8,.8 };
         cb.SpecularPower = 10;
 
-        _pImmediateContext->UpdateSubresource(_pConstantBuffer, 0, nullptr, &cb, 0, 0);
-        // Renders a triangle
-        _pImmediateContext->PSSetSamplers(0, 1, &_pSamplerLinear);
-        _pImmediateContext->PSSetShaderResources(0, 1, &_pTextureRV);
-        _pImmediateContext->VSSetShader(_pVertexShader, nullptr, 0);
-        _pImmediateContext->VSSetConstantBuffers(0, 1, &_pConstantBuffer);
-        _pImmediateContext->PSSetConstantBuffers(0, 1, &_pConstantBuffer);
-        _pImmediateContext->PSSetShader(_pPixelShader, nullptr, 0);
-        if (i >= 2)
+        cb.UVTransform = crate.UVTransform;
+        cb.TextureSlice = crate.Slice;
+        cb.MaterialUVTransform = crateMaterial.UVTransform;
+        cb.MaterialSlice = crateMaterial.Slice;
+        float area = ProjectedArea(_worldMatrices[i], _view, _projection, 1.732f, (float)_WindowHeight);
+        _textureResidency.ReportUsage(_groupResidency[crate.Group], area);
+        if (crateMaterial.Group != crate.Group)
+            _textureResidency.ReportUsage(_groupResidency[crateMaterial.Group], area);
+
+        commands->UpdateBuffer(_rhiConstantBuffer, &cb, sizeof(cb));
+
+        // The first two bodies are cubes, the rest pyramids
+        const RhiMesh* mesh = i >= 2 ? &_pyramidMesh : &_cubeMesh;
+        if (mesh != boundMesh)
         {
-            // Set vertex buffer
-            _pImmediateContext->IASetVertexBuffers(0, 1, &_pPyramidVertexBuffer, &stride, &offset);
-            // Set index buffer
-            _pImmediateContext->IASetIndexBuffer(_pPyramidIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
-            _pImmediateContext->RSSetState(_solidObj);
-            _pImmediateContext->DrawIndexed(18, 0, 0);
-        }
-        else {
-            // Set vertex buffer
-            _pImmediateContext->IASetVertexBuffers(0, 1, &_pVertexBuffer, &stride, &offset);
-            // Set index buffer
-            _pImmediateContext->IASetIndexBuffer(_pIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
-            _pImmediateContext->RSSetState(_solidObj);
-            _pImmediateContext->DrawIndexed(36, 0, 0);
+            commands->SetVertexBuffer(0, mesh->VertexBuffer, 0);
+            commands->SetIndexBuffer(mesh->IndexBuffer, 0);
+            boundMesh = mesh;
         }
+
+        commands->DrawIndexed(mesh->IndexCount, 0, 0);
+
+        if (i < NAMED_BODY_COUNT)
+            _gpuProfiler.EndScope(_pImmediateContext);
     }
+    if (_worldMatrices.size() > NAMED_BODY_COUNT)
+        _gpuProfiler.EndScope(_pImmediateContext);
+    _gpuProfiler.EndScope(_pImmediateContext);
+
     XMMATRIX world = XMLoadFloat4x4(&_groundPlaneMatrix);
     XMMATRIX view = XMLoadFloat4x4(&_view);
     XMMATRIX projection = XMLoadFloat4x4(&_projection);
@@ -901,7 +1568,7 @@ void Application::Draw()
     cb1.mView = XMMatrixTranspose(view);
     cb1.mProjection = XMMatrixTranspose(projection);
 
-    cb1.LightVecW = { 0,0,0 };
+    cb1.LightVecW = SUN_DIRECTION;
     cb1.EyePosW = { 0, 0, 25 };
 
     //ambient is the actual colour of the object
@@ -916,24 +1583,190 @@ void Application::Draw()
     cb1.SpecularLight = { 1,.8,.8,.8 };
     cb1.SpecularPower = 10;
 
-    _pImmediateContext->UpdateSubresource(_pConstantBuffer, 0, nullptr, &cb1, 0, 0);
+    cb1.UVTransform = crate.UVTransform;
+    cb1.TextureSlice = crate.Slice;
+    cb1.MaterialUVTransform = crateMaterial.UVTransform;
+    cb1.MaterialSlice = crateMaterial.Slice;
+    _textureResidency.ReportUsage(_groupResidency[crate.Group],
+                                  ProjectedArea(_groundPlaneMatrix, _view, _projection, 7.07f, (float)_WindowHeight));
 
-    //
-    // Renders a triangle
-    //
+    commands->UpdateBuffer(_rhiConstantBuffer, &cb1, sizeof(cb1));
+
+    commands->SetVertexBuffer(0, _groundMesh.VertexBuffer, 0);
+    commands->SetIndexBuffer(_groundMesh.IndexBuffer, 0);
+
+    // Record which virtual texture pages the ground plane needs
+    _gpuProfiler.BeginScope(_pImmediateContext, "Ground feedback");
+    _terrainTexture.BeginFeedback(_pImmediateContext);
+    commands->SetPipelineState(_groundFeedbackPipeline);
+    commands->DrawIndexed(_groundMesh.IndexCount, 0, 0);
+    _terrainTexture.EndFeedback(_pImmediateContext);
+    _gpuProfiler.EndScope(_pImmediateContext);
+
+    _gpuProfiler.BeginScope(_pImmediateContext, "Ground");
+    _terrainTexture.Bind(_pImmediateContext);
+    commands->SetPipelineState(_groundPipeline);
+    commands->DrawIndexed(_groundMesh.IndexCount, 0, 0);
+    _gpuProfiler.EndScope(_pImmediateContext);
+
+    _gpuProfiler.EndScope(_pImmediateContext);
+    MarkBenchmarkStage(BENCHMARK_SCENE);
+
+    if (deferred)
+    {
+        GpuScope lightingScope(_gpuProfiler, _pImmediateContext, "Deferred lighting");
+        DrawDeferredLighting();
+    }
+
+    if (_dynamicResolutionEnabled)
+    {
+        GpuScope upscaleScope(_gpuProfiler, _pImmediateContext, "Upscale");
+        _dynamicResolution.Resolve(_pImmediateContext, _pRenderTargetView, _shaderPermutations.GetVertexShader(_fullscreenShader),
+                                   _shaderPermutations.GetPixelShader(_upscaleShader));
+    }
+
+    MarkBenchmarkStage(BENCHMARK_LIGHTING);
 
-    _pImmediateContext->VSSetShader(_pVertexShader, nullptr, 0);
-    _pImmediateContext->VSSetConstantBuffers(0, 1, &_pConstantBuffer);
-    _pImmediateContext->PSSetConstantBuffers(0, 1, &_pConstantBuffer);
-    _pImmediateContext->PSSetShader(_pPixelShader, nullptr, 0);
-    // Set vertex buffer
-    _pImmediateContext->IASetVertexBuffers(0, 1, &_pGroundPlaneVertexBuffer, &stride, &offset);
-    // Set index buffer
-    _pImmediateContext->IASetIndexBuffer(_pGroundPlaneIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
-    _pImmediateContext->RSSetState(_solidObj);
-    _pImmediateContext->DrawIndexed(600, 0, 0);
     //
     // Present our back buffer to our front buffer
     //
-    _pSwapChain->Present(0, 0);
-}
\ No newline at end of file
+    _gpuProfiler.BeginScope(_pImmediateContext, "Present");
+    if (!_headless)
+    {
+        CPU_PROFILE_SCOPE("Present");
+        double presentStart = _frameClock.Now();
+        _occluded = _swapChain.Present() == DXGI_STATUS_OCCLUDED;
+        _frameStats.SetPresentTime((_frameClock.Now() - presentStart) * 1000.0);
+    }
+    _gpuProfiler.EndScope(_pImmediateContext);
+    _gpuProfiler.EndFrame(_pImmediateContext);
+    _frameStats.EndFrame();
+
+    // About twice a second is plenty for a title bar
+    if (!_headless && _frameStats.GetFrameCount() % 30 == 0)
+    {
+        char title[256];
+        _frameStats.FormatOverlay(title, sizeof(title));
+        SetWindowTextA(_hWnd, title);
+    }
+    MarkBenchmarkStage(BENCHMARK_PRESENT);
+
+    UpdateTextureResidency();
+    _terrainTexture.Update(_pImmediateContext);
+    MarkBenchmarkStage(BENCHMARK_STREAMING);
+
+    if (_captureContext)
+        _captureContext->EndFrame();
+
+    EndAllocationCheck();
+}
+
+HRESULT Application::RenderHeadless(UINT frameCount, const wchar_t* outputDirectory, bool writeImages)
+{
+    if (!_headless)
+        return E_FAIL;
+
+    // The null device draws nothing, there is nothing to read back
+    bool readback = _driverType != D3D_DRIVER_TYPE_NULL;
+
+    FrameReadback frames;
+    if (readback)
+    {
+        HRESULT hr = frames.Initialise(_pd3dDevice, _WindowWidth, _WindowHeight, DXGI_FORMAT_R8G8B8A8_UNORM);
+        if (FAILED(hr))
+            return hr;
+    }
+
+    CreateDirectoryW(outputDirectory, nullptr);
+    if (writeImages)
+        frames.SetImageDirectory(outputDirectory);
+
+    LARGE_INTEGER frequency, start, end;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+
+    // Each frame is copied out as soon as it is drawn but read a few frames later
+    for (UINT frame = 0; frame < frameCount; ++frame)
+    {
+        Update();
+        Draw();
+
+        if (readback)
+        {
+            HRESULT hr = frames.Capture(_pImmediateContext, _headlessTarget, frame);
+            if (FAILED(hr))
+                return hr;
+        }
+    }
+
+    HRESULT hr = S_OK;
+    if (readback)
+    {
+        hr = frames.Flush(_pImmediateContext);
+        if (SUCCEEDED(hr))
+            hr = frames.WriteChecksums((wstring(outputDirectory) + L"\\checksums.txt").c_str());
+    }
+    else
+    {
+        _pImmediateContext->Flush();
+    }
+
+    QueryPerformanceCounter(&end);
+    double seconds = (double)(end.QuadPart - start.QuadPart) / frequency.QuadPart;
+
+    wchar_t line[256];
+    swprintf_s(line, L"headless: %u frames in %.2f s, %.1f frames/s\n", frameCount, seconds, frameCount / seconds);
+    OutputDebugStringW(line);
+
+    return hr;
+}
+
+HRESULT Application::RunBenchmark(UINT warmupFrames, UINT measuredFrames, const wchar_t* outputFile)
+{
+    if (!_headless)
+        return E_FAIL;
+
+    BenchmarkRecorder recorder;
+    for (const char* name : BENCHMARK_STAGE_NAMES)
+        recorder.AddStage(name);
+
+    // Every run starts from the same point of the animation
+    _time = 0.0f;
+    _benchmark = &recorder;
+
+    RunBenchmarkFrames(recorder, warmupFrames, measuredFrames, [this](uint32_t)
+    {
+        Update();
+        MarkBenchmarkStage(BENCHMARK_UPDATE);
+        Draw();
+    });
+
+    _benchmark = nullptr;
+    _pImmediateContext->Flush();
+
+    const char* driver = _driverType == D3D_DRIVER_TYPE_NULL ? "null" :
+                         _driverType == D3D_DRIVER_TYPE_WARP ? "warp" :
+                         _driverType == D3D_DRIVER_TYPE_REFERENCE ? "reference" : "hardware";
+
+    vector<pair<string, string>> config;
+    config.push_back(make_pair("bodies", to_string(_worldMatrices.size())));
+    config.push_back(make_pair("warmup_frames", to_string(warmupFrames)));
+    config.push_back(make_pair("measured_frames", to_string(measuredFrames)));
+    config.push_back(make_pair("timestep", to_string(_fixedTimestep)));
+    config.push_back(make_pair("width", to_string(_WindowWidth)));
+    config.push_back(make_pair("height", to_string(_WindowHeight)));
+    config.push_back(make_pair("driver", string("\"") + driver + "\""));
+    config.push_back(make_pair("render_path", _renderPath == RENDER_PATH_DEFERRED ? "\"deferred\"" : "\"forward\""));
+    config.push_back(make_pair("dynamic_resolution", _dynamicResolutionEnabled ? "true" : "false"));
+
+    if (!recorder.WriteJson(outputFile, config))
+        return E_FAIL;
+
+    wchar_t line[256];
+    swprintf_s(line, L"benchmark: %u bodies, %u frames, median %.3f ms, p99 %.3f ms\n", (UINT)_worldMatrices.size(),
+               recorder.GetMeasuredFrames(), recorder.GetPercentile(BenchmarkRecorder::FRAME, 50.0),
+               recorder.GetPercentile(BenchmarkRecorder::FRAME, 99.0));
+    OutputDebugStringW(line);
+
+    return S_OK;
+}
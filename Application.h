@@ -8,6 +8,31 @@
 #include "resource.h"
 #include <vector>
 #include "DDSTextureLoader.h"
+#include "TexturePacker.h"
+#include "TextureResidency.h"
+#include "VirtualTexture.h"
+#include "ShaderCache.h"
+#include "ShaderPermutations.h"
+#include "ClusteredLighting.h"
+#include "GBuffer.h"
+#include "Tangents.h"
+#include "MeshGeneration.h"
+#include "SceneAnimation.h"
+#include "ChannelPacking.h"
+#include "CascadedShadowMap.h"
+#include "SwapChain.h"
+#include "FrameScheduler.h"
+#include "SystemFrameClock.h"
+#include "DynamicResolution.h"
+#include "FrameCapture.h"
+#include "GpuProfiler.h"
+#include "CpuProfiler.h"
+#include "FrameStats.h"
+#include "Benchmark.h"
+#include "MemoryTracker.h"
+#include "FrameArena.h"
+#include "CaptureContext.h"
+#include "RhiD3D11.h"
 
 using namespace DirectX;
 
@@ -18,13 +43,6 @@ struct SimpleVertex
 	XMFLOAT2 TexC;
 };
 
-struct SimpleVertexNormal
-{
-	XMFLOAT3 Pos;
-	XMFLOAT4 normal;
-	XMFLOAT2 TexC;
-};
-
 struct ConstantBuffer
 {
 	XMMATRIX mWorld;
@@ -37,6 +55,8 @@ struct ConstantBuffer
 	XMFLOAT4 DiffuseLight;
 	//vector that points in the direction of a light source
 	XMFLOAT3 LightVecW;
+	//HLSL starts the next float4 on a new register
+	float LightVecPad;
 
 	XMFLOAT4 AmbientMtrl;
 	XMFLOAT4 AmbientLight;
@@ -45,6 +65,24 @@ struct ConstantBuffer
 	XMFLOAT4 SpecularLight;
 	float SpecularPower;
 	XMFLOAT3 EyePosW;
+
+	//where the material's texels live in the bound texture array
+	XMFLOAT4 UVTransform;
+	UINT TextureSlice;
+	XMFLOAT3 TexturePad;
+
+	//same for the channel packed normal/specular texture
+	XMFLOAT4 MaterialUVTransform;
+	UINT MaterialSlice;
+	XMFLOAT3 MaterialPad;
+};
+
+// a vertex and index buffer pair as the RHI sees them
+struct RhiMesh
+{
+	RhiBuffer* VertexBuffer;
+	RhiBuffer* IndexBuffer;
+	UINT IndexCount;
 };
 
 struct VertexType
@@ -53,6 +91,14 @@ struct VertexType
 	XMFLOAT4 color;
 };
 
+// forward shades each pixel as it is drawn, deferred writes a G-buffer and lights
+// every pixel once in a full screen pass afterwards
+enum RenderPath
+{
+	RENDER_PATH_FORWARD,
+	RENDER_PATH_DEFERRED,
+};
+
 using namespace std;
 class Application
 {
@@ -63,13 +109,19 @@ private:
 	D3D_FEATURE_LEVEL       _featureLevel;
 	ID3D11Device*           _pd3dDevice;
 	ID3D11DeviceContext*    _pImmediateContext;
-	IDXGISwapChain*         _pSwapChain;
+	SwapChain               _swapChain;
+	SwapChainSettings       _swapChainSettings;
+	SystemFrameClock        _frameClock;
+	FrameScheduler          _frameScheduler;
+	double                  _targetFrameRate;
+	// last present went nowhere, stop rendering until a test present says otherwise
+	bool                    _occluded;
 	ID3D11RenderTargetView* _pRenderTargetView;
 	ID3D11VertexShader*     _pVertexShader;
-	ID3D11PixelShader*      _pPixelShader;
 	ID3D11InputLayout*      _pVertexLayout;
 	ID3D11Buffer            *_pVertexBuffer, *_pPyramidVertexBuffer, *_pGroundPlaneVertexBuffer;
 	ID3D11Buffer            *_pIndexBuffer, *_pPyramidIndexBuffer, *_pGroundPlaneIndexBuffer;
+	UINT                    _groundPlaneIndexCount;
 	ID3D11Buffer*           _pConstantBuffer;
 	XMFLOAT4X4              _world;
 	XMFLOAT4X4              _view;
@@ -80,18 +132,91 @@ private:
 	ID3D11Texture2D*        _depthStencilBuffer;
 	ID3D11RasterizerState*  _wireFrame;
 	ID3D11RasterizerState*  _solidObj;
-	ID3D11ShaderResourceView* _pTextureRV;
+	JobSystem               _jobSystem;
+	TexturePacker           _texturePacker;
+	UINT                    _crateTexture;
+	UINT                    _crateMaterialTexture;
+	TextureResidencyManager _textureResidency;
+	UINT64                  _textureBudget;
+	//residency unit of each texture packer group
+	vector<UINT>            _groupResidency;
+	VirtualTexture          _terrainTexture;
+	ShaderCache             _shaderCache;
+	ShaderPermutations      _shaderPermutations;
+	UINT                    _crateShader;
+	UINT                    _groundShader;
+	UINT                    _feedbackShader;
+	ClusteredLighting       _clusteredLighting;
+	vector<PointLight>      _pointLights;
+	RenderPath              _renderPath;
+	GBuffer                 _gBuffer;
+	UINT                    _crateGBufferShader;
+	UINT                    _groundGBufferShader;
+	UINT                    _fullscreenShader;
+	UINT                    _deferredLightingShader;
+	CascadedShadowMap       _shadowMap;
+	DynamicResolution       _dynamicResolution;
+	bool                    _dynamicResolutionEnabled;
+	UINT                    _upscaleShader;
+	// where this frame's scene goes, the back buffer or the dynamic resolution target
+	ID3D11RenderTargetView* _sceneTarget;
+	ID3D11DepthStencilView* _sceneDepth;
+	D3D11_VIEWPORT          _sceneViewport;
+	bool                    _headless;
+	// stands in for the back buffer when there is no window
+	ID3D11Texture2D*        _headlessTarget;
+	D3D_DRIVER_TYPE         _requestedDriverType;
+	float                   _fixedTimestep;
+	// animation time, Update advances it
+	float                   _time;
+	// the five named bodies, anything past them is an asteroid
+	UINT                    _bodyCount;
+	vector<bool>            _shadowCasters;
+	// set while RunBenchmark is timing the frame stages
+	BenchmarkRecorder*      _benchmark;
+	GpuProfiler             _gpuProfiler;
+	wstring                 _gpuProfileFile;
+	wstring                 _cpuProfileFile;
+	FrameStats              _frameStats;
+	wstring                 _statsFile;
+	// transient per frame data, Update starts a new frame in it
+	FrameArena              _frameArena;
+	// frames past the warm up in which Update or Draw allocated from the heap (debug builds)
+	UINT64                  _allocationFrames;
+	// stands in for the immediate context while a capture is asked for, it owns the real one
+	CaptureContext*         _captureContext;
+	wstring                 _captureFile;
+	UINT                    _captureFrames;
+	// the scene pass draws through the RHI, these wrap the D3D objects above
+	D3D11RhiDevice          _rhiDevice;
+	RhiShader*              _rhiVertexShader;
+	RhiBuffer*              _rhiConstantBuffer;
+	RhiMesh                 _cubeMesh, _pyramidMesh, _groundMesh;
+	RhiPipelineState*       _bodyPipeline;
+	RhiPipelineState*       _groundFeedbackPipeline;
+	RhiPipelineState*       _groundPipeline;
 	ID3D11SamplerState* _pSamplerLinear;
 private:
 	HRESULT InitWindow(HINSTANCE hInstance, int nCmdShow);
 	HRESULT InitDevice();
 	void Cleanup();
+	// releases the context and the device and reports any references still held on it
+	void ReleaseDevice();
 	HRESULT CompileShaderFromFile(WCHAR* szFileName, LPCSTR szEntryPoint, LPCSTR szShaderModel, ID3DBlob** ppBlobOut);
 	HRESULT InitShadersAndInputLayout();
 	HRESULT InitVertexBuffer();
 	HRESULT InitIndexBuffer();
-	HRESULT InitPlaneIndexBuffer(int vWidth, int vHeight);
-	HRESULT InitPlaneVertexBuffer(UINT width, UINT depth, UINT Wverts, UINT Dverts);
+	HRESULT InitPlaneIndexBuffer(UINT widthVerts, UINT depthVerts);
+	HRESULT InitPlaneVertexBuffer(float width, float depth, UINT widthVerts, UINT depthVerts);
+	// wraps the scene's buffers and builds its pipeline states, after everything they use
+	HRESULT InitRhiObjects();
+	void UpdateTextureResidency();
+	void DrawDeferredLighting();
+	void DrawShadowMaps();
+	void MarkBenchmarkStage(uint32_t stage) { if (_benchmark) _benchmark->Mark(stage); }
+	// debug builds count heap allocations between these two and report the frames that made any
+	void BeginAllocationCheck();
+	void EndAllocationCheck();
 
 	UINT _WindowHeight;
 	UINT _WindowWidth;
@@ -103,9 +228,65 @@ public:
 	Application();
 	~Application();
 
+	// must be set before Initialise, forward by default
+	void SetRenderPath(RenderPath path) { _renderPath = path; }
+
+	// must be set before Initialise too, defaults to triple buffered vsync with one frame of latency
+	void SetSwapChainSettings(const SwapChainSettings& settings) { _swapChainSettings = settings; }
+
+	// frames per second cap on top of vsync, 0 (the default) for none
+	void SetTargetFrameRate(double rate) { _targetFrameRate = rate; }
+
+	// must be set before Initialise, renders at whatever scale keeps the gpu inside the
+	// frame budget (the target frame rate, or 60 fps without one) and upscales
+	void SetDynamicResolution(bool enabled) { _dynamicResolutionEnabled = enabled; }
+
+	// must be set before Initialise: no window or swap chain, the scene is drawn into an
+	// offscreen target of this size for RenderHeadless
+	void SetHeadless(UINT width, UINT height);
+	// must be set before Initialise, D3D_DRIVER_TYPE_UNKNOWN (the default) tries
+	// hardware, then WARP, then the reference rasteriser
+	void SetDriverType(D3D_DRIVER_TYPE driverType) { _requestedDriverType = driverType; }
+	// seconds of animation per Update, 0 (the default) follows the wall clock
+	void SetFixedTimestep(float seconds) { _fixedTimestep = seconds; }
+	// per pass GPU timings are written here as CSV on exit
+	void SetGpuProfileFile(const wchar_t* fileName) { _gpuProfileFile = fileName; }
+	// records CPU scopes from Initialise on and writes fileName.json (Chrome trace) and
+	// fileName.cpuprof on exit, only builds with PROFILE defined have scopes to record
+	void SetCpuProfileFile(const wchar_t* fileName) { _cpuProfileFile = fileName; }
+	// per frame counters go here as CSV, or JSON with the histogram when it ends in .json
+	void SetStatsFile(const wchar_t* fileName) { _statsFile = fileName; }
+	// must be set before Initialise, GPU memory the packed material textures may take
+	// before the residency manager drops their top mips
+	void SetTextureBudget(UINT64 bytes) { _textureBudget = bytes; }
+	// must be set before Initialise, at least the five named bodies
+	void SetBodyCount(UINT count) { _bodyCount = max(count, NAMED_BODY_COUNT); }
+	// must be set before Initialise, the context calls of the first frameCount frames are
+	// written to fileName as an API trace (see ApiTrace.h)
+	void SetCaptureFile(const wchar_t* fileName, UINT frameCount) { _captureFile = fileName; _captureFrames = frameCount; }
+
 	HRESULT Initialise(HINSTANCE hInstance, int nCmdShow);
 
+	// compiles every shader the app uses into the shader cache, for -buildshaders
+	static HRESULT BuildShaders();
+
+	// channel packs the normal and specular maps into one texture, only when the packed
+	// file is missing or out of date unless force is set
+	static HRESULT PackMaterialTextures(bool force);
+
+	// blocks until the next frame is due and the swap chain can take it, call before
+	// Update. false when window messages arrived first, pump them and call again
+	bool WaitForNextFrame();
 	void Update();
 	void Draw();
+
+	// headless only, renders frameCount frames back to back and writes their checksums
+	// to outputDirectory\checksums.txt, and the frames themselves with writeImages
+	HRESULT RenderHeadless(UINT frameCount, const wchar_t* outputDirectory, bool writeImages);
+
+	// headless only, times warmupFrames and then measuredFrames frames from animation
+	// time zero and writes frame and per stage CPU time percentiles to outputFile as JSON.
+	// set a fixed timestep first so every run draws the same frames
+	HRESULT RunBenchmark(UINT warmupFrames, UINT measuredFrames, const wchar_t* outputFile);
 };
 
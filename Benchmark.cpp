@@ -0,0 +1,172 @@
+#include "Benchmark.h"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+
+static double MillisecondsBetween(chrono::steady_clock::time_point start, chrono::steady_clock::time_point end)
+{
+    return chrono::duration<double, milli>(end - start).count();
+}
+
+static FILE* OpenOutputFile(const wchar_t* fileName)
+{
+#ifdef _WIN32
+    FILE* file = nullptr;
+    return _wfopen_s(&file, fileName, L"wt") == 0 ? file : nullptr;
+#else
+    char path[1024];
+    if (wcstombs(path, fileName, sizeof(path)) == (size_t)-1)
+        return nullptr;
+
+    return fopen(path, "w");
+#endif
+}
+
+BenchmarkRecorder::BenchmarkRecorder()
+{
+    _measuring = false;
+    _inFrame = false;
+}
+
+uint32_t BenchmarkRecorder::AddStage(const char* name)
+{
+    Stage stage;
+    stage.name = name;
+    stage.frameMs = 0.0;
+    _stages.push_back(stage);
+    return (uint32_t)_stages.size() - 1;
+}
+
+void BenchmarkRecorder::Reset()
+{
+    _frameMs.clear();
+    for (Stage& stage : _stages)
+        stage.samples.clear();
+}
+
+void BenchmarkRecorder::BeginFrame()
+{
+    for (Stage& stage : _stages)
+        stage.frameMs = 0.0;
+
+    _inFrame = true;
+    _frameStart = chrono::steady_clock::now();
+    _lastMark = _frameStart;
+}
+
+void BenchmarkRecorder::Mark(uint32_t stage)
+{
+    if (!_inFrame)
+        return;
+
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    _stages[stage].frameMs += MillisecondsBetween(_lastMark, now);
+    _lastMark = now;
+}
+
+void BenchmarkRecorder::EndFrame()
+{
+    if (!_inFrame)
+        return;
+
+    _inFrame = false;
+    if (!_measuring)
+        return;
+
+    _frameMs.push_back(MillisecondsBetween(_frameStart, chrono::steady_clock::now()));
+    for (Stage& stage : _stages)
+        stage.samples.push_back(stage.frameMs);
+}
+
+void BenchmarkRecorder::AddFrame(double frameMs, const double* stageMs)
+{
+    if (!_measuring)
+        return;
+
+    _frameMs.push_back(frameMs);
+    for (size_t stage = 0; stage < _stages.size(); ++stage)
+        _stages[stage].samples.push_back(stageMs[stage]);
+}
+
+const vector<double>& BenchmarkRecorder::Samples(uint32_t stage) const
+{
+    return stage == FRAME ? _frameMs : _stages[stage].samples;
+}
+
+double BenchmarkRecorder::GetPercentile(uint32_t stage, double percentile) const
+{
+    vector<double> sorted(Samples(stage));
+    if (sorted.empty())
+        return 0.0;
+
+    size_t rank = (size_t)(percentile / 100.0 * sorted.size());
+    rank = min(rank, sorted.size() - 1);
+    nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+double BenchmarkRecorder::GetMean(uint32_t stage) const
+{
+    const vector<double>& samples = Samples(stage);
+    if (samples.empty())
+        return 0.0;
+
+    double total = 0.0;
+    for (double sample : samples)
+        total += sample;
+
+    return total / samples.size();
+}
+
+static string FormatSummary(const BenchmarkRecorder& recorder, uint32_t stage)
+{
+    char text[256];
+    snprintf(text, sizeof(text), "{\"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f}",
+             recorder.GetMean(stage), recorder.GetPercentile(stage, 50.0), recorder.GetPercentile(stage, 90.0),
+             recorder.GetPercentile(stage, 95.0), recorder.GetPercentile(stage, 99.0), recorder.GetPercentile(stage, 100.0));
+    return text;
+}
+
+string BenchmarkRecorder::FormatJson(const vector<pair<string, string>>& config) const
+{
+    string json = "{\n\"config\": {";
+    for (size_t i = 0; i < config.size(); ++i)
+        json += (i ? ", \"" : "\"") + config[i].first + "\": " + config[i].second;
+    json += "},\n\"frames\": " + to_string(GetMeasuredFrames()) + ",\n\"frame_ms\": " + FormatSummary(*this, FRAME);
+
+    json += ",\n\"stages\": {";
+    for (uint32_t stage = 0; stage < _stages.size(); ++stage)
+        json += (stage ? ",\n\"" : "\n\"") + _stages[stage].name + "\": " + FormatSummary(*this, stage);
+    json += "\n}\n}\n";
+
+    return json;
+}
+
+bool BenchmarkRecorder::WriteJson(const wchar_t* fileName, const vector<pair<string, string>>& config) const
+{
+    FILE* file = OpenOutputFile(fileName);
+    if (!file)
+        return false;
+
+    string json = FormatJson(config);
+    bool written = fwrite(json.data(), 1, json.size(), file) == json.size();
+    fclose(file);
+    return written;
+}
+
+//--------------------------------------------------------------------------------------
+// Runner
+//--------------------------------------------------------------------------------------
+void RunBenchmarkFrames(BenchmarkRecorder& recorder, uint32_t warmupFrames, uint32_t measuredFrames,
+                        const function<void(uint32_t frame)>& frame)
+{
+    for (uint32_t index = 0; index < warmupFrames + measuredFrames; ++index)
+    {
+        recorder.SetMeasuring(index >= warmupFrames);
+        recorder.BeginFrame();
+        frame(index);
+        recorder.EndFrame();
+    }
+
+    recorder.SetMeasuring(false);
+}
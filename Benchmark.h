@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <functional>
+
+using namespace std;
+
+// CPU time per named stage of each frame for a benchmark run. a frame is cut into stages
+// by Mark, each one charging the time since the previous mark (or BeginFrame) to a stage.
+// warm-up frames are timed the same way but only frames recorded while measuring are kept.
+// free of windows headers like CpuProfiler so the statistics build on any platform
+class BenchmarkRecorder
+{
+public:
+	// stands for the whole frame in the percentile queries
+	static const uint32_t FRAME = 0xFFFFFFFF;
+
+	BenchmarkRecorder();
+
+	uint32_t AddStage(const char* name);
+	void SetMeasuring(bool measuring) { _measuring = measuring; }
+	void Reset();
+
+	void BeginFrame();
+	void Mark(uint32_t stage);
+	void EndFrame();
+	// a frame timed elsewhere (a trace, another clock), stageMs has a value per stage.
+	// kept only while measuring, like the frames BeginFrame and EndFrame time
+	void AddFrame(double frameMs, const double* stageMs);
+
+	uint32_t GetMeasuredFrames() const { return (uint32_t)_frameMs.size(); }
+	uint32_t GetStageCount() const { return (uint32_t)_stages.size(); }
+	const string& GetStageName(uint32_t stage) const { return _stages[stage].name; }
+
+	// nearest rank percentile (0-100) of the measured frames in milliseconds
+	double GetPercentile(uint32_t stage, double percentile) const;
+	double GetMean(uint32_t stage) const;
+
+	// config is written as given, string values with their quotes so numbers stay numbers:
+	// { "config": {...}, "frames": n, "frame_ms": {...}, "stages": { name: {...}, ... } }
+	string FormatJson(const vector<pair<string, string>>& config) const;
+	bool WriteJson(const wchar_t* fileName, const vector<pair<string, string>>& config) const;
+
+private:
+	struct Stage
+	{
+		string name;
+		double frameMs;
+		vector<double> samples;
+	};
+
+	const vector<double>& Samples(uint32_t stage) const;
+
+	vector<Stage> _stages;
+	vector<double> _frameMs;
+	bool _measuring;
+	bool _inFrame;
+	chrono::steady_clock::time_point _frameStart;
+	chrono::steady_clock::time_point _lastMark;
+};
+
+// the benchmark loop Application, SoftwareViewer and SceneBenchmark share: warmupFrames
+// then measuredFrames calls of frame(index), each between BeginFrame and EndFrame with
+// only the measured ones kept. frame marks its own stages
+void RunBenchmarkFrames(BenchmarkRecorder& recorder, uint32_t warmupFrames, uint32_t measuredFrames,
+                        const function<void(uint32_t frame)>& frame);
@@ -0,0 +1,1547 @@
+#include "CaptureContext.h"
+#include "DDSTextureLoader.h"
+#include <algorithm>
+#include <string.h>
+
+// shader stages as numbered in the trace
+static const UINT STAGE_VS = 0;
+static const UINT STAGE_HS = 1;
+static const UINT STAGE_DS = 2;
+static const UINT STAGE_GS = 3;
+static const UINT STAGE_PS = 4;
+static const UINT STAGE_CS = 5;
+
+// what the byte counts in the trace are worked out from
+struct ResourceInfo
+{
+    bool buffer;
+    UINT width;
+    UINT height;
+    UINT depth;
+    UINT mipLevels;
+    UINT arraySize;
+    UINT sampleCount;
+    DXGI_FORMAT format;
+};
+
+static void GetResourceInfo(ID3D11Resource* resource, ResourceInfo& info)
+{
+    info.buffer = false;
+    info.width = 0;
+    info.height = 1;
+    info.depth = 1;
+    info.mipLevels = 1;
+    info.arraySize = 1;
+    info.sampleCount = 1;
+    info.format = DXGI_FORMAT_UNKNOWN;
+
+    D3D11_RESOURCE_DIMENSION dimension = D3D11_RESOURCE_DIMENSION_UNKNOWN;
+    resource->GetType(&dimension);
+
+    switch (dimension)
+    {
+    case D3D11_RESOURCE_DIMENSION_BUFFER:
+    {
+        D3D11_BUFFER_DESC desc;
+        static_cast<ID3D11Buffer*>(resource)->GetDesc(&desc);
+        info.buffer = true;
+        info.width = desc.ByteWidth;
+        break;
+    }
+    case D3D11_RESOURCE_DIMENSION_TEXTURE1D:
+    {
+        D3D11_TEXTURE1D_DESC desc;
+        static_cast<ID3D11Texture1D*>(resource)->GetDesc(&desc);
+        info.width = desc.Width;
+        info.mipLevels = desc.MipLevels;
+        info.arraySize = desc.ArraySize;
+        info.format = desc.Format;
+        break;
+    }
+    case D3D11_RESOURCE_DIMENSION_TEXTURE2D:
+    {
+        D3D11_TEXTURE2D_DESC desc;
+        static_cast<ID3D11Texture2D*>(resource)->GetDesc(&desc);
+        info.width = desc.Width;
+        info.height = desc.Height;
+        info.mipLevels = desc.MipLevels;
+        info.arraySize = desc.ArraySize;
+        info.sampleCount = desc.SampleDesc.Count;
+        info.format = desc.Format;
+        break;
+    }
+    case D3D11_RESOURCE_DIMENSION_TEXTURE3D:
+    {
+        D3D11_TEXTURE3D_DESC desc;
+        static_cast<ID3D11Texture3D*>(resource)->GetDesc(&desc);
+        info.width = desc.Width;
+        info.height = desc.Height;
+        info.depth = desc.Depth;
+        info.mipLevels = desc.MipLevels;
+        info.format = desc.Format;
+        break;
+    }
+    default:
+        break;
+    }
+
+    info.mipLevels = max(info.mipLevels, 1u);
+    info.sampleCount = max(info.sampleCount, 1u);
+}
+
+static UINT64 RegionBytes(const ResourceInfo& info, UINT width, UINT height, UINT depth)
+{
+    if (info.buffer)
+        return width;
+
+    return (UINT64)DirectX::GetSurfaceByteSize(width, height, info.format) * depth * info.sampleCount;
+}
+
+static UINT64 SubresourceBytes(const ResourceInfo& info, UINT subresource)
+{
+    UINT mip = subresource % info.mipLevels;
+    return RegionBytes(info, max(info.width >> mip, 1u), max(info.height >> mip, 1u), max(info.depth >> mip, 1u));
+}
+
+static UINT64 ResourceBytes(const ResourceInfo& info)
+{
+    UINT64 bytes = 0;
+    for (UINT mip = 0; mip < info.mipLevels; ++mip)
+        bytes += SubresourceBytes(info, mip);
+
+    return bytes * info.arraySize;
+}
+
+static bool IsEmpty(const D3D11_BOX* box)
+{
+    return box->right <= box->left || box->bottom <= box->top || box->back <= box->front;
+}
+
+static UINT64 BoxBytes(const ResourceInfo& info, UINT subresource, const D3D11_BOX* box)
+{
+    if (!box)
+        return SubresourceBytes(info, subresource);
+
+    if (IsEmpty(box))
+        return 0;
+
+    return RegionBytes(info, box->right - box->left, box->bottom - box->top, box->back - box->front);
+}
+
+// how much UpdateSubresource reads from the source, the last row and slice only as far as the data goes
+static UINT64 UpdateBytes(const ResourceInfo& info, UINT subresource, const D3D11_BOX* box, UINT rowPitch, UINT depthPitch)
+{
+    if (box && IsEmpty(box))
+        return 0;
+
+    if (info.buffer)
+        return box ? box->right - box->left : info.width;
+
+    UINT mip = subresource % info.mipLevels;
+    UINT width = box ? box->right - box->left : max(info.width >> mip, 1u);
+    UINT height = box ? box->bottom - box->top : max(info.height >> mip, 1u);
+    UINT depth = box ? box->back - box->front : max(info.depth >> mip, 1u);
+
+    // rows of blocks for compressed formats
+    UINT64 rowBytes = DirectX::GetSurfaceByteSize(width, 1, info.format);
+    UINT64 rows = rowBytes ? DirectX::GetSurfaceByteSize(width, height, info.format) / rowBytes : 0;
+    if (!rows)
+        return 0;
+
+    UINT64 sliceBytes = (UINT64)rowPitch * (rows - 1) + rowBytes;
+    return (UINT64)depthPitch * (depth - 1) + sliceBytes;
+}
+
+CaptureContext::CaptureContext(ID3D11DeviceContext* context)
+{
+    _context = context;
+    _context->AddRef();
+    _refCount = 1;
+
+    _stats = nullptr;
+    _topology = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
+
+    _framesLeft = 0;
+    _frame = 0;
+    _recording = false;
+}
+
+CaptureContext::~CaptureContext()
+{
+    _writer.Close();
+    _context->Release();
+}
+
+HRESULT CaptureContext::Open(const wchar_t* fileName, UINT frameCount)
+{
+    if (!_writer.Open(fileName))
+        return E_FAIL;
+
+    _framesLeft = frameCount;
+    _frame = 0;
+    _objectIds.clear();
+    _maps.clear();
+
+    return S_OK;
+}
+
+void CaptureContext::BeginFrame()
+{
+    _recording = _framesLeft > 0 && _writer.IsOpen();
+}
+
+void CaptureContext::EndFrame()
+{
+    if (!_recording)
+        return;
+
+    _writer.Begin(API_CALL_FRAME);
+    _writer.PutUInt(_frame++);
+    _writer.End();
+
+    _recording = false;
+    if (--_framesLeft == 0)
+        _writer.Close();
+}
+
+//--------------------------------------------------------------------------------------
+// Object ids
+//--------------------------------------------------------------------------------------
+void CaptureContext::Describe(UINT64 id, ApiObjectKind kind, UINT64 bytes, UINT width, UINT height, UINT format, UINT64 resourceId)
+{
+    _writer.Begin(API_CALL_OBJECT);
+    _writer.PutUInt(id);
+    _writer.PutUInt(kind);
+    _writer.PutUInt(bytes);
+    _writer.PutUInt(width);
+    _writer.PutUInt(height);
+    _writer.PutUInt(format);
+    _writer.PutUInt(resourceId);
+    _writer.End();
+}
+
+UINT64 CaptureContext::Id(ID3D11Resource* resource)
+{
+    if (!resource)
+        return 0;
+
+    auto found = _objectIds.find(resource);
+    if (found != _objectIds.end())
+        return found->second;
+
+    UINT64 id = _objectIds.size() + 1;
+    _objectIds[resource] = id;
+
+    ResourceInfo info;
+    GetResourceInfo(resource, info);
+    Describe(id, info.buffer ? API_OBJECT_BUFFER : API_OBJECT_TEXTURE, ResourceBytes(info), info.width, info.height, info.format, 0);
+
+    return id;
+}
+
+UINT64 CaptureContext::Id(ID3D11View* view, ApiObjectKind kind)
+{
+    if (!view)
+        return 0;
+
+    auto found = _objectIds.find(view);
+    if (found != _objectIds.end())
+        return found->second;
+
+    ID3D11Resource* resource = nullptr;
+    view->GetResource(&resource);
+
+    // the resource is described first so the view can refer to it
+    UINT64 resourceId = Id(resource);
+    UINT64 id = _objectIds.size() + 1;
+    _objectIds[view] = id;
+
+    ResourceInfo info;
+    GetResourceInfo(resource, info);
+    Describe(id, kind, SubresourceBytes(info, 0) * info.arraySize, info.width, info.height, info.format, resourceId);
+
+    resource->Release();
+    return id;
+}
+
+UINT64 CaptureContext::Id(ID3D11DeviceChild* object, ApiObjectKind kind)
+{
+    if (!object)
+        return 0;
+
+    auto found = _objectIds.find(object);
+    if (found != _objectIds.end())
+        return found->second;
+
+    UINT64 id = _objectIds.size() + 1;
+    _objectIds[object] = id;
+    Describe(id, kind, 0, 0, 0, 0, 0);
+
+    return id;
+}
+
+//--------------------------------------------------------------------------------------
+// Recording helpers, ids are worked out before the record is begun so any object
+// records they write go ahead of it
+//--------------------------------------------------------------------------------------
+template <class T>
+void CaptureContext::RecordSlots(ApiCall call, UINT stage, UINT startSlot, UINT count, T* const* objects)
+{
+    _ids.clear();
+    for (UINT i = 0; i < count; ++i)
+        _ids.push_back(objects ? Id(objects[i]) : 0);
+
+    _writer.Begin(call);
+    _writer.PutUInt(stage);
+    _writer.PutUInt(startSlot);
+    _writer.PutUInt(count);
+    for (UINT64 id : _ids)
+        _writer.PutUInt(id);
+    _writer.End();
+}
+
+void CaptureContext::RecordShader(UINT stage, ID3D11DeviceChild* shader, UINT numClassInstances)
+{
+    UINT64 id = Id(shader, API_OBJECT_SHADER);
+
+    _writer.Begin(API_CALL_SET_SHADER);
+    _writer.PutUInt(stage);
+    _writer.PutUInt(id);
+    _writer.PutUInt(numClassInstances);
+    _writer.End();
+}
+
+void CaptureContext::RecordDrawIndirect(bool indexed, ID3D11Buffer* buffer, UINT offset)
+{
+    UINT64 id = Id(buffer);
+
+    _writer.Begin(API_CALL_DRAW_INDIRECT);
+    _writer.PutUInt(indexed ? 1 : 0);
+    _writer.PutUInt(id);
+    _writer.PutUInt(offset);
+    _writer.End();
+}
+
+void CaptureContext::RecordQuery(ApiCall call, ID3D11Asynchronous* async)
+{
+    UINT64 id = Id(async, API_OBJECT_QUERY);
+
+    _writer.Begin(call);
+    _writer.PutUInt(id);
+    _writer.End();
+}
+
+void CaptureContext::CountConstantUpload(ID3D11Resource* resource, const D3D11_BOX* box)
+{
+    if (!_stats || !resource)
+        return;
+
+    D3D11_RESOURCE_DIMENSION dimension = D3D11_RESOURCE_DIMENSION_UNKNOWN;
+    resource->GetType(&dimension);
+    if (dimension != D3D11_RESOURCE_DIMENSION_BUFFER)
+        return;
+
+    D3D11_BUFFER_DESC desc;
+    static_cast<ID3D11Buffer*>(resource)->GetDesc(&desc);
+    if (!(desc.BindFlags & D3D11_BIND_CONSTANT_BUFFER))
+        return;
+
+    _stats->CountConstantUpload(box ? (box->right > box->left ? box->right - box->left : 0) : desc.ByteWidth);
+}
+
+//--------------------------------------------------------------------------------------
+// IUnknown and ID3D11DeviceChild
+//--------------------------------------------------------------------------------------
+HRESULT CaptureContext::QueryInterface(REFIID riid, void** object)
+{
+    if (!object)
+        return E_POINTER;
+
+    if (riid == __uuidof(IUnknown) || riid == __uuidof(ID3D11DeviceChild) || riid == __uuidof(ID3D11DeviceContext))
+    {
+        *object = static_cast<ID3D11DeviceContext*>(this);
+        AddRef();
+        return S_OK;
+    }
+
+    return _context->QueryInterface(riid, object);
+}
+
+ULONG CaptureContext::AddRef()
+{
+    return InterlockedIncrement(&_refCount);
+}
+
+ULONG CaptureContext::Release()
+{
+    ULONG count = InterlockedDecrement(&_refCount);
+    if (count == 0)
+        delete this;
+
+    return count;
+}
+
+void CaptureContext::GetDevice(ID3D11Device** device)
+{
+    _context->GetDevice(device);
+}
+
+HRESULT CaptureContext::GetPrivateData(REFGUID guid, UINT* dataSize, void* data)
+{
+    return _context->GetPrivateData(guid, dataSize, data);
+}
+
+HRESULT CaptureContext::SetPrivateData(REFGUID guid, UINT dataSize, const void* data)
+{
+    return _context->SetPrivateData(guid, dataSize, data);
+}
+
+HRESULT CaptureContext::SetPrivateDataInterface(REFGUID guid, const IUnknown* data)
+{
+    return _context->SetPrivateDataInterface(guid, data);
+}
+
+//--------------------------------------------------------------------------------------
+// Shader stages
+//--------------------------------------------------------------------------------------
+void CaptureContext::VSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+    CountStateChange();
+    if (_recording)
+        RecordSlots(API_CALL_SET_CONSTANT_BUFFERS, STAGE_VS, startSlot, numBuffers, buffers);
+    _context->VSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void CaptureContext::VSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+    if (_stats)
+        _stats->CountShaderResources(numViews);
+    if (_recording)
+        RecordSlots(API_CALL_SET_SHADER_RESOURCES, STAGE_VS, startSlot, numViews, views);
+    _context->VSSetShaderResources(startSlot, numViews, views);
+}
+
+void CaptureContext::VSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+    CountStateChange();
+    if (_recording)
+        RecordSlots(API_CALL_SET_SAMPLERS, STAGE_VS, startSlot, numSamplers, samplers);
+    _context->VSSetSamplers(startSlot, numSamplers, samplers);
+}
+
+void CaptureContext::VSSetShader(ID3D11VertexShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+    CountStateChange();
+    if (_recording)
+        RecordShader(STAGE_VS, shader, numClassInstances);
+    _context->VSSetShader(shader, classInstances, numClassInstances);
+}
+
+void CaptureContext::HSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+    CountStateChange();
+    if (_recording)
+        RecordSlots(API_CALL_SET_CONSTANT_BUFFERS, STAGE_HS, startSlot, numBuffers, buffers);
+    _context->HSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void CaptureContext::HSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+    if (_stats)
+        _stats->CountShaderResources(numViews);
+    if (_recording)
+        RecordSlots(API_CALL_SET_SHADER_RESOURCES, STAGE_HS, startSlot, numViews, views);
+    _context->HSSetShaderResources(startSlot, numViews, views);
+}
+
+void CaptureContext::HSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+    CountStateChange();
+    if (_recording)
+        RecordSlots(API_CALL_SET_SAMPLERS, STAGE_HS, startSlot, numSamplers, samplers);
+    _context->HSSetSamplers(startSlot, numSamplers, samplers);
+}
+
+void CaptureContext::HSSetShader(ID3D11HullShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+    CountStateChange();
+    if (_recording)
+        RecordShader(STAGE_HS, shader, numClassInstances);
+    _context->HSSetShader(shader, classInstances, numClassInstances);
+}
+
+void CaptureContext::DSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+    CountStateChange();
+    if (_recording)
+        RecordSlots(API_CALL_SET_CONSTANT_BUFFERS, STAGE_DS, startSlot, numBuffers, buffers);
+    _context->DSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void CaptureContext::DSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+    if (_stats)
+        _stats->CountShaderResources(numViews);
+    if (_recording)
+        RecordSlots(API_CALL_SET_SHADER_RESOURCES, STAGE_DS, startSlot, numViews, views);
+    _context->DSSetShaderResources(startSlot, numViews, views);
+}
+
+void CaptureContext::DSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+    CountStateChange();
+    if (_recording)
+        RecordSlots(API_CALL_SET_SAMPLERS, STAGE_DS, startSlot, numSamplers, samplers);
+    _context->DSSetSamplers(startSlot, numSamplers, samplers);
+}
+
+void CaptureContext::DSSetShader(ID3D11DomainShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+    CountStateChange();
+    if (_recording)
+        RecordShader(STAGE_DS, shader, numClassInstances);
+    _context->DSSetShader(shader, classInstances, numClassInstances);
+}
+
+void CaptureContext::GSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+    CountStateChange();
+    if (_recording)
+        RecordSlots(API_CALL_SET_CONSTANT_BUFFERS, STAGE_GS, startSlot, numBuffers, buffers);
+    _context->GSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void CaptureContext::GSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+    if (_stats)
+        _stats->CountShaderResources(numViews);
+    if (_recording)
+        RecordSlots(API_CALL_SET_SHADER_RESOURCES, STAGE_GS, startSlot, numViews, views);
+    _context->GSSetShaderResources(startSlot, numViews, views);
+}
+
+void CaptureContext::GSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+    CountStateChange();
+    if (_recording)
+        RecordSlots(API_CALL_SET_SAMPLERS, STAGE_GS, startSlot, numSamplers, samplers);
+    _context->GSSetSamplers(startSlot, numSamplers, samplers);
+}
+
+void CaptureContext::GSSetShader(ID3D11GeometryShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+    CountStateChange();
+    if (_recording)
+        RecordShader(STAGE_GS, shader, numClassInstances);
+    _context->GSSetShader(shader, classInstances, numClassInstances);
+}
+
+void CaptureContext::PSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+    CountStateChange();
+    if (_recording)
+        RecordSlots(API_CALL_SET_CONSTANT_BUFFERS, STAGE_PS, startSlot, numBuffers, buffers);
+    _context->PSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void CaptureContext::PSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+    if (_stats)
+        _stats->CountShaderResources(numViews);
+    if (_recording)
+        RecordSlots(API_CALL_SET_SHADER_RESOURCES, STAGE_PS, startSlot, numViews, views);
+    _context->PSSetShaderResources(startSlot, numViews, views);
+}
+
+void CaptureContext::PSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+    CountStateChange();
+    if (_recording)
+        RecordSlots(API_CALL_SET_SAMPLERS, STAGE_PS, startSlot, numSamplers, samplers);
+    _context->PSSetSamplers(startSlot, numSamplers, samplers);
+}
+
+void CaptureContext::PSSetShader(ID3D11PixelShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+    CountStateChange();
+    if (_recording)
+        RecordShader(STAGE_PS, shader, numClassInstances);
+    _context->PSSetShader(shader, classInstances, numClassInstances);
+}
+
+void CaptureContext::CSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers)
+{
+    CountStateChange();
+    if (_recording)
+        RecordSlots(API_CALL_SET_CONSTANT_BUFFERS, STAGE_CS, startSlot, numBuffers, buffers);
+    _context->CSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void CaptureContext::CSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views)
+{
+    if (_stats)
+        _stats->CountShaderResources(numViews);
+    if (_recording)
+        RecordSlots(API_CALL_SET_SHADER_RESOURCES, STAGE_CS, startSlot, numViews, views);
+    _context->CSSetShaderResources(startSlot, numViews, views);
+}
+
+void CaptureContext::CSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers)
+{
+    CountStateChange();
+    if (_recording)
+        RecordSlots(API_CALL_SET_SAMPLERS, STAGE_CS, startSlot, numSamplers, samplers);
+    _context->CSSetSamplers(startSlot, numSamplers, samplers);
+}
+
+void CaptureContext::CSSetUnorderedAccessViews(UINT startSlot, UINT numUAVs, ID3D11UnorderedAccessView* const* unorderedAccessViews,
+                                               const UINT* uavInitialCounts)
+{
+    CountStateChange();
+    if (_recording)
+        RecordSlots(API_CALL_SET_UNORDERED_ACCESS_VIEWS, STAGE_CS, startSlot, numUAVs, unorderedAccessViews);
+    _context->CSSetUnorderedAccessViews(startSlot, numUAVs, unorderedAccessViews, uavInitialCounts);
+}
+
+void CaptureContext::CSSetShader(ID3D11ComputeShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances)
+{
+    CountStateChange();
+    if (_recording)
+        RecordShader(STAGE_CS, shader, numClassInstances);
+    _context->CSSetShader(shader, classInstances, numClassInstances);
+}
+
+//--------------------------------------------------------------------------------------
+// Input assembler, rasteriser, output merger and stream output
+//--------------------------------------------------------------------------------------
+void CaptureContext::IASetInputLayout(ID3D11InputLayout* inputLayout)
+{
+    CountStateChange();
+    if (_recording)
+    {
+        UINT64 id = Id(inputLayout, API_OBJECT_INPUT_LAYOUT);
+
+        _writer.Begin(API_CALL_SET_INPUT_LAYOUT);
+        _writer.PutUInt(id);
+        _writer.End();
+    }
+    _context->IASetInputLayout(inputLayout);
+}
+
+void CaptureContext::IASetVertexBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* vertexBuffers,
+                                        const UINT* strides, const UINT* offsets)
+{
+    CountStateChange();
+    if (_recording)
+    {
+        _ids.clear();
+        for (UINT i = 0; i < numBuffers; ++i)
+            _ids.push_back(vertexBuffers ? Id(vertexBuffers[i]) : 0);
+
+        _writer.Begin(API_CALL_SET_VERTEX_BUFFERS);
+        _writer.PutUInt(startSlot);
+        _writer.PutUInt(numBuffers);
+        for (UINT i = 0; i < numBuffers; ++i)
+        {
+            _writer.PutUInt(_ids[i]);
+            _writer.PutUInt(strides ? strides[i] : 0);
+            _writer.PutUInt(offsets ? offsets[i] : 0);
+        }
+        _writer.End();
+    }
+    _context->IASetVertexBuffers(startSlot, numBuffers, vertexBuffers, strides, offsets);
+}
+
+void CaptureContext::IASetIndexBuffer(ID3D11Buffer* indexBuffer, DXGI_FORMAT format, UINT offset)
+{
+    CountStateChange();
+    if (_recording)
+    {
+        UINT64 id = Id(indexBuffer);
+
+        _writer.Begin(API_CALL_SET_INDEX_BUFFER);
+        _writer.PutUInt(id);
+        _writer.PutUInt(format);
+        _writer.PutUInt(offset);
+        _writer.End();
+    }
+    _context->IASetIndexBuffer(indexBuffer, format, offset);
+}
+
+void CaptureContext::IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+    CountStateChange();
+    _topology = topology;
+    if (_recording)
+    {
+        _writer.Begin(API_CALL_SET_PRIMITIVE_TOPOLOGY);
+        _writer.PutUInt(topology);
+        _writer.End();
+    }
+    _context->IASetPrimitiveTopology(topology);
+}
+
+void CaptureContext::RSSetState(ID3D11RasterizerState* rasterizerState)
+{
+    CountStateChange();
+    if (_recording)
+    {
+        UINT64 id = Id(rasterizerState, API_OBJECT_RASTERIZER_STATE);
+
+        _writer.Begin(API_CALL_SET_RASTERIZER_STATE);
+        _writer.PutUInt(id);
+        _writer.End();
+    }
+    _context->RSSetState(rasterizerState);
+}
+
+void CaptureContext::RSSetViewports(UINT numViewports, const D3D11_VIEWPORT* viewports)
+{
+    CountStateChange();
+    if (_recording)
+    {
+        _writer.Begin(API_CALL_SET_VIEWPORTS);
+        _writer.PutUInt(numViewports);
+        for (UINT i = 0; i < numViewports; ++i)
+        {
+            _writer.PutFloat(viewports[i].TopLeftX);
+            _writer.PutFloat(viewports[i].TopLeftY);
+            _writer.PutFloat(viewports[i].Width);
+            _writer.PutFloat(viewports[i].Height);
+            _writer.PutFloat(viewports[i].MinDepth);
+            _writer.PutFloat(viewports[i].MaxDepth);
+        }
+        _writer.End();
+    }
+    _context->RSSetViewports(numViewports, viewports);
+}
+
+void CaptureContext::RSSetScissorRects(UINT numRects, const D3D11_RECT* rects)
+{
+    CountStateChange();
+    if (_recording)
+    {
+        _writer.Begin(API_CALL_SET_SCISSOR_RECTS);
+        _writer.PutUInt(numRects);
+        for (UINT i = 0; i < numRects; ++i)
+        {
+            _writer.PutInt(rects[i].left);
+            _writer.PutInt(rects[i].top);
+            _writer.PutInt(rects[i].right);
+            _writer.PutInt(rects[i].bottom);
+        }
+        _writer.End();
+    }
+    _context->RSSetScissorRects(numRects, rects);
+}
+
+void CaptureContext::OMSetRenderTargets(UINT numViews, ID3D11RenderTargetView* const* renderTargetViews,
+                                        ID3D11DepthStencilView* depthStencilView)
+{
+    CountStateChange();
+    if (_recording)
+    {
+        _ids.clear();
+        for (UINT i = 0; i < numViews; ++i)
+            _ids.push_back(renderTargetViews ? Id(renderTargetViews[i]) : 0);
+        UINT64 depthId = Id(depthStencilView);
+
+        _writer.Begin(API_CALL_SET_RENDER_TARGETS);
+        _writer.PutUInt(numViews);
+        for (UINT64 id : _ids)
+            _writer.PutUInt(id);
+        _writer.PutUInt(depthId);
+        _writer.End();
+    }
+    _context->OMSetRenderTargets(numViews, renderTargetViews, depthStencilView);
+}
+
+void CaptureContext::OMSetRenderTargetsAndUnorderedAccessViews(UINT numRTVs, ID3D11RenderTargetView* const* renderTargetViews,
+                                                               ID3D11DepthStencilView* depthStencilView, UINT uavStartSlot, UINT numUAVs,
+                                                               ID3D11UnorderedAccessView* const* unorderedAccessViews,
+                                                               const UINT* uavInitialCounts)
+{
+    CountStateChange();
+    if (_recording)
+    {
+        // the output merger's views are recorded as the pixel stage's
+        if (numUAVs != D3D11_KEEP_UNORDERED_ACCESS_VIEWS)
+            RecordSlots(API_CALL_SET_UNORDERED_ACCESS_VIEWS, STAGE_PS, uavStartSlot, numUAVs, unorderedAccessViews);
+
+        if (numRTVs != D3D11_KEEP_RENDER_TARGETS_AND_DEPTH_STENCIL)
+        {
+            _ids.clear();
+            for (UINT i = 0; i < numRTVs; ++i)
+                _ids.push_back(renderTargetViews ? Id(renderTargetViews[i]) : 0);
+            UINT64 depthId = Id(depthStencilView);
+
+            _writer.Begin(API_CALL_SET_RENDER_TARGETS);
+            _writer.PutUInt(numRTVs);
+            for (UINT64 id : _ids)
+                _writer.PutUInt(id);
+            _writer.PutUInt(depthId);
+            _writer.End();
+        }
+    }
+    _context->OMSetRenderTargetsAndUnorderedAccessViews(numRTVs, renderTargetViews, depthStencilView, uavStartSlot, numUAVs,
+                                                        unorderedAccessViews, uavInitialCounts);
+}
+
+void CaptureContext::OMSetBlendState(ID3D11BlendState* blendState, const FLOAT blendFactor[4], UINT sampleMask)
+{
+    CountStateChange();
+    if (_recording)
+    {
+        UINT64 id = Id(blendState, API_OBJECT_BLEND_STATE);
+
+        _writer.Begin(API_CALL_SET_BLEND_STATE);
+        _writer.PutUInt(id);
+        // null means a factor of one
+        for (int i = 0; i < 4; ++i)
+            _writer.PutFloat(blendFactor ? blendFactor[i] : 1.0f);
+        _writer.PutUInt(sampleMask);
+        _writer.End();
+    }
+    _context->OMSetBlendState(blendState, blendFactor, sampleMask);
+}
+
+void CaptureContext::OMSetDepthStencilState(ID3D11DepthStencilState* depthStencilState, UINT stencilRef)
+{
+    CountStateChange();
+    if (_recording)
+    {
+        UINT64 id = Id(depthStencilState, API_OBJECT_DEPTH_STENCIL_STATE);
+
+        _writer.Begin(API_CALL_SET_DEPTH_STENCIL_STATE);
+        _writer.PutUInt(id);
+        _writer.PutUInt(stencilRef);
+        _writer.End();
+    }
+    _context->OMSetDepthStencilState(depthStencilState, stencilRef);
+}
+
+void CaptureContext::SOSetTargets(UINT numBuffers, ID3D11Buffer* const* targets, const UINT* offsets)
+{
+    CountStateChange();
+    if (_recording)
+    {
+        _ids.clear();
+        for (UINT i = 0; i < numBuffers; ++i)
+            _ids.push_back(targets ? Id(targets[i]) : 0);
+
+        _writer.Begin(API_CALL_SET_STREAM_OUTPUT_TARGETS);
+        _writer.PutUInt(numBuffers);
+        for (UINT i = 0; i < numBuffers; ++i)
+        {
+            _writer.PutUInt(_ids[i]);
+            _writer.PutUInt(offsets ? offsets[i] : 0);
+        }
+        _writer.End();
+    }
+    _context->SOSetTargets(numBuffers, targets, offsets);
+}
+
+void CaptureContext::SetPredication(ID3D11Predicate* predicate, BOOL predicateValue)
+{
+    if (_recording)
+    {
+        UINT64 id = Id(predicate, API_OBJECT_QUERY);
+
+        _writer.Begin(API_CALL_SET_PREDICATION);
+        _writer.PutUInt(id);
+        _writer.PutUInt(predicateValue ? 1 : 0);
+        _writer.End();
+    }
+    _context->SetPredication(predicate, predicateValue);
+}
+
+//--------------------------------------------------------------------------------------
+// Draws and dispatches
+//--------------------------------------------------------------------------------------
+void CaptureContext::Draw(UINT vertexCount, UINT startVertexLocation)
+{
+    CountDraw(vertexCount);
+    if (_recording)
+    {
+        _writer.Begin(API_CALL_DRAW);
+        _writer.PutUInt(vertexCount);
+        _writer.PutUInt(startVertexLocation);
+        _writer.End();
+    }
+    _context->Draw(vertexCount, startVertexLocation);
+}
+
+void CaptureContext::DrawIndexed(UINT indexCount, UINT startIndexLocation, INT baseVertexLocation)
+{
+    CountDraw(indexCount);
+    if (_recording)
+    {
+        _writer.Begin(API_CALL_DRAW_INDEXED);
+        _writer.PutUInt(indexCount);
+        _writer.PutUInt(startIndexLocation);
+        _writer.PutInt(baseVertexLocation);
+        _writer.End();
+    }
+    _context->DrawIndexed(indexCount, startIndexLocation, baseVertexLocation);
+}
+
+void CaptureContext::DrawInstanced(UINT vertexCountPerInstance, UINT instanceCount, UINT startVertexLocation,
+                                   UINT startInstanceLocation)
+{
+    CountDraw((UINT64)vertexCountPerInstance * instanceCount);
+    if (_recording)
+    {
+        _writer.Begin(API_CALL_DRAW_INSTANCED);
+        _writer.PutUInt(vertexCountPerInstance);
+        _writer.PutUInt(instanceCount);
+        _writer.PutUInt(startVertexLocation);
+        _writer.PutUInt(startInstanceLocation);
+        _writer.End();
+    }
+    _context->DrawInstanced(vertexCountPerInstance, instanceCount, startVertexLocation, startInstanceLocation);
+}
+
+void CaptureContext::DrawIndexedInstanced(UINT indexCountPerInstance, UINT instanceCount, UINT startIndexLocation,
+                                          INT baseVertexLocation, UINT startInstanceLocation)
+{
+    CountDraw((UINT64)indexCountPerInstance * instanceCount);
+    if (_recording)
+    {
+        _writer.Begin(API_CALL_DRAW_INDEXED_INSTANCED);
+        _writer.PutUInt(indexCountPerInstance);
+        _writer.PutUInt(instanceCount);
+        _writer.PutUInt(startIndexLocation);
+        _writer.PutInt(baseVertexLocation);
+        _writer.PutUInt(startInstanceLocation);
+        _writer.End();
+    }
+    _context->DrawIndexedInstanced(indexCountPerInstance, instanceCount, startIndexLocation, baseVertexLocation, startInstanceLocation);
+}
+
+void CaptureContext::DrawAuto()
+{
+    CountDraw(0);
+    if (_recording)
+    {
+        _writer.Begin(API_CALL_DRAW_AUTO);
+        _writer.End();
+    }
+    _context->DrawAuto();
+}
+
+void CaptureContext::DrawIndexedInstancedIndirect(ID3D11Buffer* bufferForArgs, UINT alignedByteOffsetForArgs)
+{
+    CountDraw(0);
+    if (_recording)
+        RecordDrawIndirect(true, bufferForArgs, alignedByteOffsetForArgs);
+    _context->DrawIndexedInstancedIndirect(bufferForArgs, alignedByteOffsetForArgs);
+}
+
+void CaptureContext::DrawInstancedIndirect(ID3D11Buffer* bufferForArgs, UINT alignedByteOffsetForArgs)
+{
+    CountDraw(0);
+    if (_recording)
+        RecordDrawIndirect(false, bufferForArgs, alignedByteOffsetForArgs);
+    _context->DrawInstancedIndirect(bufferForArgs, alignedByteOffsetForArgs);
+}
+
+void CaptureContext::Dispatch(UINT threadGroupCountX, UINT threadGroupCountY, UINT threadGroupCountZ)
+{
+    if (_recording)
+    {
+        _writer.Begin(API_CALL_DISPATCH);
+        _writer.PutUInt(threadGroupCountX);
+        _writer.PutUInt(threadGroupCountY);
+        _writer.PutUInt(threadGroupCountZ);
+        _writer.End();
+    }
+    _context->Dispatch(threadGroupCountX, threadGroupCountY, threadGroupCountZ);
+}
+
+void CaptureContext::DispatchIndirect(ID3D11Buffer* bufferForArgs, UINT alignedByteOffsetForArgs)
+{
+    if (_recording)
+    {
+        UINT64 id = Id(bufferForArgs);
+
+        _writer.Begin(API_CALL_DISPATCH_INDIRECT);
+        _writer.PutUInt(id);
+        _writer.PutUInt(alignedByteOffsetForArgs);
+        _writer.End();
+    }
+    _context->DispatchIndirect(bufferForArgs, alignedByteOffsetForArgs);
+}
+
+//--------------------------------------------------------------------------------------
+// Queries
+//--------------------------------------------------------------------------------------
+void CaptureContext::Begin(ID3D11Asynchronous* async)
+{
+    if (_recording)
+        RecordQuery(API_CALL_BEGIN_QUERY, async);
+    _context->Begin(async);
+}
+
+void CaptureContext::End(ID3D11Asynchronous* async)
+{
+    if (_recording)
+        RecordQuery(API_CALL_END_QUERY, async);
+    _context->End(async);
+}
+
+HRESULT CaptureContext::GetData(ID3D11Asynchronous* async, void* data, UINT dataSize, UINT getDataFlags)
+{
+    HRESULT hr = _context->GetData(async, data, dataSize, getDataFlags);
+    if (_recording)
+    {
+        UINT64 id = Id(async, API_OBJECT_QUERY);
+
+        _writer.Begin(API_CALL_GET_DATA);
+        _writer.PutUInt(id);
+        _writer.PutUInt(getDataFlags);
+        _writer.PutInt(hr);
+        _writer.End();
+    }
+    return hr;
+}
+
+//--------------------------------------------------------------------------------------
+// Resource updates and copies
+//--------------------------------------------------------------------------------------
+HRESULT CaptureContext::Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT mapFlags,
+                            D3D11_MAPPED_SUBRESOURCE* mappedResource)
+{
+    HRESULT hr = _context->Map(resource, subresource, mapType, mapFlags, mappedResource);
+    if (SUCCEEDED(hr) && mapType != D3D11_MAP_READ)
+        CountConstantUpload(resource, nullptr);
+
+    if (!_recording)
+        return hr;
+
+    UINT64 id = Id(resource);
+    ResourceInfo info;
+    GetResourceInfo(resource, info);
+
+    UINT64 readBytes = 0;
+    if (SUCCEEDED(hr) && (mapType == D3D11_MAP_READ || mapType == D3D11_MAP_READ_WRITE))
+        readBytes = SubresourceBytes(info, subresource);
+
+    // the whole buffer goes in the trace at Unmap, the app may have written any of it
+    if (SUCCEEDED(hr) && mapType != D3D11_MAP_READ && info.buffer && mappedResource)
+    {
+        PendingMap map = { resource, subresource, mappedResource->pData, info.width };
+        _maps.push_back(map);
+    }
+
+    _writer.Begin(API_CALL_MAP);
+    _writer.PutUInt(id);
+    _writer.PutUInt(subresource);
+    _writer.PutUInt(mapType);
+    _writer.PutUInt(mapFlags);
+    _writer.PutInt(hr);
+    _writer.PutUInt(readBytes);
+    _writer.End();
+
+    return hr;
+}
+
+void CaptureContext::Unmap(ID3D11Resource* resource, UINT subresource)
+{
+    // looked for even when not recording so a map left open at the end of a frame is dropped
+    const void* written = nullptr;
+    UINT writtenBytes = 0;
+    for (size_t i = 0; i < _maps.size(); ++i)
+    {
+        if (_maps[i].resource == resource && _maps[i].subresource == subresource)
+        {
+            written = _maps[i].data;
+            writtenBytes = _maps[i].bytes;
+            _maps.erase(_maps.begin() + i);
+            break;
+        }
+    }
+
+    if (_recording)
+    {
+        UINT64 id = Id(resource);
+
+        _writer.Begin(API_CALL_UNMAP);
+        _writer.PutUInt(id);
+        _writer.PutUInt(subresource);
+        _writer.PutBytes(written, written ? writtenBytes : 0);
+        _writer.End();
+    }
+    _context->Unmap(resource, subresource);
+}
+
+void CaptureContext::UpdateSubresource(ID3D11Resource* dstResource, UINT dstSubresource, const D3D11_BOX* dstBox,
+                                       const void* srcData, UINT srcRowPitch, UINT srcDepthPitch)
+{
+    CountConstantUpload(dstResource, dstBox);
+    if (_recording)
+    {
+        UINT64 id = Id(dstResource);
+        ResourceInfo info;
+        GetResourceInfo(dstResource, info);
+        UINT64 bytes = srcData ? UpdateBytes(info, dstSubresource, dstBox, srcRowPitch, srcDepthPitch) : 0;
+
+        _writer.Begin(API_CALL_UPDATE_SUBRESOURCE);
+        _writer.PutUInt(id);
+        _writer.PutUInt(dstSubresource);
+        _writer.PutUInt(dstBox ? 1 : 0);
+        if (dstBox)
+        {
+            _writer.PutUInt(dstBox->left);
+            _writer.PutUInt(dstBox->top);
+            _writer.PutUInt(dstBox->front);
+            _writer.PutUInt(dstBox->right);
+            _writer.PutUInt(dstBox->bottom);
+            _writer.PutUInt(dstBox->back);
+        }
+        _writer.PutUInt(srcRowPitch);
+        _writer.PutUInt(srcDepthPitch);
+        _writer.PutBytes(srcData, (size_t)bytes);
+        _writer.End();
+    }
+    _context->UpdateSubresource(dstResource, dstSubresource, dstBox, srcData, srcRowPitch, srcDepthPitch);
+}
+
+void CaptureContext::CopyResource(ID3D11Resource* dstResource, ID3D11Resource* srcResource)
+{
+    if (_recording)
+    {
+        UINT64 dstId = Id(dstResource);
+        UINT64 srcId = Id(srcResource);
+        ResourceInfo info;
+        GetResourceInfo(srcResource, info);
+
+        _writer.Begin(API_CALL_COPY_RESOURCE);
+        _writer.PutUInt(dstId);
+        _writer.PutUInt(srcId);
+        _writer.PutUInt(ResourceBytes(info));
+        _writer.End();
+    }
+    _context->CopyResource(dstResource, srcResource);
+}
+
+void CaptureContext::CopySubresourceRegion(ID3D11Resource* dstResource, UINT dstSubresource, UINT dstX, UINT dstY, UINT dstZ,
+                                           ID3D11Resource* srcResource, UINT srcSubresource, const D3D11_BOX* srcBox)
+{
+    if (_recording)
+    {
+        UINT64 dstId = Id(dstResource);
+        UINT64 srcId = Id(srcResource);
+        ResourceInfo info;
+        GetResourceInfo(srcResource, info);
+
+        _writer.Begin(API_CALL_COPY_SUBRESOURCE_REGION);
+        _writer.PutUInt(dstId);
+        _writer.PutUInt(dstSubresource);
+        _writer.PutUInt(dstX);
+        _writer.PutUInt(dstY);
+        _writer.PutUInt(dstZ);
+        _writer.PutUInt(srcId);
+        _writer.PutUInt(srcSubresource);
+        _writer.PutUInt(BoxBytes(info, srcSubresource, srcBox));
+        _writer.End();
+    }
+    _context->CopySubresourceRegion(dstResource, dstSubresource, dstX, dstY, dstZ, srcResource, srcSubresource, srcBox);
+}
+
+void CaptureContext::CopyStructureCount(ID3D11Buffer* dstBuffer, UINT dstAlignedByteOffset, ID3D11UnorderedAccessView* srcView)
+{
+    if (_recording)
+    {
+        UINT64 bufferId = Id(dstBuffer);
+        UINT64 viewId = Id(srcView);
+
+        _writer.Begin(API_CALL_COPY_STRUCTURE_COUNT);
+        _writer.PutUInt(bufferId);
+        _writer.PutUInt(dstAlignedByteOffset);
+        _writer.PutUInt(viewId);
+        _writer.End();
+    }
+    _context->CopyStructureCount(dstBuffer, dstAlignedByteOffset, srcView);
+}
+
+void CaptureContext::ResolveSubresource(ID3D11Resource* dstResource, UINT dstSubresource, ID3D11Resource* srcResource,
+                                        UINT srcSubresource, DXGI_FORMAT format)
+{
+    if (_recording)
+    {
+        UINT64 dstId = Id(dstResource);
+        UINT64 srcId = Id(srcResource);
+        ResourceInfo info;
+        GetResourceInfo(srcResource, info);
+
+        _writer.Begin(API_CALL_RESOLVE_SUBRESOURCE);
+        _writer.PutUInt(dstId);
+        _writer.PutUInt(dstSubresource);
+        _writer.PutUInt(srcId);
+        _writer.PutUInt(srcSubresource);
+        _writer.PutUInt(format);
+        _writer.PutUInt(SubresourceBytes(info, srcSubresource));
+        _writer.End();
+    }
+    _context->ResolveSubresource(dstResource, dstSubresource, srcResource, srcSubresource, format);
+}
+
+void CaptureContext::GenerateMips(ID3D11ShaderResourceView* shaderResourceView)
+{
+    if (_recording)
+    {
+        UINT64 id = Id(shaderResourceView);
+
+        _writer.Begin(API_CALL_GENERATE_MIPS);
+        _writer.PutUInt(id);
+        _writer.End();
+    }
+    _context->GenerateMips(shaderResourceView);
+}
+
+void CaptureContext::SetResourceMinLOD(ID3D11Resource* resource, FLOAT minLOD)
+{
+    if (_recording)
+    {
+        UINT64 id = Id(resource);
+
+        _writer.Begin(API_CALL_SET_MIN_LOD);
+        _writer.PutUInt(id);
+        _writer.PutFloat(minLOD);
+        _writer.End();
+    }
+    _context->SetResourceMinLOD(resource, minLOD);
+}
+
+//--------------------------------------------------------------------------------------
+// Clears
+//--------------------------------------------------------------------------------------
+void CaptureContext::ClearRenderTargetView(ID3D11RenderTargetView* renderTargetView, const FLOAT colorRGBA[4])
+{
+    if (_recording)
+    {
+        UINT64 id = Id(renderTargetView);
+
+        _writer.Begin(API_CALL_CLEAR_RENDER_TARGET);
+        _writer.PutUInt(id);
+        for (int i = 0; i < 4; ++i)
+            _writer.PutFloat(colorRGBA[i]);
+        _writer.End();
+    }
+    _context->ClearRenderTargetView(renderTargetView, colorRGBA);
+}
+
+void CaptureContext::ClearDepthStencilView(ID3D11DepthStencilView* depthStencilView, UINT clearFlags, FLOAT depth, UINT8 stencil)
+{
+    if (_recording)
+    {
+        UINT64 id = Id(depthStencilView);
+
+        _writer.Begin(API_CALL_CLEAR_DEPTH_STENCIL);
+        _writer.PutUInt(id);
+        _writer.PutUInt(clearFlags);
+        _writer.PutFloat(depth);
+        _writer.PutUInt(stencil);
+        _writer.End();
+    }
+    _context->ClearDepthStencilView(depthStencilView, clearFlags, depth, stencil);
+}
+
+void CaptureContext::ClearUnorderedAccessViewUint(ID3D11UnorderedAccessView* unorderedAccessView, const UINT values[4])
+{
+    if (_recording)
+    {
+        UINT64 id = Id(unorderedAccessView);
+
+        _writer.Begin(API_CALL_CLEAR_UNORDERED_ACCESS_VIEW);
+        _writer.PutUInt(id);
+        _writer.PutUInt(0);
+        for (int i = 0; i < 4; ++i)
+            _writer.PutUInt(values[i]);
+        _writer.End();
+    }
+    _context->ClearUnorderedAccessViewUint(unorderedAccessView, values);
+}
+
+void CaptureContext::ClearUnorderedAccessViewFloat(ID3D11UnorderedAccessView* unorderedAccessView, const FLOAT values[4])
+{
+    if (_recording)
+    {
+        UINT64 id = Id(unorderedAccessView);
+
+        _writer.Begin(API_CALL_CLEAR_UNORDERED_ACCESS_VIEW);
+        _writer.PutUInt(id);
+        _writer.PutUInt(1);
+        for (int i = 0; i < 4; ++i)
+        {
+            UINT bits;
+            memcpy(&bits, &values[i], sizeof(bits));
+            _writer.PutUInt(bits);
+        }
+        _writer.End();
+    }
+    _context->ClearUnorderedAccessViewFloat(unorderedAccessView, values);
+}
+
+//--------------------------------------------------------------------------------------
+// Command lists and the whole context
+//--------------------------------------------------------------------------------------
+void CaptureContext::ExecuteCommandList(ID3D11CommandList* commandList, BOOL restoreContextState)
+{
+    if (_recording)
+    {
+        UINT64 id = Id(commandList, API_OBJECT_COMMAND_LIST);
+
+        _writer.Begin(API_CALL_EXECUTE_COMMAND_LIST);
+        _writer.PutUInt(id);
+        _writer.PutUInt(restoreContextState ? 1 : 0);
+        _writer.End();
+    }
+    _context->ExecuteCommandList(commandList, restoreContextState);
+}
+
+HRESULT CaptureContext::FinishCommandList(BOOL restoreDeferredContextState, ID3D11CommandList** commandList)
+{
+    HRESULT hr = _context->FinishCommandList(restoreDeferredContextState, commandList);
+    if (_recording)
+    {
+        _writer.Begin(API_CALL_FINISH_COMMAND_LIST);
+        _writer.PutUInt(restoreDeferredContextState ? 1 : 0);
+        _writer.PutInt(hr);
+        _writer.End();
+    }
+    return hr;
+}
+
+void CaptureContext::ClearState()
+{
+    if (_recording)
+    {
+        _writer.Begin(API_CALL_CLEAR_STATE);
+        _writer.End();
+    }
+    _topology = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
+    _context->ClearState();
+}
+
+void CaptureContext::Flush()
+{
+    if (_recording)
+    {
+        _writer.Begin(API_CALL_FLUSH);
+        _writer.End();
+    }
+    _context->Flush();
+}
+
+//--------------------------------------------------------------------------------------
+// Forwarded only
+//--------------------------------------------------------------------------------------
+void CaptureContext::VSGetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer** buffers)
+{
+    _context->VSGetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void CaptureContext::VSGetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView** views)
+{
+    _context->VSGetShaderResources(startSlot, numViews, views);
+}
+
+void CaptureContext::VSGetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState** samplers)
+{
+    _context->VSGetSamplers(startSlot, numSamplers, samplers);
+}
+
+void CaptureContext::VSGetShader(ID3D11VertexShader** shader, ID3D11ClassInstance** classInstances, UINT* numClassInstances)
+{
+    _context->VSGetShader(shader, classInstances, numClassInstances);
+}
+
+void CaptureContext::HSGetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer** buffers)
+{
+    _context->HSGetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void CaptureContext::HSGetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView** views)
+{
+    _context->HSGetShaderResources(startSlot, numViews, views);
+}
+
+void CaptureContext::HSGetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState** samplers)
+{
+    _context->HSGetSamplers(startSlot, numSamplers, samplers);
+}
+
+void CaptureContext::HSGetShader(ID3D11HullShader** shader, ID3D11ClassInstance** classInstances, UINT* numClassInstances)
+{
+    _context->HSGetShader(shader, classInstances, numClassInstances);
+}
+
+void CaptureContext::DSGetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer** buffers)
+{
+    _context->DSGetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void CaptureContext::DSGetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView** views)
+{
+    _context->DSGetShaderResources(startSlot, numViews, views);
+}
+
+void CaptureContext::DSGetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState** samplers)
+{
+    _context->DSGetSamplers(startSlot, numSamplers, samplers);
+}
+
+void CaptureContext::DSGetShader(ID3D11DomainShader** shader, ID3D11ClassInstance** classInstances, UINT* numClassInstances)
+{
+    _context->DSGetShader(shader, classInstances, numClassInstances);
+}
+
+void CaptureContext::GSGetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer** buffers)
+{
+    _context->GSGetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void CaptureContext::GSGetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView** views)
+{
+    _context->GSGetShaderResources(startSlot, numViews, views);
+}
+
+void CaptureContext::GSGetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState** samplers)
+{
+    _context->GSGetSamplers(startSlot, numSamplers, samplers);
+}
+
+void CaptureContext::GSGetShader(ID3D11GeometryShader** shader, ID3D11ClassInstance** classInstances, UINT* numClassInstances)
+{
+    _context->GSGetShader(shader, classInstances, numClassInstances);
+}
+
+void CaptureContext::PSGetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer** buffers)
+{
+    _context->PSGetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void CaptureContext::PSGetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView** views)
+{
+    _context->PSGetShaderResources(startSlot, numViews, views);
+}
+
+void CaptureContext::PSGetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState** samplers)
+{
+    _context->PSGetSamplers(startSlot, numSamplers, samplers);
+}
+
+void CaptureContext::PSGetShader(ID3D11PixelShader** shader, ID3D11ClassInstance** classInstances, UINT* numClassInstances)
+{
+    _context->PSGetShader(shader, classInstances, numClassInstances);
+}
+
+void CaptureContext::CSGetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer** buffers)
+{
+    _context->CSGetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void CaptureContext::CSGetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView** views)
+{
+    _context->CSGetShaderResources(startSlot, numViews, views);
+}
+
+void CaptureContext::CSGetUnorderedAccessViews(UINT startSlot, UINT numUAVs, ID3D11UnorderedAccessView** unorderedAccessViews)
+{
+    _context->CSGetUnorderedAccessViews(startSlot, numUAVs, unorderedAccessViews);
+}
+
+void CaptureContext::CSGetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState** samplers)
+{
+    _context->CSGetSamplers(startSlot, numSamplers, samplers);
+}
+
+void CaptureContext::CSGetShader(ID3D11ComputeShader** shader, ID3D11ClassInstance** classInstances, UINT* numClassInstances)
+{
+    _context->CSGetShader(shader, classInstances, numClassInstances);
+}
+
+void CaptureContext::IAGetInputLayout(ID3D11InputLayout** inputLayout)
+{
+    _context->IAGetInputLayout(inputLayout);
+}
+
+void CaptureContext::IAGetVertexBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer** vertexBuffers, UINT* strides, UINT* offsets)
+{
+    _context->IAGetVertexBuffers(startSlot, numBuffers, vertexBuffers, strides, offsets);
+}
+
+void CaptureContext::IAGetIndexBuffer(ID3D11Buffer** indexBuffer, DXGI_FORMAT* format, UINT* offset)
+{
+    _context->IAGetIndexBuffer(indexBuffer, format, offset);
+}
+
+void CaptureContext::IAGetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY* topology)
+{
+    _context->IAGetPrimitiveTopology(topology);
+}
+
+void CaptureContext::GetPredication(ID3D11Predicate** predicate, BOOL* predicateValue)
+{
+    _context->GetPredication(predicate, predicateValue);
+}
+
+void CaptureContext::OMGetRenderTargets(UINT numViews, ID3D11RenderTargetView** renderTargetViews,
+                                        ID3D11DepthStencilView** depthStencilView)
+{
+    _context->OMGetRenderTargets(numViews, renderTargetViews, depthStencilView);
+}
+
+void CaptureContext::OMGetRenderTargetsAndUnorderedAccessViews(UINT numRTVs, ID3D11RenderTargetView** renderTargetViews,
+                                                               ID3D11DepthStencilView** depthStencilView, UINT uavStartSlot,
+                                                               UINT numUAVs, ID3D11UnorderedAccessView** unorderedAccessViews)
+{
+    _context->OMGetRenderTargetsAndUnorderedAccessViews(numRTVs, renderTargetViews, depthStencilView, uavStartSlot, numUAVs,
+                                                        unorderedAccessViews);
+}
+
+void CaptureContext::OMGetBlendState(ID3D11BlendState** blendState, FLOAT blendFactor[4], UINT* sampleMask)
+{
+    _context->OMGetBlendState(blendState, blendFactor, sampleMask);
+}
+
+void CaptureContext::OMGetDepthStencilState(ID3D11DepthStencilState** depthStencilState, UINT* stencilRef)
+{
+    _context->OMGetDepthStencilState(depthStencilState, stencilRef);
+}
+
+void CaptureContext::SOGetTargets(UINT numBuffers, ID3D11Buffer** targets)
+{
+    _context->SOGetTargets(numBuffers, targets);
+}
+
+void CaptureContext::RSGetState(ID3D11RasterizerState** rasterizerState)
+{
+    _context->RSGetState(rasterizerState);
+}
+
+void CaptureContext::RSGetViewports(UINT* numViewports, D3D11_VIEWPORT* viewports)
+{
+    _context->RSGetViewports(numViewports, viewports);
+}
+
+void CaptureContext::RSGetScissorRects(UINT* numRects, D3D11_RECT* rects)
+{
+    _context->RSGetScissorRects(numRects, rects);
+}
+
+D3D11_DEVICE_CONTEXT_TYPE CaptureContext::GetType()
+{
+    return _context->GetType();
+}
+
+UINT CaptureContext::GetContextFlags()
+{
+    return _context->GetContextFlags();
+}
+
+FLOAT CaptureContext::GetResourceMinLOD(ID3D11Resource* resource)
+{
+    return _context->GetResourceMinLOD(resource);
+}
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <windows.h>
+#include <d3d11_1.h>
+#include <vector>
+#include <unordered_map>
+
+#include "ApiTrace.h"
+#include "FrameStats.h"
+
+using namespace std;
+
+// stands in for the immediate context, forwarding every call to the real one. it counts
+// the draws, binds and constant buffer uploads of every call that goes through it into
+// FrameStats and, while a frame is being captured, writes the calls that change state or
+// do work to an API trace.
+// objects get ids by address the first time a captured call uses them (an address freed
+// and reused during the capture keeps its first id). Get calls aren't recorded, and
+// QueryInterface for anything past ID3D11DeviceContext hands out the real context
+class CaptureContext : public ID3D11DeviceContext
+{
+public:
+	// takes a reference on context
+	CaptureContext(ID3D11DeviceContext* context);
+
+	// the next frameCount frames go to fileName
+	HRESULT Open(const wchar_t* fileName, UINT frameCount);
+	// calls between these are captured while frames remain, the last frame closes the file
+	void BeginFrame();
+	void EndFrame();
+	bool IsCapturing() const { return _writer.IsOpen(); }
+	// where the counts go, null to stop counting
+	void SetStats(FrameStats* stats) { _stats = stats; }
+
+	ID3D11DeviceContext* GetContext() const { return _context; }
+
+	// IUnknown
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) override;
+	ULONG STDMETHODCALLTYPE AddRef() override;
+	ULONG STDMETHODCALLTYPE Release() override;
+
+	// ID3D11DeviceChild
+	void STDMETHODCALLTYPE GetDevice(ID3D11Device** device) override;
+	HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID guid, UINT* dataSize, void* data) override;
+	HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID guid, UINT dataSize, const void* data) override;
+	HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID guid, const IUnknown* data) override;
+
+	// captured
+	void STDMETHODCALLTYPE VSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void STDMETHODCALLTYPE PSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void STDMETHODCALLTYPE PSSetShader(ID3D11PixelShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void STDMETHODCALLTYPE PSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+	void STDMETHODCALLTYPE VSSetShader(ID3D11VertexShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void STDMETHODCALLTYPE DrawIndexed(UINT indexCount, UINT startIndexLocation, INT baseVertexLocation) override;
+	void STDMETHODCALLTYPE Draw(UINT vertexCount, UINT startVertexLocation) override;
+	HRESULT STDMETHODCALLTYPE Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT mapFlags,
+	                              D3D11_MAPPED_SUBRESOURCE* mappedResource) override;
+	void STDMETHODCALLTYPE Unmap(ID3D11Resource* resource, UINT subresource) override;
+	void STDMETHODCALLTYPE PSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void STDMETHODCALLTYPE IASetInputLayout(ID3D11InputLayout* inputLayout) override;
+	void STDMETHODCALLTYPE IASetVertexBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* vertexBuffers,
+	                                          const UINT* strides, const UINT* offsets) override;
+	void STDMETHODCALLTYPE IASetIndexBuffer(ID3D11Buffer* indexBuffer, DXGI_FORMAT format, UINT offset) override;
+	void STDMETHODCALLTYPE DrawIndexedInstanced(UINT indexCountPerInstance, UINT instanceCount, UINT startIndexLocation,
+	                                            INT baseVertexLocation, UINT startInstanceLocation) override;
+	void STDMETHODCALLTYPE DrawInstanced(UINT vertexCountPerInstance, UINT instanceCount, UINT startVertexLocation,
+	                                     UINT startInstanceLocation) override;
+	void STDMETHODCALLTYPE GSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void STDMETHODCALLTYPE GSSetShader(ID3D11GeometryShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void STDMETHODCALLTYPE IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology) override;
+	void STDMETHODCALLTYPE VSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void STDMETHODCALLTYPE VSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+	void STDMETHODCALLTYPE Begin(ID3D11Asynchronous* async) override;
+	void STDMETHODCALLTYPE End(ID3D11Asynchronous* async) override;
+	HRESULT STDMETHODCALLTYPE GetData(ID3D11Asynchronous* async, void* data, UINT dataSize, UINT getDataFlags) override;
+	void STDMETHODCALLTYPE SetPredication(ID3D11Predicate* predicate, BOOL predicateValue) override;
+	void STDMETHODCALLTYPE GSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void STDMETHODCALLTYPE GSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+	void STDMETHODCALLTYPE OMSetRenderTargets(UINT numViews, ID3D11RenderTargetView* const* renderTargetViews,
+	                                          ID3D11DepthStencilView* depthStencilView) override;
+	void STDMETHODCALLTYPE OMSetRenderTargetsAndUnorderedAccessViews(UINT numRTVs, ID3D11RenderTargetView* const* renderTargetViews,
+	                                                                 ID3D11DepthStencilView* depthStencilView, UINT uavStartSlot, UINT numUAVs,
+	                                                                 ID3D11UnorderedAccessView* const* unorderedAccessViews,
+	                                                                 const UINT* uavInitialCounts) override;
+	void STDMETHODCALLTYPE OMSetBlendState(ID3D11BlendState* blendState, const FLOAT blendFactor[4], UINT sampleMask) override;
+	void STDMETHODCALLTYPE OMSetDepthStencilState(ID3D11DepthStencilState* depthStencilState, UINT stencilRef) override;
+	void STDMETHODCALLTYPE SOSetTargets(UINT numBuffers, ID3D11Buffer* const* targets, const UINT* offsets) override;
+	void STDMETHODCALLTYPE DrawAuto() override;
+	void STDMETHODCALLTYPE DrawIndexedInstancedIndirect(ID3D11Buffer* bufferForArgs, UINT alignedByteOffsetForArgs) override;
+	void STDMETHODCALLTYPE DrawInstancedIndirect(ID3D11Buffer* bufferForArgs, UINT alignedByteOffsetForArgs) override;
+	void STDMETHODCALLTYPE Dispatch(UINT threadGroupCountX, UINT threadGroupCountY, UINT threadGroupCountZ) override;
+	void STDMETHODCALLTYPE DispatchIndirect(ID3D11Buffer* bufferForArgs, UINT alignedByteOffsetForArgs) override;
+	void STDMETHODCALLTYPE RSSetState(ID3D11RasterizerState* rasterizerState) override;
+	void STDMETHODCALLTYPE RSSetViewports(UINT numViewports, const D3D11_VIEWPORT* viewports) override;
+	void STDMETHODCALLTYPE RSSetScissorRects(UINT numRects, const D3D11_RECT* rects) override;
+	void STDMETHODCALLTYPE CopySubresourceRegion(ID3D11Resource* dstResource, UINT dstSubresource, UINT dstX, UINT dstY, UINT dstZ,
+	                                             ID3D11Resource* srcResource, UINT srcSubresource, const D3D11_BOX* srcBox) override;
+	void STDMETHODCALLTYPE CopyResource(ID3D11Resource* dstResource, ID3D11Resource* srcResource) override;
+	void STDMETHODCALLTYPE UpdateSubresource(ID3D11Resource* dstResource, UINT dstSubresource, const D3D11_BOX* dstBox,
+	                                         const void* srcData, UINT srcRowPitch, UINT srcDepthPitch) override;
+	void STDMETHODCALLTYPE CopyStructureCount(ID3D11Buffer* dstBuffer, UINT dstAlignedByteOffset, ID3D11UnorderedAccessView* srcView) override;
+	void STDMETHODCALLTYPE ClearRenderTargetView(ID3D11RenderTargetView* renderTargetView, const FLOAT colorRGBA[4]) override;
+	void STDMETHODCALLTYPE ClearUnorderedAccessViewUint(ID3D11UnorderedAccessView* unorderedAccessView, const UINT values[4]) override;
+	void STDMETHODCALLTYPE ClearUnorderedAccessViewFloat(ID3D11UnorderedAccessView* unorderedAccessView, const FLOAT values[4]) override;
+	void STDMETHODCALLTYPE ClearDepthStencilView(ID3D11DepthStencilView* depthStencilView, UINT clearFlags, FLOAT depth, UINT8 stencil) override;
+	void STDMETHODCALLTYPE GenerateMips(ID3D11ShaderResourceView* shaderResourceView) override;
+	void STDMETHODCALLTYPE SetResourceMinLOD(ID3D11Resource* resource, FLOAT minLOD) override;
+	void STDMETHODCALLTYPE ResolveSubresource(ID3D11Resource* dstResource, UINT dstSubresource, ID3D11Resource* srcResource,
+	                                          UINT srcSubresource, DXGI_FORMAT format) override;
+	void STDMETHODCALLTYPE ExecuteCommandList(ID3D11CommandList* commandList, BOOL restoreContextState) override;
+	void STDMETHODCALLTYPE HSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void STDMETHODCALLTYPE HSSetShader(ID3D11HullShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void STDMETHODCALLTYPE HSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+	void STDMETHODCALLTYPE HSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void STDMETHODCALLTYPE DSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void STDMETHODCALLTYPE DSSetShader(ID3D11DomainShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void STDMETHODCALLTYPE DSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+	void STDMETHODCALLTYPE DSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void STDMETHODCALLTYPE CSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* views) override;
+	void STDMETHODCALLTYPE CSSetUnorderedAccessViews(UINT startSlot, UINT numUAVs, ID3D11UnorderedAccessView* const* unorderedAccessViews,
+	                                                 const UINT* uavInitialCounts) override;
+	void STDMETHODCALLTYPE CSSetShader(ID3D11ComputeShader* shader, ID3D11ClassInstance* const* classInstances, UINT numClassInstances) override;
+	void STDMETHODCALLTYPE CSSetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState* const* samplers) override;
+	void STDMETHODCALLTYPE CSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* buffers) override;
+	void STDMETHODCALLTYPE ClearState() override;
+	void STDMETHODCALLTYPE Flush() override;
+	HRESULT STDMETHODCALLTYPE FinishCommandList(BOOL restoreDeferredContextState, ID3D11CommandList** commandList) override;
+
+	// forwarded only
+	void STDMETHODCALLTYPE VSGetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer** buffers) override;
+	void STDMETHODCALLTYPE PSGetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView** views) override;
+	void STDMETHODCALLTYPE PSGetShader(ID3D11PixelShader** shader, ID3D11ClassInstance** classInstances, UINT* numClassInstances) override;
+	void STDMETHODCALLTYPE PSGetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState** samplers) override;
+	void STDMETHODCALLTYPE VSGetShader(ID3D11VertexShader** shader, ID3D11ClassInstance** classInstances, UINT* numClassInstances) override;
+	void STDMETHODCALLTYPE PSGetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer** buffers) override;
+	void STDMETHODCALLTYPE IAGetInputLayout(ID3D11InputLayout** inputLayout) override;
+	void STDMETHODCALLTYPE IAGetVertexBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer** vertexBuffers, UINT* strides, UINT* offsets) override;
+	void STDMETHODCALLTYPE IAGetIndexBuffer(ID3D11Buffer** indexBuffer, DXGI_FORMAT* format, UINT* offset) override;
+	void STDMETHODCALLTYPE GSGetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer** buffers) override;
+	void STDMETHODCALLTYPE GSGetShader(ID3D11GeometryShader** shader, ID3D11ClassInstance** classInstances, UINT* numClassInstances) override;
+	void STDMETHODCALLTYPE IAGetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY* topology) override;
+	void STDMETHODCALLTYPE VSGetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView** views) override;
+	void STDMETHODCALLTYPE VSGetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState** samplers) override;
+	void STDMETHODCALLTYPE GetPredication(ID3D11Predicate** predicate, BOOL* predicateValue) override;
+	void STDMETHODCALLTYPE GSGetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView** views) override;
+	void STDMETHODCALLTYPE GSGetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState** samplers) override;
+	void STDMETHODCALLTYPE OMGetRenderTargets(UINT numViews, ID3D11RenderTargetView** renderTargetViews,
+	                                          ID3D11DepthStencilView** depthStencilView) override;
+	void STDMETHODCALLTYPE OMGetRenderTargetsAndUnorderedAccessViews(UINT numRTVs, ID3D11RenderTargetView** renderTargetViews,
+	                                                                 ID3D11DepthStencilView** depthStencilView, UINT uavStartSlot,
+	                                                                 UINT numUAVs, ID3D11UnorderedAccessView** unorderedAccessViews) override;
+	void STDMETHODCALLTYPE OMGetBlendState(ID3D11BlendState** blendState, FLOAT blendFactor[4], UINT* sampleMask) override;
+	void STDMETHODCALLTYPE OMGetDepthStencilState(ID3D11DepthStencilState** depthStencilState, UINT* stencilRef) override;
+	void STDMETHODCALLTYPE SOGetTargets(UINT numBuffers, ID3D11Buffer** targets) override;
+	void STDMETHODCALLTYPE RSGetState(ID3D11RasterizerState** rasterizerState) override;
+	void STDMETHODCALLTYPE RSGetViewports(UINT* numViewports, D3D11_VIEWPORT* viewports) override;
+	void STDMETHODCALLTYPE RSGetScissorRects(UINT* numRects, D3D11_RECT* rects) override;
+	void STDMETHODCALLTYPE HSGetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView** views) override;
+	void STDMETHODCALLTYPE HSGetShader(ID3D11HullShader** shader, ID3D11ClassInstance** classInstances, UINT* numClassInstances) override;
+	void STDMETHODCALLTYPE HSGetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState** samplers) override;
+	void STDMETHODCALLTYPE HSGetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer** buffers) override;
+	void STDMETHODCALLTYPE DSGetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView** views) override;
+	void STDMETHODCALLTYPE DSGetShader(ID3D11DomainShader** shader, ID3D11ClassInstance** classInstances, UINT* numClassInstances) override;
+	void STDMETHODCALLTYPE DSGetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState** samplers) override;
+	void STDMETHODCALLTYPE DSGetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer** buffers) override;
+	void STDMETHODCALLTYPE CSGetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView** views) override;
+	void STDMETHODCALLTYPE CSGetUnorderedAccessViews(UINT startSlot, UINT numUAVs, ID3D11UnorderedAccessView** unorderedAccessViews) override;
+	void STDMETHODCALLTYPE CSGetShader(ID3D11ComputeShader** shader, ID3D11ClassInstance** classInstances, UINT* numClassInstances) override;
+	void STDMETHODCALLTYPE CSGetSamplers(UINT startSlot, UINT numSamplers, ID3D11SamplerState** samplers) override;
+	void STDMETHODCALLTYPE CSGetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer** buffers) override;
+	D3D11_DEVICE_CONTEXT_TYPE STDMETHODCALLTYPE GetType() override;
+	UINT STDMETHODCALLTYPE GetContextFlags() override;
+	FLOAT STDMETHODCALLTYPE GetResourceMinLOD(ID3D11Resource* resource) override;
+
+private:
+	// a write map waiting for its Unmap so what was written can go in the trace
+	struct PendingMap
+	{
+		ID3D11Resource* resource;
+		UINT subresource;
+		void* data;
+		UINT bytes;
+	};
+
+	// only Release deletes
+	~CaptureContext();
+
+	// the id of object, describing it in the trace the first time it is seen
+	UINT64 Id(ID3D11Resource* resource);
+	UINT64 Id(ID3D11View* view, ApiObjectKind kind);
+	UINT64 Id(ID3D11DeviceChild* object, ApiObjectKind kind);
+	UINT64 Id(ID3D11Buffer* buffer) { return Id((ID3D11Resource*)buffer); }
+	UINT64 Id(ID3D11ShaderResourceView* view) { return Id(view, API_OBJECT_SHADER_RESOURCE_VIEW); }
+	UINT64 Id(ID3D11RenderTargetView* view) { return Id(view, API_OBJECT_RENDER_TARGET_VIEW); }
+	UINT64 Id(ID3D11DepthStencilView* view) { return Id(view, API_OBJECT_DEPTH_STENCIL_VIEW); }
+	UINT64 Id(ID3D11UnorderedAccessView* view) { return Id(view, API_OBJECT_UNORDERED_ACCESS_VIEW); }
+	UINT64 Id(ID3D11SamplerState* sampler) { return Id(sampler, API_OBJECT_SAMPLER); }
+	void Describe(UINT64 id, ApiObjectKind kind, UINT64 bytes, UINT width, UINT height, UINT format, UINT64 resourceId);
+
+	template <class T>
+	void RecordSlots(ApiCall call, UINT stage, UINT startSlot, UINT count, T* const* objects);
+	void RecordShader(UINT stage, ID3D11DeviceChild* shader, UINT numClassInstances);
+	void RecordDrawIndirect(bool indexed, ID3D11Buffer* buffer, UINT offset);
+	void RecordQuery(ApiCall call, ID3D11Asynchronous* async);
+
+	void CountStateChange() { if (_stats) _stats->CountStateChanges(1); }
+	void CountDraw(UINT64 vertices) { if (_stats) _stats->CountDraw(GetApiPrimitiveCount(_topology, vertices)); }
+	void CountConstantUpload(ID3D11Resource* resource, const D3D11_BOX* box);
+
+	ID3D11DeviceContext* _context;
+	volatile LONG _refCount;
+
+	FrameStats* _stats;
+	// for the primitive counts
+	D3D11_PRIMITIVE_TOPOLOGY _topology;
+
+	ApiTraceWriter _writer;
+	UINT _framesLeft;
+	UINT64 _frame;
+	bool _recording;
+	unordered_map<const void*, UINT64> _objectIds;
+	vector<UINT64> _ids;
+	vector<PendingMap> _maps;
+};
@@ -0,0 +1,211 @@
+#include "CascadedShadowMap.h"
+
+CascadedShadowMap::CascadedShadowMap()
+{
+    _renderedCascades = 0;
+    _paramsDirty = true;
+    _texture = nullptr;
+    for (UINT i = 0; i < MAX_SHADOW_CASCADES; ++i)
+        _sliceViews[i] = nullptr;
+    _textureView = nullptr;
+    _sampler = nullptr;
+    _rasterizer = nullptr;
+    _paramsBuffer = nullptr;
+}
+
+CascadedShadowMap::~CascadedShadowMap()
+{
+    Release();
+}
+
+HRESULT CascadedShadowMap::Initialise(ID3D11Device* device, UINT resolution, UINT cascadeCount, float nearZ, float shadowDistance, float splitBlend)
+{
+    Release();
+
+    if (!_fitter.Init(resolution, cascadeCount, nearZ, shadowDistance, splitBlend))
+        return E_INVALIDARG;
+
+    D3D11_TEXTURE2D_DESC desc;
+    ZeroMemory(&desc, sizeof(desc));
+    desc.Width = resolution;
+    desc.Height = resolution;
+    desc.MipLevels = 1;
+    desc.ArraySize = cascadeCount;
+    desc.Format = DXGI_FORMAT_R32_TYPELESS;
+    desc.SampleDesc.Count = 1;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
+
+    HRESULT hr = device->CreateTexture2D(&desc, nullptr, &_texture);
+
+    for (UINT i = 0; i < cascadeCount && SUCCEEDED(hr); ++i)
+    {
+        D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc;
+        ZeroMemory(&dsvDesc, sizeof(dsvDesc));
+        dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
+        dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2DARRAY;
+        dsvDesc.Texture2DArray.FirstArraySlice = i;
+        dsvDesc.Texture2DArray.ArraySize = 1;
+        hr = device->CreateDepthStencilView(_texture, &dsvDesc, &_sliceViews[i]);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+        ZeroMemory(&srvDesc, sizeof(srvDesc));
+        srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
+        srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+        srvDesc.Texture2DArray.MipLevels = 1;
+        srvDesc.Texture2DArray.ArraySize = cascadeCount;
+        hr = device->CreateShaderResourceView(_texture, &srvDesc, &_textureView);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        D3D11_SAMPLER_DESC sampDesc;
+        ZeroMemory(&sampDesc, sizeof(sampDesc));
+        sampDesc.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
+        sampDesc.AddressU = D3D11_TEXTURE_ADDRESS_BORDER;
+        sampDesc.AddressV = D3D11_TEXTURE_ADDRESS_BORDER;
+        sampDesc.AddressW = D3D11_TEXTURE_ADDRESS_BORDER;
+        sampDesc.BorderColor[0] = 1.0f;
+        sampDesc.ComparisonFunc = D3D11_COMPARISON_LESS_EQUAL;
+        sampDesc.MaxLOD = D3D11_FLOAT32_MAX;
+        hr = device->CreateSamplerState(&sampDesc, &_sampler);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        // no culling, the ground plane is single sided and faces away from the light.
+        // slope scaled bias keeps surfaces at a grazing angle from shadowing themselves
+        D3D11_RASTERIZER_DESC rasterDesc;
+        ZeroMemory(&rasterDesc, sizeof(rasterDesc));
+        rasterDesc.FillMode = D3D11_FILL_SOLID;
+        rasterDesc.CullMode = D3D11_CULL_NONE;
+        rasterDesc.DepthBias = 1000;
+        rasterDesc.SlopeScaledDepthBias = 2.0f;
+        rasterDesc.DepthClipEnable = TRUE;
+        hr = device->CreateRasterizerState(&rasterDesc, &_rasterizer);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        D3D11_BUFFER_DESC bd;
+        ZeroMemory(&bd, sizeof(bd));
+        bd.Usage = D3D11_USAGE_DEFAULT;
+        bd.ByteWidth = sizeof(ShadowParams);
+        bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        hr = device->CreateBuffer(&bd, nullptr, &_paramsBuffer);
+    }
+
+    if (FAILED(hr))
+        Release();
+
+    return hr;
+}
+
+void CascadedShadowMap::Release()
+{
+    for (UINT i = 0; i < MAX_SHADOW_CASCADES; ++i)
+    {
+        if (_sliceViews[i]) _sliceViews[i]->Release();
+        _sliceViews[i] = nullptr;
+    }
+
+    if (_textureView) _textureView->Release();
+    if (_texture) _texture->Release();
+    if (_sampler) _sampler->Release();
+    if (_rasterizer) _rasterizer->Release();
+    if (_paramsBuffer) _paramsBuffer->Release();
+
+    _textureView = nullptr;
+    _texture = nullptr;
+    _sampler = nullptr;
+    _rasterizer = nullptr;
+    _paramsBuffer = nullptr;
+}
+
+void CascadedShadowMap::Invalidate()
+{
+    _fitter.Invalidate();
+}
+
+void CascadedShadowMap::Update(const XMFLOAT4X4& view, const XMFLOAT4X4& projection, const XMFLOAT3& lightDirection)
+{
+    _renderedCascades = 0;
+    _paramsDirty = true;
+
+    _fitter.Update(&view._11, &projection._11, &lightDirection.x);
+}
+
+bool CascadedShadowMap::IsCasterInCascade(UINT cascade, const XMFLOAT3& centre, float radius) const
+{
+    return _fitter.IsCasterInCascade(cascade, &centre.x, radius);
+}
+
+bool CascadedShadowMap::NeedsRender(UINT cascade, bool hasDynamicCasters) const
+{
+    return _fitter.NeedsRender(cascade, hasDynamicCasters);
+}
+
+void CascadedShadowMap::BeginCascade(ID3D11DeviceContext* context, UINT cascade)
+{
+    // can't be read while it is being drawn to
+    ID3D11ShaderResourceView* nullView = nullptr;
+    context->PSSetShaderResources(10, 1, &nullView);
+
+    context->ClearDepthStencilView(_sliceViews[cascade], D3D11_CLEAR_DEPTH, 1.0f, 0);
+    context->OMSetRenderTargets(0, nullptr, _sliceViews[cascade]);
+    context->RSSetState(_rasterizer);
+
+    D3D11_VIEWPORT vp;
+    vp.Width = (FLOAT)_fitter.GetResolution();
+    vp.Height = (FLOAT)_fitter.GetResolution();
+    vp.MinDepth = 0.0f;
+    vp.MaxDepth = 1.0f;
+    vp.TopLeftX = 0;
+    vp.TopLeftY = 0;
+    context->RSSetViewports(1, &vp);
+
+    ++_renderedCascades;
+}
+
+void CascadedShadowMap::EndCascade(ID3D11DeviceContext* context, UINT cascade, bool hasDynamicCasters)
+{
+    _fitter.MarkRendered(cascade, hasDynamicCasters);
+
+    context->OMSetRenderTargets(0, nullptr, nullptr);
+}
+
+void CascadedShadowMap::Bind(ID3D11DeviceContext* context)
+{
+    if (_paramsDirty)
+    {
+        ShadowParams params;
+        ZeroMemory(&params, sizeof(params));
+
+        UINT cascadeCount = _fitter.GetCascadeCount();
+        for (UINT i = 0; i < cascadeCount; ++i)
+        {
+            XMFLOAT4X4 view = GetCascadeView(i);
+            XMFLOAT4X4 projection = GetCascadeProjection(i);
+            params.CascadeViewProjection[i] = XMMatrixTranspose(XMLoadFloat4x4(&view) * XMLoadFloat4x4(&projection));
+        }
+
+        // cascades past the count never match
+        float splits[MAX_SHADOW_CASCADES];
+        for (UINT i = 0; i < MAX_SHADOW_CASCADES; ++i)
+            splits[i] = i < cascadeCount ? _fitter.GetCascade(i).SplitFar : D3D11_FLOAT32_MAX;
+
+        params.CascadeSplits = XMFLOAT4(splits[0], splits[1], splits[2], splits[3]);
+        params.CascadeCount = cascadeCount;
+        params.DepthBias = 0.0005f;
+        params.TexelSize = 1.0f / _fitter.GetResolution();
+        context->UpdateSubresource(_paramsBuffer, 0, nullptr, &params, 0, 0);
+        _paramsDirty = false;
+    }
+
+    context->PSSetShaderResources(10, 1, &_textureView);
+    context->PSSetSamplers(1, 1, &_sampler);
+    context->PSSetConstantBuffers(4, 1, &_paramsBuffer);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <windows.h>
+#include <d3d11_1.h>
+#include <directxmath.h>
+
+#include "ShadowCascadeFitter.h"
+
+using namespace DirectX;
+
+// mirrors cbuffer ShadowParams in DX11 Framework.fx
+struct ShadowParams
+{
+	XMMATRIX CascadeViewProjection[MAX_SHADOW_CASCADES];
+	// view space depth each cascade ends at
+	XMFLOAT4 CascadeSplits;
+	UINT CascadeCount;
+	float DepthBias;
+	float TexelSize;
+	float Padding;
+};
+
+// directional light shadows split over a Texture2DArray, one slice per cascade. the
+// cascades are fitted and cached by ShadowCascadeFitter, this is the d3d side of them
+class CascadedShadowMap
+{
+public:
+	CascadedShadowMap();
+	~CascadedShadowMap();
+
+	// shadowDistance caps how far from the camera shadows reach, splitBlend mixes
+	// logarithmic (1) and even (0) cascade splits
+	HRESULT Initialise(ID3D11Device* device, UINT resolution, UINT cascadeCount, float nearZ, float shadowDistance, float splitBlend = 0.75f);
+	void Release();
+
+	// refits the cascades, lightDirection points from the scene towards the light
+	void Update(const XMFLOAT4X4& view, const XMFLOAT4X4& projection, const XMFLOAT3& lightDirection);
+
+	// static casters or the light changed, every cascade is redrawn next time
+	void Invalidate();
+
+	// whether a caster's bounding sphere can throw a shadow into the cascade
+	bool IsCasterInCascade(UINT cascade, const XMFLOAT3& centre, float radius) const;
+	// false when the cascade still holds what it would draw
+	bool NeedsRender(UINT cascade, bool hasDynamicCasters) const;
+
+	// clears the cascade's slice and binds it as the only target, depth only. draw its
+	// casters with GetCascadeView/GetCascadeProjection in between
+	void BeginCascade(ID3D11DeviceContext* context, UINT cascade);
+	void EndCascade(ID3D11DeviceContext* context, UINT cascade, bool hasDynamicCasters);
+
+	// shadow map on t10, comparison sampler on s1, parameters on b4
+	void Bind(ID3D11DeviceContext* context);
+
+	XMFLOAT4X4 GetCascadeView(UINT cascade) const { return XMFLOAT4X4(_fitter.GetCascade(cascade).View); }
+	XMFLOAT4X4 GetCascadeProjection(UINT cascade) const { return XMFLOAT4X4(_fitter.GetCascade(cascade).Projection); }
+	UINT GetCascadeCount() const { return _fitter.GetCascadeCount(); }
+	// cascades drawn on the last frame, for profiling the cache
+	UINT GetRenderedCascades() const { return _renderedCascades; }
+
+private:
+	ShadowCascadeFitter _fitter;
+	UINT _renderedCascades;
+	bool _paramsDirty;
+
+	ID3D11Texture2D* _texture;
+	ID3D11DepthStencilView* _sliceViews[MAX_SHADOW_CASCADES];
+	ID3D11ShaderResourceView* _textureView;
+	ID3D11SamplerState* _sampler;
+	ID3D11RasterizerState* _rasterizer;
+	ID3D11Buffer* _paramsBuffer;
+};
@@ -0,0 +1,148 @@
+#include "ChannelPacking.h"
+#include "DDSTextureLoader.h"
+#include <memory>
+#include <vector>
+
+using namespace DirectX;
+using namespace std;
+
+// byte of each of r, g, b, a within a texel
+static bool GetChannelBytes(DXGI_FORMAT format, UINT bytes[4])
+{
+    switch (format)
+    {
+    case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+    case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+        bytes[0] = 0; bytes[1] = 1; bytes[2] = 2; bytes[3] = 3;
+        return true;
+
+    case DXGI_FORMAT_B8G8R8A8_TYPELESS:
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+    case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+    case DXGI_FORMAT_B8G8R8X8_UNORM:
+        bytes[0] = 2; bytes[1] = 1; bytes[2] = 0; bytes[3] = 3;
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+struct PackSource
+{
+    unique_ptr<uint8_t[]> ddsData;
+    D3D11_TEXTURE2D_DESC desc;
+    vector<D3D11_SUBRESOURCE_DATA> initData;
+    UINT channelBytes[4];
+};
+
+HRESULT WriteChannelPackedTexture(const wchar_t* packedFileName, const PackedChannel channels[4])
+{
+    if (!packedFileName || !channels || !channels[0].fileName)
+        return E_INVALIDARG;
+
+    // load each file once even when it feeds several channels
+    vector<PackSource> sources;
+    vector<const wchar_t*> sourceNames;
+    UINT sourceOf[4];
+
+    for (UINT channel = 0; channel < 4; ++channel)
+    {
+        sourceOf[channel] = UINT_MAX;
+        if (!channels[channel].fileName)
+            continue;
+
+        if (channels[channel].channel > 3)
+            return E_INVALIDARG;
+
+        UINT source = 0;
+        while (source < sourceNames.size() && _wcsicmp(sourceNames[source], channels[channel].fileName) != 0)
+            ++source;
+
+        if (source == sourceNames.size())
+        {
+            PackSource loaded;
+            HRESULT hr = LoadDDSTextureDataFromFile(channels[channel].fileName, loaded.ddsData, &loaded.desc, loaded.initData);
+            if (FAILED(hr))
+                return hr;
+
+            if (!GetChannelBytes(loaded.desc.Format, loaded.channelBytes))
+                return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+            if (!sources.empty() && (loaded.desc.Width != sources[0].desc.Width || loaded.desc.Height != sources[0].desc.Height ||
+                                     loaded.desc.MipLevels != sources[0].desc.MipLevels || loaded.desc.ArraySize != sources[0].desc.ArraySize))
+            {
+                return E_INVALIDARG;
+            }
+
+            sources.push_back(move(loaded));
+            sourceNames.push_back(channels[channel].fileName);
+        }
+
+        sourceOf[channel] = source;
+    }
+
+    // the first source is rewritten in place and written out with its own header
+    PackSource& target = sources[0];
+    vector<uint8_t> packed;
+
+    for (UINT subresource = 0; subresource < target.initData.size(); ++subresource)
+    {
+        const D3D11_SUBRESOURCE_DATA& surface = target.initData[subresource];
+        UINT texels = surface.SysMemSlicePitch / 4;
+        packed.resize(surface.SysMemSlicePitch);
+
+        for (UINT channel = 0; channel < 4; ++channel)
+        {
+            uint8_t* out = packed.data() + target.channelBytes[channel];
+
+            if (sourceOf[channel] == UINT_MAX)
+            {
+                for (UINT i = 0; i < texels; ++i)
+                    out[i * 4] = channels[channel].fill;
+                continue;
+            }
+
+            const PackSource& source = sources[sourceOf[channel]];
+            const uint8_t* in = (const uint8_t*)source.initData[subresource].pSysMem + source.channelBytes[channels[channel].channel];
+
+            for (UINT i = 0; i < texels; ++i)
+                out[i * 4] = in[i * 4];
+        }
+
+        memcpy((void*)surface.pSysMem, packed.data(), packed.size());
+    }
+
+    const D3D11_SUBRESOURCE_DATA& last = target.initData.back();
+    size_t fileSize = ((const uint8_t*)last.pSysMem - target.ddsData.get()) + last.SysMemSlicePitch;
+
+    HANDLE file = CreateFileW(packedFileName, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    DWORD written = 0;
+    bool ok = WriteFile(file, target.ddsData.get(), (DWORD)fileSize, &written, nullptr) && written == fileSize;
+    CloseHandle(file);
+
+    return ok ? S_OK : E_FAIL;
+}
+
+bool IsChannelPackedTextureStale(const wchar_t* packedFileName, const PackedChannel channels[4])
+{
+    WIN32_FILE_ATTRIBUTE_DATA packed;
+    if (!GetFileAttributesExW(packedFileName, GetFileExInfoStandard, &packed))
+        return true;
+
+    for (UINT channel = 0; channel < 4; ++channel)
+    {
+        WIN32_FILE_ATTRIBUTE_DATA source;
+        if (channels[channel].fileName && GetFileAttributesExW(channels[channel].fileName, GetFileExInfoStandard, &source) &&
+            CompareFileTime(&source.ftLastWriteTime, &packed.ftLastWriteTime) > 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
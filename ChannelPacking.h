@@ -0,0 +1,21 @@
+#pragma once
+
+#include <windows.h>
+#include <d3d11_1.h>
+
+// where one channel of a packed texture comes from, a channel (0 = red .. 3 = alpha)
+// of another 8 bit rgba dds file, or a constant when fileName is null
+struct PackedChannel
+{
+	const wchar_t* fileName;
+	UINT channel;
+	BYTE fill;
+};
+
+// offline, combines up to four single channel maps into one 8 bit rgba dds so the
+// pixel shader fetches them all at once. every source must match in size, mip count and
+// array size, the packed file takes its header (and so its format) from the first source
+HRESULT WriteChannelPackedTexture(const wchar_t* packedFileName, const PackedChannel channels[4]);
+
+// true when the packed file is missing or older than any of its sources
+bool IsChannelPackedTextureStale(const wchar_t* packedFileName, const PackedChannel channels[4]);
@@ -0,0 +1,150 @@
+#include "ClusteredLighting.h"
+#include <algorithm>
+#include <math.h>
+
+//--------------------------------------------------------------------------------------
+// ClusteredLighting
+//--------------------------------------------------------------------------------------
+ClusteredLighting::ClusteredLighting()
+{
+    _maxLights = 0;
+    _viewportScale = 1.0f;
+    _lightBuffer = nullptr;
+    _lightView = nullptr;
+    _clusterBuffer = nullptr;
+    _clusterView = nullptr;
+    _indexBuffer = nullptr;
+    _indexView = nullptr;
+    _paramsBuffer = nullptr;
+}
+
+ClusteredLighting::~ClusteredLighting()
+{
+    Release();
+}
+
+HRESULT ClusteredLighting::CreateBuffer(ID3D11Device* device, UINT elements, UINT elementSize, DXGI_FORMAT format,
+                                        ID3D11Buffer** buffer, ID3D11ShaderResourceView** view)
+{
+    D3D11_BUFFER_DESC bd;
+    ZeroMemory(&bd, sizeof(bd));
+    bd.Usage = D3D11_USAGE_DYNAMIC;
+    bd.ByteWidth = elements * elementSize;
+    bd.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    HRESULT hr = device->CreateBuffer(&bd, nullptr, buffer);
+    if (FAILED(hr))
+        return hr;
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+    ZeroMemory(&srvDesc, sizeof(srvDesc));
+    srvDesc.Format = format;
+    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+    srvDesc.Buffer.FirstElement = 0;
+    srvDesc.Buffer.NumElements = elements;
+
+    return device->CreateShaderResourceView(*buffer, &srvDesc, view);
+}
+
+HRESULT ClusteredLighting::Initialise(ID3D11Device* device, UINT screenWidth, UINT screenHeight, float nearZ, float farZ, UINT maxLights)
+{
+    Release();
+
+    _maxLights = maxLights;
+    _builder.Init(screenWidth, screenHeight, nearZ, farZ);
+
+    // two float4 per light: position and radius, colour times intensity
+    HRESULT hr = CreateBuffer(device, maxLights * 2, sizeof(XMFLOAT4), DXGI_FORMAT_R32G32B32A32_FLOAT, &_lightBuffer, &_lightView);
+    if (SUCCEEDED(hr))
+        hr = CreateBuffer(device, _builder.GetClusterCount(), sizeof(UINT) * 2, DXGI_FORMAT_R32G32_UINT, &_clusterBuffer, &_clusterView);
+    if (SUCCEEDED(hr))
+        hr = CreateBuffer(device, _builder.GetMaxIndices(), sizeof(UINT), DXGI_FORMAT_R32_UINT, &_indexBuffer, &_indexView);
+
+    if (SUCCEEDED(hr))
+    {
+        D3D11_BUFFER_DESC bd;
+        ZeroMemory(&bd, sizeof(bd));
+        bd.Usage = D3D11_USAGE_DEFAULT;
+        bd.ByteWidth = sizeof(ClusterParams);
+        bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        hr = device->CreateBuffer(&bd, nullptr, &_paramsBuffer);
+    }
+
+    if (FAILED(hr))
+        Release();
+
+    return hr;
+}
+
+void ClusteredLighting::Release()
+{
+    if (_lightView) _lightView->Release();
+    if (_lightBuffer) _lightBuffer->Release();
+    if (_clusterView) _clusterView->Release();
+    if (_clusterBuffer) _clusterBuffer->Release();
+    if (_indexView) _indexView->Release();
+    if (_indexBuffer) _indexBuffer->Release();
+    if (_paramsBuffer) _paramsBuffer->Release();
+
+    _lightView = nullptr;
+    _lightBuffer = nullptr;
+    _clusterView = nullptr;
+    _clusterBuffer = nullptr;
+    _indexView = nullptr;
+    _indexBuffer = nullptr;
+    _paramsBuffer = nullptr;
+}
+
+void ClusteredLighting::Update(ID3D11DeviceContext* context, const vector<PointLight>& lights, const XMFLOAT4X4& view,
+                               const XMFLOAT4X4& projection, JobSystem* jobs)
+{
+    if (!_lightBuffer)
+        return;
+
+    // lights past the buffer size are dropped before binning so no index points past it
+    _builder.Build(&lights.data()->Position.x, min((UINT)lights.size(), _maxLights), sizeof(PointLight) / sizeof(float),
+                   &view._11, &projection._11, jobs);
+
+    UINT lightCount = _builder.GetParams().LightCount;
+
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    if (SUCCEEDED(context->Map(_lightBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+    {
+        XMFLOAT4* data = (XMFLOAT4*)mapped.pData;
+        for (UINT i = 0; i < lightCount; ++i)
+        {
+            const PointLight& light = lights[i];
+            data[i * 2] = XMFLOAT4(light.Position.x, light.Position.y, light.Position.z, light.Radius);
+            data[i * 2 + 1] = XMFLOAT4(light.Colour.x * light.Intensity, light.Colour.y * light.Intensity,
+                                       light.Colour.z * light.Intensity, 0.0f);
+        }
+        context->Unmap(_lightBuffer, 0);
+    }
+
+    const FrameTaggedVector<UINT>& clusters = _builder.GetClusters();
+    if (SUCCEEDED(context->Map(_clusterBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+    {
+        memcpy(mapped.pData, clusters.data(), clusters.size() * sizeof(UINT));
+        context->Unmap(_clusterBuffer, 0);
+    }
+
+    const FrameTaggedVector<UINT>& indices = _builder.GetLightIndices();
+    if (!indices.empty() && SUCCEEDED(context->Map(_indexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+    {
+        memcpy(mapped.pData, indices.data(), indices.size() * sizeof(UINT));
+        context->Unmap(_indexBuffer, 0);
+    }
+
+    ClusterParams params = _builder.GetParams();
+    params.TileSize[0] *= _viewportScale;
+    params.TileSize[1] *= _viewportScale;
+    context->UpdateSubresource(_paramsBuffer, 0, nullptr, &params, 0, 0);
+}
+
+void ClusteredLighting::Bind(ID3D11DeviceContext* context)
+{
+    ID3D11ShaderResourceView* views[] = { _lightView, _clusterView, _indexView };
+    context->PSSetShaderResources(3, 3, views);
+    context->PSSetConstantBuffers(2, 1, &_paramsBuffer);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <windows.h>
+#include <d3d11_1.h>
+#include <directxmath.h>
+#include <vector>
+
+#include "LightClusterBuilder.h"
+
+using namespace DirectX;
+using namespace std;
+
+// the builder reads position and radius as the first four floats
+struct PointLight
+{
+	XMFLOAT3 Position;
+	float Radius;
+	XMFLOAT3 Colour;
+	float Intensity;
+};
+
+// gpu side: light data, cluster grid and light index list as typed buffers (ps_4_0 has
+// no structured buffers on 10 level hardware) refreshed every frame
+class ClusteredLighting
+{
+public:
+	ClusteredLighting();
+	~ClusteredLighting();
+
+	HRESULT Initialise(ID3D11Device* device, UINT screenWidth, UINT screenHeight, float nearZ, float farZ, UINT maxLights = 4096);
+	void Release();
+
+	void Update(ID3D11DeviceContext* context, const vector<PointLight>& lights, const XMFLOAT4X4& view,
+	            const XMFLOAT4X4& projection, JobSystem* jobs);
+
+	// light data on t3, cluster grid on t4, light indices on t5, params on b2
+	void Bind(ID3D11DeviceContext* context);
+
+	// the tiles cover the same part of the screen at any resolution, only their size in
+	// pixels changes when the scene is drawn into a scaled viewport
+	void SetViewportScale(float scale) { _viewportScale = scale; }
+
+	const LightClusterBuilder& GetBuilder() const { return _builder; }
+
+private:
+	HRESULT CreateBuffer(ID3D11Device* device, UINT elements, UINT elementSize, DXGI_FORMAT format,
+	                     ID3D11Buffer** buffer, ID3D11ShaderResourceView** view);
+
+	LightClusterBuilder _builder;
+	UINT _maxLights;
+	float _viewportScale;
+
+	ID3D11Buffer* _lightBuffer;
+	ID3D11ShaderResourceView* _lightView;
+	ID3D11Buffer* _clusterBuffer;
+	ID3D11ShaderResourceView* _clusterView;
+	ID3D11Buffer* _indexBuffer;
+	ID3D11ShaderResourceView* _indexView;
+	ID3D11Buffer* _paramsBuffer;
+};
@@ -0,0 +1,434 @@
+#include "CpuProfiler.h"
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+// binary layout, little endian:
+//   "CPRF", uint32 version, double ticks per second
+//   uint32 name count, each name a uint16 length and its bytes
+//   uint32 thread count, each thread a uint32 id, a uint16 name length and its bytes,
+//   a uint32 event count and the events. an event is a varint of 0 for an end or the
+//   name index plus one for a begin, then a varint of the ticks since the thread's
+//   previous event (the first counts from the start of the capture)
+static const uint32_t BINARY_VERSION = 1;
+
+// Stop holds on until at least this long after Start so the tick rate can be measured
+static const double MIN_CALIBRATION_SECONDS = 0.01;
+
+struct ProfileEvent
+{
+    uint64_t ticks;
+    // null for an end
+    const char* name;
+};
+
+struct ProfileThread
+{
+    vector<ProfileEvent> events;
+    atomic<uint32_t> count;
+    atomic<uint64_t> dropped;
+    uint32_t open;
+    uint32_t id;
+    const char* name;
+};
+
+atomic<bool> CpuProfiler::_recording(false);
+
+static mutex s_threadsMutex;
+static vector<unique_ptr<ProfileThread>> s_threads;
+static uint32_t s_eventsPerThread = 1 << 18;
+static uint32_t s_nextThreadId = 0;
+static uint64_t s_startTicks = 0;
+static uint64_t s_stopTicks = 0;
+static chrono::steady_clock::time_point s_startTime;
+static chrono::steady_clock::time_point s_stopTime;
+static thread_local ProfileThread* t_thread = nullptr;
+
+static ProfileThread* RegisterThread()
+{
+    lock_guard<mutex> lock(s_threadsMutex);
+
+    unique_ptr<ProfileThread> thread(new ProfileThread);
+    thread->events.resize(s_eventsPerThread);
+    thread->count = 0;
+    thread->dropped = 0;
+    thread->open = 0;
+    thread->id = s_nextThreadId++;
+    thread->name = nullptr;
+
+    t_thread = thread.get();
+    s_threads.push_back(move(thread));
+    return t_thread;
+}
+
+//--------------------------------------------------------------------------------------
+// Recording
+//--------------------------------------------------------------------------------------
+void CpuProfiler::Start(uint32_t eventsPerThread)
+{
+    lock_guard<mutex> lock(s_threadsMutex);
+
+    for (unique_ptr<ProfileThread>& thread : s_threads)
+    {
+        thread->count = 0;
+        thread->dropped = 0;
+        thread->open = 0;
+    }
+
+    s_eventsPerThread = max(eventsPerThread, 2u);
+    s_startTime = chrono::steady_clock::now();
+    s_startTicks = Now();
+    _recording = true;
+}
+
+void CpuProfiler::Stop()
+{
+    _recording = false;
+
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - s_startTime;
+    if (elapsed.count() < MIN_CALIBRATION_SECONDS)
+        this_thread::sleep_for(chrono::duration<double>(MIN_CALIBRATION_SECONDS - elapsed.count()));
+
+    s_stopTicks = Now();
+    s_stopTime = chrono::steady_clock::now();
+}
+
+bool CpuProfiler::Begin(const char* name)
+{
+    if (!_recording.load(memory_order_relaxed))
+        return false;
+
+    ProfileThread* thread = t_thread ? t_thread : RegisterThread();
+    uint32_t index = thread->count.load(memory_order_relaxed);
+
+    // room for this begin, its end and the end of every scope already open
+    if (index + thread->open + 2 > thread->events.size())
+    {
+        thread->dropped.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+
+    thread->events[index].ticks = Now();
+    thread->events[index].name = name;
+    thread->count.store(index + 1, memory_order_release);
+    thread->open++;
+    return true;
+}
+
+void CpuProfiler::End()
+{
+    ProfileThread* thread = t_thread;
+    if (!thread || thread->open == 0)
+        return;
+
+    uint32_t index = thread->count.load(memory_order_relaxed);
+    thread->events[index].ticks = Now();
+    thread->events[index].name = nullptr;
+    thread->count.store(index + 1, memory_order_release);
+    thread->open--;
+}
+
+void CpuProfiler::SetThreadName(const char* name)
+{
+    ProfileThread* thread = t_thread ? t_thread : RegisterThread();
+    thread->name = name;
+}
+
+uint64_t CpuProfiler::GetDroppedEvents()
+{
+    lock_guard<mutex> lock(s_threadsMutex);
+
+    uint64_t dropped = 0;
+    for (unique_ptr<ProfileThread>& thread : s_threads)
+        dropped += thread->dropped.load(memory_order_relaxed);
+
+    return dropped;
+}
+
+double CpuProfiler::GetTicksPerSecond()
+{
+    uint64_t stopTicks = IsRecording() ? Now() : s_stopTicks;
+    chrono::steady_clock::time_point stopTime = IsRecording() ? chrono::steady_clock::now() : s_stopTime;
+
+    chrono::duration<double> elapsed = stopTime - s_startTime;
+    return elapsed.count() > 0.0 ? (double)(stopTicks - s_startTicks) / elapsed.count() : 1.0;
+}
+
+//--------------------------------------------------------------------------------------
+// Summary
+//--------------------------------------------------------------------------------------
+vector<CpuProfileStat> CpuProfiler::Aggregate()
+{
+    double secondsPerTick = 1.0 / GetTicksPerSecond();
+
+    struct OpenScope
+    {
+        uint32_t stat;
+        uint64_t ticks;
+        uint64_t childTicks;
+    };
+
+    struct Totals
+    {
+        uint64_t inclusive;
+        uint64_t exclusive;
+        // instances open on the current thread, for scopes nested in themselves
+        uint32_t open;
+    };
+
+    lock_guard<mutex> lock(s_threadsMutex);
+
+    // names by their text, the same literal can live at different addresses
+    vector<CpuProfileStat> stats;
+    vector<Totals> totals;
+    unordered_map<string, uint32_t> statIndices;
+    vector<OpenScope> stack;
+
+    for (unique_ptr<ProfileThread>& thread : s_threads)
+    {
+        stack.clear();
+        for (Totals& total : totals)
+            total.open = 0;
+
+        uint32_t count = thread->count.load(memory_order_acquire);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const ProfileEvent& event = thread->events[i];
+
+            if (event.name)
+            {
+                auto found = statIndices.find(event.name);
+                if (found == statIndices.end())
+                {
+                    found = statIndices.emplace(event.name, (uint32_t)stats.size()).first;
+                    stats.push_back({ event.name, 0, 0.0, 0.0, 0 });
+                    totals.push_back({ 0, 0, 0 });
+                }
+
+                OpenScope scope = { found->second, event.ticks, 0 };
+                stack.push_back(scope);
+                totals[scope.stat].open++;
+                stats[scope.stat].MaxDepth = max(stats[scope.stat].MaxDepth, (uint32_t)stack.size());
+            }
+            else if (!stack.empty())
+            {
+                OpenScope scope = stack.back();
+                stack.pop_back();
+
+                uint64_t duration = event.ticks >= scope.ticks ? event.ticks - scope.ticks : 0;
+                Totals& total = totals[scope.stat];
+                if (--total.open == 0)
+                    total.inclusive += duration;
+                total.exclusive += duration >= scope.childTicks ? duration - scope.childTicks : 0;
+                stats[scope.stat].Calls++;
+
+                if (!stack.empty())
+                    stack.back().childTicks += duration;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < stats.size(); ++i)
+    {
+        stats[i].InclusiveSeconds = totals[i].inclusive * secondsPerTick;
+        stats[i].ExclusiveSeconds = totals[i].exclusive * secondsPerTick;
+    }
+
+    // a scope that never closed has nothing to report
+    stats.erase(remove_if(stats.begin(), stats.end(), [](const CpuProfileStat& stat) { return stat.Calls == 0; }), stats.end());
+    stable_sort(stats.begin(), stats.end(), [](const CpuProfileStat& a, const CpuProfileStat& b)
+    {
+        return a.InclusiveSeconds > b.InclusiveSeconds;
+    });
+
+    return stats;
+}
+
+string CpuProfiler::FormatSummary(uint32_t maxLines)
+{
+    vector<CpuProfileStat> stats = Aggregate();
+
+    string text;
+    for (size_t i = 0; i < stats.size() && i < maxLines; ++i)
+    {
+        char line[256];
+        snprintf(line, sizeof(line), "cpu %-32.32s calls %8u inclusive %10.3f ms exclusive %10.3f ms\n", stats[i].Name.c_str(),
+                 stats[i].Calls, stats[i].InclusiveSeconds * 1000.0, stats[i].ExclusiveSeconds * 1000.0);
+        text += line;
+    }
+
+    return text;
+}
+
+//--------------------------------------------------------------------------------------
+// Output
+//--------------------------------------------------------------------------------------
+static FILE* OpenOutputFile(const wchar_t* fileName, const wchar_t* mode)
+{
+#ifdef _WIN32
+    FILE* file = nullptr;
+    return _wfopen_s(&file, fileName, mode) == 0 ? file : nullptr;
+#else
+    char path[1024];
+    char narrowMode[8];
+    if (wcstombs(path, fileName, sizeof(path)) == (size_t)-1 || wcstombs(narrowMode, mode, sizeof(narrowMode)) == (size_t)-1)
+        return nullptr;
+
+    return fopen(path, narrowMode);
+#endif
+}
+
+static void WriteJsonString(FILE* file, const char* text)
+{
+    fputc('"', file);
+    for (const char* c = text; *c; ++c)
+    {
+        if (*c == '"' || *c == '\\')
+            fprintf(file, "\\%c", *c);
+        else if ((unsigned char)*c < 0x20)
+            fprintf(file, "\\u%04x", *c);
+        else
+            fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+bool CpuProfiler::WriteChromeTrace(const wchar_t* fileName)
+{
+    FILE* file = OpenOutputFile(fileName, L"wt");
+    if (!file)
+        return false;
+
+    double microsecondsPerTick = 1000000.0 / GetTicksPerSecond();
+
+    lock_guard<mutex> lock(s_threadsMutex);
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+
+    for (unique_ptr<ProfileThread>& thread : s_threads)
+    {
+        if (thread->name)
+        {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", thread->id);
+            WriteJsonString(file, thread->name);
+            fprintf(file, "}}");
+            first = false;
+        }
+
+        uint32_t count = thread->count.load(memory_order_acquire);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const ProfileEvent& event = thread->events[i];
+            double ts = (double)(int64_t)(event.ticks - s_startTicks) * microsecondsPerTick;
+
+            fprintf(file, "%s{", first ? "" : ",\n");
+            if (event.name)
+            {
+                fprintf(file, "\"name\":");
+                WriteJsonString(file, event.name);
+                fprintf(file, ",");
+            }
+            fprintf(file, "\"ph\":\"%c\",\"pid\":0,\"tid\":%u,\"ts\":%.3f}", event.name ? 'B' : 'E', thread->id, ts);
+            first = false;
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+    bool ok = ferror(file) == 0;
+    fclose(file);
+    return ok;
+}
+
+static void PutVarint(vector<uint8_t>& out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+template <typename T>
+static void Put(vector<uint8_t>& out, T value)
+{
+    const uint8_t* bytes = (const uint8_t*)&value;
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+static void PutString(vector<uint8_t>& out, const char* text)
+{
+    size_t length = text ? min(strlen(text), (size_t)0xFFFF) : 0;
+    Put(out, (uint16_t)length);
+    out.insert(out.end(), text, text + length);
+}
+
+bool CpuProfiler::WriteBinary(const wchar_t* fileName)
+{
+    double ticksPerSecond = GetTicksPerSecond();
+
+    lock_guard<mutex> lock(s_threadsMutex);
+
+    // names by their text, the same literal can live at different addresses
+    vector<const char*> names;
+    unordered_map<string, uint32_t> nameIndices;
+    vector<uint8_t> threads;
+    Put(threads, (uint32_t)s_threads.size());
+
+    for (unique_ptr<ProfileThread>& thread : s_threads)
+    {
+        uint32_t count = thread->count.load(memory_order_acquire);
+
+        Put(threads, thread->id);
+        PutString(threads, thread->name);
+        Put(threads, count);
+
+        uint64_t previous = s_startTicks;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const ProfileEvent& event = thread->events[i];
+
+            uint32_t code = 0;
+            if (event.name)
+            {
+                auto found = nameIndices.find(event.name);
+                if (found == nameIndices.end())
+                {
+                    found = nameIndices.emplace(event.name, (uint32_t)names.size()).first;
+                    names.push_back(event.name);
+                }
+                code = found->second + 1;
+            }
+
+            PutVarint(threads, code);
+            PutVarint(threads, event.ticks >= previous ? event.ticks - previous : 0);
+            previous = event.ticks;
+        }
+    }
+
+    vector<uint8_t> header;
+    header.insert(header.end(), { 'C', 'P', 'R', 'F' });
+    Put(header, BINARY_VERSION);
+    Put(header, ticksPerSecond);
+    Put(header, (uint32_t)names.size());
+    for (const char* name : names)
+        PutString(header, name);
+
+    FILE* file = OpenOutputFile(fileName, L"wb");
+    if (!file)
+        return false;
+
+    bool ok = fwrite(header.data(), 1, header.size(), file) == header.size() &&
+              fwrite(threads.data(), 1, threads.size(), file) == threads.size();
+    fclose(file);
+    return ok;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define CPU_PROFILER_RDTSC
+#else
+#include <chrono>
+#endif
+
+using namespace std;
+
+// one scope name's totals over a capture, all threads together
+struct CpuProfileStat
+{
+	string Name;
+	uint32_t Calls;
+	// a scope nested inside another of the same name isn't counted again
+	double InclusiveSeconds;
+	// less the time spent in the scopes nested inside it
+	double ExclusiveSeconds;
+	// 1 for a scope with nothing open around it
+	uint32_t MaxDepth;
+};
+
+// scoped CPU profiler. begin and end events go into a fixed size buffer per thread that
+// only its own thread writes, so recording takes no locks: a timestamp, a store and a
+// release of the new count. a thread's first event registers its buffer (under a lock,
+// once). a Begin is only recorded when the buffer still has room for the End of every
+// scope open on the thread, so the capture always balances; past that events are dropped.
+//
+// Start and Stop belong between frames with no scopes open on other threads. the tree is
+// kept free of windows headers so the overhead benchmark (the cpu_profile_scope MicroBenchmark
+// cases) builds on any platform.
+//
+// the scope macros only exist in builds with PROFILE defined (Debug and Profile), they
+// compile to nothing in Release
+class CpuProfiler
+{
+public:
+	// timestamps are raw rdtsc ticks where there is one, Stop works out their rate
+	static inline uint64_t Now()
+	{
+#ifdef CPU_PROFILER_RDTSC
+		return __rdtsc();
+#else
+		return (uint64_t)chrono::steady_clock::now().time_since_epoch().count();
+#endif
+	}
+
+	// clears every buffer and starts recording, eventsPerThread applies to threads that
+	// record their first event after this
+	static void Start(uint32_t eventsPerThread = 1 << 18);
+	static void Stop();
+	static bool IsRecording() { return _recording.load(memory_order_relaxed); }
+
+	// false when the event was dropped, the matching End must then be skipped
+	static bool Begin(const char* name);
+	static void End();
+	// shown as the thread's name in the trace, the string must outlive the profiler
+	static void SetThreadName(const char* name);
+
+	static uint64_t GetDroppedEvents();
+	static double GetTicksPerSecond();
+
+	// totals per scope name, longest inclusive time first. scopes still open are left out
+	static vector<CpuProfileStat> Aggregate();
+	// a line per scope name from Aggregate, at most maxLines of them
+	static string FormatSummary(uint32_t maxLines = 20);
+
+	// chrome://tracing / Perfetto JSON, B and E events in microseconds
+	static bool WriteChromeTrace(const wchar_t* fileName);
+	// compact form, see CpuProfiler.cpp for the layout
+	static bool WriteBinary(const wchar_t* fileName);
+
+private:
+	static atomic<bool> _recording;
+};
+
+class CpuProfileScope
+{
+public:
+	explicit CpuProfileScope(const char* name) { _recorded = CpuProfiler::Begin(name); }
+	~CpuProfileScope() { if (_recorded) CpuProfiler::End(); }
+
+private:
+	bool _recorded;
+};
+
+#ifdef PROFILE
+#define CPU_PROFILE_CONCAT2(a, b) a##b
+#define CPU_PROFILE_CONCAT(a, b) CPU_PROFILE_CONCAT2(a, b)
+#define CPU_PROFILE_SCOPE(name) CpuProfileScope CPU_PROFILE_CONCAT(cpuProfileScope, __LINE__)(name)
+#define CPU_PROFILE_FUNCTION() CPU_PROFILE_SCOPE(__FUNCTION__)
+#define CPU_PROFILE_THREAD(name) CpuProfiler::SetThreadName(name)
+#else
+#define CPU_PROFILE_SCOPE(name) ((void)0)
+#define CPU_PROFILE_FUNCTION() ((void)0)
+#define CPU_PROFILE_THREAD(name) ((void)0)
+#endif
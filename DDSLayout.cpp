@@ -0,0 +1,247 @@
+#include "DDSLayout.h"
+#include <algorithm>
+#include <new>
+#include <string.h>
+
+bool GetDDSReducedLayout(const DDS_HEADER* header, size_t maxsize, const DDSFormatInfo& formats, DDSReducedLayout* layout)
+{
+    layout->itemBytes = 0;
+    layout->skipBytes = 0;
+    layout->arraySize = 1;
+
+    size_t width = header->width;
+    size_t height = header->height;
+    size_t depth = 1;
+    uint32_t format = DDS_FORMAT_UNKNOWN;
+
+    size_t mipCount = header->mipMapCount;
+    if (mipCount <= 1 || mipCount > DDS_MAX_MIP_LEVELS)
+        return false;
+
+    // same interpretation of the header as CreateTextureFromDDS
+    if ((header->ddspf.flags & DDS_FOURCC) && MAKEFOURCC('D', 'X', '1', '0') == header->ddspf.fourCC)
+    {
+        auto d3d10ext = reinterpret_cast<const DDS_HEADER_DXT10*>((const char*)header + sizeof(DDS_HEADER));
+
+        layout->arraySize = d3d10ext->arraySize;
+        format = d3d10ext->dxgiFormat;
+
+        switch (d3d10ext->resourceDimension)
+        {
+        case DDS_DIMENSION_TEXTURE1D:
+            height = 1;
+            break;
+
+        case DDS_DIMENSION_TEXTURE2D:
+            if (d3d10ext->miscFlag & DDS_MISC_TEXTURECUBE)
+                layout->arraySize *= 6;
+            break;
+
+        case DDS_DIMENSION_TEXTURE3D:
+            if (!(header->flags & DDS_HEADER_FLAGS_VOLUME) || layout->arraySize > 1)
+                return false;
+            depth = header->depth;
+            break;
+
+        default:
+            return false;
+        }
+    }
+    else
+    {
+        format = formats.GetFormat(header->ddspf);
+
+        if (header->flags & DDS_HEADER_FLAGS_VOLUME)
+        {
+            depth = header->depth;
+        }
+        else if (header->caps2 & DDS_CUBEMAP)
+        {
+            if ((header->caps2 & DDS_CUBEMAP_ALLFACES) != DDS_CUBEMAP_ALLFACES)
+                return false;
+
+            layout->arraySize = 6;
+        }
+    }
+
+    // leave anything the full path would reject to the full path, so it fails the same way
+    size_t texelBytes = 0;
+    if (format != DDS_FORMAT_UNKNOWN)
+        formats.GetSurfaceInfo(1, 1, format, &texelBytes, nullptr);
+
+    if (texelBytes == 0 ||
+        layout->arraySize == 0 || layout->arraySize > DDS_MAX_ARRAY_SIZE ||
+        width == 0 || height == 0 || depth == 0 ||
+        width > DDS_MAX_2D_DIMENSION || height > DDS_MAX_2D_DIMENSION || depth > DDS_MAX_3D_DIMENSION)
+    {
+        return false;
+    }
+
+    size_t skipMip = 0;
+    size_t twidth = 0;
+    size_t theight = 0;
+    size_t tdepth = 0;
+
+    size_t w = width;
+    size_t h = height;
+    size_t d = depth;
+    for (size_t i = 0; i < mipCount; i++)
+    {
+        size_t numBytes = 0;
+        formats.GetSurfaceInfo(w, h, format, &numBytes, nullptr);
+
+        if (w <= maxsize && h <= maxsize && d <= maxsize)
+        {
+            if (!twidth)
+            {
+                twidth = w;
+                theight = h;
+                tdepth = d;
+            }
+        }
+        else
+        {
+            ++skipMip;
+            layout->skipBytes += numBytes * d;
+        }
+
+        layout->itemBytes += numBytes * d;
+
+        w = max<size_t>(w >> 1, 1);
+        h = max<size_t>(h >> 1, 1);
+        d = max<size_t>(d >> 1, 1);
+    }
+
+    // nothing to save, or nothing left (DDSFillSubresources fails that case)
+    if (skipMip == 0 || skipMip == mipCount)
+        return false;
+
+    layout->header = *header;
+    layout->header.width = static_cast<uint32_t>(twidth);
+    layout->header.height = static_cast<uint32_t>(theight);
+    if (header->flags & DDS_HEADER_FLAGS_VOLUME)
+        layout->header.depth = static_cast<uint32_t>(tdepth);
+    layout->header.mipMapCount = static_cast<uint32_t>(mipCount - skipMip);
+
+    return true;
+}
+
+DDSLayoutResult ReadReducedDDS(DDSReadFunction read, void* file, size_t fileSize, size_t maxsize,
+                               const DDSFormatInfo& formats, unique_ptr<uint8_t[]>& ddsData,
+                               DDS_HEADER** header, uint8_t** bitData, size_t* bitSize)
+{
+    uint8_t headerData[sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10)];
+    size_t headerRead = min<size_t>(sizeof(headerData), fileSize);
+
+    // anything odd about the headers is reported by the full read
+    if (headerRead < sizeof(uint32_t) + sizeof(DDS_HEADER) || !read(file, 0, headerData, headerRead))
+        return DDS_LAYOUT_FULL_READ;
+
+    uint32_t magic;
+    DDS_HEADER hdr;
+    memcpy(&magic, headerData, sizeof(magic));
+    memcpy(&hdr, headerData + sizeof(uint32_t), sizeof(hdr));
+    if (magic != DDS_MAGIC || hdr.size != sizeof(DDS_HEADER) || hdr.ddspf.size != sizeof(DDS_PIXELFORMAT))
+        return DDS_LAYOUT_FULL_READ;
+
+    size_t headerSize = sizeof(uint32_t) + sizeof(DDS_HEADER);
+    if ((hdr.ddspf.flags & DDS_FOURCC) && MAKEFOURCC('D', 'X', '1', '0') == hdr.ddspf.fourCC)
+    {
+        if (headerRead < sizeof(headerData))
+            return DDS_LAYOUT_FULL_READ;
+
+        headerSize += sizeof(DDS_HEADER_DXT10);
+    }
+
+    // the structures are packed, so the header and its extension can be read in place
+    DDSReducedLayout layout;
+    if (!GetDDSReducedLayout(reinterpret_cast<const DDS_HEADER*>(headerData + sizeof(uint32_t)), maxsize, formats, &layout) ||
+        headerSize + layout.itemBytes * layout.arraySize > fileSize)
+    {
+        return DDS_LAYOUT_FULL_READ;
+    }
+
+    size_t keptBytes = layout.itemBytes - layout.skipBytes;
+    ddsData.reset(new (nothrow) uint8_t[headerSize + keptBytes * layout.arraySize]);
+    if (!ddsData)
+        return DDS_LAYOUT_OUT_OF_MEMORY;
+
+    memcpy(ddsData.get(), headerData, headerSize);
+    memcpy(ddsData.get() + sizeof(uint32_t), &layout.header, sizeof(DDS_HEADER));
+
+    // array items are stored one after another, each with its full mip chain
+    for (size_t item = 0; item < layout.arraySize; ++item)
+    {
+        if (!read(file, headerSize + item * layout.itemBytes + layout.skipBytes,
+                  ddsData.get() + headerSize + item * keptBytes, keptBytes))
+        {
+            ddsData.reset();
+            return DDS_LAYOUT_READ_FAILED;
+        }
+    }
+
+    *header = reinterpret_cast<DDS_HEADER*>(ddsData.get() + sizeof(uint32_t));
+    *bitData = ddsData.get() + headerSize;
+    *bitSize = keptBytes * layout.arraySize;
+
+    return DDS_LAYOUT_OK;
+}
+
+DDSLayoutResult DDSFillSubresources(size_t width, size_t height, size_t depth, size_t mipCount, size_t arraySize,
+                                    uint32_t format, size_t maxsize, size_t bitSize, const uint8_t* bitData,
+                                    const DDSFormatInfo& formats, size_t& twidth, size_t& theight, size_t& tdepth,
+                                    size_t& skipMip, DDSSubresource* subresources)
+{
+    skipMip = 0;
+    twidth = 0;
+    theight = 0;
+    tdepth = 0;
+
+    const uint8_t* srcBits = bitData;
+    const uint8_t* endBits = bitData + bitSize;
+
+    size_t index = 0;
+    for (size_t j = 0; j < arraySize; j++)
+    {
+        size_t w = width;
+        size_t h = height;
+        size_t d = depth;
+        for (size_t i = 0; i < mipCount; i++)
+        {
+            size_t numBytes = 0;
+            size_t rowBytes = 0;
+            formats.GetSurfaceInfo(w, h, format, &numBytes, &rowBytes);
+
+            if (mipCount <= 1 || !maxsize || (w <= maxsize && h <= maxsize && d <= maxsize))
+            {
+                if (!twidth)
+                {
+                    twidth = w;
+                    theight = h;
+                    tdepth = d;
+                }
+
+                subresources[index].data = srcBits;
+                subresources[index].rowPitch = static_cast<uint32_t>(rowBytes);
+                subresources[index].slicePitch = static_cast<uint32_t>(numBytes);
+                ++index;
+            }
+            else if (!j)
+            {
+                // Count number of skipped mipmaps (first item only)
+                ++skipMip;
+            }
+
+            if (srcBits + numBytes * d > endBits)
+                return DDS_LAYOUT_END_OF_DATA;
+
+            srcBits += numBytes * d;
+
+            w = max<size_t>(w >> 1, 1);
+            h = max<size_t>(h >> 1, 1);
+            d = max<size_t>(d >> 1, 1);
+        }
+    }
+
+    return index > 0 ? DDS_LAYOUT_OK : DDS_LAYOUT_NO_DATA;
+}
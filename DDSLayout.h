@@ -0,0 +1,170 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+
+using namespace std;
+
+// the DDS file structures and the maths of where each mip lives in a file, kept free of
+// windows and d3d headers so it runs on a buffer anywhere. formats are DXGI_FORMAT values
+// held as uint32_t, what they mean comes from the DDSFormatInfo the caller passes in
+
+#ifndef MAKEFOURCC
+	#define MAKEFOURCC(ch0, ch1, ch2, ch3)                              \
+	            ((uint32_t)(uint8_t)(ch0) | ((uint32_t)(uint8_t)(ch1) << 8) |       \
+	            ((uint32_t)(uint8_t)(ch2) << 16) | ((uint32_t)(uint8_t)(ch3) << 24 ))
+#endif /* defined(MAKEFOURCC) */
+
+//--------------------------------------------------------------------------------------
+// DDS file structure definitions
+//
+// See DDS.h in the 'Texconv' sample and the 'DirectXTex' library
+//--------------------------------------------------------------------------------------
+#pragma pack(push,1)
+
+const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+
+struct DDS_PIXELFORMAT
+{
+	uint32_t    size;
+	uint32_t    flags;
+	uint32_t    fourCC;
+	uint32_t    RGBBitCount;
+	uint32_t    RBitMask;
+	uint32_t    GBitMask;
+	uint32_t    BBitMask;
+	uint32_t    ABitMask;
+};
+
+#define DDS_FOURCC      0x00000004  // DDPF_FOURCC
+#define DDS_RGB         0x00000040  // DDPF_RGB
+#define DDS_LUMINANCE   0x00020000  // DDPF_LUMINANCE
+#define DDS_ALPHA       0x00000002  // DDPF_ALPHA
+
+#define DDS_HEADER_FLAGS_VOLUME         0x00800000  // DDSD_DEPTH
+
+#define DDS_HEIGHT 0x00000002 // DDSD_HEIGHT
+#define DDS_WIDTH  0x00000004 // DDSD_WIDTH
+
+#define DDS_CUBEMAP_POSITIVEX 0x00000600 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEX
+#define DDS_CUBEMAP_NEGATIVEX 0x00000a00 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEX
+#define DDS_CUBEMAP_POSITIVEY 0x00001200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEY
+#define DDS_CUBEMAP_NEGATIVEY 0x00002200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEY
+#define DDS_CUBEMAP_POSITIVEZ 0x00004200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEZ
+#define DDS_CUBEMAP_NEGATIVEZ 0x00008200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEZ
+
+#define DDS_CUBEMAP_ALLFACES ( DDS_CUBEMAP_POSITIVEX | DDS_CUBEMAP_NEGATIVEX |\
+                               DDS_CUBEMAP_POSITIVEY | DDS_CUBEMAP_NEGATIVEY |\
+                               DDS_CUBEMAP_POSITIVEZ | DDS_CUBEMAP_NEGATIVEZ )
+
+#define DDS_CUBEMAP 0x00000200 // DDSCAPS2_CUBEMAP
+
+enum DDS_MISC_FLAGS2
+{
+	DDS_MISC_FLAGS2_ALPHA_MODE_MASK = 0x7L,
+};
+
+struct DDS_HEADER
+{
+	uint32_t        size;
+	uint32_t        flags;
+	uint32_t        height;
+	uint32_t        width;
+	uint32_t        pitchOrLinearSize;
+	uint32_t        depth; // only if DDS_HEADER_FLAGS_VOLUME is set in flags
+	uint32_t        mipMapCount;
+	uint32_t        reserved1[11];
+	DDS_PIXELFORMAT ddspf;
+	uint32_t        caps;
+	uint32_t        caps2;
+	uint32_t        caps3;
+	uint32_t        caps4;
+	uint32_t        reserved2;
+};
+
+struct DDS_HEADER_DXT10
+{
+	uint32_t        dxgiFormat; // DXGI_FORMAT
+	uint32_t        resourceDimension;
+	uint32_t        miscFlag; // see D3D11_RESOURCE_MISC_FLAG
+	uint32_t        arraySize;
+	uint32_t        miscFlags2;
+};
+
+#pragma pack(pop)
+
+// the D3D11 values the layout checks against, as numbers so no d3d11.h is needed
+static const uint32_t DDS_FORMAT_UNKNOWN = 0;                   // DXGI_FORMAT_UNKNOWN
+static const uint32_t DDS_DIMENSION_TEXTURE1D = 2;              // D3D11_RESOURCE_DIMENSION_TEXTURE1D
+static const uint32_t DDS_DIMENSION_TEXTURE2D = 3;              // D3D11_RESOURCE_DIMENSION_TEXTURE2D
+static const uint32_t DDS_DIMENSION_TEXTURE3D = 4;              // D3D11_RESOURCE_DIMENSION_TEXTURE3D
+static const uint32_t DDS_MISC_TEXTURECUBE = 0x4;               // D3D11_RESOURCE_MISC_TEXTURECUBE
+static const size_t DDS_MAX_MIP_LEVELS = 15;                    // D3D11_REQ_MIP_LEVELS
+static const size_t DDS_MAX_ARRAY_SIZE = 2048;                  // D3D11_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION
+static const size_t DDS_MAX_2D_DIMENSION = 16384;               // D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION
+static const size_t DDS_MAX_3D_DIMENSION = 2048;                // D3D11_REQ_TEXTURE3D_U_V_OR_W_DIMENSION
+
+// what the layout needs to know about formats, DDSTextureLoader answers from its tables
+struct DDSFormatInfo
+{
+	// DXGI_FORMAT of a header without the DX10 extension, DDS_FORMAT_UNKNOWN when there isn't one
+	uint32_t (*GetFormat)(const DDS_PIXELFORMAT& ddpf);
+	// bytes in a width x height surface and in one row of it (of blocks for BC formats),
+	// both 0 for a format that can't be loaded
+	void (*GetSurfaceInfo)(size_t width, size_t height, uint32_t format, size_t* numBytes, size_t* rowBytes);
+};
+
+// one mip of one array item, as D3D11_SUBRESOURCE_DATA
+struct DDSSubresource
+{
+	const void* data;
+	uint32_t rowPitch;
+	uint32_t slicePitch;
+};
+
+enum DDSLayoutResult
+{
+	DDS_LAYOUT_OK,
+	// the reduced read doesn't apply, the caller reads the whole file instead
+	DDS_LAYOUT_FULL_READ,
+	DDS_LAYOUT_OUT_OF_MEMORY,
+	DDS_LAYOUT_READ_FAILED,
+	// the mips run past the end of the data
+	DDS_LAYOUT_END_OF_DATA,
+	// no mip is left once those over maxsize are dropped
+	DDS_LAYOUT_NO_DATA,
+};
+
+// a texture with the mips larger than maxsize dropped: the size of one array item with
+// its full mip chain, how many of its leading bytes are skipped, and a header describing
+// what is left
+struct DDSReducedLayout
+{
+	size_t itemBytes;
+	size_t skipBytes;
+	size_t arraySize;
+	DDS_HEADER header;
+};
+
+// header is followed by its DX10 extension when it has one. false for anything not worth
+// a partial read, including everything the full load would reject so it fails the same way
+bool GetDDSReducedLayout(const DDS_HEADER* header, size_t maxsize, const DDSFormatInfo& formats, DDSReducedLayout* layout);
+
+// size bytes of the file at offset into data, false on a short read or error
+typedef bool (*DDSReadFunction)(void* file, size_t offset, uint8_t* data, size_t size);
+
+// reads the headers and then only the kept mips of each array item, giving the same
+// ddsData/header/bitData a full read would have once DDSFillSubresources dropped the big
+// mips. DDS_LAYOUT_FULL_READ when the file isn't one a partial read can do
+DDSLayoutResult ReadReducedDDS(DDSReadFunction read, void* file, size_t fileSize, size_t maxsize,
+                               const DDSFormatInfo& formats, unique_ptr<uint8_t[]>& ddsData,
+                               DDS_HEADER** header, uint8_t** bitData, size_t* bitSize);
+
+// points a subresource per kept mip of each array item into bitData. mips larger than
+// maxsize (0 for none) are dropped unless there is only one, skipMip counts them and
+// twidth/theight/tdepth are the size of the first kept mip
+DDSLayoutResult DDSFillSubresources(size_t width, size_t height, size_t depth, size_t mipCount, size_t arraySize,
+                                    uint32_t format, size_t maxsize, size_t bitSize, const uint8_t* bitData,
+                                    const DDSFormatInfo& formats, size_t& twidth, size_t& theight, size_t& tdepth,
+                                    size_t& skipMip, DDSSubresource* subresources);
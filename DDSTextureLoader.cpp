@@ -23,6 +23,7 @@
 #include <memory>
 
 #include "DDSTextureLoader.h"
+#include "DDSLayout.h"
 
 #if !defined(NO_D3D11_DEBUG_NAME) && ( defined(_DEBUG) || defined(PROFILE) )
 #pragma comment(lib,"dxguid.lib")
@@ -30,93 +31,6 @@
 
 using namespace DirectX;
 
-//--------------------------------------------------------------------------------------
-// Macros
-//--------------------------------------------------------------------------------------
-#ifndef MAKEFOURCC
-    #define MAKEFOURCC(ch0, ch1, ch2, ch3)                              \
-                ((uint32_t)(uint8_t)(ch0) | ((uint32_t)(uint8_t)(ch1) << 8) |       \
-                ((uint32_t)(uint8_t)(ch2) << 16) | ((uint32_t)(uint8_t)(ch3) << 24 ))
-#endif /* defined(MAKEFOURCC) */
-
-//--------------------------------------------------------------------------------------
-// DDS file structure definitions
-//
-// See DDS.h in the 'Texconv' sample and the 'DirectXTex' library
-//--------------------------------------------------------------------------------------
-#pragma pack(push,1)
-
-const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
-
-struct DDS_PIXELFORMAT
-{
-    uint32_t    size;
-    uint32_t    flags;
-    uint32_t    fourCC;
-    uint32_t    RGBBitCount;
-    uint32_t    RBitMask;
-    uint32_t    GBitMask;
-    uint32_t    BBitMask;
-    uint32_t    ABitMask;
-};
-
-#define DDS_FOURCC      0x00000004  // DDPF_FOURCC
-#define DDS_RGB         0x00000040  // DDPF_RGB
-#define DDS_LUMINANCE   0x00020000  // DDPF_LUMINANCE
-#define DDS_ALPHA       0x00000002  // DDPF_ALPHA
-
-#define DDS_HEADER_FLAGS_VOLUME         0x00800000  // DDSD_DEPTH
-
-#define DDS_HEIGHT 0x00000002 // DDSD_HEIGHT
-#define DDS_WIDTH  0x00000004 // DDSD_WIDTH
-
-#define DDS_CUBEMAP_POSITIVEX 0x00000600 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEX
-#define DDS_CUBEMAP_NEGATIVEX 0x00000a00 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEX
-#define DDS_CUBEMAP_POSITIVEY 0x00001200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEY
-#define DDS_CUBEMAP_NEGATIVEY 0x00002200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEY
-#define DDS_CUBEMAP_POSITIVEZ 0x00004200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEZ
-#define DDS_CUBEMAP_NEGATIVEZ 0x00008200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEZ
-
-#define DDS_CUBEMAP_ALLFACES ( DDS_CUBEMAP_POSITIVEX | DDS_CUBEMAP_NEGATIVEX |\
-                               DDS_CUBEMAP_POSITIVEY | DDS_CUBEMAP_NEGATIVEY |\
-                               DDS_CUBEMAP_POSITIVEZ | DDS_CUBEMAP_NEGATIVEZ )
-
-#define DDS_CUBEMAP 0x00000200 // DDSCAPS2_CUBEMAP
-
-enum DDS_MISC_FLAGS2
-{
-    DDS_MISC_FLAGS2_ALPHA_MODE_MASK = 0x7L,
-};
-
-struct DDS_HEADER
-{
-    uint32_t        size;
-    uint32_t        flags;
-    uint32_t        height;
-    uint32_t        width;
-    uint32_t        pitchOrLinearSize;
-    uint32_t        depth; // only if DDS_HEADER_FLAGS_VOLUME is set in flags
-    uint32_t        mipMapCount;
-    uint32_t        reserved1[11];
-    DDS_PIXELFORMAT ddspf;
-    uint32_t        caps;
-    uint32_t        caps2;
-    uint32_t        caps3;
-    uint32_t        caps4;
-    uint32_t        reserved2;
-};
-
-struct DDS_HEADER_DXT10
-{
-    DXGI_FORMAT     dxgiFormat;
-    uint32_t        resourceDimension;
-    uint32_t        miscFlag; // see D3D11_RESOURCE_MISC_FLAG
-    uint32_t        arraySize;
-    uint32_t        miscFlags2;
-};
-
-#pragma pack(pop)
-
 //--------------------------------------------------------------------------------------
 namespace
 {
@@ -140,8 +54,20 @@ inline void SetDebugObjectName(_In_ ID3D11DeviceChild* resource, _In_ const char
 
 };
 
+//--------------------------------------------------------------------------------------
+static bool ReadFileAt( _In_ void* file,
+                        _In_ size_t offset,
+                        _Out_writes_bytes_(size) uint8_t* data,
+                        _In_ size_t size );
+
+static uint32_t GetLayoutFormat( const DDS_PIXELFORMAT& ddpf );
+static void GetLayoutSurfaceInfo( size_t width, size_t height, uint32_t format, size_t* numBytes, size_t* rowBytes );
+
+static const DDSFormatInfo s_ddsFormats = { GetLayoutFormat, GetLayoutSurfaceInfo };
+
 //--------------------------------------------------------------------------------------
 static HRESULT LoadTextureDataFromFile( _In_z_ const wchar_t* fileName,
+                                        _In_ size_t maxsize,
                                         std::unique_ptr<uint8_t[]>& ddsData,
                                         DDS_HEADER** header,
                                         uint8_t** bitData,
@@ -201,6 +127,32 @@ static HRESULT LoadTextureDataFromFile( _In_z_ const wchar_t* fileName,
         return E_FAIL;
     }
 
+    // with a maxsize only the mips that will be uploaded are read, S_FALSE means the
+    // layout needs the whole file after all
+    if (maxsize)
+    {
+        switch (ReadReducedDDS( ReadFileAt, hFile.get(), FileSize.LowPart, maxsize, s_ddsFormats, ddsData, header, bitData, bitSize ))
+        {
+        case DDS_LAYOUT_OK:
+            return S_OK;
+
+        case DDS_LAYOUT_OUT_OF_MEMORY:
+            return E_OUTOFMEMORY;
+
+        case DDS_LAYOUT_FULL_READ:
+            break;
+
+        default:
+            return E_FAIL;
+        }
+
+        LARGE_INTEGER start = { 0 };
+        if (!SetFilePointerEx( hFile.get(), start, nullptr, FILE_BEGIN ))
+        {
+            return HRESULT_FROM_WIN32( GetLastError() );
+        }
+    }
+
     // create enough space for the file data
     ddsData.reset( new (std::nothrow) uint8_t[ FileSize.LowPart ] );
     if (!ddsData)
@@ -786,6 +738,38 @@ static DXGI_FORMAT GetDXGIFormat( const DDS_PIXELFORMAT& ddpf )
 }
 
 
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+static bool ReadFileAt( void* file,
+                        size_t offset,
+                        uint8_t* data,
+                        size_t size )
+{
+    LARGE_INTEGER position;
+    position.QuadPart = offset;
+    if (!SetFilePointerEx( file, position, nullptr, FILE_BEGIN ))
+    {
+        return false;
+    }
+
+    DWORD BytesRead = 0;
+    return ReadFile( file, data, static_cast<DWORD>( size ), &BytesRead, nullptr ) && BytesRead == size;
+}
+
+
+//--------------------------------------------------------------------------------------
+// The format tables above as DDSLayout sees them
+//--------------------------------------------------------------------------------------
+static uint32_t GetLayoutFormat( const DDS_PIXELFORMAT& ddpf )
+{
+    return GetDXGIFormat( ddpf );
+}
+
+static void GetLayoutSurfaceInfo( size_t width, size_t height, uint32_t format, size_t* numBytes, size_t* rowBytes )
+{
+    GetSurfaceInfo( width, height, static_cast<DXGI_FORMAT>( format ), numBytes, rowBytes, nullptr );
+}
+
 //--------------------------------------------------------------------------------------
 static DXGI_FORMAT MakeSRGB( _In_ DXGI_FORMAT format )
 {
@@ -839,80 +823,32 @@ static HRESULT FillInitData( _In_ size_t width,
         return E_POINTER;
     }
 
-    skipMip = 0;
-    twidth = 0;
-    theight = 0;
-    tdepth = 0;
-
-    size_t NumBytes = 0;
-    size_t RowBytes = 0;
-    const uint8_t* pSrcBits = bitData;
-    const uint8_t* pEndBits = bitData + bitSize;
-
-    size_t index = 0;
-    for( size_t j = 0; j < arraySize; j++ )
+    // the layout is worked out by DDSLayout, this only moves it into D3D's structure
+    std::unique_ptr<DDSSubresource[]> subresources( new (std::nothrow) DDSSubresource[ mipCount * arraySize ] );
+    if ( !subresources )
     {
-        size_t w = width;
-        size_t h = height;
-        size_t d = depth;
-        for( size_t i = 0; i < mipCount; i++ )
-        {
-            GetSurfaceInfo( w,
-                            h,
-                            format,
-                            &NumBytes,
-                            &RowBytes,
-                            nullptr
-                          );
-
-            if ( (mipCount <= 1) || !maxsize || (w <= maxsize && h <= maxsize && d <= maxsize) )
-            {
-                if ( !twidth )
-                {
-                    twidth = w;
-                    theight = h;
-                    tdepth = d;
-                }
-
-                assert(index < mipCount * arraySize);
-                _Analysis_assume_(index < mipCount * arraySize);
-                initData[index].pSysMem = ( const void* )pSrcBits;
-                initData[index].SysMemPitch = static_cast<UINT>( RowBytes );
-                initData[index].SysMemSlicePitch = static_cast<UINT>( NumBytes );
-                ++index;
-            }
-            else if ( !j )
-            {
-                // Count number of skipped mipmaps (first item only)
-                ++skipMip;
-            }
+        return E_OUTOFMEMORY;
+    }
 
-            if (pSrcBits + (NumBytes*d) > pEndBits)
-            {
-                return HRESULT_FROM_WIN32( ERROR_HANDLE_EOF );
-            }
-  
-            pSrcBits += NumBytes * d;
+    DDSLayoutResult result = DDSFillSubresources( width, height, depth, mipCount, arraySize, format, maxsize, bitSize, bitData,
+                                                  s_ddsFormats, twidth, theight, tdepth, skipMip, subresources.get() );
+    if ( result == DDS_LAYOUT_END_OF_DATA )
+    {
+        return HRESULT_FROM_WIN32( ERROR_HANDLE_EOF );
+    }
+    if ( result != DDS_LAYOUT_OK )
+    {
+        return E_FAIL;
+    }
 
-            w = w >> 1;
-            h = h >> 1;
-            d = d >> 1;
-            if (w == 0)
-            {
-                w = 1;
-            }
-            if (h == 0)
-            {
-                h = 1;
-            }
-            if (d == 0)
-            {
-                d = 1;
-            }
-        }
+    for( size_t index = 0; index < (mipCount - skipMip) * arraySize; ++index )
+    {
+        initData[index].pSysMem = subresources[index].data;
+        initData[index].SysMemPitch = subresources[index].rowPitch;
+        initData[index].SysMemSlicePitch = subresources[index].slicePitch;
     }
 
-    return (index > 0) ? S_OK : E_FAIL;
+    return S_OK;
 }
 
 
@@ -1205,13 +1141,13 @@ static HRESULT CreateTextureFromDDS( _In_ ID3D11Device* d3dDevice,
             return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
 
         default:
-            if ( BitsPerPixel( d3d10ext->dxgiFormat ) == 0 )
+            if ( BitsPerPixel( static_cast<DXGI_FORMAT>( d3d10ext->dxgiFormat ) ) == 0 )
             {
                 return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
             }
         }
            
-        format = d3d10ext->dxgiFormat;
+        format = static_cast<DXGI_FORMAT>( d3d10ext->dxgiFormat );
 
         switch ( d3d10ext->resourceDimension )
         {
@@ -1757,6 +1693,7 @@ HRESULT DirectX::CreateDDSTextureFromFileEx( ID3D11Device* d3dDevice,
 
     std::unique_ptr<uint8_t[]> ddsData;
     HRESULT hr = LoadTextureDataFromFile( fileName,
+                                          maxsize,
                                           ddsData,
                                           &header,
                                           &bitData,
@@ -1824,3 +1761,179 @@ HRESULT DirectX::CreateDDSTextureFromFileEx( ID3D11Device* d3dDevice,
 
     return hr;
 }
+
+//--------------------------------------------------------------------------------------
+// Description and subresource layout of a 2D texture, no Direct3D objects involved
+static HRESULT GetTextureLayout( _In_ const DDS_HEADER* header,
+                                 _In_reads_bytes_(bitSize) const uint8_t* bitData,
+                                 _In_ size_t bitSize,
+                                 _Out_ D3D11_TEXTURE2D_DESC* desc,
+                                 _Inout_ std::vector<D3D11_SUBRESOURCE_DATA>& initData )
+{
+    size_t arraySize = 1;
+    DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+
+    if ((header->ddspf.flags & DDS_FOURCC) &&
+        (MAKEFOURCC( 'D', 'X', '1', '0' ) == header->ddspf.fourCC ))
+    {
+        auto d3d10ext = reinterpret_cast<const DDS_HEADER_DXT10*>( (const char*)header + sizeof(DDS_HEADER) );
+
+        if (d3d10ext->resourceDimension != D3D11_RESOURCE_DIMENSION_TEXTURE2D ||
+            (d3d10ext->miscFlag & D3D11_RESOURCE_MISC_TEXTURECUBE))
+        {
+            return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+        }
+
+        arraySize = d3d10ext->arraySize;
+        format = static_cast<DXGI_FORMAT>( d3d10ext->dxgiFormat );
+    }
+    else
+    {
+        if (header->flags & DDS_HEADER_FLAGS_VOLUME || header->caps2 & DDS_CUBEMAP)
+        {
+            return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+        }
+
+        format = GetDXGIFormat( header->ddspf );
+    }
+
+    if (arraySize == 0 || arraySize > D3D11_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION)
+    {
+        return HRESULT_FROM_WIN32( ERROR_INVALID_DATA );
+    }
+
+    if (format == DXGI_FORMAT_UNKNOWN || BitsPerPixel( format ) == 0)
+    {
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+    }
+
+    size_t mipCount = header->mipMapCount;
+    if (0 == mipCount)
+    {
+        mipCount = 1;
+    }
+
+    if (mipCount > D3D11_REQ_MIP_LEVELS ||
+        header->width > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION ||
+        header->height > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION)
+    {
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+    }
+
+    initData.resize( mipCount * arraySize );
+
+    size_t skipMip = 0;
+    size_t twidth = 0;
+    size_t theight = 0;
+    size_t tdepth = 0;
+    HRESULT hr = FillInitData( header->width, header->height, 1, mipCount, arraySize, format, 0, bitSize, bitData,
+                       twidth, theight, tdepth, skipMip, initData.data() );
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    memset( desc, 0, sizeof(D3D11_TEXTURE2D_DESC) );
+    desc->Width = static_cast<UINT>( twidth );
+    desc->Height = static_cast<UINT>( theight );
+    desc->MipLevels = static_cast<UINT>( mipCount );
+    desc->ArraySize = static_cast<UINT>( arraySize );
+    desc->Format = format;
+    desc->SampleDesc.Count = 1;
+    desc->Usage = D3D11_USAGE_DEFAULT;
+    desc->BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::LoadDDSTextureDataFromFile( const wchar_t* fileName,
+                                             std::unique_ptr<uint8_t[]>& ddsData,
+                                             D3D11_TEXTURE2D_DESC* desc,
+                                             std::vector<D3D11_SUBRESOURCE_DATA>& initData )
+{
+    if (!fileName || !desc)
+    {
+        return E_INVALIDARG;
+    }
+
+    DDS_HEADER* header = nullptr;
+    uint8_t* bitData = nullptr;
+    size_t bitSize = 0;
+
+    HRESULT hr = LoadTextureDataFromFile( fileName,
+                                          0,
+                                          ddsData,
+                                          &header,
+                                          &bitData,
+                                          &bitSize
+                                        );
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    return GetTextureLayout( header, bitData, bitSize, desc, initData );
+}
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::LoadDDSTextureDataFromMemory( const uint8_t* ddsData,
+                                               size_t ddsDataSize,
+                                               D3D11_TEXTURE2D_DESC* desc,
+                                               std::vector<D3D11_SUBRESOURCE_DATA>& initData )
+{
+    if (!ddsData || !desc)
+    {
+        return E_INVALIDARG;
+    }
+
+    // Same checks as CreateDDSTextureFromMemoryEx
+    if (ddsDataSize < (sizeof(uint32_t) + sizeof(DDS_HEADER)))
+    {
+        return E_FAIL;
+    }
+
+    uint32_t dwMagicNumber = *( const uint32_t* )( ddsData );
+    if (dwMagicNumber != DDS_MAGIC)
+    {
+        return E_FAIL;
+    }
+
+    auto header = reinterpret_cast<const DDS_HEADER*>( ddsData + sizeof( uint32_t ) );
+    if (header->size != sizeof(DDS_HEADER) ||
+        header->ddspf.size != sizeof(DDS_PIXELFORMAT))
+    {
+        return E_FAIL;
+    }
+
+    bool bDXT10Header = false;
+    if ((header->ddspf.flags & DDS_FOURCC) &&
+        (MAKEFOURCC( 'D', 'X', '1', '0' ) == header->ddspf.fourCC) )
+    {
+        if (ddsDataSize < (sizeof(DDS_HEADER) + sizeof(uint32_t) + sizeof(DDS_HEADER_DXT10)))
+        {
+            return E_FAIL;
+        }
+
+        bDXT10Header = true;
+    }
+
+    ptrdiff_t offset = sizeof( uint32_t )
+                       + sizeof( DDS_HEADER )
+                       + (bDXT10Header ? sizeof( DDS_HEADER_DXT10 ) : 0);
+
+    return GetTextureLayout( header, ddsData + offset, ddsDataSize - offset, desc, initData );
+}
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+size_t DirectX::GetSurfaceByteSize( size_t width,
+                                    size_t height,
+                                    DXGI_FORMAT fmt )
+{
+    size_t numBytes = 0;
+    GetSurfaceInfo( width, height, fmt, &numBytes, nullptr, nullptr );
+    return numBytes;
+}
@@ -35,6 +35,9 @@
 #include <stdint.h>
 #pragma warning(pop)
 
+#include <memory>
+#include <vector>
+
 #if defined(_MSC_VER) && (_MSC_VER<1610) && !defined(_In_reads_)
 #define _In_reads_(exp)
 #define _Out_writes_(exp)
@@ -153,4 +156,27 @@ namespace DirectX
                                         _Outptr_opt_ ID3D11ShaderResourceView** textureView,
                                         _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
                                     );
+
+    // CPU-side load of a 2D DDS texture without creating any Direct3D resource. initData
+    // gets one entry per subresource (mip + slice * MipLevels) pointing into ddsData, laid
+    // out exactly as CreateDDSTextureFromFile would upload it
+    HRESULT LoadDDSTextureDataFromFile( _In_z_ const wchar_t* szFileName,
+                                        _Inout_ std::unique_ptr<uint8_t[]>& ddsData,
+                                        _Out_ D3D11_TEXTURE2D_DESC* desc,
+                                        _Inout_ std::vector<D3D11_SUBRESOURCE_DATA>& initData
+                                      );
+
+    // As LoadDDSTextureDataFromFile for a file already in memory, initData points into
+    // ddsData so it has to outlive them
+    HRESULT LoadDDSTextureDataFromMemory( _In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+                                          _In_ size_t ddsDataSize,
+                                          _Out_ D3D11_TEXTURE2D_DESC* desc,
+                                          _Inout_ std::vector<D3D11_SUBRESOURCE_DATA>& initData
+                                        );
+
+    // Bytes taken by one 2D surface (a single mip of a single array slice) of the given format
+    size_t GetSurfaceByteSize( _In_ size_t width,
+                               _In_ size_t height,
+                               _In_ DXGI_FORMAT fmt
+                             );
 }
\ No newline at end of file
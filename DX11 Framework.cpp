@@ -1,12 +1,357 @@
 #include "Application.h"
+#include "TextureContainer.h"
+#include "HotPathBenchmarks.h"
+#include "ApiTrace.h"
+#include "SoftwareViewer.h"
+
+// the text after flag where it is an argument of its own, null when it isn't given. a
+// plain search would find -frames inside -captureframes or -software inside -softwarebench
+static const wchar_t* FindArgument(const wchar_t* cmdLine, const wchar_t* flag)
+{
+    if (!cmdLine)
+        return nullptr;
+
+    size_t length = wcslen(flag);
+    for (const wchar_t* found = wcsstr(cmdLine, flag); found; found = wcsstr(found + 1, flag))
+    {
+        bool starts = found == cmdLine || iswspace(found[-1]);
+        bool ends = found[length] == L'\0' || iswspace(found[length]);
+        if (!starts || !ends)
+            continue;
+
+        const wchar_t* value = found + length;
+        while (iswspace(*value))
+            ++value;
+        return value;
+    }
+
+    return nullptr;
+}
+
+// -packtextures: channel packs the material maps, then compresses the textures the app
+// loads into .ddsz containers next to them and reports load times against the raw
+// files in the debug output
+static int PackTextures()
+{
+    // normal and specular maps are only loaded channel packed
+    const wchar_t* textures[] = { L"Crate_COLOR.dds", L"Crate_MATERIAL.dds" };
+
+    if (FAILED(Application::PackMaterialTextures(true)))
+        return -1;
+
+    JobSystem jobs;
+    jobs.Init();
+
+    for (const wchar_t* texture : textures)
+    {
+        wstring container = wstring(texture) + L"z";
+
+        if (FAILED(WriteTextureContainer(texture, container.c_str())))
+            return -1;
+
+        BenchmarkTextureContainer(texture, container.c_str(), &jobs, 20);
+    }
+
+    return 0;
+}
+
+// -drsreplay file: runs a recorded trace of full resolution frame times (milliseconds,
+// one per line) through the dynamic resolution controller at a 60 fps budget, results go
+// to the debug output
+static int ReplayResolutionTrace(const wchar_t* fileName)
+{
+    vector<double> frameTimes;
+    if (FAILED(LoadFrameTimeTrace(fileName, frameTimes)))
+        return -1;
+
+    ResolutionController controller;
+    controller.Init(1.0 / 60.0);
+    ResolutionTraceResult result = ReplayFrameTimeTrace(controller, frameTimes);
+
+    wchar_t line[256];
+    swprintf_s(line, L"%s: %u frames, %u over budget, %u scale changes, scale mean %.3f min %.3f\n", fileName,
+               result.Frames, result.OverBudget, result.ScaleChanges, result.MeanScale, result.MinScale);
+    OutputDebugStringW(line);
+
+    return 0;
+}
+
+// -analyzetrace file: replays an API trace written by -capture against a model of the
+// pipeline and reports call counts, redundant state sets and estimated memory traffic to
+// the debug output
+static int AnalyseTrace(const wchar_t* fileName)
+{
+    ApiTraceStats stats;
+    if (!AnalyseApiTrace(fileName, stats))
+        return -1;
+
+    OutputDebugStringA(FormatApiTraceReport(stats).c_str());
+    return stats.BadRecords ? -1 : 0;
+}
+
+// -microbench file: times the CPU hot paths into file (CSV). with -baseline file the
+// results are compared against an earlier run and anything more than -threshold percent
+// (10) slower is reported and fails the run. -filter name runs the matching cases only
+static int RunMicroBenchmarks(LPWSTR lpCmdLine)
+{
+    wstring resultsFile = FindArgument(lpCmdLine, L"-microbench");
+    resultsFile = resultsFile.substr(0, resultsFile.find(L' '));
+
+    string filter;
+    if (FindArgument(lpCmdLine, L"-filter"))
+    {
+        wstring name = FindArgument(lpCmdLine, L"-filter");
+        name = name.substr(0, name.find(L' '));
+        filter.assign(name.begin(), name.end());
+    }
+
+    // One core at a raised priority, so the scheduler moves it about as little as possible
+    SetThreadAffinityMask(GetCurrentThread(), 1);
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+
+    MicroBenchmarkSuite suite;
+    AddHotPathBenchmarks(suite);
+    AddD3DHotPathBenchmarks(suite);
+
+    vector<MicroBenchmarkResult> results;
+    suite.Run(filter.c_str(), results);
+
+    wchar_t line[256];
+    for (const MicroBenchmarkResult& result : results)
+    {
+        swprintf_s(line, L"%-28S %12.1f ns (min %.1f, %llu iterations)\n", result.Name.c_str(), result.NsPerIteration,
+                   result.MinNsPerIteration, result.Iterations);
+        OutputDebugStringW(line);
+    }
+
+    if (!MicroBenchmarkSuite::WriteResults(resultsFile.c_str(), results))
+        return -1;
+
+    if (!FindArgument(lpCmdLine, L"-baseline"))
+        return 0;
+
+    wstring baselineFile = FindArgument(lpCmdLine, L"-baseline");
+    vector<MicroBenchmarkResult> baseline;
+    if (!MicroBenchmarkSuite::ReadResults(baselineFile.substr(0, baselineFile.find(L' ')).c_str(), baseline))
+        return -1;
+
+    double threshold = 10.0;
+    if (FindArgument(lpCmdLine, L"-threshold"))
+        threshold = _wtof(FindArgument(lpCmdLine, L"-threshold"));
+
+    vector<MicroBenchmarkRegression> regressions;
+    MicroBenchmarkSuite::Compare(baseline, results, threshold / 100.0, regressions);
+
+    for (const MicroBenchmarkRegression& regression : regressions)
+    {
+        swprintf_s(line, L"regression: %S %.1f ns -> %.1f ns (+%.0f%%)\n", regression.Name.c_str(), regression.BaselineNs,
+                   regression.CurrentNs, (regression.CurrentNs / regression.BaselineNs - 1.0) * 100.0);
+        OutputDebugStringW(line);
+    }
+
+    return regressions.empty() ? 0 : 1;
+}
+
+// anything a tagged allocator handed out that the app didn't give back
+static void ReportMemoryLeaks()
+{
+    string leaks = MemoryTracker::FormatLeaks();
+    if (!leaks.empty())
+        OutputDebugStringA(leaks.c_str());
+}
+
+// -software draws the scene with the CPU rasteriser into a window of its own, -bodies N
+// as for the app. -softwarebench file times -warmup N (60) then -frames N (600) headless
+// 1280x720 frames of it and writes the same JSON as -benchmark
+static int RunSoftwareViewer(HINSTANCE hInstance, int nCmdShow, LPWSTR lpCmdLine)
+{
+    UINT bodyCount = NAMED_BODY_COUNT;
+    if (FindArgument(lpCmdLine, L"-bodies"))
+        bodyCount = _wtoi(FindArgument(lpCmdLine, L"-bodies"));
+
+    SoftwareViewer* viewer = new SoftwareViewer();
+    HRESULT hr;
+
+    if (FindArgument(lpCmdLine, L"-softwarebench"))
+    {
+        wstring outputFile = FindArgument(lpCmdLine, L"-softwarebench");
+        outputFile = outputFile.substr(0, outputFile.find(L' '));
+
+        UINT warmupFrames = 60;
+        if (FindArgument(lpCmdLine, L"-warmup"))
+            warmupFrames = _wtoi(FindArgument(lpCmdLine, L"-warmup"));
+
+        UINT measuredFrames = 600;
+        if (FindArgument(lpCmdLine, L"-frames"))
+            measuredFrames = max(_wtoi(FindArgument(lpCmdLine, L"-frames")), 1);
+
+        hr = viewer->Initialise(1280, 720, bodyCount);
+        if (SUCCEEDED(hr))
+            hr = viewer->RunBenchmark(warmupFrames, measuredFrames, outputFile.c_str());
+    }
+    else
+    {
+        hr = viewer->Initialise(640, 480, bodyCount);
+        if (SUCCEEDED(hr))
+            hr = viewer->Run(hInstance, nCmdShow);
+    }
+
+    delete viewer;
+    ReportMemoryLeaks();
+    return FAILED(hr) ? -1 : 0;
+}
 
 int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdLine, int nCmdShow)
 {
     UNREFERENCED_PARAMETER(hPrevInstance);
-    UNREFERENCED_PARAMETER(lpCmdLine);
+
+    if (FindArgument(lpCmdLine, L"-packtextures"))
+        return PackTextures();
+
+    if (FindArgument(lpCmdLine, L"-microbench"))
+        return RunMicroBenchmarks(lpCmdLine);
+
+    // fills the shader cache ahead of time so the first launch doesn't compile anything
+    if (FindArgument(lpCmdLine, L"-buildshaders"))
+        return FAILED(Application::BuildShaders()) ? -1 : 0;
+
+    if (FindArgument(lpCmdLine, L"-drsreplay"))
+    {
+        wstring fileName = FindArgument(lpCmdLine, L"-drsreplay");
+        return ReplayResolutionTrace(fileName.substr(0, fileName.find(L' ')).c_str());
+    }
+
+    if (FindArgument(lpCmdLine, L"-analyzetrace"))
+    {
+        wstring fileName = FindArgument(lpCmdLine, L"-analyzetrace");
+        return AnalyseTrace(fileName.substr(0, fileName.find(L' ')).c_str());
+    }
+
+    if (FindArgument(lpCmdLine, L"-software") || FindArgument(lpCmdLine, L"-softwarebench"))
+        return RunSoftwareViewer(hInstance, nCmdShow, lpCmdLine);
 
 	Application * theApp = new Application();
 
+    if (FindArgument(lpCmdLine, L"-deferred"))
+        theApp->SetRenderPath(RENDER_PATH_DEFERRED);
+
+    // -novsync presents immediately (tearing where the display supports it),
+    // -latency N lets N frames queue up, 1 by default
+    SwapChainSettings swapChainSettings = { 3, 1, 1, true };
+    if (FindArgument(lpCmdLine, L"-novsync"))
+        swapChainSettings.SyncInterval = 0;
+    if (FindArgument(lpCmdLine, L"-latency"))
+        swapChainSettings.MaxFrameLatency = max(_wtoi(FindArgument(lpCmdLine, L"-latency")), 1);
+    theApp->SetSwapChainSettings(swapChainSettings);
+
+    // -fps N caps the frame rate, handy with -novsync
+    if (FindArgument(lpCmdLine, L"-fps"))
+        theApp->SetTargetFrameRate(max(_wtof(FindArgument(lpCmdLine, L"-fps")), 0.0));
+
+    if (FindArgument(lpCmdLine, L"-dynres"))
+        theApp->SetDynamicResolution(true);
+
+    // -cpuprofile name writes a Chrome trace (name.json) and the binary capture
+    // (name.cpuprof) of the CPU scopes on exit
+    if (FindArgument(lpCmdLine, L"-cpuprofile"))
+    {
+        wstring profileFile = FindArgument(lpCmdLine, L"-cpuprofile");
+        theApp->SetCpuProfileFile(profileFile.substr(0, profileFile.find(L' ')).c_str());
+    }
+
+    // -stats file writes per frame draw, state and upload counts (CSV, or JSON for .json)
+    if (FindArgument(lpCmdLine, L"-stats"))
+    {
+        wstring statsFile = FindArgument(lpCmdLine, L"-stats");
+        theApp->SetStatsFile(statsFile.substr(0, statsFile.find(L' ')).c_str());
+    }
+
+    // -gpuprofile file writes per pass GPU times to file on exit
+    if (FindArgument(lpCmdLine, L"-gpuprofile"))
+    {
+        wstring profileFile = FindArgument(lpCmdLine, L"-gpuprofile");
+        theApp->SetGpuProfileFile(profileFile.substr(0, profileFile.find(L' ')).c_str());
+    }
+
+    // -warp and -nulldevice pick the software rasteriser or a device that draws nothing
+    if (FindArgument(lpCmdLine, L"-warp"))
+        theApp->SetDriverType(D3D_DRIVER_TYPE_WARP);
+    if (FindArgument(lpCmdLine, L"-nulldevice"))
+        theApp->SetDriverType(D3D_DRIVER_TYPE_NULL);
+
+    // -capture file writes every device context call of the first -captureframes N (1)
+    // frames to file, -analyzetrace reads it back
+    if (FindArgument(lpCmdLine, L"-capture"))
+    {
+        wstring captureFile = FindArgument(lpCmdLine, L"-capture");
+        UINT captureFrames = 1;
+        if (FindArgument(lpCmdLine, L"-captureframes"))
+            captureFrames = max(_wtoi(FindArgument(lpCmdLine, L"-captureframes")), 1);
+        theApp->SetCaptureFile(captureFile.substr(0, captureFile.find(L' ')).c_str(), captureFrames);
+    }
+
+    // -texturebudget KB caps the packed material textures. the crate's arrays are a few
+    // megabytes at full size, well inside the 64 MB default, so a budget below that is
+    // what makes the residency manager drop and restore top mips as the bodies move
+    if (FindArgument(lpCmdLine, L"-texturebudget"))
+        theApp->SetTextureBudget((UINT64)max(_wtoi(FindArgument(lpCmdLine, L"-texturebudget")), 1) * 1024);
+
+    // -bodies N adds asteroids to the five planets and moons
+    if (FindArgument(lpCmdLine, L"-bodies"))
+        theApp->SetBodyCount(_wtoi(FindArgument(lpCmdLine, L"-bodies")));
+
+    // -benchmark file runs -warmup N (60) then -frames N (600) headless frames on a fixed
+    // 60 Hz clock and writes CPU frame and stage time percentiles to file as JSON
+    if (FindArgument(lpCmdLine, L"-benchmark"))
+    {
+        wstring outputFile = FindArgument(lpCmdLine, L"-benchmark");
+        outputFile = outputFile.substr(0, outputFile.find(L' '));
+
+        UINT warmupFrames = 60;
+        if (FindArgument(lpCmdLine, L"-warmup"))
+            warmupFrames = _wtoi(FindArgument(lpCmdLine, L"-warmup"));
+
+        UINT measuredFrames = 600;
+        if (FindArgument(lpCmdLine, L"-frames"))
+            measuredFrames = max(_wtoi(FindArgument(lpCmdLine, L"-frames")), 1);
+
+        theApp->SetHeadless(1280, 720);
+        theApp->SetFixedTimestep(1.0f / 60.0f);
+
+        HRESULT hr = theApp->Initialise(hInstance, nCmdShow);
+        if (SUCCEEDED(hr))
+            hr = theApp->RunBenchmark(warmupFrames, measuredFrames, outputFile.c_str());
+
+        delete theApp;
+        ReportMemoryLeaks();
+        return FAILED(hr) ? -1 : 0;
+    }
+
+    // -headless N renders N frames at a fixed 60 Hz step with no window, checksums (and
+    // with -images the frames as bitmaps) go to -out dir, "headless" by default
+    if (FindArgument(lpCmdLine, L"-headless"))
+    {
+        UINT frameCount = max(_wtoi(FindArgument(lpCmdLine, L"-headless")), 1);
+
+        wstring outputDirectory = L"headless";
+        if (FindArgument(lpCmdLine, L"-out"))
+        {
+            outputDirectory = FindArgument(lpCmdLine, L"-out");
+            outputDirectory = outputDirectory.substr(0, outputDirectory.find(L' '));
+        }
+
+        theApp->SetHeadless(640, 480);
+        theApp->SetFixedTimestep(1.0f / 60.0f);
+
+        HRESULT hr = theApp->Initialise(hInstance, nCmdShow);
+        if (SUCCEEDED(hr))
+            hr = theApp->RenderHeadless(frameCount, outputDirectory.c_str(), FindArgument(lpCmdLine, L"-images") != nullptr);
+
+        delete theApp;
+        ReportMemoryLeaks();
+        return FAILED(hr) ? -1 : 0;
+    }
+
 	if (FAILED(theApp->Initialise(hInstance, nCmdShow)))
 	{
 		return -1;
@@ -24,13 +369,17 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdLi
         }
         else
         {
-			theApp->Update();
-            theApp->Draw();
+            if (theApp->WaitForNextFrame())
+            {
+                theApp->Update();
+                theApp->Draw();
+            }
         }
     }
 
 	delete theApp;
 	theApp = nullptr;
+    ReportMemoryLeaks();
 
     return (int) msg.wParam;
 }
\ No newline at end of file
@@ -4,12 +4,59 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 //--------------------------------------------------------------------------------------
 
+//--------------------------------------------------------------------------------------
+// Features, ShaderPermutations defines every one of these to 0 or 1 per material.
+// The defaults are for compiling the file on its own
+//--------------------------------------------------------------------------------------
+#ifndef FEATURE_DIFFUSE_TEXTURE
+#define FEATURE_DIFFUSE_TEXTURE 1
+#endif
+
+#ifndef FEATURE_SPECULAR
+#define FEATURE_SPECULAR 1
+#endif
+
+#ifndef FEATURE_VIRTUAL_TEXTURE
+#define FEATURE_VIRTUAL_TEXTURE 0
+#endif
+
+#ifndef FEATURE_POINT_LIGHTS
+#define FEATURE_POINT_LIGHTS 0
+#endif
+
+#ifndef FEATURE_NORMAL_MAP
+#define FEATURE_NORMAL_MAP 0
+#endif
+
+#ifndef FEATURE_SHADOWS
+#define FEATURE_SHADOWS 0
+#endif
+
 //--------------------------------------------------------------------------------------
 // Constant Buffer Variables
 //--------------------------------------------------------------------------------------
 
-Texture2D txDiffuse : register(t0);
+Texture2DArray txDiffuse : register(t0);
+// virtual texture: page table (one mip per virtual mip) and the physical page cache
+Texture2D<uint4> txPageTable : register(t1);
+Texture2D txPageCache : register(t2);
+// clustered point lights: two float4 per light (position and radius, colour), an
+// offset and count per cluster and the light index list the clusters point into
+Buffer<float4> txLightData : register(t3);
+Buffer<uint2> txClusterGrid : register(t4);
+Buffer<uint> txLightIndices : register(t5);
+// deferred path: the G-buffer the geometry pass wrote, see GBuffer.h for the layout
+Texture2D txGBufferAlbedo : register(t6);
+Texture2D txGBufferNormal : register(t7);
+Texture2D<float> txGBufferDepth : register(t8);
+// channel packed material: rg = tangent space normal xy, b = specular mask
+Texture2DArray txMaterial : register(t9);
+// one slice per shadow cascade
+Texture2DArray<float> txShadowMap : register(t10);
+// dynamic resolution: the scene rendered into the corner of a window sized target
+Texture2D txScene : register(t11);
 SamplerState samLinear : register(s0);
+SamplerComparisonState samShadow : register(s1);
 
 cbuffer ConstantBuffer : register(b0)
 {
@@ -29,6 +76,62 @@ cbuffer ConstantBuffer : register(b0)
     float4 SpecularLight; 
     float SpecularPower; 
     float3 EyePosW;
+
+    // xy = scale, zw = offset into the packed atlas page
+    float4 UVTransform;
+    uint TextureSlice;
+
+    float4 MaterialUVTransform;
+    uint MaterialSlice;
+}
+
+cbuffer VirtualTextureParams : register(b1)
+{
+    float2 VTVirtualSize;
+    float VTPageSize;
+    float VTMipCount;
+
+    float2 VTPagesAtTop;
+    float2 VTCacheSize;
+
+    float VTSlotSize;
+    float VTPageBorder;
+    float VTFeedbackBias;
+}
+
+cbuffer ClusterParams : register(b2)
+{
+    float2 ClusterTileSize;
+    float ClusterSliceScale;
+    float ClusterSliceBias;
+
+    uint ClusterCountX;
+    uint ClusterCountY;
+    uint ClusterCountZ;
+    uint ClusterLightCount;
+}
+
+cbuffer DeferredParams : register(b3)
+{
+    matrix InvViewProjection;
+    float2 ScreenSize;
+}
+
+cbuffer ShadowParams : register(b4)
+{
+    matrix CascadeViewProjection[4];
+    // view space depth each cascade ends at
+    float4 CascadeSplits;
+    uint CascadeCount;
+    float ShadowDepthBias;
+    float ShadowTexelSize;
+}
+
+cbuffer UpscaleParams : register(b5)
+{
+    float2 UpscaleUVScale;
+    float2 UpscaleUVMin;
+    float2 UpscaleUVMax;
 }
 
 //--------------------------------------------------------------------------------------
@@ -38,17 +141,19 @@ struct VS_OUTPUT
     float3 normalW : NORMAL;
     float3 eye : POSITION;
     float2 Tex : TEXCOORD;
-    //float3 Tan : TANGENT;
-    //float3  Bitan : BITANGENT;
+    float3 posW : TEXCOORD1;
+    // xyz = world tangent, w = bitangent sign
+    float4 tangentW : TANGENT;
 };
 
 //----------------------------------------------------------------------------
 // Vertex Shader - Implements Gouraud Shading using Diffuse lighting only
 //----------------------------------------------------------------------------
-VS_OUTPUT VS(float4 Pos : POSITION, float3 NormalL : NORMAL, float2 Tex : TEXCOORD /*,float3 Tan : TANGENT, float3  Bitan : BITANGENT*/)
+VS_OUTPUT VS(float4 Pos : POSITION, float3 NormalL : NORMAL, float2 Tex : TEXCOORD, float4 TangentL : TANGENT)
 {
     VS_OUTPUT output = (VS_OUTPUT)0;
     output.Pos = mul(Pos, World); 
+    output.posW = output.Pos.xyz;
 
     output.eye = normalize(EyePosW.xyz - output.Pos.xyz);
 
@@ -59,27 +164,151 @@ VS_OUTPUT VS(float4 Pos : POSITION, float3 NormalL : NORMAL, float2 Tex : TEXCOO
     // W component of vector is 0 as vectors cannot be translated     
     float3 normalW = mul(float4(NormalL, 0.0f), World).xyz;
     output.normalW = normalize(normalW);
+    output.tangentW = float4(normalize(mul(float4(TangentL.xyz, 0.0f), World).xyz), TangentL.w);
     output.Tex = Tex;
 
     return output;
 }
 
+//--------------------------------------------------------------------------------------
+// Virtual texturing
+//--------------------------------------------------------------------------------------
+float VirtualMip(float2 uv, float bias)
+{
+    float2 dx = ddx(uv * VTVirtualSize);
+    float2 dy = ddy(uv * VTVirtualSize);
+    float mip = 0.5f * log2(max(dot(dx, dx), dot(dy, dy))) + bias;
+    return clamp(mip, 0, VTMipCount - 1);
+}
+
+uint2 VirtualPage(float2 uv, uint mip)
+{
+    uint2 pageCount = max((uint2)VTPagesAtTop >> mip, 1);
+    return min((uint2)(saturate(uv) * pageCount), pageCount - 1);
+}
+
+float4 SampleVirtual(float2 uv)
+{
+    uint mip = (uint)VirtualMip(uv, 0);
+
+    // x, y = cache slot, z = mip the resident page actually came from
+    uint4 entry = txPageTable.Load(int3(VirtualPage(uv, mip), mip));
+    float2 residentPages = max((uint2)VTPagesAtTop >> entry.z, 1);
+    float2 inPage = frac(saturate(uv) * residentPages);
+
+    float2 cacheTexel = entry.xy * VTSlotSize + VTPageBorder + inPage * VTPageSize;
+    return txPageCache.SampleLevel(samLinear, cacheTexel / VTCacheSize, 0);
+}
+
+//--------------------------------------------------------------------------------------
+// Clustered point lights
+//--------------------------------------------------------------------------------------
+float3 ClusteredPointLights(float3 posW, float3 normalW, float2 pixel)
+{
+    // same froxel mapping as LightClusterBuilder
+    float viewZ = mul(float4(posW, 1.0f), View).z;
+    int slice = clamp((int)floor(log(viewZ) * ClusterSliceScale + ClusterSliceBias), 0, (int)ClusterCountZ - 1);
+    uint2 tile = min((uint2)(pixel / ClusterTileSize), uint2(ClusterCountX, ClusterCountY) - 1);
+
+    uint2 cluster = txClusterGrid.Load((slice * ClusterCountY + tile.y) * ClusterCountX + tile.x);
+
+    float3 light = 0;
+    for (uint i = 0; i < cluster.y; ++i)
+    {
+        uint index = txLightIndices.Load(cluster.x + i);
+        float4 positionRadius = txLightData.Load(index * 2);
+        float3 colour = txLightData.Load(index * 2 + 1).rgb;
+
+        float3 toLight = positionRadius.xyz - posW;
+        float distanceSq = dot(toLight, toLight);
+        float falloff = saturate(1.0f - distanceSq / (positionRadius.w * positionRadius.w));
+
+        light += colour * (falloff * falloff * max(dot(normalW, toLight * rsqrt(max(distanceSq, 1e-6f))), 0.0f));
+    }
+
+    return light;
+}
+
+//--------------------------------------------------------------------------------------
+// Shadows
+//--------------------------------------------------------------------------------------
+// 0 in shadow to 1 lit, 3x3 pcf in the nearest cascade that covers the point
+float ShadowFactor(float3 posW)
+{
+    float viewZ = mul(float4(posW, 1.0f), View).z;
+    uint cascade = (uint)dot((float4)(viewZ > CascadeSplits), 1.0f);
+
+    if (cascade >= CascadeCount)
+        return 1.0f;
+
+    float4 shadowPos = mul(float4(posW, 1.0f), CascadeViewProjection[cascade]);
+    float2 shadowTex = shadowPos.xy * float2(0.5f, -0.5f) + 0.5f;
+    float depth = shadowPos.z - ShadowDepthBias;
+
+    float lit = 0;
+    [unroll]
+    for (int y = -1; y <= 1; ++y)
+    {
+        [unroll]
+        for (int x = -1; x <= 1; ++x)
+            lit += txShadowMap.SampleCmpLevelZero(samShadow, float3(shadowTex + float2(x, y) * ShadowTexelSize, cascade), depth);
+    }
+
+    return lit / 9.0f;
+}
+
+//--------------------------------------------------------------------------------------
+// G-buffer packing, DecodeOctahedral etc. in GBuffer.cpp are the cpu reference
+//--------------------------------------------------------------------------------------
+static const float MaxSpecularPower = 2048.0f;
+
+float2 EncodeOctahedral(float3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    if (n.z < 0)
+        n.xy = (1.0f - abs(n.yx)) * (n.xy >= 0 ? 1.0f : -1.0f);
+    return n.xy * 0.5f + 0.5f;
+}
+
+float3 DecodeOctahedral(float2 encoded)
+{
+    float3 n = float3(encoded * 2.0f - 1.0f, 0);
+    n.z = 1.0f - abs(n.x) - abs(n.y);
+    float t = saturate(-n.z);
+    n.xy += n.xy >= 0 ? -t : t;
+    return normalize(n);
+}
+
+float EncodeSpecularPower(float power)
+{
+    return saturate(log2(max(power, 1.0f)) / log2(MaxSpecularPower));
+}
+
+float DecodeSpecularPower(float encoded)
+{
+    return exp2(encoded * log2(MaxSpecularPower));
+}
+
 //--------------------------------------------------------------------------------------
 // Pixel Shader
 //--------------------------------------------------------------------------------------
-float4 PS(VS_OUTPUT input) : SV_Target
+// shadow scales the directional light only, ambient and point lights are left alone
+float4 ShadeSurface(float3 normalW, float3 eye, float4 textureColour, float3 specularColour, float specularPower, float shadow)
 {
-    float4 textureColour = txDiffuse.Sample(samLinear, input.Tex);
-    //compute reflection vector
-    input.normalW = normalize(input.normalW);
-    float r = reflect(-LightVecW, input.normalW);
     // Compute Colour using Diffuse lighting only     
-    float diffuseAmount = max(dot(LightVecW, input.normalW), 0.0f);
+    float diffuseAmount = max(dot(LightVecW, normalW), 0.0f) * shadow;
+
+#if FEATURE_SPECULAR
+    //compute reflection vector
+    float r = reflect(-LightVecW, normalW);
     // Determine how much (if any) specular light makes it into the eye.
-    float specularAmount = pow(max(dot(r, input.eye), 0), SpecularPower);
+    float specularAmount = pow(max(dot(r, eye), 0), specularPower) * shadow;
 
     //specular calc
-    float3 specular = specularAmount * (SpecularMtrl * SpecularLight).rgb;
+    float3 specular = specularAmount * specularColour;
+#else
+    float3 specular = 0;
+#endif
     //ambient calc
     float3 ambient = AmbientMaterial * AmbientLight;
     //diffuse calc
@@ -90,4 +319,146 @@ float4 PS(VS_OUTPUT input) : SV_Target
     finalColor.a = DiffuseMtrl.a;
 
     return textureColour + finalColor;
-}
\ No newline at end of file
+}
+
+// shading normal and specular mask, from the packed material texture when there is one
+void SampleSurface(VS_OUTPUT input, out float3 normalW, out float specularMask)
+{
+#if FEATURE_NORMAL_MAP
+    float2 packedTex = input.Tex * MaterialUVTransform.xy + MaterialUVTransform.zw;
+    float4 material = txMaterial.Sample(samLinear, float3(packedTex, MaterialSlice));
+
+    float3 normalT;
+    normalT.xy = material.rg * 2.0f - 1.0f;
+    normalT.z = sqrt(saturate(1.0f - dot(normalT.xy, normalT.xy)));
+
+    // MikkTSpace: bitangent from the interpolated, unnormalised normal and tangent
+    float3 bitangentW = input.tangentW.w * cross(input.normalW, input.tangentW.xyz);
+    normalW = normalize(normalT.x * input.tangentW.xyz + normalT.y * bitangentW + normalT.z * input.normalW);
+    specularMask = material.b;
+#else
+    normalW = normalize(input.normalW);
+    specularMask = 1.0f;
+#endif
+}
+
+float4 Shade(VS_OUTPUT input, float4 textureColour)
+{
+    float3 normalW;
+    float specularMask;
+    SampleSurface(input, normalW, specularMask);
+
+#if FEATURE_SHADOWS
+    float shadow = ShadowFactor(input.posW);
+#else
+    float shadow = 1.0f;
+#endif
+
+    float4 colour = ShadeSurface(normalW, input.eye, textureColour, (SpecularMtrl * SpecularLight).rgb * specularMask, SpecularPower, shadow);
+#if FEATURE_POINT_LIGHTS
+    colour.rgb += ClusteredPointLights(input.posW, normalW, input.Pos.xy) * DiffuseMtrl.rgb;
+#endif
+
+    return colour;
+}
+
+float4 SampleMaterial(VS_OUTPUT input)
+{
+#if FEATURE_VIRTUAL_TEXTURE
+    return SampleVirtual(input.Tex);
+#elif FEATURE_DIFFUSE_TEXTURE
+    float2 packedTex = input.Tex * UVTransform.xy + UVTransform.zw;
+    return txDiffuse.Sample(samLinear, float3(packedTex, TextureSlice));
+#else
+    return 0;
+#endif
+}
+
+float4 PS(VS_OUTPUT input) : SV_Target
+{
+    return Shade(input, SampleMaterial(input));
+}
+
+//--------------------------------------------------------------------------------------
+// Deferred path
+//--------------------------------------------------------------------------------------
+struct GBUFFER_OUTPUT
+{
+    float4 AlbedoSpecular : SV_Target0;
+    float4 NormalPower : SV_Target1;
+};
+
+GBUFFER_OUTPUT PS_GBuffer(VS_OUTPUT input)
+{
+    GBUFFER_OUTPUT output;
+
+    float3 normalW;
+    float specularMask;
+    SampleSurface(input, normalW, specularMask);
+
+    float3 specular = (SpecularMtrl * SpecularLight).rgb;
+#if FEATURE_SPECULAR
+    float specularIntensity = dot(specular, 1.0f / 3.0f) * specularMask;
+#else
+    float specularIntensity = 0;
+#endif
+
+    output.AlbedoSpecular = float4(SampleMaterial(input).rgb, specularIntensity);
+    output.NormalPower = float4(EncodeOctahedral(normalW), EncodeSpecularPower(SpecularPower), 0);
+    return output;
+}
+
+// one triangle covering the screen, no vertex buffer needed
+float4 VS_Fullscreen(uint id : SV_VertexID) : SV_POSITION
+{
+    float2 uv = float2((id << 1) & 2, id & 2);
+    return float4(uv * float2(2, -2) + float2(-1, 1), 0, 1);
+}
+
+// lights the G-buffer, the point lights come from the same clusters the forward path uses
+float4 PS_DeferredLighting(float4 pixel : SV_POSITION) : SV_Target
+{
+    int3 texel = int3(pixel.xy, 0);
+    float depth = txGBufferDepth.Load(texel);
+
+    // nothing drawn here, leave the clear colour
+    if (depth >= 1.0f)
+        discard;
+
+    float4 albedoSpecular = txGBufferAlbedo.Load(texel);
+    float4 normalPower = txGBufferNormal.Load(texel);
+    float3 normalW = DecodeOctahedral(normalPower.xy);
+
+    float2 ndc = pixel.xy / ScreenSize * float2(2, -2) + float2(-1, 1);
+    float4 posW = mul(float4(ndc, depth, 1), InvViewProjection);
+    posW.xyz /= posW.w;
+
+    float3 eye = normalize(EyePosW - posW.xyz);
+#if FEATURE_SHADOWS
+    float shadow = ShadowFactor(posW.xyz);
+#else
+    float shadow = 1.0f;
+#endif
+
+    float4 colour = ShadeSurface(normalW, eye, float4(albedoSpecular.rgb, 0), albedoSpecular.a,
+                                 DecodeSpecularPower(normalPower.z), shadow);
+    colour.rgb += ClusteredPointLights(posW.xyz, normalW, pixel.xy) * DiffuseMtrl.rgb;
+
+    return colour;
+}
+
+// writes the virtual page each pixel needs into the low resolution feedback target
+uint PS_Feedback(VS_OUTPUT input) : SV_Target
+{
+    uint mip = (uint)VirtualMip(input.Tex, VTFeedbackBias);
+    uint2 page = VirtualPage(input.Tex, mip);
+    return 0x80000000 | (mip << 24) | (page.y << 12) | page.x;
+}
+
+// stretches the scaled scene over the back buffer, the clamp keeps the filter from
+// reaching the stale texels outside this frame's viewport (or wrapping round to them)
+float4 PS_Upscale(float4 pixel : SV_POSITION) : SV_Target
+{
+    float2 uv = clamp(pixel.xy * UpscaleUVScale, UpscaleUVMin, UpscaleUVMax);
+    return txScene.SampleLevel(samLinear, uv, 0);
+}
@@ -0,0 +1,217 @@
+#include "DynamicResolution.h"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+
+//--------------------------------------------------------------------------------------
+// Traces
+//--------------------------------------------------------------------------------------
+HRESULT LoadFrameTimeTrace(const wchar_t* fileName, vector<double>& frameTimes)
+{
+    FILE* file = nullptr;
+    if (_wfopen_s(&file, fileName, L"rt") != 0 || !file)
+        return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+
+    frameTimes.clear();
+
+    double milliseconds;
+    while (fscanf_s(file, "%lf", &milliseconds) == 1)
+        frameTimes.push_back(milliseconds / 1000.0);
+
+    fclose(file);
+    return frameTimes.empty() ? E_FAIL : S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+// DynamicResolution
+//--------------------------------------------------------------------------------------
+DynamicResolution::DynamicResolution()
+{
+    _width = 0;
+    _height = 0;
+    _scale = 1.0f;
+    _lastGpuTime = 0.0;
+    _scene = nullptr;
+    _sceneView = nullptr;
+    _sceneResource = nullptr;
+    _depth = nullptr;
+    _depthView = nullptr;
+    _paramsBuffer = nullptr;
+    _frame = 0;
+
+    for (UINT i = 0; i < QUERY_LATENCY; ++i)
+    {
+        _disjoint[i] = nullptr;
+        _frameStart[i] = nullptr;
+        _frameEnd[i] = nullptr;
+    }
+}
+
+DynamicResolution::~DynamicResolution()
+{
+    Release();
+}
+
+HRESULT DynamicResolution::Initialise(ID3D11Device* device, UINT width, UINT height, double budget, float minScale)
+{
+    _width = width;
+    _height = height;
+    _controller.Init(budget, minScale, 1.0f);
+    _scale = _controller.GetScale();
+    _frame = 0;
+
+    D3D11_TEXTURE2D_DESC desc;
+    ZeroMemory(&desc, sizeof(desc));
+    desc.Width = width;
+    desc.Height = height;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    desc.SampleDesc.Count = 1;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+
+    HRESULT hr = device->CreateTexture2D(&desc, nullptr, &_scene);
+    if (SUCCEEDED(hr))
+        hr = device->CreateRenderTargetView(_scene, nullptr, &_sceneView);
+    if (SUCCEEDED(hr))
+        hr = device->CreateShaderResourceView(_scene, nullptr, &_sceneResource);
+
+    if (SUCCEEDED(hr))
+    {
+        desc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+        desc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
+        hr = device->CreateTexture2D(&desc, nullptr, &_depth);
+    }
+    if (SUCCEEDED(hr))
+        hr = device->CreateDepthStencilView(_depth, nullptr, &_depthView);
+
+    if (SUCCEEDED(hr))
+    {
+        D3D11_BUFFER_DESC bd;
+        ZeroMemory(&bd, sizeof(bd));
+        bd.Usage = D3D11_USAGE_DEFAULT;
+        bd.ByteWidth = sizeof(UpscaleParams);
+        bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        hr = device->CreateBuffer(&bd, nullptr, &_paramsBuffer);
+    }
+
+    D3D11_QUERY_DESC disjointDesc = { D3D11_QUERY_TIMESTAMP_DISJOINT, 0 };
+    D3D11_QUERY_DESC timestampDesc = { D3D11_QUERY_TIMESTAMP, 0 };
+    for (UINT i = 0; i < QUERY_LATENCY && SUCCEEDED(hr); ++i)
+    {
+        hr = device->CreateQuery(&disjointDesc, &_disjoint[i]);
+        if (SUCCEEDED(hr))
+            hr = device->CreateQuery(&timestampDesc, &_frameStart[i]);
+        if (SUCCEEDED(hr))
+            hr = device->CreateQuery(&timestampDesc, &_frameEnd[i]);
+    }
+
+    if (FAILED(hr))
+        Release();
+
+    return hr;
+}
+
+void DynamicResolution::Release()
+{
+    if (_scene) _scene->Release();
+    if (_sceneView) _sceneView->Release();
+    if (_sceneResource) _sceneResource->Release();
+    if (_depth) _depth->Release();
+    if (_depthView) _depthView->Release();
+    if (_paramsBuffer) _paramsBuffer->Release();
+
+    _scene = nullptr;
+    _sceneView = nullptr;
+    _sceneResource = nullptr;
+    _depth = nullptr;
+    _depthView = nullptr;
+    _paramsBuffer = nullptr;
+
+    for (UINT i = 0; i < QUERY_LATENCY; ++i)
+    {
+        if (_disjoint[i]) _disjoint[i]->Release();
+        if (_frameStart[i]) _frameStart[i]->Release();
+        if (_frameEnd[i]) _frameEnd[i]->Release();
+
+        _disjoint[i] = nullptr;
+        _frameStart[i] = nullptr;
+        _frameEnd[i] = nullptr;
+    }
+}
+
+void DynamicResolution::BeginFrame(ID3D11DeviceContext* context)
+{
+    UINT index = (UINT)(_frame % QUERY_LATENCY);
+
+    // this set was last used QUERY_LATENCY frames ago, read it before it is reused. not
+    // ready yet means the GPU is well behind, skip the sample rather than wait
+    if (_frame >= QUERY_LATENCY)
+    {
+        D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+        UINT64 start;
+        UINT64 end;
+        if (context->GetData(_disjoint[index], &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK &&
+            context->GetData(_frameStart[index], &start, sizeof(start), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK &&
+            context->GetData(_frameEnd[index], &end, sizeof(end), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK &&
+            !disjoint.Disjoint)
+        {
+            _lastGpuTime = (double)(end - start) / disjoint.Frequency;
+            _scale = _controller.Update(_lastGpuTime);
+        }
+    }
+
+    context->Begin(_disjoint[index]);
+    context->End(_frameStart[index]);
+}
+
+D3D11_VIEWPORT DynamicResolution::GetSceneViewport() const
+{
+    D3D11_VIEWPORT vp;
+    vp.TopLeftX = 0;
+    vp.TopLeftY = 0;
+    vp.Width = max(floorf(_width * _scale + 0.5f), 1.0f);
+    vp.Height = max(floorf(_height * _scale + 0.5f), 1.0f);
+    vp.MinDepth = 0.0f;
+    vp.MaxDepth = 1.0f;
+    return vp;
+}
+
+void DynamicResolution::Resolve(ID3D11DeviceContext* context, ID3D11RenderTargetView* target,
+                                ID3D11VertexShader* fullscreenShader, ID3D11PixelShader* upscaleShader)
+{
+    D3D11_VIEWPORT scene = GetSceneViewport();
+
+    UpscaleParams params;
+    params.UVScale[0] = scene.Width / _width / _width;
+    params.UVScale[1] = scene.Height / _height / _height;
+    params.UVMin[0] = 0.5f / _width;
+    params.UVMin[1] = 0.5f / _height;
+    params.UVMax[0] = (scene.Width - 0.5f) / _width;
+    params.UVMax[1] = (scene.Height - 0.5f) / _height;
+    params.Padding[0] = 0.0f;
+    params.Padding[1] = 0.0f;
+    context->UpdateSubresource(_paramsBuffer, 0, nullptr, &params, 0, 0);
+
+    D3D11_VIEWPORT vp = scene;
+    vp.Width = (FLOAT)_width;
+    vp.Height = (FLOAT)_height;
+    context->RSSetViewports(1, &vp);
+    context->OMSetRenderTargets(1, &target, nullptr);
+
+    context->VSSetShader(fullscreenShader, nullptr, 0);
+    context->PSSetShader(upscaleShader, nullptr, 0);
+    context->PSSetShaderResources(11, 1, &_sceneResource);
+    context->PSSetConstantBuffers(5, 1, &_paramsBuffer);
+    context->Draw(3, 0);
+
+    // the scene target is drawn to again next frame
+    ID3D11ShaderResourceView* nullView = nullptr;
+    context->PSSetShaderResources(11, 1, &nullView);
+
+    UINT index = (UINT)(_frame % QUERY_LATENCY);
+    context->End(_frameEnd[index]);
+    context->End(_disjoint[index]);
+    ++_frame;
+}
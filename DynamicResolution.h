@@ -0,0 +1,74 @@
+#pragma once
+
+#include <windows.h>
+#include <d3d11_1.h>
+#include "ResolutionController.h"
+#include <vector>
+
+using namespace std;
+
+// mirrors cbuffer UpscaleParams in DX11 Framework.fx
+struct UpscaleParams
+{
+	// output pixel to source uv, the rendered region only covers part of the source
+	float UVScale[2];
+	// first and last uv that still filter inside the rendered region
+	float UVMin[2];
+	float UVMax[2];
+	float Padding[2];
+};
+
+// one full resolution frame time in milliseconds per line
+HRESULT LoadFrameTimeTrace(const wchar_t* fileName, vector<double>& frameTimes);
+
+// renders the scene into an offscreen target at a varying fraction of the window size
+// and upscales it to the back buffer. the target is allocated at full size once so a
+// new scale only changes the viewport. gpu time for the whole frame is measured with
+// timestamp queries read back a few frames late and drives the controller
+class DynamicResolution
+{
+public:
+	DynamicResolution();
+	~DynamicResolution();
+
+	HRESULT Initialise(ID3D11Device* device, UINT width, UINT height, double budget, float minScale = 0.5f);
+	void Release();
+
+	// first thing in a frame, picks up the oldest finished timing and starts timing this one
+	void BeginFrame(ID3D11DeviceContext* context);
+
+	ID3D11RenderTargetView* GetSceneTarget() const { return _sceneView; }
+	ID3D11DepthStencilView* GetSceneDepth() const { return _depthView; }
+	// the scaled region of the scene target for this frame
+	D3D11_VIEWPORT GetSceneViewport() const;
+
+	// bilinear upscale onto target (window sized) and ends the frame's timing. uses t11
+	// for the scene and b5 for the parameters, unbound again afterwards
+	void Resolve(ID3D11DeviceContext* context, ID3D11RenderTargetView* target,
+	             ID3D11VertexShader* fullscreenShader, ID3D11PixelShader* upscaleShader);
+
+	float GetScale() const { return _scale; }
+	double GetLastGpuTime() const { return _lastGpuTime; }
+	ResolutionController& GetController() { return _controller; }
+
+private:
+	static const UINT QUERY_LATENCY = 3;
+
+	UINT _width;
+	UINT _height;
+	float _scale;
+	double _lastGpuTime;
+	ResolutionController _controller;
+
+	ID3D11Texture2D* _scene;
+	ID3D11RenderTargetView* _sceneView;
+	ID3D11ShaderResourceView* _sceneResource;
+	ID3D11Texture2D* _depth;
+	ID3D11DepthStencilView* _depthView;
+	ID3D11Buffer* _paramsBuffer;
+
+	ID3D11Query* _disjoint[QUERY_LATENCY];
+	ID3D11Query* _frameStart[QUERY_LATENCY];
+	ID3D11Query* _frameEnd[QUERY_LATENCY];
+	UINT64 _frame;
+};
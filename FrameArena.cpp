@@ -0,0 +1,229 @@
+#include "FrameArena.h"
+#include <algorithm>
+#include <string.h>
+
+// what the CRT debug heap fills uninitialised and freed memory with
+static const int POISON_RESET = 0xCD;
+static const int POISON_FREED = 0xDD;
+
+struct FrameArena::OverflowBlock
+{
+    OverflowBlock* next;
+    size_t bytes;
+};
+
+// the part of the current buffer this thread is bumping through
+struct ThreadChunk
+{
+    uint64_t generation;
+    uint8_t* cursor;
+    uint8_t* end;
+};
+
+static atomic<uint64_t> s_generation(0);
+static thread_local ThreadChunk t_chunk = { 0, nullptr, nullptr };
+
+static uint8_t* AlignUp(uint8_t* pointer, size_t alignment)
+{
+    return (uint8_t*)(((uintptr_t)pointer + alignment - 1) & ~(uintptr_t)(alignment - 1));
+}
+
+static void* Bump(ThreadChunk& chunk, size_t bytes, size_t alignment)
+{
+    uint8_t* aligned = AlignUp(chunk.cursor, alignment);
+    if (aligned > chunk.end || (size_t)(chunk.end - aligned) < bytes)
+        return nullptr;
+
+    chunk.cursor = aligned + bytes;
+    return aligned;
+}
+
+FrameArena::FrameArena()
+{
+    for (FrameBuffer& buffer : _buffers)
+    {
+        buffer.memory = nullptr;
+        buffer.offset = 0;
+        buffer.overflow = nullptr;
+        buffer.live = 0;
+    }
+
+    _frameCount = 1;
+    _capacity = 0;
+    _frame = 0;
+    _generation = ++s_generation;
+    _peakBytes = 0;
+    _overflowAllocations = 0;
+    _leakedAllocations = 0;
+}
+
+FrameArena::~FrameArena()
+{
+    Release();
+}
+
+void FrameArena::Init(size_t bytesPerFrame, uint32_t frameCount)
+{
+    Release();
+
+    _frameCount = min(max(frameCount, 1u), (uint32_t)MAX_FRAMES);
+    _capacity = bytesPerFrame;
+    for (uint32_t i = 0; i < _frameCount; ++i)
+        _buffers[i].memory = static_cast<uint8_t*>(MemoryTracker::Allocate(_capacity, MEMORY_TAG_FRAME));
+
+    _frame = 0;
+    _generation = ++s_generation;
+}
+
+void FrameArena::Release()
+{
+    for (FrameBuffer& buffer : _buffers)
+    {
+        Reset(buffer);
+        MemoryTracker::Free(buffer.memory);
+        buffer.memory = nullptr;
+    }
+
+    _frameCount = 1;
+    _capacity = 0;
+    _generation = ++s_generation;
+}
+
+void FrameArena::BeginFrame()
+{
+    _peakBytes = max(_peakBytes, GetUsedBytes());
+
+    ++_frame;
+    Reset(_buffers[_frame % _frameCount]);
+
+    // every thread's chunk belonged to an older frame now
+    _generation = ++s_generation;
+}
+
+size_t FrameArena::GetUsedBytes() const
+{
+    return min(_buffers[_frame % _frameCount].offset.load(memory_order_relaxed), _capacity);
+}
+
+void FrameArena::Reset(FrameBuffer& buffer)
+{
+#ifndef NDEBUG
+    int64_t live = buffer.live.exchange(0, memory_order_relaxed);
+    if (live > 0)
+        _leakedAllocations += (uint64_t)live;
+
+    if (buffer.memory)
+        memset(buffer.memory, POISON_RESET, min(buffer.offset.load(memory_order_relaxed), _capacity));
+#endif
+
+    OverflowBlock* block = buffer.overflow.exchange(nullptr, memory_order_acquire);
+    while (block)
+    {
+        OverflowBlock* next = block->next;
+        MemoryTracker::Free(block);
+        block = next;
+    }
+
+    buffer.offset.store(0, memory_order_relaxed);
+}
+
+void* FrameArena::Reserve(size_t bytes, size_t alignment)
+{
+    FrameBuffer& buffer = _buffers[_frame % _frameCount];
+
+    // room to align whatever the offset turns out to be
+    size_t size = bytes + alignment - 1;
+    size_t offset = buffer.offset.fetch_add(size, memory_order_relaxed);
+    if (!buffer.memory || offset > _capacity || _capacity - offset < size)
+        return nullptr;
+
+    return AlignUp(buffer.memory + offset, alignment);
+}
+
+void* FrameArena::AllocateOverflow(size_t bytes, size_t alignment)
+{
+    FrameBuffer& buffer = _buffers[_frame % _frameCount];
+
+    size_t size = sizeof(OverflowBlock) + alignment - 1 + bytes;
+    OverflowBlock* block = static_cast<OverflowBlock*>(MemoryTracker::Allocate(size, MEMORY_TAG_FRAME));
+    block->bytes = size;
+
+    block->next = buffer.overflow.load(memory_order_relaxed);
+    while (!buffer.overflow.compare_exchange_weak(block->next, block, memory_order_release, memory_order_relaxed))
+    {
+    }
+
+    _overflowAllocations.fetch_add(1, memory_order_relaxed);
+    return AlignUp((uint8_t*)(block + 1), alignment);
+}
+
+void* FrameArena::Allocate(size_t bytes, size_t alignment)
+{
+    ThreadChunk& chunk = t_chunk;
+    void* memory = nullptr;
+
+    if (chunk.generation == _generation)
+        memory = Bump(chunk, bytes, alignment);
+
+    if (!memory)
+    {
+        // big blocks come straight out of the buffer rather than wasting most of a chunk
+        if (bytes + alignment > CHUNK_SIZE / 4)
+        {
+            memory = Reserve(bytes, alignment);
+        }
+        else if (uint8_t* start = static_cast<uint8_t*>(Reserve(CHUNK_SIZE, 1)))
+        {
+            chunk.generation = _generation;
+            chunk.cursor = start;
+            chunk.end = start + CHUNK_SIZE;
+            memory = Bump(chunk, bytes, alignment);
+        }
+    }
+
+    if (!memory)
+        memory = AllocateOverflow(bytes, alignment);
+
+#ifndef NDEBUG
+    _buffers[_frame % _frameCount].live.fetch_add(1, memory_order_relaxed);
+#endif
+    return memory;
+}
+
+FrameArena::FrameBuffer* FrameArena::FindBuffer(void* memory)
+{
+    uint8_t* pointer = static_cast<uint8_t*>(memory);
+
+    for (uint32_t i = 0; i < _frameCount; ++i)
+    {
+        FrameBuffer& buffer = _buffers[i];
+        if (buffer.memory && pointer >= buffer.memory && pointer < buffer.memory + _capacity)
+            return &buffer;
+
+        // overflow is rare, walking the list is fine for a debug check
+        for (OverflowBlock* block = buffer.overflow.load(memory_order_acquire); block; block = block->next)
+        {
+            if (pointer > (uint8_t*)block && pointer < (uint8_t*)block + block->bytes)
+                return &buffer;
+        }
+    }
+
+    return nullptr;
+}
+
+void FrameArena::Free(void* memory, size_t bytes)
+{
+#ifndef NDEBUG
+    if (!memory)
+        return;
+
+    FrameBuffer* buffer = FindBuffer(memory);
+    if (buffer)
+        buffer->live.fetch_sub(1, memory_order_relaxed);
+
+    memset(memory, POISON_FREED, bytes);
+#else
+    (void)memory;
+    (void)bytes;
+#endif
+}
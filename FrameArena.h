@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+#include "MemoryTracker.h"
+
+using namespace std;
+
+// linear allocator for data that only lives for a frame or two: draw lists, sort keys,
+// culling results. a ring of frame buffers (two or three) is charged to the frame tag
+// once up front, BeginFrame moves to the next one and throws away everything in it, so
+// anything allocated stays valid for frameCount - 1 further frames.
+//
+// each thread bumps through its own chunk of the current buffer and only touches the
+// shared offset (an atomic add) to grab the next chunk. a frame that runs out of room
+// falls back to the heap, those blocks are freed at the same reset and counted so the
+// buffer size can be raised. BeginFrame must not race with allocations on other threads.
+//
+// builds without NDEBUG poison freed and reset memory and count the allocations still
+// live in each buffer, one that is still in use when its buffer comes round again is a leak
+class FrameArena
+{
+public:
+	static const uint32_t MAX_FRAMES = 3;
+	// a thread takes this much of the buffer at a time
+	static const size_t CHUNK_SIZE = 64 * 1024;
+
+	FrameArena();
+	~FrameArena();
+
+	void Init(size_t bytesPerFrame, uint32_t frameCount = 2);
+	void Release();
+
+	void BeginFrame();
+
+	// alignment must be a power of two. never fails, past the buffer it goes to the heap
+	void* Allocate(size_t bytes, size_t alignment = 16);
+	// only builds without NDEBUG do anything with this: poisons the block and drops the live count
+	void Free(void* memory, size_t bytes);
+
+	uint64_t GetFrame() const { return _frame; }
+	size_t GetBytesPerFrame() const { return _capacity; }
+	// bytes handed out of the current buffer, chunks count in full
+	size_t GetUsedBytes() const;
+	size_t GetPeakBytes() const { return _peakBytes; }
+	// heap allocations made because a buffer was full
+	uint64_t GetOverflowAllocations() const { return _overflowAllocations; }
+	// allocations still live when their buffer was reset, always 0 with NDEBUG
+	uint64_t GetLeakedAllocations() const { return _leakedAllocations; }
+
+private:
+	struct OverflowBlock;
+
+	struct FrameBuffer
+	{
+		uint8_t* memory;
+		atomic<size_t> offset;
+		atomic<OverflowBlock*> overflow;
+		atomic<int64_t> live;
+	};
+
+	void* Reserve(size_t bytes, size_t alignment);
+	void* AllocateOverflow(size_t bytes, size_t alignment);
+	void Reset(FrameBuffer& buffer);
+	FrameBuffer* FindBuffer(void* memory);
+
+	FrameBuffer _buffers[MAX_FRAMES];
+	uint32_t _frameCount;
+	size_t _capacity;
+	uint64_t _frame;
+	// unique across every arena and reset, tells a thread its cached chunk is stale
+	uint64_t _generation;
+
+	size_t _peakBytes;
+	atomic<uint64_t> _overflowAllocations;
+	uint64_t _leakedAllocations;
+};
+
+// STL allocator over a frame arena, the container must not outlive the frames the arena
+// keeps. growing a container leaves the old block behind until the reset, reserve first
+template <class T>
+class FrameAllocator
+{
+public:
+	typedef T value_type;
+
+	template <class U> struct rebind { typedef FrameAllocator<U> other; };
+
+	explicit FrameAllocator(FrameArena* arena) : _arena(arena) { }
+	template <class U> FrameAllocator(const FrameAllocator<U>& other) : _arena(other.GetArena()) { }
+
+	T* allocate(size_t count) { return static_cast<T*>(_arena->Allocate(count * sizeof(T), alignof(T))); }
+	void deallocate(T* memory, size_t count) { _arena->Free(memory, count * sizeof(T)); }
+
+	FrameArena* GetArena() const { return _arena; }
+
+	template <class U> bool operator==(const FrameAllocator<U>& other) const { return _arena == other.GetArena(); }
+	template <class U> bool operator!=(const FrameAllocator<U>& other) const { return _arena != other.GetArena(); }
+
+private:
+	FrameArena* _arena;
+};
+
+// memory out of the arena itself, gone at the reset. not to be confused with
+// FrameTaggedVector, which is a heap vector charged to the frame tag
+template <class T> using FrameArenaVector = vector<T, FrameAllocator<T>>;
@@ -0,0 +1,156 @@
+#include "FrameCapture.h"
+#include <algorithm>
+#include <stdio.h>
+
+FrameReadback::FrameReadback()
+{
+    _width = 0;
+    _height = 0;
+    _swapRedBlue = false;
+    _next = 0;
+}
+
+FrameReadback::~FrameReadback()
+{
+    Release();
+}
+
+HRESULT FrameReadback::Initialise(ID3D11Device* device, UINT width, UINT height, DXGI_FORMAT format, UINT latency)
+{
+    // bitmaps store blue first
+    if (format != DXGI_FORMAT_R8G8B8A8_UNORM && format != DXGI_FORMAT_B8G8R8A8_UNORM)
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+    _width = width;
+    _height = height;
+    _swapRedBlue = format == DXGI_FORMAT_R8G8B8A8_UNORM;
+    _next = 0;
+    _checksums.clear();
+
+    D3D11_TEXTURE2D_DESC desc;
+    ZeroMemory(&desc, sizeof(desc));
+    desc.Width = width;
+    desc.Height = height;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = format;
+    desc.SampleDesc.Count = 1;
+    desc.Usage = D3D11_USAGE_STAGING;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+
+    _slots.resize(max(latency, 1u));
+    for (Slot& slot : _slots)
+    {
+        slot.texture = nullptr;
+        slot.frame = 0;
+        slot.pending = false;
+    }
+
+    for (Slot& slot : _slots)
+    {
+        HRESULT hr = device->CreateTexture2D(&desc, nullptr, &slot.texture);
+        if (FAILED(hr))
+        {
+            Release();
+            return hr;
+        }
+    }
+
+    return S_OK;
+}
+
+void FrameReadback::Release()
+{
+    for (Slot& slot : _slots)
+    {
+        if (slot.texture) slot.texture->Release();
+    }
+
+    _slots.clear();
+}
+
+HRESULT FrameReadback::Capture(ID3D11DeviceContext* context, ID3D11Texture2D* source, UINT frame)
+{
+    Slot& slot = _slots[_next];
+
+    // the oldest copy, long enough ago that the map shouldn't wait
+    if (slot.pending)
+    {
+        HRESULT hr = ReadSlot(context, slot);
+        if (FAILED(hr))
+            return hr;
+    }
+
+    context->CopyResource(slot.texture, source);
+    slot.frame = frame;
+    slot.pending = true;
+
+    _next = (_next + 1) % (UINT)_slots.size();
+    return S_OK;
+}
+
+HRESULT FrameReadback::Flush(ID3D11DeviceContext* context)
+{
+    for (UINT i = 0; i < _slots.size(); ++i)
+    {
+        Slot& slot = _slots[(_next + i) % _slots.size()];
+        if (!slot.pending)
+            continue;
+
+        HRESULT hr = ReadSlot(context, slot);
+        if (FAILED(hr))
+            return hr;
+    }
+
+    return S_OK;
+}
+
+HRESULT FrameReadback::ReadSlot(ID3D11DeviceContext* context, Slot& slot)
+{
+    slot.pending = false;
+
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    HRESULT hr = context->Map(slot.texture, 0, D3D11_MAP_READ, 0, &mapped);
+    if (FAILED(hr))
+        return hr;
+
+    const uint8_t* texels = (const uint8_t*)mapped.pData;
+    FrameChecksum result = { slot.frame, ChecksumFrame(texels, _width, _height, mapped.RowPitch) };
+    _checksums.push_back(result);
+
+    if (!_imageDirectory.empty())
+        hr = WriteImage(slot.frame, texels, mapped.RowPitch);
+
+    context->Unmap(slot.texture, 0);
+    return hr;
+}
+
+HRESULT FrameReadback::WriteImage(UINT frame, const uint8_t* texels, UINT rowPitch)
+{
+    wchar_t fileName[MAX_PATH];
+    swprintf_s(fileName, L"%s\\frame_%05u.bmp", _imageDirectory.c_str(), frame);
+
+    EncodeFrameBitmap(texels, _width, _height, rowPitch, _swapRedBlue, _bitmap);
+
+    HANDLE file = CreateFileW(fileName, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    DWORD written = 0;
+    bool ok = WriteFile(file, _bitmap.data(), (DWORD)_bitmap.size(), &written, nullptr) && written == _bitmap.size();
+
+    CloseHandle(file);
+    return ok ? S_OK : E_FAIL;
+}
+
+HRESULT FrameReadback::WriteChecksums(const wchar_t* fileName) const
+{
+    FILE* file = nullptr;
+    if (_wfopen_s(&file, fileName, L"wt") != 0 || !file)
+        return HRESULT_FROM_WIN32(ERROR_CANNOT_MAKE);
+
+    fputs(FormatFrameChecksums(_checksums).c_str(), file);
+
+    fclose(file);
+    return S_OK;
+}
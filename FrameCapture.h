@@ -0,0 +1,57 @@
+#pragma once
+
+#include <windows.h>
+#include <d3d11_1.h>
+#include <vector>
+#include <string>
+
+#include "FrameImage.h"
+
+using namespace std;
+
+// copies rendered frames into a ring of staging textures and only maps a copy once the
+// ring comes back round to it, so the GPU is a few frames ahead of the readback instead
+// of draining the pipeline every frame. each frame is checksummed and optionally written
+// out as a 32 bit .bmp
+class FrameReadback
+{
+public:
+	FrameReadback();
+	~FrameReadback();
+
+	// format must be R8G8B8A8_UNORM or B8G8R8A8_UNORM, latency is the number of frames in flight
+	HRESULT Initialise(ID3D11Device* device, UINT width, UINT height, DXGI_FORMAT format, UINT latency = 3);
+	void Release();
+
+	// images go to directory\frame_00000.bmp and so on, empty for checksums only
+	void SetImageDirectory(const wstring& directory) { _imageDirectory = directory; }
+
+	// queues a copy of source, reading back the frame that was queued latency frames ago
+	HRESULT Capture(ID3D11DeviceContext* context, ID3D11Texture2D* source, UINT frame);
+	// reads back everything still in flight, in frame order
+	HRESULT Flush(ID3D11DeviceContext* context);
+
+	const vector<FrameChecksum>& GetChecksums() const { return _checksums; }
+	// one "frame checksum" line per frame, checksum in hex
+	HRESULT WriteChecksums(const wchar_t* fileName) const;
+
+private:
+	struct Slot
+	{
+		ID3D11Texture2D* texture;
+		UINT frame;
+		bool pending;
+	};
+
+	HRESULT ReadSlot(ID3D11DeviceContext* context, Slot& slot);
+	HRESULT WriteImage(UINT frame, const uint8_t* texels, UINT rowPitch);
+
+	UINT _width;
+	UINT _height;
+	bool _swapRedBlue;
+	UINT _next;
+	vector<Slot> _slots;
+	vector<uint8_t> _bitmap;
+	wstring _imageDirectory;
+	vector<FrameChecksum> _checksums;
+};
@@ -0,0 +1,97 @@
+#include "FrameImage.h"
+#include <stdio.h>
+#include <string.h>
+
+static const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+static const uint64_t FNV_PRIME = 1099511628211ull;
+
+// BITMAPFILEHEADER and BITMAPINFOHEADER
+static const uint32_t BITMAP_FILE_HEADER_BYTES = 14;
+static const uint32_t BITMAP_INFO_HEADER_BYTES = 40;
+
+uint64_t ChecksumFrame(const uint8_t* texels, uint32_t width, uint32_t height, uint32_t rowPitch)
+{
+    uint64_t checksum = FNV_OFFSET_BASIS;
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint8_t* row = texels + (size_t)y * rowPitch;
+        for (uint32_t x = 0; x < width * 4; ++x)
+            checksum = (checksum ^ row[x]) * FNV_PRIME;
+    }
+
+    return checksum;
+}
+
+//--------------------------------------------------------------------------------------
+// Bitmaps
+//--------------------------------------------------------------------------------------
+static void Write16(uint8_t*& out, uint16_t value)
+{
+    *out++ = (uint8_t)value;
+    *out++ = (uint8_t)(value >> 8);
+}
+
+static void Write32(uint8_t*& out, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i)
+        *out++ = (uint8_t)(value >> (i * 8));
+}
+
+void EncodeFrameBitmap(const uint8_t* texels, uint32_t width, uint32_t height, uint32_t rowPitch, bool swapRedBlue,
+                       vector<uint8_t>& bitmap)
+{
+    uint32_t rowBytes = width * 4;
+    uint32_t imageSize = rowBytes * height;
+    uint32_t offBits = BITMAP_FILE_HEADER_BYTES + BITMAP_INFO_HEADER_BYTES;
+    bitmap.resize(offBits + imageSize);
+
+    // the headers are written field by field, little endian as the format has them
+    uint8_t* out = bitmap.data();
+    Write16(out, 0x4D42); // "BM"
+    Write32(out, offBits + imageSize);
+    Write32(out, 0);
+    Write32(out, offBits);
+
+    // negative height for top down rows
+    Write32(out, BITMAP_INFO_HEADER_BYTES);
+    Write32(out, width);
+    Write32(out, (uint32_t)-(int32_t)height);
+    Write16(out, 1);  // planes
+    Write16(out, 32); // bits per pixel
+    Write32(out, 0);  // BI_RGB
+    Write32(out, imageSize);
+    Write32(out, 0);
+    Write32(out, 0);
+    Write32(out, 0);
+    Write32(out, 0);
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        memcpy(out, texels + (size_t)y * rowPitch, rowBytes);
+
+        if (swapRedBlue)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                uint8_t red = out[x * 4];
+                out[x * 4] = out[x * 4 + 2];
+                out[x * 4 + 2] = red;
+            }
+        }
+
+        out += rowBytes;
+    }
+}
+
+string FormatFrameChecksums(const vector<FrameChecksum>& checksums)
+{
+    string text;
+    for (const FrameChecksum& result : checksums)
+    {
+        char line[64];
+        snprintf(line, sizeof(line), "%u %016llx\n", result.Frame, (unsigned long long)result.Checksum);
+        text += line;
+    }
+
+    return text;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// what a rendered frame becomes once it is on the CPU: a checksum to compare runs by and a
+// bitmap to look at. kept free of windows and d3d headers, FrameReadback feeds it from
+// D3D11 staging textures and the software rasteriser from its own colour buffer
+
+struct FrameChecksum
+{
+	uint32_t Frame;
+	// FNV-1a over the visible texels row by row, the row pitch padding is skipped
+	uint64_t Checksum;
+};
+
+// width x height texels of 4 bytes, rowPitch bytes from one row to the next
+uint64_t ChecksumFrame(const uint8_t* texels, uint32_t width, uint32_t height, uint32_t rowPitch);
+
+// a 32 bit .bmp with the rows top down as the texels have them. bitmaps store blue first,
+// so RGBA texels need swapRedBlue
+void EncodeFrameBitmap(const uint8_t* texels, uint32_t width, uint32_t height, uint32_t rowPitch, bool swapRedBlue,
+                       vector<uint8_t>& bitmap);
+
+// one "frame checksum" line per frame, checksum in hex
+string FormatFrameChecksums(const vector<FrameChecksum>& checksums);
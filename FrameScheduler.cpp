@@ -0,0 +1,127 @@
+#include "FrameScheduler.h"
+#include <algorithm>
+#include <stdio.h>
+
+//--------------------------------------------------------------------------------------
+// VirtualFrameClock
+//--------------------------------------------------------------------------------------
+VirtualFrameClock::VirtualFrameClock(double sleepOvershoot, double spinStep)
+{
+    _now = 0.0;
+    _sleepOvershoot = sleepOvershoot;
+    _spinStep = spinStep;
+    _sleeps = 0;
+    _spins = 0;
+}
+
+bool VirtualFrameClock::SleepFor(double seconds)
+{
+    _now += seconds + _sleepOvershoot;
+    ++_sleeps;
+    return true;
+}
+
+void VirtualFrameClock::Spin()
+{
+    _now += _spinStep;
+    ++_spins;
+}
+
+//--------------------------------------------------------------------------------------
+// FrameScheduler
+//--------------------------------------------------------------------------------------
+FrameScheduler::FrameScheduler()
+{
+    _clock = nullptr;
+    _targetRate = 0.0;
+    _throttleRate = 10.0;
+    _spinThreshold = 0.002;
+    _throttled = false;
+    _wasThrottled = false;
+    _deadline = 0.0;
+    _lastFrameStart = 0.0;
+    _frameCount = 0;
+}
+
+void FrameScheduler::Init(FrameClock* clock, double targetRate)
+{
+    _clock = clock;
+    _targetRate = targetRate;
+    _throttled = false;
+    _wasThrottled = false;
+    _frameCount = 0;
+    _frameTimes.assign(HISTORY, 0.0);
+    _deadline = clock->Now();
+    _lastFrameStart = _deadline;
+}
+
+bool FrameScheduler::WaitForNextFrame()
+{
+    double rate = _throttled ? _throttleRate : _targetRate;
+
+    // the old deadline was set for the other rate
+    if (_throttled != _wasThrottled)
+    {
+        _deadline = _clock->Now();
+        _wasThrottled = _throttled;
+    }
+
+    if (rate > 0.0)
+    {
+        for (;;)
+        {
+            double remaining = _deadline - _clock->Now();
+            if (remaining <= 0.0)
+                break;
+
+            if (remaining > _spinThreshold)
+            {
+                if (!_clock->SleepFor(remaining - _spinThreshold))
+                    return false;
+            }
+            else
+            {
+                _clock->Spin();
+            }
+        }
+    }
+
+    double now = _clock->Now();
+
+    if (rate > 0.0)
+    {
+        // hold a steady cadence through small misses, but after a stall of more than a
+        // frame start over from now rather than rushing frames out to catch up
+        double period = 1.0 / rate;
+        _deadline = now - _deadline > period ? now + period : _deadline + period;
+    }
+
+    if (_frameCount > 0)
+        _frameTimes[(_frameCount - 1) % HISTORY] = now - _lastFrameStart;
+
+    _lastFrameStart = now;
+    ++_frameCount;
+
+    return true;
+}
+
+double FrameScheduler::GetFrameTimePercentile(double percentile) const
+{
+    uint32_t count = GetRecordedFrames();
+    if (count == 0)
+        return 0.0;
+
+    vector<double> sorted(_frameTimes.begin(), _frameTimes.begin() + count);
+    size_t rank = min((size_t)(percentile / 100.0 * count), (size_t)count - 1);
+    nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+string FrameScheduler::FormatReport(const char* label) const
+{
+    char line[256];
+    snprintf(line, sizeof(line), "%s: %llu frames, frame time p50 %.2f ms, p95 %.2f ms, p99 %.2f ms\n", label,
+             (unsigned long long)_frameCount, GetFrameTimePercentile(50.0) * 1000.0, GetFrameTimePercentile(95.0) * 1000.0,
+             GetFrameTimePercentile(99.0) * 1000.0);
+    return line;
+}
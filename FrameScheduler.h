@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// where the scheduler gets its time from, swapped for VirtualFrameClock to check the pacing.
+// SystemFrameClock.h has the real one, nothing here needs windows.h
+class FrameClock
+{
+public:
+	virtual ~FrameClock() {}
+
+	// seconds from some fixed point
+	virtual double Now() = 0;
+	// coarse wait that may overshoot, false when it was cut short by window messages
+	virtual bool SleepFor(double seconds) = 0;
+	// one step of a busy wait
+	virtual void Spin() = 0;
+};
+
+// time only moves when the scheduler sleeps or spins or the caller advances it, so the
+// pacing can be checked without a real clock. sleeps overshoot by a fixed amount the way
+// a coarse OS timer does
+class VirtualFrameClock : public FrameClock
+{
+public:
+	VirtualFrameClock(double sleepOvershoot = 0.001, double spinStep = 0.00001);
+
+	double Now() override { return _now; }
+	bool SleepFor(double seconds) override;
+	void Spin() override;
+
+	// simulated work between frames
+	void Advance(double seconds) { _now += seconds; }
+
+	uint32_t GetSleepCount() const { return _sleeps; }
+	uint32_t GetSpinCount() const { return _spins; }
+
+private:
+	double _now;
+	double _sleepOvershoot;
+	double _spinStep;
+	uint32_t _sleeps;
+	uint32_t _spins;
+};
+
+// paces the main loop to a target rate. it sleeps until just before the frame is due and
+// spins the rest of the way, so the OS timer's granularity doesn't show up as jitter. a
+// throttled scheduler (window minimised or occluded) ticks at a low fixed rate instead
+class FrameScheduler
+{
+public:
+	FrameScheduler();
+
+	void Init(FrameClock* clock, double targetRate);
+
+	// frames per second, 0 leaves the pace to vsync and the swap chain
+	void SetTargetRate(double rate) { _targetRate = rate; }
+	void SetThrottled(bool throttled) { _throttled = throttled; }
+	void SetThrottleRate(double rate) { _throttleRate = rate; }
+	// how long before the deadline to stop sleeping and start spinning
+	void SetSpinThreshold(double seconds) { _spinThreshold = seconds; }
+
+	// waits for the next frame to be due. false when window messages cut the wait short,
+	// pump them and call again
+	bool WaitForNextFrame();
+
+	// over the most recent frames, start to start, in seconds
+	double GetFrameTimePercentile(double percentile) const;
+	// frame times held for the percentiles, the first frame has nothing to measure against
+	uint32_t GetRecordedFrames() const { return (uint32_t)min(_frameCount > 0 ? _frameCount - 1 : 0, (uint64_t)HISTORY); }
+	// a line with the median, 95th and 99th percentile frame times
+	string FormatReport(const char* label) const;
+
+private:
+	static const uint32_t HISTORY = 512;
+
+	FrameClock* _clock;
+	double _targetRate;
+	double _throttleRate;
+	double _spinThreshold;
+	bool _throttled;
+	bool _wasThrottled;
+
+	double _deadline;
+	double _lastFrameStart;
+	uint64_t _frameCount;
+	vector<double> _frameTimes;
+};
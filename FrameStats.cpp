@@ -0,0 +1,221 @@
+#include "FrameStats.h"
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <wctype.h>
+
+// the median needs a few frames behind it before anything counts as a stutter
+static const uint32_t MIN_STUTTER_HISTORY = 10;
+
+static FILE* OpenOutputFile(const wchar_t* fileName)
+{
+#ifdef _WIN32
+    FILE* file = nullptr;
+    return _wfopen_s(&file, fileName, L"wt") == 0 ? file : nullptr;
+#else
+    char path[1024];
+    if (wcstombs(path, fileName, sizeof(path)) == (size_t)-1)
+        return nullptr;
+
+    return fopen(path, "w");
+#endif
+}
+
+static bool IsJsonFile(const wchar_t* fileName)
+{
+    const wchar_t* extension = wcsrchr(fileName, L'.');
+    if (!extension || wcslen(extension) != 5)
+        return false;
+
+    const wchar_t* json = L".json";
+    for (int i = 0; i < 5; ++i)
+    {
+        if (towlower(extension[i]) != (wint_t)json[i])
+            return false;
+    }
+    return true;
+}
+
+FrameStats::FrameStats()
+{
+    _clock = nullptr;
+    _file = nullptr;
+    _json = false;
+    _fileFrames = 0;
+    _stutterMultiple = 2.0f;
+    memset(&_current, 0, sizeof(_current));
+    memset(&_pending, 0, sizeof(_pending));
+    memset(&_last, 0, sizeof(_last));
+    _hasPending = false;
+    _frameStart = 0.0;
+    _frameCount = 0;
+    _stutterCount = 0;
+    memset(_histogram, 0, sizeof(_histogram));
+
+    // both fill up in the first frames, so they are sized now rather than then
+    _recent.reserve(MEDIAN_WINDOW);
+    _stutterFrames.assign(MAX_STUTTER_FRAMES, 0);
+}
+
+FrameStats::~FrameStats()
+{
+    Close();
+}
+
+void FrameStats::Init(FrameClock* clock)
+{
+    _clock = clock;
+}
+
+bool FrameStats::Open(const wchar_t* fileName)
+{
+    Close();
+
+    _file = OpenOutputFile(fileName);
+    if (!_file)
+        return false;
+
+    _json = IsJsonFile(fileName);
+    _fileFrames = 0;
+
+    if (_json)
+        fprintf(_file, "{\n\"frames\": [\n");
+    else
+        fprintf(_file, "frame,frame_ms,present_ms,draw_calls,triangles,state_changes,constant_buffer_bytes,srv_binds,stutter\n");
+
+    return true;
+}
+
+void FrameStats::Close()
+{
+    if (!_file)
+        return;
+
+    if (_json)
+    {
+        fprintf(_file, "\n],\n\"median_ms\": %.3f,\n\"stutter_multiple\": %.2f,\n\"stutters\": [", GetMedianFrameMs(), _stutterMultiple);
+        vector<uint64_t> stutters;
+        GetStutterFrames(stutters);
+        for (size_t i = 0; i < stutters.size(); ++i)
+            fprintf(_file, "%s%llu", i ? ", " : "", (unsigned long long)stutters[i]);
+
+        // bucket i counts frames of i to i+1 ms
+        fprintf(_file, "],\n\"histogram_ms\": [");
+        for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; ++i)
+            fprintf(_file, "%s%u", i ? ", " : "", _histogram[i]);
+        fprintf(_file, "]\n}\n");
+    }
+
+    fclose(_file);
+    _file = nullptr;
+}
+
+void FrameStats::BeginFrame()
+{
+    double now = _clock ? _clock->Now() : 0.0;
+
+    if (_hasPending)
+    {
+        _pending.FrameMs = (now - _frameStart) * 1000.0;
+        FinishFrame(_pending);
+        _hasPending = false;
+    }
+
+    _frameStart = now;
+    memset(&_current, 0, sizeof(_current));
+}
+
+void FrameStats::EndFrame()
+{
+    _pending = _current;
+    _hasPending = true;
+}
+
+double FrameStats::GetMedianFrameMs() const
+{
+    if (_recent.empty())
+        return 0.0;
+
+    // called every frame, so sorted on the stack rather than in a copy of the vector
+    double sorted[MEDIAN_WINDOW];
+    size_t count = _recent.size();
+    copy(_recent.begin(), _recent.end(), sorted);
+    nth_element(sorted, sorted + count / 2, sorted + count);
+    return sorted[count / 2];
+}
+
+void FrameStats::GetStutterFrames(vector<uint64_t>& frames) const
+{
+    frames.clear();
+    uint64_t kept = min(_stutterCount, (uint64_t)MAX_STUTTER_FRAMES);
+    for (uint64_t i = _stutterCount - kept; i < _stutterCount; ++i)
+        frames.push_back(_stutterFrames[i % MAX_STUTTER_FRAMES]);
+}
+
+void FrameStats::FinishFrame(RenderStats& stats)
+{
+    // against the frames before it, so one long frame doesn't raise its own bar
+    stats.Stutter = _recent.size() >= MIN_STUTTER_HISTORY && stats.FrameMs > GetMedianFrameMs() * _stutterMultiple;
+    if (stats.Stutter)
+    {
+        _stutterFrames[_stutterCount % MAX_STUTTER_FRAMES] = _frameCount;
+        _stutterCount++;
+    }
+
+    if (_recent.size() < MEDIAN_WINDOW)
+        _recent.push_back(stats.FrameMs);
+    else
+        _recent[_frameCount % MEDIAN_WINDOW] = stats.FrameMs;
+
+    _histogram[min((uint32_t)max(stats.FrameMs, 0.0), HISTOGRAM_BUCKETS - 1)]++;
+
+    unsigned long long frame = _frameCount;
+    if (_file && _json)
+    {
+        fprintf(_file, "%s{\"frame\": %llu, \"frame_ms\": %.3f, \"present_ms\": %.3f, \"draw_calls\": %u, \"triangles\": %llu, "
+                       "\"state_changes\": %u, \"constant_buffer_bytes\": %llu, \"srv_binds\": %u, \"stutter\": %s}",
+                _fileFrames ? ",\n" : "", frame, stats.FrameMs, stats.PresentMs, stats.DrawCalls, (unsigned long long)stats.Triangles,
+                stats.StateChanges, (unsigned long long)stats.ConstantBufferBytes, stats.ShaderResourceBinds,
+                stats.Stutter ? "true" : "false");
+    }
+    else if (_file)
+    {
+        fprintf(_file, "%llu,%.3f,%.3f,%u,%llu,%u,%llu,%u,%d\n", frame, stats.FrameMs, stats.PresentMs, stats.DrawCalls,
+                (unsigned long long)stats.Triangles, stats.StateChanges, (unsigned long long)stats.ConstantBufferBytes,
+                stats.ShaderResourceBinds, stats.Stutter ? 1 : 0);
+    }
+
+    if (_file)
+        _fileFrames++;
+
+    _last = stats;
+    _frameCount++;
+}
+
+void FrameStats::FormatOverlay(char* text, size_t length) const
+{
+    snprintf(text, length, "%.2f ms (median %.2f)  %u draws  %llu tris  %u state  %llu cb bytes  %u srvs  present %.2f ms  %llu stutters",
+             _last.FrameMs, GetMedianFrameMs(), _last.DrawCalls, (unsigned long long)_last.Triangles, _last.StateChanges,
+             (unsigned long long)_last.ConstantBufferBytes, _last.ShaderResourceBinds, _last.PresentMs,
+             (unsigned long long)_stutterCount);
+}
+
+string FrameStats::FormatReport() const
+{
+    char line[256];
+    snprintf(line, sizeof(line), "frame stats: %llu frames, median %.2f ms, %llu stutters (over %.1fx median)\n",
+             (unsigned long long)_frameCount, GetMedianFrameMs(), (unsigned long long)_stutterCount, _stutterMultiple);
+    string report = line;
+
+    for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; ++i)
+    {
+        if (_histogram[i] == 0)
+            continue;
+
+        snprintf(line, sizeof(line), "  %3u%s ms: %u\n", i, i == HISTOGRAM_BUCKETS - 1 ? "+" : "", _histogram[i]);
+        report += line;
+    }
+
+    return report;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "FrameScheduler.h"
+
+using namespace std;
+
+// what one frame asked of the API, counted by CaptureContext as the calls go through it
+struct RenderStats
+{
+	uint32_t DrawCalls;
+	uint64_t Triangles;
+	// shader, buffer, input layout, topology, state object, sampler, viewport and target binds
+	uint32_t StateChanges;
+	// UpdateSubresource and Map uploads into constant buffers
+	uint64_t ConstantBufferBytes;
+	// views bound with *SetShaderResources
+	uint32_t ShaderResourceBinds;
+	double PresentMs;
+	// start of this frame to the start of the next
+	double FrameMs;
+	bool Stutter;
+};
+
+// collects RenderStats per frame, keeps a frame time histogram and flags stutters (frames
+// more than a multiple of the recent median). frames can be streamed to a CSV file, or a
+// JSON file with the histogram and stutter list added when it is closed. nothing here
+// needs windows.h, the time comes from a FrameClock and nothing allocates once Init is done
+class FrameStats
+{
+public:
+	// 1ms buckets, the last one takes everything longer
+	static const uint32_t HISTOGRAM_BUCKETS = 100;
+	// the most recent stutters are kept for the JSON file, older ones are only counted
+	static const uint32_t MAX_STUTTER_FRAMES = 1024;
+
+	FrameStats();
+	~FrameStats();
+
+	void Init(FrameClock* clock);
+
+	// .json writes JSON, anything else CSV
+	bool Open(const wchar_t* fileName);
+	void Close();
+
+	// frames over multiple times the median of the last MEDIAN_WINDOW frames are stutters
+	void SetStutterThreshold(float multiple) { _stutterMultiple = multiple; }
+
+	// a frame's time runs to the next BeginFrame, so it is finished (and written) then
+	void BeginFrame();
+	void EndFrame();
+
+	void CountDraw(uint64_t triangles) { _current.DrawCalls++; _current.Triangles += triangles; }
+	void CountStateChanges(uint32_t count) { _current.StateChanges += count; }
+	void CountConstantUpload(uint64_t bytes) { _current.ConstantBufferBytes += bytes; }
+	void CountShaderResources(uint32_t views) { _current.ShaderResourceBinds += views; }
+	void SetPresentTime(double ms) { _current.PresentMs = ms; }
+
+	// the last complete frame
+	const RenderStats& GetLast() const { return _last; }
+	uint64_t GetFrameCount() const { return _frameCount; }
+	uint64_t GetStutterCount() const { return _stutterCount; }
+	const uint32_t* GetHistogram() const { return _histogram; }
+	double GetMedianFrameMs() const;
+	// frame numbers of the kept stutters, oldest first
+	void GetStutterFrames(vector<uint64_t>& frames) const;
+
+	// one line summary for the window title
+	void FormatOverlay(char* text, size_t length) const;
+	// median, stutters and a line per non-empty histogram bucket
+	string FormatReport() const;
+
+private:
+	static const uint32_t MEDIAN_WINDOW = 120;
+
+	void FinishFrame(RenderStats& stats);
+
+	FrameClock* _clock;
+	FILE* _file;
+	bool _json;
+	// frames written since Open, the first JSON one goes without a separator
+	uint64_t _fileFrames;
+	float _stutterMultiple;
+
+	RenderStats _current;
+	// ended but waiting on the next BeginFrame for its frame time
+	RenderStats _pending;
+	bool _hasPending;
+	RenderStats _last;
+	double _frameStart;
+	uint64_t _frameCount;
+	uint64_t _stutterCount;
+	uint32_t _histogram[HISTOGRAM_BUCKETS];
+	vector<double> _recent;
+	// a ring of MAX_STUTTER_FRAMES, _stutterCount says where the next one goes
+	vector<uint64_t> _stutterFrames;
+};
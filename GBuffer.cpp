@@ -0,0 +1,168 @@
+#include "GBuffer.h"
+
+// mirrors cbuffer DeferredParams in DX11 Framework.fx
+struct DeferredParams
+{
+    XMMATRIX InvViewProjection;
+    XMFLOAT2 ScreenSize;
+    XMFLOAT2 Padding;
+};
+
+static const DXGI_FORMAT GBUFFER_FORMATS[] = { DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_R10G10B10A2_UNORM };
+
+//--------------------------------------------------------------------------------------
+// GBuffer
+//--------------------------------------------------------------------------------------
+GBuffer::GBuffer()
+{
+    _width = 0;
+    _height = 0;
+    for (UINT i = 0; i < TARGET_COUNT; ++i)
+    {
+        _targets[i] = nullptr;
+        _targetViews[i] = nullptr;
+        _targetResources[i] = nullptr;
+    }
+    _depth = nullptr;
+    _depthView = nullptr;
+    _depthResource = nullptr;
+    _paramsBuffer = nullptr;
+}
+
+GBuffer::~GBuffer()
+{
+    Release();
+}
+
+HRESULT GBuffer::Initialise(ID3D11Device* device, UINT width, UINT height)
+{
+    Release();
+
+    _width = width;
+    _height = height;
+
+    D3D11_TEXTURE2D_DESC desc;
+    ZeroMemory(&desc, sizeof(desc));
+    desc.Width = width;
+    desc.Height = height;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.SampleDesc.Count = 1;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+
+    HRESULT hr = S_OK;
+    for (UINT i = 0; i < TARGET_COUNT && SUCCEEDED(hr); ++i)
+    {
+        desc.Format = GBUFFER_FORMATS[i];
+        hr = device->CreateTexture2D(&desc, nullptr, &_targets[i]);
+        if (SUCCEEDED(hr))
+            hr = device->CreateRenderTargetView(_targets[i], nullptr, &_targetViews[i]);
+        if (SUCCEEDED(hr))
+            hr = device->CreateShaderResourceView(_targets[i], nullptr, &_targetResources[i]);
+    }
+
+    // typeless so the lighting pass can read the depth the geometry pass wrote
+    if (SUCCEEDED(hr))
+    {
+        desc.Format = DXGI_FORMAT_R24G8_TYPELESS;
+        desc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
+        hr = device->CreateTexture2D(&desc, nullptr, &_depth);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc;
+        ZeroMemory(&dsvDesc, sizeof(dsvDesc));
+        dsvDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+        dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+        hr = device->CreateDepthStencilView(_depth, &dsvDesc, &_depthView);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+        ZeroMemory(&srvDesc, sizeof(srvDesc));
+        srvDesc.Format = DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
+        srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+        srvDesc.Texture2D.MipLevels = 1;
+        hr = device->CreateShaderResourceView(_depth, &srvDesc, &_depthResource);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        D3D11_BUFFER_DESC bd;
+        ZeroMemory(&bd, sizeof(bd));
+        bd.Usage = D3D11_USAGE_DEFAULT;
+        bd.ByteWidth = sizeof(DeferredParams);
+        bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        hr = device->CreateBuffer(&bd, nullptr, &_paramsBuffer);
+    }
+
+    if (FAILED(hr))
+        Release();
+
+    return hr;
+}
+
+void GBuffer::Release()
+{
+    for (UINT i = 0; i < TARGET_COUNT; ++i)
+    {
+        if (_targetResources[i]) _targetResources[i]->Release();
+        if (_targetViews[i]) _targetViews[i]->Release();
+        if (_targets[i]) _targets[i]->Release();
+        _targetResources[i] = nullptr;
+        _targetViews[i] = nullptr;
+        _targets[i] = nullptr;
+    }
+
+    if (_depthResource) _depthResource->Release();
+    if (_depthView) _depthView->Release();
+    if (_depth) _depth->Release();
+    if (_paramsBuffer) _paramsBuffer->Release();
+
+    _depthResource = nullptr;
+    _depthView = nullptr;
+    _depth = nullptr;
+    _paramsBuffer = nullptr;
+}
+
+void GBuffer::Begin(ID3D11DeviceContext* context)
+{
+    // albedo clears to black with no specular, the normal clear is unused as the
+    // lighting pass skips pixels nothing was drawn to
+    float clear[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (UINT i = 0; i < TARGET_COUNT; ++i)
+        context->ClearRenderTargetView(_targetViews[i], clear);
+
+    context->ClearDepthStencilView(_depthView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+    context->OMSetRenderTargets(TARGET_COUNT, _targetViews, _depthView);
+}
+
+void GBuffer::BindForLighting(ID3D11DeviceContext* context, const XMFLOAT4X4& view, const XMFLOAT4X4& projection)
+{
+    XMMATRIX viewProjection = XMLoadFloat4x4(&view) * XMLoadFloat4x4(&projection);
+
+    DeferredParams params;
+    params.InvViewProjection = XMMatrixTranspose(XMMatrixInverse(nullptr, viewProjection));
+    // the bound viewport rather than the target size, so a scaled viewport still maps
+    // its pixels back to the right positions
+    D3D11_VIEWPORT vp;
+    UINT viewportCount = 1;
+    context->RSGetViewports(&viewportCount, &vp);
+    params.ScreenSize = viewportCount ? XMFLOAT2(vp.Width, vp.Height) : XMFLOAT2((float)_width, (float)_height);
+    params.Padding = XMFLOAT2(0.0f, 0.0f);
+    context->UpdateSubresource(_paramsBuffer, 0, nullptr, &params, 0, 0);
+
+    ID3D11ShaderResourceView* views[] = { _targetResources[0], _targetResources[1], _depthResource };
+    context->PSSetShaderResources(6, 3, views);
+    context->PSSetConstantBuffers(3, 1, &_paramsBuffer);
+}
+
+void GBuffer::EndLighting(ID3D11DeviceContext* context)
+{
+    // unbound so Begin can use them as targets next frame
+    ID3D11ShaderResourceView* views[] = { nullptr, nullptr, nullptr };
+    context->PSSetShaderResources(6, 3, views);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <windows.h>
+#include <d3d11_1.h>
+#include <directxmath.h>
+
+#include "GBufferPacking.h"
+
+using namespace DirectX;
+
+// render targets for the deferred path. the geometry pass writes them through
+// PS_GBuffer, then PS_DeferredLighting reads them back for a full screen lighting pass
+class GBuffer
+{
+public:
+	GBuffer();
+	~GBuffer();
+
+	HRESULT Initialise(ID3D11Device* device, UINT width, UINT height);
+	void Release();
+
+	// clears the targets and binds them with the G-buffer depth for the geometry pass
+	void Begin(ID3D11DeviceContext* context);
+
+	// albedo on t6, normal on t7, depth on t8, inverse view projection on b3. the
+	// G-buffer must not be bound as a target while these are bound, and the viewport
+	// the geometry pass used must be set
+	void BindForLighting(ID3D11DeviceContext* context, const XMFLOAT4X4& view, const XMFLOAT4X4& projection);
+	void EndLighting(ID3D11DeviceContext* context);
+
+private:
+	static const UINT TARGET_COUNT = 2;
+
+	UINT _width;
+	UINT _height;
+
+	ID3D11Texture2D* _targets[TARGET_COUNT];
+	ID3D11RenderTargetView* _targetViews[TARGET_COUNT];
+	ID3D11ShaderResourceView* _targetResources[TARGET_COUNT];
+	ID3D11Texture2D* _depth;
+	ID3D11DepthStencilView* _depthView;
+	ID3D11ShaderResourceView* _depthResource;
+	ID3D11Buffer* _paramsBuffer;
+};
@@ -0,0 +1,103 @@
+#include "GBufferPacking.h"
+#include <math.h>
+
+static float SignNotZero(float value)
+{
+    return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+static float Saturate(float value)
+{
+    return value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+}
+
+// float to n bit unorm the way the output merger converts it
+static uint32_t ToUnorm(float value, uint32_t bits)
+{
+    float scale = (float)((1u << bits) - 1);
+    return (uint32_t)(Saturate(value) * scale + 0.5f);
+}
+
+static float FromUnorm(uint32_t value, uint32_t bits)
+{
+    return (float)(value & ((1u << bits) - 1)) / (float)((1u << bits) - 1);
+}
+
+void EncodeOctahedral(const float normal[3], float encoded[2])
+{
+    float length = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+    if (length == 0.0f)
+    {
+        encoded[0] = 0.5f;
+        encoded[1] = 0.5f;
+        return;
+    }
+
+    float x = normal[0] / length;
+    float y = normal[1] / length;
+
+    if (normal[2] < 0.0f)
+    {
+        float foldX = (1.0f - fabsf(y)) * SignNotZero(x);
+        float foldY = (1.0f - fabsf(x)) * SignNotZero(y);
+        x = foldX;
+        y = foldY;
+    }
+
+    encoded[0] = x * 0.5f + 0.5f;
+    encoded[1] = y * 0.5f + 0.5f;
+}
+
+void DecodeOctahedral(const float encoded[2], float normal[3])
+{
+    float x = encoded[0] * 2.0f - 1.0f;
+    float y = encoded[1] * 2.0f - 1.0f;
+    float z = 1.0f - fabsf(x) - fabsf(y);
+
+    // unfold the lower hemisphere
+    float t = Saturate(-z);
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+
+    float length = sqrtf(x * x + y * y + z * z);
+    normal[0] = x / length;
+    normal[1] = y / length;
+    normal[2] = z / length;
+}
+
+float EncodeSpecularPower(float power)
+{
+    return Saturate(log2f(power > 1.0f ? power : 1.0f) / log2f(GBUFFER_MAX_SPECULAR_POWER));
+}
+
+float DecodeSpecularPower(float encoded)
+{
+    return exp2f(encoded * log2f(GBUFFER_MAX_SPECULAR_POWER));
+}
+
+uint32_t PackAlbedoSpecular(const float albedo[3], float specularIntensity)
+{
+    return ToUnorm(albedo[0], 8) | (ToUnorm(albedo[1], 8) << 8) | (ToUnorm(albedo[2], 8) << 16) | (ToUnorm(specularIntensity, 8) << 24);
+}
+
+void UnpackAlbedoSpecular(uint32_t packed, float albedo[3], float* specularIntensity)
+{
+    albedo[0] = FromUnorm(packed, 8);
+    albedo[1] = FromUnorm(packed >> 8, 8);
+    albedo[2] = FromUnorm(packed >> 16, 8);
+    *specularIntensity = FromUnorm(packed >> 24, 8);
+}
+
+uint32_t PackNormalSpecularPower(const float normal[3], float specularPower)
+{
+    float encoded[2];
+    EncodeOctahedral(normal, encoded);
+    return ToUnorm(encoded[0], 10) | (ToUnorm(encoded[1], 10) << 10) | (ToUnorm(EncodeSpecularPower(specularPower), 10) << 20);
+}
+
+void UnpackNormalSpecularPower(uint32_t packed, float normal[3], float* specularPower)
+{
+    float encoded[2] = { FromUnorm(packed, 10), FromUnorm(packed >> 10, 10) };
+    DecodeOctahedral(encoded, normal);
+    *specularPower = DecodeSpecularPower(FromUnorm(packed >> 20, 10));
+}
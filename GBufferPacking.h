@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+
+// G-buffer layout, two 32 bit targets plus depth:
+//   albedo:  R8G8B8A8_UNORM     rgb = albedo, a = specular intensity
+//   normal:  R10G10B10A2_UNORM  rg = octahedral world normal, b = log encoded specular power
+//   depth:   D24_UNORM_S8_UINT  read back to rebuild the world position
+// the functions below are the cpu reference for the packing the shader does, the
+// hlsl functions of the same name in DX11 Framework.fx must stay in step with them.
+// they need no windows or d3d headers so they can be checked anywhere
+
+// largest specular power the normal target can hold, powers are stored as log2(power) / log2(max)
+static const float GBUFFER_MAX_SPECULAR_POWER = 2048.0f;
+
+// unit vector to [0, 1]^2, folds the lower hemisphere over the upper one's diagonals
+void EncodeOctahedral(const float normal[3], float encoded[2]);
+void DecodeOctahedral(const float encoded[2], float normal[3]);
+
+float EncodeSpecularPower(float power);
+float DecodeSpecularPower(float encoded);
+
+// what the render targets hold, packed the way the hardware stores the unorm formats
+uint32_t PackAlbedoSpecular(const float albedo[3], float specularIntensity);
+void UnpackAlbedoSpecular(uint32_t packed, float albedo[3], float* specularIntensity);
+uint32_t PackNormalSpecularPower(const float normal[3], float specularPower);
+void UnpackNormalSpecularPower(uint32_t packed, float normal[3], float* specularPower);
@@ -0,0 +1,303 @@
+#include "GpuProfiler.h"
+#include <algorithm>
+#include <stdio.h>
+
+GpuProfiler::GpuProfiler()
+{
+    _maxScopes = 0;
+    _frame = 0;
+    _collected = 0;
+    _droppedFrames = 0;
+    _droppedScopes = 0;
+    _inFrame = false;
+
+    for (UINT i = 0; i < FRAME_LATENCY; ++i)
+    {
+        _frames[i].disjoint = nullptr;
+        _frames[i].pending = false;
+    }
+}
+
+GpuProfiler::~GpuProfiler()
+{
+    Release();
+}
+
+HRESULT GpuProfiler::Initialise(ID3D11Device* device, UINT maxScopesPerFrame)
+{
+    // a second Initialise replaces the query ring rather than leaking it
+    Release();
+
+    _maxScopes = maxScopesPerFrame;
+    _droppedScopes = 0;
+
+    D3D11_QUERY_DESC disjointDesc = { D3D11_QUERY_TIMESTAMP_DISJOINT, 0 };
+    D3D11_QUERY_DESC timestampDesc = { D3D11_QUERY_TIMESTAMP, 0 };
+
+    HRESULT hr = S_OK;
+    for (UINT i = 0; i < FRAME_LATENCY && SUCCEEDED(hr); ++i)
+    {
+        FrameSet& set = _frames[i];
+        hr = device->CreateQuery(&disjointDesc, &set.disjoint);
+
+        // a begin and an end per scope
+        set.timestamps.assign(maxScopesPerFrame * 2, nullptr);
+        for (UINT q = 0; q < set.timestamps.size() && SUCCEEDED(hr); ++q)
+            hr = device->CreateQuery(&timestampDesc, &set.timestamps[q]);
+
+        set.scopes.reserve(maxScopesPerFrame);
+        set.pending = false;
+    }
+
+    if (FAILED(hr))
+        Release();
+
+    return hr;
+}
+
+void GpuProfiler::Release()
+{
+    for (UINT i = 0; i < FRAME_LATENCY; ++i)
+    {
+        FrameSet& set = _frames[i];
+        if (set.disjoint) set.disjoint->Release();
+        for (ID3D11Query* query : set.timestamps)
+        {
+            if (query) query->Release();
+        }
+
+        set.disjoint = nullptr;
+        set.timestamps.clear();
+        set.scopes.clear();
+        set.pending = false;
+    }
+
+    // open scopes index into the sets just cleared
+    _open.clear();
+    _inFrame = false;
+    _maxScopes = 0;
+}
+
+UINT GpuProfiler::GetStat(const char* name)
+{
+    UINT parent = _open.empty() ? UINT_MAX : _frames[_frame % FRAME_LATENCY].scopes[_open.back()].stat;
+
+    // every scope after its first frame ends here, without touching the heap
+    for (const StatKey& key : _statKeys)
+    {
+        if (key.parent == parent && key.name == name)
+            return key.stat;
+    }
+
+    string path = parent == UINT_MAX ? name : _stats[parent].Path + "/" + name;
+    StatKey key = { parent, name, 0 };
+
+    // the same path through a different copy of the literal
+    auto found = _statsByPath.find(path);
+    if (found != _statsByPath.end())
+    {
+        key.stat = found->second;
+        _statKeys.push_back(key);
+        return key.stat;
+    }
+
+    GpuScopeStats stats;
+    stats.Path = path;
+    stats.Depth = (UINT)_open.size();
+    stats.Samples = 0;
+    stats.LastMs = 0.0;
+    stats.AverageMs = 0.0;
+    stats.MaxMs = 0.0;
+
+    UINT index = (UINT)_stats.size();
+    _stats.push_back(stats);
+    _history.push_back(vector<double>(HISTORY, 0.0));
+    _statsByPath[path] = index;
+
+    key.stat = index;
+    _statKeys.push_back(key);
+    return index;
+}
+
+void GpuProfiler::BeginFrame(ID3D11DeviceContext* context)
+{
+    if (_maxScopes == 0)
+        return;
+
+    FrameSet& set = _frames[_frame % FRAME_LATENCY];
+
+    // still not back after FRAME_LATENCY frames, don't wait for it
+    if (set.pending && !ReadFrame(context, set))
+        ++_droppedFrames;
+
+    set.pending = false;
+    set.scopes.clear();
+    _open.clear();
+    _inFrame = true;
+
+    context->Begin(set.disjoint);
+    BeginScope(context, "Frame");
+}
+
+void GpuProfiler::EndFrame(ID3D11DeviceContext* context)
+{
+    if (!_inFrame)
+        return;
+
+    // anything left open ends with the frame
+    while (!_open.empty())
+        EndScope(context);
+
+    FrameSet& set = _frames[_frame % FRAME_LATENCY];
+    context->End(set.disjoint);
+    set.pending = true;
+    _inFrame = false;
+    ++_frame;
+
+    // oldest first, and stop at the first that isn't ready so frames are collected in order
+    for (UINT i = 0; i < FRAME_LATENCY; ++i)
+    {
+        FrameSet& older = _frames[(_frame + i) % FRAME_LATENCY];
+        if (!older.pending)
+            continue;
+
+        if (!ReadFrame(context, older))
+            break;
+
+        older.pending = false;
+    }
+}
+
+void GpuProfiler::BeginScope(ID3D11DeviceContext* context, const char* name)
+{
+    if (!_inFrame)
+        return;
+
+    FrameSet& set = _frames[_frame % FRAME_LATENCY];
+
+    // over the limit, EndScope still pops it
+    if (set.scopes.size() >= _maxScopes)
+    {
+        if (_droppedScopes++ == 0)
+        {
+            char line[256];
+            sprintf_s(line, "GpuProfiler: more than %u scopes in a frame, \"%s\" and any after it aren't timed\n", _maxScopes, name);
+            OutputDebugStringA(line);
+        }
+
+        _open.push_back(UINT_MAX);
+        return;
+    }
+
+    ScopeRecord record;
+    record.stat = GetStat(name);
+    record.query = (UINT)set.scopes.size() * 2;
+
+    context->End(set.timestamps[record.query]);
+    _open.push_back((UINT)set.scopes.size());
+    set.scopes.push_back(record);
+}
+
+void GpuProfiler::EndScope(ID3D11DeviceContext* context)
+{
+    if (!_inFrame || _open.empty())
+        return;
+
+    UINT scope = _open.back();
+    _open.pop_back();
+
+    if (scope == UINT_MAX)
+        return;
+
+    FrameSet& set = _frames[_frame % FRAME_LATENCY];
+    context->End(set.timestamps[set.scopes[scope].query + 1]);
+}
+
+bool GpuProfiler::ReadFrame(ID3D11DeviceContext* context, FrameSet& set)
+{
+    D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+    if (context->GetData(set.disjoint, &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+        return false;
+
+    // every timestamp has to be in before any of them are used
+    vector<UINT64>& timestamps = _timestamps;
+    timestamps.resize(set.scopes.size() * 2);
+    for (UINT q = 0; q < timestamps.size(); ++q)
+    {
+        if (context->GetData(set.timestamps[q], &timestamps[q], sizeof(UINT64), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+            return false;
+    }
+
+    // the clock changed speed part way through, the results are meaningless
+    if (disjoint.Disjoint)
+    {
+        ++_droppedFrames;
+        return true;
+    }
+
+    for (UINT scope = 0; scope < set.scopes.size(); ++scope)
+    {
+        UINT64 begin = timestamps[scope * 2];
+        UINT64 end = timestamps[scope * 2 + 1];
+        double ms = end > begin ? (double)(end - begin) * 1000.0 / disjoint.Frequency : 0.0;
+
+        GpuScopeStats& stats = _stats[set.scopes[scope].stat];
+        vector<double>& history = _history[set.scopes[scope].stat];
+        history[stats.Samples % HISTORY] = ms;
+        stats.Samples++;
+        stats.LastMs = ms;
+
+        UINT count = min(stats.Samples, (UINT)HISTORY);
+        double sum = 0.0;
+        double largest = 0.0;
+        for (UINT i = 0; i < count; ++i)
+        {
+            sum += history[i];
+            largest = max(largest, history[i]);
+        }
+
+        stats.AverageMs = sum / count;
+        stats.MaxMs = largest;
+    }
+
+    ++_collected;
+    return true;
+}
+
+UINT GpuProfiler::FindScope(const string& path) const
+{
+    auto found = _statsByPath.find(path);
+    return found != _statsByPath.end() ? found->second : UINT_MAX;
+}
+
+double GpuProfiler::GetScopePercentile(UINT scope, double percentile) const
+{
+    UINT count = min(_stats[scope].Samples, (UINT)HISTORY);
+    if (count == 0)
+        return 0.0;
+
+    vector<double> sorted(_history[scope].begin(), _history[scope].begin() + count);
+    size_t rank = min((size_t)(percentile / 100.0 * count), (size_t)count - 1);
+    nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+HRESULT GpuProfiler::WriteReport(const wchar_t* fileName) const
+{
+    FILE* file = nullptr;
+    if (_wfopen_s(&file, fileName, L"wt") != 0 || !file)
+        return HRESULT_FROM_WIN32(ERROR_CANNOT_MAKE);
+
+    fprintf(file, "scope,depth,samples,average_ms,p50_ms,p95_ms,p99_ms,max_ms\n");
+    for (UINT scope = 0; scope < _stats.size(); ++scope)
+    {
+        const GpuScopeStats& stats = _stats[scope];
+        fprintf(file, "%s,%u,%u,%.4f,%.4f,%.4f,%.4f,%.4f\n", stats.Path.c_str(), stats.Depth, stats.Samples, stats.AverageMs,
+                GetScopePercentile(scope, 50.0), GetScopePercentile(scope, 95.0), GetScopePercentile(scope, 99.0), stats.MaxMs);
+    }
+
+    fprintf(file, "# %llu frames collected, %llu dropped, %llu scopes over the limit of %u a frame\n", _collected, _droppedFrames,
+            _droppedScopes, _maxScopes);
+    fclose(file);
+    return S_OK;
+}
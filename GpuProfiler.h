@@ -0,0 +1,125 @@
+#pragma once
+
+#include <windows.h>
+#include <d3d11_1.h>
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+
+struct GpuScopeStats
+{
+	// parent scopes joined with '/', "Frame/Scene/Ground"
+	string Path;
+	UINT Depth;
+	UINT Samples;
+	double LastMs;
+	// over the last GpuProfiler::HISTORY samples
+	double AverageMs;
+	double MaxMs;
+};
+
+// GPU timings from timestamp queries. each frame is bracketed by a disjoint query and
+// every scope by a pair of timestamps. a ring of query sets means results are collected
+// a few frames late without ever waiting on the GPU, a set that still isn't ready when
+// its turn comes round again is thrown away and counted as dropped
+class GpuProfiler
+{
+public:
+	static const UINT HISTORY = 256;
+
+	GpuProfiler();
+	~GpuProfiler();
+
+	HRESULT Initialise(ID3D11Device* device, UINT maxScopesPerFrame = 64);
+	void Release();
+
+	// opens the root "Frame" scope
+	void BeginFrame(ID3D11DeviceContext* context);
+	// closes the root scope and collects any finished frames
+	void EndFrame(ID3D11DeviceContext* context);
+
+	// scopes nest, names are kept by pointer so must outlive the profiler (literals).
+	// scopes past the per frame limit aren't timed, they are counted and the first frame
+	// to go over says so in the debug output
+	void BeginScope(ID3D11DeviceContext* context, const char* name);
+	void EndScope(ID3D11DeviceContext* context);
+
+	UINT GetScopeCount() const { return (UINT)_stats.size(); }
+	const GpuScopeStats& GetScope(UINT scope) const { return _stats[scope]; }
+	// UINT_MAX when the path hasn't been seen
+	UINT FindScope(const string& path) const;
+	double GetScopePercentile(UINT scope, double percentile) const;
+	UINT64 GetDroppedFrames() const { return _droppedFrames; }
+	// scopes past the per frame limit since Initialise
+	UINT64 GetDroppedScopes() const { return _droppedScopes; }
+
+	// one CSV row per scope: path, depth, samples, average, p50, p95, p99 and max in ms
+	HRESULT WriteReport(const wchar_t* fileName) const;
+
+private:
+	static const UINT FRAME_LATENCY = 4;
+
+	struct ScopeRecord
+	{
+		UINT stat;
+		UINT query;
+	};
+
+	// a scope name under a parent scope, names are literals so the pointer identifies them
+	struct StatKey
+	{
+		UINT parent;
+		const char* name;
+		UINT stat;
+	};
+
+	struct FrameSet
+	{
+		ID3D11Query* disjoint;
+		vector<ID3D11Query*> timestamps;
+		vector<ScopeRecord> scopes;
+		bool pending;
+	};
+
+	bool ReadFrame(ID3D11DeviceContext* context, FrameSet& set);
+	UINT GetStat(const char* name);
+
+	UINT _maxScopes;
+	FrameSet _frames[FRAME_LATENCY];
+	UINT64 _frame;
+	UINT64 _collected;
+	UINT64 _droppedFrames;
+	UINT64 _droppedScopes;
+	bool _inFrame;
+
+	// indices into the current frame's scopes of the open scopes, innermost last
+	vector<UINT> _open;
+
+	// ReadFrame's results, kept so collecting a frame doesn't allocate
+	vector<UINT64> _timestamps;
+
+	vector<GpuScopeStats> _stats;
+	vector<vector<double>> _history;
+	unordered_map<string, UINT> _statsByPath;
+	// looked through before _statsByPath so a scope seen before doesn't build its path
+	vector<StatKey> _statKeys;
+};
+
+// scope for the rest of a block
+class GpuScope
+{
+public:
+	GpuScope(GpuProfiler& profiler, ID3D11DeviceContext* context, const char* name)
+		: _profiler(profiler), _context(context)
+	{
+		_profiler.BeginScope(_context, name);
+	}
+
+	~GpuScope() { _profiler.EndScope(_context); }
+
+private:
+	GpuProfiler& _profiler;
+	ID3D11DeviceContext* _context;
+};
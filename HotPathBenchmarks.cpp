@@ -0,0 +1,357 @@
+#include "HotPathBenchmarks.h"
+#include "CpuProfiler.h"
+#include "FrameArena.h"
+#include "LightClusterBuilder.h"
+#include "LZ4.h"
+#include "RhiNull.h"
+#include "RhiRecording.h"
+#include "SceneAnimation.h"
+#include "ShaderCacheFormat.h"
+#include "SkylinePacker.h"
+#include "SubmissionScene.h"
+#include "TextureContainerFormat.h"
+#include <algorithm>
+
+// the same inputs every run, so a result compares with its baseline
+static uint32_t NextRandom(uint32_t& seed)
+{
+    seed = seed * 1664525u + 1013904223u;
+    return seed >> 8;
+}
+
+//--------------------------------------------------------------------------------------
+// LZ4, argument is the input size in KB
+//--------------------------------------------------------------------------------------
+
+// smooth texel rows with a little noise, about as compressible as the texture payloads
+// the packed containers hold
+static void BuildCompressible(uint32_t kilobytes, vector<uint8_t>& data)
+{
+    data.resize(kilobytes * 1024);
+    uint32_t seed = 1;
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = (uint8_t)((i / 4 % 256) / 16 * 16 + (NextRandom(seed) % 8 == 0 ? NextRandom(seed) % 4 : 0));
+}
+
+static void LZ4CompressBenchmark(MicroBenchmarkState& state)
+{
+    vector<uint8_t> data;
+    BuildCompressible(state.Argument, data);
+    vector<uint8_t> compressed(LZ4CompressBound(data.size()));
+    state.StartTiming();
+
+    for (uint64_t i = 0; i < state.Iterations; ++i)
+    {
+        size_t size = LZ4CompressBlock(data.data(), data.size(), compressed.data(), compressed.size());
+        MicroBenchmarkSink(&size);
+    }
+}
+
+static void LZ4DecompressBenchmark(MicroBenchmarkState& state)
+{
+    vector<uint8_t> data;
+    BuildCompressible(state.Argument, data);
+    vector<uint8_t> compressed(LZ4CompressBound(data.size()));
+    compressed.resize(LZ4CompressBlock(data.data(), data.size(), compressed.data(), compressed.size()));
+    state.StartTiming();
+
+    for (uint64_t i = 0; i < state.Iterations; ++i)
+    {
+        bool decompressed = LZ4DecompressBlock(compressed.data(), compressed.size(), data.data(), data.size());
+        MicroBenchmarkSink(&decompressed);
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// Texture containers, argument is the payload size in KB
+//--------------------------------------------------------------------------------------
+
+// one mip of the compressible texels in the 256KB tiles -packtextures writes
+static void BuildContainer(uint32_t kilobytes, vector<uint8_t>& container)
+{
+    vector<uint8_t> texels;
+    BuildCompressible(kilobytes, texels);
+    uint8_t header[148] = {};
+    vector<TextureContainerSurface> surfaces = { { texels.data(), (uint32_t)texels.size() } };
+    EncodeTextureContainer(header, sizeof(header), surfaces, 256 * 1024, container);
+}
+
+static void DecodeContainer(MicroBenchmarkState& state, JobSystem* jobs)
+{
+    vector<uint8_t> container;
+    BuildContainer(state.Argument, container);
+    unique_ptr<uint8_t[]> dds;
+    size_t ddsSize = 0;
+    state.StartTiming();
+
+    for (uint64_t i = 0; i < state.Iterations; ++i)
+    {
+        bool decoded = DecodeTextureContainer(container.data(), container.size(), jobs, dds, &ddsSize);
+        MicroBenchmarkSink(&decoded);
+    }
+
+    state.StopTiming();
+}
+
+static void TextureContainerDecodeBenchmark(MicroBenchmarkState& state)
+{
+    DecodeContainer(state, nullptr);
+}
+
+// the tiles spread over a pool, stopping its threads isn't part of the time
+static void TextureContainerDecodeJobsBenchmark(MicroBenchmarkState& state)
+{
+    JobSystem jobs;
+    jobs.Init();
+    DecodeContainer(state, &jobs);
+}
+
+//--------------------------------------------------------------------------------------
+// Atlas packing, argument is the rectangle count
+//--------------------------------------------------------------------------------------
+
+static void SkylinePackBenchmark(MicroBenchmarkState& state)
+{
+    // texture sized rectangles from 16 to 256 texels a side, onto a page they mostly fit
+    vector<uint32_t> sizes(state.Argument * 2);
+    uint32_t seed = 1;
+    for (uint32_t& size : sizes)
+        size = 16 + NextRandom(seed) % 241;
+
+    SkylinePacker packer;
+    state.StartTiming();
+
+    for (uint64_t i = 0; i < state.Iterations; ++i)
+    {
+        packer.Init(8192, 8192, 4, 2);
+        AtlasRect rect;
+        for (uint32_t j = 0; j < state.Argument; ++j)
+            packer.Insert(sizes[j * 2], sizes[j * 2 + 1], &rect);
+        MicroBenchmarkSink(&packer);
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// Shader cache key hashing, argument is the bytes hashed
+//--------------------------------------------------------------------------------------
+
+static void HashBytesBenchmark(MicroBenchmarkState& state)
+{
+    vector<uint8_t> data;
+    BuildCompressible((state.Argument + 1023) / 1024, data);
+    state.StartTiming();
+
+    for (uint64_t i = 0; i < state.Iterations; ++i)
+    {
+        uint64_t hash = HashBytes(data.data(), state.Argument);
+        MicroBenchmarkSink(&hash);
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// Frame arena, argument is the allocations a frame
+//--------------------------------------------------------------------------------------
+
+// a frame's worth of draw list sized blocks, then the reset that throws them away
+static void FrameArenaBenchmark(MicroBenchmarkState& state)
+{
+    FrameArena arena;
+    arena.Init(state.Argument * 128 + FrameArena::CHUNK_SIZE);
+    state.StartTiming();
+
+    for (uint64_t i = 0; i < state.Iterations; ++i)
+    {
+        arena.BeginFrame();
+        for (uint32_t j = 0; j < state.Argument; ++j)
+            MicroBenchmarkSink(arena.Allocate(16 + j % 8 * 12));
+    }
+
+    arena.Release();
+}
+
+//--------------------------------------------------------------------------------------
+// CPU profiler scopes, argument is how deep they nest
+//--------------------------------------------------------------------------------------
+
+// well inside the default per thread buffer, recording restarts before it fills so no
+// scope is ever dropped
+static const uint32_t PROFILE_CAPTURE_EVENTS = 1 << 16;
+
+// Argument nested scopes an iteration, opened and closed the way CpuProfileScope does
+static void RunProfileScopes(MicroBenchmarkState& state)
+{
+    bool recording = CpuProfiler::IsRecording();
+    uint64_t iterationsPerCapture = max(PROFILE_CAPTURE_EVENTS / (state.Argument * 2), 1u);
+
+    for (uint64_t i = 0; i < state.Iterations; ++i)
+    {
+        if (recording && i && i % iterationsPerCapture == 0)
+            CpuProfiler::Start();
+
+        uint32_t recorded = 0;
+        for (uint32_t depth = 0; depth < state.Argument; ++depth)
+            recorded += CpuProfiler::Begin("Benchmark") ? 1 : 0;
+        MicroBenchmarkSink(&recorded);
+        for (uint32_t depth = 0; depth < recorded; ++depth)
+            CpuProfiler::End();
+    }
+}
+
+static void CpuProfileScopeBenchmark(MicroBenchmarkState& state)
+{
+    CpuProfiler::Start();
+    state.StartTiming();
+
+    RunProfileScopes(state);
+
+    // Stop waits out the tick rate calibration, which isn't the scopes' cost
+    state.StopTiming();
+    CpuProfiler::Stop();
+}
+
+// what the scopes cost a build that has them compiled in but isn't capturing
+static void CpuProfileScopeIdleBenchmark(MicroBenchmarkState& state)
+{
+    RunProfileScopes(state);
+}
+
+//--------------------------------------------------------------------------------------
+// Light clustering, argument is the light count
+//--------------------------------------------------------------------------------------
+
+// the app's camera at (0, 0, 25) looking at the origin with a 90 degree fov at 640x480,
+// and lights spread through the scene the way it places them
+static void BuildLightScene(uint32_t lightCount, vector<float>& lights, float view[16], float projection[16])
+{
+    const float viewRows[16] = { -1, 0, 0, 0, 0, 1, 0, 0, 0, 0, -1, 0, 0, 0, 25, 1 };
+    const float projectionRows[16] = { 0.75f, 0, 0, 0, 0, 1, 0, 0, 0, 0, 100.0f / 99.99f, 1, 0, 0, -1.0f / 99.99f, 0 };
+    copy(viewRows, viewRows + 16, view);
+    copy(projectionRows, projectionRows + 16, projection);
+
+    uint32_t seed = 12345;
+    lights.resize(lightCount * 4);
+    for (uint32_t i = 0; i < lightCount; ++i)
+    {
+        lights[i * 4] = NextRandom(seed) / 16777216.0f * 60.0f - 30.0f;
+        lights[i * 4 + 1] = NextRandom(seed) / 16777216.0f * 30.0f - 15.0f;
+        lights[i * 4 + 2] = NextRandom(seed) / 16777216.0f * 60.0f - 30.0f;
+        lights[i * 4 + 3] = 0.5f + NextRandom(seed) / 16777216.0f * 3.0f;
+    }
+}
+
+static void BuildLightClusters(MicroBenchmarkState& state, JobSystem* jobs)
+{
+    vector<float> lights;
+    float view[16], projection[16];
+    BuildLightScene(state.Argument, lights, view, projection);
+
+    // one untimed build sizes the lists
+    LightClusterBuilder builder;
+    builder.Init(640, 480, 0.01f, 100.0f);
+    builder.Build(lights.data(), state.Argument, 4, view, projection, jobs);
+    state.StartTiming();
+
+    for (uint64_t i = 0; i < state.Iterations; ++i)
+    {
+        builder.Build(lights.data(), state.Argument, 4, view, projection, jobs);
+        MicroBenchmarkSink(builder.GetLightIndices().data());
+    }
+
+    state.StopTiming();
+}
+
+static void LightClustersBenchmark(MicroBenchmarkState& state)
+{
+    BuildLightClusters(state, nullptr);
+}
+
+// the cull batches and slices spread over a pool, as the app builds them
+static void LightClustersJobsBenchmark(MicroBenchmarkState& state)
+{
+    JobSystem jobs;
+    jobs.Init();
+    BuildLightClusters(state, &jobs);
+}
+
+//--------------------------------------------------------------------------------------
+// Scene animation, argument is the body count
+//--------------------------------------------------------------------------------------
+
+static void AnimateBodiesBenchmark(MicroBenchmarkState& state)
+{
+    vector<float> worldMatrices(state.Argument * 16);
+    state.StartTiming();
+
+    for (uint64_t i = 0; i < state.Iterations; ++i)
+    {
+        AnimateBodies(i * 0.001f, worldMatrices.data(), state.Argument);
+        MicroBenchmarkSink(worldMatrices.data());
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// Scene submission through the RHI without a GPU, argument is the body count
+//--------------------------------------------------------------------------------------
+
+static void SubmitNullBenchmark(MicroBenchmarkState& state)
+{
+    NullRhiDevice device;
+    SubmissionScene scene;
+    CreateSubmissionScene(device, scene);
+
+    vector<float> worldMatrices(state.Argument * 16);
+    AnimateBodies(0.0f, worldMatrices.data(), state.Argument);
+    state.StartTiming();
+
+    for (uint64_t i = 0; i < state.Iterations; ++i)
+    {
+        SubmitBodies(*device.GetImmediateCommandList(), scene, worldMatrices.data(), state.Argument);
+        device.ResetCommandStats();
+        MicroBenchmarkSink(&device.GetStats());
+    }
+
+    DeleteSubmissionScene(scene);
+}
+
+// recording a frame and replaying it, the cost a deferred list adds over the direct one
+static void RecordNullBenchmark(MicroBenchmarkState& state)
+{
+    NullRhiDevice device;
+    SubmissionScene scene;
+    CreateSubmissionScene(device, scene);
+
+    vector<float> worldMatrices(state.Argument * 16);
+    AnimateBodies(0.0f, worldMatrices.data(), state.Argument);
+
+    RecordingRhiCommandList recording;
+    state.StartTiming();
+
+    for (uint64_t i = 0; i < state.Iterations; ++i)
+    {
+        recording.Reset();
+        SubmitBodies(recording, scene, worldMatrices.data(), state.Argument);
+        recording.Execute(*device.GetImmediateCommandList());
+        device.ResetCommandStats();
+        MicroBenchmarkSink(&device.GetStats());
+    }
+
+    DeleteSubmissionScene(scene);
+}
+
+void AddHotPathBenchmarks(MicroBenchmarkSuite& suite)
+{
+    suite.Add("lz4_compress", LZ4CompressBenchmark, { 4, 64, 1024 });
+    suite.Add("lz4_decompress", LZ4DecompressBenchmark, { 4, 64, 1024 });
+    suite.Add("texture_container_decode", TextureContainerDecodeBenchmark, { 256, 4096 });
+    suite.Add("texture_container_decode_jobs", TextureContainerDecodeJobsBenchmark, { 256, 4096 });
+    suite.Add("skyline_pack", SkylinePackBenchmark, { 16, 256, 1024 });
+    suite.Add("hash_bytes", HashBytesBenchmark, { 64, 1024, 65536 });
+    suite.Add("frame_arena", FrameArenaBenchmark, { 64, 1024, 16384 });
+    suite.Add("cpu_profile_scope", CpuProfileScopeBenchmark, { 1, 8 });
+    suite.Add("cpu_profile_scope_idle", CpuProfileScopeIdleBenchmark, { 1, 8 });
+    suite.Add("light_clusters", LightClustersBenchmark, { 1000, 10000 });
+    suite.Add("light_clusters_jobs", LightClustersJobsBenchmark, { 1000, 10000 });
+    suite.Add("animate_bodies", AnimateBodiesBenchmark, { 5, 64, 1024, 16384 });
+    suite.Add("rhi_submit_null", SubmitNullBenchmark, { 5, 64, 1024, 16384 });
+    suite.Add("rhi_record_null", RecordNullBenchmark, { 5, 64, 1024, 16384 });
+}
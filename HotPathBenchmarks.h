@@ -0,0 +1,13 @@
+#pragma once
+
+#include "MicroBenchmark.h"
+
+// the CPU paths that build on any platform: LZ4 payloads, texture container decoding on
+// one thread and over a job pool, atlas packing, shader cache key hashing, frame arena
+// allocation, CPU profiler scopes recording and idle, light clustering on one thread and
+// over a job pool, body animation, and scene submission through the null RHI
+void AddHotPathBenchmarks(MicroBenchmarkSuite& suite);
+
+// the ones that need DirectXMath or the d3d types, in HotPathBenchmarksD3D.cpp: ground
+// plane grid generation, and DDS parsing through to the subresource layout
+void AddD3DHotPathBenchmarks(MicroBenchmarkSuite& suite);
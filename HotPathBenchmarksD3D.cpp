@@ -0,0 +1,118 @@
+#include "HotPathBenchmarks.h"
+#include "MeshGeneration.h"
+#include "DDSTextureLoader.h"
+
+//--------------------------------------------------------------------------------------
+// Mesh generation, argument is the vertex count along each side
+//--------------------------------------------------------------------------------------
+
+static void PlaneVerticesBenchmark(MicroBenchmarkState& state)
+{
+    MeshVector<SimpleVertexNormal> vertices;
+    state.StartTiming();
+
+    for (uint64_t i = 0; i < state.Iterations; ++i)
+    {
+        GeneratePlaneVertices(10.0f, 10.0f, state.Argument, state.Argument, vertices);
+        MicroBenchmarkSink(vertices.data());
+    }
+}
+
+static void PlaneIndicesBenchmark(MicroBenchmarkState& state)
+{
+    MeshVector<WORD> indices;
+    state.StartTiming();
+
+    for (uint64_t i = 0; i < state.Iterations; ++i)
+    {
+        GeneratePlaneIndices(state.Argument, state.Argument, indices);
+        MicroBenchmarkSink(indices.data());
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// DDS parsing, argument is the width and height of a full mip chain
+//--------------------------------------------------------------------------------------
+
+// magic, DDS_HEADER and DDS_HEADER_DXT10 as 32 bit words
+static const UINT DDS_HEADER_WORDS = 1 + 31 + 5;
+
+static void BuildDDS(UINT size, DXGI_FORMAT format, vector<uint8_t>& dds)
+{
+    UINT mipCount = 1;
+    while ((size >> mipCount) > 0)
+        ++mipCount;
+
+    size_t dataSize = 0;
+    for (UINT mip = 0; mip < mipCount; ++mip)
+        dataSize += GetSurfaceByteSize(max(size >> mip, 1u), max(size >> mip, 1u), format);
+
+    dds.assign(DDS_HEADER_WORDS * sizeof(uint32_t) + dataSize, 0);
+
+    uint32_t* words = reinterpret_cast<uint32_t*>(dds.data());
+    words[0] = 0x20534444; // "DDS "
+    words[1] = 124;        // header size
+    words[2] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000; // caps, height, width, pixel format, mip count
+    words[3] = size;
+    words[4] = size;
+    words[7] = mipCount;
+    words[19] = 32;        // pixel format size
+    words[20] = 0x4;       // four cc
+    words[21] = MAKEFOURCC('D', 'X', '1', '0');
+    words[27] = 0x1000 | 0x400000 | 0x8; // texture, mipmap, complex
+    words[32] = format;
+    words[33] = D3D11_RESOURCE_DIMENSION_TEXTURE2D;
+    words[35] = 1;         // array size
+}
+
+static void ParseDDS(MicroBenchmarkState& state, DXGI_FORMAT format)
+{
+    vector<uint8_t> dds;
+    BuildDDS(state.Argument, format, dds);
+
+    D3D11_TEXTURE2D_DESC desc;
+    vector<D3D11_SUBRESOURCE_DATA> initData;
+    state.StartTiming();
+
+    for (uint64_t i = 0; i < state.Iterations; ++i)
+    {
+        LoadDDSTextureDataFromMemory(dds.data(), dds.size(), &desc, initData);
+        MicroBenchmarkSink(initData.data());
+    }
+}
+
+static void ParseDDSRGBABenchmark(MicroBenchmarkState& state)
+{
+    ParseDDS(state, DXGI_FORMAT_R8G8B8A8_UNORM);
+}
+
+static void ParseDDSBC1Benchmark(MicroBenchmarkState& state)
+{
+    ParseDDS(state, DXGI_FORMAT_BC1_UNORM);
+}
+
+// every mip of a full chain in a block compressed, a packed and a plain format
+static void SurfaceSizeBenchmark(MicroBenchmarkState& state)
+{
+    static const DXGI_FORMAT formats[] = { DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_R8G8_B8G8_UNORM, DXGI_FORMAT_R16G16B16A16_FLOAT };
+
+    for (uint64_t i = 0; i < state.Iterations; ++i)
+    {
+        size_t bytes = 0;
+        for (DXGI_FORMAT format : formats)
+        {
+            for (UINT size = state.Argument; size > 0; size >>= 1)
+                bytes += GetSurfaceByteSize(size, size, format);
+        }
+        MicroBenchmarkSink(&bytes);
+    }
+}
+
+void AddD3DHotPathBenchmarks(MicroBenchmarkSuite& suite)
+{
+    suite.Add("plane_vertices", PlaneVerticesBenchmark, { 11, 64, 128, 256 });
+    suite.Add("plane_indices", PlaneIndicesBenchmark, { 11, 64, 128, 256 });
+    suite.Add("dds_parse_rgba8", ParseDDSRGBABenchmark, { 64, 256, 1024, 4096 });
+    suite.Add("dds_parse_bc1", ParseDDSBC1Benchmark, { 64, 256, 1024, 4096 });
+    suite.Add("surface_size", SurfaceSizeBenchmark, { 64, 1024, 16384 });
+}
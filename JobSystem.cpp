@@ -0,0 +1,130 @@
+#include "JobSystem.h"
+#include "CpuProfiler.h"
+
+JobSystem::JobSystem()
+{
+    _quit = false;
+    _job = nullptr;
+    _count = 0;
+    _batch = 0;
+    _active = 0;
+    _next = 0;
+    _finished = 0;
+}
+
+JobSystem::~JobSystem()
+{
+    Shutdown();
+}
+
+void JobSystem::Init(uint32_t threadCount)
+{
+    Shutdown();
+
+    if (threadCount == 0)
+    {
+        uint32_t cores = thread::hardware_concurrency();
+        threadCount = cores > 1 ? cores - 1 : 0;
+    }
+
+    _quit = false;
+    for (uint32_t i = 0; i < threadCount; ++i)
+        _workers.push_back(thread(&JobSystem::WorkerMain, this));
+}
+
+void JobSystem::Shutdown()
+{
+    {
+        lock_guard<mutex> lock(_mutex);
+        _quit = true;
+    }
+    _wake.notify_all();
+
+    for (thread& worker : _workers)
+        worker.join();
+
+    _workers.clear();
+}
+
+void JobSystem::RunJobs(const function<void(uint32_t)>& job, uint32_t count)
+{
+    CPU_PROFILE_SCOPE("Jobs");
+
+    for (;;)
+    {
+        uint32_t index = _next++;
+        if (index >= count)
+            break;
+
+        job(index);
+        ++_finished;
+    }
+}
+
+void JobSystem::WorkerMain()
+{
+    CPU_PROFILE_THREAD("Worker");
+
+    uint64_t seenBatch = 0;
+
+    for (;;)
+    {
+        const function<void(uint32_t)>* job = nullptr;
+        uint32_t count = 0;
+        {
+            unique_lock<mutex> lock(_mutex);
+            _wake.wait(lock, [&] { return _quit || (_job && _batch != seenBatch); });
+
+            if (_quit)
+                return;
+
+            seenBatch = _batch;
+            job = _job;
+            count = _count;
+            ++_active;
+        }
+
+        RunJobs(*job, count);
+
+        {
+            lock_guard<mutex> lock(_mutex);
+            --_active;
+        }
+        _done.notify_all();
+    }
+}
+
+void JobSystem::ParallelFor(uint32_t count, const function<void(uint32_t)>& job)
+{
+    if (count == 0)
+        return;
+
+    if (_workers.empty() || count == 1)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+            job(i);
+
+        return;
+    }
+
+    // one batch in flight at a time
+    lock_guard<mutex> batchLock(_batchMutex);
+
+    {
+        lock_guard<mutex> lock(_mutex);
+        _job = &job;
+        _count = count;
+        _next = 0;
+        _finished = 0;
+        ++_batch;
+    }
+    _wake.notify_all();
+
+    RunJobs(job, count);
+
+    // wait for the stragglers, and for every worker to leave the batch so none of them
+    // can pick an index out of the next one
+    unique_lock<mutex> lock(_mutex);
+    _done.wait(lock, [&] { return _finished == count && _active == 0; });
+    _job = nullptr;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+using namespace std;
+
+// small pool of worker threads for splitting a loop across cores. the calling thread
+// joins in on every ParallelFor, so a pool with no workers still runs everything. only
+// the standard library's threads, so the software rasteriser builds on any platform
+class JobSystem
+{
+public:
+	JobSystem();
+	~JobSystem();
+
+	// threadCount workers on top of the calling thread, 0 picks one per spare core
+	void Init(uint32_t threadCount = 0);
+	void Shutdown();
+
+	// runs job(i) for every i in [0, count) and returns once they have all finished.
+	// jobs must not call ParallelFor themselves
+	void ParallelFor(uint32_t count, const function<void(uint32_t)>& job);
+
+	// workers plus the calling thread
+	uint32_t GetThreadCount() const { return (uint32_t)_workers.size() + 1; }
+
+private:
+	void WorkerMain();
+	void RunJobs(const function<void(uint32_t)>& job, uint32_t count);
+
+	vector<thread> _workers;
+	mutex _batchMutex;
+	mutex _mutex;
+	condition_variable _wake;
+	condition_variable _done;
+	bool _quit;
+
+	// current batch
+	const function<void(uint32_t)>* _job;
+	uint32_t _count;
+	uint64_t _batch;
+	// workers still inside the current batch
+	uint32_t _active;
+	atomic<uint32_t> _next;
+	atomic<uint32_t> _finished;
+};
@@ -0,0 +1,239 @@
+#include "LZ4.h"
+#include <string.h>
+#include <vector>
+
+using namespace std;
+
+static const size_t MIN_MATCH = 4;
+// the last match has to start this far from the end of the block
+static const size_t MATCH_FIND_LIMIT = 12;
+// and the block always ends with at least this many literals
+static const size_t LAST_LITERALS = 5;
+static const size_t MAX_OFFSET = 65535;
+static const int HASH_BITS = 16;
+
+static uint32_t Read32(const uint8_t* p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t Hash(uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// writes the 255 run continuation bytes of a length that did not fit in its token nibble
+static bool WriteLength(size_t length, uint8_t*& op, const uint8_t* opEnd)
+{
+    while (length >= 255)
+    {
+        if (op >= opEnd)
+            return false;
+
+        *op++ = 255;
+        length -= 255;
+    }
+
+    if (op >= opEnd)
+        return false;
+
+    *op++ = (uint8_t)length;
+    return true;
+}
+
+static bool WriteSequence(const uint8_t* literals, size_t literalLength, size_t offset, size_t matchLength,
+                          uint8_t*& op, const uint8_t* opEnd)
+{
+    if (op >= opEnd)
+        return false;
+
+    uint8_t* token = op++;
+    *token = (uint8_t)((literalLength >= 15 ? 15 : literalLength) << 4);
+
+    if (literalLength >= 15 && !WriteLength(literalLength - 15, op, opEnd))
+        return false;
+
+    if ((size_t)(opEnd - op) < literalLength)
+        return false;
+
+    memcpy(op, literals, literalLength);
+    op += literalLength;
+
+    // last sequence is literals only
+    if (matchLength == 0)
+        return true;
+
+    if (opEnd - op < 2)
+        return false;
+
+    *op++ = (uint8_t)(offset & 0xFF);
+    *op++ = (uint8_t)(offset >> 8);
+
+    size_t length = matchLength - MIN_MATCH;
+    *token |= (uint8_t)(length >= 15 ? 15 : length);
+
+    if (length >= 15 && !WriteLength(length - 15, op, opEnd))
+        return false;
+
+    return true;
+}
+
+size_t LZ4CompressBound(size_t srcSize)
+{
+    return srcSize + srcSize / 255 + 16;
+}
+
+size_t LZ4CompressBlock(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity)
+{
+    // A lone empty token, as the reference encoder writes, without handing memcpy the
+    // null an empty input may well be
+    if (srcSize == 0)
+    {
+        if (dstCapacity == 0)
+            return 0;
+
+        *dst = 0;
+        return 1;
+    }
+
+    uint8_t* op = dst;
+    const uint8_t* opEnd = dst + dstCapacity;
+
+    size_t anchor = 0;
+    size_t ip = 0;
+
+    if (srcSize > MATCH_FIND_LIMIT)
+    {
+        // last position each hashed 4 byte sequence was seen at, plus one so 0 means empty
+        vector<uint32_t> table((size_t)1 << HASH_BITS, 0);
+        size_t matchLimit = srcSize - MATCH_FIND_LIMIT;
+        size_t matchEnd = srcSize - LAST_LITERALS;
+
+        while (ip < matchLimit)
+        {
+            uint32_t sequence = Read32(src + ip);
+            uint32_t& slot = table[Hash(sequence)];
+            size_t candidate = slot;
+            slot = (uint32_t)(ip + 1);
+
+            if (candidate == 0 || ip - (candidate - 1) > MAX_OFFSET || Read32(src + candidate - 1) != sequence)
+            {
+                ++ip;
+                continue;
+            }
+
+            size_t match = candidate - 1;
+            size_t length = MIN_MATCH;
+            while (ip + length < matchEnd && src[match + length] == src[ip + length])
+                ++length;
+
+            // grow the match backwards into the pending literals
+            while (ip > anchor && match > 0 && src[ip - 1] == src[match - 1])
+            {
+                --ip;
+                --match;
+                ++length;
+            }
+
+            if (!WriteSequence(src + anchor, ip - anchor, ip - match, length, op, opEnd))
+                return 0;
+
+            ip += length;
+            anchor = ip;
+
+            // seed the table inside the match so the next search has something close by
+            if (ip - 2 < matchLimit)
+                table[Hash(Read32(src + ip - 2))] = (uint32_t)(ip - 2 + 1);
+        }
+    }
+
+    if (!WriteSequence(src + anchor, srcSize - anchor, 0, 0, op, opEnd))
+        return 0;
+
+    return op - dst;
+}
+
+bool LZ4DecompressBlock(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+{
+    // Only the empty token decodes to nothing, and dst may be null for it
+    if (dstSize == 0)
+        return srcSize == 1 && src[0] == 0;
+
+    const uint8_t* ip = src;
+    const uint8_t* ipEnd = src + srcSize;
+    uint8_t* op = dst;
+    uint8_t* opEnd = dst + dstSize;
+
+    while (ip < ipEnd)
+    {
+        uint8_t token = *ip++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15)
+        {
+            uint8_t more;
+            do
+            {
+                if (ip >= ipEnd)
+                    return false;
+
+                more = *ip++;
+                literalLength += more;
+            } while (more == 255);
+        }
+
+        if ((size_t)(ipEnd - ip) < literalLength || (size_t)(opEnd - op) < literalLength)
+            return false;
+
+        memcpy(op, ip, literalLength);
+        ip += literalLength;
+        op += literalLength;
+
+        if (ip == ipEnd)
+            break;
+
+        if (ipEnd - ip < 2)
+            return false;
+
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+
+        if (offset == 0 || offset > (size_t)(op - dst))
+            return false;
+
+        size_t matchLength = token & 15;
+        if (matchLength == 15)
+        {
+            uint8_t more;
+            do
+            {
+                if (ip >= ipEnd)
+                    return false;
+
+                more = *ip++;
+                matchLength += more;
+            } while (more == 255);
+        }
+        matchLength += MIN_MATCH;
+
+        if ((size_t)(opEnd - op) < matchLength)
+            return false;
+
+        const uint8_t* match = op - offset;
+        if (offset >= matchLength)
+        {
+            memcpy(op, match, matchLength);
+            op += matchLength;
+        }
+        else
+        {
+            // overlapping copy repeats the last offset bytes
+            for (size_t i = 0; i < matchLength; ++i)
+                *op++ = *match++;
+        }
+    }
+
+    return op == opEnd;
+}
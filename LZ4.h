@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// minimal LZ4 block format codec (no frame format, no dictionary), compatible with
+// the reference implementation's LZ4_compress_default / LZ4_decompress_safe output:
+// https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+
+// worst case compressed size for an input of the given size
+size_t LZ4CompressBound(size_t srcSize);
+
+// greedy single pass compressor, returns the compressed size or 0 if dst is too small. an
+// empty input is the single byte block the reference encoder writes for it
+size_t LZ4CompressBlock(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity);
+
+// bounds checked decompressor, dstSize must be the exact decompressed size
+bool LZ4DecompressBlock(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
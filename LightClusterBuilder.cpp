@@ -0,0 +1,252 @@
+#include "LightClusterBuilder.h"
+#include "CpuProfiler.h"
+#include <xmmintrin.h>
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+// lights culled per job
+static const uint32_t CULL_BATCH = 256;
+
+//--------------------------------------------------------------------------------------
+// LightClusterBuilder
+//--------------------------------------------------------------------------------------
+LightClusterBuilder::LightClusterBuilder()
+{
+    memset(&_params, 0, sizeof(_params));
+    _nearZ = 0.01f;
+    _farZ = 100.0f;
+    _maxIndices = 0;
+    _lightCount = 0;
+}
+
+void LightClusterBuilder::Init(uint32_t screenWidth, uint32_t screenHeight, float nearZ, float farZ,
+                               uint32_t tilesX, uint32_t tilesY, uint32_t slices, uint32_t maxIndices)
+{
+    _nearZ = nearZ;
+    _farZ = farZ;
+    _maxIndices = maxIndices;
+
+    // the bounds are kept in 16 bits
+    _params.CountX = min(max(tilesX, 1u), 0xFFFFu);
+    _params.CountY = min(max(tilesY, 1u), 0xFFFFu);
+    _params.CountZ = min(max(slices, 1u), 0xFFFFu);
+    _params.TileSize[0] = (float)screenWidth / _params.CountX;
+    _params.TileSize[1] = (float)screenHeight / _params.CountY;
+
+    float logRange = logf(farZ / nearZ);
+    _params.SliceScale = _params.CountZ / logRange;
+    _params.SliceBias = -(_params.CountZ * logf(nearZ)) / logRange;
+
+    _sliceCounts.assign(_params.CountZ, FrameTaggedVector<uint32_t>(_params.CountX * _params.CountY));
+    _sliceIndices.assign(_params.CountZ, FrameTaggedVector<uint32_t>());
+    _clusters.assign(GetClusterCount() * 2, 0);
+}
+
+void LightClusterBuilder::CullLights(uint32_t first, uint32_t count, const float* view, const float* projection)
+{
+    // row vector convention, view space position = x * row0 + y * row1 + z * row2 + row3
+    __m128 m00 = _mm_set1_ps(view[0]), m01 = _mm_set1_ps(view[1]), m02 = _mm_set1_ps(view[2]);
+    __m128 m10 = _mm_set1_ps(view[4]), m11 = _mm_set1_ps(view[5]), m12 = _mm_set1_ps(view[6]);
+    __m128 m20 = _mm_set1_ps(view[8]), m21 = _mm_set1_ps(view[9]), m22 = _mm_set1_ps(view[10]);
+    __m128 m30 = _mm_set1_ps(view[12]), m31 = _mm_set1_ps(view[13]), m32 = _mm_set1_ps(view[14]);
+    __m128 projX = _mm_set1_ps(projection[0]);
+    __m128 projY = _mm_set1_ps(projection[5]);
+    __m128 nearZ = _mm_set1_ps(_nearZ);
+
+    float tilesX = (float)_params.CountX;
+    float tilesY = (float)_params.CountY;
+    float slicesZ = (float)_params.CountZ;
+
+    for (uint32_t i = first; i < first + count; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(&_lightX[i]);
+        __m128 y = _mm_loadu_ps(&_lightY[i]);
+        __m128 z = _mm_loadu_ps(&_lightZ[i]);
+        __m128 r = _mm_loadu_ps(&_lightRadius[i]);
+
+        __m128 vx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m00), _mm_mul_ps(y, m10)), _mm_add_ps(_mm_mul_ps(z, m20), m30));
+        __m128 vy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m01), _mm_mul_ps(y, m11)), _mm_add_ps(_mm_mul_ps(z, m21), m31));
+        __m128 vz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m02), _mm_mul_ps(y, m12)), _mm_add_ps(_mm_mul_ps(z, m22), m32));
+
+        // the sphere's view space box, clipped to the near plane. x/z over the box is
+        // largest at its nearest or farthest depth, so projecting the box edges at both
+        // gives conservative screen bounds
+        __m128 boxNear = _mm_max_ps(_mm_sub_ps(vz, r), nearZ);
+        __m128 boxFar = _mm_max_ps(_mm_add_ps(vz, r), nearZ);
+        __m128 invNear = _mm_div_ps(_mm_set1_ps(1.0f), boxNear);
+        __m128 invFar = _mm_div_ps(_mm_set1_ps(1.0f), boxFar);
+
+        __m128 left = _mm_sub_ps(vx, r);
+        __m128 right = _mm_add_ps(vx, r);
+        __m128 bottom = _mm_sub_ps(vy, r);
+        __m128 top = _mm_add_ps(vy, r);
+
+        __m128 minX = _mm_mul_ps(_mm_min_ps(_mm_mul_ps(left, invNear), _mm_mul_ps(left, invFar)), projX);
+        __m128 maxX = _mm_mul_ps(_mm_max_ps(_mm_mul_ps(right, invNear), _mm_mul_ps(right, invFar)), projX);
+        __m128 minY = _mm_mul_ps(_mm_min_ps(_mm_mul_ps(bottom, invNear), _mm_mul_ps(bottom, invFar)), projY);
+        __m128 maxY = _mm_mul_ps(_mm_max_ps(_mm_mul_ps(top, invNear), _mm_mul_ps(top, invFar)), projY);
+
+        // ndc to tile coordinates, y flips as tiles count down the screen
+        __m128 half = _mm_set1_ps(0.5f);
+        __m128 tileMinX = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(minX, half), half), _mm_set1_ps(tilesX));
+        __m128 tileMaxX = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(maxX, half), half), _mm_set1_ps(tilesX));
+        __m128 tileMinY = _mm_mul_ps(_mm_sub_ps(half, _mm_mul_ps(maxY, half)), _mm_set1_ps(tilesY));
+        __m128 tileMaxY = _mm_mul_ps(_mm_sub_ps(half, _mm_mul_ps(minY, half)), _mm_set1_ps(tilesY));
+
+        __m128 depthNear = _mm_sub_ps(vz, r);
+        __m128 depthFar = _mm_add_ps(vz, r);
+
+        alignas(16) float lanes[6][4];
+        _mm_store_ps(lanes[0], tileMinX);
+        _mm_store_ps(lanes[1], tileMaxX);
+        _mm_store_ps(lanes[2], tileMinY);
+        _mm_store_ps(lanes[3], tileMaxY);
+        _mm_store_ps(lanes[4], depthNear);
+        _mm_store_ps(lanes[5], depthFar);
+
+        for (uint32_t lane = 0; lane < 4 && i + lane < _lightCount; ++lane)
+        {
+            LightBounds& bounds = _bounds[i + lane];
+
+            float nearDepth = max(lanes[4][lane], _nearZ);
+            float farDepth = min(lanes[5][lane], _farZ);
+
+            if (farDepth <= nearDepth || lanes[1][lane] < 0.0f || lanes[0][lane] >= tilesX ||
+                lanes[3][lane] < 0.0f || lanes[2][lane] >= tilesY)
+            {
+                bounds.minZ = 1;
+                bounds.maxZ = 0;
+                continue;
+            }
+
+            bounds.minX = (uint16_t)max(lanes[0][lane], 0.0f);
+            bounds.maxX = (uint16_t)min(lanes[1][lane], tilesX - 1);
+            bounds.minY = (uint16_t)max(lanes[2][lane], 0.0f);
+            bounds.maxY = (uint16_t)min(lanes[3][lane], tilesY - 1);
+            bounds.minZ = (uint16_t)min(max(logf(nearDepth) * _params.SliceScale + _params.SliceBias, 0.0f), slicesZ - 1);
+            bounds.maxZ = (uint16_t)min(max(logf(farDepth) * _params.SliceScale + _params.SliceBias, 0.0f), slicesZ - 1);
+        }
+    }
+}
+
+void LightClusterBuilder::BinSlice(uint32_t slice)
+{
+    FrameTaggedVector<uint32_t>& counts = _sliceCounts[slice];
+    FrameTaggedVector<uint32_t>& indices = _sliceIndices[slice];
+    uint32_t tilesX = _params.CountX;
+
+    fill(counts.begin(), counts.end(), 0);
+
+    for (uint32_t light = 0; light < _lightCount; ++light)
+    {
+        const LightBounds& bounds = _bounds[light];
+        if (slice < bounds.minZ || slice > bounds.maxZ)
+            continue;
+
+        for (uint32_t y = bounds.minY; y <= bounds.maxY; ++y)
+            for (uint32_t x = bounds.minX; x <= bounds.maxX; ++x)
+                counts[y * tilesX + x]++;
+    }
+
+    // counts become each tile's end offset, then walk back down while filling
+    uint32_t total = 0;
+    for (uint32_t& count : counts)
+    {
+        total += count;
+        count = total;
+    }
+
+    indices.resize(total);
+
+    for (uint32_t light = _lightCount; light-- > 0;)
+    {
+        const LightBounds& bounds = _bounds[light];
+        if (slice < bounds.minZ || slice > bounds.maxZ)
+            continue;
+
+        for (uint32_t y = bounds.minY; y <= bounds.maxY; ++y)
+            for (uint32_t x = bounds.minX; x <= bounds.maxX; ++x)
+                indices[--counts[y * tilesX + x]] = light;
+    }
+}
+
+void LightClusterBuilder::Build(const float* lights, uint32_t lightCount, uint32_t floatsPerLight, const float* view,
+                                const float* projection, JobSystem* jobs)
+{
+    CPU_PROFILE_FUNCTION();
+
+    _lightCount = lightCount;
+    _params.LightCount = _lightCount;
+
+    uint32_t padded = (_lightCount + 3) & ~3u;
+    _lightX.resize(padded);
+    _lightY.resize(padded);
+    _lightZ.resize(padded);
+    // padding lanes get radius 0 at the origin and are never read back
+    _lightRadius.assign(padded, 0.0f);
+    _bounds.resize(_lightCount);
+
+    for (uint32_t i = 0; i < _lightCount; ++i)
+    {
+        const float* light = lights + (size_t)i * floatsPerLight;
+        _lightX[i] = light[0];
+        _lightY[i] = light[1];
+        _lightZ[i] = light[2];
+        _lightRadius[i] = light[3];
+    }
+
+    for (uint32_t i = _lightCount; i < padded; ++i)
+        _lightX[i] = _lightY[i] = _lightZ[i] = 0.0f;
+
+    uint32_t batches = (padded + CULL_BATCH - 1) / CULL_BATCH;
+    auto cull = [&](uint32_t batch)
+    {
+        uint32_t first = batch * CULL_BATCH;
+        CullLights(first, min(CULL_BATCH, padded - first), view, projection);
+    };
+
+    auto bin = [&](uint32_t slice)
+    {
+        BinSlice(slice);
+    };
+
+    if (jobs)
+    {
+        jobs->ParallelFor(batches, cull);
+        jobs->ParallelFor(_params.CountZ, bin);
+    }
+    else
+    {
+        for (uint32_t i = 0; i < batches; ++i)
+            cull(i);
+
+        for (uint32_t i = 0; i < _params.CountZ; ++i)
+            bin(i);
+    }
+
+    // join the slices into one list, clusters past _maxIndices lose their lights
+    _indices.clear();
+    uint32_t tileCount = _params.CountX * _params.CountY;
+
+    for (uint32_t slice = 0; slice < _params.CountZ; ++slice)
+    {
+        const FrameTaggedVector<uint32_t>& counts = _sliceCounts[slice];
+        const FrameTaggedVector<uint32_t>& indices = _sliceIndices[slice];
+        uint32_t base = (uint32_t)_indices.size();
+        uint32_t kept = min((uint32_t)indices.size(), _maxIndices - base);
+
+        for (uint32_t tile = 0; tile < tileCount; ++tile)
+        {
+            // after BinSlice counts[tile] is the tile's start offset within the slice
+            uint32_t start = counts[tile];
+            uint32_t end = tile + 1 < tileCount ? counts[tile + 1] : (uint32_t)indices.size();
+            uint32_t cluster = slice * tileCount + tile;
+
+            _clusters[cluster * 2] = base + min(start, kept);
+            _clusters[cluster * 2 + 1] = min(end, kept) - min(start, kept);
+        }
+
+        _indices.insert(_indices.end(), indices.begin(), indices.begin() + kept);
+    }
+}
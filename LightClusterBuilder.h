@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "JobSystem.h"
+#include "MemoryTracker.h"
+
+using namespace std;
+
+// mirrors cbuffer ClusterParams in DX11 Framework.fx
+struct ClusterParams
+{
+	// pixels covered by one cluster tile
+	float TileSize[2];
+	// slice = log(viewZ) * SliceScale + SliceBias
+	float SliceScale;
+	float SliceBias;
+
+	uint32_t CountX;
+	uint32_t CountY;
+	uint32_t CountZ;
+	uint32_t LightCount;
+};
+
+// bins point lights into view space froxels (screen tiles split into exponential depth
+// slices). the cull runs four lights at a time with SSE and both passes are spread over
+// the job threads. free of windows and d3d headers so it can be checked and timed anywhere
+class LightClusterBuilder
+{
+public:
+	LightClusterBuilder();
+
+	void Init(uint32_t screenWidth, uint32_t screenHeight, float nearZ, float farZ,
+	          uint32_t tilesX = 16, uint32_t tilesY = 9, uint32_t slices = 24, uint32_t maxIndices = 256 * 1024);
+
+	// lights holds x, y, z and radius at the start of every floatsPerLight floats, as
+	// PointLight keeps them. view and projection are 16 floats, row major as XMFLOAT4X4
+	// keeps them, left handed with a perspective projection
+	void Build(const float* lights, uint32_t lightCount, uint32_t floatsPerLight, const float* view, const float* projection,
+	           JobSystem* jobs);
+
+	// offset and count into the light index list for every cluster, x fastest then y then slice
+	const FrameTaggedVector<uint32_t>& GetClusters() const { return _clusters; }
+	const FrameTaggedVector<uint32_t>& GetLightIndices() const { return _indices; }
+	const ClusterParams& GetParams() const { return _params; }
+	uint32_t GetClusterCount() const { return _params.CountX * _params.CountY * _params.CountZ; }
+	uint32_t GetMaxIndices() const { return _maxIndices; }
+
+private:
+	// cluster range a light touches, inclusive. maxZ < minZ when the light is culled
+	struct LightBounds
+	{
+		uint16_t minX;
+		uint16_t maxX;
+		uint16_t minY;
+		uint16_t maxY;
+		uint16_t minZ;
+		uint16_t maxZ;
+	};
+
+	void CullLights(uint32_t first, uint32_t count, const float* view, const float* projection);
+	void BinSlice(uint32_t slice);
+
+	ClusterParams _params;
+	float _nearZ;
+	float _farZ;
+	uint32_t _maxIndices;
+
+	// world space light spheres as structure of arrays, padded to a multiple of four
+	FrameTaggedVector<float> _lightX;
+	FrameTaggedVector<float> _lightY;
+	FrameTaggedVector<float> _lightZ;
+	FrameTaggedVector<float> _lightRadius;
+	uint32_t _lightCount;
+	FrameTaggedVector<LightBounds> _bounds;
+
+	// per slice results before they are joined into one list
+	FrameTaggedVector<FrameTaggedVector<uint32_t>> _sliceCounts;
+	FrameTaggedVector<FrameTaggedVector<uint32_t>> _sliceIndices;
+
+	FrameTaggedVector<uint32_t> _clusters;
+	FrameTaggedVector<uint32_t> _indices;
+};
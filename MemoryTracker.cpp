@@ -0,0 +1,145 @@
+#include "MemoryTracker.h"
+#include <atomic>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char* TAG_NAMES[MEMORY_TAG_COUNT] = { "mesh", "texture", "shader", "frame" };
+
+// in front of every allocation, padded so what follows keeps malloc's alignment
+struct alignas(16) AllocationHeader
+{
+    uint64_t bytes;
+    uint32_t tag;
+};
+
+struct TagCounters
+{
+    atomic<int64_t> liveBytes;
+    atomic<int64_t> peakBytes;
+    atomic<int64_t> liveAllocations;
+    atomic<uint64_t> totalAllocations;
+    atomic<uint64_t> budget;
+    atomic<uint64_t> overBudget;
+};
+
+// zero initialised before anything runs, so allocations from static constructors count too
+static TagCounters s_tags[MEMORY_TAG_COUNT];
+
+void MemoryTracker::Add(MemoryTag tag, size_t bytes, uint64_t allocations)
+{
+    TagCounters& counters = s_tags[tag];
+
+    int64_t live = counters.liveBytes.fetch_add((int64_t)bytes, memory_order_relaxed) + (int64_t)bytes;
+    counters.liveAllocations.fetch_add((int64_t)allocations, memory_order_relaxed);
+    counters.totalAllocations.fetch_add(allocations, memory_order_relaxed);
+
+    int64_t peak = counters.peakBytes.load(memory_order_relaxed);
+    while (live > peak && !counters.peakBytes.compare_exchange_weak(peak, live, memory_order_relaxed))
+    {
+    }
+
+    uint64_t budget = counters.budget.load(memory_order_relaxed);
+    if (budget && (uint64_t)live > budget)
+        counters.overBudget.fetch_add(1, memory_order_relaxed);
+}
+
+void* MemoryTracker::Allocate(size_t bytes, MemoryTag tag)
+{
+    AllocationHeader* header = static_cast<AllocationHeader*>(malloc(sizeof(AllocationHeader) + bytes));
+    if (!header)
+        throw bad_alloc();
+
+    header->bytes = bytes;
+    header->tag = tag;
+    Add(tag, bytes, 1);
+
+    return header + 1;
+}
+
+void MemoryTracker::Free(void* memory)
+{
+    if (!memory)
+        return;
+
+    AllocationHeader* header = static_cast<AllocationHeader*>(memory) - 1;
+    TagCounters& counters = s_tags[header->tag];
+    counters.liveBytes.fetch_sub((int64_t)header->bytes, memory_order_relaxed);
+    counters.liveAllocations.fetch_sub(1, memory_order_relaxed);
+
+    free(header);
+}
+
+void MemoryTracker::TrackExternal(MemoryTag tag, size_t bytes)
+{
+    Add(tag, bytes, 1);
+}
+
+void MemoryTracker::ReleaseExternal(MemoryTag tag, size_t bytes)
+{
+    s_tags[tag].liveBytes.fetch_sub((int64_t)bytes, memory_order_relaxed);
+    s_tags[tag].liveAllocations.fetch_sub(1, memory_order_relaxed);
+}
+
+void MemoryTracker::SetBudget(MemoryTag tag, uint64_t bytes)
+{
+    s_tags[tag].budget.store(bytes, memory_order_relaxed);
+}
+
+MemoryTagStats MemoryTracker::GetStats(MemoryTag tag)
+{
+    const TagCounters& counters = s_tags[tag];
+
+    MemoryTagStats stats;
+    stats.Name = TAG_NAMES[tag];
+    stats.LiveBytes = (uint64_t)counters.liveBytes.load(memory_order_relaxed);
+    stats.PeakBytes = (uint64_t)counters.peakBytes.load(memory_order_relaxed);
+    stats.LiveAllocations = (uint64_t)counters.liveAllocations.load(memory_order_relaxed);
+    stats.TotalAllocations = counters.totalAllocations.load(memory_order_relaxed);
+    stats.Budget = counters.budget.load(memory_order_relaxed);
+    stats.OverBudgetAllocations = counters.overBudget.load(memory_order_relaxed);
+    return stats;
+}
+
+string MemoryTracker::FormatLeaks()
+{
+    string text;
+    char line[256];
+
+    for (int tag = 0; tag < MEMORY_TAG_COUNT; ++tag)
+    {
+        MemoryTagStats stats = GetStats((MemoryTag)tag);
+        if (stats.LiveAllocations == 0 && stats.LiveBytes == 0)
+            continue;
+
+        snprintf(line, sizeof(line), "memory leak: %s, %llu bytes in %llu allocations\n", stats.Name,
+                 (unsigned long long)stats.LiveBytes, (unsigned long long)stats.LiveAllocations);
+        text += line;
+    }
+
+    return text;
+}
+
+string MemoryTracker::FormatReport()
+{
+    string text;
+    char line[256];
+
+    for (int tag = 0; tag < MEMORY_TAG_COUNT; ++tag)
+    {
+        MemoryTagStats stats = GetStats((MemoryTag)tag);
+        snprintf(line, sizeof(line), "memory %-8s live %10llu peak %10llu allocations %8llu", stats.Name,
+                 (unsigned long long)stats.LiveBytes, (unsigned long long)stats.PeakBytes, (unsigned long long)stats.TotalAllocations);
+        text += line;
+
+        if (stats.Budget)
+        {
+            snprintf(line, sizeof(line), " budget %llu (%llu allocations over)", (unsigned long long)stats.Budget,
+                     (unsigned long long)stats.OverBudgetAllocations);
+            text += line;
+        }
+        text += "\n";
+    }
+
+    return text;
+}
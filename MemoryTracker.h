@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// what an allocation is for, each tag keeps its own counts and budget
+enum MemoryTag
+{
+	MEMORY_TAG_MESH,
+	MEMORY_TAG_TEXTURE,
+	MEMORY_TAG_SHADER,
+	// rebuilt every frame
+	MEMORY_TAG_FRAME,
+	MEMORY_TAG_COUNT,
+};
+
+struct MemoryTagStats
+{
+	const char* Name;
+	uint64_t LiveBytes;
+	uint64_t PeakBytes;
+	uint64_t LiveAllocations;
+	uint64_t TotalAllocations;
+	// 0 for none
+	uint64_t Budget;
+	// allocations that took the tag over its budget
+	uint64_t OverBudgetAllocations;
+};
+
+// live and peak bytes per tag for the allocations made through it. counters are atomic
+// so any thread can allocate. budgets are soft like the texture residency budget: going
+// over is counted and reported, the allocation still succeeds. kept free of windows
+// headers so it builds and can be checked on any platform
+class MemoryTracker
+{
+public:
+	static void* Allocate(size_t bytes, MemoryTag tag);
+	static void Free(void* memory);
+
+	// memory someone else allocated (a loader's new[]) but that belongs to a tag, the
+	// same byte count has to be released again
+	static void TrackExternal(MemoryTag tag, size_t bytes);
+	static void ReleaseExternal(MemoryTag tag, size_t bytes);
+
+	static void SetBudget(MemoryTag tag, uint64_t bytes);
+	static MemoryTagStats GetStats(MemoryTag tag);
+
+	// a line per tag with anything still allocated, empty when nothing is
+	static string FormatLeaks();
+	// a line per tag: live, peak and budget
+	static string FormatReport();
+
+private:
+	static void Add(MemoryTag tag, size_t bytes, uint64_t allocations);
+};
+
+// STL allocator charging a tag, e.g. vector<float, TaggedAllocator<float, MEMORY_TAG_FRAME>>
+template <class T, MemoryTag Tag>
+class TaggedAllocator
+{
+public:
+	typedef T value_type;
+
+	template <class U> struct rebind { typedef TaggedAllocator<U, Tag> other; };
+
+	TaggedAllocator() { }
+	template <class U> TaggedAllocator(const TaggedAllocator<U, Tag>&) { }
+
+	T* allocate(size_t count) { return static_cast<T*>(MemoryTracker::Allocate(count * sizeof(T), Tag)); }
+	void deallocate(T* memory, size_t) { MemoryTracker::Free(memory); }
+
+	template <class U> bool operator==(const TaggedAllocator<U, Tag>&) const { return true; }
+	template <class U> bool operator!=(const TaggedAllocator<U, Tag>&) const { return false; }
+};
+
+template <class T> using MeshVector = vector<T, TaggedAllocator<T, MEMORY_TAG_MESH>>;
+template <class T> using TextureVector = vector<T, TaggedAllocator<T, MEMORY_TAG_TEXTURE>>;
+template <class T> using ShaderVector = vector<T, TaggedAllocator<T, MEMORY_TAG_SHADER>>;
+// heap memory that is rebuilt every frame, unlike FrameArenaVector it outlives the frame
+template <class T> using FrameTaggedVector = vector<T, TaggedAllocator<T, MEMORY_TAG_FRAME>>;
@@ -0,0 +1,118 @@
+#include "MeshGeneration.h"
+#include "Tangents.h"
+
+void GeneratePlaneVertices(float width, float depth, UINT widthVerts, UINT depthVerts, MeshVector<SimpleVertexNormal>& vertices)
+{
+    vertices.resize(widthVerts * depthVerts);
+
+    float hWidth = 0.5f * width;
+    float hDepth = 0.5f * depth;
+
+    float dx = width / (widthVerts - 1);
+    float dz = depth / (depthVerts - 1);
+
+    float du = 1.0f / (widthVerts - 1);
+    float dv = 1.0f / (depthVerts - 1);
+
+    SimpleVertexNormal* vertex = vertices.data();
+    for (UINT i = 0; i < depthVerts; ++i)
+    {
+        float z = hDepth - i * dz;
+        for (UINT j = 0; j < widthVerts; ++j, ++vertex)
+        {
+            vertex->Pos = XMFLOAT3(-hWidth + j * dx, 0, z);
+            vertex->normal = XMFLOAT4(0, -1, 0, 0);
+            vertex->TexC = XMFLOAT2(j * du, i * dv);
+            // u runs along +x and v along -z, with the normal facing -y that is a flipped bitangent
+            vertex->Tangent = XMFLOAT4(1, 0, 0, -1);
+        }
+    }
+}
+
+void GeneratePlaneIndices(UINT widthVerts, UINT depthVerts, MeshVector<WORD>& indices)
+{
+    indices.resize((widthVerts - 1) * (depthVerts - 1) * 6);
+
+    WORD* index = indices.data();
+    for (UINT i = 0; i < depthVerts - 1; ++i)
+    {
+        for (UINT j = 0; j < widthVerts - 1; ++j, index += 6)
+        {
+            WORD topLeft = (WORD)(i * widthVerts + j);
+            WORD bottomLeft = (WORD)((i + 1) * widthVerts + j);
+
+            index[0] = topLeft;
+            index[1] = topLeft + 1;
+            index[2] = bottomLeft;
+            index[3] = bottomLeft;
+            index[4] = topLeft + 1;
+            index[5] = bottomLeft + 1;
+        }
+    }
+}
+
+void GenerateCubeVertices(MeshVector<SimpleVertexNormal>& vertices)
+{
+    static const SimpleVertexNormal cubeVertices[] =
+    {
+        //front face
+        { XMFLOAT3(1, 1, 1), XMFLOAT4(0, 0, -1, 0), XMFLOAT2(1,0) },
+        { XMFLOAT3(-1, 1, 1), XMFLOAT4(0, 0, -1, 0), XMFLOAT2(0,0) },
+        { XMFLOAT3(-1, -1, 1), XMFLOAT4(0, 0, -1, 0), XMFLOAT2(0,1) },
+
+        { XMFLOAT3(1, -1, 1), XMFLOAT4(0, 0, -1, 0), XMFLOAT2(1,1) },
+        { XMFLOAT3(1, 1, 1), XMFLOAT4(0, 0, -1, 0), XMFLOAT2(1,0) },
+        { XMFLOAT3(-1, -1, 1), XMFLOAT4(0, 0, -1, 0), XMFLOAT2(0,1) },
+
+        //back face
+        { XMFLOAT3(-1, -1, -1), XMFLOAT4(0, 0, 1, 0), XMFLOAT2(1,1) },
+        { XMFLOAT3(1, 1, -1), XMFLOAT4(0, 0, 1, 0), XMFLOAT2(0,0) },
+        { XMFLOAT3(-1, 1, -1), XMFLOAT4(0, 0, 1, 0), XMFLOAT2(1,0) },
+
+        { XMFLOAT3(-1, -1, -1), XMFLOAT4(0, 0, 1, 0), XMFLOAT2(1,1) },
+        { XMFLOAT3(1, -1, -1), XMFLOAT4(0, 0, 1, 0), XMFLOAT2(0,1) },
+        { XMFLOAT3(1, 1, -1), XMFLOAT4(0, 0,1, 0), XMFLOAT2(0,0) },
+
+        //left face
+        { XMFLOAT3(-1, 1, 1), XMFLOAT4(1, 0, 0, 0), XMFLOAT2(1,0) },
+        { XMFLOAT3(-1, 1, -1), XMFLOAT4(1, 0, 0, 0), XMFLOAT2(0,0) },
+        { XMFLOAT3(-1, -1, -1), XMFLOAT4(1, 0, 0, 0), XMFLOAT2(0,1) },
+
+        { XMFLOAT3(-1, -1, -1), XMFLOAT4(1, 0, 0, 0), XMFLOAT2(0,1) },
+        { XMFLOAT3(-1, -1, 1), XMFLOAT4(1, 0, 0, 0), XMFLOAT2(1,1) },
+        { XMFLOAT3(-1, 1, 1), XMFLOAT4(1, 0, 0, 0), XMFLOAT2(1,0) },
+
+        //right face
+        { XMFLOAT3(1, 1, 1), XMFLOAT4(-1, 0, 0, 0), XMFLOAT2(0,0) },
+        { XMFLOAT3(1, -1, -1), XMFLOAT4(-1, 0, 0, 0), XMFLOAT2(1,1) },
+        { XMFLOAT3(1, 1, -1), XMFLOAT4(-1, 0, 0, 0), XMFLOAT2(1,0) },
+
+        { XMFLOAT3(1, -1, -1), XMFLOAT4(-1, 0, 0, 0), XMFLOAT2(1,1) },
+        { XMFLOAT3(1, 1, 1), XMFLOAT4(-1, 0, 0, 0), XMFLOAT2(0,0) },
+        { XMFLOAT3(1, -1, 1), XMFLOAT4(-1, 0, 0, 0), XMFLOAT2(0,1) },
+
+        //top face
+        { XMFLOAT3(-1, 1, -1), XMFLOAT4(0, -1, 0, 0), XMFLOAT2(0,0) },
+        { XMFLOAT3(-1, 1, 1), XMFLOAT4(0, -1, 0, 0), XMFLOAT2(0,1) },
+        { XMFLOAT3(1, 1, -1), XMFLOAT4(0, -1, 0, 0), XMFLOAT2(1,0) },
+
+        { XMFLOAT3(1, 1, -1), XMFLOAT4(0, -1, 0, 0), XMFLOAT2(1,0) },
+        { XMFLOAT3(-1, 1, 1), XMFLOAT4(0, -1, 0, 0), XMFLOAT2(0,1) },
+        { XMFLOAT3(1, 1, 1), XMFLOAT4(0, -1, 0, 0), XMFLOAT2(1,1) },
+
+        //bottom face
+        { XMFLOAT3(-1, -1, -1), XMFLOAT4(0, 1, 0, 0), XMFLOAT2(1,0) },
+        { XMFLOAT3(-1, -1, 1), XMFLOAT4(0, 1, 0, 0), XMFLOAT2(1,1) },
+        { XMFLOAT3(1, -1, -1), XMFLOAT4(0, 1, 0, 0), XMFLOAT2(0,0) },
+
+        { XMFLOAT3(1, -1, -1), XMFLOAT4(0, 1, 0, 0), XMFLOAT2(0,0) },
+        { XMFLOAT3(1, -1, 1), XMFLOAT4(0, 1, 0, 0), XMFLOAT2(0,1) },
+        { XMFLOAT3(-1, -1, 1), XMFLOAT4(0, 1, 0, 0), XMFLOAT2(1,1) },
+    };
+
+    vertices.assign(cubeVertices, cubeVertices + 36);
+
+    TangentVertexLayout tangentLayout = { sizeof(SimpleVertexNormal), offsetof(SimpleVertexNormal, Pos), offsetof(SimpleVertexNormal, normal),
+                                          offsetof(SimpleVertexNormal, TexC), offsetof(SimpleVertexNormal, Tangent) };
+    GenerateTangents(vertices.data(), 36, nullptr, 36, tangentLayout);
+}
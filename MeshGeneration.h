@@ -0,0 +1,31 @@
+#pragma once
+
+#include <windows.h>
+#include <directxmath.h>
+#include <vector>
+
+#include "MemoryTracker.h"
+
+using namespace DirectX;
+using namespace std;
+
+struct SimpleVertexNormal
+{
+	XMFLOAT3 Pos;
+	XMFLOAT4 normal;
+	XMFLOAT2 TexC;
+	//xyz = tangent, w = bitangent sign, filled in by GenerateTangents
+	XMFLOAT4 Tangent;
+};
+
+// flat grid in the xz plane centred on the origin. rows run from +z to -z and each row
+// from -x to +x, u follows x and v follows -z across the whole grid
+void GeneratePlaneVertices(float width, float depth, UINT widthVerts, UINT depthVerts, MeshVector<SimpleVertexNormal>& vertices);
+
+// two triangles per grid cell for vertices laid out as GeneratePlaneVertices does,
+// 16 bit indices so at most 65536 vertices
+void GeneratePlaneIndices(UINT widthVerts, UINT depthVerts, MeshVector<WORD>& indices);
+
+// the 36 vertices of a 2x2x2 cube centred on the origin, six per face, drawn without
+// indices. tangents are filled in
+void GenerateCubeVertices(MeshVector<SimpleVertexNormal>& vertices);
@@ -0,0 +1,170 @@
+#include "MicroBenchmark.h"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const void* volatile s_sink = nullptr;
+
+void MicroBenchmarkSink(const void* value)
+{
+    s_sink = value;
+}
+
+static FILE* OpenFile(const wchar_t* fileName, const char* mode)
+{
+#ifdef _WIN32
+    FILE* file = nullptr;
+    return _wfopen_s(&file, fileName, mode[0] == 'w' ? L"wt" : L"rt") == 0 ? file : nullptr;
+#else
+    char path[1024];
+    if (wcstombs(path, fileName, sizeof(path)) == (size_t)-1)
+        return nullptr;
+
+    return fopen(path, mode);
+#endif
+}
+
+MicroBenchmarkSuite::MicroBenchmarkSuite()
+{
+    _secondsPerRepetition = 0.1;
+    _repetitions = 9;
+}
+
+void MicroBenchmarkSuite::Add(const char* name, MicroBenchmarkFunction function, const vector<uint32_t>& arguments)
+{
+    Case benchmark;
+    benchmark.name = name;
+    benchmark.function = function;
+    benchmark.arguments = arguments;
+    _cases.push_back(benchmark);
+}
+
+void MicroBenchmarkSuite::SetRepetitions(double secondsPerRepetition, uint32_t repetitions)
+{
+    _secondsPerRepetition = secondsPerRepetition;
+    _repetitions = max(repetitions, 1u);
+}
+
+double MicroBenchmarkSuite::Time(MicroBenchmarkFunction function, uint32_t argument, uint64_t iterations)
+{
+    MicroBenchmarkState state;
+    state.Iterations = iterations;
+    state.Argument = argument;
+    state.Stopped = false;
+    state.StartTiming();
+
+    function(state);
+
+    if (!state.Stopped)
+        state.StopTiming();
+    return chrono::duration<double>(state.End - state.Start).count();
+}
+
+void MicroBenchmarkSuite::Run(const char* filter, vector<MicroBenchmarkResult>& results) const
+{
+    results.clear();
+
+    for (const Case& benchmark : _cases)
+    {
+        if (filter && *filter && !strstr(benchmark.name.c_str(), filter))
+            continue;
+
+        for (uint32_t argument : benchmark.arguments)
+        {
+            // Growing runs double as the warm-up, the caches and the branch predictor
+            // have seen the input by the time anything is kept
+            uint64_t iterations = 1;
+            double seconds = Time(benchmark.function, argument, iterations);
+            while (seconds < _secondsPerRepetition * 0.1 && iterations < (1ull << 40))
+            {
+                iterations *= 2;
+                seconds = Time(benchmark.function, argument, iterations);
+            }
+
+            iterations = max((uint64_t)(iterations * _secondsPerRepetition / max(seconds, 1e-9)), (uint64_t)1);
+
+            vector<double> samples;
+            for (uint32_t repetition = 0; repetition < _repetitions; ++repetition)
+                samples.push_back(Time(benchmark.function, argument, iterations) * 1e9 / iterations);
+
+            sort(samples.begin(), samples.end());
+
+            MicroBenchmarkResult result;
+            result.Name = benchmark.name + "/" + to_string(argument);
+            result.Iterations = iterations;
+            result.NsPerIteration = samples[samples.size() / 2];
+            result.MinNsPerIteration = samples[0];
+            results.push_back(result);
+        }
+    }
+}
+
+bool MicroBenchmarkSuite::WriteResults(const wchar_t* fileName, const vector<MicroBenchmarkResult>& results)
+{
+    FILE* file = OpenFile(fileName, "w");
+    if (!file)
+        return false;
+
+    fprintf(file, "name,ns_per_iteration,min_ns_per_iteration,iterations\n");
+    for (const MicroBenchmarkResult& result : results)
+        fprintf(file, "%s,%.3f,%.3f,%llu\n", result.Name.c_str(), result.NsPerIteration, result.MinNsPerIteration,
+                (unsigned long long)result.Iterations);
+
+    bool written = ferror(file) == 0;
+    fclose(file);
+    return written;
+}
+
+bool MicroBenchmarkSuite::ReadResults(const wchar_t* fileName, vector<MicroBenchmarkResult>& results)
+{
+    results.clear();
+
+    FILE* file = OpenFile(fileName, "r");
+    if (!file)
+        return false;
+
+    char line[512];
+    while (fgets(line, sizeof(line), file))
+    {
+        char name[256];
+        double ns, minNs;
+        unsigned long long iterations;
+        if (sscanf(line, "%255[^,],%lf,%lf,%llu", name, &ns, &minNs, &iterations) != 4)
+            continue;
+
+        MicroBenchmarkResult result;
+        result.Name = name;
+        result.Iterations = iterations;
+        result.NsPerIteration = ns;
+        result.MinNsPerIteration = minNs;
+        results.push_back(result);
+    }
+
+    fclose(file);
+    return true;
+}
+
+void MicroBenchmarkSuite::Compare(const vector<MicroBenchmarkResult>& baseline, const vector<MicroBenchmarkResult>& results,
+                                  double threshold, vector<MicroBenchmarkRegression>& regressions)
+{
+    regressions.clear();
+
+    for (const MicroBenchmarkResult& result : results)
+    {
+        for (const MicroBenchmarkResult& before : baseline)
+        {
+            if (before.Name != result.Name)
+                continue;
+
+            // Only when the fastest run is slower too, a noisy median on its own is not enough
+            if (result.NsPerIteration > before.NsPerIteration * (1.0 + threshold) &&
+                result.MinNsPerIteration > before.MinNsPerIteration * (1.0 + threshold))
+            {
+                MicroBenchmarkRegression regression = { result.Name, before.NsPerIteration, result.NsPerIteration };
+                regressions.push_back(regression);
+            }
+            break;
+        }
+    }
+}
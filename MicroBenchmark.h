@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <chrono>
+
+using namespace std;
+
+// what a case gets to run: Iterations passes over an input of size Argument. the clock
+// starts when the case is called unless it calls StartTiming after building its inputs,
+// and stops when it returns unless it calls StopTiming before tearing them down
+struct MicroBenchmarkState
+{
+	uint64_t Iterations;
+	uint32_t Argument;
+	chrono::steady_clock::time_point Start;
+	chrono::steady_clock::time_point End;
+	bool Stopped;
+
+	void StartTiming() { Start = chrono::steady_clock::now(); }
+	void StopTiming() { End = chrono::steady_clock::now(); Stopped = true; }
+};
+
+typedef void (*MicroBenchmarkFunction)(MicroBenchmarkState& state);
+
+struct MicroBenchmarkResult
+{
+	// case name and argument, "name/argument"
+	string Name;
+	uint64_t Iterations;
+	// median and fastest of the repetitions
+	double NsPerIteration;
+	double MinNsPerIteration;
+};
+
+struct MicroBenchmarkRegression
+{
+	string Name;
+	double BaselineNs;
+	double CurrentNs;
+};
+
+// stores a pointer nothing reads so the optimiser has to keep whatever produced it
+void MicroBenchmarkSink(const void* value);
+
+// google benchmark style runner. each case and argument is run once with a growing
+// iteration count until a run is long enough to time, that count is scaled up to the
+// repetition time and the repetitions' median is reported, so one slow repetition
+// (a context switch, a page fault) doesn't move the result. free of windows headers
+// like BenchmarkRecorder
+class MicroBenchmarkSuite
+{
+public:
+	MicroBenchmarkSuite();
+
+	void Add(const char* name, MicroBenchmarkFunction function, const vector<uint32_t>& arguments);
+	void SetRepetitions(double secondsPerRepetition, uint32_t repetitions);
+
+	// cases whose name contains filter, all of them with a null or empty filter
+	void Run(const char* filter, vector<MicroBenchmarkResult>& results) const;
+
+	// CSV, one line per result, the same file serves as a baseline for a later run
+	static bool WriteResults(const wchar_t* fileName, const vector<MicroBenchmarkResult>& results);
+	static bool ReadResults(const wchar_t* fileName, vector<MicroBenchmarkResult>& results);
+
+	// results slower than their baseline by more than threshold (0.1 for 10%) in both the
+	// median and the fastest repetition. cases only on one side are not compared
+	static void Compare(const vector<MicroBenchmarkResult>& baseline, const vector<MicroBenchmarkResult>& results,
+	                    double threshold, vector<MicroBenchmarkRegression>& regressions);
+
+private:
+	struct Case
+	{
+		string name;
+		MicroBenchmarkFunction function;
+		vector<uint32_t> arguments;
+	};
+
+	static double Time(MicroBenchmarkFunction function, uint32_t argument, uint64_t iterations);
+
+	vector<Case> _cases;
+	double _secondsPerRepetition;
+	uint32_t _repetitions;
+};
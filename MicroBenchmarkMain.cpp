@@ -0,0 +1,91 @@
+#include "HotPathBenchmarks.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// -microbench without the d3d cases, so the portable hot paths can be timed and checked
+// against a baseline on any machine. the same CSV, regression rule and exit codes
+//
+//   MicroBenchmark results.csv [-baseline file] [-threshold percent] [-filter name] [-quick]
+//
+// -quick times one short repetition of each case, for checking they run rather than
+// for numbers worth keeping
+
+static const char* ArgumentText(int argc, char** argv, const char* name)
+{
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        if (strcmp(argv[i], name) == 0)
+            return argv[i + 1];
+    }
+
+    return nullptr;
+}
+
+static bool HasArgument(int argc, char** argv, const char* name)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], name) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+static wstring WideArgument(const char* text)
+{
+    string narrow = text;
+    return wstring(narrow.begin(), narrow.end());
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || argv[1][0] == '-')
+    {
+        fprintf(stderr, "usage: MicroBenchmark results.csv [-baseline file] [-threshold percent] [-filter name] [-quick]\n");
+        return 2;
+    }
+
+    MicroBenchmarkSuite suite;
+    AddHotPathBenchmarks(suite);
+    if (HasArgument(argc, argv, "-quick"))
+        suite.SetRepetitions(0.001, 1);
+
+    vector<MicroBenchmarkResult> results;
+    suite.Run(ArgumentText(argc, argv, "-filter"), results);
+
+    for (const MicroBenchmarkResult& result : results)
+        printf("%-28s %12.1f ns (min %.1f, %llu iterations)\n", result.Name.c_str(), result.NsPerIteration,
+               result.MinNsPerIteration, (unsigned long long)result.Iterations);
+
+    if (!MicroBenchmarkSuite::WriteResults(WideArgument(argv[1]).c_str(), results))
+    {
+        fprintf(stderr, "MicroBenchmark: can't write %s\n", argv[1]);
+        return -1;
+    }
+
+    const char* baselineFile = ArgumentText(argc, argv, "-baseline");
+    if (!baselineFile)
+        return 0;
+
+    vector<MicroBenchmarkResult> baseline;
+    if (!MicroBenchmarkSuite::ReadResults(WideArgument(baselineFile).c_str(), baseline))
+    {
+        fprintf(stderr, "MicroBenchmark: can't read %s\n", baselineFile);
+        return -1;
+    }
+
+    double threshold = 10.0;
+    if (ArgumentText(argc, argv, "-threshold"))
+        threshold = atof(ArgumentText(argc, argv, "-threshold"));
+
+    vector<MicroBenchmarkRegression> regressions;
+    MicroBenchmarkSuite::Compare(baseline, results, threshold / 100.0, regressions);
+
+    for (const MicroBenchmarkRegression& regression : regressions)
+        printf("regression: %s %.1f ns -> %.1f ns (+%.0f%%)\n", regression.Name.c_str(), regression.BaselineNs,
+               regression.CurrentNs, (regression.CurrentNs / regression.BaselineNs - 1.0) * 100.0);
+
+    return regressions.empty() ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+#include "ResolutionController.h"
+#include <algorithm>
+#include <math.h>
+
+// the viewport snaps to this many pixels so tiny scale changes don't resize it every frame
+static const float SCALE_STEP = 1.0f / 64.0f;
+
+//--------------------------------------------------------------------------------------
+// ResolutionController
+//--------------------------------------------------------------------------------------
+ResolutionController::ResolutionController()
+{
+    _budget = 1.0 / 60.0;
+    _minScale = 0.5f;
+    _maxScale = 1.0f;
+    _proportional = 0.4f;
+    _integral = 0.02f;
+    _derivative = 0.05f;
+    _dropThreshold = 0.05f;
+    _raiseThreshold = 0.15f;
+    _raiseDelay = 10;
+    Reset();
+}
+
+void ResolutionController::Init(double budget, float minScale, float maxScale)
+{
+    _budget = budget;
+    _minScale = minScale;
+    _maxScale = maxScale;
+    Reset();
+}
+
+void ResolutionController::Reset()
+{
+    _scale = _maxScale;
+    _errorSum = 0.0f;
+    _lastError = 0.0f;
+    _headroomFrames = 0;
+}
+
+void ResolutionController::SetGains(float proportional, float integral, float derivative)
+{
+    _proportional = proportional;
+    _integral = integral;
+    _derivative = derivative;
+}
+
+void ResolutionController::SetHysteresis(float dropThreshold, float raiseThreshold)
+{
+    _dropThreshold = dropThreshold;
+    _raiseThreshold = raiseThreshold;
+}
+
+float ResolutionController::Update(double frameTime)
+{
+    // a single hitch can be several budgets long, limit how hard one frame can pull
+    float error = min(max((float)((_budget - frameTime) / _budget), -0.5f), 0.5f);
+    float derivative = error - _lastError;
+    _lastError = error;
+
+    // inside the band, hold and let the accumulated error fade
+    if (error > -_dropThreshold && error < _raiseThreshold)
+    {
+        _headroomFrames = 0;
+        _errorSum *= 0.9f;
+        return _scale;
+    }
+
+    // drop straight away, grow only once the headroom has lasted
+    if (error > 0.0f)
+    {
+        if (++_headroomFrames < _raiseDelay)
+            return _scale;
+    }
+    else
+    {
+        _headroomFrames = 0;
+    }
+
+    // no winding up against a limit the scale can't get past
+    bool saturated = (_scale >= _maxScale && error > 0.0f) || (_scale <= _minScale && error < 0.0f);
+    if (!saturated)
+        _errorSum = min(max(_errorSum + error, -1.0f), 1.0f);
+
+    float output = _proportional * error + _integral * _errorSum + _derivative * derivative;
+
+    // the cost that scales is per pixel, so correct the area and take the root
+    float area = _scale * _scale * max(1.0f + output, 0.25f);
+    float scale = min(max(sqrtf(area), _minScale), _maxScale);
+    _scale = min(max(floorf(scale / SCALE_STEP + 0.5f) * SCALE_STEP, _minScale), _maxScale);
+
+    return _scale;
+}
+
+//--------------------------------------------------------------------------------------
+// Traces
+//--------------------------------------------------------------------------------------
+ResolutionTraceResult ReplayFrameTimeTrace(ResolutionController& controller, const vector<double>& frameTimes, float fixedFraction)
+{
+    ResolutionTraceResult result = {};
+    result.MinScale = controller.GetScale();
+
+    double scaleSum = 0.0;
+    float scale = controller.GetScale();
+
+    for (double fullTime : frameTimes)
+    {
+        double frameTime = fullTime * (fixedFraction + (1.0f - fixedFraction) * scale * scale);
+        if (frameTime > controller.GetBudget())
+            result.OverBudget++;
+
+        scaleSum += scale;
+        result.MinScale = min(result.MinScale, scale);
+
+        float next = controller.Update(frameTime);
+        if (next != scale)
+            result.ScaleChanges++;
+
+        scale = next;
+        result.Frames++;
+    }
+
+    result.MeanScale = result.Frames ? (float)(scaleSum / result.Frames) : scale;
+    return result;
+}
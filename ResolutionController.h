@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+// works out the render scale from measured frame times. the error is the headroom left
+// under the budget as a fraction of it, and a PID on that error nudges the pixel count
+// (the square of the scale) each frame. a band around the budget holds the scale still
+// so noise doesn't make it hunt, and it only grows back after a run of frames with room
+class ResolutionController
+{
+public:
+	ResolutionController();
+
+	void Init(double budget, float minScale = 0.5f, float maxScale = 1.0f);
+	void Reset();
+
+	void SetBudget(double budget) { _budget = budget; }
+	void SetGains(float proportional, float integral, float derivative);
+	// the scale drops once a frame is dropThreshold over budget and grows once there is
+	// raiseThreshold of headroom, both as fractions of the budget
+	void SetHysteresis(float dropThreshold, float raiseThreshold);
+	// frames in a row with headroom before the scale may grow
+	void SetRaiseDelay(uint32_t frames) { _raiseDelay = frames; }
+
+	// feeds in the last frame's time in seconds and returns the scale to render at next
+	float Update(double frameTime);
+
+	float GetScale() const { return _scale; }
+	double GetBudget() const { return _budget; }
+
+private:
+	double _budget;
+	float _minScale;
+	float _maxScale;
+	float _scale;
+
+	float _proportional;
+	float _integral;
+	float _derivative;
+	float _dropThreshold;
+	float _raiseThreshold;
+	uint32_t _raiseDelay;
+
+	float _errorSum;
+	float _lastError;
+	uint32_t _headroomFrames;
+};
+
+struct ResolutionTraceResult
+{
+	uint32_t Frames;
+	uint32_t OverBudget;
+	uint32_t ScaleChanges;
+	float MeanScale;
+	float MinScale;
+};
+
+// runs a recorded trace through the controller in closed loop. the recorded frames were
+// full resolution, so each replayed frame costs fixedFraction of it plus the rest scaled
+// by the pixel count the controller asked for on the frame before
+ResolutionTraceResult ReplayFrameTimeTrace(ResolutionController& controller, const vector<double>& frameTimes,
+                                           float fixedFraction = 0.2f);
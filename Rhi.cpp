@@ -0,0 +1,29 @@
+#include "Rhi.h"
+
+uint64_t GetRhiSurfaceBytes(RhiFormat format, uint32_t width, uint32_t height)
+{
+    uint64_t blocksWide = (width + 3) / 4;
+    uint64_t blocksHigh = (height + 3) / 4;
+
+    switch (format)
+    {
+    case RHI_FORMAT_R32G32B32A32_FLOAT:
+        return (uint64_t)width * height * 16;
+    case RHI_FORMAT_R32G32B32_FLOAT:
+        return (uint64_t)width * height * 12;
+    case RHI_FORMAT_R32G32_FLOAT:
+        return (uint64_t)width * height * 8;
+    case RHI_FORMAT_R8G8B8A8_UNORM:
+    case RHI_FORMAT_B8G8R8A8_UNORM:
+    case RHI_FORMAT_R32_UINT:
+        return (uint64_t)width * height * 4;
+    case RHI_FORMAT_R16_UINT:
+        return (uint64_t)width * height * 2;
+    case RHI_FORMAT_BC1_UNORM:
+        return blocksWide * blocksHigh * 8;
+    case RHI_FORMAT_BC3_UNORM:
+        return blocksWide * blocksHigh * 16;
+    default:
+        return 0;
+    }
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+using namespace std;
+
+// a thin layer over the device for the scene passes: buffers, textures, shaders, pipeline
+// states and a command list to draw with. the D3D11 backend is what the app runs on, the
+// null backend (RhiNull.h) validates and counts without a GPU, the recording backend
+// (RhiRecording.h) keeps commands to replay later and the software backend
+// (RhiSoftware.h) draws on the CPU. this header needs no platform headers
+
+// the values are DXGI_FORMAT's so the D3D11 backend passes them straight through
+enum RhiFormat
+{
+	RHI_FORMAT_UNKNOWN = 0,
+	RHI_FORMAT_R32G32B32A32_FLOAT = 2,
+	RHI_FORMAT_R32G32B32_FLOAT = 6,
+	RHI_FORMAT_R32G32_FLOAT = 16,
+	RHI_FORMAT_R8G8B8A8_UNORM = 28,
+	RHI_FORMAT_R32_UINT = 42,
+	RHI_FORMAT_R16_UINT = 57,
+	RHI_FORMAT_BC1_UNORM = 71,
+	RHI_FORMAT_BC3_UNORM = 77,
+	RHI_FORMAT_B8G8R8A8_UNORM = 87,
+};
+
+enum RhiBufferKind
+{
+	RHI_BUFFER_VERTEX,
+	RHI_BUFFER_INDEX,
+	RHI_BUFFER_CONSTANT,
+};
+
+enum RhiShaderStage
+{
+	RHI_STAGE_VERTEX,
+	RHI_STAGE_PIXEL,
+	RHI_STAGE_COUNT,
+};
+
+enum RhiFillMode
+{
+	RHI_FILL_SOLID,
+	RHI_FILL_WIREFRAME,
+};
+
+enum RhiCullMode
+{
+	RHI_CULL_NONE,
+	RHI_CULL_FRONT,
+	RHI_CULL_BACK,
+};
+
+static const uint32_t RHI_MAX_VERTEX_BUFFERS = 4;
+static const uint32_t RHI_MAX_CONSTANT_BUFFERS = 14;
+static const uint32_t RHI_MAX_TEXTURES = 16;
+static const uint32_t RHI_MAX_VERTEX_ELEMENTS = 8;
+// a vertex element offset that puts the element straight after the one before
+static const uint32_t RHI_APPEND_ALIGNED = 0xffffffff;
+// D3D11's limit on a constant buffer, and they are sized in whole registers
+static const uint32_t RHI_MAX_CONSTANT_BUFFER_BYTES = 64 * 1024;
+
+struct RhiBufferDesc
+{
+	RhiBufferKind Kind;
+	uint32_t Bytes;
+	// bytes per vertex or index, unused for constant buffers
+	uint32_t Stride;
+};
+
+// 2D textures and texture arrays, shader visible
+struct RhiTextureDesc
+{
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t MipLevels;
+	uint32_t ArraySize;
+	RhiFormat Format;
+};
+
+// one mip of one slice, mip major within a slice as D3D orders subresources
+struct RhiSubresourceData
+{
+	const void* Data;
+	uint32_t RowPitch;
+};
+
+struct RhiShaderDesc
+{
+	RhiShaderStage Stage;
+	const void* Bytecode;
+	size_t Bytes;
+};
+
+// the vertex layout reads from vertex buffer slot 0
+struct RhiVertexElement
+{
+	const char* Semantic;
+	uint32_t SemanticIndex;
+	RhiFormat Format;
+	uint32_t Offset;
+};
+
+class RhiShader;
+
+// everything a draw needs besides its buffers and textures, triangle lists only
+struct RhiPipelineStateDesc
+{
+	RhiShader* VertexShader;
+	RhiShader* PixelShader;
+	RhiVertexElement Elements[RHI_MAX_VERTEX_ELEMENTS];
+	uint32_t ElementCount;
+	RhiFillMode Fill;
+	RhiCullMode Cull;
+	// off lets geometry past the far plane through with its depth clamped
+	bool DepthClip;
+	bool DepthTest;
+	bool DepthWrite;
+};
+
+// objects are freed with delete, after the last command list that used them has been
+// executed or reset
+class RhiBuffer
+{
+public:
+	virtual ~RhiBuffer() { }
+	const RhiBufferDesc& GetDesc() const { return _desc; }
+
+protected:
+	RhiBufferDesc _desc;
+};
+
+class RhiTexture
+{
+public:
+	virtual ~RhiTexture() { }
+	const RhiTextureDesc& GetDesc() const { return _desc; }
+
+protected:
+	RhiTextureDesc _desc;
+};
+
+class RhiShader
+{
+public:
+	virtual ~RhiShader() { }
+	RhiShaderStage GetStage() const { return _stage; }
+
+protected:
+	RhiShaderStage _stage;
+};
+
+class RhiPipelineState
+{
+public:
+	virtual ~RhiPipelineState() { }
+	const RhiPipelineStateDesc& GetDesc() const { return _desc; }
+
+protected:
+	RhiPipelineStateDesc _desc;
+};
+
+// records or issues draws. render targets, viewports and anything the RHI doesn't cover
+// are still set on the device directly, around the command list's work
+class RhiCommandList
+{
+public:
+	virtual ~RhiCommandList() { }
+
+	virtual void SetPipelineState(RhiPipelineState* state) = 0;
+	// strides come from the buffers, an index buffer's is 2 or 4
+	virtual void SetVertexBuffer(uint32_t slot, RhiBuffer* buffer, uint32_t offset) = 0;
+	virtual void SetIndexBuffer(RhiBuffer* buffer, uint32_t offset) = 0;
+	virtual void SetConstantBuffer(RhiShaderStage stage, uint32_t slot, RhiBuffer* buffer) = 0;
+	virtual void SetTexture(RhiShaderStage stage, uint32_t slot, RhiTexture* texture) = 0;
+	// replaces the start of the buffer, constant buffers have to be replaced whole
+	virtual void UpdateBuffer(RhiBuffer* buffer, const void* data, uint32_t bytes) = 0;
+
+	virtual void Draw(uint32_t vertexCount, uint32_t startVertex) = 0;
+	virtual void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) = 0;
+};
+
+// creates objects, returning null when the description is no good or the backend fails
+class RhiDevice
+{
+public:
+	virtual ~RhiDevice() { }
+
+	// initialData may be null
+	virtual RhiBuffer* CreateBuffer(const RhiBufferDesc& desc, const void* initialData) = 0;
+	// initialData is null or has MipLevels * ArraySize entries
+	virtual RhiTexture* CreateTexture(const RhiTextureDesc& desc, const RhiSubresourceData* initialData) = 0;
+	virtual RhiShader* CreateShader(const RhiShaderDesc& desc) = 0;
+	virtual RhiPipelineState* CreatePipelineState(const RhiPipelineStateDesc& desc) = 0;
+
+	// the one command list that goes straight to the device
+	virtual RhiCommandList* GetImmediateCommandList() = 0;
+};
+
+// bytes in one mip of a texture, 0 for a format the RHI doesn't know
+uint64_t GetRhiSurfaceBytes(RhiFormat format, uint32_t width, uint32_t height);
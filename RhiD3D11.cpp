@@ -0,0 +1,400 @@
+#include "RhiD3D11.h"
+#include <vector>
+
+//--------------------------------------------------------------------------------------
+// Objects, each holds a reference to the D3D objects behind it
+//--------------------------------------------------------------------------------------
+class D3D11RhiBuffer : public RhiBuffer
+{
+public:
+    D3D11RhiBuffer(ID3D11Buffer* buffer, const RhiBufferDesc& desc)
+    {
+        _buffer = buffer;
+        _buffer->AddRef();
+        _desc = desc;
+    }
+
+    ~D3D11RhiBuffer()
+    {
+        _buffer->Release();
+    }
+
+    ID3D11Buffer* GetBuffer() const { return _buffer; }
+
+private:
+    ID3D11Buffer* _buffer;
+};
+
+class D3D11RhiTexture : public RhiTexture
+{
+public:
+    D3D11RhiTexture(ID3D11ShaderResourceView* view, const RhiTextureDesc& desc)
+    {
+        _view = view;
+        _view->AddRef();
+        _desc = desc;
+    }
+
+    ~D3D11RhiTexture()
+    {
+        _view->Release();
+    }
+
+    ID3D11ShaderResourceView* GetView() const { return _view; }
+
+private:
+    ID3D11ShaderResourceView* _view;
+};
+
+class D3D11RhiShader : public RhiShader
+{
+public:
+    D3D11RhiShader(ID3D11DeviceChild* shader, RhiShaderStage stage, const void* bytecode, size_t bytes)
+    {
+        _shader = shader;
+        _shader->AddRef();
+        _stage = stage;
+        if (bytecode)
+            _bytecode.assign((const uint8_t*)bytecode, (const uint8_t*)bytecode + bytes);
+    }
+
+    ~D3D11RhiShader()
+    {
+        _shader->Release();
+    }
+
+    ID3D11VertexShader* GetVertexShader() const { return _stage == RHI_STAGE_VERTEX ? static_cast<ID3D11VertexShader*>(_shader) : nullptr; }
+    ID3D11PixelShader* GetPixelShader() const { return _stage == RHI_STAGE_PIXEL ? static_cast<ID3D11PixelShader*>(_shader) : nullptr; }
+    const vector<uint8_t>& GetBytecode() const { return _bytecode; }
+
+private:
+    ID3D11DeviceChild* _shader;
+    // vertex shaders only, for the input layouts
+    vector<uint8_t> _bytecode;
+};
+
+class D3D11RhiPipelineState : public RhiPipelineState
+{
+public:
+    D3D11RhiPipelineState(const RhiPipelineStateDesc& desc)
+    {
+        _desc = desc;
+        _vertexShader = nullptr;
+        _pixelShader = nullptr;
+        _inputLayout = nullptr;
+        _rasterizerState = nullptr;
+        _depthStencilState = nullptr;
+    }
+
+    ~D3D11RhiPipelineState()
+    {
+        if (_vertexShader) _vertexShader->Release();
+        if (_pixelShader) _pixelShader->Release();
+        if (_inputLayout) _inputLayout->Release();
+        if (_rasterizerState) _rasterizerState->Release();
+        if (_depthStencilState) _depthStencilState->Release();
+    }
+
+    ID3D11VertexShader* _vertexShader;
+    ID3D11PixelShader* _pixelShader;
+    ID3D11InputLayout* _inputLayout;
+    ID3D11RasterizerState* _rasterizerState;
+    // null for the default, depth tested and written
+    ID3D11DepthStencilState* _depthStencilState;
+};
+
+static UINT BindFlags(RhiBufferKind kind)
+{
+    switch (kind)
+    {
+    case RHI_BUFFER_VERTEX:
+        return D3D11_BIND_VERTEX_BUFFER;
+    case RHI_BUFFER_INDEX:
+        return D3D11_BIND_INDEX_BUFFER;
+    default:
+        return D3D11_BIND_CONSTANT_BUFFER;
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// Device
+//--------------------------------------------------------------------------------------
+D3D11RhiDevice::D3D11RhiDevice()
+{
+    _device = nullptr;
+}
+
+void D3D11RhiDevice::Init(ID3D11Device* device, ID3D11DeviceContext* context)
+{
+    _device = device;
+    _commandList.SetContext(context);
+}
+
+RhiBuffer* D3D11RhiDevice::CreateBuffer(const RhiBufferDesc& desc, const void* initialData)
+{
+    D3D11_BUFFER_DESC bd;
+    ZeroMemory(&bd, sizeof(bd));
+    bd.Usage = D3D11_USAGE_DEFAULT;
+    bd.ByteWidth = desc.Bytes;
+    bd.BindFlags = BindFlags(desc.Kind);
+
+    D3D11_SUBRESOURCE_DATA data;
+    ZeroMemory(&data, sizeof(data));
+    data.pSysMem = initialData;
+
+    ID3D11Buffer* buffer = nullptr;
+    if (FAILED(_device->CreateBuffer(&bd, initialData ? &data : nullptr, &buffer)))
+        return nullptr;
+
+    RhiBuffer* result = new D3D11RhiBuffer(buffer, desc);
+    buffer->Release();
+    return result;
+}
+
+RhiTexture* D3D11RhiDevice::CreateTexture(const RhiTextureDesc& desc, const RhiSubresourceData* initialData)
+{
+    D3D11_TEXTURE2D_DESC td;
+    ZeroMemory(&td, sizeof(td));
+    td.Width = desc.Width;
+    td.Height = desc.Height;
+    td.MipLevels = desc.MipLevels;
+    td.ArraySize = desc.ArraySize;
+    td.Format = (DXGI_FORMAT)desc.Format;
+    td.SampleDesc.Count = 1;
+    td.Usage = D3D11_USAGE_DEFAULT;
+    td.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+    vector<D3D11_SUBRESOURCE_DATA> data;
+    if (initialData)
+    {
+        data.resize(desc.MipLevels * desc.ArraySize);
+        for (size_t i = 0; i < data.size(); ++i)
+        {
+            data[i].pSysMem = initialData[i].Data;
+            data[i].SysMemPitch = initialData[i].RowPitch;
+            data[i].SysMemSlicePitch = 0;
+        }
+    }
+
+    ID3D11Texture2D* texture = nullptr;
+    HRESULT hr = _device->CreateTexture2D(&td, initialData ? data.data() : nullptr, &texture);
+    if (FAILED(hr))
+        return nullptr;
+
+    ID3D11ShaderResourceView* view = nullptr;
+    hr = _device->CreateShaderResourceView(texture, nullptr, &view);
+    texture->Release();
+    if (FAILED(hr))
+        return nullptr;
+
+    RhiTexture* result = new D3D11RhiTexture(view, desc);
+    view->Release();
+    return result;
+}
+
+RhiShader* D3D11RhiDevice::CreateShader(const RhiShaderDesc& desc)
+{
+    ID3D11DeviceChild* shader = nullptr;
+    HRESULT hr = E_INVALIDARG;
+
+    if (desc.Stage == RHI_STAGE_VERTEX)
+    {
+        ID3D11VertexShader* vertexShader = nullptr;
+        hr = _device->CreateVertexShader(desc.Bytecode, desc.Bytes, nullptr, &vertexShader);
+        shader = vertexShader;
+    }
+    else if (desc.Stage == RHI_STAGE_PIXEL)
+    {
+        ID3D11PixelShader* pixelShader = nullptr;
+        hr = _device->CreatePixelShader(desc.Bytecode, desc.Bytes, nullptr, &pixelShader);
+        shader = pixelShader;
+    }
+
+    if (FAILED(hr))
+        return nullptr;
+
+    bool vertex = desc.Stage == RHI_STAGE_VERTEX;
+    RhiShader* result = new D3D11RhiShader(shader, desc.Stage, vertex ? desc.Bytecode : nullptr, vertex ? desc.Bytes : 0);
+    shader->Release();
+    return result;
+}
+
+RhiPipelineState* D3D11RhiDevice::CreatePipelineState(const RhiPipelineStateDesc& desc)
+{
+    D3D11RhiShader* vertexShader = static_cast<D3D11RhiShader*>(desc.VertexShader);
+    D3D11RhiShader* pixelShader = static_cast<D3D11RhiShader*>(desc.PixelShader);
+    if (!vertexShader || !vertexShader->GetVertexShader() || vertexShader->GetBytecode().empty() ||
+        (pixelShader && !pixelShader->GetPixelShader()) || desc.ElementCount > RHI_MAX_VERTEX_ELEMENTS)
+        return nullptr;
+
+    D3D11RhiPipelineState* state = new D3D11RhiPipelineState(desc);
+    state->_vertexShader = vertexShader->GetVertexShader();
+    state->_vertexShader->AddRef();
+    if (pixelShader)
+    {
+        state->_pixelShader = pixelShader->GetPixelShader();
+        state->_pixelShader->AddRef();
+    }
+
+    D3D11_INPUT_ELEMENT_DESC layout[RHI_MAX_VERTEX_ELEMENTS];
+    for (UINT i = 0; i < desc.ElementCount; ++i)
+    {
+        layout[i].SemanticName = desc.Elements[i].Semantic;
+        layout[i].SemanticIndex = desc.Elements[i].SemanticIndex;
+        layout[i].Format = (DXGI_FORMAT)desc.Elements[i].Format;
+        layout[i].InputSlot = 0;
+        layout[i].AlignedByteOffset = desc.Elements[i].Offset;
+        layout[i].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
+        layout[i].InstanceDataStepRate = 0;
+    }
+
+    const vector<uint8_t>& bytecode = vertexShader->GetBytecode();
+    HRESULT hr = _device->CreateInputLayout(layout, desc.ElementCount, bytecode.data(), bytecode.size(), &state->_inputLayout);
+
+    if (SUCCEEDED(hr))
+    {
+        D3D11_RASTERIZER_DESC rd;
+        ZeroMemory(&rd, sizeof(rd));
+        rd.FillMode = desc.Fill == RHI_FILL_WIREFRAME ? D3D11_FILL_WIREFRAME : D3D11_FILL_SOLID;
+        rd.CullMode = desc.Cull == RHI_CULL_FRONT ? D3D11_CULL_FRONT : desc.Cull == RHI_CULL_BACK ? D3D11_CULL_BACK : D3D11_CULL_NONE;
+        rd.DepthClipEnable = desc.DepthClip;
+        hr = _device->CreateRasterizerState(&rd, &state->_rasterizerState);
+    }
+
+    if (SUCCEEDED(hr) && !(desc.DepthTest && desc.DepthWrite))
+    {
+        D3D11_DEPTH_STENCIL_DESC dsd;
+        ZeroMemory(&dsd, sizeof(dsd));
+        dsd.DepthEnable = desc.DepthTest;
+        dsd.DepthWriteMask = desc.DepthWrite ? D3D11_DEPTH_WRITE_MASK_ALL : D3D11_DEPTH_WRITE_MASK_ZERO;
+        dsd.DepthFunc = D3D11_COMPARISON_LESS;
+        hr = _device->CreateDepthStencilState(&dsd, &state->_depthStencilState);
+    }
+
+    if (FAILED(hr))
+    {
+        delete state;
+        return nullptr;
+    }
+
+    return state;
+}
+
+RhiBuffer* D3D11RhiDevice::WrapBuffer(ID3D11Buffer* buffer, RhiBufferKind kind, UINT stride)
+{
+    D3D11_BUFFER_DESC bd;
+    buffer->GetDesc(&bd);
+
+    RhiBufferDesc desc;
+    desc.Kind = kind;
+    desc.Bytes = bd.ByteWidth;
+    desc.Stride = stride;
+    return new D3D11RhiBuffer(buffer, desc);
+}
+
+RhiShader* D3D11RhiDevice::WrapVertexShader(ID3D11VertexShader* shader, const void* bytecode, size_t bytes)
+{
+    return new D3D11RhiShader(shader, RHI_STAGE_VERTEX, bytecode, bytes);
+}
+
+RhiShader* D3D11RhiDevice::WrapPixelShader(ID3D11PixelShader* shader)
+{
+    return new D3D11RhiShader(shader, RHI_STAGE_PIXEL, nullptr, 0);
+}
+
+RhiTexture* D3D11RhiDevice::WrapTexture(ID3D11ShaderResourceView* view)
+{
+    ID3D11Resource* resource = nullptr;
+    view->GetResource(&resource);
+
+    D3D11_TEXTURE2D_DESC td;
+    static_cast<ID3D11Texture2D*>(resource)->GetDesc(&td);
+    resource->Release();
+
+    RhiTextureDesc desc;
+    desc.Width = td.Width;
+    desc.Height = td.Height;
+    desc.MipLevels = td.MipLevels;
+    desc.ArraySize = td.ArraySize;
+    desc.Format = (RhiFormat)td.Format;
+    return new D3D11RhiTexture(view, desc);
+}
+
+//--------------------------------------------------------------------------------------
+// Command list
+//--------------------------------------------------------------------------------------
+D3D11RhiCommandList::D3D11RhiCommandList()
+{
+    _context = nullptr;
+}
+
+static ID3D11Buffer* GetBuffer(RhiBuffer* buffer)
+{
+    return buffer ? static_cast<D3D11RhiBuffer*>(buffer)->GetBuffer() : nullptr;
+}
+
+void D3D11RhiCommandList::SetPipelineState(RhiPipelineState* state)
+{
+    D3D11RhiPipelineState* d3dState = static_cast<D3D11RhiPipelineState*>(state);
+
+    _context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    _context->IASetInputLayout(d3dState ? d3dState->_inputLayout : nullptr);
+    _context->VSSetShader(d3dState ? d3dState->_vertexShader : nullptr, nullptr, 0);
+    _context->PSSetShader(d3dState ? d3dState->_pixelShader : nullptr, nullptr, 0);
+    _context->RSSetState(d3dState ? d3dState->_rasterizerState : nullptr);
+    _context->OMSetDepthStencilState(d3dState ? d3dState->_depthStencilState : nullptr, 0);
+}
+
+void D3D11RhiCommandList::SetVertexBuffer(uint32_t slot, RhiBuffer* buffer, uint32_t offset)
+{
+    ID3D11Buffer* d3dBuffer = GetBuffer(buffer);
+    UINT stride = buffer ? buffer->GetDesc().Stride : 0;
+    _context->IASetVertexBuffers(slot, 1, &d3dBuffer, &stride, &offset);
+}
+
+void D3D11RhiCommandList::SetIndexBuffer(RhiBuffer* buffer, uint32_t offset)
+{
+    DXGI_FORMAT format = buffer && buffer->GetDesc().Stride == 4 ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
+    _context->IASetIndexBuffer(GetBuffer(buffer), format, offset);
+}
+
+void D3D11RhiCommandList::SetConstantBuffer(RhiShaderStage stage, uint32_t slot, RhiBuffer* buffer)
+{
+    ID3D11Buffer* d3dBuffer = GetBuffer(buffer);
+    if (stage == RHI_STAGE_VERTEX)
+        _context->VSSetConstantBuffers(slot, 1, &d3dBuffer);
+    else
+        _context->PSSetConstantBuffers(slot, 1, &d3dBuffer);
+}
+
+void D3D11RhiCommandList::SetTexture(RhiShaderStage stage, uint32_t slot, RhiTexture* texture)
+{
+    ID3D11ShaderResourceView* view = texture ? static_cast<D3D11RhiTexture*>(texture)->GetView() : nullptr;
+    if (stage == RHI_STAGE_VERTEX)
+        _context->VSSetShaderResources(slot, 1, &view);
+    else
+        _context->PSSetShaderResources(slot, 1, &view);
+}
+
+void D3D11RhiCommandList::UpdateBuffer(RhiBuffer* buffer, const void* data, uint32_t bytes)
+{
+    // Constant buffers can't take a box before 11.1, they are replaced whole anyway
+    if (buffer->GetDesc().Kind == RHI_BUFFER_CONSTANT)
+    {
+        _context->UpdateSubresource(GetBuffer(buffer), 0, nullptr, data, 0, 0);
+        return;
+    }
+
+    D3D11_BOX box = { 0, 0, 0, bytes, 1, 1 };
+    _context->UpdateSubresource(GetBuffer(buffer), 0, &box, data, 0, 0);
+}
+
+void D3D11RhiCommandList::Draw(uint32_t vertexCount, uint32_t startVertex)
+{
+    _context->Draw(vertexCount, startVertex);
+}
+
+void D3D11RhiCommandList::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+    _context->DrawIndexed(indexCount, startIndex, baseVertex);
+}
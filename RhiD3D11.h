@@ -0,0 +1,60 @@
+#pragma once
+
+#include <windows.h>
+#include <d3d11_1.h>
+
+#include "Rhi.h"
+
+using namespace std;
+
+// issues commands straight on a D3D11 context. nothing is cached, so code that still
+// uses the context directly can be mixed in freely
+class D3D11RhiCommandList : public RhiCommandList
+{
+public:
+	D3D11RhiCommandList();
+
+	void SetContext(ID3D11DeviceContext* context) { _context = context; }
+
+	void SetPipelineState(RhiPipelineState* state) override;
+	void SetVertexBuffer(uint32_t slot, RhiBuffer* buffer, uint32_t offset) override;
+	void SetIndexBuffer(RhiBuffer* buffer, uint32_t offset) override;
+	void SetConstantBuffer(RhiShaderStage stage, uint32_t slot, RhiBuffer* buffer) override;
+	void SetTexture(RhiShaderStage stage, uint32_t slot, RhiTexture* texture) override;
+	void UpdateBuffer(RhiBuffer* buffer, const void* data, uint32_t bytes) override;
+
+	void Draw(uint32_t vertexCount, uint32_t startVertex) override;
+	void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override;
+
+private:
+	ID3D11DeviceContext* _context;
+};
+
+// the RHI on a D3D11 device. objects the app made itself can be wrapped, so passes move
+// over one at a time, and every object holds a reference to what it wraps
+class D3D11RhiDevice : public RhiDevice
+{
+public:
+	D3D11RhiDevice();
+
+	// takes no references, device and context have to outlive every use of this
+	void Init(ID3D11Device* device, ID3D11DeviceContext* context);
+
+	RhiBuffer* CreateBuffer(const RhiBufferDesc& desc, const void* initialData) override;
+	RhiTexture* CreateTexture(const RhiTextureDesc& desc, const RhiSubresourceData* initialData) override;
+	RhiShader* CreateShader(const RhiShaderDesc& desc) override;
+	RhiPipelineState* CreatePipelineState(const RhiPipelineStateDesc& desc) override;
+	RhiCommandList* GetImmediateCommandList() override { return &_commandList; }
+
+	// the stride of an index buffer picks R16_UINT or R32_UINT
+	RhiBuffer* WrapBuffer(ID3D11Buffer* buffer, RhiBufferKind kind, UINT stride);
+	// pipeline states build their input layout from the vertex shader's bytecode
+	RhiShader* WrapVertexShader(ID3D11VertexShader* shader, const void* bytecode, size_t bytes);
+	RhiShader* WrapPixelShader(ID3D11PixelShader* shader);
+	// the view has to be of a 2D texture or texture array
+	RhiTexture* WrapTexture(ID3D11ShaderResourceView* view);
+
+private:
+	ID3D11Device* _device;
+	D3D11RhiCommandList _commandList;
+};
@@ -0,0 +1,418 @@
+#include "RhiNull.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+//--------------------------------------------------------------------------------------
+// Objects, they only keep their descriptions and take themselves off the live counts
+//--------------------------------------------------------------------------------------
+class NullRhiBuffer : public RhiBuffer
+{
+public:
+    NullRhiBuffer(const RhiBufferDesc& desc, RhiNullStats* stats)
+    {
+        _desc = desc;
+        _stats = stats;
+        _stats->Buffers++;
+        _stats->BufferBytes += desc.Bytes;
+    }
+
+    ~NullRhiBuffer()
+    {
+        _stats->Buffers--;
+        _stats->BufferBytes -= _desc.Bytes;
+    }
+
+private:
+    RhiNullStats* _stats;
+};
+
+class NullRhiTexture : public RhiTexture
+{
+public:
+    NullRhiTexture(const RhiTextureDesc& desc, uint64_t bytes, RhiNullStats* stats)
+    {
+        _desc = desc;
+        _bytes = bytes;
+        _stats = stats;
+        _stats->Textures++;
+        _stats->TextureBytes += bytes;
+    }
+
+    ~NullRhiTexture()
+    {
+        _stats->Textures--;
+        _stats->TextureBytes -= _bytes;
+    }
+
+private:
+    uint64_t _bytes;
+    RhiNullStats* _stats;
+};
+
+class NullRhiShader : public RhiShader
+{
+public:
+    NullRhiShader(RhiShaderStage stage, RhiNullStats* stats)
+    {
+        _stage = stage;
+        _stats = stats;
+        _stats->Shaders++;
+    }
+
+    ~NullRhiShader()
+    {
+        _stats->Shaders--;
+    }
+
+private:
+    RhiNullStats* _stats;
+};
+
+class NullRhiPipelineState : public RhiPipelineState
+{
+public:
+    NullRhiPipelineState(const RhiPipelineStateDesc& desc, RhiNullStats* stats)
+    {
+        _desc = desc;
+        _stats = stats;
+        _stats->PipelineStates++;
+    }
+
+    ~NullRhiPipelineState()
+    {
+        _stats->PipelineStates--;
+    }
+
+private:
+    RhiNullStats* _stats;
+};
+
+//--------------------------------------------------------------------------------------
+// Device
+//--------------------------------------------------------------------------------------
+NullRhiDevice::NullRhiDevice()
+    : _commandList(this)
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+void NullRhiDevice::ResetCommandStats()
+{
+    _stats.Draws = 0;
+    _stats.Primitives = 0;
+    _stats.StateChanges = 0;
+    _stats.RedundantStateChanges = 0;
+    _stats.Updates = 0;
+    _stats.UploadBytes = 0;
+}
+
+void NullRhiDevice::Fail(const char* format, ...)
+{
+    _stats.Errors++;
+
+    if (_firstError.empty())
+    {
+        char message[256];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(message, sizeof(message), format, args);
+        va_end(args);
+        _firstError = message;
+    }
+}
+
+RhiBuffer* NullRhiDevice::CreateBuffer(const RhiBufferDesc& desc, const void* initialData)
+{
+    (void)initialData;
+
+    if (desc.Bytes == 0)
+    {
+        Fail("CreateBuffer: no bytes");
+        return nullptr;
+    }
+
+    switch (desc.Kind)
+    {
+    case RHI_BUFFER_VERTEX:
+        if (desc.Stride == 0 || desc.Bytes % desc.Stride != 0)
+        {
+            Fail("CreateBuffer: %u bytes isn't a whole number of %u byte vertices", desc.Bytes, desc.Stride);
+            return nullptr;
+        }
+        break;
+    case RHI_BUFFER_INDEX:
+        if ((desc.Stride != 2 && desc.Stride != 4) || desc.Bytes % desc.Stride != 0)
+        {
+            Fail("CreateBuffer: index stride %u with %u bytes", desc.Stride, desc.Bytes);
+            return nullptr;
+        }
+        break;
+    case RHI_BUFFER_CONSTANT:
+        if (desc.Bytes % 16 != 0 || desc.Bytes > RHI_MAX_CONSTANT_BUFFER_BYTES)
+        {
+            Fail("CreateBuffer: a %u byte constant buffer isn't whole registers under 64K", desc.Bytes);
+            return nullptr;
+        }
+        break;
+    default:
+        Fail("CreateBuffer: unknown kind %d", (int)desc.Kind);
+        return nullptr;
+    }
+
+    return new NullRhiBuffer(desc, &_stats);
+}
+
+RhiTexture* NullRhiDevice::CreateTexture(const RhiTextureDesc& desc, const RhiSubresourceData* initialData)
+{
+    if (desc.Width == 0 || desc.Height == 0 || desc.ArraySize == 0)
+    {
+        Fail("CreateTexture: %ux%u with %u slices", desc.Width, desc.Height, desc.ArraySize);
+        return nullptr;
+    }
+
+    if (GetRhiSurfaceBytes(desc.Format, 1, 1) == 0)
+    {
+        Fail("CreateTexture: unknown format %u", (unsigned)desc.Format);
+        return nullptr;
+    }
+
+    uint32_t fullChain = 1;
+    for (uint32_t size = desc.Width > desc.Height ? desc.Width : desc.Height; size > 1; size >>= 1)
+        fullChain++;
+
+    if (desc.MipLevels == 0 || desc.MipLevels > fullChain)
+    {
+        Fail("CreateTexture: %u mips for %ux%u", desc.MipLevels, desc.Width, desc.Height);
+        return nullptr;
+    }
+
+    uint64_t bytes = 0;
+    for (uint32_t mip = 0; mip < desc.MipLevels; ++mip)
+    {
+        uint32_t width = desc.Width >> mip ? desc.Width >> mip : 1;
+        uint32_t height = desc.Height >> mip ? desc.Height >> mip : 1;
+        bytes += GetRhiSurfaceBytes(desc.Format, width, height);
+
+        if (!initialData)
+            continue;
+
+        uint64_t rowBytes = GetRhiSurfaceBytes(desc.Format, width, 1);
+        for (uint32_t slice = 0; slice < desc.ArraySize; ++slice)
+        {
+            const RhiSubresourceData& data = initialData[slice * desc.MipLevels + mip];
+            if (!data.Data || data.RowPitch < rowBytes)
+            {
+                Fail("CreateTexture: slice %u mip %u has no data or a %u byte pitch", slice, mip, data.RowPitch);
+                return nullptr;
+            }
+        }
+    }
+
+    return new NullRhiTexture(desc, bytes * desc.ArraySize, &_stats);
+}
+
+RhiShader* NullRhiDevice::CreateShader(const RhiShaderDesc& desc)
+{
+    if (desc.Stage >= RHI_STAGE_COUNT)
+    {
+        Fail("CreateShader: unknown stage %d", (int)desc.Stage);
+        return nullptr;
+    }
+
+    if (!desc.Bytecode || desc.Bytes == 0)
+    {
+        Fail("CreateShader: no bytecode");
+        return nullptr;
+    }
+
+    return new NullRhiShader(desc.Stage, &_stats);
+}
+
+RhiPipelineState* NullRhiDevice::CreatePipelineState(const RhiPipelineStateDesc& desc)
+{
+    if (!desc.VertexShader || desc.VertexShader->GetStage() != RHI_STAGE_VERTEX)
+    {
+        Fail("CreatePipelineState: no vertex shader");
+        return nullptr;
+    }
+
+    // no pixel shader is fine, for depth only passes
+    if (desc.PixelShader && desc.PixelShader->GetStage() != RHI_STAGE_PIXEL)
+    {
+        Fail("CreatePipelineState: the pixel shader is for another stage");
+        return nullptr;
+    }
+
+    if (desc.ElementCount == 0 || desc.ElementCount > RHI_MAX_VERTEX_ELEMENTS)
+    {
+        Fail("CreatePipelineState: %u vertex elements", desc.ElementCount);
+        return nullptr;
+    }
+
+    for (uint32_t i = 0; i < desc.ElementCount; ++i)
+    {
+        const RhiVertexElement& element = desc.Elements[i];
+        if (!element.Semantic || GetRhiSurfaceBytes(element.Format, 1, 1) == 0)
+        {
+            Fail("CreatePipelineState: vertex element %u has no semantic or an unknown format", i);
+            return nullptr;
+        }
+    }
+
+    return new NullRhiPipelineState(desc, &_stats);
+}
+
+//--------------------------------------------------------------------------------------
+// Command list
+//--------------------------------------------------------------------------------------
+NullRhiCommandList::NullRhiCommandList(NullRhiDevice* device)
+{
+    _device = device;
+    ClearState();
+}
+
+void NullRhiCommandList::ClearState()
+{
+    _pipelineState = nullptr;
+    _indexBuffer = nullptr;
+    _indexOffset = 0;
+    memset(_vertexBuffers, 0, sizeof(_vertexBuffers));
+    memset(_vertexOffsets, 0, sizeof(_vertexOffsets));
+    memset(_constantBuffers, 0, sizeof(_constantBuffers));
+    memset(_textures, 0, sizeof(_textures));
+}
+
+void NullRhiCommandList::CountSet(bool changed)
+{
+    _device->_stats.StateChanges++;
+    if (!changed)
+        _device->_stats.RedundantStateChanges++;
+}
+
+void NullRhiCommandList::SetPipelineState(RhiPipelineState* state)
+{
+    CountSet(state != _pipelineState);
+    _pipelineState = state;
+}
+
+void NullRhiCommandList::SetVertexBuffer(uint32_t slot, RhiBuffer* buffer, uint32_t offset)
+{
+    if (slot >= RHI_MAX_VERTEX_BUFFERS)
+    {
+        _device->Fail("SetVertexBuffer: slot %u", slot);
+        return;
+    }
+
+    if (buffer && (buffer->GetDesc().Kind != RHI_BUFFER_VERTEX || offset >= buffer->GetDesc().Bytes))
+    {
+        _device->Fail("SetVertexBuffer: not a vertex buffer, or offset %u past its end", offset);
+        return;
+    }
+
+    CountSet(buffer != _vertexBuffers[slot] || offset != _vertexOffsets[slot]);
+    _vertexBuffers[slot] = buffer;
+    _vertexOffsets[slot] = offset;
+}
+
+void NullRhiCommandList::SetIndexBuffer(RhiBuffer* buffer, uint32_t offset)
+{
+    if (buffer && (buffer->GetDesc().Kind != RHI_BUFFER_INDEX || offset >= buffer->GetDesc().Bytes))
+    {
+        _device->Fail("SetIndexBuffer: not an index buffer, or offset %u past its end", offset);
+        return;
+    }
+
+    CountSet(buffer != _indexBuffer || offset != _indexOffset);
+    _indexBuffer = buffer;
+    _indexOffset = offset;
+}
+
+void NullRhiCommandList::SetConstantBuffer(RhiShaderStage stage, uint32_t slot, RhiBuffer* buffer)
+{
+    if (stage >= RHI_STAGE_COUNT || slot >= RHI_MAX_CONSTANT_BUFFERS)
+    {
+        _device->Fail("SetConstantBuffer: stage %d slot %u", (int)stage, slot);
+        return;
+    }
+
+    if (buffer && buffer->GetDesc().Kind != RHI_BUFFER_CONSTANT)
+    {
+        _device->Fail("SetConstantBuffer: not a constant buffer");
+        return;
+    }
+
+    CountSet(buffer != _constantBuffers[stage][slot]);
+    _constantBuffers[stage][slot] = buffer;
+}
+
+void NullRhiCommandList::SetTexture(RhiShaderStage stage, uint32_t slot, RhiTexture* texture)
+{
+    if (stage >= RHI_STAGE_COUNT || slot >= RHI_MAX_TEXTURES)
+    {
+        _device->Fail("SetTexture: stage %d slot %u", (int)stage, slot);
+        return;
+    }
+
+    CountSet(texture != _textures[stage][slot]);
+    _textures[stage][slot] = texture;
+}
+
+void NullRhiCommandList::UpdateBuffer(RhiBuffer* buffer, const void* data, uint32_t bytes)
+{
+    if (!buffer || !data)
+    {
+        _device->Fail("UpdateBuffer: no buffer or no data");
+        return;
+    }
+
+    const RhiBufferDesc& desc = buffer->GetDesc();
+    if (bytes > desc.Bytes || (desc.Kind == RHI_BUFFER_CONSTANT && bytes != desc.Bytes))
+    {
+        _device->Fail("UpdateBuffer: %u bytes into a %u byte buffer", bytes, desc.Bytes);
+        return;
+    }
+
+    _device->_stats.Updates++;
+    _device->_stats.UploadBytes += bytes;
+}
+
+void NullRhiCommandList::Draw(uint32_t vertexCount, uint32_t startVertex)
+{
+    if (!_pipelineState || !_vertexBuffers[0])
+    {
+        _device->Fail("Draw: no pipeline state or vertex buffer");
+        return;
+    }
+
+    const RhiBufferDesc& desc = _vertexBuffers[0]->GetDesc();
+    if (((uint64_t)startVertex + vertexCount) * desc.Stride + _vertexOffsets[0] > desc.Bytes)
+    {
+        _device->Fail("Draw: vertices %u to %u are past the end of the buffer", startVertex, startVertex + vertexCount);
+        return;
+    }
+
+    _device->_stats.Draws++;
+    _device->_stats.Primitives += vertexCount / 3;
+}
+
+void NullRhiCommandList::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+    (void)baseVertex;
+
+    if (!_pipelineState || !_vertexBuffers[0] || !_indexBuffer)
+    {
+        _device->Fail("DrawIndexed: no pipeline state, vertex buffer or index buffer");
+        return;
+    }
+
+    const RhiBufferDesc& desc = _indexBuffer->GetDesc();
+    if (((uint64_t)startIndex + indexCount) * desc.Stride + _indexOffset > desc.Bytes)
+    {
+        _device->Fail("DrawIndexed: indices %u to %u are past the end of the buffer", startIndex, startIndex + indexCount);
+        return;
+    }
+
+    _device->_stats.Draws++;
+    _device->_stats.Primitives += indexCount / 3;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <string>
+
+#include "Rhi.h"
+
+using namespace std;
+
+struct RhiNullStats
+{
+	// objects alive and the memory they would take
+	uint64_t Buffers;
+	uint64_t Textures;
+	uint64_t Shaders;
+	uint64_t PipelineStates;
+	uint64_t BufferBytes;
+	uint64_t TextureBytes;
+
+	// work since the last ResetCommandStats
+	uint64_t Draws;
+	uint64_t Primitives;
+	uint64_t StateChanges;
+	// sets that bound what was bound already, included in StateChanges
+	uint64_t RedundantStateChanges;
+	uint64_t Updates;
+	uint64_t UploadBytes;
+
+	// creates and commands that failed validation, they did nothing else
+	uint64_t Errors;
+};
+
+class NullRhiDevice;
+
+class NullRhiCommandList : public RhiCommandList
+{
+public:
+	NullRhiCommandList(NullRhiDevice* device);
+
+	void SetPipelineState(RhiPipelineState* state) override;
+	void SetVertexBuffer(uint32_t slot, RhiBuffer* buffer, uint32_t offset) override;
+	void SetIndexBuffer(RhiBuffer* buffer, uint32_t offset) override;
+	void SetConstantBuffer(RhiShaderStage stage, uint32_t slot, RhiBuffer* buffer) override;
+	void SetTexture(RhiShaderStage stage, uint32_t slot, RhiTexture* texture) override;
+	void UpdateBuffer(RhiBuffer* buffer, const void* data, uint32_t bytes) override;
+
+	void Draw(uint32_t vertexCount, uint32_t startVertex) override;
+	void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override;
+
+	// unbinds everything, as a new frame on a real device would leave it undefined
+	void ClearState();
+
+private:
+	// counts a set and whether it changed anything
+	void CountSet(bool changed);
+
+	NullRhiDevice* _device;
+	RhiPipelineState* _pipelineState;
+	RhiBuffer* _vertexBuffers[RHI_MAX_VERTEX_BUFFERS];
+	uint32_t _vertexOffsets[RHI_MAX_VERTEX_BUFFERS];
+	RhiBuffer* _indexBuffer;
+	uint32_t _indexOffset;
+	RhiBuffer* _constantBuffers[RHI_STAGE_COUNT][RHI_MAX_CONSTANT_BUFFERS];
+	RhiTexture* _textures[RHI_STAGE_COUNT][RHI_MAX_TEXTURES];
+};
+
+// a device with nothing behind it: every create and command is checked the way the
+// D3D11 debug layer would and counted, nothing is drawn and buffer contents aren't kept.
+// objects have to be deleted before the device
+class NullRhiDevice : public RhiDevice
+{
+public:
+	NullRhiDevice();
+
+	RhiBuffer* CreateBuffer(const RhiBufferDesc& desc, const void* initialData) override;
+	RhiTexture* CreateTexture(const RhiTextureDesc& desc, const RhiSubresourceData* initialData) override;
+	RhiShader* CreateShader(const RhiShaderDesc& desc) override;
+	RhiPipelineState* CreatePipelineState(const RhiPipelineStateDesc& desc) override;
+	RhiCommandList* GetImmediateCommandList() override { return &_commandList; }
+
+	const RhiNullStats& GetStats() const { return _stats; }
+	void ResetCommandStats();
+	// what the first failed validation was about, empty when nothing has failed
+	const string& GetFirstError() const { return _firstError; }
+
+private:
+	friend class NullRhiCommandList;
+
+	// counts an error and keeps its message if it's the first
+	void Fail(const char* format, ...);
+
+	NullRhiCommandList _commandList;
+	RhiNullStats _stats;
+	string _firstError;
+};
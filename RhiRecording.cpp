@@ -0,0 +1,99 @@
+#include "RhiRecording.h"
+
+void RecordingRhiCommandList::Add(Op op, void* object, uint32_t arg0, uint32_t arg1, uint32_t arg2)
+{
+    Command command;
+    command.op = op;
+    command.args[0] = arg0;
+    command.args[1] = arg1;
+    command.args[2] = arg2;
+    command.object = object;
+    _commands.push_back(command);
+}
+
+void RecordingRhiCommandList::SetPipelineState(RhiPipelineState* state)
+{
+    Add(OP_SET_PIPELINE_STATE, state, 0);
+}
+
+void RecordingRhiCommandList::SetVertexBuffer(uint32_t slot, RhiBuffer* buffer, uint32_t offset)
+{
+    Add(OP_SET_VERTEX_BUFFER, buffer, slot, offset);
+}
+
+void RecordingRhiCommandList::SetIndexBuffer(RhiBuffer* buffer, uint32_t offset)
+{
+    Add(OP_SET_INDEX_BUFFER, buffer, offset);
+}
+
+void RecordingRhiCommandList::SetConstantBuffer(RhiShaderStage stage, uint32_t slot, RhiBuffer* buffer)
+{
+    Add(OP_SET_CONSTANT_BUFFER, buffer, stage, slot);
+}
+
+void RecordingRhiCommandList::SetTexture(RhiShaderStage stage, uint32_t slot, RhiTexture* texture)
+{
+    Add(OP_SET_TEXTURE, texture, stage, slot);
+}
+
+void RecordingRhiCommandList::UpdateBuffer(RhiBuffer* buffer, const void* data, uint32_t bytes)
+{
+    size_t offset = _data.size();
+    if (data)
+        _data.insert(_data.end(), (const uint8_t*)data, (const uint8_t*)data + bytes);
+
+    // no data stays no data so the target sees the same call
+    Add(OP_UPDATE_BUFFER, buffer, (uint32_t)offset, data ? bytes : 0, data ? 1 : 0);
+}
+
+void RecordingRhiCommandList::Draw(uint32_t vertexCount, uint32_t startVertex)
+{
+    Add(OP_DRAW, nullptr, vertexCount, startVertex);
+}
+
+void RecordingRhiCommandList::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+    Add(OP_DRAW_INDEXED, nullptr, indexCount, startIndex, (uint32_t)baseVertex);
+}
+
+void RecordingRhiCommandList::Execute(RhiCommandList& target) const
+{
+    for (const Command& command : _commands)
+    {
+        const uint32_t* args = command.args;
+
+        switch (command.op)
+        {
+        case OP_SET_PIPELINE_STATE:
+            target.SetPipelineState(static_cast<RhiPipelineState*>(command.object));
+            break;
+        case OP_SET_VERTEX_BUFFER:
+            target.SetVertexBuffer(args[0], static_cast<RhiBuffer*>(command.object), args[1]);
+            break;
+        case OP_SET_INDEX_BUFFER:
+            target.SetIndexBuffer(static_cast<RhiBuffer*>(command.object), args[0]);
+            break;
+        case OP_SET_CONSTANT_BUFFER:
+            target.SetConstantBuffer((RhiShaderStage)args[0], args[1], static_cast<RhiBuffer*>(command.object));
+            break;
+        case OP_SET_TEXTURE:
+            target.SetTexture((RhiShaderStage)args[0], args[1], static_cast<RhiTexture*>(command.object));
+            break;
+        case OP_UPDATE_BUFFER:
+            target.UpdateBuffer(static_cast<RhiBuffer*>(command.object), args[2] ? _data.data() + args[0] : nullptr, args[1]);
+            break;
+        case OP_DRAW:
+            target.Draw(args[0], args[1]);
+            break;
+        case OP_DRAW_INDEXED:
+            target.DrawIndexed(args[0], args[1], (int32_t)args[2]);
+            break;
+        }
+    }
+}
+
+void RecordingRhiCommandList::Reset()
+{
+    _commands.clear();
+    _data.clear();
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+
+#include "Rhi.h"
+
+using namespace std;
+
+// keeps commands to replay on another command list later, like a deferred context: jobs
+// can each record a list of their own and the main thread executes them in order, and
+// recording needs no device so it can be timed on its own. UpdateBuffer copies the data,
+// everything else is kept by pointer so the objects have to outlive the recording
+class RecordingRhiCommandList : public RhiCommandList
+{
+public:
+	void SetPipelineState(RhiPipelineState* state) override;
+	void SetVertexBuffer(uint32_t slot, RhiBuffer* buffer, uint32_t offset) override;
+	void SetIndexBuffer(RhiBuffer* buffer, uint32_t offset) override;
+	void SetConstantBuffer(RhiShaderStage stage, uint32_t slot, RhiBuffer* buffer) override;
+	void SetTexture(RhiShaderStage stage, uint32_t slot, RhiTexture* texture) override;
+	void UpdateBuffer(RhiBuffer* buffer, const void* data, uint32_t bytes) override;
+
+	void Draw(uint32_t vertexCount, uint32_t startVertex) override;
+	void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override;
+
+	// issues everything recorded on target, the recording is kept and can run again
+	void Execute(RhiCommandList& target) const;
+	// forgets the commands, the memory is kept for the next recording
+	void Reset();
+
+	size_t GetCommandCount() const { return _commands.size(); }
+	size_t GetDataBytes() const { return _data.size(); }
+
+private:
+	enum Op
+	{
+		OP_SET_PIPELINE_STATE,
+		OP_SET_VERTEX_BUFFER,
+		OP_SET_INDEX_BUFFER,
+		OP_SET_CONSTANT_BUFFER,
+		OP_SET_TEXTURE,
+		OP_UPDATE_BUFFER,
+		OP_DRAW,
+		OP_DRAW_INDEXED,
+	};
+
+	// the arguments in the order the call takes them, UpdateBuffer's data is an offset
+	// into _data and its size
+	struct Command
+	{
+		Op op;
+		uint32_t args[3];
+		void* object;
+	};
+
+	void Add(Op op, void* object, uint32_t arg0, uint32_t arg1 = 0, uint32_t arg2 = 0);
+
+	vector<Command> _commands;
+	vector<uint8_t> _data;
+};
@@ -0,0 +1,417 @@
+#include "RhiSoftware.h"
+
+#include <string.h>
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------
+// Objects, everything lives in system memory
+//--------------------------------------------------------------------------------------
+class SoftwareRhiBuffer : public RhiBuffer
+{
+public:
+    SoftwareRhiBuffer(const RhiBufferDesc& desc, const void* initialData, uint64_t version)
+    {
+        _desc = desc;
+        if (initialData)
+            _data.assign((const uint8_t*)initialData, (const uint8_t*)initialData + desc.Bytes);
+        else
+            _data.assign(desc.Bytes, 0);
+        _version = version;
+    }
+
+    vector<uint8_t> _data;
+    uint64_t _version;
+};
+
+class SoftwareRhiTexture : public RhiTexture
+{
+public:
+    SoftwareRhiTexture(const RhiTextureDesc& desc)
+    {
+        _desc = desc;
+    }
+
+    SoftwareTexture _texture;
+};
+
+class SoftwareRhiShader : public RhiShader
+{
+public:
+    SoftwareRhiShader(RhiShaderStage stage)
+    {
+        _stage = stage;
+        _vertexShader = nullptr;
+        _pixelShader = nullptr;
+        _varyingCount = 0;
+        _texCoordVarying = -1;
+    }
+
+    SoftwareVertexShader _vertexShader;
+    SoftwarePixelShader _pixelShader;
+    uint32_t _varyingCount;
+    int32_t _texCoordVarying;
+};
+
+// copies what it needs from the shaders, they can be deleted once it's made
+class SoftwareRhiPipelineState : public RhiPipelineState
+{
+public:
+    SoftwareRhiPipelineState(const RhiPipelineStateDesc& desc)
+    {
+        _desc = desc;
+        _vertexShader = nullptr;
+        _pixelShader = nullptr;
+        _varyingCount = 0;
+        _texCoordVarying = -1;
+        _vertexBytes = 0;
+    }
+
+    SoftwareVertexShader _vertexShader;
+    SoftwarePixelShader _pixelShader;
+    uint32_t _varyingCount;
+    int32_t _texCoordVarying;
+    uint32_t _elementOffsets[RHI_MAX_VERTEX_ELEMENTS];
+    // how far into a vertex the elements reach
+    uint32_t _vertexBytes;
+};
+
+static uint32_t ReadIndex(const uint8_t* indices, uint32_t indexBytes, uint32_t i)
+{
+    if (indexBytes == 4)
+    {
+        uint32_t index;
+        memcpy(&index, indices + i * 4, 4);
+        return index;
+    }
+
+    uint16_t index;
+    memcpy(&index, indices + i * 2, 2);
+    return index;
+}
+
+//--------------------------------------------------------------------------------------
+// Device
+//--------------------------------------------------------------------------------------
+SoftwareRhiDevice::SoftwareRhiDevice()
+    : _commandList(this)
+{
+    _nextVersion = 0;
+}
+
+bool SoftwareRhiDevice::Init(uint32_t width, uint32_t height, JobSystem* jobs)
+{
+    return _rasterizer.Init(width, height, jobs);
+}
+
+RhiBuffer* SoftwareRhiDevice::CreateBuffer(const RhiBufferDesc& desc, const void* initialData)
+{
+    if (desc.Bytes == 0)
+        return nullptr;
+
+    return new SoftwareRhiBuffer(desc, initialData, ++_nextVersion);
+}
+
+RhiTexture* SoftwareRhiDevice::CreateTexture(const RhiTextureDesc& desc, const RhiSubresourceData* initialData)
+{
+    bool bgra = desc.Format == RHI_FORMAT_B8G8R8A8_UNORM;
+    if ((desc.Format != RHI_FORMAT_R8G8B8A8_UNORM && !bgra) || desc.Width == 0 || desc.Height == 0 ||
+        desc.MipLevels == 0 || desc.ArraySize == 0)
+        return nullptr;
+
+    SoftwareRhiTexture* result = new SoftwareRhiTexture(desc);
+    SoftwareTexture& texture = result->_texture;
+    texture.Width = desc.Width;
+    texture.Height = desc.Height;
+    texture.MipLevels = desc.MipLevels;
+    texture.ArraySize = desc.ArraySize;
+
+    size_t texels = 0;
+    for (uint32_t slice = 0; slice < desc.ArraySize; ++slice)
+    {
+        for (uint32_t mip = 0; mip < desc.MipLevels; ++mip)
+        {
+            texture.Offsets.push_back(texels);
+            texels += (size_t)max(desc.Width >> mip, 1u) * max(desc.Height >> mip, 1u);
+        }
+    }
+    texture.Texels.assign(texels, 0);
+
+    if (!initialData)
+        return result;
+
+    for (uint32_t i = 0; i < desc.MipLevels * desc.ArraySize; ++i)
+    {
+        uint32_t mip = i % desc.MipLevels;
+        uint32_t width = max(desc.Width >> mip, 1u);
+        uint32_t height = max(desc.Height >> mip, 1u);
+        uint32_t* destination = &texture.Texels[texture.Offsets[i]];
+
+        for (uint32_t y = 0; y < height; ++y, destination += width)
+        {
+            memcpy(destination, (const uint8_t*)initialData[i].Data + (size_t)y * initialData[i].RowPitch, width * sizeof(uint32_t));
+
+            // The samplers read R from the low byte
+            if (bgra)
+            {
+                for (uint32_t x = 0; x < width; ++x)
+                    destination[x] = (destination[x] & 0xff00ff00) | ((destination[x] >> 16) & 0xff) | ((destination[x] & 0xff) << 16);
+            }
+        }
+    }
+
+    return result;
+}
+
+RhiShader* SoftwareRhiDevice::CreateShader(const RhiShaderDesc&)
+{
+    return nullptr;
+}
+
+RhiPipelineState* SoftwareRhiDevice::CreatePipelineState(const RhiPipelineStateDesc& desc)
+{
+    SoftwareRhiShader* vertexShader = static_cast<SoftwareRhiShader*>(desc.VertexShader);
+    SoftwareRhiShader* pixelShader = static_cast<SoftwareRhiShader*>(desc.PixelShader);
+    if (!vertexShader || !vertexShader->_vertexShader || (pixelShader && !pixelShader->_pixelShader) ||
+        desc.ElementCount > RHI_MAX_VERTEX_ELEMENTS || desc.Fill != RHI_FILL_SOLID)
+        return nullptr;
+
+    SoftwareRhiPipelineState* state = new SoftwareRhiPipelineState(desc);
+    state->_vertexShader = vertexShader->_vertexShader;
+    state->_varyingCount = vertexShader->_varyingCount;
+    state->_texCoordVarying = vertexShader->_texCoordVarying;
+    if (pixelShader)
+        state->_pixelShader = pixelShader->_pixelShader;
+
+    // Append aligned elements go straight after the one before, as in a D3D input layout
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < desc.ElementCount; ++i)
+    {
+        uint32_t bytes = (uint32_t)GetRhiSurfaceBytes(desc.Elements[i].Format, 1, 1);
+        if (bytes == 0)
+        {
+            delete state;
+            return nullptr;
+        }
+
+        if (desc.Elements[i].Offset != RHI_APPEND_ALIGNED)
+            offset = desc.Elements[i].Offset;
+
+        state->_elementOffsets[i] = offset;
+        offset += bytes;
+        state->_vertexBytes = max(state->_vertexBytes, offset);
+    }
+
+    return state;
+}
+
+RhiShader* SoftwareRhiDevice::CreateVertexShader(SoftwareVertexShader shader, uint32_t varyingCount, int32_t texCoordVarying)
+{
+    if (!shader || varyingCount > SOFTWARE_MAX_VARYINGS)
+        return nullptr;
+
+    SoftwareRhiShader* result = new SoftwareRhiShader(RHI_STAGE_VERTEX);
+    result->_vertexShader = shader;
+    result->_varyingCount = varyingCount;
+    result->_texCoordVarying = texCoordVarying;
+    return result;
+}
+
+RhiShader* SoftwareRhiDevice::CreatePixelShader(SoftwarePixelShader shader)
+{
+    if (!shader)
+        return nullptr;
+
+    SoftwareRhiShader* result = new SoftwareRhiShader(RHI_STAGE_PIXEL);
+    result->_pixelShader = shader;
+    return result;
+}
+
+//--------------------------------------------------------------------------------------
+// Command list
+//--------------------------------------------------------------------------------------
+SoftwareRhiCommandList::SoftwareRhiCommandList(SoftwareRhiDevice* device)
+{
+    _device = device;
+    _pipelineState = nullptr;
+    _vertexBuffer = nullptr;
+    _vertexOffset = 0;
+    _indexBuffer = nullptr;
+    _indexOffset = 0;
+    memset(_constantBuffers, 0, sizeof(_constantBuffers));
+    memset(_textures, 0, sizeof(_textures));
+    memset(_constantCopies, 0, sizeof(_constantCopies));
+    memset(_constantCopyVersions, 0, sizeof(_constantCopyVersions));
+    _constantCopyFrame = 0;
+}
+
+void SoftwareRhiCommandList::SetPipelineState(RhiPipelineState* state)
+{
+    _pipelineState = state;
+}
+
+void SoftwareRhiCommandList::SetVertexBuffer(uint32_t slot, RhiBuffer* buffer, uint32_t offset)
+{
+    // Pipeline states only read slot 0
+    if (slot != 0)
+        return;
+
+    _vertexBuffer = buffer;
+    _vertexOffset = offset;
+}
+
+void SoftwareRhiCommandList::SetIndexBuffer(RhiBuffer* buffer, uint32_t offset)
+{
+    _indexBuffer = buffer;
+    _indexOffset = offset;
+}
+
+void SoftwareRhiCommandList::SetConstantBuffer(RhiShaderStage stage, uint32_t slot, RhiBuffer* buffer)
+{
+    if (stage < RHI_STAGE_COUNT && slot < RHI_MAX_CONSTANT_BUFFERS)
+        _constantBuffers[stage][slot] = buffer;
+}
+
+void SoftwareRhiCommandList::SetTexture(RhiShaderStage stage, uint32_t slot, RhiTexture* texture)
+{
+    if (stage < RHI_STAGE_COUNT && slot < RHI_MAX_TEXTURES)
+        _textures[stage][slot] = texture;
+}
+
+void SoftwareRhiCommandList::UpdateBuffer(RhiBuffer* buffer, const void* data, uint32_t bytes)
+{
+    SoftwareRhiBuffer* target = static_cast<SoftwareRhiBuffer*>(buffer);
+    if (!target || !data)
+        return;
+
+    memcpy(target->_data.data(), data, min(bytes, (uint32_t)target->_data.size()));
+    target->_version = ++_device->_nextVersion;
+}
+
+void SoftwareRhiCommandList::Draw(uint32_t vertexCount, uint32_t startVertex)
+{
+    DrawTriangles(nullptr, 0, vertexCount, startVertex, 0);
+}
+
+void SoftwareRhiCommandList::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+    SoftwareRhiBuffer* indices = static_cast<SoftwareRhiBuffer*>(_indexBuffer);
+    if (!indices)
+        return;
+
+    uint32_t indexBytes = indices->GetDesc().Stride == 4 ? 4 : 2;
+    if (_indexOffset + ((uint64_t)startIndex + indexCount) * indexBytes > indices->_data.size())
+        return;
+
+    DrawTriangles(indices->_data.data() + _indexOffset + (size_t)startIndex * indexBytes, indexBytes, indexCount, 0, baseVertex);
+}
+
+void SoftwareRhiCommandList::DrawTriangles(const uint8_t* indices, uint32_t indexBytes, uint32_t count, uint32_t first, int32_t baseVertex)
+{
+    SoftwareRhiPipelineState* state = static_cast<SoftwareRhiPipelineState*>(_pipelineState);
+    SoftwareRhiBuffer* vertices = static_cast<SoftwareRhiBuffer*>(_vertexBuffer);
+    if (!state || !vertices || count < 3)
+        return;
+
+    // The vertex shader runs once for each vertex from the lowest index to the highest
+    int64_t lowest = first;
+    int64_t highest = (int64_t)first + count - 1;
+    if (indices)
+    {
+        uint32_t lowestIndex = UINT32_MAX;
+        uint32_t highestIndex = 0;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            uint32_t index = ReadIndex(indices, indexBytes, i);
+            lowestIndex = min(lowestIndex, index);
+            highestIndex = max(highestIndex, index);
+        }
+
+        lowest = (int64_t)lowestIndex + baseVertex;
+        highest = (int64_t)highestIndex + baseVertex;
+    }
+
+    uint32_t stride = vertices->GetDesc().Stride;
+    if (lowest < 0 || _vertexOffset + (uint64_t)highest * stride + state->_vertexBytes > vertices->_data.size())
+        return;
+
+    SoftwareShaderResources vertexResources;
+    for (uint32_t slot = 0; slot < RHI_MAX_CONSTANT_BUFFERS; ++slot)
+    {
+        SoftwareRhiBuffer* buffer = static_cast<SoftwareRhiBuffer*>(_constantBuffers[RHI_STAGE_VERTEX][slot]);
+        vertexResources.ConstantBuffers[slot] = buffer ? buffer->_data.data() : nullptr;
+    }
+    for (uint32_t slot = 0; slot < RHI_MAX_TEXTURES; ++slot)
+    {
+        SoftwareRhiTexture* texture = static_cast<SoftwareRhiTexture*>(_textures[RHI_STAGE_VERTEX][slot]);
+        vertexResources.Textures[slot] = texture ? &texture->_texture : nullptr;
+    }
+
+    uint32_t vertexCount = (uint32_t)(highest - lowest + 1);
+    _vertices.resize(vertexCount);
+    const uint8_t* vertex = vertices->_data.data() + _vertexOffset + (size_t)lowest * stride;
+    for (uint32_t i = 0; i < vertexCount; ++i, vertex += stride)
+        state->_vertexShader(vertex, state->_elementOffsets, vertexResources, _vertices[i]);
+
+    const RhiPipelineStateDesc& desc = state->GetDesc();
+    SoftwareDrawState draw;
+    draw.PixelShader = state->_pixelShader;
+    draw.VaryingCount = state->_varyingCount;
+    draw.TexCoordVarying = state->_texCoordVarying;
+    draw.Cull = desc.Cull;
+    draw.DepthClip = desc.DepthClip;
+    draw.DepthTest = desc.DepthTest;
+    draw.DepthWrite = desc.DepthWrite;
+    CopyPixelConstants(draw.Resources);
+    for (uint32_t slot = 0; slot < RHI_MAX_TEXTURES; ++slot)
+    {
+        SoftwareRhiTexture* texture = static_cast<SoftwareRhiTexture*>(_textures[RHI_STAGE_PIXEL][slot]);
+        draw.Resources.Textures[slot] = texture ? &texture->_texture : nullptr;
+    }
+
+    SoftwareRasterizer& rasterizer = _device->_rasterizer;
+    uint32_t drawIndex = rasterizer.AddDraw(draw);
+
+    for (uint32_t i = 0; i + 2 < count; i += 3)
+    {
+        uint32_t corners[3];
+        for (uint32_t j = 0; j < 3; ++j)
+        {
+            int64_t index = indices ? (int64_t)ReadIndex(indices, indexBytes, i + j) + baseVertex : (int64_t)first + i + j;
+            corners[j] = (uint32_t)(index - lowest);
+        }
+
+        rasterizer.AddTriangle(drawIndex, _vertices[corners[0]], _vertices[corners[1]], _vertices[corners[2]]);
+    }
+}
+
+void SoftwareRhiCommandList::CopyPixelConstants(SoftwareShaderResources& resources)
+{
+    SoftwareRasterizer& rasterizer = _device->_rasterizer;
+
+    // Copies from before the last Flush went with its frame data
+    if (_constantCopyFrame != rasterizer.GetFrame())
+    {
+        memset(_constantCopyVersions, 0, sizeof(_constantCopyVersions));
+        _constantCopyFrame = rasterizer.GetFrame();
+    }
+
+    for (uint32_t slot = 0; slot < RHI_MAX_CONSTANT_BUFFERS; ++slot)
+    {
+        SoftwareRhiBuffer* buffer = static_cast<SoftwareRhiBuffer*>(_constantBuffers[RHI_STAGE_PIXEL][slot]);
+        if (!buffer)
+        {
+            resources.ConstantBuffers[slot] = nullptr;
+            continue;
+        }
+
+        if (_constantCopyVersions[slot] != buffer->_version)
+        {
+            void* copy = rasterizer.AllocateFrameData(buffer->_data.size());
+            memcpy(copy, buffer->_data.data(), buffer->_data.size());
+            _constantCopies[slot] = copy;
+            _constantCopyVersions[slot] = buffer->_version;
+        }
+
+        resources.ConstantBuffers[slot] = _constantCopies[slot];
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+
+#include "Rhi.h"
+#include "SoftwareRasterizer.h"
+
+using namespace std;
+
+class SoftwareRhiDevice;
+
+// runs the vertex shader and bins the triangles as each draw comes in, the pixels are
+// shaded when the device flushes. like the D3D11 backend nothing is validated, a draw
+// without the state it needs or that reads past its buffers is dropped, and the null
+// backend is the place to find out why
+class SoftwareRhiCommandList : public RhiCommandList
+{
+public:
+	SoftwareRhiCommandList(SoftwareRhiDevice* device);
+
+	void SetPipelineState(RhiPipelineState* state) override;
+	void SetVertexBuffer(uint32_t slot, RhiBuffer* buffer, uint32_t offset) override;
+	void SetIndexBuffer(RhiBuffer* buffer, uint32_t offset) override;
+	void SetConstantBuffer(RhiShaderStage stage, uint32_t slot, RhiBuffer* buffer) override;
+	void SetTexture(RhiShaderStage stage, uint32_t slot, RhiTexture* texture) override;
+	void UpdateBuffer(RhiBuffer* buffer, const void* data, uint32_t bytes) override;
+
+	void Draw(uint32_t vertexCount, uint32_t startVertex) override;
+	void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override;
+
+private:
+	// indices null for vertices first to first + count
+	void DrawTriangles(const uint8_t* indices, uint32_t indexBytes, uint32_t count, uint32_t first, int32_t baseVertex);
+	// copies of the pixel shader's constant buffers as they are now, a copy is shared by
+	// draws until its buffer is updated
+	void CopyPixelConstants(SoftwareShaderResources& resources);
+
+	SoftwareRhiDevice* _device;
+	RhiPipelineState* _pipelineState;
+	RhiBuffer* _vertexBuffer;
+	uint32_t _vertexOffset;
+	RhiBuffer* _indexBuffer;
+	uint32_t _indexOffset;
+	RhiBuffer* _constantBuffers[RHI_STAGE_COUNT][RHI_MAX_CONSTANT_BUFFERS];
+	RhiTexture* _textures[RHI_STAGE_COUNT][RHI_MAX_TEXTURES];
+
+	const void* _constantCopies[RHI_MAX_CONSTANT_BUFFERS];
+	uint64_t _constantCopyVersions[RHI_MAX_CONSTANT_BUFFERS];
+	uint64_t _constantCopyFrame;
+
+	vector<SoftwareVertex> _vertices;
+};
+
+// draws on the CPU with SoftwareRasterizer. HLSL bytecode can't run here so CreateShader
+// always fails, shaders are C++ functions given to CreateVertexShader and
+// CreatePixelShader instead. fill is solid only, textures are RGBA8 or BGRA8 and have to outlive the next
+// Flush of any draw that used them, buffers can go as soon as their draws are submitted
+class SoftwareRhiDevice : public RhiDevice
+{
+public:
+	SoftwareRhiDevice();
+
+	// jobs may be null to draw on the calling thread only
+	bool Init(uint32_t width, uint32_t height, JobSystem* jobs);
+
+	RhiBuffer* CreateBuffer(const RhiBufferDesc& desc, const void* initialData) override;
+	RhiTexture* CreateTexture(const RhiTextureDesc& desc, const RhiSubresourceData* initialData) override;
+	RhiShader* CreateShader(const RhiShaderDesc& desc) override;
+	RhiPipelineState* CreatePipelineState(const RhiPipelineStateDesc& desc) override;
+	RhiCommandList* GetImmediateCommandList() override { return &_commandList; }
+
+	// texCoordVarying is where the u of the uv the pixel shader samples with goes, or -1
+	RhiShader* CreateVertexShader(SoftwareVertexShader shader, uint32_t varyingCount, int32_t texCoordVarying);
+	RhiShader* CreatePixelShader(SoftwarePixelShader shader);
+
+	void Clear(const float colour[4], float depth) { _rasterizer.Clear(colour, depth); }
+	// shades everything submitted since the last Flush
+	void Flush() { _rasterizer.Flush(); }
+	const SoftwareRasterizer& GetRasterizer() const { return _rasterizer; }
+
+private:
+	friend class SoftwareRhiCommandList;
+
+	SoftwareRhiCommandList _commandList;
+	SoftwareRasterizer _rasterizer;
+	// every create and update takes the next one, so a changed buffer never looks unchanged
+	uint64_t _nextVersion;
+};
@@ -0,0 +1,97 @@
+#include "SceneAnimation.h"
+#include <math.h>
+#include <string.h>
+
+//--------------------------------------------------------------------------------------
+// Matrices as DirectXMath builds them, row vectors so the left one is applied first
+//--------------------------------------------------------------------------------------
+struct Matrix
+{
+    float m[4][4];
+};
+
+static Matrix operator*(const Matrix& a, const Matrix& b)
+{
+    Matrix result;
+    for (int row = 0; row < 4; ++row)
+    {
+        for (int column = 0; column < 4; ++column)
+        {
+            result.m[row][column] = a.m[row][0] * b.m[0][column] + a.m[row][1] * b.m[1][column] +
+                                    a.m[row][2] * b.m[2][column] + a.m[row][3] * b.m[3][column];
+        }
+    }
+    return result;
+}
+
+static Matrix Scaling(float s)
+{
+    Matrix result = { { { s, 0, 0, 0 }, { 0, s, 0, 0 }, { 0, 0, s, 0 }, { 0, 0, 0, 1 } } };
+    return result;
+}
+
+static Matrix Translation(float x, float y, float z)
+{
+    Matrix result = { { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { x, y, z, 1 } } };
+    return result;
+}
+
+// XMMatrixRotationRollPitchYaw: roll about z, then pitch about x, then yaw about y
+static Matrix RotationRollPitchYaw(float pitch, float yaw, float roll)
+{
+    float cp = cosf(pitch), sp = sinf(pitch);
+    float cy = cosf(yaw), sy = sinf(yaw);
+    float cr = cosf(roll), sr = sinf(roll);
+
+    Matrix result = { { { cr * cy + sr * sp * sy, sr * cp, sr * sp * cy - cr * sy, 0 },
+                        { cr * sp * sy - sr * cy, cr * cp, sr * sy + cr * sp * cy, 0 },
+                        { cp * sy, -sp, cp * cy, 0 },
+                        { 0, 0, 0, 1 } } };
+    return result;
+}
+
+static void Store(const Matrix& matrix, float* worldMatrices, uint32_t body)
+{
+    memcpy(worldMatrices + body * 16, matrix.m, sizeof(matrix.m));
+}
+
+//--------------------------------------------------------------------------------------
+void AnimateBodies(float t, float* worldMatrices, uint32_t bodyCount)
+{
+    if (bodyCount < NAMED_BODY_COUNT)
+        return;
+
+    Matrix sun = Scaling(3) * Translation(0, 0, 0) * RotationRollPitchYaw(t*10, t*10, t*10);
+    Store(sun, worldMatrices, 0);
+
+    Matrix mars = RotationRollPitchYaw(t * 4, 0, 0) * Scaling(.6f) * Translation(6, 0, 0) * RotationRollPitchYaw(0, t*5, 0);
+    Store(mars, worldMatrices, 1);
+
+    Matrix earth = RotationRollPitchYaw(0, 0, t * 6) * Scaling(.8f) * Translation(9, 0, 0) * RotationRollPitchYaw(0, t * 3.5f, 0);
+    Store(earth, worldMatrices, 2);
+
+    //translation are done backwards, so you would read the first to be the last
+    //scale the moon translate the moon to its position relative to the earth, allow the moon to rotate around the earth,
+    //translate the mmon to the position of the eath and allow the same rotation (so it follows the earths rotatrion around the sun)
+    Matrix earthMoon = Scaling(.125f) * Translation(3,0,0) * RotationRollPitchYaw(0, t*2, t * 3) * Translation(9, 0, 0) *
+        RotationRollPitchYaw(0, t * 3.5f, 0);
+    Store(earthMoon, worldMatrices, 3);
+
+    Matrix marsMoon = Scaling(.1f) * Translation(3, 0, 0) * RotationRollPitchYaw(0, t * 2, t * 4) * Translation(6, 0, 0) *
+        RotationRollPitchYaw(0, t * 5, 0);
+    Store(marsMoon, worldMatrices, 4);
+
+    for (uint32_t i = NAMED_BODY_COUNT; i < bodyCount; ++i)
+    {
+        uint32_t n = i - NAMED_BODY_COUNT;
+        float radius = 12.0f + (n % 8) * 0.5f;
+        float height = ((n % 7) - 3.0f) * 0.25f;
+        float speed = 1.0f + (n % 5) * 0.25f;
+        // golden angle steps so any count fills the belt evenly
+        float phase = n * 2.39996f;
+
+        Matrix asteroid = RotationRollPitchYaw(t * speed * 4, t * speed * 3, 0) * Scaling(.2f) *
+            Translation(radius, height, 0) * RotationRollPitchYaw(0, phase + t * speed, 0);
+        Store(asteroid, worldMatrices, i);
+    }
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+
+// the sun, mars, earth and their moons in that order, then asteroids round a belt outside
+// the earth's orbit. a fixed function of t and the body index, so the same time and count
+// always give the same matrices. free of windows and DirectXMath so SceneBenchmark can
+// time the app's own update anywhere
+static const uint32_t NAMED_BODY_COUNT = 5;
+
+// worldMatrices holds 16 floats a body, row major and for row vectors as XMFLOAT4X4 and
+// DirectXMath keep them
+void AnimateBodies(float t, float* worldMatrices, uint32_t bodyCount);
@@ -0,0 +1,139 @@
+#include "Benchmark.h"
+#include "RhiNull.h"
+#include "RhiRecording.h"
+#include "SceneAnimation.h"
+#include "SubmissionScene.h"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the -benchmark frame loop on the null RHI, so the scene's CPU side can be timed on a
+// machine without D3D11. the app's fixed 60 Hz step drives the bodies; each frame runs
+// AnimateBodies as Application::Update does, submits the bodies' draws as Draw does and,
+// with -recorded, records them for a deferred list and replays that on the device. the
+// JSON is what -benchmark writes, with "update", "submit" and "execute" stages
+//
+//   SceneBenchmark output.json [-bodies N] [-warmup N] [-frames N] [-recorded]
+
+enum SceneBenchmarkStage
+{
+    SCENE_BENCHMARK_UPDATE,
+    SCENE_BENCHMARK_SUBMIT,
+    SCENE_BENCHMARK_EXECUTE,
+};
+
+static const char* SCENE_BENCHMARK_STAGE_NAMES[] = { "update", "submit", "execute" };
+
+static uint32_t ArgumentValue(int argc, char** argv, const char* name, uint32_t value)
+{
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        if (strcmp(argv[i], name) == 0)
+            return (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+    }
+
+    return value;
+}
+
+static bool HasArgument(int argc, char** argv, const char* name)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], name) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || argv[1][0] == '-')
+    {
+        fprintf(stderr, "usage: SceneBenchmark output.json [-bodies N] [-warmup N] [-frames N] [-recorded]\n");
+        return 2;
+    }
+
+    // the named bodies always animate, as in the app
+    uint32_t bodyCount = max(ArgumentValue(argc, argv, "-bodies", 1024), NAMED_BODY_COUNT);
+    uint32_t warmupFrames = ArgumentValue(argc, argv, "-warmup", 60);
+    uint32_t measuredFrames = max(ArgumentValue(argc, argv, "-frames", 600), 1u);
+    bool recorded = HasArgument(argc, argv, "-recorded");
+
+    NullRhiDevice device;
+    SubmissionScene scene;
+    if (!CreateSubmissionScene(device, scene))
+    {
+        fprintf(stderr, "SceneBenchmark: %s\n", device.GetFirstError().c_str());
+        return 1;
+    }
+
+    BenchmarkRecorder recorder;
+    for (const char* name : SCENE_BENCHMARK_STAGE_NAMES)
+        recorder.AddStage(name);
+
+    const float timestep = 1.0f / 60.0f;
+    vector<float> worldMatrices(bodyCount * 16);
+    RecordingRhiCommandList recording;
+    uint64_t draws = 0;
+
+    RunBenchmarkFrames(recorder, warmupFrames, measuredFrames, [&](uint32_t frame)
+    {
+        // the same tenth of a unit per second Update advances by at a fixed step
+        AnimateBodies(frame * timestep * 0.1f, worldMatrices.data(), bodyCount);
+        recorder.Mark(SCENE_BENCHMARK_UPDATE);
+
+        device.ResetCommandStats();
+        if (recorded)
+        {
+            recording.Reset();
+            SubmitBodies(recording, scene, worldMatrices.data(), bodyCount);
+            recorder.Mark(SCENE_BENCHMARK_SUBMIT);
+
+            recording.Execute(*device.GetImmediateCommandList());
+            recorder.Mark(SCENE_BENCHMARK_EXECUTE);
+        }
+        else
+        {
+            SubmitBodies(*device.GetImmediateCommandList(), scene, worldMatrices.data(), bodyCount);
+            recorder.Mark(SCENE_BENCHMARK_SUBMIT);
+        }
+
+        draws = device.GetStats().Draws;
+    });
+
+    DeleteSubmissionScene(scene);
+
+    if (device.GetStats().Errors)
+    {
+        fprintf(stderr, "SceneBenchmark: %s\n", device.GetFirstError().c_str());
+        return 1;
+    }
+
+    vector<pair<string, string>> config;
+    config.push_back(make_pair("bodies", to_string(bodyCount)));
+    config.push_back(make_pair("warmup_frames", to_string(warmupFrames)));
+    config.push_back(make_pair("measured_frames", to_string(measuredFrames)));
+    config.push_back(make_pair("timestep", to_string(timestep)));
+    config.push_back(make_pair("driver", "\"null\""));
+    config.push_back(make_pair("recorded", recorded ? "true" : "false"));
+    config.push_back(make_pair("draws", to_string(draws)));
+
+    string json = recorder.FormatJson(config);
+    FILE* file = fopen(argv[1], "w");
+    bool written = file && fwrite(json.data(), 1, json.size(), file) == json.size();
+    if (file)
+        fclose(file);
+
+    if (!written)
+    {
+        fprintf(stderr, "SceneBenchmark: can't write %s\n", argv[1]);
+        return 1;
+    }
+
+    printf("scene benchmark: %u bodies, %llu draws, %u frames, median %.3f ms, p99 %.3f ms\n", bodyCount,
+           (unsigned long long)draws, recorder.GetMeasuredFrames(), recorder.GetPercentile(BenchmarkRecorder::FRAME, 50.0),
+           recorder.GetPercentile(BenchmarkRecorder::FRAME, 99.0));
+    return 0;
+}
@@ -0,0 +1,336 @@
+#include "ShaderCache.h"
+
+static string ToUtf8(const wchar_t* text)
+{
+    int length = WideCharToMultiByte(CP_UTF8, 0, text, -1, nullptr, 0, nullptr, nullptr);
+    if (length <= 1)
+        return string();
+
+    string result(length - 1, '\0');
+    WideCharToMultiByte(CP_UTF8, 0, text, -1, &result[0], length, nullptr, nullptr);
+    return result;
+}
+
+static wstring ToWide(const string& text)
+{
+    int length = MultiByteToWideChar(CP_UTF8, 0, text.c_str(), -1, nullptr, 0);
+    if (length <= 1)
+        return wstring();
+
+    wstring result(length - 1, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, text.c_str(), -1, &result[0], length);
+    return result;
+}
+
+static bool ReadFileBytes(const wstring& fileName, vector<uint8_t>& data)
+{
+    HANDLE file = CreateFileW(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size = { 0 };
+    bool ok = GetFileSizeEx(file, &size) && size.HighPart == 0;
+
+    if (ok)
+    {
+        data.resize(size.LowPart);
+        DWORD bytesRead = 0;
+        ok = size.LowPart == 0 || (ReadFile(file, data.data(), size.LowPart, &bytesRead, nullptr) && bytesRead == size.LowPart);
+    }
+
+    CloseHandle(file);
+    return ok;
+}
+
+//--------------------------------------------------------------------------------------
+// Include handler that resolves includes next to the main source file and records
+// each one as a dependency of the entry being compiled
+//--------------------------------------------------------------------------------------
+class DependencyInclude : public ID3DInclude
+{
+public:
+    DependencyInclude(const string& directory, vector<ShaderDependency>& dependencies)
+        : _directory(directory), _dependencies(dependencies)
+    {
+    }
+
+    HRESULT __stdcall Open(D3D_INCLUDE_TYPE includeType, LPCSTR fileName, LPCVOID parentData, LPCVOID* data, UINT* bytes) override
+    {
+        UNREFERENCED_PARAMETER(includeType);
+        UNREFERENCED_PARAMETER(parentData);
+
+        string path = _directory + fileName;
+        vector<uint8_t> contents;
+        if (!ReadFileBytes(ToWide(path), contents))
+            return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+
+        ShaderDependency dependency = { path, HashBytes(contents.data(), contents.size()) };
+        _dependencies.push_back(dependency);
+
+        uint8_t* copy = new uint8_t[contents.size() + 1];
+        memcpy(copy, contents.data(), contents.size());
+        *data = copy;
+        *bytes = (UINT)contents.size();
+
+        return S_OK;
+    }
+
+    HRESULT __stdcall Close(LPCVOID data) override
+    {
+        delete[] (const uint8_t*)data;
+        return S_OK;
+    }
+
+private:
+    string _directory;
+    vector<ShaderDependency>& _dependencies;
+};
+
+static void Reflect(ShaderCacheEntry& entry)
+{
+    ShaderReflectionInfo& info = entry.Reflection;
+    info = ShaderReflectionInfo();
+
+    ID3D11ShaderReflection* reflector = nullptr;
+    if (FAILED(D3DReflect(entry.Bytecode.data(), entry.Bytecode.size(), IID_ID3D11ShaderReflection, (void**)&reflector)))
+        return;
+
+    D3D11_SHADER_DESC desc;
+    reflector->GetDesc(&desc);
+
+    for (UINT i = 0; i < desc.ConstantBuffers; ++i)
+    {
+        D3D11_SHADER_BUFFER_DESC bufferDesc;
+        reflector->GetConstantBufferByIndex(i)->GetDesc(&bufferDesc);
+
+        ShaderConstantBufferInfo buffer = { bufferDesc.Name, bufferDesc.Size, bufferDesc.Variables };
+        info.ConstantBuffers.push_back(buffer);
+    }
+
+    for (UINT i = 0; i < desc.BoundResources; ++i)
+    {
+        D3D11_SHADER_INPUT_BIND_DESC bindDesc;
+        reflector->GetResourceBindingDesc(i, &bindDesc);
+
+        ShaderResourceInfo resource = { bindDesc.Name, (uint32_t)bindDesc.Type, bindDesc.BindPoint, bindDesc.BindCount };
+        info.Resources.push_back(resource);
+    }
+
+    for (UINT i = 0; i < desc.InputParameters; ++i)
+    {
+        D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
+        reflector->GetInputParameterDesc(i, &paramDesc);
+
+        ShaderInputInfo input = { paramDesc.SemanticName, paramDesc.SemanticIndex, paramDesc.Register, paramDesc.Mask };
+        info.Inputs.push_back(input);
+    }
+
+    reflector->Release();
+}
+
+//--------------------------------------------------------------------------------------
+// ShaderCache
+//--------------------------------------------------------------------------------------
+ShaderCache::ShaderCache()
+{
+    _hits = 0;
+    _misses = 0;
+}
+
+void ShaderCache::SetDirectory(const wstring& directory)
+{
+    _directory = directory;
+
+    if (!_directory.empty())
+        CreateDirectoryW(_directory.c_str(), nullptr);
+}
+
+wstring ShaderCache::EntryPath(uint64_t key) const
+{
+    return _directory + L"\\" + ToWide(ShaderCacheFileName(key));
+}
+
+void ShaderCache::MakeEntry(const wchar_t* fileName, const char* entryPoint, const char* target, const D3D_SHADER_MACRO* defines,
+                            UINT flags, ShaderCacheEntry& entry) const
+{
+    entry.SourceFile = ToUtf8(fileName);
+    entry.EntryPoint = entryPoint;
+    entry.Target = target;
+    entry.Flags = flags;
+
+    entry.Defines.clear();
+    for (const D3D_SHADER_MACRO* define = defines; define && define->Name; ++define)
+    {
+        ShaderDefine shaderDefine = { define->Name, define->Definition ? define->Definition : "" };
+        entry.Defines.push_back(shaderDefine);
+    }
+
+    entry.Key = ComputeShaderCacheKey(entry.SourceFile, entry.EntryPoint, entry.Target, entry.Defines, entry.Flags);
+}
+
+HRESULT ShaderCache::Compile(const wchar_t* fileName, ShaderCacheEntry& entry) const
+{
+    vector<uint8_t> source;
+    if (!ReadFileBytes(fileName, source))
+        return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+
+    entry.Dependencies.clear();
+    ShaderDependency main = { entry.SourceFile, HashBytes(source.data(), source.size()) };
+    entry.Dependencies.push_back(main);
+
+    size_t slash = entry.SourceFile.find_last_of("/\\");
+    string directory = slash == string::npos ? string() : entry.SourceFile.substr(0, slash + 1);
+    DependencyInclude include(directory, entry.Dependencies);
+
+    vector<D3D_SHADER_MACRO> macros;
+    for (const ShaderDefine& define : entry.Defines)
+    {
+        D3D_SHADER_MACRO macro = { define.Name.c_str(), define.Value.c_str() };
+        macros.push_back(macro);
+    }
+    D3D_SHADER_MACRO terminator = { nullptr, nullptr };
+    macros.push_back(terminator);
+
+    ID3DBlob* code = nullptr;
+    ID3DBlob* errors = nullptr;
+    HRESULT hr = D3DCompile(source.data(), source.size(), entry.SourceFile.c_str(), macros.data(), &include,
+                            entry.EntryPoint.c_str(), entry.Target.c_str(), entry.Flags, 0, &code, &errors);
+
+    if (errors)
+    {
+        OutputDebugStringA((char*)errors->GetBufferPointer());
+        errors->Release();
+    }
+
+    if (FAILED(hr))
+        return hr;
+
+    const uint8_t* bytecode = (const uint8_t*)code->GetBufferPointer();
+    entry.Bytecode.assign(bytecode, bytecode + code->GetBufferSize());
+    code->Release();
+
+    Reflect(entry);
+
+    return S_OK;
+}
+
+bool ShaderCache::IsCurrent(const ShaderCacheEntry& entry) const
+{
+    return IsShaderCacheEntryCurrent(entry, [](const string& fileName, vector<uint8_t>& contents)
+    {
+        return ReadFileBytes(ToWide(fileName), contents);
+    });
+}
+
+bool ShaderCache::Load(ShaderCacheEntry& entry) const
+{
+    if (_directory.empty())
+        return false;
+
+    vector<uint8_t> data;
+    if (!ReadFileBytes(EntryPath(entry.Key), data))
+        return false;
+
+    ShaderCacheEntry cached;
+    if (!DeserializeShaderCacheEntry(data.data(), data.size(), cached))
+        return false;
+
+    // guards against two keys hashing the same
+    if (cached.Key != entry.Key || cached.SourceFile != entry.SourceFile || cached.EntryPoint != entry.EntryPoint ||
+        cached.Target != entry.Target || cached.Flags != entry.Flags || cached.Defines.size() != entry.Defines.size())
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < cached.Defines.size(); ++i)
+    {
+        if (cached.Defines[i].Name != entry.Defines[i].Name || cached.Defines[i].Value != entry.Defines[i].Value)
+            return false;
+    }
+
+    entry = move(cached);
+    return true;
+}
+
+bool ShaderCache::Save(const ShaderCacheEntry& entry) const
+{
+    if (_directory.empty())
+        return false;
+
+    vector<uint8_t> data;
+    SerializeShaderCacheEntry(entry, data);
+
+    // written next to the real name and moved over it, so a reader never sees half a file
+    wstring path = EntryPath(entry.Key);
+    wstring tempPath = path + L"." + to_wstring(GetCurrentThreadId()) + L".tmp";
+
+    HANDLE file = CreateFileW(tempPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    DWORD written = 0;
+    bool ok = WriteFile(file, data.data(), (DWORD)data.size(), &written, nullptr) && written == data.size();
+    CloseHandle(file);
+
+    if (ok)
+        ok = MoveFileExW(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+
+    if (!ok)
+        DeleteFileW(tempPath.c_str());
+
+    return ok;
+}
+
+HRESULT ShaderCache::GetShader(const wchar_t* fileName, const char* entryPoint, const char* target, const D3D_SHADER_MACRO* defines,
+                               UINT flags, ID3DBlob** blob, ShaderReflectionInfo* reflection)
+{
+    if (!fileName || !entryPoint || !target || !blob)
+        return E_INVALIDARG;
+
+    *blob = nullptr;
+
+    ShaderCacheEntry entry;
+    MakeEntry(fileName, entryPoint, target, defines, flags, entry);
+
+    if (Load(entry) && IsCurrent(entry))
+    {
+        ++_hits;
+    }
+    else
+    {
+        ++_misses;
+
+        HRESULT hr = Compile(fileName, entry);
+        if (FAILED(hr))
+            return hr;
+
+        Save(entry);
+    }
+
+    HRESULT hr = D3DCreateBlob(entry.Bytecode.size(), blob);
+    if (FAILED(hr))
+        return hr;
+
+    memcpy((*blob)->GetBufferPointer(), entry.Bytecode.data(), entry.Bytecode.size());
+
+    if (reflection)
+        *reflection = entry.Reflection;
+
+    return S_OK;
+}
+
+HRESULT ShaderCache::BuildShader(const wchar_t* fileName, const char* entryPoint, const char* target, const D3D_SHADER_MACRO* defines,
+                                 UINT flags)
+{
+    if (!fileName || !entryPoint || !target)
+        return E_INVALIDARG;
+
+    ShaderCacheEntry entry;
+    MakeEntry(fileName, entryPoint, target, defines, flags, entry);
+
+    HRESULT hr = Compile(fileName, entry);
+    if (FAILED(hr))
+        return hr;
+
+    return Save(entry) ? S_OK : E_FAIL;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <windows.h>
+#include <d3d11_1.h>
+#include <d3dcompiler.h>
+#include <string>
+#include <atomic>
+
+#include "ShaderCacheFormat.h"
+
+using namespace std;
+
+// compiled shader bytecode kept on disk between runs. an entry is used as long as the
+// source file and everything it includes still hash to what it was built from, a stale
+// or missing entry is compiled and written back. when the sources are not there at all
+// (a build shipped with only the cache) entries are trusted as they are.
+// GetShader and BuildShader may be called from several threads at once
+class ShaderCache
+{
+public:
+	ShaderCache();
+
+	// creates the directory if it doesn't exist yet
+	void SetDirectory(const wstring& directory);
+
+	HRESULT GetShader(const wchar_t* fileName, const char* entryPoint, const char* target, const D3D_SHADER_MACRO* defines,
+	                  UINT flags, ID3DBlob** blob, ShaderReflectionInfo* reflection = nullptr);
+
+	// compiles and writes the entry whether or not a current one exists (offline build)
+	HRESULT BuildShader(const wchar_t* fileName, const char* entryPoint, const char* target, const D3D_SHADER_MACRO* defines,
+	                    UINT flags);
+
+	UINT GetHits() const { return _hits; }
+	UINT GetMisses() const { return _misses; }
+
+private:
+	void MakeEntry(const wchar_t* fileName, const char* entryPoint, const char* target, const D3D_SHADER_MACRO* defines,
+	               UINT flags, ShaderCacheEntry& entry) const;
+	HRESULT Compile(const wchar_t* fileName, ShaderCacheEntry& entry) const;
+	bool IsCurrent(const ShaderCacheEntry& entry) const;
+	bool Load(ShaderCacheEntry& entry) const;
+	bool Save(const ShaderCacheEntry& entry) const;
+	wstring EntryPath(uint64_t key) const;
+
+	wstring _directory;
+	atomic<UINT> _hits;
+	atomic<UINT> _misses;
+};
@@ -0,0 +1,313 @@
+#include "ShaderCacheFormat.h"
+#include <string.h>
+
+static const uint32_t SHADER_CACHE_MAGIC = 0x43444853; // "SHDC"
+static const uint32_t SHADER_CACHE_VERSION = 1;
+
+static const uint64_t FNV_PRIME = 1099511628211ull;
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t hash)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+// integers are hashed as little endian bytes so a key names the same file on any host
+static uint64_t HashU32(uint32_t value, uint64_t hash)
+{
+    uint8_t bytes[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+    return HashBytes(bytes, sizeof(bytes), hash);
+}
+
+// strings are hashed with their length so "ab"+"c" and "a"+"bc" differ
+static uint64_t HashString(const string& value, uint64_t hash)
+{
+    hash = HashU32((uint32_t)value.size(), hash);
+    return HashBytes(value.data(), value.size(), hash);
+}
+
+uint64_t ComputeShaderCacheKey(const string& sourceFile, const string& entryPoint, const string& target,
+                               const vector<ShaderDefine>& defines, uint32_t flags)
+{
+    uint64_t hash = HashString(sourceFile, FNV_OFFSET_BASIS);
+    hash = HashString(entryPoint, hash);
+    hash = HashString(target, hash);
+
+    hash = HashU32((uint32_t)defines.size(), hash);
+    for (const ShaderDefine& define : defines)
+    {
+        hash = HashString(define.Name, hash);
+        hash = HashString(define.Value, hash);
+    }
+
+    return HashU32(flags, hash);
+}
+
+bool IsShaderCacheEntryCurrent(const ShaderCacheEntry& entry, const function<bool(const string&, vector<uint8_t>&)>& readFile)
+{
+    if (entry.Dependencies.empty())
+        return false;
+
+    vector<uint8_t> contents;
+
+    // no source to compare against, go with what was shipped
+    if (!readFile(entry.Dependencies[0].FileName, contents))
+        return true;
+
+    for (size_t i = 0; i < entry.Dependencies.size(); ++i)
+    {
+        const ShaderDependency& dependency = entry.Dependencies[i];
+        if (i > 0 && !readFile(dependency.FileName, contents))
+            return false;
+
+        if (HashBytes(contents.data(), contents.size()) != dependency.Hash)
+            return false;
+    }
+
+    return true;
+}
+
+string ShaderCacheFileName(uint64_t key)
+{
+    static const char digits[] = "0123456789abcdef";
+
+    string name(16, '0');
+    for (int i = 15; i >= 0; --i)
+    {
+        name[i] = digits[key & 0xF];
+        key >>= 4;
+    }
+
+    return name + ".shc";
+}
+
+//--------------------------------------------------------------------------------------
+// Serialisation, little endian fields with length prefixed strings and arrays
+//--------------------------------------------------------------------------------------
+class BlobWriter
+{
+public:
+    BlobWriter(vector<uint8_t>& data) : _data(data) { }
+
+    void Bytes(const void* bytes, size_t size)
+    {
+        const uint8_t* p = (const uint8_t*)bytes;
+        _data.insert(_data.end(), p, p + size);
+    }
+
+    void U32(uint32_t value)
+    {
+        uint8_t bytes[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+        Bytes(bytes, sizeof(bytes));
+    }
+
+    void U64(uint64_t value)
+    {
+        U32((uint32_t)value);
+        U32((uint32_t)(value >> 32));
+    }
+
+    void String(const string& value)
+    {
+        U32((uint32_t)value.size());
+        Bytes(value.data(), value.size());
+    }
+
+private:
+    vector<uint8_t>& _data;
+};
+
+class BlobReader
+{
+public:
+    BlobReader(const uint8_t* data, size_t size) : _data(data), _size(size), _offset(0), _failed(false) { }
+
+    bool Bytes(void* bytes, size_t size)
+    {
+        if (_failed || size > _size - _offset)
+        {
+            _failed = true;
+            return false;
+        }
+
+        memcpy(bytes, _data + _offset, size);
+        _offset += size;
+        return true;
+    }
+
+    uint32_t U32()
+    {
+        uint8_t bytes[4] = { 0 };
+        Bytes(bytes, sizeof(bytes));
+        return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+    }
+
+    uint64_t U64()
+    {
+        uint64_t low = U32();
+        return low | ((uint64_t)U32() << 32);
+    }
+
+    // element counts are checked against what is left so corrupt data can't ask for huge allocations
+    uint32_t Count(size_t minimumElementSize)
+    {
+        uint32_t count = U32();
+        if (!_failed && (uint64_t)count * minimumElementSize > _size - _offset)
+            _failed = true;
+
+        return _failed ? 0 : count;
+    }
+
+    string String()
+    {
+        uint32_t length = Count(1);
+        string value(length, '\0');
+        if (length)
+            Bytes(&value[0], length);
+
+        return value;
+    }
+
+    size_t Offset() const { return _offset; }
+    bool Failed() const { return _failed; }
+
+private:
+    const uint8_t* _data;
+    size_t _size;
+    size_t _offset;
+    bool _failed;
+};
+
+void SerializeShaderCacheEntry(const ShaderCacheEntry& entry, vector<uint8_t>& data)
+{
+    data.clear();
+    BlobWriter writer(data);
+
+    writer.U32(SHADER_CACHE_MAGIC);
+    writer.U32(SHADER_CACHE_VERSION);
+    writer.U64(entry.Key);
+    writer.String(entry.SourceFile);
+    writer.String(entry.EntryPoint);
+    writer.String(entry.Target);
+    writer.U32(entry.Flags);
+
+    writer.U32((uint32_t)entry.Defines.size());
+    for (const ShaderDefine& define : entry.Defines)
+    {
+        writer.String(define.Name);
+        writer.String(define.Value);
+    }
+
+    writer.U32((uint32_t)entry.Dependencies.size());
+    for (const ShaderDependency& dependency : entry.Dependencies)
+    {
+        writer.String(dependency.FileName);
+        writer.U64(dependency.Hash);
+    }
+
+    writer.U32((uint32_t)entry.Bytecode.size());
+    writer.Bytes(entry.Bytecode.data(), entry.Bytecode.size());
+
+    const ShaderReflectionInfo& reflection = entry.Reflection;
+    writer.U32((uint32_t)reflection.ConstantBuffers.size());
+    for (const ShaderConstantBufferInfo& buffer : reflection.ConstantBuffers)
+    {
+        writer.String(buffer.Name);
+        writer.U32(buffer.Size);
+        writer.U32(buffer.Variables);
+    }
+
+    writer.U32((uint32_t)reflection.Resources.size());
+    for (const ShaderResourceInfo& resource : reflection.Resources)
+    {
+        writer.String(resource.Name);
+        writer.U32(resource.Type);
+        writer.U32(resource.BindPoint);
+        writer.U32(resource.BindCount);
+    }
+
+    writer.U32((uint32_t)reflection.Inputs.size());
+    for (const ShaderInputInfo& input : reflection.Inputs)
+    {
+        writer.String(input.SemanticName);
+        writer.U32(input.SemanticIndex);
+        writer.U32(input.Register);
+        writer.U32(input.Mask);
+    }
+
+    // catches files cut short or damaged on disk
+    writer.U64(HashBytes(data.data(), data.size()));
+}
+
+bool DeserializeShaderCacheEntry(const uint8_t* data, size_t size, ShaderCacheEntry& entry)
+{
+    if (!data || size < sizeof(uint64_t))
+        return false;
+
+    BlobReader checksumReader(data + size - sizeof(uint64_t), sizeof(uint64_t));
+    if (checksumReader.U64() != HashBytes(data, size - sizeof(uint64_t)))
+        return false;
+
+    BlobReader reader(data, size - sizeof(uint64_t));
+    if (reader.U32() != SHADER_CACHE_MAGIC || reader.U32() != SHADER_CACHE_VERSION)
+        return false;
+
+    entry.Key = reader.U64();
+    entry.SourceFile = reader.String();
+    entry.EntryPoint = reader.String();
+    entry.Target = reader.String();
+    entry.Flags = reader.U32();
+
+    entry.Defines.resize(reader.Count(8));
+    for (ShaderDefine& define : entry.Defines)
+    {
+        define.Name = reader.String();
+        define.Value = reader.String();
+    }
+
+    entry.Dependencies.resize(reader.Count(12));
+    for (ShaderDependency& dependency : entry.Dependencies)
+    {
+        dependency.FileName = reader.String();
+        dependency.Hash = reader.U64();
+    }
+
+    entry.Bytecode.resize(reader.Count(1));
+    if (!entry.Bytecode.empty())
+        reader.Bytes(entry.Bytecode.data(), entry.Bytecode.size());
+
+    ShaderReflectionInfo& reflection = entry.Reflection;
+    reflection.ConstantBuffers.resize(reader.Count(12));
+    for (ShaderConstantBufferInfo& buffer : reflection.ConstantBuffers)
+    {
+        buffer.Name = reader.String();
+        buffer.Size = reader.U32();
+        buffer.Variables = reader.U32();
+    }
+
+    reflection.Resources.resize(reader.Count(16));
+    for (ShaderResourceInfo& resource : reflection.Resources)
+    {
+        resource.Name = reader.String();
+        resource.Type = reader.U32();
+        resource.BindPoint = reader.U32();
+        resource.BindCount = reader.U32();
+    }
+
+    reflection.Inputs.resize(reader.Count(16));
+    for (ShaderInputInfo& input : reflection.Inputs)
+    {
+        input.SemanticName = reader.String();
+        input.SemanticIndex = reader.U32();
+        input.Register = reader.U32();
+        input.Mask = reader.U32();
+    }
+
+    return !reader.Failed() && reader.Offset() == size - sizeof(uint64_t);
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "MemoryTracker.h"
+
+using namespace std;
+
+// on disk format of the shader cache, kept free of windows and d3d headers so the
+// key and serialisation code builds anywhere
+
+static const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+
+// 64 bit FNV-1a, pass the previous result back in to hash several pieces as one
+uint64_t HashBytes(const void* data, size_t size, uint64_t hash = FNV_OFFSET_BASIS);
+
+struct ShaderDefine
+{
+	string Name;
+	string Value;
+};
+
+// a file the bytecode was built from and the hash of its contents at the time
+struct ShaderDependency
+{
+	string FileName;
+	uint64_t Hash;
+};
+
+struct ShaderConstantBufferInfo
+{
+	string Name;
+	uint32_t Size;
+	uint32_t Variables;
+};
+
+struct ShaderResourceInfo
+{
+	string Name;
+	// D3D_SHADER_INPUT_TYPE
+	uint32_t Type;
+	uint32_t BindPoint;
+	uint32_t BindCount;
+};
+
+struct ShaderInputInfo
+{
+	string SemanticName;
+	uint32_t SemanticIndex;
+	uint32_t Register;
+	uint32_t Mask;
+};
+
+// what D3DReflect had to say about the bytecode, saved so it doesn't need redoing at runtime
+struct ShaderReflectionInfo
+{
+	vector<ShaderConstantBufferInfo> ConstantBuffers;
+	vector<ShaderResourceInfo> Resources;
+	vector<ShaderInputInfo> Inputs;
+};
+
+struct ShaderCacheEntry
+{
+	uint64_t Key;
+	string SourceFile;
+	string EntryPoint;
+	string Target;
+	vector<ShaderDefine> Defines;
+	uint32_t Flags;
+	// main source file first, then every file it included
+	vector<ShaderDependency> Dependencies;
+	ShaderVector<uint8_t> Bytecode;
+	ShaderReflectionInfo Reflection;
+};
+
+// identifies one compile of a source file. the file contents are not part of the key,
+// they are checked against the entry's dependency hashes so an edited shader replaces
+// its stale entry instead of leaving it behind
+uint64_t ComputeShaderCacheKey(const string& sourceFile, const string& entryPoint, const string& target,
+                               const vector<ShaderDefine>& defines, uint32_t flags);
+
+// whether the main source and every include still hash to what the entry was built from.
+// readFile gives a file's contents or false when it can't be read. with no main source
+// to compare against (a build shipped with only the cache) the entry is current
+bool IsShaderCacheEntryCurrent(const ShaderCacheEntry& entry, const function<bool(const string&, vector<uint8_t>&)>& readFile);
+
+// 16 hex digits and the .shc extension
+string ShaderCacheFileName(uint64_t key);
+
+void SerializeShaderCacheEntry(const ShaderCacheEntry& entry, vector<uint8_t>& data);
+// false for truncated, corrupt or older version data
+bool DeserializeShaderCacheEntry(const uint8_t* data, size_t size, ShaderCacheEntry& entry);
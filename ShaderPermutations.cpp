@@ -0,0 +1,150 @@
+#include "ShaderPermutations.h"
+
+// macro for each ShaderFeature bit, in bit order
+static const char* FEATURE_MACROS[SHADER_FEATURE_COUNT] =
+{
+    "FEATURE_DIFFUSE_TEXTURE",
+    "FEATURE_SPECULAR",
+    "FEATURE_VIRTUAL_TEXTURE",
+    "FEATURE_POINT_LIGHTS",
+    "FEATURE_NORMAL_MAP",
+    "FEATURE_SHADOWS",
+};
+
+ShaderPermutations::ShaderPermutations()
+{
+    _cache = nullptr;
+    _jobs = nullptr;
+    _compileFlags = 0;
+}
+
+ShaderPermutations::~ShaderPermutations()
+{
+    Release();
+}
+
+void ShaderPermutations::Init(ShaderCache* cache, JobSystem* jobs, const wchar_t* fileName, UINT compileFlags)
+{
+    Release();
+
+    _cache = cache;
+    _jobs = jobs;
+    _fileName = fileName;
+    _compileFlags = compileFlags;
+}
+
+void ShaderPermutations::Release()
+{
+    for (Permutation& permutation : _permutations)
+    {
+        if (permutation.bytecode) permutation.bytecode->Release();
+        if (permutation.vertexShader) permutation.vertexShader->Release();
+        if (permutation.pixelShader) permutation.pixelShader->Release();
+    }
+
+    _permutations.clear();
+}
+
+void ShaderPermutations::MakeDefines(UINT features, vector<D3D_SHADER_MACRO>& defines)
+{
+    defines.clear();
+
+    for (UINT i = 0; i < SHADER_FEATURE_COUNT; ++i)
+    {
+        D3D_SHADER_MACRO define = { FEATURE_MACROS[i], (features & (1 << i)) ? "1" : "0" };
+        defines.push_back(define);
+    }
+
+    D3D_SHADER_MACRO terminator = { nullptr, nullptr };
+    defines.push_back(terminator);
+}
+
+UINT ShaderPermutations::Request(const char* entryPoint, const char* target, UINT features)
+{
+    for (UINT i = 0; i < _permutations.size(); ++i)
+    {
+        const Permutation& permutation = _permutations[i];
+        if (permutation.entryPoint == entryPoint && permutation.target == target && permutation.features == features)
+            return i;
+    }
+
+    Permutation permutation;
+    permutation.entryPoint = entryPoint;
+    permutation.target = target;
+    permutation.features = features;
+    permutation.compiled = false;
+    permutation.bytecode = nullptr;
+    permutation.vertexShader = nullptr;
+    permutation.pixelShader = nullptr;
+    _permutations.push_back(permutation);
+
+    return (UINT)_permutations.size() - 1;
+}
+
+HRESULT ShaderPermutations::CompileRequested(ID3D11Device* device)
+{
+    if (!_cache)
+        return E_FAIL;
+
+    vector<UINT> pending;
+    for (UINT i = 0; i < _permutations.size(); ++i)
+    {
+        if (!_permutations[i].compiled)
+            pending.push_back(i);
+    }
+
+    // each job only touches its own permutation and result
+    vector<HRESULT> results(pending.size(), S_OK);
+    auto compile = [&](UINT index)
+    {
+        Permutation& permutation = _permutations[pending[index]];
+        if (permutation.bytecode) permutation.bytecode->Release();
+        permutation.bytecode = nullptr;
+
+        vector<D3D_SHADER_MACRO> defines;
+        MakeDefines(permutation.features, defines);
+
+        results[index] = _cache->GetShader(_fileName.c_str(), permutation.entryPoint.c_str(), permutation.target.c_str(),
+                                           defines.data(), _compileFlags, &permutation.bytecode);
+    };
+
+    if (_jobs)
+    {
+        _jobs->ParallelFor((UINT)pending.size(), compile);
+    }
+    else
+    {
+        for (UINT i = 0; i < pending.size(); ++i)
+            compile(i);
+    }
+
+    HRESULT hr = S_OK;
+    for (UINT i = 0; i < pending.size(); ++i)
+    {
+        Permutation& permutation = _permutations[pending[i]];
+
+        if (FAILED(results[i]))
+        {
+            hr = results[i];
+            continue;
+        }
+
+        if (device && permutation.target[0] == 'v')
+        {
+            results[i] = device->CreateVertexShader(permutation.bytecode->GetBufferPointer(), permutation.bytecode->GetBufferSize(),
+                                                    nullptr, &permutation.vertexShader);
+        }
+        else if (device && permutation.target[0] == 'p')
+        {
+            results[i] = device->CreatePixelShader(permutation.bytecode->GetBufferPointer(), permutation.bytecode->GetBufferSize(),
+                                                   nullptr, &permutation.pixelShader);
+        }
+
+        if (FAILED(results[i]))
+            hr = results[i];
+        else
+            permutation.compiled = true;
+    }
+
+    return hr;
+}
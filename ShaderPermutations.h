@@ -0,0 +1,71 @@
+#pragma once
+
+#include <windows.h>
+#include <d3d11_1.h>
+#include <string>
+#include <vector>
+
+#include "ShaderCache.h"
+#include "JobSystem.h"
+
+using namespace std;
+
+// optional shader features, each one is a FEATURE_* macro in DX11 Framework.fx that is
+// compiled in or out rather than branched on per pixel
+enum ShaderFeature
+{
+	SHADER_FEATURE_DIFFUSE_TEXTURE = 1 << 0,
+	SHADER_FEATURE_SPECULAR = 1 << 1,
+	SHADER_FEATURE_VIRTUAL_TEXTURE = 1 << 2,
+	SHADER_FEATURE_POINT_LIGHTS = 1 << 3,
+	SHADER_FEATURE_NORMAL_MAP = 1 << 4,
+	SHADER_FEATURE_SHADOWS = 1 << 5,
+};
+
+static const UINT SHADER_FEATURE_COUNT = 6;
+
+// compiles the variants of a source file's entry points that materials ask for. every
+// permutation goes through the shader cache and the compiles are spread over the jobs
+class ShaderPermutations
+{
+public:
+	ShaderPermutations();
+	~ShaderPermutations();
+
+	void Init(ShaderCache* cache, JobSystem* jobs, const wchar_t* fileName, UINT compileFlags);
+	void Release();
+
+	// asks for a permutation, nothing is compiled until CompileRequested. asking for the
+	// same entry point, target and features again returns the same handle
+	UINT Request(const char* entryPoint, const char* target, UINT features);
+
+	// compiles whatever has been requested since the last call, device may be null to
+	// only fill the cache
+	HRESULT CompileRequested(ID3D11Device* device);
+
+	ID3D11VertexShader* GetVertexShader(UINT handle) const { return _permutations[handle].vertexShader; }
+	ID3D11PixelShader* GetPixelShader(UINT handle) const { return _permutations[handle].pixelShader; }
+	ID3DBlob* GetBytecode(UINT handle) const { return _permutations[handle].bytecode; }
+	UINT GetPermutationCount() const { return (UINT)_permutations.size(); }
+
+	// every feature macro defined to 0 or 1, null terminated
+	static void MakeDefines(UINT features, vector<D3D_SHADER_MACRO>& defines);
+
+private:
+	struct Permutation
+	{
+		string entryPoint;
+		string target;
+		UINT features;
+		bool compiled;
+		ID3DBlob* bytecode;
+		ID3D11VertexShader* vertexShader;
+		ID3D11PixelShader* pixelShader;
+	};
+
+	ShaderCache* _cache;
+	JobSystem* _jobs;
+	wstring _fileName;
+	UINT _compileFlags;
+	vector<Permutation> _permutations;
+};
@@ -0,0 +1,207 @@
+#include "ShadowCascadeFitter.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+using namespace std;
+
+// how far behind a cascade's sphere casters are still drawn, so tall things outside the
+// view still shadow into it
+static const float CASTER_EXTENT = 50.0f;
+
+static void Multiply(const float* a, const float* b, float* result)
+{
+    for (int row = 0; row < 4; ++row)
+    {
+        for (int column = 0; column < 4; ++column)
+        {
+            result[row * 4 + column] = a[row * 4] * b[column] + a[row * 4 + 1] * b[4 + column] +
+                                       a[row * 4 + 2] * b[8 + column] + a[row * 4 + 3] * b[12 + column];
+        }
+    }
+}
+
+static float Dot(const float* a, const float* b)
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void Normalize(float* v)
+{
+    float length = sqrtf(Dot(v, v));
+    v[0] /= length;
+    v[1] /= length;
+    v[2] /= length;
+}
+
+//--------------------------------------------------------------------------------------
+void ComputeCascadeSplits(float nearZ, float shadowDistance, float splitBlend, uint32_t cascadeCount, float* splits)
+{
+    for (uint32_t i = 0; i < cascadeCount; ++i)
+    {
+        float fraction = (float)(i + 1) / cascadeCount;
+        float logSplit = nearZ * powf(shadowDistance / nearZ, fraction);
+        float evenSplit = nearZ + (shadowDistance - nearZ) * fraction;
+        splits[i] = splitBlend * logSplit + (1.0f - splitBlend) * evenSplit;
+    }
+
+    // both ends meet there, but float noise in powf shouldn't move the last one
+    if (cascadeCount)
+        splits[cascadeCount - 1] = shadowDistance;
+}
+
+//--------------------------------------------------------------------------------------
+// ShadowCascadeFitter
+//--------------------------------------------------------------------------------------
+ShadowCascadeFitter::ShadowCascadeFitter()
+{
+    _resolution = 0;
+    _cascadeCount = 0;
+    _nearZ = 0.01f;
+    _shadowDistance = 0.0f;
+    _splitBlend = 0.0f;
+    memset(_cascades, 0, sizeof(_cascades));
+}
+
+bool ShadowCascadeFitter::Init(uint32_t resolution, uint32_t cascadeCount, float nearZ, float shadowDistance, float splitBlend)
+{
+    if (cascadeCount == 0 || cascadeCount > MAX_SHADOW_CASCADES)
+        return false;
+
+    _resolution = resolution;
+    _cascadeCount = cascadeCount;
+    _nearZ = nearZ;
+    _shadowDistance = shadowDistance;
+    _splitBlend = splitBlend;
+    memset(_cascades, 0, sizeof(_cascades));
+    return true;
+}
+
+void ShadowCascadeFitter::Invalidate()
+{
+    for (uint32_t i = 0; i < MAX_SHADOW_CASCADES; ++i)
+        _cascades[i].Cached = false;
+}
+
+void ShadowCascadeFitter::Update(const float* view, const float* projection, const float* lightDirection)
+{
+    float towardLight[3] = { lightDirection[0], lightDirection[1], lightDirection[2] };
+    Normalize(towardLight);
+    float up[3] = { 0.0f, 1.0f, 0.0f };
+    if (fabsf(towardLight[1]) > 0.99f)
+    {
+        up[1] = 0.0f;
+        up[2] = 1.0f;
+    }
+
+    // the light looks along -towardLight, its x and y axes as XMMatrixLookAtLH builds them
+    float axisZ[3] = { -towardLight[0], -towardLight[1], -towardLight[2] };
+    float axisX[3] = { up[1] * axisZ[2] - up[2] * axisZ[1], up[2] * axisZ[0] - up[0] * axisZ[2], up[0] * axisZ[1] - up[1] * axisZ[0] };
+    Normalize(axisX);
+    float axisY[3] = { axisZ[1] * axisX[2] - axisZ[2] * axisX[1], axisZ[2] * axisX[0] - axisZ[0] * axisX[2],
+                       axisZ[0] * axisX[1] - axisZ[1] * axisX[0] };
+
+    // view space half extents of the frustum at depth 1
+    float tanX = 1.0f / projection[0];
+    float tanY = 1.0f / projection[5];
+
+    float splits[MAX_SHADOW_CASCADES];
+    ComputeCascadeSplits(_nearZ, _shadowDistance, _splitBlend, _cascadeCount, splits);
+
+    float splitNear = _nearZ;
+    for (uint32_t i = 0; i < _cascadeCount; ++i)
+    {
+        ShadowCascade& cascade = _cascades[i];
+        float splitFar = splits[i];
+
+        // the sphere through the slice's corners sits on the view axis. working it out in
+        // view space means it doesn't change as the camera turns, so neither does its size
+        float nearHalfDiagonalSq = splitNear * splitNear * (tanX * tanX + tanY * tanY);
+        float farHalfDiagonalSq = splitFar * splitFar * (tanX * tanX + tanY * tanY);
+        float centreZ = min((splitNear + splitFar + (farHalfDiagonalSq - nearHalfDiagonalSq) / (splitFar - splitNear)) * 0.5f, splitFar);
+        float radius = sqrtf(max((splitFar - centreZ) * (splitFar - centreZ) + farHalfDiagonalSq,
+                                 (centreZ - splitNear) * (centreZ - splitNear) + nearHalfDiagonalSq));
+
+        // rounded up so float noise never changes the texel size
+        radius = ceilf(radius * 16.0f) / 16.0f;
+
+        // (0, 0, centreZ) back to world space, the inverse of a rigid view is its
+        // transposed rotation after taking off its translation
+        float centre[3];
+        for (int k = 0; k < 3; ++k)
+            centre[k] = -view[12] * view[k * 4] - view[13] * view[k * 4 + 1] + (centreZ - view[14]) * view[k * 4 + 2];
+
+        float eye[3];
+        for (int k = 0; k < 3; ++k)
+            eye[k] = centre[k] + towardLight[k] * (radius + CASTER_EXTENT);
+
+        const float lightView[16] =
+        {
+            axisX[0], axisY[0], axisZ[0], 0.0f,
+            axisX[1], axisY[1], axisZ[1], 0.0f,
+            axisX[2], axisY[2], axisZ[2], 0.0f,
+            -Dot(axisX, eye), -Dot(axisY, eye), -Dot(axisZ, eye), 1.0f,
+        };
+
+        // XMMatrixOrthographicOffCenterLH round the sphere, from the eye to past its far side
+        float lightProjection[16] =
+        {
+            1.0f / radius, 0.0f, 0.0f, 0.0f,
+            0.0f, 1.0f / radius, 0.0f, 0.0f,
+            0.0f, 0.0f, 1.0f / (2.0f * radius + CASTER_EXTENT), 0.0f,
+            0.0f, 0.0f, 0.0f, 1.0f,
+        };
+
+        // move the projection so the world origin lands on a whole texel, a camera
+        // movement then shifts the shadow map by whole texels only
+        float halfResolution = _resolution * 0.5f;
+        float x = lightView[12] * lightProjection[0] * halfResolution;
+        float y = lightView[13] * lightProjection[5] * halfResolution;
+        lightProjection[12] += (roundf(x) - x) / halfResolution;
+        lightProjection[13] += (roundf(y) - y) / halfResolution;
+
+        memcpy(cascade.View, lightView, sizeof(lightView));
+        memcpy(cascade.Projection, lightProjection, sizeof(lightProjection));
+        cascade.SplitFar = splitFar;
+        cascade.Radius = radius;
+
+        splitNear = splitFar;
+    }
+}
+
+bool ShadowCascadeFitter::IsCasterInCascade(uint32_t cascade, const float* centre, float radius) const
+{
+    const ShadowCascade& c = _cascades[cascade];
+    float light[3];
+    for (int k = 0; k < 3; ++k)
+        light[k] = centre[0] * c.View[k] + centre[1] * c.View[4 + k] + centre[2] * c.View[8 + k] + c.View[12 + k];
+
+    // the ortho box around the cascade sphere, anything between it and the light counts
+    float projectionOffsetX = -c.Projection[12] / c.Projection[0];
+    float projectionOffsetY = -c.Projection[13] / c.Projection[5];
+    float farZ = 2.0f * c.Radius + CASTER_EXTENT;
+
+    return fabsf(light[0] - projectionOffsetX) <= c.Radius + radius &&
+           fabsf(light[1] - projectionOffsetY) <= c.Radius + radius &&
+           light[2] + radius >= 0.0f && light[2] - radius <= farZ;
+}
+
+bool ShadowCascadeFitter::NeedsRender(uint32_t cascade, bool hasDynamicCasters) const
+{
+    const ShadowCascade& c = _cascades[cascade];
+    if (hasDynamicCasters || !c.Cached)
+        return true;
+
+    float viewProjection[16];
+    Multiply(c.View, c.Projection, viewProjection);
+    return memcmp(viewProjection, c.CachedViewProjection, sizeof(viewProjection)) != 0;
+}
+
+void ShadowCascadeFitter::MarkRendered(uint32_t cascade, bool hasDynamicCasters)
+{
+    ShadowCascade& c = _cascades[cascade];
+
+    // with something moving in it the slice is redrawn every frame anyway
+    c.Cached = !hasDynamicCasters;
+    Multiply(c.View, c.Projection, c.CachedViewProjection);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+
+static const uint32_t MAX_SHADOW_CASCADES = 4;
+
+// one cascade's fit, the matrices are 16 floats row major as XMFLOAT4X4 keeps them
+struct ShadowCascade
+{
+	float View[16];
+	float Projection[16];
+	// view space depth the cascade ends at
+	float SplitFar;
+	float Radius;
+	// view * projection the slice was last drawn with
+	float CachedViewProjection[16];
+	bool Cached;
+};
+
+// view space depth each cascade ends at, splitBlend mixes logarithmic (1) and even (0)
+// splits. the last one is always shadowDistance
+void ComputeCascadeSplits(float nearZ, float shadowDistance, float splitBlend, uint32_t cascadeCount, float* splits);
+
+// the cascade maths behind CascadedShadowMap. each cascade is fitted to a bounding sphere
+// of its slice of the view frustum, which keeps its size fixed as the camera turns, and
+// its origin is snapped to whole shadow texels so static shadows don't shimmer as the
+// camera moves. a cascade that only static casters reached last time it was drawn is
+// kept until its fit moves, Invalidate is called, or something dynamic moves into it.
+// free of windows and d3d headers so it can be checked anywhere
+class ShadowCascadeFitter
+{
+public:
+	ShadowCascadeFitter();
+
+	// false for no cascades or more than MAX_SHADOW_CASCADES
+	bool Init(uint32_t resolution, uint32_t cascadeCount, float nearZ, float shadowDistance, float splitBlend);
+
+	// refits the cascades. view and projection are 16 floats as XMFLOAT4X4 keeps them,
+	// view a rigid transform as LookAt builds it. lightDirection points from the scene
+	// towards the light
+	void Update(const float* view, const float* projection, const float* lightDirection);
+
+	// static casters or the light changed, every cascade is redrawn next time
+	void Invalidate();
+
+	// whether a caster's bounding sphere can throw a shadow into the cascade
+	bool IsCasterInCascade(uint32_t cascade, const float* centre, float radius) const;
+	// false when the cascade still holds what it would draw
+	bool NeedsRender(uint32_t cascade, bool hasDynamicCasters) const;
+	// the cascade's slice was drawn with its current fit
+	void MarkRendered(uint32_t cascade, bool hasDynamicCasters);
+
+	const ShadowCascade& GetCascade(uint32_t cascade) const { return _cascades[cascade]; }
+	uint32_t GetCascadeCount() const { return _cascadeCount; }
+	uint32_t GetResolution() const { return _resolution; }
+
+private:
+	uint32_t _resolution;
+	uint32_t _cascadeCount;
+	float _nearZ;
+	float _shadowDistance;
+	float _splitBlend;
+	ShadowCascade _cascades[MAX_SHADOW_CASCADES];
+};
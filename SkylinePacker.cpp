@@ -0,0 +1,154 @@
+#include "SkylinePacker.h"
+
+#include <algorithm>
+
+static uint32_t AlignUp(uint32_t value, uint32_t alignment)
+{
+    return ((value + alignment - 1) / alignment) * alignment;
+}
+
+SkylinePacker::SkylinePacker()
+{
+    _width = 0;
+    _height = 0;
+    _alignment = 1;
+    _padding = 0;
+    _usedArea = 0;
+}
+
+void SkylinePacker::Init(uint32_t width, uint32_t height, uint32_t alignment, uint32_t padding)
+{
+    _width = width;
+    _height = height;
+    _alignment = max(alignment, 1u);
+    _padding = padding;
+    _usedArea = 0;
+
+    // starts off as one segment along the bottom of the page
+    _skyline.clear();
+    SkylineNode node = { 0, 0, width };
+    _skyline.push_back(node);
+}
+
+bool SkylinePacker::Fit(size_t index, uint32_t width, uint32_t height, uint32_t* y) const
+{
+    uint32_t x = _skyline[index].x;
+    if (x + width > _width)
+        return false;
+
+    // the rectangle rests on the highest segment it spans
+    uint32_t top = _skyline[index].y;
+    uint32_t widthLeft = width;
+    size_t i = index;
+    while (widthLeft > 0)
+    {
+        if (i >= _skyline.size())
+            return false;
+
+        top = max(top, _skyline[i].y);
+        if (top + height > _height)
+            return false;
+
+        if (_skyline[i].width >= widthLeft)
+            break;
+
+        widthLeft -= _skyline[i].width;
+        ++i;
+    }
+
+    *y = top;
+    return true;
+}
+
+void SkylinePacker::AddLevel(size_t index, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+    SkylineNode node = { x, y + height, width };
+    _skyline.insert(_skyline.begin() + index, node);
+
+    // cut back the segments now hidden underneath the new one
+    for (size_t i = index + 1; i < _skyline.size(); )
+    {
+        SkylineNode& prev = _skyline[i - 1];
+        SkylineNode& cur = _skyline[i];
+        if (cur.x >= prev.x + prev.width)
+            break;
+
+        uint32_t shrink = prev.x + prev.width - cur.x;
+        if (cur.width <= shrink)
+        {
+            _skyline.erase(_skyline.begin() + i);
+            continue;
+        }
+
+        cur.x += shrink;
+        cur.width -= shrink;
+        break;
+    }
+
+    // merge neighbours at the same height
+    for (size_t i = 0; i + 1 < _skyline.size(); )
+    {
+        if (_skyline[i].y == _skyline[i + 1].y)
+        {
+            _skyline[i].width += _skyline[i + 1].width;
+            _skyline.erase(_skyline.begin() + i + 1);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
+
+bool SkylinePacker::Insert(uint32_t width, uint32_t height, AtlasRect* rect)
+{
+    if (width == 0 || height == 0 || rect == nullptr)
+        return false;
+
+    uint32_t paddedWidth = AlignUp(width + _padding * 2, _alignment);
+    uint32_t paddedHeight = AlignUp(height + _padding * 2, _alignment);
+
+    size_t bestIndex = _skyline.size();
+    uint32_t bestTop = UINT32_MAX;
+    uint32_t bestWidth = UINT32_MAX;
+    uint32_t bestY = 0;
+
+    for (size_t i = 0; i < _skyline.size(); ++i)
+    {
+        uint32_t y;
+        if (!Fit(i, paddedWidth, paddedHeight, &y))
+            continue;
+
+        // lowest top edge wins, ties go to the narrowest segment so wide gaps stay open
+        uint32_t top = y + paddedHeight;
+        if (top < bestTop || (top == bestTop && _skyline[i].width < bestWidth))
+        {
+            bestIndex = i;
+            bestTop = top;
+            bestWidth = _skyline[i].width;
+            bestY = y;
+        }
+    }
+
+    if (bestIndex == _skyline.size())
+        return false;
+
+    uint32_t x = _skyline[bestIndex].x;
+    AddLevel(bestIndex, x, bestY, paddedWidth, paddedHeight);
+
+    rect->x = x + _padding;
+    rect->y = bestY + _padding;
+    rect->width = width;
+    rect->height = height;
+
+    _usedArea += (uint64_t)width * height;
+    return true;
+}
+
+float SkylinePacker::Occupancy() const
+{
+    if (_width == 0 || _height == 0)
+        return 0.0f;
+
+    return (float)((double)_usedArea / ((double)_width * _height));
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+// rectangle (in texels) that a texture was packed into
+struct AtlasRect
+{
+	uint32_t x;
+	uint32_t y;
+	uint32_t width;
+	uint32_t height;
+};
+
+// bottom-left skyline packer, keeps the top edge of the packed area as a list of
+// horizontal segments and drops each new rectangle onto the lowest segment it fits
+class SkylinePacker
+{
+public:
+	SkylinePacker();
+
+	void Init(uint32_t width, uint32_t height, uint32_t alignment = 1, uint32_t padding = 0);
+	bool Insert(uint32_t width, uint32_t height, AtlasRect* rect);
+
+	// fraction of the page covered by inserted rectangles (padding excluded)
+	float Occupancy() const;
+
+	uint32_t GetWidth() const { return _width; }
+	uint32_t GetHeight() const { return _height; }
+
+private:
+	struct SkylineNode
+	{
+		uint32_t x;
+		uint32_t y;
+		uint32_t width;
+	};
+
+	bool Fit(size_t index, uint32_t width, uint32_t height, uint32_t* y) const;
+	void AddLevel(size_t index, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
+	uint32_t _width;
+	uint32_t _height;
+	uint32_t _alignment;
+	uint32_t _padding;
+	uint64_t _usedArea;
+	vector<SkylineNode> _skyline;
+};
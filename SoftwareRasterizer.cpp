@@ -0,0 +1,556 @@
+#include "SoftwareRasterizer.h"
+#include "CpuProfiler.h"
+
+#include <emmintrin.h>
+#include <math.h>
+#include <algorithm>
+
+// clip space x and y are clipped to this many times w, which keeps snapped positions
+// within a target width or height of the screen
+static const float GUARD_BAND = 3.0f;
+// w has to be at least this before the divide
+static const float MIN_W = 1e-5f;
+// w, near, far and the four guard band sides
+static const uint32_t CLIP_PLANES = 7;
+// each plane can add one vertex
+static const uint32_t MAX_CLIPPED_VERTICES = 3 + CLIP_PLANES;
+static const size_t FRAME_CHUNK_BYTES = 64 * 1024;
+
+//--------------------------------------------------------------------------------------
+// Textures
+//--------------------------------------------------------------------------------------
+
+void SampleSoftwareTexture(const SoftwareTexture& texture, float u, float v, uint32_t slice, float texCoordArea, float colour[4])
+{
+    // One texel per pixel at mip 0 is a texel area of 1, every mip after quarters it
+    uint32_t mip = 0;
+    float texelArea = texCoordArea * texture.Width * texture.Height;
+    if (texelArea > 1.0f)
+        mip = min((uint32_t)(0.5f * log2f(texelArea) + 0.5f), texture.MipLevels - 1);
+
+    uint32_t width = max(texture.Width >> mip, 1u);
+    uint32_t height = max(texture.Height >> mip, 1u);
+    const uint32_t* texels = &texture.Texels[texture.Offsets[min(slice, texture.ArraySize - 1) * texture.MipLevels + mip]];
+
+    // Wrapped before scaling so the texel coordinates stay small whatever the uv
+    float x = (u - floorf(u)) * width - 0.5f;
+    float y = (v - floorf(v)) * height - 0.5f;
+    float fx = floorf(x);
+    float fy = floorf(y);
+    float wx = x - fx;
+    float wy = y - fy;
+
+    uint32_t x0 = fx < 0.0f ? width - 1 : (uint32_t)fx;
+    uint32_t y0 = fy < 0.0f ? height - 1 : (uint32_t)fy;
+    uint32_t x1 = x0 + 1 < width ? x0 + 1 : 0;
+    uint32_t y1 = y0 + 1 < height ? y0 + 1 : 0;
+
+    const uint32_t corners[4] = { texels[y0 * width + x0], texels[y0 * width + x1], texels[y1 * width + x0], texels[y1 * width + x1] };
+    const float weights[4] = { (1.0f - wx) * (1.0f - wy), wx * (1.0f - wy), (1.0f - wx) * wy, wx * wy };
+
+    __m128i zero = _mm_setzero_si128();
+    __m128 sum = _mm_setzero_ps();
+    for (int i = 0; i < 4; ++i)
+    {
+        __m128i texel = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128((int)corners[i]), zero), zero);
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_cvtepi32_ps(texel), _mm_set1_ps(weights[i])));
+    }
+
+    _mm_storeu_ps(colour, _mm_mul_ps(sum, _mm_set1_ps(1.0f / 255.0f)));
+}
+
+//--------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------
+
+// saturated RGBA to B8G8R8A8
+static uint32_t PackColour(const float colour[4])
+{
+    __m128 clamped = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(colour), _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    __m128i rgba = _mm_cvtps_epi32(_mm_mul_ps(clamped, _mm_set1_ps(255.0f)));
+    __m128i bgra = _mm_shuffle_epi32(rgba, _MM_SHUFFLE(3, 0, 1, 2));
+    bgra = _mm_packs_epi32(bgra, bgra);
+    return (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(bgra, bgra));
+}
+
+// inside where it isn't negative
+static float ClipDistance(const float* position, uint32_t plane, bool depthClip)
+{
+    float x = position[0];
+    float y = position[1];
+    float z = position[2];
+    float w = position[3];
+
+    switch (plane)
+    {
+    case 0: return w - MIN_W;
+    case 1: return depthClip ? z : 1.0f;
+    case 2: return depthClip ? w - z : 1.0f;
+    case 3: return GUARD_BAND * w - x;
+    case 4: return GUARD_BAND * w + x;
+    case 5: return GUARD_BAND * w - y;
+    default: return GUARD_BAND * w + y;
+    }
+}
+
+static void LerpVertex(const SoftwareVertex& a, const SoftwareVertex& b, float t, uint32_t varyingCount, SoftwareVertex& output)
+{
+    for (uint32_t i = 0; i < 4; ++i)
+        output.Position[i] = a.Position[i] + (b.Position[i] - a.Position[i]) * t;
+
+    for (uint32_t i = 0; i < varyingCount; ++i)
+        output.Varyings[i] = a.Varyings[i] + (b.Varyings[i] - a.Varyings[i]) * t;
+}
+
+// four pixels of a row of a plane, the first x and y pixels from its first vertex
+static __m128 PlaneRow(float c, float dx, float dy, float x, float y)
+{
+    return _mm_add_ps(_mm_set1_ps(c + dx * x + dy * y), _mm_mul_ps(_mm_set1_ps(dx), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f)));
+}
+
+//--------------------------------------------------------------------------------------
+// SoftwareRasterizer
+//--------------------------------------------------------------------------------------
+
+SoftwareRasterizer::SoftwareRasterizer()
+{
+    _width = 0;
+    _height = 0;
+    _pitch = 0;
+    _tilesX = 0;
+    _tilesY = 0;
+    _jobs = nullptr;
+    _clearPending = false;
+    _clearColour = 0;
+    _clearDepth = 1.0f;
+    _frameChunk = 0;
+    _frameChunkUsed = 0;
+    _frame = 0;
+}
+
+bool SoftwareRasterizer::Init(uint32_t width, uint32_t height, JobSystem* jobs)
+{
+    if (width == 0 || height == 0 || width > SOFTWARE_MAX_TARGET_SIZE || height > SOFTWARE_MAX_TARGET_SIZE)
+        return false;
+
+    _width = width;
+    _height = height;
+    _jobs = jobs;
+    _tilesX = (width + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+    _tilesY = (height + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+    _pitch = _tilesX * SOFTWARE_TILE_SIZE;
+
+    size_t pixels = (size_t)_pitch * _tilesY * SOFTWARE_TILE_SIZE;
+    _colour.reset(new uint32_t[pixels]());
+    _depth.reset(new float[pixels]);
+    fill(_depth.get(), _depth.get() + pixels, 1.0f);
+
+    _bins.assign(_tilesX * _tilesY, vector<uint32_t>());
+    _draws.clear();
+    _triangles.clear();
+
+    return true;
+}
+
+void SoftwareRasterizer::Clear(const float colour[4], float depth)
+{
+    // Whatever was added before has to land under the clear
+    if (!_triangles.empty())
+        Flush();
+
+    _clearPending = true;
+    _clearColour = PackColour(colour);
+    _clearDepth = depth;
+}
+
+void* SoftwareRasterizer::AllocateFrameData(size_t bytes)
+{
+    bytes = (bytes + 15) & ~(size_t)15;
+
+    // The current chunk, or the next one with room
+    while (_frameChunk < _frameChunks.size() && _frameChunkUsed + bytes > _frameChunkSizes[_frameChunk])
+    {
+        ++_frameChunk;
+        _frameChunkUsed = 0;
+    }
+
+    if (_frameChunk == _frameChunks.size())
+    {
+        size_t size = max(bytes, FRAME_CHUNK_BYTES);
+        _frameChunks.push_back(unique_ptr<uint8_t[]>(new uint8_t[size]));
+        _frameChunkSizes.push_back(size);
+        _frameChunkUsed = 0;
+    }
+
+    uint8_t* data = _frameChunks[_frameChunk].get() + _frameChunkUsed;
+    _frameChunkUsed += bytes;
+
+    return data;
+}
+
+uint32_t SoftwareRasterizer::AddDraw(const SoftwareDrawState& state)
+{
+    _draws.push_back(state);
+    _draws.back().VaryingCount = min(state.VaryingCount, SOFTWARE_MAX_VARYINGS);
+
+    return (uint32_t)_draws.size() - 1;
+}
+
+void SoftwareRasterizer::AddTriangle(uint32_t draw, const SoftwareVertex& v0, const SoftwareVertex& v1, const SoftwareVertex& v2)
+{
+    const SoftwareDrawState& state = _draws[draw];
+    const SoftwareVertex* vertices[3] = { &v0, &v1, &v2 };
+
+    uint32_t outside[3] = {};
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        for (uint32_t plane = 0; plane < CLIP_PLANES; ++plane)
+        {
+            if (ClipDistance(vertices[i]->Position, plane, state.DepthClip) < 0.0f)
+                outside[i] |= 1 << plane;
+        }
+    }
+
+    // Wholly outside one plane or inside them all, nearly every triangle is one or the other
+    if (outside[0] & outside[1] & outside[2])
+        return;
+
+    uint32_t crossed = outside[0] | outside[1] | outside[2];
+    if (!crossed)
+    {
+        SetupTriangle(draw, &v0, &v1, &v2);
+        return;
+    }
+
+    // Sutherland-Hodgman against the planes it crosses, then a fan of what is left
+    SoftwareVertex buffers[2][MAX_CLIPPED_VERTICES];
+    SoftwareVertex* polygon = buffers[0];
+    SoftwareVertex* clipped = buffers[1];
+    polygon[0] = v0;
+    polygon[1] = v1;
+    polygon[2] = v2;
+    uint32_t count = 3;
+
+    for (uint32_t plane = 0; plane < CLIP_PLANES; ++plane)
+    {
+        if (!(crossed & (1 << plane)))
+            continue;
+
+        uint32_t clippedCount = 0;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const SoftwareVertex& a = polygon[i];
+            const SoftwareVertex& b = polygon[(i + 1) % count];
+            float da = ClipDistance(a.Position, plane, state.DepthClip);
+            float db = ClipDistance(b.Position, plane, state.DepthClip);
+
+            if (da >= 0.0f)
+                clipped[clippedCount++] = a;
+
+            if ((da >= 0.0f) != (db >= 0.0f))
+                LerpVertex(a, b, da / (da - db), state.VaryingCount, clipped[clippedCount++]);
+        }
+
+        swap(polygon, clipped);
+        count = clippedCount;
+
+        if (count < 3)
+            return;
+    }
+
+    for (uint32_t i = 1; i + 1 < count; ++i)
+        SetupTriangle(draw, &polygon[0], &polygon[i], &polygon[i + 1]);
+}
+
+void SoftwareRasterizer::SetupTriangle(uint32_t draw, const SoftwareVertex* v0, const SoftwareVertex* v1, const SoftwareVertex* v2)
+{
+    const SoftwareDrawState& state = _draws[draw];
+    const SoftwareVertex* vertices[3] = { v0, v1, v2 };
+
+    // Viewport transform, snapped to 1/16 pixel
+    int32_t x[3];
+    int32_t y[3];
+    float z[3];
+    float invW[3];
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        const float* position = vertices[i]->Position;
+        invW[i] = 1.0f / position[3];
+        x[i] = (int32_t)lrintf((position[0] * invW[i] * 0.5f + 0.5f) * _width * 16.0f);
+        y[i] = (int32_t)lrintf((0.5f - position[1] * invW[i] * 0.5f) * _height * 16.0f);
+        z[i] = position[2] * invW[i];
+    }
+
+    int64_t area = (int64_t)(x[1] - x[0]) * (y[2] - y[0]) - (int64_t)(x[2] - x[0]) * (y[1] - y[0]);
+    if (area == 0)
+        return;
+
+    // Clockwise on screen faces the front, as in D3D's default rasteriser state
+    bool front = area > 0;
+    if ((state.Cull == RHI_CULL_BACK && !front) || (state.Cull == RHI_CULL_FRONT && front))
+        return;
+
+    // The edge functions take the vertices clockwise
+    if (!front)
+    {
+        swap(vertices[1], vertices[2]);
+        swap(x[1], x[2]);
+        swap(y[1], y[2]);
+        swap(z[1], z[2]);
+        swap(invW[1], invW[2]);
+        area = -area;
+    }
+
+    // Pixels whose centres (x * 16 + 8) fall within the snapped bounds
+    int32_t minX = max((min(x[0], min(x[1], x[2])) + 7) >> 4, 0);
+    int32_t minY = max((min(y[0], min(y[1], y[2])) + 7) >> 4, 0);
+    int32_t maxX = min((max(x[0], max(x[1], x[2])) - 8) >> 4, (int32_t)_width - 1);
+    int32_t maxY = min((max(y[0], max(y[1], y[2])) - 8) >> 4, (int32_t)_height - 1);
+    if (minX > maxX || minY > maxY)
+        return;
+
+    uint32_t index = (uint32_t)_triangles.size();
+    _triangles.emplace_back();
+    Triangle& triangle = _triangles.back();
+
+    triangle.Draw = draw;
+    triangle.MinX = minX;
+    triangle.MinY = minY;
+    triangle.MaxX = maxX;
+    triangle.MaxY = maxY;
+
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        triangle.X[i] = x[i];
+        triangle.Y[i] = y[i];
+
+        // With y down and clockwise order a top edge runs along +x and a left edge up the screen
+        int32_t dx = x[(i + 1) % 3] - x[i];
+        int32_t dy = y[(i + 1) % 3] - y[i];
+        bool topLeft = (dy == 0 && dx > 0) || dy < 0;
+        triangle.Bias[i] = topLeft ? 0 : 1;
+    }
+
+    // Planes in pixels from vertex 0
+    float dx1 = (x[1] - x[0]) / 16.0f;
+    float dy1 = (y[1] - y[0]) / 16.0f;
+    float dx2 = (x[2] - x[0]) / 16.0f;
+    float dy2 = (y[2] - y[0]) / 16.0f;
+    float pixelArea = (float)area / 256.0f;
+    float invArea = 1.0f / pixelArea;
+
+    const float values[4][3] = { { z[0], z[1], z[2] }, { invW[0], invW[1], invW[2] }, { 0.0f, invW[1], 0.0f }, { 0.0f, 0.0f, invW[2] } };
+    Plane* planes[4] = { &triangle.Depth, &triangle.InvW, &triangle.Weight1, &triangle.Weight2 };
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        float d1 = values[i][1] - values[i][0];
+        float d2 = values[i][2] - values[i][0];
+        planes[i]->C = values[i][0];
+        planes[i]->DX = (d1 * dy2 - d2 * dy1) * invArea;
+        planes[i]->DY = (d2 * dx1 - d1 * dx2) * invArea;
+    }
+
+    const float* varyings[3] = { vertices[0]->Varyings, vertices[1]->Varyings, vertices[2]->Varyings };
+    for (uint32_t i = 0; i < state.VaryingCount; ++i)
+    {
+        triangle.Varyings[i] = varyings[0][i];
+        triangle.Deltas1[i] = varyings[1][i] - varyings[0][i];
+        triangle.Deltas2[i] = varyings[2][i] - varyings[0][i];
+    }
+
+    // One uv footprint for the whole triangle, the same mip for all of it
+    triangle.TexCoordArea = 0.0f;
+    if (state.TexCoordVarying >= 0 && state.TexCoordVarying + 1 < (int32_t)state.VaryingCount)
+    {
+        uint32_t u = (uint32_t)state.TexCoordVarying;
+        float uvArea = triangle.Deltas1[u] * triangle.Deltas2[u + 1] - triangle.Deltas2[u] * triangle.Deltas1[u + 1];
+        triangle.TexCoordArea = fabsf(uvArea) * invArea;
+    }
+
+    for (int32_t tileY = minY / (int32_t)SOFTWARE_TILE_SIZE; tileY <= maxY / (int32_t)SOFTWARE_TILE_SIZE; ++tileY)
+    {
+        for (int32_t tileX = minX / (int32_t)SOFTWARE_TILE_SIZE; tileX <= maxX / (int32_t)SOFTWARE_TILE_SIZE; ++tileX)
+            _bins[tileY * _tilesX + tileX].push_back(index);
+    }
+}
+
+void SoftwareRasterizer::Flush()
+{
+    CPU_PROFILE_FUNCTION();
+
+    if (_clearPending || !_triangles.empty())
+    {
+        uint32_t tileCount = _tilesX * _tilesY;
+        if (_jobs)
+        {
+            _jobs->ParallelFor(tileCount, [this](uint32_t tile) { DrawTile(tile); });
+        }
+        else
+        {
+            for (uint32_t tile = 0; tile < tileCount; ++tile)
+                DrawTile(tile);
+        }
+    }
+
+    _clearPending = false;
+    _draws.clear();
+    _triangles.clear();
+    for (vector<uint32_t>& bin : _bins)
+        bin.clear();
+
+    _frameChunk = 0;
+    _frameChunkUsed = 0;
+    ++_frame;
+}
+
+void SoftwareRasterizer::DrawTile(uint32_t tile)
+{
+    int32_t tileX = (int32_t)((tile % _tilesX) * SOFTWARE_TILE_SIZE);
+    int32_t tileY = (int32_t)((tile / _tilesX) * SOFTWARE_TILE_SIZE);
+
+    if (_clearPending)
+    {
+        for (uint32_t y = 0; y < SOFTWARE_TILE_SIZE; ++y)
+        {
+            size_t row = (size_t)(tileY + y) * _pitch + tileX;
+            fill(&_colour[row], &_colour[row] + SOFTWARE_TILE_SIZE, _clearColour);
+            fill(&_depth[row], &_depth[row] + SOFTWARE_TILE_SIZE, _clearDepth);
+        }
+    }
+
+    for (uint32_t index : _bins[tile])
+        DrawTriangle(_triangles[index], tileX, tileY);
+}
+
+void SoftwareRasterizer::DrawTriangle(const Triangle& triangle, int32_t tileX, int32_t tileY)
+{
+    const SoftwareDrawState& state = _draws[triangle.Draw];
+
+    // Whole steps of four pixels, the tiles and the padded rows are multiples of four
+    int32_t minX = max(triangle.MinX, tileX) & ~3;
+    int32_t maxX = min(triangle.MaxX, tileX + (int32_t)SOFTWARE_TILE_SIZE - 1) | 3;
+    int32_t minY = max(triangle.MinY, tileY);
+    int32_t maxY = min(triangle.MaxY, tileY + (int32_t)SOFTWARE_TILE_SIZE - 1);
+
+    // An edge with the whole rectangle on one side either draws nothing or needs no test.
+    // the ones that cross it stay well inside 32 bits anywhere in the rectangle
+    __m128i edgeRows[3];
+    __m128i edgeStepsX[3];
+    __m128i edgeStepsY[3];
+    uint32_t edgeCount = 0;
+
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        uint32_t a = i;
+        uint32_t b = (i + 1) % 3;
+        int64_t stepX = (int64_t)(triangle.Y[a] - triangle.Y[b]) * 16;
+        int64_t stepY = (int64_t)(triangle.X[b] - triangle.X[a]) * 16;
+        int64_t corner = (int64_t)(triangle.Y[a] - triangle.Y[b]) * ((minX << 4) + 8 - triangle.X[a]) +
+                         (int64_t)(triangle.X[b] - triangle.X[a]) * ((minY << 4) + 8 - triangle.Y[a]) - triangle.Bias[i];
+
+        int64_t acrossX = stepX * (maxX - minX);
+        int64_t acrossY = stepY * (maxY - minY);
+        if (corner + max(acrossX, (int64_t)0) + max(acrossY, (int64_t)0) < 0)
+            return;
+        if (corner + min(acrossX, (int64_t)0) + min(acrossY, (int64_t)0) >= 0)
+            continue;
+
+        edgeRows[edgeCount] = _mm_setr_epi32((int32_t)corner, (int32_t)(corner + stepX), (int32_t)(corner + 2 * stepX), (int32_t)(corner + 3 * stepX));
+        edgeStepsX[edgeCount] = _mm_set1_epi32((int32_t)(stepX * 4));
+        edgeStepsY[edgeCount] = _mm_set1_epi32((int32_t)stepY);
+        ++edgeCount;
+    }
+
+    // The planes at the first pixel centre, stepped along like the edges
+    float originX = minX + 0.5f - triangle.X[0] / 16.0f;
+    float originY = minY + 0.5f - triangle.Y[0] / 16.0f;
+    const Plane* planes[4] = { &triangle.Depth, &triangle.InvW, &triangle.Weight1, &triangle.Weight2 };
+    __m128 planeRows[4];
+    __m128 planeStepsX[4];
+    __m128 planeStepsY[4];
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        planeRows[i] = PlaneRow(planes[i]->C, planes[i]->DX, planes[i]->DY, originX, originY);
+        planeStepsX[i] = _mm_set1_ps(planes[i]->DX * 4.0f);
+        planeStepsY[i] = _mm_set1_ps(planes[i]->DY);
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128i allNegative = _mm_set1_epi32(-1);
+
+    SoftwarePixelInput input;
+    input.TexCoordArea = triangle.TexCoordArea;
+
+    float* depthRow = &_depth[(size_t)minY * _pitch];
+    uint32_t* colourRow = &_colour[(size_t)minY * _pitch];
+
+    for (int32_t y = minY; y <= maxY; ++y, depthRow += _pitch, colourRow += _pitch)
+    {
+        __m128i edges[3];
+        for (uint32_t i = 0; i < edgeCount; ++i)
+            edges[i] = edgeRows[i];
+        __m128 depth = planeRows[0];
+        __m128 invW = planeRows[1];
+        __m128 weight1 = planeRows[2];
+        __m128 weight2 = planeRows[3];
+
+        for (int32_t x = minX; x <= maxX; x += 4)
+        {
+            // Negative somewhere is outside, so is the or of the edges
+            __m128i edgeBits = _mm_setzero_si128();
+            for (uint32_t i = 0; i < edgeCount; ++i)
+                edgeBits = _mm_or_si128(edgeBits, edges[i]);
+            __m128 covered = _mm_castsi128_ps(_mm_cmpgt_epi32(edgeBits, allNegative));
+
+            // Clamped to the viewport's depth range, as when depth clipping is off
+            __m128 pixelDepth = _mm_min_ps(_mm_max_ps(depth, zero), one);
+            __m128 storedDepth = _mm_loadu_ps(depthRow + x);
+            if (state.DepthTest)
+                covered = _mm_and_ps(covered, _mm_cmplt_ps(pixelDepth, storedDepth));
+
+            int mask = _mm_movemask_ps(covered);
+            if (mask)
+            {
+                if (state.DepthWrite)
+                    _mm_storeu_ps(depthRow + x, _mm_or_ps(_mm_and_ps(covered, pixelDepth), _mm_andnot_ps(covered, storedDepth)));
+
+                if (state.PixelShader)
+                {
+                    __m128 w = _mm_div_ps(one, invW);
+                    float weights1[4];
+                    float weights2[4];
+                    _mm_storeu_ps(weights1, _mm_mul_ps(weight1, w));
+                    _mm_storeu_ps(weights2, _mm_mul_ps(weight2, w));
+
+                    input.Y = y + 0.5f;
+                    for (int lane = 0; lane < 4; ++lane)
+                    {
+                        if (!(mask & (1 << lane)))
+                            continue;
+
+                        input.X = x + lane + 0.5f;
+                        for (uint32_t i = 0; i < state.VaryingCount; ++i)
+                            input.Varyings[i] = triangle.Varyings[i] + weights1[lane] * triangle.Deltas1[i] + weights2[lane] * triangle.Deltas2[i];
+
+                        float colour[4];
+                        state.PixelShader(input, state.Resources, colour);
+                        colourRow[x + lane] = PackColour(colour);
+                    }
+                }
+            }
+
+            for (uint32_t i = 0; i < edgeCount; ++i)
+                edges[i] = _mm_add_epi32(edges[i], edgeStepsX[i]);
+            depth = _mm_add_ps(depth, planeStepsX[0]);
+            invW = _mm_add_ps(invW, planeStepsX[1]);
+            weight1 = _mm_add_ps(weight1, planeStepsX[2]);
+            weight2 = _mm_add_ps(weight2, planeStepsX[3]);
+        }
+
+        for (uint32_t i = 0; i < edgeCount; ++i)
+            edgeRows[i] = _mm_add_epi32(edgeRows[i], edgeStepsY[i]);
+        for (uint32_t i = 0; i < 4; ++i)
+            planeRows[i] = _mm_add_ps(planeRows[i], planeStepsY[i]);
+    }
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <memory>
+
+#include "Rhi.h"
+#include "JobSystem.h"
+
+using namespace std;
+
+// floats a vertex shader can hand the pixel shader besides the position
+static const uint32_t SOFTWARE_MAX_VARYINGS = 16;
+// the target is cut into square tiles this many pixels wide, a job draws one tile
+static const uint32_t SOFTWARE_TILE_SIZE = 64;
+// keeps the snapped positions, guard band included, small enough for 32 bit edge functions
+static const uint32_t SOFTWARE_MAX_TARGET_SIZE = 4096;
+
+// every mip of a 2D texture or texture array as RGBA8, R in the low byte
+struct SoftwareTexture
+{
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t MipLevels;
+	uint32_t ArraySize;
+	vector<uint32_t> Texels;
+	// where each subresource starts in Texels, mip major within a slice as D3D orders them
+	vector<size_t> Offsets;
+};
+
+// bilinear filtered RGBA in 0-1 from the mip whose texels best match the uv area one
+// pixel covers, wrapping at the edges like the app's linear sampler
+void SampleSoftwareTexture(const SoftwareTexture& texture, float u, float v, uint32_t slice, float texCoordArea, float colour[4]);
+
+// what a draw's shaders read. the pixel shader's constant buffers are copies taken when
+// the draw was submitted, since it runs at the next Flush
+struct SoftwareShaderResources
+{
+	const void* ConstantBuffers[RHI_MAX_CONSTANT_BUFFERS];
+	const SoftwareTexture* Textures[RHI_MAX_TEXTURES];
+};
+
+// what a vertex shader writes: the clip space position and the values to interpolate
+struct SoftwareVertex
+{
+	float Position[4];
+	float Varyings[SOFTWARE_MAX_VARYINGS];
+};
+
+struct SoftwarePixelInput
+{
+	// pixel centre in the target
+	float X;
+	float Y;
+	// perspective correct
+	float Varyings[SOFTWARE_MAX_VARYINGS];
+	// uv area one pixel of the triangle covers, 0 when the vertex shader has no uv
+	float TexCoordArea;
+};
+
+// elementOffsets are the byte offsets of the pipeline state's vertex elements, in order
+typedef void (*SoftwareVertexShader)(const uint8_t* vertex, const uint32_t* elementOffsets,
+                                     const SoftwareShaderResources& resources, SoftwareVertex& output);
+// writes RGBA, saturated when it is stored
+typedef void (*SoftwarePixelShader)(const SoftwarePixelInput& input, const SoftwareShaderResources& resources, float colour[4]);
+
+struct SoftwareDrawState
+{
+	// null draws depth only
+	SoftwarePixelShader PixelShader;
+	SoftwareShaderResources Resources;
+	uint32_t VaryingCount;
+	// varying the u of a uv pair is in, for TexCoordArea, or -1
+	int32_t TexCoordVarying;
+	RhiCullMode Cull;
+	bool DepthClip;
+	bool DepthTest;
+	bool DepthWrite;
+};
+
+// tile based triangle rasteriser. triangles are clipped, set up and binned into every
+// tile their bounds touch as they are added, then Flush draws the tiles across the job
+// system. coverage comes from integer edge functions on 1/16 pixel snapped positions,
+// four pixels at a time with SSE2, with the top-left fill rule so shared edges draw every
+// pixel once. depth is tested before shading, LESS as D3D's default. each tile draws its
+// triangles in the order they were added, so the image is the same however many threads
+class SoftwareRasterizer
+{
+public:
+	SoftwareRasterizer();
+
+	// jobs may be null to draw every tile on the calling thread
+	bool Init(uint32_t width, uint32_t height, JobSystem* jobs);
+
+	// done by each tile at the next Flush, before anything is drawn on it
+	void Clear(const float colour[4], float depth);
+
+	// memory that lasts until the next Flush
+	void* AllocateFrameData(size_t bytes);
+	// the state is copied, triangles refer to it by the returned index
+	uint32_t AddDraw(const SoftwareDrawState& state);
+	void AddTriangle(uint32_t draw, const SoftwareVertex& v0, const SoftwareVertex& v1, const SoftwareVertex& v2);
+
+	// draws everything added since the last Flush, frame data and draws are gone after
+	void Flush();
+
+	uint32_t GetWidth() const { return _width; }
+	uint32_t GetHeight() const { return _height; }
+	// B8G8R8A8 as GDI bitmaps have it, GetPitch pixels from one row to the next
+	const uint32_t* GetPixels() const { return _colour.get(); }
+	uint32_t GetPitch() const { return _pitch; }
+	// bumped by every Flush, frame data from an earlier frame is gone
+	uint64_t GetFrame() const { return _frame; }
+	// triangles binned since the last Flush, after clipping and culling
+	uint32_t GetTriangleCount() const { return (uint32_t)_triangles.size(); }
+
+private:
+	// a plane over the screen, value = C + DX * (x - first vertex x) + DY * (y - first vertex y)
+	struct Plane
+	{
+		float C;
+		float DX;
+		float DY;
+	};
+
+	struct Triangle
+	{
+		uint32_t Draw;
+		// 1/16 pixel
+		int32_t X[3];
+		int32_t Y[3];
+		// 1 for edges the top-left rule leaves out, edge i runs from vertex i to i + 1
+		int32_t Bias[3];
+		// pixel centres covered lie inside these, inclusive
+		int32_t MinX;
+		int32_t MinY;
+		int32_t MaxX;
+		int32_t MaxY;
+		Plane Depth;
+		Plane InvW;
+		// barycentric weights of vertices 1 and 2 over w, divided by InvW per pixel
+		Plane Weight1;
+		Plane Weight2;
+		float TexCoordArea;
+		// vertex 0's varyings and the differences to vertices 1 and 2
+		float Varyings[SOFTWARE_MAX_VARYINGS];
+		float Deltas1[SOFTWARE_MAX_VARYINGS];
+		float Deltas2[SOFTWARE_MAX_VARYINGS];
+	};
+
+	void SetupTriangle(uint32_t draw, const SoftwareVertex* v0, const SoftwareVertex* v1, const SoftwareVertex* v2);
+	void DrawTile(uint32_t tile);
+	void DrawTriangle(const Triangle& triangle, int32_t tileX, int32_t tileY);
+
+	uint32_t _width;
+	uint32_t _height;
+	// both buffers are padded out to whole tiles
+	uint32_t _pitch;
+	uint32_t _tilesX;
+	uint32_t _tilesY;
+	unique_ptr<uint32_t[]> _colour;
+	unique_ptr<float[]> _depth;
+	JobSystem* _jobs;
+
+	bool _clearPending;
+	uint32_t _clearColour;
+	float _clearDepth;
+
+	vector<SoftwareDrawState> _draws;
+	vector<Triangle> _triangles;
+	// triangle indices per tile, in the order they were added
+	vector<vector<uint32_t>> _bins;
+
+	vector<unique_ptr<uint8_t[]>> _frameChunks;
+	vector<size_t> _frameChunkSizes;
+	size_t _frameChunk;
+	size_t _frameChunkUsed;
+	uint64_t _frame;
+};
@@ -0,0 +1,130 @@
+#include "SoftwareShaders.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+// ConstantBuffer as HLSL packs it, the matrices transposed as Application uploads them
+struct SceneConstants
+{
+    float World[16];
+    float View[16];
+    float Projection[16];
+
+    float DiffuseMtrl[4];
+    float DiffuseLight[4];
+    float LightVecW[3];
+    float LightVecPad;
+
+    float AmbientMtrl[4];
+    float AmbientLight[4];
+
+    float SpecularMtrl[4];
+    float SpecularLight[4];
+    float SpecularPower;
+    float EyePosW[3];
+
+    float UVTransform[4];
+    uint32_t TextureSlice;
+    float TexturePad[3];
+
+    float MaterialUVTransform[4];
+    uint32_t MaterialSlice;
+    float MaterialPad[3];
+};
+
+// mul(v, M) on a transposed matrix, each output is a dot product with one uploaded row
+static void Transform(const float v[4], const float* m, float output[4])
+{
+    for (int i = 0; i < 4; ++i)
+        output[i] = v[0] * m[i * 4] + v[1] * m[i * 4 + 1] + v[2] * m[i * 4 + 2] + v[3] * m[i * 4 + 3];
+}
+
+static void Normalize(float v[3])
+{
+    float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    if (length > 0.0f)
+    {
+        v[0] /= length;
+        v[1] /= length;
+        v[2] /= length;
+    }
+}
+
+static float Saturate(float value)
+{
+    return min(max(value, 0.0f), 1.0f);
+}
+
+void SceneVertexShader(const uint8_t* vertex, const uint32_t* elementOffsets, const SoftwareShaderResources& resources, SoftwareVertex& output)
+{
+    const SceneConstants& cb = *static_cast<const SceneConstants*>(resources.ConstantBuffers[0]);
+
+    // A float3 element read as float4 gets w = 1
+    float position[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    memcpy(position, vertex + elementOffsets[0], 3 * sizeof(float));
+
+    float positionW[4];
+    Transform(position, cb.World, positionW);
+
+    float* eye = output.Varyings + 3;
+    for (int i = 0; i < 3; ++i)
+        eye[i] = cb.EyePosW[i] - positionW[i];
+    Normalize(eye);
+
+    float positionV[4];
+    Transform(positionW, cb.View, positionV);
+    Transform(positionV, cb.Projection, output.Position);
+
+    // W component of vector is 0 as vectors cannot be translated
+    float normal[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    memcpy(normal, vertex + elementOffsets[1], 3 * sizeof(float));
+
+    float normalW[4];
+    Transform(normal, cb.World, normalW);
+    Normalize(normalW);
+    memcpy(output.Varyings, normalW, 3 * sizeof(float));
+
+    memcpy(output.Varyings + SCENE_TEXCOORD_VARYING, vertex + elementOffsets[2], 2 * sizeof(float));
+}
+
+void ScenePixelShader(const SoftwarePixelInput& input, const SoftwareShaderResources& resources, float colour[4])
+{
+    const SceneConstants& cb = *static_cast<const SceneConstants*>(resources.ConstantBuffers[0]);
+
+    // SampleMaterial, an unbound texture reads as 0 like it does on the GPU
+    float texture[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    if (resources.Textures[0])
+    {
+        const float* tex = input.Varyings + SCENE_TEXCOORD_VARYING;
+        float u = tex[0] * cb.UVTransform[0] + cb.UVTransform[2];
+        float v = tex[1] * cb.UVTransform[1] + cb.UVTransform[3];
+        float texCoordArea = input.TexCoordArea * fabsf(cb.UVTransform[0] * cb.UVTransform[1]);
+        SampleSoftwareTexture(*resources.Textures[0], u, v, cb.TextureSlice, texCoordArea, texture);
+    }
+
+    // SampleSurface without a normal map
+    float normal[3] = { input.Varyings[0], input.Varyings[1], input.Varyings[2] };
+    Normalize(normal);
+    const float* eye = input.Varyings + 3;
+    const float* light = cb.LightVecW;
+
+    // ShadeSurface, fully lit
+    float lightDotNormal = light[0] * normal[0] + light[1] * normal[1] + light[2] * normal[2];
+    float diffuseAmount = max(lightDotNormal, 0.0f);
+
+    // The HLSL keeps only x of reflect(-LightVecW, normalW) in the float r, and dot(r, eye)
+    // then uses it for every component of eye
+    float r = -light[0] + 2.0f * lightDotNormal * normal[0];
+    float specularAmount = powf(max(r * (eye[0] + eye[1] + eye[2]), 0.0f), cb.SpecularPower);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        float specular = specularAmount * cb.SpecularMtrl[i] * cb.SpecularLight[i];
+        float ambient = cb.AmbientMtrl[i] * cb.AmbientLight[i];
+        float diffuse = diffuseAmount * cb.DiffuseMtrl[i] * cb.DiffuseLight[i];
+        colour[i] = texture[i] + Saturate(diffuse) + ambient + Saturate(specular);
+    }
+
+    colour[3] = texture[3] + cb.DiffuseMtrl[3];
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "SoftwareRasterizer.h"
+
+// CPU ports of VS and PS from DX11 Framework.fx in the default permutation: diffuse
+// texture and specular, no normal map, shadows, point lights or virtual texture. both
+// read Application's ConstantBuffer from slot 0, the pixel shader samples texture 0. the
+// vertex layout is POSITION, NORMAL, TEXCOORD and TANGENT as the app's input layout has it
+
+// normalW, eye and Tex, the varyings PS reads
+static const uint32_t SCENE_VARYING_COUNT = 8;
+static const int32_t SCENE_TEXCOORD_VARYING = 6;
+
+void SceneVertexShader(const uint8_t* vertex, const uint32_t* elementOffsets, const SoftwareShaderResources& resources, SoftwareVertex& output);
+void ScenePixelShader(const SoftwarePixelInput& input, const SoftwareShaderResources& resources, float colour[4]);
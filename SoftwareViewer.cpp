@@ -0,0 +1,358 @@
+#include "SoftwareViewer.h"
+#include "SoftwareShaders.h"
+#include "Application.h"
+
+static const XMFLOAT3 SUN_DIRECTION = { 0.3f, 0.9f, 0.3f };
+
+// CPU stages RunBenchmark times, in the order a frame goes through them
+enum SoftwareBenchmarkStage
+{
+    SOFTWARE_BENCHMARK_UPDATE,
+    SOFTWARE_BENCHMARK_SUBMIT,
+    SOFTWARE_BENCHMARK_RASTER,
+};
+
+static const char* SOFTWARE_BENCHMARK_STAGE_NAMES[] = { "update", "submit", "raster" };
+
+static LRESULT CALLBACK SoftwareViewerWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
+{
+    PAINTSTRUCT ps;
+
+    switch (message)
+    {
+        // Every frame is drawn straight to the window, there's nothing to repaint
+        case WM_PAINT:
+            BeginPaint(hWnd, &ps);
+            EndPaint(hWnd, &ps);
+            break;
+
+        case WM_DESTROY:
+            PostQuitMessage(0);
+            break;
+
+        default:
+            return DefWindowProc(hWnd, message, wParam, lParam);
+    }
+
+    return 0;
+}
+
+SoftwareViewer::SoftwareViewer()
+{
+    _width = 0;
+    _height = 0;
+    _hWnd = nullptr;
+
+    _vertexShader = nullptr;
+    _pixelShader = nullptr;
+    _pipeline = nullptr;
+    _constantBuffer = nullptr;
+    _cubeVertexBuffer = nullptr;
+    _groundVertexBuffer = nullptr;
+    _groundIndexBuffer = nullptr;
+    _groundIndexCount = 0;
+    _crateTexture = nullptr;
+}
+
+SoftwareViewer::~SoftwareViewer()
+{
+    delete _crateTexture;
+    delete _groundIndexBuffer;
+    delete _groundVertexBuffer;
+    delete _cubeVertexBuffer;
+    delete _constantBuffer;
+    delete _pipeline;
+    delete _pixelShader;
+    delete _vertexShader;
+
+    _jobs.Shutdown();
+}
+
+HRESULT SoftwareViewer::Initialise(UINT width, UINT height, UINT bodyCount)
+{
+    _width = width;
+    _height = height;
+
+    _jobs.Init();
+    if (!_device.Init(width, height, &_jobs))
+        return E_INVALIDARG;
+
+    _worldMatrices.resize(max(bodyCount, NAMED_BODY_COUNT));
+
+    // Camera and projection as Application sets them up
+    XMVECTOR Eye = XMVectorSet(0.0f, 0.0f, 25.0f, 0.0f);
+    XMVECTOR At = XMVectorSet(0.0f, 0.0f, 0.0f, 0.0f);
+    XMVECTOR Up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+    XMStoreFloat4x4(&_view, XMMatrixLookAtLH(Eye, At, Up));
+    XMStoreFloat4x4(&_projection, XMMatrixPerspectiveFovLH(XM_PIDIV2, width / (FLOAT)height, 0.01f, 100.0f));
+
+    XMStoreFloat4x4(&_groundPlaneMatrix, XMMatrixScaling(3, 3, 3) * XMMatrixTranslation(0, -8, 0));
+
+    return InitScene();
+}
+
+HRESULT SoftwareViewer::InitScene()
+{
+    _vertexShader = _device.CreateVertexShader(SceneVertexShader, SCENE_VARYING_COUNT, SCENE_TEXCOORD_VARYING);
+    _pixelShader = _device.CreatePixelShader(ScenePixelShader);
+
+    // Same layout and rasteriser state as Application's scene pipelines
+    RhiPipelineStateDesc desc = {};
+    desc.VertexShader = _vertexShader;
+    desc.PixelShader = _pixelShader;
+    desc.Elements[0] = { "POSITION", 0, RHI_FORMAT_R32G32B32_FLOAT, RHI_APPEND_ALIGNED };
+    desc.Elements[1] = { "NORMAL", 0, RHI_FORMAT_R32G32B32A32_FLOAT, RHI_APPEND_ALIGNED };
+    desc.Elements[2] = { "TEXCOORD", 0, RHI_FORMAT_R32G32_FLOAT, RHI_APPEND_ALIGNED };
+    desc.Elements[3] = { "TANGENT", 0, RHI_FORMAT_R32G32B32A32_FLOAT, RHI_APPEND_ALIGNED };
+    desc.ElementCount = 4;
+    desc.Fill = RHI_FILL_SOLID;
+    desc.Cull = RHI_CULL_NONE;
+    desc.DepthClip = false;
+    desc.DepthTest = true;
+    desc.DepthWrite = true;
+    _pipeline = _device.CreatePipelineState(desc);
+
+    RhiBufferDesc constantDesc = { RHI_BUFFER_CONSTANT, sizeof(ConstantBuffer), 0 };
+    _constantBuffer = _device.CreateBuffer(constantDesc, nullptr);
+
+    MeshVector<SimpleVertexNormal> cubeVertices;
+    GenerateCubeVertices(cubeVertices);
+    RhiBufferDesc cubeDesc = { RHI_BUFFER_VERTEX, (UINT)(sizeof(SimpleVertexNormal) * cubeVertices.size()), sizeof(SimpleVertexNormal) };
+    _cubeVertexBuffer = _device.CreateBuffer(cubeDesc, cubeVertices.data());
+
+    MeshVector<SimpleVertexNormal> groundVertices;
+    GeneratePlaneVertices(10, 10, 11, 11, groundVertices);
+    RhiBufferDesc groundDesc = { RHI_BUFFER_VERTEX, (UINT)(sizeof(SimpleVertexNormal) * groundVertices.size()), sizeof(SimpleVertexNormal) };
+    _groundVertexBuffer = _device.CreateBuffer(groundDesc, groundVertices.data());
+
+    MeshVector<WORD> groundIndices;
+    GeneratePlaneIndices(11, 11, groundIndices);
+    _groundIndexCount = (UINT)groundIndices.size();
+    RhiBufferDesc indexDesc = { RHI_BUFFER_INDEX, (UINT)sizeof(WORD) * _groundIndexCount, sizeof(WORD) };
+    _groundIndexBuffer = _device.CreateBuffer(indexDesc, groundIndices.data());
+
+    if (!_pipeline || !_constantBuffer || !_cubeVertexBuffer || !_groundVertexBuffer || !_groundIndexBuffer)
+        return E_FAIL;
+
+    // The crate on its own rather than through the texture packer, so the uv transform
+    // is the identity
+    unique_ptr<uint8_t[]> ddsData;
+    D3D11_TEXTURE2D_DESC textureDesc;
+    vector<D3D11_SUBRESOURCE_DATA> initData;
+    HRESULT hr = LoadDDSTextureDataFromFile(L"Crate_COLOR.dds", ddsData, &textureDesc, initData);
+    if (FAILED(hr))
+        return hr;
+
+    vector<RhiSubresourceData> subresources(initData.size());
+    for (size_t i = 0; i < initData.size(); ++i)
+        subresources[i] = { initData[i].pSysMem, initData[i].SysMemPitch };
+
+    RhiTextureDesc crateDesc = { textureDesc.Width, textureDesc.Height, textureDesc.MipLevels, textureDesc.ArraySize,
+                                 (RhiFormat)textureDesc.Format };
+    _crateTexture = _device.CreateTexture(crateDesc, subresources.data());
+
+    return _crateTexture ? S_OK : E_FAIL;
+}
+
+HRESULT SoftwareViewer::InitWindow(HINSTANCE hInstance, int nCmdShow)
+{
+    // Register class
+    WNDCLASSEX wcex;
+    wcex.cbSize = sizeof(WNDCLASSEX);
+    wcex.style = CS_HREDRAW | CS_VREDRAW;
+    wcex.lpfnWndProc = SoftwareViewerWndProc;
+    wcex.cbClsExtra = 0;
+    wcex.cbWndExtra = 0;
+    wcex.hInstance = hInstance;
+    wcex.hIcon = LoadIcon(hInstance, (LPCTSTR)IDI_TUTORIAL1);
+    wcex.hCursor = LoadCursor(NULL, IDC_ARROW);
+    wcex.hbrBackground = nullptr;
+    wcex.lpszMenuName = nullptr;
+    wcex.lpszClassName = L"SoftwareViewerWindowClass";
+    wcex.hIconSm = LoadIcon(wcex.hInstance, (LPCTSTR)IDI_TUTORIAL1);
+    if (!RegisterClassEx(&wcex))
+        return E_FAIL;
+
+    // Create window
+    RECT rc = { 0, 0, (LONG)_width, (LONG)_height };
+    AdjustWindowRect(&rc, WS_OVERLAPPEDWINDOW, FALSE);
+    _hWnd = CreateWindow(L"SoftwareViewerWindowClass", L"DX11 Framework (software)", WS_OVERLAPPEDWINDOW,
+                         CW_USEDEFAULT, CW_USEDEFAULT, rc.right - rc.left, rc.bottom - rc.top, nullptr, nullptr, hInstance,
+                         nullptr);
+    if (!_hWnd)
+        return E_FAIL;
+
+    ShowWindow(_hWnd, nCmdShow);
+
+    return S_OK;
+}
+
+HRESULT SoftwareViewer::Run(HINSTANCE hInstance, int nCmdShow)
+{
+    HRESULT hr = InitWindow(hInstance, nCmdShow);
+    if (FAILED(hr))
+        return hr;
+
+    DWORD timeStart = GetTickCount();
+    DWORD titleTime = timeStart;
+    UINT titleFrames = 0;
+
+    // Main message loop
+    MSG msg = {0};
+
+    while (WM_QUIT != msg.message)
+    {
+        if (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
+        {
+            TranslateMessage(&msg);
+            DispatchMessage(&msg);
+            continue;
+        }
+
+        Update((GetTickCount() - timeStart) / 10000.0f);
+        Submit();
+        _device.Flush();
+        Present();
+
+        // Averaged over half a second, a frame can be shorter than the tick count's resolution
+        ++titleFrames;
+        DWORD now = GetTickCount();
+        if (now - titleTime >= 500)
+        {
+            wchar_t title[128];
+            swprintf_s(title, L"DX11 Framework (software) - %.2f ms", (now - titleTime) / (double)titleFrames);
+            SetWindowText(_hWnd, title);
+
+            titleTime = now;
+            titleFrames = 0;
+        }
+    }
+
+    return S_OK;
+}
+
+HRESULT SoftwareViewer::RunBenchmark(UINT warmupFrames, UINT measuredFrames, const wchar_t* outputFile)
+{
+    BenchmarkRecorder recorder;
+    for (const char* name : SOFTWARE_BENCHMARK_STAGE_NAMES)
+        recorder.AddStage(name);
+
+    // Every run starts from the same point of the animation and steps it as Application's
+    // fixed 60 Hz timestep does
+    const float timestep = 1.0f / 60.0f;
+    float time = 0.0f;
+    UINT triangles = 0;
+
+    RunBenchmarkFrames(recorder, warmupFrames, measuredFrames, [&](uint32_t)
+    {
+        time += timestep * 0.1f;
+        Update(time);
+        recorder.Mark(SOFTWARE_BENCHMARK_UPDATE);
+
+        Submit();
+        triangles = _device.GetRasterizer().GetTriangleCount();
+        recorder.Mark(SOFTWARE_BENCHMARK_SUBMIT);
+
+        _device.Flush();
+        recorder.Mark(SOFTWARE_BENCHMARK_RASTER);
+    });
+
+    vector<pair<string, string>> config;
+    config.push_back(make_pair("bodies", to_string(_worldMatrices.size())));
+    config.push_back(make_pair("warmup_frames", to_string(warmupFrames)));
+    config.push_back(make_pair("measured_frames", to_string(measuredFrames)));
+    config.push_back(make_pair("timestep", to_string(timestep)));
+    config.push_back(make_pair("width", to_string(_width)));
+    config.push_back(make_pair("height", to_string(_height)));
+    config.push_back(make_pair("driver", "\"software\""));
+    config.push_back(make_pair("threads", to_string(_jobs.GetThreadCount())));
+    config.push_back(make_pair("triangles", to_string(triangles)));
+
+    if (!recorder.WriteJson(outputFile, config))
+        return E_FAIL;
+
+    wchar_t line[256];
+    swprintf_s(line, L"software benchmark: %u bodies, %u triangles, %u threads, %u frames, median %.3f ms, p99 %.3f ms\n",
+               (UINT)_worldMatrices.size(), triangles, _jobs.GetThreadCount(), recorder.GetMeasuredFrames(),
+               recorder.GetPercentile(BenchmarkRecorder::FRAME, 50.0), recorder.GetPercentile(BenchmarkRecorder::FRAME, 99.0));
+    OutputDebugStringW(line);
+
+    return S_OK;
+}
+
+void SoftwareViewer::Update(float t)
+{
+    CPU_PROFILE_FUNCTION();
+
+    AnimateBodies(t, (float*)_worldMatrices.data(), (UINT)_worldMatrices.size());
+}
+
+void SoftwareViewer::Submit()
+{
+    CPU_PROFILE_FUNCTION();
+
+    float clearColour[4] = { 0.0f, 0.125f, 0.3f, 1.0f };
+    _device.Clear(clearColour, 1.0f);
+
+    RhiCommandList* commands = _device.GetImmediateCommandList();
+    commands->SetPipelineState(_pipeline);
+    commands->SetConstantBuffer(RHI_STAGE_VERTEX, 0, _constantBuffer);
+    commands->SetConstantBuffer(RHI_STAGE_PIXEL, 0, _constantBuffer);
+    commands->SetTexture(RHI_STAGE_PIXEL, 0, _crateTexture);
+
+    // The constants the forward pass gives every body and the ground
+    ConstantBuffer cb;
+    ZeroMemory(&cb, sizeof(cb));
+    cb.mView = XMMatrixTranspose(XMLoadFloat4x4(&_view));
+    cb.mProjection = XMMatrixTranspose(XMLoadFloat4x4(&_projection));
+    cb.LightVecW = SUN_DIRECTION;
+    cb.EyePosW = { 0, 0, 25 };
+    cb.AmbientMtrl = { 1,.2,.2,.2 };
+    cb.AmbientLight = { 1,.2,.2,.2 };
+    cb.DiffuseMtrl = { 1,.5,.4,.1 };
+    cb.DiffuseLight = { 0,0,0,1 };
+    cb.SpecularMtrl = { 1,.5,.5,.5 };
+    cb.SpecularLight = { 1,.8,.8,.8 };
+    cb.SpecularPower = 10;
+    cb.UVTransform = { 1, 1, 0, 0 };
+    cb.MaterialUVTransform = { 1, 1, 0, 0 };
+
+    // The app's pyramid buffer still holds position and colour vertices, which the scene
+    // layout can't read, so the pyramids are cubes here
+    commands->SetVertexBuffer(0, _cubeVertexBuffer, 0);
+    for (UINT i = 0; i < _worldMatrices.size(); i++)
+    {
+        cb.mWorld = XMMatrixTranspose(XMLoadFloat4x4(&_worldMatrices[i]));
+        commands->UpdateBuffer(_constantBuffer, &cb, sizeof(cb));
+        commands->Draw(36, 0);
+    }
+
+    cb.mWorld = XMMatrixTranspose(XMLoadFloat4x4(&_groundPlaneMatrix));
+    commands->UpdateBuffer(_constantBuffer, &cb, sizeof(cb));
+    commands->SetVertexBuffer(0, _groundVertexBuffer, 0);
+    commands->SetIndexBuffer(_groundIndexBuffer, 0);
+    commands->DrawIndexed(_groundIndexCount, 0, 0);
+}
+
+void SoftwareViewer::Present()
+{
+    const SoftwareRasterizer& rasterizer = _device.GetRasterizer();
+
+    // Top down, and as wide as the pitch so the rows line up
+    BITMAPINFO info;
+    ZeroMemory(&info, sizeof(info));
+    info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    info.bmiHeader.biWidth = rasterizer.GetPitch();
+    info.bmiHeader.biHeight = -(LONG)rasterizer.GetHeight();
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+
+    RECT client;
+    GetClientRect(_hWnd, &client);
+
+    HDC hdc = GetDC(_hWnd);
+    StretchDIBits(hdc, 0, 0, client.right, client.bottom, 0, 0, rasterizer.GetWidth(), rasterizer.GetHeight(),
+                  rasterizer.GetPixels(), &info, DIB_RGB_COLORS, SRCCOPY);
+    ReleaseDC(_hWnd, hdc);
+}
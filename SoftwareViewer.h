@@ -0,0 +1,62 @@
+#pragma once
+
+#include <windows.h>
+#include <directxmath.h>
+#include <vector>
+
+#include "RhiSoftware.h"
+#include "JobSystem.h"
+
+using namespace DirectX;
+using namespace std;
+
+// the forward scene drawn by SoftwareRhiDevice across the job system and shown with GDI,
+// for machines without a usable GPU and for timing the software rasteriser. same camera,
+// light, animation and crate texture as Application, but only the default shader
+// permutation (no normal map, shadows or point lights) and every body is a cube
+class SoftwareViewer
+{
+public:
+	SoftwareViewer();
+	~SoftwareViewer();
+
+	// bodyCount as Application::SetBodyCount
+	HRESULT Initialise(UINT width, UINT height, UINT bodyCount);
+
+	// draws into a window until it's closed, the frame time goes in the title
+	HRESULT Run(HINSTANCE hInstance, int nCmdShow);
+	// headless frames on a fixed 60 Hz clock, the same JSON as Application::RunBenchmark
+	// with "update", "submit" (vertex shading and binning) and "raster" stages
+	HRESULT RunBenchmark(UINT warmupFrames, UINT measuredFrames, const wchar_t* outputFile);
+
+private:
+	HRESULT InitWindow(HINSTANCE hInstance, int nCmdShow);
+	HRESULT InitScene();
+
+	void Update(float t);
+	// records the frame's draws, the pixels come at the device's Flush
+	void Submit();
+	void Present();
+
+	UINT _width;
+	UINT _height;
+	HWND _hWnd;
+
+	JobSystem _jobs;
+	SoftwareRhiDevice _device;
+
+	RhiShader* _vertexShader;
+	RhiShader* _pixelShader;
+	RhiPipelineState* _pipeline;
+	RhiBuffer* _constantBuffer;
+	RhiBuffer* _cubeVertexBuffer;
+	RhiBuffer* _groundVertexBuffer;
+	RhiBuffer* _groundIndexBuffer;
+	UINT _groundIndexCount;
+	RhiTexture* _crateTexture;
+
+	vector<XMFLOAT4X4> _worldMatrices;
+	XMFLOAT4X4 _groundPlaneMatrix;
+	XMFLOAT4X4 _view;
+	XMFLOAT4X4 _projection;
+};
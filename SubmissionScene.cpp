@@ -0,0 +1,92 @@
+#include "SubmissionScene.h"
+#include <string.h>
+
+bool CreateSubmissionScene(RhiDevice& device, SubmissionScene& scene)
+{
+    memset(&scene, 0, sizeof(scene));
+
+    // the null backend only checks the bytecode is there
+    static const uint8_t bytecode[4] = {};
+
+    RhiShaderDesc shaderDesc = { RHI_STAGE_VERTEX, bytecode, sizeof(bytecode) };
+    scene.VertexShader = device.CreateShader(shaderDesc);
+    shaderDesc.Stage = RHI_STAGE_PIXEL;
+    scene.PixelShader = device.CreateShader(shaderDesc);
+
+    RhiPipelineStateDesc pipelineDesc = {};
+    pipelineDesc.VertexShader = scene.VertexShader;
+    pipelineDesc.PixelShader = scene.PixelShader;
+    pipelineDesc.Elements[0] = { "POSITION", 0, RHI_FORMAT_R32G32B32_FLOAT, RHI_APPEND_ALIGNED };
+    pipelineDesc.Elements[1] = { "NORMAL", 0, RHI_FORMAT_R32G32B32A32_FLOAT, RHI_APPEND_ALIGNED };
+    pipelineDesc.Elements[2] = { "TEXCOORD", 0, RHI_FORMAT_R32G32_FLOAT, RHI_APPEND_ALIGNED };
+    pipelineDesc.Elements[3] = { "TANGENT", 0, RHI_FORMAT_R32G32B32A32_FLOAT, RHI_APPEND_ALIGNED };
+    pipelineDesc.ElementCount = 4;
+    pipelineDesc.DepthTest = true;
+    pipelineDesc.DepthWrite = true;
+    if (scene.VertexShader && scene.PixelShader)
+        scene.Pipeline = device.CreatePipelineState(pipelineDesc);
+
+    RhiBufferDesc constantDesc = { RHI_BUFFER_CONSTANT, SUBMISSION_CONSTANT_BYTES, 0 };
+    scene.Constants = device.CreateBuffer(constantDesc, nullptr);
+
+    scene.IndexCounts[0] = 36;
+    scene.IndexCounts[1] = 18;
+    bool created = scene.Pipeline && scene.Constants;
+    for (int mesh = 0; mesh < 2; ++mesh)
+    {
+        RhiBufferDesc vertexDesc = { RHI_BUFFER_VERTEX, 24 * SUBMISSION_VERTEX_BYTES, SUBMISSION_VERTEX_BYTES };
+        scene.VertexBuffers[mesh] = device.CreateBuffer(vertexDesc, nullptr);
+
+        RhiBufferDesc indexDesc = { RHI_BUFFER_INDEX, scene.IndexCounts[mesh] * (uint32_t)sizeof(uint16_t), sizeof(uint16_t) };
+        scene.IndexBuffers[mesh] = device.CreateBuffer(indexDesc, nullptr);
+
+        created &= scene.VertexBuffers[mesh] && scene.IndexBuffers[mesh];
+    }
+
+    if (!created)
+        DeleteSubmissionScene(scene);
+
+    return created;
+}
+
+void DeleteSubmissionScene(SubmissionScene& scene)
+{
+    for (int mesh = 0; mesh < 2; ++mesh)
+    {
+        delete scene.IndexBuffers[mesh];
+        delete scene.VertexBuffers[mesh];
+    }
+
+    delete scene.Constants;
+    delete scene.Pipeline;
+    delete scene.PixelShader;
+    delete scene.VertexShader;
+    memset(&scene, 0, sizeof(scene));
+}
+
+void SubmitBodies(RhiCommandList& commands, const SubmissionScene& scene, const float* worldMatrices, uint32_t count)
+{
+    uint8_t constants[SUBMISSION_CONSTANT_BYTES] = {};
+
+    commands.SetPipelineState(scene.Pipeline);
+    commands.SetConstantBuffer(RHI_STAGE_VERTEX, 0, scene.Constants);
+    commands.SetConstantBuffer(RHI_STAGE_PIXEL, 0, scene.Constants);
+
+    // constants for every body, the mesh only when it changes
+    int boundMesh = -1;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        memcpy(constants, worldMatrices + i * 16, 16 * sizeof(float));
+        commands.UpdateBuffer(scene.Constants, constants, sizeof(constants));
+
+        int mesh = i % 2;
+        if (mesh != boundMesh)
+        {
+            commands.SetVertexBuffer(0, scene.VertexBuffers[mesh], 0);
+            commands.SetIndexBuffer(scene.IndexBuffers[mesh], 0);
+            boundMesh = mesh;
+        }
+
+        commands.DrawIndexed(scene.IndexCounts[mesh], 0, 0);
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "Rhi.h"
+
+using namespace std;
+
+// the calls Application's Draw makes for the bodies, on any RHI device: one pipeline, the
+// constants for every body and a cube and a pyramid in turn. the buffers have the app's
+// sizes but no contents, for timing submission on the null and recording backends. free
+// of windows and d3d headers so SceneBenchmark builds anywhere
+
+// the size of Application's ConstantBuffer
+static const uint32_t SUBMISSION_CONSTANT_BYTES = 384;
+// SimpleVertexNormal: position, normal, uv and tangent
+static const uint32_t SUBMISSION_VERTEX_BYTES = 52;
+
+struct SubmissionScene
+{
+	RhiShader* VertexShader;
+	RhiShader* PixelShader;
+	RhiPipelineState* Pipeline;
+	RhiBuffer* Constants;
+	// a cube and a pyramid, as Draw alternates them
+	RhiBuffer* VertexBuffers[2];
+	RhiBuffer* IndexBuffers[2];
+	uint32_t IndexCounts[2];
+};
+
+// false when the device wouldn't create something, what it did create is deleted
+bool CreateSubmissionScene(RhiDevice& device, SubmissionScene& scene);
+void DeleteSubmissionScene(SubmissionScene& scene);
+
+// worldMatrices holds 16 floats a body, row major as XMFLOAT4X4 keeps them and
+// AnimateBodies writes them
+void SubmitBodies(RhiCommandList& commands, const SubmissionScene& scene, const float* worldMatrices, uint32_t count);
@@ -0,0 +1,152 @@
+#include "SwapChain.h"
+
+SwapChain::SwapChain()
+{
+    _swapChain = nullptr;
+    _frameLatencyWaitable = nullptr;
+    _syncInterval = 1;
+    _flipModel = false;
+    _tearing = false;
+}
+
+SwapChain::~SwapChain()
+{
+    Release();
+}
+
+HRESULT SwapChain::CreateSwapChain(ID3D11Device* device, IDXGIFactory2* factory, HWND window, UINT width, UINT height,
+                                   DXGI_SWAP_EFFECT effect, UINT bufferCount, UINT flags)
+{
+    DXGI_SWAP_CHAIN_DESC1 sd;
+    ZeroMemory(&sd, sizeof(sd));
+    sd.Width = width;
+    sd.Height = height;
+    sd.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    sd.SampleDesc.Count = 1;
+    sd.SampleDesc.Quality = 0;
+    sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+    sd.BufferCount = bufferCount;
+    sd.Scaling = DXGI_SCALING_STRETCH;
+    sd.SwapEffect = effect;
+    sd.AlphaMode = DXGI_ALPHA_MODE_UNSPECIFIED;
+    sd.Flags = flags;
+
+    return factory->CreateSwapChainForHwnd(device, window, &sd, nullptr, nullptr, &_swapChain);
+}
+
+HRESULT SwapChain::Create(ID3D11Device* device, HWND window, UINT width, UINT height, const SwapChainSettings& settings)
+{
+    Release();
+
+    // the factory that made the device's adapter
+    IDXGIDevice1* dxgiDevice = nullptr;
+    IDXGIAdapter* adapter = nullptr;
+    IDXGIFactory2* factory = nullptr;
+
+    HRESULT hr = device->QueryInterface(__uuidof(IDXGIDevice1), (void**)&dxgiDevice);
+    if (SUCCEEDED(hr))
+        hr = dxgiDevice->GetAdapter(&adapter);
+    if (SUCCEEDED(hr))
+        hr = adapter->GetParent(__uuidof(IDXGIFactory2), (void**)&factory);
+
+    if (FAILED(hr))
+    {
+        if (adapter) adapter->Release();
+        if (dxgiDevice) dxgiDevice->Release();
+        return hr;
+    }
+
+    // tearing needs windows 10 and a driver that can do it, variable refresh displays
+    // only kick in with it
+    BOOL tearingSupported = FALSE;
+    IDXGIFactory5* factory5 = nullptr;
+    if (settings.AllowTearing && SUCCEEDED(factory->QueryInterface(__uuidof(IDXGIFactory5), (void**)&factory5)))
+    {
+        if (FAILED(factory5->CheckFeatureSupport(DXGI_FEATURE_PRESENT_ALLOW_TEARING, &tearingSupported, sizeof(tearingSupported))))
+            tearingSupported = FALSE;
+        factory5->Release();
+    }
+
+    UINT bufferCount = min(max(settings.BufferCount, 2u), 3u);
+    UINT flags = DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
+    if (tearingSupported)
+        flags |= DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING;
+
+    _flipModel = true;
+    hr = CreateSwapChain(device, factory, window, width, height, DXGI_SWAP_EFFECT_FLIP_DISCARD, bufferCount, flags);
+
+    // flip discard is windows 10 only, flip sequential windows 8
+    if (FAILED(hr))
+    {
+        tearingSupported = FALSE;
+        hr = CreateSwapChain(device, factory, window, width, height, DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL, bufferCount,
+                             DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT);
+    }
+
+    if (FAILED(hr))
+    {
+        _flipModel = false;
+        hr = CreateSwapChain(device, factory, window, width, height, DXGI_SWAP_EFFECT_DISCARD, 1, 0);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        _tearing = tearingSupported != FALSE;
+        _syncInterval = settings.SyncInterval;
+
+        // alt-enter fullscreen would turn tearing off behind our back
+        if (_tearing)
+            factory->MakeWindowAssociation(window, DXGI_MWA_NO_ALT_ENTER);
+
+        IDXGISwapChain2* swapChain2 = nullptr;
+        if (_flipModel && SUCCEEDED(_swapChain->QueryInterface(__uuidof(IDXGISwapChain2), (void**)&swapChain2)))
+        {
+            swapChain2->SetMaximumFrameLatency(max(settings.MaxFrameLatency, 1u));
+            _frameLatencyWaitable = swapChain2->GetFrameLatencyWaitableObject();
+            swapChain2->Release();
+        }
+        else
+        {
+            // no waitable, at least keep the queue short
+            dxgiDevice->SetMaximumFrameLatency(max(settings.MaxFrameLatency, 1u));
+        }
+    }
+
+    factory->Release();
+    adapter->Release();
+    dxgiDevice->Release();
+
+    return hr;
+}
+
+void SwapChain::Release()
+{
+    if (_frameLatencyWaitable) CloseHandle(_frameLatencyWaitable);
+    if (_swapChain) _swapChain->Release();
+
+    _frameLatencyWaitable = nullptr;
+    _swapChain = nullptr;
+}
+
+void SwapChain::WaitForNextFrame(DWORD timeoutMs)
+{
+    if (_frameLatencyWaitable)
+        WaitForSingleObjectEx(_frameLatencyWaitable, timeoutMs, TRUE);
+}
+
+HRESULT SwapChain::Present()
+{
+    // tearing is only allowed with no vsync
+    UINT flags = (_tearing && _syncInterval == 0) ? DXGI_PRESENT_ALLOW_TEARING : 0;
+    return _swapChain->Present(_syncInterval, flags);
+}
+
+HRESULT SwapChain::TestPresent()
+{
+    return _swapChain->Present(0, DXGI_PRESENT_TEST);
+}
+
+HRESULT SwapChain::GetBackBuffer(ID3D11Texture2D** backBuffer)
+{
+    return _swapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (void**)backBuffer);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <windows.h>
+#include <d3d11_1.h>
+#include <dxgi1_5.h>
+
+struct SwapChainSettings
+{
+	// 2 or 3, flip model needs at least two
+	UINT BufferCount;
+	// frames the cpu may queue ahead of the display, 1 is the lowest latency
+	UINT MaxFrameLatency;
+	// 0 presents straight away, tearing if the display allows it, 1 waits for vblank
+	UINT SyncInterval;
+	bool AllowTearing;
+};
+
+// flip model swap chain with a frame latency waitable object. the render loop blocks on
+// the waitable before it starts a frame instead of inside Present, so input is read as
+// late as possible and no more than MaxFrameLatency frames are ever queued. falls back
+// to flip sequential and then the legacy blit model on older versions of windows
+class SwapChain
+{
+public:
+	SwapChain();
+	~SwapChain();
+
+	HRESULT Create(ID3D11Device* device, HWND window, UINT width, UINT height, const SwapChainSettings& settings);
+	void Release();
+
+	// sleeps until DXGI can take another frame, returns at once without a waitable object
+	void WaitForNextFrame(DWORD timeoutMs = 1000);
+	HRESULT Present();
+	// asks whether a present would be seen without presenting anything,
+	// DXGI_STATUS_OCCLUDED while the window is covered or the screen locked
+	HRESULT TestPresent();
+
+	// current back buffer, flip model unbinds it from the pipeline on every Present
+	HRESULT GetBackBuffer(ID3D11Texture2D** backBuffer);
+
+	bool IsFlipModel() const { return _flipModel; }
+	bool IsTearingEnabled() const { return _tearing; }
+
+private:
+	HRESULT CreateSwapChain(ID3D11Device* device, IDXGIFactory2* factory, HWND window, UINT width, UINT height,
+	                        DXGI_SWAP_EFFECT effect, UINT bufferCount, UINT flags);
+
+	IDXGISwapChain1* _swapChain;
+	HANDLE _frameLatencyWaitable;
+	UINT _syncInterval;
+	bool _flipModel;
+	bool _tearing;
+};
@@ -0,0 +1,60 @@
+#include "SystemFrameClock.h"
+
+#pragma comment(lib, "winmm.lib")
+
+// Windows 10 1803 and later, older SDKs don't define it
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+//--------------------------------------------------------------------------------------
+// SystemFrameClock
+//--------------------------------------------------------------------------------------
+SystemFrameClock::SystemFrameClock()
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    _secondsPerTick = 1.0 / frequency.QuadPart;
+
+    _timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    _highResolution = _timer != nullptr;
+
+    // the plain timer only wakes on the system tick, so shorten the tick
+    if (!_highResolution)
+    {
+        _timer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+        timeBeginPeriod(1);
+    }
+}
+
+SystemFrameClock::~SystemFrameClock()
+{
+    if (!_highResolution)
+        timeEndPeriod(1);
+
+    if (_timer) CloseHandle(_timer);
+}
+
+double SystemFrameClock::Now()
+{
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart * _secondsPerTick;
+}
+
+bool SystemFrameClock::SleepFor(double seconds)
+{
+    // relative due times are negative, in 100ns units
+    LARGE_INTEGER due;
+    due.QuadPart = -(LONGLONG)(seconds * 10000000.0);
+
+    if (_timer && SetWaitableTimerEx(_timer, &due, 0, nullptr, nullptr, nullptr, 0))
+        return MsgWaitForMultipleObjectsEx(1, &_timer, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE) == WAIT_OBJECT_0;
+
+    return MsgWaitForMultipleObjectsEx(0, nullptr, (DWORD)(seconds * 1000.0), QS_ALLINPUT, MWMO_INPUTAVAILABLE) == WAIT_TIMEOUT;
+}
+
+void SystemFrameClock::Spin()
+{
+    YieldProcessor();
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <windows.h>
+#include "FrameScheduler.h"
+
+// QueryPerformanceCounter for the time and a high resolution waitable timer (or a 1ms
+// timer period on older windows) to sleep on. sleeps wake early for window messages
+class SystemFrameClock : public FrameClock
+{
+public:
+	SystemFrameClock();
+	~SystemFrameClock();
+
+	double Now() override;
+	bool SleepFor(double seconds) override;
+	void Spin() override;
+
+	bool IsHighResolution() const { return _highResolution; }
+
+private:
+	double _secondsPerTick;
+	HANDLE _timer;
+	bool _highResolution;
+};
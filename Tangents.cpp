@@ -0,0 +1,100 @@
+#include "Tangents.h"
+#include <vector>
+
+using namespace std;
+
+static XMVECTOR LoadAttribute3(const uint8_t* vertex, UINT offset)
+{
+    return XMLoadFloat3((const XMFLOAT3*)(vertex + offset));
+}
+
+static XMVECTOR LoadAttribute2(const uint8_t* vertex, UINT offset)
+{
+    return XMLoadFloat2((const XMFLOAT2*)(vertex + offset));
+}
+
+// v projected into the plane with normal n and normalised, zero if nothing is left
+static XMVECTOR ProjectOntoPlane(FXMVECTOR v, FXMVECTOR n)
+{
+    XMVECTOR projected = XMVectorSubtract(v, XMVectorMultiply(n, XMVector3Dot(n, v)));
+    if (XMVectorGetX(XMVector3LengthSq(projected)) < 1e-12f)
+        return XMVectorZero();
+
+    return XMVector3Normalize(projected);
+}
+
+void GenerateTangents(void* vertices, UINT vertexCount, const WORD* indices, UINT indexCount, const TangentVertexLayout& layout)
+{
+    uint8_t* base = (uint8_t*)vertices;
+    vector<XMFLOAT3> tangents(vertexCount, XMFLOAT3(0, 0, 0));
+    vector<XMFLOAT3> bitangents(vertexCount, XMFLOAT3(0, 0, 0));
+
+    for (UINT triangle = 0; triangle + 2 < indexCount; triangle += 3)
+    {
+        UINT corner[3];
+        for (UINT i = 0; i < 3; ++i)
+            corner[i] = indices ? indices[triangle + i] : triangle + i;
+
+        if (corner[0] >= vertexCount || corner[1] >= vertexCount || corner[2] >= vertexCount)
+            continue;
+
+        const uint8_t* v[3];
+        XMVECTOR p[3], uv[3];
+        for (UINT i = 0; i < 3; ++i)
+        {
+            v[i] = base + corner[i] * layout.Stride;
+            p[i] = LoadAttribute3(v[i], layout.PositionOffset);
+            uv[i] = LoadAttribute2(v[i], layout.TexCoordOffset);
+        }
+
+        XMVECTOR e1 = XMVectorSubtract(p[1], p[0]);
+        XMVECTOR e2 = XMVectorSubtract(p[2], p[0]);
+        XMFLOAT2 d1, d2;
+        XMStoreFloat2(&d1, XMVectorSubtract(uv[1], uv[0]));
+        XMStoreFloat2(&d2, XMVectorSubtract(uv[2], uv[0]));
+
+        // degenerate in uv, nothing to say about the tangent
+        float area = d1.x * d2.y - d2.x * d1.y;
+        if (fabsf(area) < 1e-12f)
+            continue;
+
+        // the sign of the uv area carries the winding, the length does not matter as
+        // each corner normalises after projecting
+        float sign = area > 0.0f ? 1.0f : -1.0f;
+        XMVECTOR faceTangent = XMVectorScale(XMVectorSubtract(XMVectorScale(e1, d2.y), XMVectorScale(e2, d1.y)), sign);
+        XMVECTOR faceBitangent = XMVectorScale(XMVectorSubtract(XMVectorScale(e2, d1.x), XMVectorScale(e1, d2.x)), sign);
+
+        for (UINT i = 0; i < 3; ++i)
+        {
+            XMVECTOR toNext = XMVector3Normalize(XMVectorSubtract(p[(i + 1) % 3], p[i]));
+            XMVECTOR toPrev = XMVector3Normalize(XMVectorSubtract(p[(i + 2) % 3], p[i]));
+            float angle = XMVectorGetX(XMVector3AngleBetweenNormals(toNext, toPrev));
+
+            XMVECTOR n = XMVector3Normalize(LoadAttribute3(v[i], layout.NormalOffset));
+            XMVECTOR t = XMVectorScale(ProjectOntoPlane(faceTangent, n), angle);
+            XMVECTOR b = XMVectorScale(ProjectOntoPlane(faceBitangent, n), angle);
+
+            XMStoreFloat3(&tangents[corner[i]], XMVectorAdd(XMLoadFloat3(&tangents[corner[i]]), t));
+            XMStoreFloat3(&bitangents[corner[i]], XMVectorAdd(XMLoadFloat3(&bitangents[corner[i]]), b));
+        }
+    }
+
+    for (UINT i = 0; i < vertexCount; ++i)
+    {
+        uint8_t* vertex = base + i * layout.Stride;
+        XMVECTOR n = XMVector3Normalize(LoadAttribute3(vertex, layout.NormalOffset));
+        XMVECTOR t = ProjectOntoPlane(XMLoadFloat3(&tangents[i]), n);
+
+        // unused or uv degenerate vertices still get a valid frame
+        if (XMVector3Equal(t, XMVectorZero()))
+        {
+            XMVECTOR axis = fabsf(XMVectorGetX(n)) < 0.9f ? XMVectorSet(1, 0, 0, 0) : XMVectorSet(0, 1, 0, 0);
+            t = ProjectOntoPlane(axis, n);
+        }
+
+        float w = XMVectorGetX(XMVector3Dot(XMVector3Cross(n, t), XMLoadFloat3(&bitangents[i]))) < 0.0f ? -1.0f : 1.0f;
+
+        XMFLOAT4* tangent = (XMFLOAT4*)(vertex + layout.TangentOffset);
+        XMStoreFloat4(tangent, XMVectorSetW(t, w));
+    }
+}
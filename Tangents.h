@@ -0,0 +1,24 @@
+#pragma once
+
+#include <windows.h>
+#include <directxmath.h>
+
+using namespace DirectX;
+
+// where GenerateTangents finds each attribute inside a vertex, offsetof of the vertex struct's members.
+// position is an XMFLOAT3, normal the xyz of an XMFLOAT3/4, texcoord an XMFLOAT2 and tangent an XMFLOAT4
+struct TangentVertexLayout
+{
+	UINT Stride;
+	UINT PositionOffset;
+	UINT NormalOffset;
+	UINT TexCoordOffset;
+	UINT TangentOffset;
+};
+
+// MikkTSpace style tangent frames. every triangle's uv derivative is projected into the
+// plane of each corner's normal and added in weighted by the corner angle, so shared
+// vertices agree whatever order the triangles come in. tangent.w is the bitangent sign,
+// the shader rebuilds the bitangent per pixel as w * cross(normal, tangent) without
+// normalising anything first. indices may be null for a plain triangle list
+void GenerateTangents(void* vertices, UINT vertexCount, const WORD* indices, UINT indexCount, const TangentVertexLayout& layout);
@@ -0,0 +1,258 @@
+#include "Test.h"
+#include "ApiTrace.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static const wchar_t* TRACE_FILE = L"_apitrace_test.aptr";
+static const char* TRACE_PATH = "_apitrace_test.aptr";
+
+static vector<uint8_t> ReadFile(const char* path)
+{
+	vector<uint8_t> data;
+	FILE* file = fopen(path, "rb");
+	if (!file)
+		return data;
+
+	uint8_t buffer[4096];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		data.insert(data.end(), buffer, buffer + read);
+	fclose(file);
+	return data;
+}
+
+static void WriteFile(const char* path, const vector<uint8_t>& data)
+{
+	FILE* file = fopen(path, "wb");
+	if (file)
+	{
+		fwrite(data.data(), 1, data.size(), file);
+		fclose(file);
+	}
+}
+
+static void Object(ApiTraceWriter& writer, uint64_t id, ApiObjectKind kind, uint64_t bytes)
+{
+	writer.Begin(API_CALL_OBJECT);
+	writer.PutUInt(id);
+	writer.PutUInt(kind);
+	writer.PutUInt(bytes);
+	for (int i = 0; i < 4; ++i)
+		writer.PutUInt(0);
+	writer.End();
+}
+
+// two frames of: bind a vertex and an index buffer, a triangle list, clear a 640x480
+// target, an indexed draw of a cube, ten instances of a triangle and a 64 byte update
+static void WriteScene(ApiTraceWriter& writer)
+{
+	Object(writer, 1, API_OBJECT_BUFFER, 1200);
+	Object(writer, 2, API_OBJECT_BUFFER, 72);
+	Object(writer, 3, API_OBJECT_RENDER_TARGET_VIEW, 640 * 480 * 4);
+
+	uint8_t constants[64] = {};
+	for (uint64_t frame = 0; frame < 2; ++frame)
+	{
+		writer.Begin(API_CALL_FRAME);
+		writer.PutUInt(frame);
+		writer.End();
+
+		writer.Begin(API_CALL_SET_VERTEX_BUFFERS);
+		writer.PutUInt(0);
+		writer.PutUInt(1);
+		writer.PutUInt(1);
+		writer.PutUInt(32);
+		writer.PutUInt(0);
+		writer.End();
+
+		// R16_UINT
+		writer.Begin(API_CALL_SET_INDEX_BUFFER);
+		writer.PutUInt(2);
+		writer.PutUInt(57);
+		writer.PutUInt(0);
+		writer.End();
+
+		writer.Begin(API_CALL_SET_PRIMITIVE_TOPOLOGY);
+		writer.PutUInt(4);
+		writer.End();
+
+		writer.Begin(API_CALL_CLEAR_RENDER_TARGET);
+		writer.PutUInt(3);
+		for (int i = 0; i < 4; ++i)
+			writer.PutFloat(0.5f);
+		writer.End();
+
+		writer.Begin(API_CALL_DRAW_INDEXED);
+		writer.PutUInt(36);
+		writer.PutUInt(0);
+		writer.PutInt(0);
+		writer.End();
+
+		writer.Begin(API_CALL_DRAW_INSTANCED);
+		writer.PutUInt(3);
+		writer.PutUInt(10);
+		writer.PutUInt(0);
+		writer.PutUInt(0);
+		writer.End();
+
+		writer.Begin(API_CALL_UPDATE_SUBRESOURCE);
+		writer.PutUInt(1);
+		writer.PutUInt(0);
+		writer.PutUInt(0);
+		writer.PutUInt(0);
+		writer.PutUInt(0);
+		writer.PutBytes(constants, sizeof(constants));
+		writer.End();
+	}
+}
+
+static void TestFileLayout()
+{
+	// the header and floats are little endian whatever the host
+	ApiTraceWriter writer;
+	CHECK(writer.Open(TRACE_FILE));
+	writer.Begin(API_CALL_SET_MIN_LOD);
+	writer.PutUInt(300);
+	writer.PutFloat(1.0f);
+	writer.End();
+	writer.Close();
+
+	vector<uint8_t> data = ReadFile(TRACE_PATH);
+	const uint8_t expected[] = { 'A', 'P', 'T', 'R', 1, 0, 0, 0, API_CALL_SET_MIN_LOD, 6, 0xac, 0x02, 0x00, 0x00, 0x80, 0x3f };
+	CHECK(data.size() == sizeof(expected));
+	CHECK(data.size() == sizeof(expected) && memcmp(data.data(), expected, sizeof(expected)) == 0);
+}
+
+static void TestRecordFields()
+{
+	ApiTraceWriter writer;
+	CHECK(writer.Open(TRACE_FILE));
+	writer.Begin(API_CALL_MAP);
+	writer.PutUInt(0);
+	writer.PutUInt(0xffffffffffffffffull);
+	writer.PutInt(-1);
+	writer.PutInt(-9000000000ll);
+	writer.PutFloat(-2.75f);
+	writer.PutBytes("abc", 3);
+	writer.PutBytes(nullptr, 0);
+	writer.End();
+	writer.Begin(API_CALL_FLUSH);
+	writer.End();
+	writer.Close();
+
+	ApiTraceReader reader;
+	CHECK(reader.Open(TRACE_FILE));
+	ApiTraceRecord record;
+	CHECK(reader.Next(record));
+	CHECK(record.Call == API_CALL_MAP);
+	CHECK(record.GetUInt() == 0);
+	CHECK(record.GetUInt() == 0xffffffffffffffffull);
+	CHECK(record.GetInt() == -1);
+	CHECK(record.GetInt() == -9000000000ll);
+	CHECK(record.GetFloat() == -2.75f);
+	size_t bytes;
+	const uint8_t* data = record.GetBytes(&bytes);
+	CHECK(bytes == 3 && data && memcmp(data, "abc", 3) == 0);
+	record.GetBytes(&bytes);
+	CHECK(bytes == 0 && !record.Overrun());
+
+	// reading past the end gives nothing and says so
+	CHECK(record.GetUInt() == 0);
+	CHECK(record.Overrun());
+
+	CHECK(reader.Next(record) && record.Call == API_CALL_FLUSH && record.Size == 0);
+	CHECK(!reader.Next(record));
+	CHECK(!reader.IsTruncated());
+}
+
+static void TestAnalysis()
+{
+	ApiTraceWriter writer;
+	CHECK(writer.Open(TRACE_FILE));
+	WriteScene(writer);
+	writer.Close();
+
+	ApiTraceStats stats;
+	CHECK(AnalyseApiTrace(TRACE_FILE, stats));
+	CHECK(stats.TraceBytes == writer.GetBytesWritten());
+	CHECK(stats.Frames == 2 && stats.Objects == 3);
+	CHECK(stats.UnknownObjects == 0 && stats.BadRecords == 0);
+
+	// the second frame sets what the first did
+	CHECK(stats.Calls[API_CALL_SET_VERTEX_BUFFERS] == 2 && stats.RedundantCalls[API_CALL_SET_VERTEX_BUFFERS] == 1);
+	CHECK(stats.Calls[API_CALL_SET_INDEX_BUFFER] == 2 && stats.RedundantCalls[API_CALL_SET_INDEX_BUFFER] == 1);
+	CHECK(stats.Calls[API_CALL_SET_PRIMITIVE_TOPOLOGY] == 2 && stats.RedundantCalls[API_CALL_SET_PRIMITIVE_TOPOLOGY] == 1);
+
+	// a frame: 12 + 10 triangles, 36 + 30 vertices of 32 bytes, 36 16 bit indices
+	CHECK(stats.Draws == 4);
+	CHECK(stats.Primitives == 2 * 22);
+	CHECK(stats.VertexBytes == 2 * 66 * 32);
+	CHECK(stats.IndexBytes == 2 * 36 * 2);
+	CHECK(stats.ClearBytes == 2 * 640 * 480 * 4);
+	CHECK(stats.UploadBytes == 2 * 64);
+	CHECK(stats.ReadbackBytes == 0 && stats.CopyBytes == 0);
+
+	string report = FormatApiTraceReport(stats);
+	CHECK(report.find("api trace: 2 frames, " + to_string(stats.TraceBytes) + " bytes, 3 objects\n") == 0);
+	CHECK(report.find("per frame: 7.0 calls, 2.0 draws, 22.0 primitives, 50.0% of state sets redundant\n") != string::npos);
+	CHECK(report.find("set_primitive_topology") != string::npos);
+	CHECK(report.find("warning") == string::npos);
+}
+
+static void TestDamagedTraces()
+{
+	ApiTraceWriter writer;
+	CHECK(writer.Open(TRACE_FILE));
+	WriteScene(writer);
+	writer.Close();
+	vector<uint8_t> data = ReadFile(TRACE_PATH);
+
+	// a capture cut off mid record keeps everything before it, and counts the rest as bad
+	vector<uint8_t> cut(data.begin(), data.end() - 10);
+	WriteFile(TRACE_PATH, cut);
+	ApiTraceStats stats;
+	CHECK(AnalyseApiTrace(TRACE_FILE, stats));
+	CHECK(stats.BadRecords == 1);
+	CHECK(stats.Frames == 2 && stats.Draws == 4);
+	CHECK(stats.UploadBytes == 64);
+	CHECK(FormatApiTraceReport(stats).find("warning: 0 uses of undescribed objects, 1 bad records\n") != string::npos);
+
+	// ids nothing described are counted
+	CHECK(writer.Open(TRACE_FILE));
+	writer.Begin(API_CALL_SET_INPUT_LAYOUT);
+	writer.PutUInt(9);
+	writer.End();
+	writer.Close();
+	CHECK(AnalyseApiTrace(TRACE_FILE, stats));
+	CHECK(stats.UnknownObjects == 1 && stats.BadRecords == 0);
+
+	// another version, or not a trace at all, isn't read
+	vector<uint8_t> version = data;
+	version[4] = 2;
+	WriteFile(TRACE_PATH, version);
+	CHECK(!AnalyseApiTrace(TRACE_FILE, stats));
+	vector<uint8_t> bigEndian = data;
+	bigEndian[4] = 0;
+	bigEndian[7] = 1;
+	WriteFile(TRACE_PATH, bigEndian);
+	CHECK(!AnalyseApiTrace(TRACE_FILE, stats));
+	WriteFile(TRACE_PATH, vector<uint8_t>(data.begin(), data.begin() + 6));
+	CHECK(!AnalyseApiTrace(TRACE_FILE, stats));
+
+	remove(TRACE_PATH);
+	CHECK(!AnalyseApiTrace(TRACE_FILE, stats));
+}
+
+int main()
+{
+	RUN_TEST(TestFileLayout);
+	RUN_TEST(TestRecordFields);
+	RUN_TEST(TestAnalysis);
+	RUN_TEST(TestDamagedTraces);
+	return TestResult();
+}
@@ -0,0 +1,190 @@
+#include "Test.h"
+#include "Benchmark.h"
+#include "RhiNull.h"
+#include "RhiRecording.h"
+#include "SceneAnimation.h"
+#include "SubmissionScene.h"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// frame times of 1 to 100ms in a shuffled order, the two stages splitting each a quarter
+// and three quarters
+static void AddSeries(BenchmarkRecorder& recorder)
+{
+	for (int i = 0; i < 100; ++i)
+	{
+		double frameMs = i * 37 % 100 + 1;
+		double stageMs[2] = { frameMs * 0.25, frameMs * 0.75 };
+		recorder.AddFrame(frameMs, stageMs);
+	}
+}
+
+static void TestPercentiles()
+{
+	BenchmarkRecorder recorder;
+	uint32_t update = recorder.AddStage("update");
+	uint32_t draw = recorder.AddStage("draw");
+	CHECK(recorder.GetPercentile(BenchmarkRecorder::FRAME, 50.0) == 0.0);
+	CHECK(recorder.GetMean(BenchmarkRecorder::FRAME) == 0.0);
+
+	// warm-up frames aren't kept
+	double stageMs[2] = { 1000.0, 1000.0 };
+	recorder.AddFrame(2000.0, stageMs);
+	CHECK(recorder.GetMeasuredFrames() == 0);
+
+	recorder.SetMeasuring(true);
+	AddSeries(recorder);
+	CHECK(recorder.GetMeasuredFrames() == 100);
+
+	// nearest rank: the value a percentile of the frames are under
+	CHECK(recorder.GetPercentile(BenchmarkRecorder::FRAME, 0.0) == 1.0);
+	CHECK(recorder.GetPercentile(BenchmarkRecorder::FRAME, 50.0) == 51.0);
+	CHECK(recorder.GetPercentile(BenchmarkRecorder::FRAME, 90.0) == 91.0);
+	CHECK(recorder.GetPercentile(BenchmarkRecorder::FRAME, 99.0) == 100.0);
+	CHECK(recorder.GetPercentile(BenchmarkRecorder::FRAME, 100.0) == 100.0);
+	CHECK_NEAR(recorder.GetMean(BenchmarkRecorder::FRAME), 50.5, 1e-12);
+
+	CHECK(recorder.GetPercentile(update, 50.0) == 51.0 * 0.25);
+	CHECK(recorder.GetPercentile(draw, 90.0) == 91.0 * 0.75);
+	CHECK_NEAR(recorder.GetMean(draw), 50.5 * 0.75, 1e-12);
+
+	// a single slow frame is the max but moves nothing below p99
+	double slowMs[2] = { 0.0, 500.0 };
+	recorder.AddFrame(500.0, slowMs);
+	CHECK(recorder.GetPercentile(BenchmarkRecorder::FRAME, 100.0) == 500.0);
+	CHECK(recorder.GetPercentile(BenchmarkRecorder::FRAME, 95.0) == 96.0);
+
+	recorder.Reset();
+	CHECK(recorder.GetMeasuredFrames() == 0);
+	CHECK(recorder.GetStageCount() == 2);
+}
+
+static void TestJson()
+{
+	BenchmarkRecorder recorder;
+	recorder.AddStage("update");
+	recorder.AddStage("draw");
+	recorder.SetMeasuring(true);
+	AddSeries(recorder);
+
+	vector<pair<string, string>> config;
+	config.push_back(make_pair("bodies", "5"));
+	config.push_back(make_pair("driver", "\"null\""));
+
+	CHECK(recorder.FormatJson(config) ==
+		"{\n"
+		"\"config\": {\"bodies\": 5, \"driver\": \"null\"},\n"
+		"\"frames\": 100,\n"
+		"\"frame_ms\": {\"mean\": 50.5000, \"p50\": 51.0000, \"p90\": 91.0000, \"p95\": 96.0000, \"p99\": 100.0000, \"max\": 100.0000},\n"
+		"\"stages\": {\n"
+		"\"update\": {\"mean\": 12.6250, \"p50\": 12.7500, \"p90\": 22.7500, \"p95\": 24.0000, \"p99\": 25.0000, \"max\": 25.0000},\n"
+		"\"draw\": {\"mean\": 37.8750, \"p50\": 38.2500, \"p90\": 68.2500, \"p95\": 72.0000, \"p99\": 75.0000, \"max\": 75.0000}\n"
+		"}\n"
+		"}\n");
+
+	// and the same text in the file
+	const wchar_t* fileName = L"_benchmark_test.json";
+	CHECK(recorder.WriteJson(fileName, config));
+	FILE* file = fopen("_benchmark_test.json", "r");
+	CHECK(file != nullptr);
+	if (file)
+	{
+		string text;
+		char buffer[256];
+		size_t read;
+		while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			text.append(buffer, read);
+		fclose(file);
+		CHECK(text == recorder.FormatJson(config));
+	}
+	remove("_benchmark_test.json");
+}
+
+static void TestRunner()
+{
+	BenchmarkRecorder recorder;
+	uint32_t first = recorder.AddStage("first");
+	uint32_t second = recorder.AddStage("second");
+
+	vector<uint32_t> frames;
+	RunBenchmarkFrames(recorder, 5, 10, [&](uint32_t frame)
+	{
+		frames.push_back(frame);
+		recorder.Mark(first);
+		recorder.Mark(second);
+	});
+
+	// every frame runs, only those after the warm-up are kept
+	CHECK(frames.size() == 15);
+	for (size_t i = 0; i < frames.size(); ++i)
+		CHECK(frames[i] == i);
+	CHECK(recorder.GetMeasuredFrames() == 10);
+
+	// the stages add up to no more than the frame
+	double stages = recorder.GetMean(first) + recorder.GetMean(second);
+	CHECK(stages >= 0.0 && stages <= recorder.GetMean(BenchmarkRecorder::FRAME));
+
+	// and nothing is kept once it's done
+	recorder.BeginFrame();
+	recorder.EndFrame();
+	CHECK(recorder.GetMeasuredFrames() == 10);
+}
+
+static void TestNullScene()
+{
+	// the loop SceneBenchmark runs, submitted directly and through a recording
+	const uint32_t bodies = 37;
+	for (bool recorded : { false, true })
+	{
+		NullRhiDevice device;
+		SubmissionScene scene;
+		CHECK(CreateSubmissionScene(device, scene));
+
+		BenchmarkRecorder recorder;
+		recorder.AddStage("submit");
+		vector<float> worldMatrices(bodies * 16);
+		RecordingRhiCommandList recording;
+		bool everyFrame = true;
+
+		RunBenchmarkFrames(recorder, 2, 20, [&](uint32_t frame)
+		{
+			AnimateBodies(frame / 600.0f, worldMatrices.data(), bodies);
+			device.ResetCommandStats();
+			if (recorded)
+			{
+				recording.Reset();
+				SubmitBodies(recording, scene, worldMatrices.data(), bodies);
+				recording.Execute(*device.GetImmediateCommandList());
+			}
+			else
+			{
+				SubmitBodies(*device.GetImmediateCommandList(), scene, worldMatrices.data(), bodies);
+			}
+			recorder.Mark(0);
+
+			// a draw and a constants update a body, the cube and pyramid each bound in turn
+			const RhiNullStats& stats = device.GetStats();
+			everyFrame &= stats.Draws == bodies && stats.Updates == bodies;
+			everyFrame &= stats.UploadBytes == (uint64_t)bodies * SUBMISSION_CONSTANT_BYTES;
+			everyFrame &= stats.Primitives == (bodies + 1) / 2 * 12 + bodies / 2 * 6;
+		});
+
+		CHECK(everyFrame);
+		CHECK(device.GetStats().Errors == 0);
+		CHECK(recorder.GetMeasuredFrames() == 20);
+		DeleteSubmissionScene(scene);
+		CHECK(device.GetStats().Buffers == 0 && device.GetStats().PipelineStates == 0);
+	}
+}
+
+int main()
+{
+	RUN_TEST(TestPercentiles);
+	RUN_TEST(TestJson);
+	RUN_TEST(TestRunner);
+	RUN_TEST(TestNullScene);
+	return TestResult();
+}
@@ -0,0 +1,258 @@
+#include "Test.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// CMakeLists.txt builds this test with PROFILE, as the Debug and Profile configurations are,
+// so the scope macros below are the real ones rather than nothing
+#ifndef PROFILE
+#error CpuProfilerTests needs PROFILE defined
+#endif
+
+// long enough to stand well clear of the timer's resolution
+static void Spin(double seconds)
+{
+	chrono::steady_clock::time_point end = chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(seconds));
+	while (chrono::steady_clock::now() < end)
+	{
+	}
+}
+
+static const CpuProfileStat* Find(const vector<CpuProfileStat>& stats, const char* name)
+{
+	for (const CpuProfileStat& stat : stats)
+	{
+		if (stat.Name == name)
+			return &stat;
+	}
+	return nullptr;
+}
+
+static void TestNesting()
+{
+	// Frame { Update { Physics } Draw } Present, twice
+	CpuProfiler::Start();
+	for (int frame = 0; frame < 2; ++frame)
+	{
+		CpuProfileScope frameScope("Frame");
+		Spin(0.001);
+		{
+			CpuProfileScope update("Update");
+			{
+				CpuProfileScope physics("Physics");
+				Spin(0.002);
+			}
+			Spin(0.001);
+		}
+		{
+			CpuProfileScope draw("Draw");
+			Spin(0.002);
+		}
+	}
+	{
+		CpuProfileScope present("Present");
+	}
+	CpuProfiler::Stop();
+
+	vector<CpuProfileStat> stats = CpuProfiler::Aggregate();
+	CHECK(stats.size() == 5);
+	const CpuProfileStat* frame = Find(stats, "Frame");
+	const CpuProfileStat* update = Find(stats, "Update");
+	const CpuProfileStat* physics = Find(stats, "Physics");
+	const CpuProfileStat* draw = Find(stats, "Draw");
+	const CpuProfileStat* present = Find(stats, "Present");
+	CHECK(frame && update && physics && draw && present);
+	if (!frame || !update || !physics || !draw || !present)
+		return;
+
+	CHECK(frame->Calls == 2 && update->Calls == 2 && physics->Calls == 2 && draw->Calls == 2 && present->Calls == 1);
+	CHECK(frame->MaxDepth == 1 && update->MaxDepth == 2 && physics->MaxDepth == 3 && draw->MaxDepth == 2);
+	CHECK(present->MaxDepth == 1);
+
+	// a scope's own time is what its children leave, to the tick
+	CHECK_NEAR(frame->ExclusiveSeconds, frame->InclusiveSeconds - update->InclusiveSeconds - draw->InclusiveSeconds, 1e-9);
+	CHECK_NEAR(update->ExclusiveSeconds, update->InclusiveSeconds - physics->InclusiveSeconds, 1e-9);
+	CHECK(physics->ExclusiveSeconds == physics->InclusiveSeconds);
+
+	// and roughly the time spun in it. spins only overrun, so the lower bounds are firm
+	CHECK(physics->InclusiveSeconds >= 0.004);
+	CHECK(update->ExclusiveSeconds >= 0.002);
+	CHECK(frame->ExclusiveSeconds >= 0.002);
+	CHECK(frame->InclusiveSeconds >= 0.012);
+	CHECK(frame->InclusiveSeconds < 0.5);
+
+	// longest first
+	CHECK(stats[0].Name == "Frame");
+	for (size_t i = 1; i < stats.size(); ++i)
+		CHECK(stats[i].InclusiveSeconds <= stats[i - 1].InclusiveSeconds);
+
+	string summary = CpuProfiler::FormatSummary(2);
+	CHECK(summary.find("cpu Frame ") == 0);
+	CHECK(summary.find("calls        2") != string::npos);
+	CHECK(count(summary.begin(), summary.end(), '\n') == 2);
+}
+
+static void TestRecursion()
+{
+	// a scope inside itself counts both calls, but its time once
+	CpuProfiler::Start();
+	{
+		CpuProfileScope outer("Visit");
+		Spin(0.001);
+		{
+			CpuProfileScope inner("Visit");
+			Spin(0.002);
+		}
+	}
+	CpuProfiler::Stop();
+
+	vector<CpuProfileStat> stats = CpuProfiler::Aggregate();
+	CHECK(stats.size() == 1);
+	if (stats.size() != 1)
+		return;
+
+	CHECK(stats[0].Calls == 2);
+	CHECK(stats[0].MaxDepth == 2);
+	CHECK_NEAR(stats[0].ExclusiveSeconds, stats[0].InclusiveSeconds, 1e-9);
+	CHECK(stats[0].InclusiveSeconds >= 0.003 && stats[0].InclusiveSeconds < 0.5);
+}
+
+static void TestAggregation()
+{
+	const int threadCount = 4;
+	const int scopesPerThread = 100;
+
+	// the same name from different threads, and from a copy of the text at another
+	// address, is one entry
+	CpuProfiler::Start();
+	vector<thread> threads;
+	for (int t = 0; t < threadCount; ++t)
+	{
+		threads.emplace_back([=]()
+		{
+			static const char copy[] = "Job";
+			for (int i = 0; i < scopesPerThread; ++i)
+			{
+				CpuProfileScope job(i & 1 ? copy : "Job");
+				CpuProfileScope inner("Inner");
+			}
+		});
+	}
+	for (thread& worker : threads)
+		worker.join();
+
+	// and a scope still open when the capture is read is left out
+	CpuProfiler::Begin("Open");
+	vector<CpuProfileStat> stats = CpuProfiler::Aggregate();
+	CpuProfiler::End();
+	CpuProfiler::Stop();
+
+	CHECK(stats.size() == 2);
+	const CpuProfileStat* job = Find(stats, "Job");
+	const CpuProfileStat* inner = Find(stats, "Inner");
+	CHECK(job && job->Calls == threadCount * scopesPerThread && job->MaxDepth == 1);
+	CHECK(inner && inner->Calls == threadCount * scopesPerThread && inner->MaxDepth == 2);
+	CHECK(!Find(stats, "Open"));
+	if (job && inner)
+		CHECK(job->InclusiveSeconds >= inner->InclusiveSeconds);
+
+	// a new capture starts from nothing
+	CpuProfiler::Start();
+	CpuProfiler::Stop();
+	CHECK(CpuProfiler::Aggregate().empty());
+}
+
+static void TestDroppedEventsBalance()
+{
+	// a thread that registers after a Start with a small buffer keeps room for the end of
+	// everything it has open, so the capture nests properly however deep it goes
+	CpuProfiler::Start(8);
+	thread worker([]()
+	{
+		for (int frame = 0; frame < 3; ++frame)
+		{
+			CpuProfileScope a("A");
+			CpuProfileScope b("B");
+			CpuProfileScope c("C");
+			CpuProfileScope d("D");
+			CpuProfileScope e("E");
+		}
+	});
+	worker.join();
+	CpuProfiler::Stop();
+
+	// a Begin needs room for itself, its End and the End of everything open: A to D fit
+	// in the first frame with their ends, E and both later frames are dropped
+	CHECK(CpuProfiler::GetDroppedEvents() == 1 + 2 * 5);
+	vector<CpuProfileStat> stats = CpuProfiler::Aggregate();
+	CHECK(stats.size() == 4);
+	const char* names[] = { "A", "B", "C", "D" };
+	for (uint32_t depth = 1; depth <= 4; ++depth)
+	{
+		const CpuProfileStat* stat = Find(stats, names[depth - 1]);
+		CHECK(stat && stat->Calls == 1 && stat->MaxDepth == depth);
+	}
+
+	// nothing is recorded while stopped
+	CHECK(!CpuProfiler::Begin("Stopped"));
+	CHECK(!Find(CpuProfiler::Aggregate(), "Stopped"));
+}
+
+static void ProfiledFunction()
+{
+	CPU_PROFILE_FUNCTION();
+	Spin(0.001);
+}
+
+static void TestMacros()
+{
+	CpuProfiler::Start();
+	{
+		CPU_PROFILE_THREAD("Macro thread");
+		// two on neighbouring lines of one block need names of their own
+		CPU_PROFILE_SCOPE("Outer");
+		CPU_PROFILE_SCOPE("Inner");
+		ProfiledFunction();
+	}
+	CpuProfiler::Stop();
+
+	vector<CpuProfileStat> stats = CpuProfiler::Aggregate();
+	CHECK(stats.size() == 3);
+	const CpuProfileStat* outer = Find(stats, "Outer");
+	const CpuProfileStat* inner = Find(stats, "Inner");
+	const CpuProfileStat* function = Find(stats, "ProfiledFunction");
+	CHECK(outer && outer->Calls == 1 && outer->MaxDepth == 1);
+	CHECK(inner && inner->Calls == 1 && inner->MaxDepth == 2);
+	CHECK(function && function->Calls == 1 && function->MaxDepth == 3 && function->InclusiveSeconds >= 0.001);
+
+	CHECK(CpuProfiler::WriteChromeTrace(L"_cpuprofiler_test.json"));
+	string trace;
+	FILE* file = fopen("_cpuprofiler_test.json", "r");
+	if (file)
+	{
+		char buffer[4096];
+		size_t read;
+		while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			trace.append(buffer, read);
+		fclose(file);
+	}
+	remove("_cpuprofiler_test.json");
+	CHECK(trace.find("\"Macro thread\"") != string::npos);
+}
+
+int main()
+{
+	RUN_TEST(TestNesting);
+	RUN_TEST(TestRecursion);
+	RUN_TEST(TestAggregation);
+	RUN_TEST(TestDroppedEventsBalance);
+	RUN_TEST(TestMacros);
+	return TestResult();
+}
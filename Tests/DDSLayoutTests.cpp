@@ -0,0 +1,390 @@
+#include "Test.h"
+#include "DDSLayout.h"
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// the DXGI_FORMAT values used here
+static const uint32_t FORMAT_R8G8B8A8_UNORM = 28;
+static const uint32_t FORMAT_BC1_UNORM = 71;
+static const uint32_t FORMAT_BC3_UNORM = 77;
+
+// the few formats the tests write, sized the way DDSTextureLoader's GetSurfaceInfo does
+static uint32_t TestGetFormat(const DDS_PIXELFORMAT& ddpf)
+{
+	if ((ddpf.flags & DDS_FOURCC) && ddpf.fourCC == MAKEFOURCC('D', 'X', 'T', '1'))
+		return FORMAT_BC1_UNORM;
+	if ((ddpf.flags & DDS_FOURCC) && ddpf.fourCC == MAKEFOURCC('D', 'X', 'T', '5'))
+		return FORMAT_BC3_UNORM;
+	if ((ddpf.flags & DDS_RGB) && ddpf.RGBBitCount == 32 && ddpf.RBitMask == 0xff && ddpf.ABitMask == 0xff000000)
+		return FORMAT_R8G8B8A8_UNORM;
+	return DDS_FORMAT_UNKNOWN;
+}
+
+static void TestGetSurfaceInfo(size_t width, size_t height, uint32_t format, size_t* numBytes, size_t* rowBytes)
+{
+	size_t row = 0;
+	size_t rows = 0;
+	if (format == FORMAT_BC1_UNORM || format == FORMAT_BC3_UNORM)
+	{
+		row = max<size_t>(1, (width + 3) / 4) * (format == FORMAT_BC1_UNORM ? 8 : 16);
+		rows = max<size_t>(1, (height + 3) / 4);
+	}
+	else if (format == FORMAT_R8G8B8A8_UNORM)
+	{
+		row = width * 4;
+		rows = height;
+	}
+
+	if (numBytes)
+		*numBytes = row * rows;
+	if (rowBytes)
+		*rowBytes = row;
+}
+
+static const DDSFormatInfo s_formats = { TestGetFormat, TestGetSurfaceInfo };
+
+struct TestTexture
+{
+	uint32_t width;
+	uint32_t height;
+	// more than 1 for a volume
+	uint32_t depth;
+	uint32_t mipCount;
+	uint32_t format;
+	bool dx10;
+	// of the DX10 header, legacy cubes are always one
+	uint32_t arraySize;
+	bool cube;
+};
+
+static size_t HeaderBytes(const TestTexture& texture)
+{
+	return sizeof(uint32_t) + sizeof(DDS_HEADER) + (texture.dx10 ? sizeof(DDS_HEADER_DXT10) : 0);
+}
+
+static size_t ItemCount(const TestTexture& texture)
+{
+	return (texture.cube ? 6 : 1) * (texture.dx10 ? texture.arraySize : 1);
+}
+
+static size_t ItemBytes(const TestTexture& texture)
+{
+	size_t bytes = 0;
+	for (uint32_t mip = 0; mip < max(texture.mipCount, 1u); ++mip)
+	{
+		size_t numBytes;
+		TestGetSurfaceInfo(max(texture.width >> mip, 1u), max(texture.height >> mip, 1u), texture.format, &numBytes, nullptr);
+		bytes += numBytes * max(texture.depth >> mip, 1u);
+	}
+	return bytes;
+}
+
+// a whole file with every byte of the texture data different from its neighbours, so
+// data read from the wrong offset doesn't compare equal
+static vector<uint8_t> MakeDDS(const TestTexture& texture)
+{
+	DDS_HEADER header = {};
+	header.size = sizeof(DDS_HEADER);
+	header.flags = DDS_WIDTH | DDS_HEIGHT | (texture.depth > 1 ? DDS_HEADER_FLAGS_VOLUME : 0);
+	header.width = texture.width;
+	header.height = texture.height;
+	header.depth = texture.depth;
+	header.mipMapCount = texture.mipCount;
+	header.ddspf.size = sizeof(DDS_PIXELFORMAT);
+
+	DDS_HEADER_DXT10 ext = {};
+	if (texture.dx10)
+	{
+		header.ddspf.flags = DDS_FOURCC;
+		header.ddspf.fourCC = MAKEFOURCC('D', 'X', '1', '0');
+		ext.dxgiFormat = texture.format;
+		ext.resourceDimension = texture.depth > 1 ? DDS_DIMENSION_TEXTURE3D : DDS_DIMENSION_TEXTURE2D;
+		ext.miscFlag = texture.cube ? DDS_MISC_TEXTURECUBE : 0;
+		ext.arraySize = texture.arraySize;
+	}
+	else
+	{
+		if (texture.format == FORMAT_R8G8B8A8_UNORM)
+		{
+			header.ddspf.flags = DDS_RGB;
+			header.ddspf.RGBBitCount = 32;
+			header.ddspf.RBitMask = 0xff;
+			header.ddspf.GBitMask = 0xff00;
+			header.ddspf.BBitMask = 0xff0000;
+			header.ddspf.ABitMask = 0xff000000;
+		}
+		else
+		{
+			header.ddspf.flags = DDS_FOURCC;
+			header.ddspf.fourCC = texture.format == FORMAT_BC1_UNORM ? MAKEFOURCC('D', 'X', 'T', '1') : MAKEFOURCC('D', 'X', 'T', '5');
+		}
+
+		if (texture.cube)
+			header.caps2 = DDS_CUBEMAP_ALLFACES;
+	}
+
+	vector<uint8_t> file(HeaderBytes(texture) + ItemCount(texture) * ItemBytes(texture));
+	memcpy(file.data(), &DDS_MAGIC, sizeof(uint32_t));
+	memcpy(file.data() + sizeof(uint32_t), &header, sizeof(header));
+	if (texture.dx10)
+		memcpy(file.data() + sizeof(uint32_t) + sizeof(header), &ext, sizeof(ext));
+
+	for (size_t i = HeaderBytes(texture); i < file.size(); ++i)
+		file[i] = (uint8_t)((i * 2654435761u) >> 13);
+
+	return file;
+}
+
+struct MemoryFile
+{
+	const vector<uint8_t>* data;
+	// reads that succeed before the rest fail
+	int readsLeft;
+};
+
+static bool MemoryRead(void* file, size_t offset, uint8_t* data, size_t size)
+{
+	MemoryFile* memory = static_cast<MemoryFile*>(file);
+	if (memory->readsLeft-- <= 0 || offset + size > memory->data->size())
+		return false;
+
+	memcpy(data, memory->data->data() + offset, size);
+	return true;
+}
+
+static DDSLayoutResult ReadReduced(const vector<uint8_t>& file, size_t maxsize, unique_ptr<uint8_t[]>& ddsData,
+                                   DDS_HEADER** header, uint8_t** bitData, size_t* bitSize, int reads = 1000)
+{
+	MemoryFile memory = { &file, reads };
+	return ReadReducedDDS(MemoryRead, &memory, file.size(), maxsize, s_formats, ddsData, header, bitData, bitSize);
+}
+
+// the reduced read against the subresources a full read gives once the big mips are dropped
+static void CheckReducedMatchesFull(const TestTexture& texture, size_t maxsize, uint32_t expectedSkip)
+{
+	vector<uint8_t> file = MakeDDS(texture);
+	size_t headerBytes = HeaderBytes(texture);
+	size_t items = ItemCount(texture);
+
+	vector<DDSSubresource> full(texture.mipCount * items);
+	size_t twidth, theight, tdepth, skipMip;
+	CHECK(DDSFillSubresources(texture.width, texture.height, texture.depth, texture.mipCount, items, texture.format, maxsize,
+	                          file.size() - headerBytes, file.data() + headerBytes, s_formats,
+	                          twidth, theight, tdepth, skipMip, full.data()) == DDS_LAYOUT_OK);
+	CHECK(skipMip == expectedSkip);
+
+	unique_ptr<uint8_t[]> ddsData;
+	DDS_HEADER* header = nullptr;
+	uint8_t* bitData = nullptr;
+	size_t bitSize = 0;
+	CHECK(ReadReduced(file, maxsize, ddsData, &header, &bitData, &bitSize) == DDS_LAYOUT_OK);
+	if (!ddsData)
+		return;
+
+	// the header describes what's left, everything else about the file is as it was
+	size_t keptMips = texture.mipCount - skipMip;
+	CHECK(header->width == twidth && header->height == theight && header->mipMapCount == keptMips);
+	CHECK(texture.depth <= 1 || header->depth == tdepth);
+	const DDS_HEADER* original = reinterpret_cast<const DDS_HEADER*>(file.data() + sizeof(uint32_t));
+	CHECK(memcmp(ddsData.get(), file.data(), sizeof(uint32_t)) == 0);
+	CHECK(header->flags == original->flags && header->caps2 == original->caps2);
+	CHECK(memcmp(&header->ddspf, &original->ddspf, sizeof(DDS_PIXELFORMAT)) == 0);
+	CHECK(memcmp(ddsData.get() + sizeof(uint32_t) + sizeof(DDS_HEADER), file.data() + sizeof(uint32_t) + sizeof(DDS_HEADER),
+	             headerBytes - sizeof(uint32_t) - sizeof(DDS_HEADER)) == 0);
+	CHECK(bitData == ddsData.get() + headerBytes);
+
+	// and the kept bytes are exactly those the full read points at
+	vector<DDSSubresource> reduced(keptMips * items);
+	size_t rwidth, rheight, rdepth, rskip;
+	CHECK(DDSFillSubresources(twidth, theight, max<size_t>(tdepth, 1), keptMips, items, texture.format, maxsize, bitSize, bitData,
+	                          s_formats, rwidth, rheight, rdepth, rskip, reduced.data()) == DDS_LAYOUT_OK);
+	CHECK(rskip == 0 && rwidth == twidth && rheight == theight);
+
+	size_t keptBytes = 0;
+	for (size_t i = 0; i < reduced.size(); ++i)
+	{
+		size_t depth = max<size_t>(tdepth >> (i % keptMips), 1);
+		CHECK(reduced[i].rowPitch == full[i].rowPitch && reduced[i].slicePitch == full[i].slicePitch);
+		CHECK(memcmp(reduced[i].data, full[i].data, reduced[i].slicePitch * depth) == 0);
+		keptBytes += reduced[i].slicePitch * depth;
+	}
+	CHECK(bitSize == keptBytes);
+}
+
+static void TestMipChain()
+{
+	CheckReducedMatchesFull({ 256, 256, 1, 9, FORMAT_R8G8B8A8_UNORM, false, 1, false }, 64, 2);
+	// a limit that isn't a power of two, and a non-square texture
+	CheckReducedMatchesFull({ 256, 64, 1, 9, FORMAT_R8G8B8A8_UNORM, false, 1, false }, 100, 2);
+	CheckReducedMatchesFull({ 64, 256, 1, 9, FORMAT_R8G8B8A8_UNORM, true, 1, false }, 32, 3);
+}
+
+static void TestBlockCompressed()
+{
+	// partial chain
+	CheckReducedMatchesFull({ 256, 128, 1, 6, FORMAT_BC1_UNORM, false, 1, false }, 32, 3);
+	// sizes that aren't multiples of the block size: 100x60, 50x30, 25x15, ...
+	CheckReducedMatchesFull({ 100, 60, 1, 7, FORMAT_BC1_UNORM, false, 1, false }, 30, 2);
+	// down to mips smaller than a block
+	CheckReducedMatchesFull({ 128, 128, 1, 8, FORMAT_BC3_UNORM, false, 1, false }, 2, 6);
+}
+
+static void TestArrays()
+{
+	CheckReducedMatchesFull({ 128, 128, 1, 8, FORMAT_BC3_UNORM, true, 3, false }, 32, 2);
+	CheckReducedMatchesFull({ 64, 32, 1, 7, FORMAT_R8G8B8A8_UNORM, true, 5, false }, 16, 2);
+}
+
+static void TestCubes()
+{
+	CheckReducedMatchesFull({ 64, 64, 1, 7, FORMAT_R8G8B8A8_UNORM, false, 1, true }, 16, 2);
+	// an array of two cubes is 12 items
+	CheckReducedMatchesFull({ 64, 64, 1, 7, FORMAT_BC1_UNORM, true, 2, true }, 8, 3);
+}
+
+static void TestVolumes()
+{
+	CheckReducedMatchesFull({ 32, 32, 16, 6, FORMAT_R8G8B8A8_UNORM, false, 1, false }, 8, 2);
+	// depth is what's over the limit
+	CheckReducedMatchesFull({ 8, 8, 64, 7, FORMAT_R8G8B8A8_UNORM, true, 1, false }, 16, 2);
+}
+
+// S_FALSE in the loader, which then reads the whole file
+static void CheckFullRead(const vector<uint8_t>& file, size_t maxsize)
+{
+	unique_ptr<uint8_t[]> ddsData;
+	DDS_HEADER* header = nullptr;
+	uint8_t* bitData = nullptr;
+	size_t bitSize = 0;
+	CHECK(ReadReduced(file, maxsize, ddsData, &header, &bitData, &bitSize) == DDS_LAYOUT_FULL_READ);
+	CHECK(!ddsData && !header && !bitData && bitSize == 0);
+}
+
+static DDS_HEADER* Header(vector<uint8_t>& file)
+{
+	return reinterpret_cast<DDS_HEADER*>(file.data() + sizeof(uint32_t));
+}
+
+static DDS_HEADER_DXT10* Extension(vector<uint8_t>& file)
+{
+	return reinterpret_cast<DDS_HEADER_DXT10*>(file.data() + sizeof(uint32_t) + sizeof(DDS_HEADER));
+}
+
+static void TestFullReadFallbacks()
+{
+	const TestTexture plain = { 256, 256, 1, 9, FORMAT_R8G8B8A8_UNORM, false, 1, false };
+	const TestTexture dx10 = { 256, 256, 1, 9, FORMAT_BC1_UNORM, true, 1, false };
+
+	// nothing to drop: one mip, no mip count, or everything already within the limit
+	CheckFullRead(MakeDDS({ 256, 256, 1, 1, FORMAT_R8G8B8A8_UNORM, false, 1, false }), 64);
+	CheckFullRead(MakeDDS({ 256, 256, 1, 0, FORMAT_R8G8B8A8_UNORM, false, 1, false }), 64);
+	CheckFullRead(MakeDDS(plain), 256);
+
+	// nothing left, every mip of a short chain is over the limit
+	CheckFullRead(MakeDDS({ 256, 256, 1, 3, FORMAT_R8G8B8A8_UNORM, false, 1, false }), 32);
+
+	// more mips than D3D11 allows
+	vector<uint8_t> file = MakeDDS(plain);
+	Header(file)->mipMapCount = 16;
+	CheckFullRead(file, 64);
+
+	// a format the loader doesn't know
+	file = MakeDDS({ 256, 256, 1, 9, FORMAT_BC1_UNORM, false, 1, false });
+	Header(file)->ddspf.fourCC = MAKEFOURCC('A', 'T', 'I', '2');
+	CheckFullRead(file, 64);
+	file = MakeDDS(dx10);
+	Extension(file)->dxgiFormat = 1000;
+	CheckFullRead(file, 64);
+
+	// a cube without all its faces
+	file = MakeDDS({ 64, 64, 1, 7, FORMAT_R8G8B8A8_UNORM, false, 1, true });
+	Header(file)->caps2 = DDS_CUBEMAP_POSITIVEX | DDS_CUBEMAP_NEGATIVEX;
+	CheckFullRead(file, 16);
+
+	// an array of volumes, a volume without the volume flag and a buffer
+	file = MakeDDS({ 32, 32, 16, 6, FORMAT_R8G8B8A8_UNORM, true, 2, false });
+	CheckFullRead(file, 8);
+	file = MakeDDS({ 32, 32, 16, 6, FORMAT_R8G8B8A8_UNORM, true, 1, false });
+	Header(file)->flags &= ~DDS_HEADER_FLAGS_VOLUME;
+	CheckFullRead(file, 8);
+	file = MakeDDS(dx10);
+	Extension(file)->resourceDimension = 1;
+	CheckFullRead(file, 64);
+
+	// empty arrays and sizes past the limits
+	file = MakeDDS(dx10);
+	Extension(file)->arraySize = 0;
+	CheckFullRead(file, 64);
+	file = MakeDDS(plain);
+	Header(file)->width = 32768;
+	CheckFullRead(file, 64);
+
+	// the data stops short of the last mip
+	file = MakeDDS(plain);
+	file.pop_back();
+	CheckFullRead(file, 64);
+
+	// not a DDS file, a header of the wrong size, or too short for the DX10 header it says it has
+	file = MakeDDS(plain);
+	file[0] = 'X';
+	CheckFullRead(file, 64);
+	file = MakeDDS(plain);
+	Header(file)->size = 100;
+	CheckFullRead(file, 64);
+	file = MakeDDS(dx10);
+	file.resize(sizeof(uint32_t) + sizeof(DDS_HEADER) + 10);
+	CheckFullRead(file, 64);
+	file.resize(16);
+	CheckFullRead(file, 64);
+}
+
+static void TestReadFailure()
+{
+	vector<uint8_t> file = MakeDDS({ 128, 128, 1, 8, FORMAT_BC3_UNORM, true, 3, false });
+
+	// the headers read but the second array item doesn't
+	unique_ptr<uint8_t[]> ddsData;
+	DDS_HEADER* header = nullptr;
+	uint8_t* bitData = nullptr;
+	size_t bitSize = 0;
+	CHECK(ReadReduced(file, 32, ddsData, &header, &bitData, &bitSize, 2) == DDS_LAYOUT_READ_FAILED);
+	CHECK(!ddsData);
+}
+
+static void TestFillSubresources()
+{
+	const TestTexture texture = { 64, 64, 1, 7, FORMAT_R8G8B8A8_UNORM, false, 1, false };
+	vector<uint8_t> file = MakeDDS(texture);
+	size_t headerBytes = HeaderBytes(texture);
+
+	// no limit keeps everything, rows and slices as the format says
+	vector<DDSSubresource> subresources(7);
+	size_t twidth, theight, tdepth, skipMip;
+	CHECK(DDSFillSubresources(64, 64, 1, 7, 1, texture.format, 0, file.size() - headerBytes, file.data() + headerBytes,
+	                          s_formats, twidth, theight, tdepth, skipMip, subresources.data()) == DDS_LAYOUT_OK);
+	CHECK(skipMip == 0 && twidth == 64 && theight == 64 && tdepth == 1);
+	CHECK(subresources[0].data == file.data() + headerBytes);
+	CHECK(subresources[1].data == file.data() + headerBytes + 64 * 64 * 4);
+	CHECK(subresources[2].rowPitch == 16 * 4 && subresources[2].slicePitch == 16 * 16 * 4);
+
+	// short data, and a limit that leaves nothing
+	CHECK(DDSFillSubresources(64, 64, 1, 7, 1, texture.format, 0, file.size() - headerBytes - 1, file.data() + headerBytes,
+	                          s_formats, twidth, theight, tdepth, skipMip, subresources.data()) == DDS_LAYOUT_END_OF_DATA);
+	CHECK(DDSFillSubresources(64, 64, 1, 3, 1, texture.format, 8, file.size() - headerBytes, file.data() + headerBytes,
+	                          s_formats, twidth, theight, tdepth, skipMip, subresources.data()) == DDS_LAYOUT_NO_DATA);
+}
+
+int main()
+{
+	RUN_TEST(TestMipChain);
+	RUN_TEST(TestBlockCompressed);
+	RUN_TEST(TestArrays);
+	RUN_TEST(TestCubes);
+	RUN_TEST(TestVolumes);
+	RUN_TEST(TestFullReadFallbacks);
+	RUN_TEST(TestReadFailure);
+	RUN_TEST(TestFillSubresources);
+	return TestResult();
+}
@@ -0,0 +1,231 @@
+#include "Test.h"
+#include "FrameArena.h"
+
+#include <list>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static const size_t CHUNK = FrameArena::CHUNK_SIZE;
+
+static bool Within(const void* memory, const void* start, size_t bytes)
+{
+	return (const uint8_t*)memory >= (const uint8_t*)start && (const uint8_t*)memory < (const uint8_t*)start + bytes;
+}
+
+static void TestThreadChunks()
+{
+	FrameArena arena;
+	arena.Init(16 * CHUNK);
+	CHECK(arena.GetUsedBytes() == 0);
+
+	// the first allocation takes a chunk, the next ones bump through it
+	uint8_t* first = (uint8_t*)arena.Allocate(16);
+	uint8_t* second = (uint8_t*)arena.Allocate(16);
+	CHECK(arena.GetUsedBytes() == CHUNK);
+	CHECK(second == first + 16);
+
+	// every other thread takes a chunk of its own, never one another thread is using
+	const int threadCount = 4;
+	void* allocations[threadCount][2] = {};
+	vector<thread> threads;
+	for (int t = 0; t < threadCount; ++t)
+	{
+		threads.emplace_back([&arena, &allocations, t]()
+		{
+			allocations[t][0] = arena.Allocate(24);
+			allocations[t][1] = arena.Allocate(24);
+		});
+	}
+	for (thread& worker : threads)
+		worker.join();
+
+	CHECK(arena.GetUsedBytes() == (threadCount + 1) * CHUNK);
+	for (int t = 0; t < threadCount; ++t)
+	{
+		uint8_t* start = (uint8_t*)allocations[t][0];
+		CHECK(allocations[t][1] == start + 32);
+		CHECK(!Within(first, start, CHUNK) && !Within(start, first, CHUNK));
+		for (int other = 0; other < t; ++other)
+		{
+			uint8_t* otherStart = (uint8_t*)allocations[other][0];
+			CHECK(!Within(otherStart, start, CHUNK) && !Within(start, otherStart, CHUNK));
+		}
+	}
+	CHECK(arena.GetOverflowAllocations() == 0);
+
+	// alignment is honoured inside a chunk
+	void* aligned = arena.Allocate(8, 256);
+	CHECK(((uintptr_t)aligned & 255) == 0);
+}
+
+static void TestOverflow()
+{
+	uint64_t frameBytes = MemoryTracker::GetStats(MEMORY_TAG_FRAME).LiveBytes;
+
+	FrameArena arena;
+	arena.Init(2 * CHUNK);
+	CHECK(MemoryTracker::GetStats(MEMORY_TAG_FRAME).LiveBytes == frameBytes + 4 * CHUNK);
+
+	// two chunks of 1KB blocks fill the buffer, everything after goes to the heap
+	vector<uint8_t*> blocks;
+	for (size_t i = 0; i < 2 * CHUNK / 1024 + 10; ++i)
+	{
+		uint8_t* block = (uint8_t*)arena.Allocate(1024);
+		memset(block, (int)i, 1024);
+		blocks.push_back(block);
+	}
+	CHECK(arena.GetOverflowAllocations() == 10);
+	CHECK(arena.GetUsedBytes() == 2 * CHUNK);
+
+	// more than a whole chunk can't come from anywhere but the heap
+	uint8_t* big = (uint8_t*)arena.Allocate(CHUNK + 1, 64);
+	CHECK(((uintptr_t)big & 63) == 0);
+	memset(big, 0xAB, CHUNK + 1);
+	CHECK(arena.GetOverflowAllocations() == 11);
+	CHECK(MemoryTracker::GetStats(MEMORY_TAG_FRAME).LiveBytes > frameBytes + 5 * CHUNK);
+
+	// blocks keep what was written to them, none overlaps another
+	bool intact = true;
+	for (size_t i = 0; i < blocks.size(); ++i)
+	{
+		for (size_t j = 0; j < 1024; ++j)
+			intact &= blocks[i][j] == (uint8_t)i;
+	}
+	CHECK(intact);
+
+	// the heap blocks go when their buffer is reset, the second BeginFrame comes back to it
+	arena.BeginFrame();
+	CHECK(arena.GetOverflowAllocations() == 11);
+	arena.BeginFrame();
+	CHECK(MemoryTracker::GetStats(MEMORY_TAG_FRAME).LiveBytes == frameBytes + 4 * CHUNK);
+	CHECK(arena.GetPeakBytes() == 2 * CHUNK);
+
+	arena.Release();
+	CHECK(MemoryTracker::GetStats(MEMORY_TAG_FRAME).LiveBytes == frameBytes);
+}
+
+static void TestFrames()
+{
+	FrameArena arena;
+	arena.Init(4 * CHUNK, 3);
+	CHECK(arena.GetFrame() == 0);
+
+	uint32_t* frame0 = (uint32_t*)arena.Allocate(sizeof(uint32_t));
+	*frame0 = 1234;
+
+	// a new frame moves on to the next buffer, the thread's chunk in the old one is stale
+	arena.BeginFrame();
+	CHECK(arena.GetFrame() == 1);
+	CHECK(arena.GetUsedBytes() == 0);
+	uint32_t* frame1 = (uint32_t*)arena.Allocate(sizeof(uint32_t));
+	CHECK(arena.GetUsedBytes() == CHUNK);
+	CHECK(!Within(frame1, frame0, CHUNK) && !Within(frame0, frame1, CHUNK));
+
+	// with three buffers frame 0's allocations are still there two frames on
+	arena.BeginFrame();
+	arena.Allocate(sizeof(uint32_t));
+	CHECK(*frame0 == 1234);
+
+	// and its buffer starts again from the beginning when it comes round
+	arena.BeginFrame();
+	CHECK(arena.GetFrame() == 3);
+	CHECK(arena.Allocate(sizeof(uint32_t)) == frame0);
+
+	// a chunk from another arena is never used for this one
+	FrameArena other;
+	other.Init(4 * CHUNK);
+	uint8_t* fromOther = (uint8_t*)other.Allocate(16);
+	uint8_t* next = (uint8_t*)arena.Allocate(16);
+	CHECK(!Within(next, fromOther, CHUNK) && !Within(fromOther, next, CHUNK));
+	CHECK(next == (uint8_t*)frame0 + CHUNK);
+
+	// Init and Release start over too
+	arena.Init(4 * CHUNK);
+	CHECK(arena.GetFrame() == 0 && arena.GetUsedBytes() == 0);
+	arena.Allocate(16);
+	CHECK(arena.GetUsedBytes() == CHUNK);
+}
+
+static void TestAllocators()
+{
+	FrameArena arena;
+	arena.Init(16 * CHUNK);
+
+	FrameArenaVector<int> values{ FrameAllocator<int>(&arena) };
+	for (int i = 0; i < 1000; ++i)
+		values.push_back(i * 3);
+
+	bool ordered = true;
+	for (int i = 0; i < 1000; ++i)
+		ordered &= values[i] == i * 3;
+	CHECK(ordered);
+	CHECK(arena.GetUsedBytes() == CHUNK);
+	CHECK(arena.GetOverflowAllocations() == 0);
+
+	// node containers rebind the allocator to their node type
+	list<double, FrameAllocator<double>> nodes{ FrameAllocator<double>(&arena) };
+	nodes.push_back(1.5);
+	nodes.push_back(2.5);
+	CHECK(nodes.size() == 2 && nodes.front() == 1.5 && nodes.back() == 2.5);
+
+	FrameArena other;
+	FrameAllocator<int> a(&arena);
+	FrameAllocator<double> b(&arena);
+	FrameAllocator<int> c(&other);
+	CHECK(a == b && !(a != b));
+	CHECK(a != c);
+	CHECK(FrameAllocator<char>(b).GetArena() == &arena);
+
+	// a copy shares the arena, so it can take over the other's memory
+	FrameArenaVector<int> copy = values;
+	CHECK(copy.get_allocator() == values.get_allocator());
+	CHECK(copy.size() == 1000 && copy[999] == 2997);
+}
+
+static void TestDebugChecks()
+{
+	FrameArena arena;
+	arena.Init(4 * CHUNK);
+
+	uint8_t* freed = (uint8_t*)arena.Allocate(32);
+	uint8_t* kept = (uint8_t*)arena.Allocate(32);
+	memset(freed, 1, 32);
+	memset(kept, 2, 32);
+	arena.Free(freed, 32);
+
+	// the second buffer, then back to the first
+	arena.BeginFrame();
+	arena.BeginFrame();
+
+#ifndef NDEBUG
+	// freed memory is poisoned straight away, the rest at the reset, and the block that
+	// was never freed is a leak
+	CHECK(freed[0] == 0xCD && freed[31] == 0xCD);
+	CHECK(kept[0] == 0xCD && kept[31] == 0xCD);
+	CHECK(arena.GetLeakedAllocations() == 1);
+
+	uint8_t* block = (uint8_t*)arena.Allocate(16);
+	arena.Free(block, 16);
+	CHECK(block[0] == 0xDD && block[15] == 0xDD);
+	arena.BeginFrame();
+	arena.BeginFrame();
+	CHECK(arena.GetLeakedAllocations() == 1);
+#else
+	// without the checks nothing is touched or counted
+	CHECK(freed[0] == 1 && kept[0] == 2);
+	CHECK(arena.GetLeakedAllocations() == 0);
+#endif
+}
+
+int main()
+{
+	RUN_TEST(TestThreadChunks);
+	RUN_TEST(TestOverflow);
+	RUN_TEST(TestFrames);
+	RUN_TEST(TestAllocators);
+	RUN_TEST(TestDebugChecks);
+	return TestResult();
+}
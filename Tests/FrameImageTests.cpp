@@ -0,0 +1,123 @@
+#include "Test.h"
+#include "FrameImage.h"
+
+#include <string.h>
+#include <vector>
+
+using namespace std;
+
+static uint32_t Read16(const vector<uint8_t>& data, size_t offset)
+{
+	return data[offset] | (data[offset + 1] << 8);
+}
+
+static uint32_t Read32(const vector<uint8_t>& data, size_t offset)
+{
+	return data[offset] | (data[offset + 1] << 8) | (data[offset + 2] << 16) | ((uint32_t)data[offset + 3] << 24);
+}
+
+// width x height texels with pitch bytes a row, the padding filled with junk
+static vector<uint8_t> MakeFrame(uint32_t width, uint32_t height, uint32_t pitch, uint8_t padding)
+{
+	vector<uint8_t> texels(pitch * height, padding);
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			uint8_t* texel = &texels[y * pitch + x * 4];
+			texel[0] = (uint8_t)(x * 40);
+			texel[1] = (uint8_t)(y * 40);
+			texel[2] = (uint8_t)(x + y);
+			texel[3] = 255;
+		}
+	}
+	return texels;
+}
+
+static void TestChecksum()
+{
+	// known FNV-1a values: nothing hashed, then the bytes 0 0 0 0
+	CHECK(ChecksumFrame(nullptr, 0, 0, 0) == 0xcbf29ce484222325ull);
+	const uint8_t zero[4] = { 0, 0, 0, 0 };
+	CHECK(ChecksumFrame(zero, 1, 1, 4) == 0x4d25767f9dce13f5ull);
+
+	// the pitch padding is skipped, a tightly packed frame checksums the same
+	vector<uint8_t> packed = MakeFrame(5, 3, 20, 0);
+	vector<uint8_t> padded = MakeFrame(5, 3, 32, 0xcd);
+	vector<uint8_t> otherPadding = MakeFrame(5, 3, 32, 0x11);
+	uint64_t checksum = ChecksumFrame(packed.data(), 5, 3, 20);
+	CHECK(ChecksumFrame(padded.data(), 5, 3, 32) == checksum);
+	CHECK(ChecksumFrame(otherPadding.data(), 5, 3, 32) == checksum);
+
+	// any visible byte, and the order of the rows, changes it
+	bool allChange = true;
+	for (size_t i = 0; i < packed.size(); ++i)
+	{
+		vector<uint8_t> changed = packed;
+		changed[i] ^= 1;
+		allChange &= ChecksumFrame(changed.data(), 5, 3, 20) != checksum;
+	}
+	CHECK(allChange);
+	CHECK(ChecksumFrame(packed.data() + 20, 5, 2, 20) != ChecksumFrame(packed.data(), 5, 2, 20));
+}
+
+static void TestBitmap()
+{
+	const uint32_t width = 5;
+	const uint32_t height = 3;
+	vector<uint8_t> texels = MakeFrame(width, height, 32, 0xcd);
+
+	vector<uint8_t> bitmap;
+	EncodeFrameBitmap(texels.data(), width, height, 32, false, bitmap);
+
+	// BITMAPFILEHEADER then BITMAPINFOHEADER, little endian
+	CHECK(bitmap.size() == 54 + width * height * 4);
+	CHECK(bitmap[0] == 'B' && bitmap[1] == 'M');
+	CHECK(Read32(bitmap, 2) == bitmap.size());
+	CHECK(Read32(bitmap, 6) == 0);
+	CHECK(Read32(bitmap, 10) == 54);
+	CHECK(Read32(bitmap, 14) == 40);
+	CHECK(Read32(bitmap, 18) == width);
+	CHECK((int32_t)Read32(bitmap, 22) == -(int32_t)height);
+	CHECK(Read16(bitmap, 26) == 1);
+	CHECK(Read16(bitmap, 28) == 32);
+	CHECK(Read32(bitmap, 30) == 0);
+	CHECK(Read32(bitmap, 34) == width * height * 4);
+
+	// the rows top down and packed, without the padding
+	bool rows = true;
+	for (uint32_t y = 0; y < height; ++y)
+		rows &= memcmp(&bitmap[54 + y * width * 4], &texels[y * 32], width * 4) == 0;
+	CHECK(rows);
+
+	// RGBA texels come out blue first
+	vector<uint8_t> swapped;
+	EncodeFrameBitmap(texels.data(), width, height, 32, true, swapped);
+	CHECK(memcmp(swapped.data(), bitmap.data(), 54) == 0);
+	bool swappedTexels = true;
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			const uint8_t* in = &texels[y * 32 + x * 4];
+			const uint8_t* out = &swapped[54 + (y * width + x) * 4];
+			swappedTexels &= out[0] == in[2] && out[1] == in[1] && out[2] == in[0] && out[3] == in[3];
+		}
+	}
+	CHECK(swappedTexels);
+}
+
+static void TestChecksumFile()
+{
+	vector<FrameChecksum> checksums = { { 0, 0x0123456789abcdefull }, { 17, 5 } };
+	CHECK(FormatFrameChecksums(checksums) == "0 0123456789abcdef\n17 0000000000000005\n");
+	CHECK(FormatFrameChecksums(vector<FrameChecksum>()).empty());
+}
+
+int main()
+{
+	RUN_TEST(TestChecksum);
+	RUN_TEST(TestBitmap);
+	RUN_TEST(TestChecksumFile);
+	return TestResult();
+}
@@ -0,0 +1,169 @@
+#include "Test.h"
+#include "FrameScheduler.h"
+
+#include <vector>
+
+using namespace std;
+
+static const double RATE = 60.0;
+static const double PERIOD = 1.0 / RATE;
+static const double SPIN_STEP = 0.00001;
+
+// runs frames with work seconds of simulated work between them, returns when each started
+static vector<double> RunFrames(FrameScheduler& scheduler, VirtualFrameClock& clock, int frames, double work)
+{
+	vector<double> starts;
+	for (int i = 0; i < frames; ++i)
+	{
+		CHECK(scheduler.WaitForNextFrame());
+		starts.push_back(clock.Now());
+		clock.Advance(work);
+	}
+	return starts;
+}
+
+static void TestPacing()
+{
+	VirtualFrameClock clock(0.001, SPIN_STEP);
+	FrameScheduler scheduler;
+	scheduler.Init(&clock, RATE);
+
+	// every frame starts on its deadline, the spin makes up what the sleep's overshoot
+	// didn't, so the start is late by at most one spin step
+	vector<double> starts = RunFrames(scheduler, clock, 300, 0.005);
+	double maxLate = 0.0;
+	for (size_t i = 0; i < starts.size(); ++i)
+		maxLate = max(maxLate, fabs(starts[i] - i * PERIOD));
+	CHECK(maxLate <= SPIN_STEP * 1.01);
+
+	CHECK_NEAR(scheduler.GetFrameTimePercentile(50.0), PERIOD, SPIN_STEP);
+	CHECK_NEAR(scheduler.GetFrameTimePercentile(99.0), PERIOD, SPIN_STEP);
+	CHECK(scheduler.GetRecordedFrames() == 299);
+}
+
+static void TestLatencyWait()
+{
+	// one sleep a frame takes it to within the threshold, the rest is spun. the first
+	// frame is due at once
+	VirtualFrameClock clock(0.001, SPIN_STEP);
+	FrameScheduler scheduler;
+	scheduler.Init(&clock, RATE);
+	scheduler.SetSpinThreshold(0.002);
+
+	const int frames = 100;
+	RunFrames(scheduler, clock, frames, 0.005);
+	CHECK(clock.GetSleepCount() == frames - 1);
+	// 2ms threshold less 1ms overshoot, in 10us steps
+	CHECK(clock.GetSpinCount() <= (frames - 1) * 101);
+	CHECK(clock.GetSpinCount() >= (frames - 1) * 99);
+
+	// an overshoot past the threshold makes every frame late by the difference, but the
+	// cadence holds rather than drifting by it each frame
+	VirtualFrameClock coarse(0.003, SPIN_STEP);
+	scheduler.Init(&coarse, RATE);
+	vector<double> starts = RunFrames(scheduler, coarse, 100, 0.005);
+	for (size_t i = 1; i < starts.size(); ++i)
+		CHECK_NEAR(starts[i] - i * PERIOD, 0.001, 1e-9);
+	CHECK(coarse.GetSpinCount() == 0);
+
+	// work longer than the frame leaves nothing to wait for
+	VirtualFrameClock busy(0.001, SPIN_STEP);
+	scheduler.Init(&busy, RATE);
+	RunFrames(scheduler, busy, 50, PERIOD * 1.01);
+	CHECK(busy.GetSleepCount() == 0);
+	CHECK(busy.GetSpinCount() == 0);
+}
+
+static void TestMissedDeadline()
+{
+	VirtualFrameClock clock(0.001, SPIN_STEP);
+	FrameScheduler scheduler;
+	scheduler.Init(&clock, RATE);
+	RunFrames(scheduler, clock, 10, 0.005);
+
+	// a miss of under a frame keeps the cadence, the frame after it is back on the grid
+	clock.Advance(PERIOD * 1.2);
+	vector<double> missed = RunFrames(scheduler, clock, 1, 0.005);
+	CHECK_NEAR(missed[0], 10.5 * PERIOD, 1e-9);
+	vector<double> after = RunFrames(scheduler, clock, 5, 0.005);
+	for (size_t i = 0; i < after.size(); ++i)
+		CHECK_NEAR(after[i], (11 + i) * PERIOD, SPIN_STEP * 1.01);
+
+	// a stall of several frames starts over from where it ended instead of rushing out
+	// frames to catch up
+	clock.Advance(PERIOD * 3.5);
+	double stallEnd = clock.Now() + PERIOD;
+	RunFrames(scheduler, clock, 1, 0.005);
+	vector<double> resumed = RunFrames(scheduler, clock, 10, 0.005);
+	CHECK_NEAR(resumed[0], stallEnd, SPIN_STEP * 1.01);
+	for (size_t i = 1; i < resumed.size(); ++i)
+		CHECK_NEAR(resumed[i] - resumed[i - 1], PERIOD, SPIN_STEP * 1.01);
+}
+
+static void TestThrottle()
+{
+	VirtualFrameClock clock(0.001, SPIN_STEP);
+	FrameScheduler scheduler;
+	scheduler.Init(&clock, RATE);
+	scheduler.SetThrottleRate(10.0);
+	RunFrames(scheduler, clock, 5, 0.005);
+
+	// throttling starts over at the low rate from now
+	scheduler.SetThrottled(true);
+	vector<double> throttled = RunFrames(scheduler, clock, 5, 0.005);
+	for (size_t i = 1; i < throttled.size(); ++i)
+		CHECK_NEAR(throttled[i] - throttled[i - 1], 0.1, SPIN_STEP * 1.01);
+
+	// and coming back doesn't wait out the rest of a throttled frame
+	scheduler.SetThrottled(false);
+	double resumeAt = clock.Now();
+	vector<double> resumed = RunFrames(scheduler, clock, 5, 0.005);
+	CHECK(resumed[0] == resumeAt);
+	for (size_t i = 1; i < resumed.size(); ++i)
+		CHECK_NEAR(resumed[i] - resumed[i - 1], PERIOD, SPIN_STEP * 1.01);
+}
+
+static void TestUnpaced()
+{
+	// no target rate leaves it to vsync, nothing waits
+	VirtualFrameClock clock(0.001, SPIN_STEP);
+	FrameScheduler scheduler;
+	scheduler.Init(&clock, 0.0);
+	CHECK(scheduler.GetFrameTimePercentile(50.0) == 0.0);
+
+	// frame times of 1 to 100ms in a shuffled order
+	for (int i = 0; i <= 100; ++i)
+	{
+		CHECK(scheduler.WaitForNextFrame());
+		clock.Advance((i * 37 % 100 + 1) * 0.001);
+	}
+	CHECK(clock.GetSleepCount() == 0 && clock.GetSpinCount() == 0);
+	CHECK(scheduler.GetRecordedFrames() == 100);
+	CHECK_NEAR(scheduler.GetFrameTimePercentile(0.0), 0.001, 1e-9);
+	CHECK_NEAR(scheduler.GetFrameTimePercentile(50.0), 0.051, 1e-9);
+	CHECK_NEAR(scheduler.GetFrameTimePercentile(99.0), 0.100, 1e-9);
+	CHECK_NEAR(scheduler.GetFrameTimePercentile(100.0), 0.100, 1e-9);
+
+	string report = scheduler.FormatReport("frame times");
+	CHECK(report.find("frame times: 101 frames") == 0);
+	CHECK(report.find("p95 96.00 ms") != string::npos);
+
+	// only the most recent frames are kept
+	for (int i = 0; i < 1000; ++i)
+	{
+		scheduler.WaitForNextFrame();
+		clock.Advance(0.002);
+	}
+	CHECK(scheduler.GetRecordedFrames() == 512);
+	CHECK_NEAR(scheduler.GetFrameTimePercentile(99.0), 0.002, 1e-9);
+}
+
+int main()
+{
+	RUN_TEST(TestPacing);
+	RUN_TEST(TestLatencyWait);
+	RUN_TEST(TestMissedDeadline);
+	RUN_TEST(TestThrottle);
+	RUN_TEST(TestUnpaced);
+	return TestResult();
+}
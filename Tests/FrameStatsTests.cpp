@@ -0,0 +1,234 @@
+#include "Test.h"
+#include "FrameStats.h"
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static string ReadText(const char* path)
+{
+	string text;
+	FILE* file = fopen(path, "r");
+	if (!file)
+		return text;
+
+	char buffer[4096];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		text.append(buffer, read);
+	fclose(file);
+	return text;
+}
+
+// a frame that takes ms, it is finished by the next BeginFrame
+static void RunFrame(FrameStats& stats, VirtualFrameClock& clock, double ms)
+{
+	stats.BeginFrame();
+	stats.EndFrame();
+	clock.Advance(ms / 1000.0);
+}
+
+static void TestCounts()
+{
+	VirtualFrameClock clock;
+	FrameStats stats;
+	stats.Init(&clock);
+
+	// counted before the first frame, dropped by it
+	stats.CountDraw(1000);
+
+	stats.BeginFrame();
+	stats.CountDraw(12);
+	stats.CountDraw(2);
+	stats.CountStateChanges(3);
+	stats.CountStateChanges(1);
+	stats.CountConstantUpload(384);
+	stats.CountConstantUpload(64);
+	stats.CountShaderResources(2);
+	stats.SetPresentTime(1.25);
+	stats.EndFrame();
+	clock.Advance(0.0165);
+
+	// not finished until the next frame starts, which is when its time is known
+	CHECK(stats.GetFrameCount() == 0);
+	stats.BeginFrame();
+	CHECK(stats.GetFrameCount() == 1);
+
+	const RenderStats& last = stats.GetLast();
+	CHECK(last.DrawCalls == 2 && last.Triangles == 14);
+	CHECK(last.StateChanges == 4);
+	CHECK(last.ConstantBufferBytes == 448);
+	CHECK(last.ShaderResourceBinds == 2);
+	CHECK(last.PresentMs == 1.25);
+	CHECK_NEAR(last.FrameMs, 16.5, 1e-6);
+	CHECK(!last.Stutter);
+
+	// each frame starts from nothing
+	stats.EndFrame();
+	clock.Advance(0.0105);
+	stats.BeginFrame();
+	CHECK(stats.GetFrameCount() == 2);
+	CHECK(stats.GetLast().DrawCalls == 0 && stats.GetLast().Triangles == 0 && stats.GetLast().PresentMs == 0.0);
+	CHECK_NEAR(stats.GetLast().FrameMs, 10.5, 1e-6);
+
+	char overlay[256];
+	stats.FormatOverlay(overlay, sizeof(overlay));
+	CHECK(string(overlay) == "10.50 ms (median 16.50)  0 draws  0 tris  0 state  0 cb bytes  0 srvs  present 0.00 ms  0 stutters");
+}
+
+static void TestHistogramAndMedian()
+{
+	VirtualFrameClock clock;
+	FrameStats stats;
+	stats.Init(&clock);
+	CHECK(stats.GetMedianFrameMs() == 0.0);
+
+	for (int i = 0; i < 30; ++i)
+		RunFrame(stats, clock, 10.5);
+	for (int i = 0; i < 10; ++i)
+		RunFrame(stats, clock, 4.5);
+	RunFrame(stats, clock, 250.0);
+	stats.BeginFrame();
+
+	// 1ms buckets, the last takes everything longer
+	const uint32_t* histogram = stats.GetHistogram();
+	CHECK(histogram[10] == 30);
+	CHECK(histogram[4] == 10);
+	CHECK(histogram[FrameStats::HISTOGRAM_BUCKETS - 1] == 1);
+	uint32_t total = 0;
+	for (uint32_t i = 0; i < FrameStats::HISTOGRAM_BUCKETS; ++i)
+		total += histogram[i];
+	CHECK(total == 41);
+	CHECK_NEAR(stats.GetMedianFrameMs(), 10.5, 1e-6);
+
+	// the median only looks at the last 120 frames
+	for (int i = 0; i < 120; ++i)
+		RunFrame(stats, clock, 4.5);
+	stats.BeginFrame();
+	CHECK_NEAR(stats.GetMedianFrameMs(), 4.5, 1e-6);
+
+	string report = stats.FormatReport();
+	CHECK(report.find("frame stats: 161 frames, median 4.50 ms, 1 stutters (over 2.0x median)\n") == 0);
+	CHECK(report.find("    4 ms: 130\n") != string::npos);
+	CHECK(report.find("   10 ms: 30\n") != string::npos);
+	CHECK(report.find("   99+ ms: 1\n") != string::npos);
+}
+
+static void TestStutters()
+{
+	VirtualFrameClock clock;
+	FrameStats stats;
+	stats.Init(&clock);
+
+	// too early to tell, the median needs ten frames behind it
+	RunFrame(stats, clock, 10.5);
+	RunFrame(stats, clock, 40.5);
+	for (int i = 0; i < 10; ++i)
+		RunFrame(stats, clock, 10.5);
+	stats.BeginFrame();
+	CHECK(stats.GetStutterCount() == 0);
+
+	// frame 12 is past twice the median, frame 13 isn't
+	stats.EndFrame();
+	clock.Advance(0.0215);
+	RunFrame(stats, clock, 20.5);
+	stats.BeginFrame();
+	CHECK(stats.GetStutterCount() == 1);
+	CHECK(!stats.GetLast().Stutter);
+
+	vector<uint64_t> frames;
+	stats.GetStutterFrames(frames);
+	CHECK(frames.size() == 1 && frames[0] == 12);
+
+	stats.SetStutterThreshold(4.0f);
+	stats.EndFrame();
+	clock.Advance(0.0405);
+	stats.BeginFrame();
+	CHECK(stats.GetStutterCount() == 1 && !stats.GetLast().Stutter);
+}
+
+static void TestStutterRing()
+{
+	VirtualFrameClock clock;
+	FrameStats stats;
+	stats.Init(&clock);
+
+	// a stutter every fourth frame never moves the median, past the ring only the newest are kept
+	const uint32_t stutters = FrameStats::MAX_STUTTER_FRAMES + 100;
+	for (int i = 0; i < 12; ++i)
+		RunFrame(stats, clock, 10.5);
+	for (uint32_t i = 0; i < stutters * 4; ++i)
+		RunFrame(stats, clock, i % 4 == 3 ? 50.5 : 10.5);
+	stats.BeginFrame();
+	CHECK(stats.GetStutterCount() == stutters);
+
+	vector<uint64_t> frames;
+	stats.GetStutterFrames(frames);
+	CHECK(frames.size() == FrameStats::MAX_STUTTER_FRAMES);
+	if (frames.size() == FrameStats::MAX_STUTTER_FRAMES)
+	{
+		CHECK(frames.front() == 12 + 100 * 4 + 3);
+		CHECK(frames.back() == 12 + (stutters - 1) * 4 + 3);
+		bool ordered = true;
+		for (size_t i = 1; i < frames.size(); ++i)
+			ordered &= frames[i] == frames[i - 1] + 4;
+		CHECK(ordered);
+	}
+}
+
+static void TestFiles()
+{
+	VirtualFrameClock clock;
+	FrameStats stats;
+	stats.Init(&clock);
+
+	CHECK(stats.Open(L"_framestats_test.csv"));
+	for (int i = 0; i < 11; ++i)
+		RunFrame(stats, clock, 10.5);
+	stats.BeginFrame();
+	stats.CountDraw(12);
+	stats.CountStateChanges(5);
+	stats.CountConstantUpload(384);
+	stats.CountShaderResources(3);
+	stats.SetPresentTime(0.5);
+	stats.EndFrame();
+	clock.Advance(0.0305);
+	stats.BeginFrame();
+	stats.Close();
+
+	string csv = ReadText("_framestats_test.csv");
+	CHECK(csv.find("frame,frame_ms,present_ms,draw_calls,triangles,state_changes,constant_buffer_bytes,srv_binds,stutter\n"
+	               "0,10.500,0.000,0,0,0,0,0,0\n") == 0);
+	CHECK(csv.find("\n11,30.500,0.500,1,12,5,384,3,1\n") != string::npos);
+	remove("_framestats_test.csv");
+
+	// JSON whatever the extension's case, with the stutters and histogram at the end
+	CHECK(stats.Open(L"_framestats_test.JSON"));
+	for (int i = 0; i < 11; ++i)
+		RunFrame(stats, clock, 10.5);
+	RunFrame(stats, clock, 30.5);
+	stats.BeginFrame();
+	stats.Close();
+
+	string json = ReadText("_framestats_test.JSON");
+	CHECK(json.find("{\n\"frames\": [\n{\"frame\": 12, \"frame_ms\": 10.500") == 0);
+	CHECK(json.find("{\"frame\": 23, \"frame_ms\": 30.500, \"present_ms\": 0.000, \"draw_calls\": 0, \"triangles\": 0, "
+	                "\"state_changes\": 0, \"constant_buffer_bytes\": 0, \"srv_binds\": 0, \"stutter\": true}\n],\n") != string::npos);
+	CHECK(json.find("\"median_ms\": 10.500,\n\"stutter_multiple\": 2.00,\n\"stutters\": [11, 23],\n\"histogram_ms\": [0, ") != string::npos);
+	CHECK(json.size() > 4 && json.compare(json.size() - 4, 4, "]\n}\n") == 0);
+	remove("_framestats_test.JSON");
+
+	CHECK(!stats.Open(L"_no_such_directory/stats.csv"));
+}
+
+int main()
+{
+	RUN_TEST(TestCounts);
+	RUN_TEST(TestHistogramAndMedian);
+	RUN_TEST(TestStutters);
+	RUN_TEST(TestStutterRing);
+	RUN_TEST(TestFiles);
+	return TestResult();
+}
@@ -0,0 +1,225 @@
+#include "Test.h"
+#include "GBufferPacking.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+static const double PI = 3.14159265358979323846;
+
+struct Normal
+{
+	float v[3];
+};
+
+static Normal Normalised(double x, double y, double z)
+{
+	double length = sqrt(x * x + y * y + z * z);
+	return { { (float)(x / length), (float)(y / length), (float)(z / length) } };
+}
+
+// angle between two unit vectors, acos loses too much near 0 so from the cross product
+static double AngleBetween(const float a[3], const float b[3])
+{
+	double cx = (double)a[1] * b[2] - (double)a[2] * b[1];
+	double cy = (double)a[2] * b[0] - (double)a[0] * b[2];
+	double cz = (double)a[0] * b[1] - (double)a[1] * b[0];
+	double dot = (double)a[0] * b[0] + (double)a[1] * b[1] + (double)a[2] * b[2];
+	return atan2(sqrt(cx * cx + cy * cy + cz * cz), dot);
+}
+
+// the sphere evenly, then the places the encoding treats specially: the poles, the
+// axes, the equator where the fold starts, the lower hemisphere's x = 0 and y = 0 planes
+// where the sign picks the quadrant, and the diagonals |x| + |y| = 1 it folds across
+static vector<Normal> SweepNormals()
+{
+	vector<Normal> normals;
+
+	const int count = 20000;
+	for (int i = 0; i < count; ++i)
+	{
+		double z = 1.0 - (2.0 * i + 1.0) / count;
+		double r = sqrt(1.0 - z * z);
+		double phi = i * PI * (3.0 - sqrt(5.0));
+		normals.push_back(Normalised(r * cos(phi), r * sin(phi), z));
+	}
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		for (double sign : { 1.0, -1.0 })
+		{
+			double v[3] = { 0, 0, 0 };
+			v[axis] = sign;
+			normals.push_back(Normalised(v[0], v[1], v[2]));
+		}
+	}
+
+	// just off the poles
+	for (double e : { 1e-7, 1e-5, 1e-3 })
+	{
+		for (double sz : { 1.0, -1.0 })
+		{
+			normals.push_back(Normalised(e, e, sz));
+			normals.push_back(Normalised(-e, e, sz));
+			normals.push_back(Normalised(e, -e, sz));
+			normals.push_back(Normalised(-e, -e, sz));
+		}
+	}
+
+	const int steps = 720;
+	for (int i = 0; i < steps; ++i)
+	{
+		double a = 2.0 * PI * i / steps;
+		double t = PI * i / steps - PI / 2;
+
+		// equator, and either side of it
+		normals.push_back(Normalised(cos(a), sin(a), 0));
+		normals.push_back(Normalised(cos(a), sin(a), 1e-4));
+		normals.push_back(Normalised(cos(a), sin(a), -1e-4));
+
+		// lower hemisphere on and just off the x = 0 and y = 0 planes
+		for (double off : { 0.0, 1e-6, -1e-6 })
+		{
+			normals.push_back(Normalised(off, cos(t), -fabs(sin(t)) - 1e-3));
+			normals.push_back(Normalised(cos(t), off, -fabs(sin(t)) - 1e-3));
+		}
+
+		// |x| + |y| = 1 - |z| on the diagonal planes of each quadrant, where the folded
+		// square's edges meet
+		double z = -sin(PI / 2 * i / steps);
+		for (double sx : { 1.0, -1.0 })
+		{
+			for (double sy : { 1.0, -1.0 })
+			{
+				normals.push_back(Normalised(sx * (1 + z) * 0.5, sy * (1 + z) * 0.5, z));
+				normals.push_back(Normalised(sx * (1 + z) * 0.3, sy * (1 + z) * 0.7, z));
+			}
+		}
+	}
+
+	return normals;
+}
+
+static void TestFloatRoundTrip()
+{
+	double maxError = 0.0;
+	bool inRange = true;
+	for (const Normal& normal : SweepNormals())
+	{
+		float encoded[2];
+		EncodeOctahedral(normal.v, encoded);
+		inRange &= encoded[0] >= 0.0f && encoded[0] <= 1.0f && encoded[1] >= 0.0f && encoded[1] <= 1.0f;
+
+		float decoded[3];
+		DecodeOctahedral(encoded, decoded);
+		maxError = max(maxError, AngleBetween(normal.v, decoded));
+	}
+
+	// only float rounding is lost
+	CHECK(inRange);
+	CHECK(maxError < 1e-5);
+}
+
+static void TestPackedRoundTrip()
+{
+	// 10 bits a channel, a step of 2/1023 across the square. the worst case is near the
+	// equator and the folds where the square is stretched most
+	double maxError = 0.0;
+	double sumError = 0.0;
+	vector<Normal> normals = SweepNormals();
+	for (const Normal& normal : normals)
+	{
+		float decoded[3];
+		float power;
+		UnpackNormalSpecularPower(PackNormalSpecularPower(normal.v, 32.0f), decoded, &power);
+		double error = AngleBetween(normal.v, decoded);
+		maxError = max(maxError, error);
+		sumError += error;
+	}
+
+	CHECK(maxError < 0.25 * PI / 180.0);
+	CHECK(sumError / normals.size() < 0.1 * PI / 180.0);
+}
+
+static void TestPoles()
+{
+	// as floats the poles and axes come back exactly, the fold doesn't send -z anywhere else
+	const float axes[6][3] = { { 0, 0, 1 }, { 0, 0, -1 }, { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 } };
+	for (const float* axis : axes)
+	{
+		float encoded[2];
+		float decoded[3];
+		EncodeOctahedral(axis, encoded);
+		DecodeOctahedral(encoded, decoded);
+		CHECK(decoded[0] == axis[0] && decoded[1] == axis[1] && decoded[2] == axis[2]);
+
+		// 0.5 falls between two 10 bit values, so packed they're off by under half a step
+		float power;
+		UnpackNormalSpecularPower(PackNormalSpecularPower(axis, 1.0f), decoded, &power);
+		CHECK(AngleBetween(axis, decoded) < 0.1 * PI / 180.0);
+	}
+
+	// +z is the middle of the square, -z any of its corners
+	float encoded[2];
+	EncodeOctahedral(axes[0], encoded);
+	CHECK(encoded[0] == 0.5f && encoded[1] == 0.5f);
+	EncodeOctahedral(axes[1], encoded);
+	CHECK((encoded[0] == 0.0f || encoded[0] == 1.0f) && (encoded[1] == 0.0f || encoded[1] == 1.0f));
+
+	// zero length doesn't divide by zero
+	const float zero[3] = { 0, 0, 0 };
+	EncodeOctahedral(zero, encoded);
+	CHECK(encoded[0] == 0.5f && encoded[1] == 0.5f);
+}
+
+static void TestSpecularPower()
+{
+	// log encoded, so the relative error is the same across the range
+	double maxRelative = 0.0;
+	for (float power = 1.0f; power <= GBUFFER_MAX_SPECULAR_POWER; power *= 1.07f)
+	{
+		const float up[3] = { 0, 0, 1 };
+		float normal[3];
+		float decoded;
+		UnpackNormalSpecularPower(PackNormalSpecularPower(up, power), normal, &decoded);
+		maxRelative = max(maxRelative, fabs((double)decoded - power) / power);
+	}
+	CHECK(maxRelative < 0.006);
+
+	// out of range clamps
+	CHECK_NEAR(DecodeSpecularPower(EncodeSpecularPower(0.25f)), 1.0, 1e-6);
+	CHECK_NEAR(DecodeSpecularPower(EncodeSpecularPower(1e6f)), GBUFFER_MAX_SPECULAR_POWER, 1e-2);
+}
+
+static void TestAlbedoSpecular()
+{
+	// every 8 bit value survives
+	bool exact = true;
+	for (uint32_t value = 0; value < 256; ++value)
+	{
+		float albedo[3] = { value / 255.0f, (255 - value) / 255.0f, (value * 7 % 256) / 255.0f };
+		uint32_t packed = PackAlbedoSpecular(albedo, value / 255.0f);
+
+		float unpacked[3];
+		float specular;
+		UnpackAlbedoSpecular(packed, unpacked, &specular);
+		exact &= PackAlbedoSpecular(unpacked, specular) == packed;
+		exact &= (packed & 0xFF) == value && (packed >> 24) == value;
+	}
+	CHECK(exact);
+
+	// out of range clamps as the output merger does
+	const float bright[3] = { 2.0f, -1.0f, 0.5f };
+	CHECK(PackAlbedoSpecular(bright, 1.5f) == (0xFFu | (0x00u << 8) | (0x80u << 16) | (0xFFu << 24)));
+}
+
+int main()
+{
+	RUN_TEST(TestFloatRoundTrip);
+	RUN_TEST(TestPackedRoundTrip);
+	RUN_TEST(TestPoles);
+	RUN_TEST(TestSpecularPower);
+	RUN_TEST(TestAlbedoSpecular);
+	return TestResult();
+}
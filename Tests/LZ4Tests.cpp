@@ -0,0 +1,169 @@
+#include "Test.h"
+#include "LZ4.h"
+
+#include <string.h>
+#include <vector>
+
+using namespace std;
+
+static uint32_t NextRandom(uint32_t& seed)
+{
+	seed = seed * 1664525u + 1013904223u;
+	return seed >> 8;
+}
+
+static vector<uint8_t> Compress(const vector<uint8_t>& data)
+{
+	vector<uint8_t> compressed(LZ4CompressBound(data.size()));
+	compressed.resize(LZ4CompressBlock(data.data(), data.size(), compressed.data(), compressed.size()));
+	return compressed;
+}
+
+static bool RoundTrips(const vector<uint8_t>& data)
+{
+	vector<uint8_t> compressed = Compress(data);
+	if (compressed.empty() || compressed.size() > LZ4CompressBound(data.size()))
+		return false;
+
+	// exactly sized, so a write past the end is a failure under a sanitiser
+	vector<uint8_t> decompressed(data.size());
+	return LZ4DecompressBlock(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()) &&
+	       decompressed == data;
+}
+
+static void TestEmpty()
+{
+	// the single empty token the reference encoder writes, from a null input
+	uint8_t block[16];
+	memset(block, 0xFF, sizeof(block));
+	CHECK(LZ4CompressBlock(nullptr, 0, block, sizeof(block)) == 1);
+	CHECK(block[0] == 0);
+	CHECK(LZ4CompressBlock(nullptr, 0, block, 0) == 0);
+
+	CHECK(LZ4DecompressBlock(block, 1, nullptr, 0));
+	CHECK(!LZ4DecompressBlock(nullptr, 0, nullptr, 0));
+	uint8_t literal[] = { 0x10, 'a' };
+	CHECK(!LZ4DecompressBlock(literal, sizeof(literal), nullptr, 0));
+
+	// and nothing decodes from an empty block into a buffer that expects something
+	uint8_t out[4];
+	CHECK(!LZ4DecompressBlock(block, 1, out, sizeof(out)));
+	CHECK(!LZ4DecompressBlock(block, 0, out, sizeof(out)));
+}
+
+static void TestSmall()
+{
+	// under the size where matches are looked for, everything is one literal run
+	bool ok = true;
+	for (size_t size = 1; size <= 40; ++size)
+	{
+		vector<uint8_t> data(size, 'x');
+		ok &= RoundTrips(data);
+		ok &= Compress(data).size() <= size + 1 || size > 12;
+	}
+	CHECK(ok);
+}
+
+static void TestIncompressible()
+{
+	vector<uint8_t> data(64 * 1024);
+	uint32_t seed = 7;
+	for (uint8_t& value : data)
+		value = (uint8_t)NextRandom(seed);
+
+	// no matches, so it grows by the token and the literal length's 255 run
+	vector<uint8_t> compressed = Compress(data);
+	CHECK(compressed.size() > data.size());
+	CHECK(compressed.size() <= LZ4CompressBound(data.size()));
+	CHECK(RoundTrips(data));
+
+	// and one byte less room than that fails rather than writing past it
+	vector<uint8_t> small(compressed.size() - 1);
+	CHECK(LZ4CompressBlock(data.data(), data.size(), small.data(), small.size()) == 0);
+}
+
+static void TestLongMatches()
+{
+	// a megabyte of one value is a single match with thousands of 255 length bytes
+	vector<uint8_t> zeros(1024 * 1024, 0);
+	CHECK(Compress(zeros).size() < zeros.size() / 200);
+	CHECK(RoundTrips(zeros));
+
+	// a short period copies from the bytes it is writing
+	vector<uint8_t> period(100000);
+	for (size_t i = 0; i < period.size(); ++i)
+		period[i] = (uint8_t)("abc"[i % 3]);
+	CHECK(Compress(period).size() < 1000);
+	CHECK(RoundTrips(period));
+
+	// a long literal run, then the same run again past the 64KB window and inside it
+	vector<uint8_t> far(300 * 1024);
+	uint32_t seed = 11;
+	for (size_t i = 0; i < 70 * 1024; ++i)
+		far[i] = (uint8_t)NextRandom(seed);
+	memcpy(far.data() + 70 * 1024, far.data(), 1000);
+	memcpy(far.data() + 71 * 1024, far.data() + 70 * 1024, 1000);
+	CHECK(RoundTrips(far));
+}
+
+static void TestReferenceBlock()
+{
+	// "abc", a 16 byte match at offset 3 that overlaps itself, then "xyzzy"
+	uint8_t block[] = { 0x3C, 'a', 'b', 'c', 0x03, 0x00, 0x50, 'x', 'y', 'z', 'z', 'y' };
+	const char* expected = "abcabcabcabcabcabcaxyzzy";
+	uint8_t out[24];
+	CHECK(LZ4DecompressBlock(block, sizeof(block), out, sizeof(out)));
+	CHECK(memcmp(out, expected, sizeof(out)) == 0);
+}
+
+static void TestCorrupt()
+{
+	vector<uint8_t> data(32 * 1024);
+	uint32_t seed = 3;
+	for (size_t i = 0; i < data.size(); ++i)
+		data[i] = (uint8_t)((i / 64) + (NextRandom(seed) % 16 == 0 ? NextRandom(seed) % 4 : 0));
+	vector<uint8_t> compressed = Compress(data);
+	vector<uint8_t> out(data.size());
+
+	// every truncation is caught, none of them reaches the end of the output
+	bool rejected = true;
+	for (size_t size = 0; size < compressed.size(); ++size)
+		rejected &= !LZ4DecompressBlock(compressed.data(), size, out.data(), out.size());
+	CHECK(rejected);
+
+	// the output size has to be exact
+	CHECK(!LZ4DecompressBlock(compressed.data(), compressed.size(), out.data(), out.size() - 1));
+	out.resize(data.size() + 1);
+	CHECK(!LZ4DecompressBlock(compressed.data(), compressed.size(), out.data(), out.size()));
+	out.resize(data.size());
+
+	// offsets of zero and from before the start of the output
+	uint8_t zeroOffset[] = { 0x10, 'a', 0x00, 0x00, 0x10, 'b' };
+	uint8_t farOffset[] = { 0x10, 'a', 0x02, 0x00, 0x10, 'b' };
+	uint8_t small[6];
+	CHECK(!LZ4DecompressBlock(zeroOffset, sizeof(zeroOffset), small, sizeof(small)));
+	CHECK(!LZ4DecompressBlock(farOffset, sizeof(farOffset), small, sizeof(small)));
+
+	// a literal length running off the end of the input
+	uint8_t longLiteral[] = { 0xF0, 0xFF, 0xFF };
+	CHECK(!LZ4DecompressBlock(longLiteral, sizeof(longLiteral), small, sizeof(small)));
+
+	// flipped bytes may decode to something else, but never past either buffer
+	for (size_t i = 0; i < compressed.size(); i += 7)
+	{
+		vector<uint8_t> damaged = compressed;
+		damaged[i] ^= 0x5A;
+		LZ4DecompressBlock(damaged.data(), damaged.size(), out.data(), out.size());
+	}
+}
+
+int main()
+{
+	RUN_TEST(TestEmpty);
+	RUN_TEST(TestSmall);
+	RUN_TEST(TestIncompressible);
+	RUN_TEST(TestLongMatches);
+	RUN_TEST(TestReferenceBlock);
+	RUN_TEST(TestCorrupt);
+	return TestResult();
+}
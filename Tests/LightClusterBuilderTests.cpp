@@ -0,0 +1,316 @@
+#include "Test.h"
+#include "LightClusterBuilder.h"
+
+#include <algorithm>
+#include <math.h>
+#include <vector>
+
+using namespace std;
+
+static const uint32_t SCREEN_WIDTH = 640;
+static const uint32_t SCREEN_HEIGHT = 480;
+static const float NEAR_Z = 0.01f;
+static const float FAR_Z = 100.0f;
+
+static uint32_t NextRandom(uint32_t& seed)
+{
+	seed = seed * 1664525u + 1013904223u;
+	return seed >> 8;
+}
+
+static float RandomFloat(uint32_t& seed)
+{
+	return NextRandom(seed) / 16777216.0f;
+}
+
+// the app's camera: at (0, 0, 25) looking at the origin, 90 degree vertical fov, as
+// XMMatrixLookAtLH and XMMatrixPerspectiveFovLH build them
+struct TestCamera
+{
+	float view[16];
+	float projection[16];
+
+	TestCamera()
+	{
+		const float viewRows[16] = { -1, 0, 0, 0, 0, 1, 0, 0, 0, 0, -1, 0, 0, 0, 25, 1 };
+		copy(viewRows, viewRows + 16, view);
+
+		fill(projection, projection + 16, 0.0f);
+		projection[0] = (float)SCREEN_HEIGHT / SCREEN_WIDTH;
+		projection[5] = 1.0f;
+		projection[10] = FAR_Z / (FAR_Z - NEAR_Z);
+		projection[11] = 1.0f;
+		projection[14] = -NEAR_Z * FAR_Z / (FAR_Z - NEAR_Z);
+	}
+
+	void ToView(const float* p, double& x, double& y, double& z) const
+	{
+		x = p[0] * view[0] + p[1] * view[4] + p[2] * view[8] + view[12];
+		y = p[0] * view[1] + p[1] * view[5] + p[2] * view[9] + view[13];
+		z = p[0] * view[2] + p[1] * view[6] + p[2] * view[10] + view[14];
+	}
+};
+
+// x, y, z, radius per light, spread like the app's lights. the odd count leaves a part
+// filled batch of four, and a few are placed on purpose: one around the camera that
+// crosses the near plane, one behind it, one past the far plane and one over everything
+static vector<float> BuildLights(uint32_t count, uint32_t seed)
+{
+	vector<float> lights;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		lights.push_back(RandomFloat(seed) * 60.0f - 30.0f);
+		lights.push_back(RandomFloat(seed) * 30.0f - 15.0f);
+		lights.push_back(RandomFloat(seed) * 60.0f - 30.0f);
+		lights.push_back(0.5f + RandomFloat(seed) * 3.0f);
+	}
+
+	const float placed[] = { 0.5f, 0.2f, 25.0f, 2.0f,
+	                         0.0f, 0.0f, 40.0f, 3.0f,
+	                         0.0f, 0.0f, -90.0f, 2.0f,
+	                         0.0f, 0.0f, 0.0f, 30.0f };
+	lights.insert(lights.end(), placed, placed + 16);
+	return lights;
+}
+
+static vector<uint32_t> ClusterLights(const LightClusterBuilder& builder, uint32_t cluster)
+{
+	const FrameTaggedVector<uint32_t>& clusters = builder.GetClusters();
+	const FrameTaggedVector<uint32_t>& indices = builder.GetLightIndices();
+	uint32_t offset = clusters[cluster * 2];
+	uint32_t count = clusters[cluster * 2 + 1];
+
+	vector<uint32_t> lights;
+	if (offset + count <= indices.size())
+		lights.assign(indices.begin() + offset, indices.begin() + offset + count);
+	return lights;
+}
+
+// every light against every cluster: the sphere's view space box, clipped to the near
+// plane, projected to the screen and checked against the cluster's rectangle, and its
+// depth range checked against the slice's
+static vector<vector<uint32_t>> BruteForceClusters(const LightClusterBuilder& builder, const vector<float>& lights,
+                                                   const TestCamera& camera)
+{
+	const ClusterParams& params = builder.GetParams();
+	vector<vector<uint32_t>> clusters(builder.GetClusterCount());
+
+	for (uint32_t light = 0; light < lights.size() / 4; ++light)
+	{
+		double x, y, z;
+		camera.ToView(&lights[light * 4], x, y, z);
+		double r = lights[light * 4 + 3];
+
+		double nearDepth = max(z - r, (double)NEAR_Z);
+		double farDepth = min(z + r, (double)FAR_Z);
+		if (farDepth <= nearDepth)
+			continue;
+
+		double boxNear = max(z - r, (double)NEAR_Z);
+		double boxFar = max(z + r, (double)NEAR_Z);
+		double minX = min((x - r) / boxNear, (x - r) / boxFar) * camera.projection[0];
+		double maxX = max((x + r) / boxNear, (x + r) / boxFar) * camera.projection[0];
+		double minY = min((y - r) / boxNear, (y - r) / boxFar) * camera.projection[5];
+		double maxY = max((y + r) / boxNear, (y + r) / boxFar) * camera.projection[5];
+
+		for (uint32_t slice = 0; slice < params.CountZ; ++slice)
+		{
+			// the first and last slices reach to anything clamped into them
+			double sliceNear = slice == 0 ? 0.0 : exp((slice - params.SliceBias) / params.SliceScale);
+			double sliceFar = slice + 1 == params.CountZ ? 1e30 : exp((slice + 1 - params.SliceBias) / params.SliceScale);
+			if (farDepth < sliceNear || nearDepth >= sliceFar)
+				continue;
+
+			for (uint32_t tileY = 0; tileY < params.CountY; ++tileY)
+			{
+				// tiles count down the screen
+				double tileTop = 1.0 - 2.0 * tileY / params.CountY;
+				double tileBottom = 1.0 - 2.0 * (tileY + 1) / params.CountY;
+				if (minY > tileTop || maxY <= tileBottom)
+					continue;
+
+				for (uint32_t tileX = 0; tileX < params.CountX; ++tileX)
+				{
+					double tileLeft = 2.0 * tileX / params.CountX - 1.0;
+					double tileRight = 2.0 * (tileX + 1) / params.CountX - 1.0;
+					if (maxX < tileLeft || minX >= tileRight)
+						continue;
+
+					clusters[(slice * params.CountY + tileY) * params.CountX + tileX].push_back(light);
+				}
+			}
+		}
+	}
+
+	return clusters;
+}
+
+static void TestMatchesBruteForce()
+{
+	TestCamera camera;
+	vector<float> lights = BuildLights(1001, 12345);
+	uint32_t lightCount = (uint32_t)lights.size() / 4;
+
+	LightClusterBuilder builder;
+	builder.Init(SCREEN_WIDTH, SCREEN_HEIGHT, NEAR_Z, FAR_Z);
+	builder.Build(lights.data(), lightCount, 4, camera.view, camera.projection, nullptr);
+	CHECK(builder.GetParams().LightCount == lightCount);
+	CHECK(builder.GetClusterCount() == 16 * 9 * 24);
+
+	vector<vector<uint32_t>> expected = BruteForceClusters(builder, lights, camera);
+
+	uint32_t mismatches = 0;
+	size_t total = 0;
+	vector<bool> seen(lightCount, false);
+	for (uint32_t cluster = 0; cluster < builder.GetClusterCount(); ++cluster)
+	{
+		vector<uint32_t> binned = ClusterLights(builder, cluster);
+		mismatches += binned != expected[cluster];
+		total += binned.size();
+		for (uint32_t light : binned)
+			seen[light] = true;
+	}
+	CHECK(mismatches == 0);
+	CHECK(total == builder.GetLightIndices().size());
+
+	// the lights behind the camera and past the far plane are nowhere, the big one and
+	// the one around the camera are binned
+	CHECK(seen[lightCount - 4]);
+	CHECK(!seen[lightCount - 3]);
+	CHECK(!seen[lightCount - 2]);
+	CHECK(seen[lightCount - 1]);
+
+	// the same lists spread over jobs, and from lights with colour after the sphere
+	JobSystem jobs;
+	jobs.Init(3);
+	LightClusterBuilder parallel;
+	parallel.Init(SCREEN_WIDTH, SCREEN_HEIGHT, NEAR_Z, FAR_Z);
+	parallel.Build(lights.data(), lightCount, 4, camera.view, camera.projection, &jobs);
+	CHECK(parallel.GetClusters() == builder.GetClusters());
+	CHECK(parallel.GetLightIndices() == builder.GetLightIndices());
+
+	vector<float> wide;
+	for (uint32_t light = 0; light < lightCount; ++light)
+	{
+		wide.insert(wide.end(), lights.begin() + light * 4, lights.begin() + light * 4 + 4);
+		wide.insert(wide.end(), { 1.0f, 0.5f, 0.25f, 1.0f });
+	}
+	parallel.Build(wide.data(), lightCount, 8, camera.view, camera.projection, &jobs);
+	CHECK(parallel.GetClusters() == builder.GetClusters());
+	CHECK(parallel.GetLightIndices() == builder.GetLightIndices());
+}
+
+static void TestPixelsFindTheirLights()
+{
+	// points inside each sphere, put in a cluster the way the shader does for a pixel
+	// at that depth, have to find the light there
+	TestCamera camera;
+	vector<float> lights = BuildLights(500, 777);
+	uint32_t lightCount = (uint32_t)lights.size() / 4;
+
+	LightClusterBuilder builder;
+	builder.Init(SCREEN_WIDTH, SCREEN_HEIGHT, NEAR_Z, FAR_Z);
+	builder.Build(lights.data(), lightCount, 4, camera.view, camera.projection, nullptr);
+	const ClusterParams& params = builder.GetParams();
+
+	uint32_t missed = 0;
+	uint32_t checked = 0;
+	for (uint32_t light = 0; light < lightCount; ++light)
+	{
+		const float* sphere = &lights[light * 4];
+		for (int i = -4; i <= 4; ++i)
+			for (int j = -4; j <= 4; ++j)
+				for (int k = -4; k <= 4; ++k)
+				{
+					// just inside the surface, so no point sits on a cluster's edge
+					if (i * i + j * j + k * k > 16)
+						continue;
+
+					float scale = sphere[3] * 0.99f / 4.0f;
+					float point[3] = { sphere[0] + i * scale, sphere[1] + j * scale, sphere[2] + k * scale };
+					double x, y, z;
+					camera.ToView(point, x, y, z);
+					if (z <= NEAR_Z || z >= FAR_Z)
+						continue;
+
+					double ndcX = x * camera.projection[0] / z;
+					double ndcY = y * camera.projection[5] / z;
+					if (fabs(ndcX) >= 1.0 || fabs(ndcY) >= 1.0)
+						continue;
+
+					uint32_t tileX = (uint32_t)((ndcX * 0.5 + 0.5) * params.CountX);
+					uint32_t tileY = (uint32_t)((0.5 - ndcY * 0.5) * params.CountY);
+					double slice = min(max(log(z) * params.SliceScale + params.SliceBias, 0.0), params.CountZ - 1.0);
+					uint32_t cluster = ((uint32_t)slice * params.CountY + tileY) * params.CountX + tileX;
+
+					vector<uint32_t> binned = ClusterLights(builder, cluster);
+					missed += find(binned.begin(), binned.end(), light) == binned.end();
+					++checked;
+				}
+	}
+
+	CHECK(checked > 10000);
+	CHECK(missed == 0);
+}
+
+static void TestIndexLimit()
+{
+	TestCamera camera;
+	vector<float> lights = BuildLights(300, 99);
+	uint32_t lightCount = (uint32_t)lights.size() / 4;
+
+	LightClusterBuilder full;
+	full.Init(SCREEN_WIDTH, SCREEN_HEIGHT, NEAR_Z, FAR_Z);
+	full.Build(lights.data(), lightCount, 4, camera.view, camera.projection, nullptr);
+	CHECK(full.GetLightIndices().size() > 1000);
+
+	// the list stops at the limit, clusters past it lose their lights and every range
+	// still points inside the list
+	LightClusterBuilder limited;
+	limited.Init(SCREEN_WIDTH, SCREEN_HEIGHT, NEAR_Z, FAR_Z, 16, 9, 24, 1000);
+	limited.Build(lights.data(), lightCount, 4, camera.view, camera.projection, nullptr);
+
+	const FrameTaggedVector<uint32_t>& indices = limited.GetLightIndices();
+	CHECK(indices.size() == 1000);
+	CHECK(equal(indices.begin(), indices.end(), full.GetLightIndices().begin()));
+
+	bool inside = true;
+	bool subsets = true;
+	for (uint32_t cluster = 0; cluster < limited.GetClusterCount(); ++cluster)
+	{
+		const FrameTaggedVector<uint32_t>& clusters = limited.GetClusters();
+		inside &= clusters[cluster * 2] + clusters[cluster * 2 + 1] <= indices.size();
+
+		vector<uint32_t> kept = ClusterLights(limited, cluster);
+		vector<uint32_t> all = ClusterLights(full, cluster);
+		subsets &= kept.size() <= all.size() && equal(kept.begin(), kept.end(), all.begin());
+	}
+	CHECK(inside);
+	CHECK(subsets);
+}
+
+static void TestNoLights()
+{
+	TestCamera camera;
+	LightClusterBuilder builder;
+	builder.Init(SCREEN_WIDTH, SCREEN_HEIGHT, NEAR_Z, FAR_Z, 4, 3, 8);
+	builder.Build(nullptr, 0, 4, camera.view, camera.projection, nullptr);
+
+	CHECK(builder.GetClusterCount() == 4 * 3 * 8);
+	CHECK(builder.GetLightIndices().empty());
+	CHECK(builder.GetParams().TileSize[0] == 160.0f && builder.GetParams().TileSize[1] == 160.0f);
+
+	bool empty = true;
+	for (uint32_t value : builder.GetClusters())
+		empty &= value == 0;
+	CHECK(empty);
+}
+
+int main()
+{
+	RUN_TEST(TestMatchesBruteForce);
+	RUN_TEST(TestPixelsFindTheirLights);
+	RUN_TEST(TestIndexLimit);
+	RUN_TEST(TestNoLights);
+	return TestResult();
+}
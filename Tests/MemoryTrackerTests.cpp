@@ -0,0 +1,167 @@
+#include "Test.h"
+#include "MemoryTracker.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// the counters are global, so each test leaves every tag as it found it
+static void TestTagAccounting()
+{
+	MemoryTagStats mesh = MemoryTracker::GetStats(MEMORY_TAG_MESH);
+	MemoryTagStats texture = MemoryTracker::GetStats(MEMORY_TAG_TEXTURE);
+	CHECK(mesh.Name == string("mesh") && texture.Name == string("texture"));
+
+	void* a = MemoryTracker::Allocate(100, MEMORY_TAG_MESH);
+	void* b = MemoryTracker::Allocate(200, MEMORY_TAG_MESH);
+	void* c = MemoryTracker::Allocate(50, MEMORY_TAG_TEXTURE);
+	// the header keeps malloc's alignment for what follows it
+	CHECK((uintptr_t)a % 16 == 0 && (uintptr_t)b % 16 == 0 && (uintptr_t)c % 16 == 0);
+
+	MemoryTagStats stats = MemoryTracker::GetStats(MEMORY_TAG_MESH);
+	CHECK(stats.LiveBytes == mesh.LiveBytes + 300);
+	CHECK(stats.LiveAllocations == mesh.LiveAllocations + 2);
+	CHECK(stats.TotalAllocations == mesh.TotalAllocations + 2);
+	CHECK(stats.PeakBytes >= mesh.LiveBytes + 300);
+	CHECK(MemoryTracker::GetStats(MEMORY_TAG_TEXTURE).LiveBytes == texture.LiveBytes + 50);
+
+	// a free goes back to the tag it was made with, the peak stays
+	MemoryTracker::Free(b);
+	MemoryTracker::Free(c);
+	MemoryTracker::Free(nullptr);
+	stats = MemoryTracker::GetStats(MEMORY_TAG_MESH);
+	CHECK(stats.LiveBytes == mesh.LiveBytes + 100);
+	CHECK(stats.LiveAllocations == mesh.LiveAllocations + 1);
+	CHECK(stats.TotalAllocations == mesh.TotalAllocations + 2);
+	CHECK(stats.PeakBytes >= mesh.LiveBytes + 300);
+	CHECK(MemoryTracker::GetStats(MEMORY_TAG_TEXTURE).LiveBytes == texture.LiveBytes);
+	MemoryTracker::Free(a);
+	CHECK(MemoryTracker::GetStats(MEMORY_TAG_MESH).LiveBytes == mesh.LiveBytes);
+
+	// the containers charge their tag for what they hold, and give it back
+	{
+		ShaderVector<uint32_t> shader(1000);
+		stats = MemoryTracker::GetStats(MEMORY_TAG_SHADER);
+		CHECK(stats.LiveBytes >= 4000 && stats.LiveAllocations >= 1);
+		CHECK(MemoryTracker::GetStats(MEMORY_TAG_MESH).LiveBytes == mesh.LiveBytes);
+	}
+	CHECK(MemoryTracker::GetStats(MEMORY_TAG_SHADER).LiveBytes == 0);
+
+	// memory someone else allocated counts the same way
+	MemoryTracker::TrackExternal(MEMORY_TAG_TEXTURE, 4096);
+	stats = MemoryTracker::GetStats(MEMORY_TAG_TEXTURE);
+	CHECK(stats.LiveBytes == texture.LiveBytes + 4096 && stats.LiveAllocations == texture.LiveAllocations + 1);
+	MemoryTracker::ReleaseExternal(MEMORY_TAG_TEXTURE, 4096);
+	stats = MemoryTracker::GetStats(MEMORY_TAG_TEXTURE);
+	CHECK(stats.LiveBytes == texture.LiveBytes && stats.LiveAllocations == texture.LiveAllocations);
+	CHECK(stats.PeakBytes >= texture.LiveBytes + 4096);
+}
+
+static void TestBudget()
+{
+	uint64_t live = MemoryTracker::GetStats(MEMORY_TAG_TEXTURE).LiveBytes;
+	uint64_t over = MemoryTracker::GetStats(MEMORY_TAG_TEXTURE).OverBudgetAllocations;
+	MemoryTracker::SetBudget(MEMORY_TAG_TEXTURE, live + 1000);
+
+	// going over counts each allocation past the budget but still hands them out
+	void* first = MemoryTracker::Allocate(600, MEMORY_TAG_TEXTURE);
+	CHECK(MemoryTracker::GetStats(MEMORY_TAG_TEXTURE).OverBudgetAllocations == over);
+	void* second = MemoryTracker::Allocate(600, MEMORY_TAG_TEXTURE);
+	void* third = MemoryTracker::Allocate(1, MEMORY_TAG_TEXTURE);
+	CHECK(second && third);
+	CHECK(MemoryTracker::GetStats(MEMORY_TAG_TEXTURE).OverBudgetAllocations == over + 2);
+
+	// back under it nothing more is counted
+	MemoryTracker::Free(second);
+	MemoryTracker::Free(third);
+	void* fourth = MemoryTracker::Allocate(400, MEMORY_TAG_TEXTURE);
+	CHECK(MemoryTracker::GetStats(MEMORY_TAG_TEXTURE).OverBudgetAllocations == over + 2);
+
+	string report = MemoryTracker::FormatReport();
+	CHECK(report.find("budget " + to_string(live + 1000) + " (2 allocations over)") != string::npos);
+
+	MemoryTracker::Free(first);
+	MemoryTracker::Free(fourth);
+	MemoryTracker::SetBudget(MEMORY_TAG_TEXTURE, 0);
+	CHECK(MemoryTracker::FormatReport().find("budget") == string::npos);
+}
+
+static void TestThreads()
+{
+	MemoryTagStats before = MemoryTracker::GetStats(MEMORY_TAG_FRAME);
+
+	const int threadCount = 4;
+	const int allocationsPerThread = 10000;
+	vector<thread> threads;
+	for (int t = 0; t < threadCount; ++t)
+	{
+		threads.emplace_back([]()
+		{
+			void* held[8] = {};
+			for (int i = 0; i < allocationsPerThread; ++i)
+			{
+				MemoryTracker::Free(held[i % 8]);
+				held[i % 8] = MemoryTracker::Allocate(1 + i % 64, MEMORY_TAG_FRAME);
+			}
+			for (void* memory : held)
+				MemoryTracker::Free(memory);
+		});
+	}
+	for (thread& worker : threads)
+		worker.join();
+
+	MemoryTagStats after = MemoryTracker::GetStats(MEMORY_TAG_FRAME);
+	CHECK(after.LiveBytes == before.LiveBytes);
+	CHECK(after.LiveAllocations == before.LiveAllocations);
+	CHECK(after.TotalAllocations == before.TotalAllocations + threadCount * allocationsPerThread);
+	// every thread held at least eight small blocks at once
+	CHECK(after.PeakBytes >= before.LiveBytes + 8);
+	CHECK(after.PeakBytes <= before.LiveBytes + threadCount * 8 * 64);
+}
+
+static void TestLeakReport()
+{
+	// the tests above gave everything back
+	CHECK(MemoryTracker::FormatLeaks().empty());
+
+	void* shader = MemoryTracker::Allocate(48, MEMORY_TAG_SHADER);
+	void* mesh = MemoryTracker::Allocate(16, MEMORY_TAG_MESH);
+	void* otherMesh = MemoryTracker::Allocate(8, MEMORY_TAG_MESH);
+	MemoryTracker::TrackExternal(MEMORY_TAG_TEXTURE, 1024);
+
+	// in tag order, only the tags with something left
+	CHECK(MemoryTracker::FormatLeaks() ==
+		"memory leak: mesh, 24 bytes in 2 allocations\n"
+		"memory leak: texture, 1024 bytes in 1 allocations\n"
+		"memory leak: shader, 48 bytes in 1 allocations\n");
+
+	MemoryTracker::Free(mesh);
+	MemoryTracker::Free(otherMesh);
+	MemoryTracker::ReleaseExternal(MEMORY_TAG_TEXTURE, 1024);
+	CHECK(MemoryTracker::FormatLeaks() == "memory leak: shader, 48 bytes in 1 allocations\n");
+
+	// an external release that doesn't match what was tracked shows up too
+	MemoryTracker::Free(shader);
+	MemoryTracker::TrackExternal(MEMORY_TAG_MESH, 100);
+	MemoryTracker::ReleaseExternal(MEMORY_TAG_MESH, 60);
+	CHECK(MemoryTracker::FormatLeaks() == "memory leak: mesh, 40 bytes in 0 allocations\n");
+	MemoryTracker::TrackExternal(MEMORY_TAG_MESH, 60);
+	MemoryTracker::ReleaseExternal(MEMORY_TAG_MESH, 100);
+	CHECK(MemoryTracker::FormatLeaks().empty());
+
+	// the report has a line per tag whatever is live
+	string report = MemoryTracker::FormatReport();
+	CHECK(report.find("memory mesh     live          0 peak ") == 0);
+	CHECK(report.find("memory frame ") != string::npos);
+}
+
+int main()
+{
+	RUN_TEST(TestTagAccounting);
+	RUN_TEST(TestBudget);
+	RUN_TEST(TestThreads);
+	RUN_TEST(TestLeakReport);
+	return TestResult();
+}
@@ -0,0 +1,153 @@
+#include "Test.h"
+#include "HotPathBenchmarks.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static uint64_t s_iterations;
+
+static void CountingBenchmark(MicroBenchmarkState& state)
+{
+	for (uint64_t i = 0; i < state.Iterations; ++i)
+		MicroBenchmarkSink(&i);
+	s_iterations += state.Iterations;
+}
+
+// the teardown after StopTiming is far longer than the timed loop
+static void TeardownBenchmark(MicroBenchmarkState& state)
+{
+	for (uint64_t i = 0; i < state.Iterations; ++i)
+		MicroBenchmarkSink(&i);
+	state.StopTiming();
+
+	chrono::steady_clock::time_point end = chrono::steady_clock::now() + chrono::milliseconds(5);
+	while (chrono::steady_clock::now() < end)
+	{
+	}
+}
+
+static MicroBenchmarkResult Result(const char* name, double ns, double minNs)
+{
+	MicroBenchmarkResult result;
+	result.Name = name;
+	result.Iterations = 1000;
+	result.NsPerIteration = ns;
+	result.MinNsPerIteration = minNs;
+	return result;
+}
+
+static void TestRun()
+{
+	MicroBenchmarkSuite suite;
+	suite.Add("count", CountingBenchmark, { 1, 7 });
+	suite.Add("other", CountingBenchmark, { 3 });
+	suite.SetRepetitions(0.001, 3);
+
+	vector<MicroBenchmarkResult> results;
+	s_iterations = 0;
+	suite.Run(nullptr, results);
+	CHECK(results.size() == 3);
+	if (results.size() != 3)
+		return;
+
+	CHECK(results[0].Name == "count/1" && results[1].Name == "count/7" && results[2].Name == "other/3");
+	for (const MicroBenchmarkResult& result : results)
+	{
+		CHECK(result.Iterations > 0);
+		CHECK(result.MinNsPerIteration > 0.0 && result.MinNsPerIteration <= result.NsPerIteration);
+	}
+	// the growing runs then three repetitions of the count settled on, for every argument
+	CHECK(s_iterations > 3 * (results[0].Iterations + results[1].Iterations + results[2].Iterations));
+
+	suite.Run("oth", results);
+	CHECK(results.size() == 1 && results[0].Name == "other/3");
+	suite.Run("", results);
+	CHECK(results.size() == 3);
+}
+
+static void TestStopTiming()
+{
+	MicroBenchmarkSuite suite;
+	suite.Add("teardown", TeardownBenchmark, { 1 });
+	suite.SetRepetitions(0.0001, 1);
+
+	// a repetition is timed to about 0.1ms, the 5ms teardown would swamp it if it counted
+	vector<MicroBenchmarkResult> results;
+	suite.Run(nullptr, results);
+	CHECK(results.size() == 1);
+	if (results.size() == 1)
+		CHECK(results[0].NsPerIteration * results[0].Iterations < 2.5e6);
+}
+
+static void TestCompare()
+{
+	vector<MicroBenchmarkResult> baseline = { Result("a/1", 100.0, 90.0), Result("b/1", 100.0, 90.0),
+	                                          Result("c/1", 100.0, 90.0), Result("gone/1", 1.0, 1.0) };
+	vector<MicroBenchmarkResult> results = { Result("a/1", 120.0, 100.0), Result("b/1", 120.0, 95.0),
+	                                         Result("c/1", 105.0, 105.0), Result("new/1", 1000.0, 1000.0) };
+
+	// only a, slower past the 10% in the median and the fastest run both
+	vector<MicroBenchmarkRegression> regressions;
+	MicroBenchmarkSuite::Compare(baseline, results, 0.1, regressions);
+	CHECK(regressions.size() == 1);
+	if (regressions.size() == 1)
+	{
+		CHECK(regressions[0].Name == "a/1");
+		CHECK(regressions[0].BaselineNs == 100.0 && regressions[0].CurrentNs == 120.0);
+	}
+
+	MicroBenchmarkSuite::Compare(baseline, results, 0.5, regressions);
+	CHECK(regressions.empty());
+}
+
+static void TestResultsFile()
+{
+	vector<MicroBenchmarkResult> results = { Result("lz4_compress/4", 1234.5678, 1200.25), Result("hash_bytes/64", 0.125, 0.1) };
+	CHECK(MicroBenchmarkSuite::WriteResults(L"_microbenchmark_test.csv", results));
+
+	vector<MicroBenchmarkResult> read;
+	CHECK(MicroBenchmarkSuite::ReadResults(L"_microbenchmark_test.csv", read));
+	remove("_microbenchmark_test.csv");
+
+	// the header line is skipped, values keep three decimals
+	CHECK(read.size() == 2);
+	if (read.size() == 2)
+	{
+		CHECK(read[0].Name == "lz4_compress/4" && read[0].Iterations == 1000);
+		CHECK_NEAR(read[0].NsPerIteration, 1234.568, 1e-9);
+		CHECK_NEAR(read[0].MinNsPerIteration, 1200.25, 1e-9);
+		CHECK(read[1].Name == "hash_bytes/64");
+		CHECK_NEAR(read[1].NsPerIteration, 0.125, 1e-9);
+	}
+
+	CHECK(!MicroBenchmarkSuite::ReadResults(L"_no_such_results.csv", read));
+	CHECK(read.empty());
+}
+
+static void TestHotPathCases()
+{
+	// every portable case runs to completion, what MicroBenchmark -quick does
+	MicroBenchmarkSuite suite;
+	AddHotPathBenchmarks(suite);
+	suite.SetRepetitions(0.0001, 1);
+
+	vector<MicroBenchmarkResult> results;
+	suite.Run(nullptr, results);
+	CHECK(results.size() == 39);
+	for (const MicroBenchmarkResult& result : results)
+		CHECK(result.Iterations > 0 && result.NsPerIteration > 0.0);
+}
+
+int main()
+{
+	RUN_TEST(TestRun);
+	RUN_TEST(TestStopTiming);
+	RUN_TEST(TestCompare);
+	RUN_TEST(TestResultsFile);
+	RUN_TEST(TestHotPathCases);
+	return TestResult();
+}
@@ -0,0 +1,216 @@
+#include "Test.h"
+#include "ResolutionController.h"
+
+#include <vector>
+
+using namespace std;
+
+static const double BUDGET = 1.0 / 60.0;
+// as ReplayFrameTimeTrace's default, a fifth of the frame doesn't scale with pixels
+static const float FIXED = 0.2f;
+
+// what a frame recorded at full resolution costs at scale
+static double ScaledTime(double fullTime, float scale)
+{
+	return fullTime * (FIXED + (1.0f - FIXED) * scale * scale);
+}
+
+// a full resolution frame time of load budgets with up to noise of it either way, from a
+// fixed seed so every run sees the same trace
+static vector<double> MakeTrace(size_t frames, double load, double noise, uint32_t seed = 1)
+{
+	vector<double> trace;
+	for (size_t i = 0; i < frames; ++i)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		double r = (seed >> 8) / 16777216.0 * 2.0 - 1.0;
+		trace.push_back(load * BUDGET * (1.0 + noise * r));
+	}
+	return trace;
+}
+
+// replays a trace frame by frame and keeps the scale each frame rendered at
+static vector<float> Replay(ResolutionController& controller, const vector<double>& trace)
+{
+	vector<float> scales;
+	float scale = controller.GetScale();
+	for (double fullTime : trace)
+	{
+		scales.push_back(scale);
+		scale = controller.Update(ScaledTime(fullTime, scale));
+	}
+	return scales;
+}
+
+// times the scale changed direction, each one is half a cycle of hunting
+static int Reversals(const vector<float>& scales, size_t from)
+{
+	int reversals = 0;
+	int lastDirection = 0;
+	for (size_t i = from + 1; i < scales.size(); ++i)
+	{
+		int direction = scales[i] > scales[i - 1] ? 1 : scales[i] < scales[i - 1] ? -1 : 0;
+		if (direction && lastDirection && direction != lastDirection)
+			++reversals;
+		if (direction)
+			lastDirection = direction;
+	}
+	return reversals;
+}
+
+static void TestConvergence()
+{
+	// a steady load the minimum scale can meet settles inside the band around the budget
+	// within a few frames, and then holds still
+	for (double load : { 1.2, 1.5, 2.0, 2.4 })
+	{
+		ResolutionController controller;
+		controller.Init(BUDGET);
+		vector<double> trace = MakeTrace(600, load, 0.0);
+		vector<float> scales = Replay(controller, trace);
+
+		float settled = scales.back();
+		double frameTime = ScaledTime(trace.back(), settled);
+		CHECK(frameTime < BUDGET * 1.05);
+		CHECK(frameTime > BUDGET * 0.85);
+
+		bool still = true;
+		for (size_t i = 20; i < scales.size(); ++i)
+			still &= scales[i] == settled;
+		CHECK(still);
+		CHECK(Reversals(scales, 0) == 0);
+	}
+
+	// and only ever moves towards where it settles
+	ResolutionController controller;
+	controller.Init(BUDGET);
+	vector<float> scales = Replay(controller, MakeTrace(100, 2.0, 0.0));
+	for (size_t i = 1; i < scales.size(); ++i)
+		CHECK(scales[i] <= scales[i - 1]);
+}
+
+static void TestBounds()
+{
+	// plenty of room stays at full resolution
+	ResolutionController controller;
+	controller.Init(BUDGET);
+	vector<float> scales = Replay(controller, MakeTrace(300, 0.5, 0.2));
+	for (float scale : scales)
+		CHECK(scale == 1.0f);
+
+	// hitches many budgets long, and a load the minimum can't meet, stop at the minimum
+	vector<double> trace = MakeTrace(300, 1.0, 0.05);
+	for (size_t i = 10; i < trace.size(); i += 37)
+		trace[i] = 20.0 * BUDGET;
+	vector<double> heavy = MakeTrace(300, 10.0, 0.1);
+	trace.insert(trace.end(), heavy.begin(), heavy.end());
+
+	controller.Init(BUDGET, 0.6f, 0.9f);
+	scales = Replay(controller, trace);
+	CHECK(scales.front() == 0.9f);
+	bool inBounds = true;
+	bool onStep = true;
+	for (float scale : scales)
+	{
+		inBounds &= scale >= 0.6f && scale <= 0.9f;
+		// the viewport snaps to 1/64ths, other than at the limits
+		onStep &= scale == 0.6f || scale == 0.9f || scale * 64.0f == (float)(int)(scale * 64.0f);
+	}
+	CHECK(inBounds);
+	CHECK(onStep);
+	CHECK(controller.GetScale() == 0.6f);
+
+	// however long it was pinned at the minimum, the integral is bounded and the scale
+	// grows back as soon as the raise delay allows once the load goes
+	controller.Init(BUDGET, 0.6f, 0.9f);
+	Replay(controller, MakeTrace(3000, 10.0, 0.1));
+	CHECK(controller.GetScale() == 0.6f);
+	Replay(controller, MakeTrace(10, 0.4, 0.0));
+	CHECK(controller.GetScale() > 0.6f);
+}
+
+static void TestNoOscillation()
+{
+	// frame to frame noise of 5% either way settles and stays settled rather than hunting
+	ResolutionController controller;
+	controller.Init(BUDGET);
+	vector<float> scales = Replay(controller, MakeTrace(3000, 1.4, 0.05));
+
+	int changes = 0;
+	for (size_t i = 101; i < scales.size(); ++i)
+		changes += scales[i] != scales[i - 1];
+	CHECK(changes <= 5);
+	CHECK(Reversals(scales, 100) <= 2);
+
+	// a load that alternates between light and heavy frames isn't followed frame by frame
+	vector<double> alternating;
+	for (int i = 0; i < 1000; ++i)
+		alternating.push_back((i & 1 ? 1.6 : 0.9) * BUDGET);
+	controller.Init(BUDGET);
+	scales = Replay(controller, alternating);
+	CHECK(Reversals(scales, 100) <= 4);
+}
+
+static void TestRecovery()
+{
+	ResolutionController controller;
+	controller.Init(BUDGET);
+	controller.SetRaiseDelay(10);
+	Replay(controller, MakeTrace(200, 1.8, 0.0));
+	float dropped = controller.GetScale();
+	CHECK(dropped < 0.8f);
+
+	// room for nine frames isn't enough to grow
+	vector<float> scales = Replay(controller, MakeTrace(9, 0.5, 0.0));
+	for (float scale : scales)
+		CHECK(scale == dropped);
+	CHECK(controller.GetScale() == dropped);
+
+	// the tenth grows it, and it keeps growing back to full resolution
+	controller.Update(ScaledTime(0.5 * BUDGET, dropped));
+	CHECK(controller.GetScale() > dropped);
+	Replay(controller, MakeTrace(300, 0.5, 0.0));
+	CHECK(controller.GetScale() == 1.0f);
+
+	// a frame over budget drops at once
+	controller.Update(ScaledTime(1.5 * BUDGET, 1.0f));
+	CHECK(controller.GetScale() < 1.0f);
+}
+
+static void TestReplayResult()
+{
+	ResolutionController controller;
+	controller.Init(BUDGET);
+	vector<double> trace = MakeTrace(400, 2.0, 0.0);
+	ResolutionTraceResult result = ReplayFrameTimeTrace(controller, trace, FIXED);
+
+	ResolutionController check;
+	check.Init(BUDGET);
+	vector<float> scales = Replay(check, trace);
+
+	uint32_t overBudget = 0;
+	uint32_t changes = 0;
+	double scaleSum = 0.0;
+	for (size_t i = 0; i < scales.size(); ++i)
+	{
+		overBudget += ScaledTime(trace[i], scales[i]) > BUDGET;
+		changes += i + 1 < scales.size() ? scales[i + 1] != scales[i] : check.GetScale() != scales[i];
+		scaleSum += scales[i];
+	}
+
+	CHECK(result.Frames == 400);
+	CHECK(result.OverBudget == overBudget);
+	CHECK(result.ScaleChanges == changes);
+	CHECK_NEAR(result.MeanScale, scaleSum / scales.size(), 1e-5);
+	CHECK(result.MinScale == controller.GetScale());
+}
+
+int main()
+{
+	RUN_TEST(TestConvergence);
+	RUN_TEST(TestBounds);
+	RUN_TEST(TestNoOscillation);
+	RUN_TEST(TestRecovery);
+	RUN_TEST(TestReplayResult);
+	return TestResult();
+}
@@ -0,0 +1,341 @@
+#include "Test.h"
+#include "RhiNull.h"
+#include "RhiRecording.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// writes down every call it gets, update data included, so two command streams compare
+// as text
+class LoggingCommandList : public RhiCommandList
+{
+public:
+	vector<string> Calls;
+
+	void SetPipelineState(RhiPipelineState* state) override { Log("pipeline %p", state); }
+	void SetVertexBuffer(uint32_t slot, RhiBuffer* buffer, uint32_t offset) override { Log("vertex %u %p %u", slot, buffer, offset); }
+	void SetIndexBuffer(RhiBuffer* buffer, uint32_t offset) override { Log("index %p %u", buffer, offset); }
+	void SetConstantBuffer(RhiShaderStage stage, uint32_t slot, RhiBuffer* buffer) override { Log("constants %d %u %p", (int)stage, slot, buffer); }
+	void SetTexture(RhiShaderStage stage, uint32_t slot, RhiTexture* texture) override { Log("texture %d %u %p", (int)stage, slot, texture); }
+	void Draw(uint32_t vertexCount, uint32_t startVertex) override { Log("draw %u %u", vertexCount, startVertex); }
+	void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override { Log("draw indexed %u %u %d", indexCount, startIndex, baseVertex); }
+
+	void UpdateBuffer(RhiBuffer* buffer, const void* data, uint32_t bytes) override
+	{
+		Log("update %p %u", buffer, bytes);
+		if (data)
+			Calls.back().append((const char*)data, bytes);
+	}
+
+private:
+	void Log(const char* format, ...)
+	{
+		char line[128];
+		va_list args;
+		va_start(args, format);
+		vsnprintf(line, sizeof(line), format, args);
+		va_end(args);
+		Calls.push_back(line);
+	}
+};
+
+static const uint8_t BYTECODE[4] = { 1, 2, 3, 4 };
+
+struct TestScene
+{
+	RhiShader* vertexShader;
+	RhiShader* pixelShader;
+	RhiPipelineState* pipeline;
+	RhiBuffer* vertices;
+	RhiBuffer* indices;
+	RhiBuffer* constants;
+	RhiTexture* texture;
+};
+
+// 24 vertices of 32 bytes, 36 16 bit indices, 64 bytes of constants and a 64x64 texture
+static void CreateScene(RhiDevice& device, TestScene& scene)
+{
+	scene.vertexShader = device.CreateShader({ RHI_STAGE_VERTEX, BYTECODE, sizeof(BYTECODE) });
+	scene.pixelShader = device.CreateShader({ RHI_STAGE_PIXEL, BYTECODE, sizeof(BYTECODE) });
+
+	RhiPipelineStateDesc desc = {};
+	desc.VertexShader = scene.vertexShader;
+	desc.PixelShader = scene.pixelShader;
+	desc.Elements[0] = { "POSITION", 0, RHI_FORMAT_R32G32B32_FLOAT, 0 };
+	desc.Elements[1] = { "NORMAL", 0, RHI_FORMAT_R32G32B32_FLOAT, RHI_APPEND_ALIGNED };
+	desc.Elements[2] = { "TEXCOORD", 0, RHI_FORMAT_R32G32_FLOAT, RHI_APPEND_ALIGNED };
+	desc.ElementCount = 3;
+	desc.Cull = RHI_CULL_BACK;
+	desc.DepthClip = desc.DepthTest = desc.DepthWrite = true;
+	scene.pipeline = device.CreatePipelineState(desc);
+
+	scene.vertices = device.CreateBuffer({ RHI_BUFFER_VERTEX, 24 * 32, 32 }, nullptr);
+	scene.indices = device.CreateBuffer({ RHI_BUFFER_INDEX, 36 * 2, 2 }, nullptr);
+	scene.constants = device.CreateBuffer({ RHI_BUFFER_CONSTANT, 64, 0 }, nullptr);
+	scene.texture = device.CreateTexture({ 64, 64, 7, 1, RHI_FORMAT_R8G8B8A8_UNORM }, nullptr);
+}
+
+static void DeleteScene(TestScene& scene)
+{
+	delete scene.texture;
+	delete scene.constants;
+	delete scene.indices;
+	delete scene.vertices;
+	delete scene.pipeline;
+	delete scene.pixelShader;
+	delete scene.vertexShader;
+}
+
+// a pass drawing the cube count times with new constants each time, the state it sets
+// only changing for the first
+static void DrawScene(RhiCommandList& commands, const TestScene& scene, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint8_t constants[64];
+		memset(constants, 'a' + i, sizeof(constants));
+
+		commands.SetPipelineState(scene.pipeline);
+		commands.SetVertexBuffer(0, scene.vertices, 0);
+		commands.SetIndexBuffer(scene.indices, 0);
+		commands.SetConstantBuffer(RHI_STAGE_VERTEX, 0, scene.constants);
+		commands.SetTexture(RHI_STAGE_PIXEL, 0, scene.texture);
+		commands.UpdateBuffer(scene.constants, constants, sizeof(constants));
+		commands.DrawIndexed(36, 0, 0);
+	}
+	commands.Draw(24, 0);
+}
+
+static void TestSurfaceBytes()
+{
+	CHECK(GetRhiSurfaceBytes(RHI_FORMAT_R8G8B8A8_UNORM, 64, 32) == 64 * 32 * 4);
+	CHECK(GetRhiSurfaceBytes(RHI_FORMAT_R32G32B32A32_FLOAT, 3, 5) == 3 * 5 * 16);
+	CHECK(GetRhiSurfaceBytes(RHI_FORMAT_R16_UINT, 7, 1) == 14);
+	// block compressed formats round up to whole 4x4 blocks
+	CHECK(GetRhiSurfaceBytes(RHI_FORMAT_BC1_UNORM, 4, 4) == 8);
+	CHECK(GetRhiSurfaceBytes(RHI_FORMAT_BC1_UNORM, 5, 1) == 16);
+	CHECK(GetRhiSurfaceBytes(RHI_FORMAT_BC3_UNORM, 1, 1) == 16);
+	CHECK(GetRhiSurfaceBytes(RHI_FORMAT_UNKNOWN, 4, 4) == 0);
+}
+
+static void TestObjects()
+{
+	NullRhiDevice device;
+	TestScene scene;
+	CreateScene(device, scene);
+	CHECK(scene.vertexShader && scene.pixelShader && scene.pipeline);
+	CHECK(scene.vertices && scene.indices && scene.constants && scene.texture);
+	CHECK(device.GetStats().Errors == 0 && device.GetFirstError().empty());
+
+	const RhiNullStats& stats = device.GetStats();
+	CHECK(stats.Buffers == 3 && stats.Shaders == 2 && stats.PipelineStates == 1 && stats.Textures == 1);
+	CHECK(stats.BufferBytes == 24 * 32 + 36 * 2 + 64);
+	// the whole chain, 64x64 down to 1x1
+	CHECK(stats.TextureBytes == 4 * (4096 + 1024 + 256 + 64 + 16 + 4 + 1));
+
+	// an array of BC1 slices with two mips, with initial data for each
+	uint8_t texels[32] = {};
+	RhiSubresourceData data[6];
+	for (RhiSubresourceData& subresource : data)
+		subresource = { texels, 16 };
+	RhiTexture* array = device.CreateTexture({ 8, 8, 2, 3, RHI_FORMAT_BC1_UNORM }, data);
+	CHECK(array && stats.TextureBytes == 4 * 5461 + 3 * (32 + 8));
+	delete array;
+
+	DeleteScene(scene);
+	CHECK(stats.Buffers == 0 && stats.Textures == 0 && stats.Shaders == 0 && stats.PipelineStates == 0);
+	CHECK(stats.BufferBytes == 0 && stats.TextureBytes == 0);
+}
+
+static void TestCreateValidation()
+{
+	NullRhiDevice device;
+	RhiShader* pixelShader = device.CreateShader({ RHI_STAGE_PIXEL, BYTECODE, sizeof(BYTECODE) });
+
+	// each of these is what the debug layer would refuse
+	CHECK(!device.CreateBuffer({ RHI_BUFFER_VERTEX, 0, 32 }, nullptr));
+	CHECK(device.GetFirstError() == "CreateBuffer: no bytes");
+	CHECK(!device.CreateBuffer({ RHI_BUFFER_VERTEX, 100, 32 }, nullptr));
+	CHECK(!device.CreateBuffer({ RHI_BUFFER_INDEX, 24, 3 }, nullptr));
+	CHECK(!device.CreateBuffer({ RHI_BUFFER_INDEX, 6, 4 }, nullptr));
+	CHECK(!device.CreateBuffer({ RHI_BUFFER_CONSTANT, 40, 0 }, nullptr));
+	CHECK(!device.CreateBuffer({ RHI_BUFFER_CONSTANT, RHI_MAX_CONSTANT_BUFFER_BYTES + 16, 0 }, nullptr));
+	CHECK(!device.CreateTexture({ 0, 4, 1, 1, RHI_FORMAT_R8G8B8A8_UNORM }, nullptr));
+	CHECK(!device.CreateTexture({ 4, 4, 1, 1, RHI_FORMAT_UNKNOWN }, nullptr));
+	CHECK(!device.CreateTexture({ 64, 16, 8, 1, RHI_FORMAT_R8G8B8A8_UNORM }, nullptr));
+	RhiSubresourceData shortPitch = { BYTECODE, 15 };
+	CHECK(!device.CreateTexture({ 4, 4, 1, 1, RHI_FORMAT_R8G8B8A8_UNORM }, &shortPitch));
+	CHECK(!device.CreateShader({ RHI_STAGE_VERTEX, nullptr, 0 }));
+	CHECK(!device.CreateShader({ RHI_STAGE_COUNT, BYTECODE, sizeof(BYTECODE) }));
+
+	RhiPipelineStateDesc desc = {};
+	desc.Elements[0] = { "POSITION", 0, RHI_FORMAT_R32G32B32_FLOAT, 0 };
+	desc.ElementCount = 1;
+	desc.VertexShader = pixelShader;
+	CHECK(!device.CreatePipelineState(desc));
+	desc.VertexShader = device.CreateShader({ RHI_STAGE_VERTEX, BYTECODE, sizeof(BYTECODE) });
+	desc.PixelShader = desc.VertexShader;
+	CHECK(!device.CreatePipelineState(desc));
+	desc.PixelShader = nullptr;
+	desc.Elements[0].Format = RHI_FORMAT_UNKNOWN;
+	CHECK(!device.CreatePipelineState(desc));
+	desc.ElementCount = 0;
+	CHECK(!device.CreatePipelineState(desc));
+
+	CHECK(device.GetStats().Errors == 16);
+	CHECK(device.GetFirstError() == "CreateBuffer: no bytes");
+	CHECK(device.GetStats().Buffers == 0 && device.GetStats().Textures == 0 && device.GetStats().PipelineStates == 0);
+
+	// and the edges of what's allowed: a depth only pipeline, the biggest constant buffer
+	// and a full chain of a non square texture
+	desc.Elements[0].Format = RHI_FORMAT_R32G32B32_FLOAT;
+	desc.ElementCount = 1;
+	RhiPipelineState* depthOnly = device.CreatePipelineState(desc);
+	RhiBuffer* constants = device.CreateBuffer({ RHI_BUFFER_CONSTANT, RHI_MAX_CONSTANT_BUFFER_BYTES, 0 }, nullptr);
+	RhiTexture* texture = device.CreateTexture({ 64, 16, 7, 1, RHI_FORMAT_R8G8B8A8_UNORM }, nullptr);
+	CHECK(depthOnly && constants && texture);
+	CHECK(device.GetStats().Errors == 16);
+
+	delete texture;
+	delete constants;
+	delete depthOnly;
+	delete desc.VertexShader;
+	delete pixelShader;
+}
+
+static void TestCommands()
+{
+	NullRhiDevice device;
+	TestScene scene;
+	CreateScene(device, scene);
+	NullRhiCommandList& commands = *static_cast<NullRhiCommandList*>(device.GetImmediateCommandList());
+
+	// three cubes: five sets that change something, then ten that don't
+	DrawScene(commands, scene, 3);
+	const RhiNullStats& stats = device.GetStats();
+	CHECK(stats.Errors == 0);
+	CHECK(stats.Draws == 4 && stats.Primitives == 3 * 12 + 8);
+	CHECK(stats.StateChanges == 15 && stats.RedundantStateChanges == 10);
+	CHECK(stats.Updates == 3 && stats.UploadBytes == 3 * 64);
+
+	// the creates stay counted, the commands start over
+	device.ResetCommandStats();
+	CHECK(stats.Draws == 0 && stats.StateChanges == 0 && stats.UploadBytes == 0);
+	CHECK(stats.Buffers == 3);
+
+	// nothing bound after a clear, so the same sets all change something again
+	commands.ClearState();
+	DrawScene(commands, scene, 1);
+	CHECK(stats.RedundantStateChanges == 0 && stats.Errors == 0);
+
+	// draws past the end of their buffers, and commands given the wrong things, fail
+	// without counting
+	device.ResetCommandStats();
+	uint8_t constants[64] = {};
+	commands.Draw(25, 0);
+	commands.Draw(1, 24);
+	commands.DrawIndexed(36, 1, 0);
+	commands.SetVertexBuffer(RHI_MAX_VERTEX_BUFFERS, scene.vertices, 0);
+	commands.SetVertexBuffer(0, scene.indices, 0);
+	commands.SetVertexBuffer(0, scene.vertices, 24 * 32);
+	commands.SetIndexBuffer(scene.vertices, 0);
+	commands.SetConstantBuffer(RHI_STAGE_VERTEX, RHI_MAX_CONSTANT_BUFFERS, scene.constants);
+	commands.SetConstantBuffer(RHI_STAGE_PIXEL, 0, scene.vertices);
+	commands.SetTexture(RHI_STAGE_COUNT, 0, scene.texture);
+	commands.UpdateBuffer(scene.constants, constants, 48);
+	commands.UpdateBuffer(scene.vertices, constants, 24 * 32 + 1);
+	commands.UpdateBuffer(scene.vertices, nullptr, 16);
+	CHECK(stats.Errors == 13);
+	CHECK(stats.Draws == 0 && stats.StateChanges == 0 && stats.Updates == 0);
+
+	// a vertex buffer update needn't cover the whole buffer
+	commands.UpdateBuffer(scene.vertices, constants, 64);
+	CHECK(stats.Updates == 1 && stats.Errors == 13);
+
+	commands.ClearState();
+	commands.Draw(3, 0);
+	commands.SetPipelineState(scene.pipeline);
+	commands.SetVertexBuffer(0, scene.vertices, 0);
+	commands.DrawIndexed(3, 0, 0);
+	CHECK(stats.Errors == 15);
+	CHECK(device.GetFirstError() == "Draw: vertices 0 to 25 are past the end of the buffer");
+
+	DeleteScene(scene);
+}
+
+static void TestRecording()
+{
+	NullRhiDevice device;
+	TestScene scene;
+	CreateScene(device, scene);
+
+	// a recording replays exactly the calls made on it, in order
+	LoggingCommandList direct;
+	DrawScene(direct, scene, 4);
+
+	RecordingRhiCommandList recording;
+	DrawScene(recording, scene, 4);
+	CHECK(recording.GetCommandCount() == direct.Calls.size());
+	CHECK(recording.GetDataBytes() == 4 * 64);
+
+	LoggingCommandList replayed;
+	recording.Execute(replayed);
+	CHECK(replayed.Calls == direct.Calls);
+
+	// and can run again, on the null device giving what the calls made directly give
+	LoggingCommandList again;
+	recording.Execute(again);
+	CHECK(again.Calls == direct.Calls);
+
+	DrawScene(*device.GetImmediateCommandList(), scene, 4);
+	RhiNullStats directStats = device.GetStats();
+	device.ResetCommandStats();
+	static_cast<NullRhiCommandList*>(device.GetImmediateCommandList())->ClearState();
+	recording.Execute(*device.GetImmediateCommandList());
+	const RhiNullStats& recordedStats = device.GetStats();
+	CHECK(memcmp(&directStats, &recordedStats, sizeof(RhiNullStats)) == 0);
+
+	// update data is copied when it's recorded, the caller's buffer can go
+	recording.Reset();
+	CHECK(recording.GetCommandCount() == 0 && recording.GetDataBytes() == 0);
+	{
+		uint8_t constants[64];
+		memset(constants, 'x', sizeof(constants));
+		recording.UpdateBuffer(scene.constants, constants, sizeof(constants));
+		memset(constants, 'y', sizeof(constants));
+		recording.DrawIndexed(6, 30, -4);
+	}
+	LoggingCommandList copied;
+	recording.Execute(copied);
+	CHECK(copied.Calls.size() == 2);
+	if (copied.Calls.size() == 2)
+	{
+		CHECK(copied.Calls[0].substr(copied.Calls[0].size() - 64) == string(64, 'x'));
+		CHECK(copied.Calls[1] == "draw indexed 6 30 -4");
+	}
+
+	// a bad command recorded is still bad when it's replayed
+	recording.Reset();
+	recording.UpdateBuffer(scene.constants, nullptr, 64);
+	recording.Draw(100, 0);
+	uint64_t errors = device.GetStats().Errors;
+	recording.Execute(*device.GetImmediateCommandList());
+	CHECK(device.GetStats().Errors == errors + 2);
+
+	DeleteScene(scene);
+}
+
+int main()
+{
+	RUN_TEST(TestSurfaceBytes);
+	RUN_TEST(TestObjects);
+	RUN_TEST(TestCreateValidation);
+	RUN_TEST(TestCommands);
+	RUN_TEST(TestRecording);
+	return TestResult();
+}
@@ -0,0 +1,104 @@
+#include "Test.h"
+#include "SceneAnimation.h"
+
+#include <math.h>
+#include <vector>
+
+using namespace std;
+
+static const float PI = 3.14159265f;
+
+static const float* Row(const vector<float>& worldMatrices, uint32_t body, uint32_t row)
+{
+	return &worldMatrices[body * 16 + row * 4];
+}
+
+static bool RowNear(const vector<float>& worldMatrices, uint32_t body, uint32_t row, float x, float y, float z, float w)
+{
+	const float* values = Row(worldMatrices, body, row);
+	return fabsf(values[0] - x) < 1e-4f && fabsf(values[1] - y) < 1e-4f && fabsf(values[2] - z) < 1e-4f &&
+	       fabsf(values[3] - w) < 1e-4f;
+}
+
+static void TestStart()
+{
+	// at t = 0 only the scales and the orbit radii are left
+	vector<float> worldMatrices(NAMED_BODY_COUNT * 16);
+	AnimateBodies(0.0f, worldMatrices.data(), NAMED_BODY_COUNT);
+
+	CHECK(RowNear(worldMatrices, 0, 0, 3, 0, 0, 0));
+	CHECK(RowNear(worldMatrices, 0, 1, 0, 3, 0, 0));
+	CHECK(RowNear(worldMatrices, 0, 2, 0, 0, 3, 0));
+	CHECK(RowNear(worldMatrices, 0, 3, 0, 0, 0, 1));
+
+	CHECK(RowNear(worldMatrices, 1, 0, 0.6f, 0, 0, 0));
+	CHECK(RowNear(worldMatrices, 1, 3, 6, 0, 0, 1));
+	CHECK(RowNear(worldMatrices, 2, 3, 9, 0, 0, 1));
+	CHECK(RowNear(worldMatrices, 3, 0, 0.125f, 0, 0, 0));
+	CHECK(RowNear(worldMatrices, 3, 3, 12, 0, 0, 1));
+	CHECK(RowNear(worldMatrices, 4, 3, 9, 0, 0, 1));
+}
+
+static void TestRotations()
+{
+	// the sun turns a quarter about every axis at once. rolling about z, then pitching
+	// about x, then yawing about y leaves x on x, y on z and z on -y
+	vector<float> worldMatrices(NAMED_BODY_COUNT * 16);
+	AnimateBodies(PI / 20.0f, worldMatrices.data(), NAMED_BODY_COUNT);
+	CHECK(RowNear(worldMatrices, 0, 0, 3, 0, 0, 0));
+	CHECK(RowNear(worldMatrices, 0, 1, 0, 0, 3, 0));
+	CHECK(RowNear(worldMatrices, 0, 2, 0, -3, 0, 0));
+
+	// mars is a quarter of the way round its orbit, which a left handed yaw takes to -z
+	AnimateBodies(PI / 10.0f, worldMatrices.data(), NAMED_BODY_COUNT);
+	CHECK(RowNear(worldMatrices, 1, 3, 0, 0, -6, 1));
+}
+
+static void TestAsteroids()
+{
+	// every asteroid sits on its belt radius and height, however it is turned
+	const uint32_t count = 200;
+	const float t = 3.7f;
+	vector<float> worldMatrices(count * 16);
+	AnimateBodies(t, worldMatrices.data(), count);
+
+	bool onBelt = true;
+	bool scaled = true;
+	for (uint32_t i = NAMED_BODY_COUNT; i < count; ++i)
+	{
+		uint32_t n = i - NAMED_BODY_COUNT;
+		float radius = 12.0f + (n % 8) * 0.5f;
+		float height = ((n % 7) - 3.0f) * 0.25f;
+		float angle = n * 2.39996f + t * (1.0f + (n % 5) * 0.25f);
+		onBelt &= RowNear(worldMatrices, i, 3, radius * cosf(angle), height, -radius * sinf(angle), 1);
+
+		for (uint32_t row = 0; row < 3; ++row)
+		{
+			const float* axis = Row(worldMatrices, i, row);
+			scaled &= fabsf(sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]) - 0.2f) < 1e-4f;
+		}
+	}
+	CHECK(onBelt);
+	CHECK(scaled);
+}
+
+static void TestTooFewBodies()
+{
+	// without room for the named bodies nothing is written
+	vector<float> worldMatrices(4 * 16, 7.0f);
+	AnimateBodies(1.0f, worldMatrices.data(), 4);
+
+	bool untouched = true;
+	for (float value : worldMatrices)
+		untouched &= value == 7.0f;
+	CHECK(untouched);
+}
+
+int main()
+{
+	RUN_TEST(TestStart);
+	RUN_TEST(TestRotations);
+	RUN_TEST(TestAsteroids);
+	RUN_TEST(TestTooFewBodies);
+	return TestResult();
+}
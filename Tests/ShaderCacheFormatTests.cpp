@@ -0,0 +1,294 @@
+#include "Test.h"
+#include "ShaderCacheFormat.h"
+
+#include <map>
+#include <string.h>
+
+static const char* SCENE_SOURCE = "Shaders/Scene.hlsl";
+
+static vector<ShaderDefine> SceneDefines()
+{
+	return { { "NORMAL_MAP", "1" }, { "SHADOWS", "" } };
+}
+
+static uint64_t SceneKey()
+{
+	return ComputeShaderCacheKey(SCENE_SOURCE, "PS", "ps_5_0", SceneDefines(), 0x800);
+}
+
+static uint64_t HashText(const char* text, uint64_t hash = FNV_OFFSET_BASIS)
+{
+	return HashBytes(text, strlen(text), hash);
+}
+
+static ShaderCacheEntry MakeEntry(const map<string, string>& files)
+{
+	ShaderCacheEntry entry;
+	entry.SourceFile = SCENE_SOURCE;
+	entry.EntryPoint = "PS";
+	entry.Target = "ps_5_0";
+	entry.Defines = SceneDefines();
+	entry.Flags = 0x800;
+	entry.Key = SceneKey();
+
+	// main source first, as ShaderCache records them
+	auto source = files.find(SCENE_SOURCE);
+	if (source != files.end())
+		entry.Dependencies.push_back({ source->first, HashText(source->second.c_str()) });
+	for (const auto& file : files)
+	{
+		if (file.first != SCENE_SOURCE)
+			entry.Dependencies.push_back({ file.first, HashText(file.second.c_str()) });
+	}
+
+	for (uint32_t i = 0; i < 300; ++i)
+		entry.Bytecode.push_back((uint8_t)(i * 7));
+
+	entry.Reflection.ConstantBuffers.push_back({ "ConstantBuffer", 256, 9 });
+	entry.Reflection.ConstantBuffers.push_back({ "MaterialBuffer", 32, 2 });
+	entry.Reflection.Resources.push_back({ "txDiffuse", 2, 0, 1 });
+	entry.Reflection.Resources.push_back({ "samLinear", 3, 0, 1 });
+	entry.Reflection.Inputs.push_back({ "POSITION", 0, 0, 0x7 });
+	entry.Reflection.Inputs.push_back({ "TEXCOORD", 1, 2, 0x3 });
+	return entry;
+}
+
+static bool SameEntry(const ShaderCacheEntry& a, const ShaderCacheEntry& b)
+{
+	if (a.Key != b.Key || a.SourceFile != b.SourceFile || a.EntryPoint != b.EntryPoint || a.Target != b.Target ||
+	    a.Flags != b.Flags || a.Bytecode != b.Bytecode || a.Defines.size() != b.Defines.size() ||
+	    a.Dependencies.size() != b.Dependencies.size())
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < a.Defines.size(); ++i)
+	{
+		if (a.Defines[i].Name != b.Defines[i].Name || a.Defines[i].Value != b.Defines[i].Value)
+			return false;
+	}
+	for (size_t i = 0; i < a.Dependencies.size(); ++i)
+	{
+		if (a.Dependencies[i].FileName != b.Dependencies[i].FileName || a.Dependencies[i].Hash != b.Dependencies[i].Hash)
+			return false;
+	}
+
+	const ShaderReflectionInfo& ra = a.Reflection;
+	const ShaderReflectionInfo& rb = b.Reflection;
+	if (ra.ConstantBuffers.size() != rb.ConstantBuffers.size() || ra.Resources.size() != rb.Resources.size() ||
+	    ra.Inputs.size() != rb.Inputs.size())
+	{
+		return false;
+	}
+	for (size_t i = 0; i < ra.ConstantBuffers.size(); ++i)
+	{
+		if (ra.ConstantBuffers[i].Name != rb.ConstantBuffers[i].Name || ra.ConstantBuffers[i].Size != rb.ConstantBuffers[i].Size ||
+		    ra.ConstantBuffers[i].Variables != rb.ConstantBuffers[i].Variables)
+			return false;
+	}
+	for (size_t i = 0; i < ra.Resources.size(); ++i)
+	{
+		if (ra.Resources[i].Name != rb.Resources[i].Name || ra.Resources[i].Type != rb.Resources[i].Type ||
+		    ra.Resources[i].BindPoint != rb.Resources[i].BindPoint || ra.Resources[i].BindCount != rb.Resources[i].BindCount)
+			return false;
+	}
+	for (size_t i = 0; i < ra.Inputs.size(); ++i)
+	{
+		if (ra.Inputs[i].SemanticName != rb.Inputs[i].SemanticName || ra.Inputs[i].SemanticIndex != rb.Inputs[i].SemanticIndex ||
+		    ra.Inputs[i].Register != rb.Inputs[i].Register || ra.Inputs[i].Mask != rb.Inputs[i].Mask)
+			return false;
+	}
+	return true;
+}
+
+static void TestHashBytes()
+{
+	// the published FNV-1a 64 test vectors
+	CHECK(HashText("") == 0xcbf29ce484222325ull);
+	CHECK(HashText("a") == 0xaf63dc4c8601ec8cull);
+	CHECK(HashText("foobar") == 0x85944171f73967e8ull);
+
+	// hashing in pieces is hashing the whole
+	CHECK(HashText("bar", HashText("foo")) == HashText("foobar"));
+}
+
+static void TestKeyStable()
+{
+	// the same on every run and every host, or a shipped cache is never hit. this is the
+	// key the cache has always given this compile
+	CHECK(SceneKey() == SceneKey());
+	CHECK(SceneKey() == 0x48f474e53cd6e444ull);
+	CHECK(ShaderCacheFileName(SceneKey()) == "48f474e53cd6e444.shc");
+	CHECK(ShaderCacheFileName(0x1f) == "000000000000001f.shc");
+}
+
+static void TestKeyChanges()
+{
+	uint64_t key = SceneKey();
+	vector<ShaderDefine> defines = SceneDefines();
+
+	// every part of the compile is in the key
+	CHECK(ComputeShaderCacheKey("Shaders/Other.hlsl", "PS", "ps_5_0", defines, 0x800) != key);
+	CHECK(ComputeShaderCacheKey(SCENE_SOURCE, "VS", "ps_5_0", defines, 0x800) != key);
+	CHECK(ComputeShaderCacheKey(SCENE_SOURCE, "PS", "ps_4_0", defines, 0x800) != key);
+	CHECK(ComputeShaderCacheKey(SCENE_SOURCE, "PS", "ps_5_0", defines, 0x801) != key);
+	CHECK(ComputeShaderCacheKey(SCENE_SOURCE, "PS", "ps_5_0", defines, 0) != key);
+
+	// a define's value, name, presence or order
+	vector<ShaderDefine> changed = defines;
+	changed[0].Value = "0";
+	CHECK(ComputeShaderCacheKey(SCENE_SOURCE, "PS", "ps_5_0", changed, 0x800) != key);
+	changed = defines;
+	changed[1].Name = "SHADOW";
+	CHECK(ComputeShaderCacheKey(SCENE_SOURCE, "PS", "ps_5_0", changed, 0x800) != key);
+	changed = defines;
+	changed.push_back({ "POINT_LIGHTS", "4" });
+	CHECK(ComputeShaderCacheKey(SCENE_SOURCE, "PS", "ps_5_0", changed, 0x800) != key);
+	changed = defines;
+	changed.pop_back();
+	CHECK(ComputeShaderCacheKey(SCENE_SOURCE, "PS", "ps_5_0", changed, 0x800) != key);
+	changed = { defines[1], defines[0] };
+	CHECK(ComputeShaderCacheKey(SCENE_SOURCE, "PS", "ps_5_0", changed, 0x800) != key);
+
+	// text moved between neighbouring strings
+	CHECK(ComputeShaderCacheKey("ab", "c", "ps_5_0", {}, 0) != ComputeShaderCacheKey("a", "bc", "ps_5_0", {}, 0));
+	CHECK(ComputeShaderCacheKey(SCENE_SOURCE, "PS", "ps_5_0", { { "AB", "" } }, 0) !=
+	      ComputeShaderCacheKey(SCENE_SOURCE, "PS", "ps_5_0", { { "A", "B" } }, 0));
+}
+
+// include edits don't change the key, the entry's dependency hashes catch them instead
+static void TestIncludeChanges()
+{
+	map<string, string> files =
+	{
+		{ SCENE_SOURCE, "#include \"Lighting.hlsli\"\nfloat4 PS() : SV_Target { return Light(); }" },
+		{ "Shaders/Lighting.hlsli", "float4 Light() { return 1; }" },
+	};
+	ShaderCacheEntry entry = MakeEntry(files);
+
+	auto readFile = [&files](const string& fileName, vector<uint8_t>& contents)
+	{
+		auto file = files.find(fileName);
+		if (file == files.end())
+			return false;
+		contents.assign(file->second.begin(), file->second.end());
+		return true;
+	};
+
+	CHECK(IsShaderCacheEntryCurrent(entry, readFile));
+
+	files["Shaders/Lighting.hlsli"] = "float4 Light() { return 0.5; }";
+	CHECK(!IsShaderCacheEntryCurrent(entry, readFile));
+
+	files.erase("Shaders/Lighting.hlsli");
+	CHECK(!IsShaderCacheEntryCurrent(entry, readFile));
+
+	// the main source edited
+	files = { { SCENE_SOURCE, "float4 PS() : SV_Target { return 0; }" } };
+	entry = MakeEntry(files);
+	CHECK(IsShaderCacheEntryCurrent(entry, readFile));
+	files[SCENE_SOURCE] += " ";
+	CHECK(!IsShaderCacheEntryCurrent(entry, readFile));
+
+	// shipped with only the cache, trusted as it is
+	files.clear();
+	CHECK(IsShaderCacheEntryCurrent(entry, readFile));
+
+	// nothing recorded to check against
+	entry.Dependencies.clear();
+	CHECK(!IsShaderCacheEntryCurrent(entry, readFile));
+}
+
+static void TestRoundTrip()
+{
+	ShaderCacheEntry entry = MakeEntry({ { SCENE_SOURCE, "a" }, { "Shaders/Lighting.hlsli", "b" } });
+
+	vector<uint8_t> data;
+	SerializeShaderCacheEntry(entry, data);
+
+	ShaderCacheEntry read;
+	CHECK(DeserializeShaderCacheEntry(data.data(), data.size(), read));
+	CHECK(SameEntry(entry, read));
+
+	// and writing what was read gives the same bytes
+	vector<uint8_t> again;
+	SerializeShaderCacheEntry(read, again);
+	CHECK(again == data);
+
+	// empty lists and strings
+	ShaderCacheEntry empty = {};
+	SerializeShaderCacheEntry(empty, data);
+	CHECK(DeserializeShaderCacheEntry(data.data(), data.size(), read));
+	CHECK(SameEntry(empty, read));
+}
+
+static void TestRejectsDamage()
+{
+	ShaderCacheEntry entry = MakeEntry({ { SCENE_SOURCE, "a" } });
+	vector<uint8_t> data;
+	SerializeShaderCacheEntry(entry, data);
+
+	ShaderCacheEntry read;
+	CHECK(!DeserializeShaderCacheEntry(nullptr, 0, read));
+	CHECK(!DeserializeShaderCacheEntry(data.data(), 0, read));
+
+	// cut short anywhere
+	bool anyTruncatedAccepted = false;
+	for (size_t size = 0; size < data.size(); ++size)
+		anyTruncatedAccepted |= DeserializeShaderCacheEntry(data.data(), size, read);
+	CHECK(!anyTruncatedAccepted);
+
+	// any one bit flipped
+	bool anyCorruptAccepted = false;
+	for (size_t i = 0; i < data.size(); ++i)
+	{
+		for (int bit = 0; bit < 8; ++bit)
+		{
+			vector<uint8_t> corrupt = data;
+			corrupt[i] ^= (uint8_t)(1 << bit);
+			anyCorruptAccepted |= DeserializeShaderCacheEntry(corrupt.data(), corrupt.size(), read);
+		}
+	}
+	CHECK(!anyCorruptAccepted);
+
+	// trailing bytes
+	vector<uint8_t> longer = data;
+	longer.push_back(0);
+	CHECK(!DeserializeShaderCacheEntry(longer.data(), longer.size(), read));
+}
+
+// a blob with a valid checksum but a count far past the data must fail without trying
+// to allocate what it asks for
+static void TestRejectsHugeCounts()
+{
+	ShaderCacheEntry entry = {};
+	vector<uint8_t> data;
+	SerializeShaderCacheEntry(entry, data);
+
+	// magic, version, key, three empty strings and the flags come before the define count
+	size_t defineCount = 4 + 4 + 8 + 4 * 3 + 4;
+	data[defineCount] = 0xFF;
+	data[defineCount + 1] = 0xFF;
+	data[defineCount + 2] = 0xFF;
+	data[defineCount + 3] = 0x7F;
+
+	size_t body = data.size() - sizeof(uint64_t);
+	uint64_t checksum = HashBytes(data.data(), body);
+	for (int i = 0; i < 8; ++i)
+		data[body + i] = (uint8_t)(checksum >> (i * 8));
+
+	ShaderCacheEntry read;
+	CHECK(!DeserializeShaderCacheEntry(data.data(), data.size(), read));
+}
+
+int main()
+{
+	RUN_TEST(TestHashBytes);
+	RUN_TEST(TestKeyStable);
+	RUN_TEST(TestKeyChanges);
+	RUN_TEST(TestIncludeChanges);
+	RUN_TEST(TestRoundTrip);
+	RUN_TEST(TestRejectsDamage);
+	RUN_TEST(TestRejectsHugeCounts);
+	return TestResult();
+}
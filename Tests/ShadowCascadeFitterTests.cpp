@@ -0,0 +1,268 @@
+#include "Test.h"
+#include "ShadowCascadeFitter.h"
+
+#include <math.h>
+#include <string.h>
+
+static const uint32_t RESOLUTION = 2048;
+static const uint32_t CASCADES = 4;
+static const float NEAR_Z = 0.01f;
+static const float SHADOW_DISTANCE = 60.0f;
+
+// towards the light, not normalised to check that it doesn't have to be
+static const float SUN_DIRECTION[3] = { 0.4f, 1.0f, -0.3f };
+
+// a left handed camera at eye turned yaw radians about y, with a 90 degree vertical
+// fov at 16:9
+struct TestCamera
+{
+	float view[16];
+	float projection[16];
+
+	TestCamera(float x, float y, float z, float yaw = 0.0f)
+	{
+		float c = cosf(yaw);
+		float s = sinf(yaw);
+
+		// the inverse of the camera's rotation, then its position taken off
+		const float rows[16] =
+		{
+			c, 0, s, 0,
+			0, 1, 0, 0,
+			-s, 0, c, 0,
+			-(x * c - z * s), -y, -(x * s + z * c), 1,
+		};
+		memcpy(view, rows, sizeof(view));
+
+		memset(projection, 0, sizeof(projection));
+		projection[0] = 9.0f / 16.0f;
+		projection[5] = 1.0f;
+		projection[10] = 100.0f / (100.0f - NEAR_Z);
+		projection[11] = 1.0f;
+		projection[14] = -NEAR_Z * 100.0f / (100.0f - NEAR_Z);
+	}
+
+	// a view space point back in the world
+	void ToWorld(float vx, float vy, float vz, float* world) const
+	{
+		for (int k = 0; k < 3; ++k)
+			world[k] = (vx - view[12]) * view[k * 4] + (vy - view[13]) * view[k * 4 + 1] + (vz - view[14]) * view[k * 4 + 2];
+	}
+};
+
+static void Fit(ShadowCascadeFitter& fitter, const TestCamera& camera)
+{
+	CHECK(fitter.Init(RESOLUTION, CASCADES, NEAR_Z, SHADOW_DISTANCE, 0.75f));
+	fitter.Update(camera.view, camera.projection, SUN_DIRECTION);
+}
+
+// a world point in the cascade's shadow map, in texels from its centre
+static void ToTexels(const ShadowCascade& cascade, const float* world, float& x, float& y)
+{
+	float light[2];
+	for (int k = 0; k < 2; ++k)
+		light[k] = world[0] * cascade.View[k] + world[1] * cascade.View[4 + k] + world[2] * cascade.View[8 + k] + cascade.View[12 + k];
+
+	x = (light[0] * cascade.Projection[0] + cascade.Projection[12]) * RESOLUTION * 0.5f;
+	y = (light[1] * cascade.Projection[5] + cascade.Projection[13]) * RESOLUTION * 0.5f;
+}
+
+static bool Whole(float value)
+{
+	return fabsf(value - roundf(value)) < 0.01f;
+}
+
+static void TestSplits()
+{
+	// every blend, every count: rising from past the near plane to the shadow distance
+	const float blends[] = { 0.0f, 0.5f, 0.75f, 1.0f };
+	bool rising = true;
+	bool reaches = true;
+	for (float blend : blends)
+	{
+		for (uint32_t count = 1; count <= MAX_SHADOW_CASCADES; ++count)
+		{
+			float splits[MAX_SHADOW_CASCADES];
+			ComputeCascadeSplits(NEAR_Z, SHADOW_DISTANCE, blend, count, splits);
+
+			float previous = NEAR_Z;
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				rising &= splits[i] > previous;
+				previous = splits[i];
+			}
+			reaches &= splits[count - 1] == SHADOW_DISTANCE;
+		}
+	}
+	CHECK(rising);
+	CHECK(reaches);
+
+	// even splits, and logarithmic ones that give the near cascades far less
+	float splits[MAX_SHADOW_CASCADES];
+	ComputeCascadeSplits(NEAR_Z, SHADOW_DISTANCE, 0.0f, 4, splits);
+	CHECK_NEAR(splits[0], NEAR_Z + (SHADOW_DISTANCE - NEAR_Z) / 4, 1e-4f);
+	CHECK_NEAR(splits[1], NEAR_Z + (SHADOW_DISTANCE - NEAR_Z) / 2, 1e-4f);
+	ComputeCascadeSplits(NEAR_Z, SHADOW_DISTANCE, 1.0f, 4, splits);
+	CHECK_NEAR(splits[1], sqrtf(NEAR_Z * SHADOW_DISTANCE), 1e-4f);
+
+	// and the fitter ends its cascades on them
+	ShadowCascadeFitter fitter;
+	Fit(fitter, TestCamera(0, 5, -20));
+	ComputeCascadeSplits(NEAR_Z, SHADOW_DISTANCE, 0.75f, CASCADES, splits);
+	for (uint32_t i = 0; i < CASCADES; ++i)
+		CHECK(fitter.GetCascade(i).SplitFar == splits[i]);
+
+	CHECK(!fitter.Init(RESOLUTION, 0, NEAR_Z, SHADOW_DISTANCE, 0.75f));
+	CHECK(!fitter.Init(RESOLUTION, MAX_SHADOW_CASCADES + 1, NEAR_Z, SHADOW_DISTANCE, 0.75f));
+}
+
+static void TestSpheres()
+{
+	// every corner of a cascade's slice of the view frustum is inside the circle its
+	// sphere covers on the shadow map
+	TestCamera camera(0, 5, -20);
+	ShadowCascadeFitter fitter;
+	Fit(fitter, camera);
+
+	float tanX = 1.0f / camera.projection[0];
+	float tanY = 1.0f / camera.projection[5];
+	float splitNear = NEAR_Z;
+	bool inside = true;
+	for (uint32_t i = 0; i < CASCADES; ++i)
+	{
+		const ShadowCascade& cascade = fitter.GetCascade(i);
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			float z = corner & 4 ? cascade.SplitFar : splitNear;
+			float world[3];
+			camera.ToWorld(corner & 1 ? z * tanX : -z * tanX, corner & 2 ? z * tanY : -z * tanY, z, world);
+
+			float x, y;
+			ToTexels(cascade, world, x, y);
+			inside &= sqrtf(x * x + y * y) <= RESOLUTION * 0.5f + 1.0f;
+		}
+		splitNear = cascade.SplitFar;
+	}
+	CHECK(inside);
+
+	// turning the camera doesn't change their size, so neither does a texel's
+	ShadowCascadeFitter turned;
+	Fit(turned, TestCamera(0, 5, -20, 0.7f));
+	for (uint32_t i = 0; i < CASCADES; ++i)
+		CHECK(turned.GetCascade(i).Radius == fitter.GetCascade(i).Radius);
+}
+
+static void TestTexelSnapping()
+{
+	ShadowCascadeFitter fitter;
+	Fit(fitter, TestCamera(0, 5, -20));
+	ShadowCascadeFitter moved;
+	Fit(moved, TestCamera(0.37f, 5.05f, -19.89f));
+
+	// the world origin is on a texel corner, so anything static moves in whole texels
+	// between the two frames, and in the near cascade it does move
+	const float origin[3] = { 0, 0, 0 };
+	const float point[3] = { 3.3f, 0.7f, -2.1f };
+	bool onCorner = true;
+	bool wholeTexels = true;
+	for (uint32_t i = 0; i < CASCADES; ++i)
+	{
+		float x, y, movedX, movedY;
+		ToTexels(moved.GetCascade(i), origin, x, y);
+		onCorner &= Whole(x) && Whole(y);
+
+		ToTexels(fitter.GetCascade(i), point, x, y);
+		ToTexels(moved.GetCascade(i), point, movedX, movedY);
+		wholeTexels &= Whole(movedX - x) && Whole(movedY - y);
+
+		if (i == 0)
+			CHECK(fabsf(movedX - x) >= 1.0f || fabsf(movedY - y) >= 1.0f);
+	}
+	CHECK(onCorner);
+	CHECK(wholeTexels);
+}
+
+static void TestCache()
+{
+	TestCamera camera(0, 5, -20);
+	ShadowCascadeFitter fitter;
+	Fit(fitter, camera);
+
+	// nothing is kept before it is drawn
+	for (uint32_t i = 0; i < CASCADES; ++i)
+		CHECK(fitter.NeedsRender(i, false));
+
+	// drawn with static casters only, it is kept while the fit stays put, but not for
+	// dynamic casters
+	fitter.MarkRendered(0, false);
+	CHECK(!fitter.NeedsRender(0, false));
+	CHECK(fitter.NeedsRender(0, true));
+	CHECK(fitter.NeedsRender(1, false));
+
+	fitter.Update(camera.view, camera.projection, SUN_DIRECTION);
+	CHECK(!fitter.NeedsRender(0, false));
+
+	// Invalidate throws it away
+	fitter.Invalidate();
+	CHECK(fitter.NeedsRender(0, false));
+
+	// drawn with dynamic casters in it, it is drawn again next time whatever is there
+	fitter.MarkRendered(0, true);
+	CHECK(fitter.NeedsRender(0, false));
+
+	// and a fit that moves needs the slice drawn again
+	fitter.MarkRendered(0, false);
+	TestCamera moved(2, 5, -20);
+	fitter.Update(moved.view, moved.projection, SUN_DIRECTION);
+	CHECK(fitter.NeedsRender(0, false));
+}
+
+static void TestCasters()
+{
+	TestCamera camera(0, 5, -20);
+	ShadowCascadeFitter fitter;
+	Fit(fitter, camera);
+
+	float length = sqrtf(SUN_DIRECTION[0] * SUN_DIRECTION[0] + SUN_DIRECTION[1] * SUN_DIRECTION[1] +
+	                     SUN_DIRECTION[2] * SUN_DIRECTION[2]);
+	float splitNear = NEAR_Z;
+	for (uint32_t i = 0; i < CASCADES; ++i)
+	{
+		const ShadowCascade& cascade = fitter.GetCascade(i);
+		float r = cascade.Radius;
+
+		// a point inside the slice, on the view axis
+		float centre[3];
+		camera.ToWorld(0, 0, (splitNear + cascade.SplitFar) * 0.5f, centre);
+		CHECK(fitter.IsCasterInCascade(i, centre, 0.5f));
+
+		// well off to the side of the light's view is out
+		float side[3] = { centre[0], centre[1], centre[2] };
+		side[0] += 3.0f * r * SUN_DIRECTION[1] / length;
+		side[1] -= 3.0f * r * SUN_DIRECTION[0] / length;
+		CHECK(!fitter.IsCasterInCascade(i, side, 0.5f));
+
+		// most of the caster extent towards the light still shadows it, past the far side
+		// of the sphere doesn't
+		float above[3], below[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			above[k] = centre[k] + SUN_DIRECTION[k] / length * 45.0f;
+			below[k] = centre[k] - SUN_DIRECTION[k] / length * (3.0f * r);
+		}
+		CHECK(fitter.IsCasterInCascade(i, above, 0.5f));
+		CHECK(!fitter.IsCasterInCascade(i, below, 0.5f));
+
+		splitNear = cascade.SplitFar;
+	}
+}
+
+int main()
+{
+	RUN_TEST(TestSplits);
+	RUN_TEST(TestSpheres);
+	RUN_TEST(TestTexelSnapping);
+	RUN_TEST(TestCache);
+	RUN_TEST(TestCasters);
+	return TestResult();
+}
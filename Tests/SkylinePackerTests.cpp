@@ -0,0 +1,140 @@
+#include "Test.h"
+#include "SkylinePacker.h"
+
+#include <algorithm>
+
+struct Size
+{
+	uint32_t width;
+	uint32_t height;
+};
+
+// the same sizes every run, 8 to 128 texels a side
+static vector<Size> MixedSizes(uint32_t count)
+{
+	vector<Size> sizes;
+	uint32_t seed = 12345;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		uint32_t width = 8 + (seed >> 8) % 121;
+		seed = seed * 1664525u + 1013904223u;
+		uint32_t height = 8 + (seed >> 8) % 121;
+		sizes.push_back({ width, height });
+	}
+
+	// tallest first as TexturePacker::PackAtlas orders them
+	sort(sizes.begin(), sizes.end(), [](const Size& a, const Size& b)
+	{
+		return a.height != b.height ? a.height > b.height : a.width > b.width;
+	});
+	return sizes;
+}
+
+// the padded rectangles stay on the page and none of them overlap
+static void CheckLayout(const SkylinePacker& packer, const vector<AtlasRect>& rects, uint32_t padding)
+{
+	for (size_t i = 0; i < rects.size(); ++i)
+	{
+		const AtlasRect& a = rects[i];
+		CHECK(a.x >= padding && a.y >= padding);
+		CHECK(a.x + a.width + padding <= packer.GetWidth());
+		CHECK(a.y + a.height + padding <= packer.GetHeight());
+
+		for (size_t j = i + 1; j < rects.size(); ++j)
+		{
+			const AtlasRect& b = rects[j];
+			bool apart = a.x + a.width + padding <= b.x - padding || b.x + b.width + padding <= a.x - padding ||
+			             a.y + a.height + padding <= b.y - padding || b.y + b.height + padding <= a.y - padding;
+			CHECK(apart);
+		}
+	}
+}
+
+static void TestExactFit()
+{
+	SkylinePacker packer;
+	packer.Init(256, 256);
+
+	vector<AtlasRect> rects(16);
+	for (AtlasRect& rect : rects)
+		CHECK(packer.Insert(64, 64, &rect));
+
+	CheckLayout(packer, rects, 0);
+	CHECK_NEAR(packer.Occupancy(), 1.0, 1e-6);
+
+	AtlasRect extra;
+	CHECK(!packer.Insert(1, 1, &extra));
+}
+
+static void TestMixedOccupancy()
+{
+	SkylinePacker packer;
+	packer.Init(1024, 1024);
+
+	vector<AtlasRect> rects;
+	for (const Size& size : MixedSizes(400))
+	{
+		AtlasRect rect;
+		if (!packer.Insert(size.width, size.height, &rect))
+			break;
+		rects.push_back(rect);
+	}
+
+	CheckLayout(packer, rects, 0);
+	// the page fills up before the sizes run out, and little of it is wasted
+	CHECK(rects.size() < 400);
+	CHECK(packer.Occupancy() > 0.85f);
+}
+
+static void TestPaddingAndAlignment()
+{
+	const uint32_t padding = 4;
+	const uint32_t alignment = 4;
+
+	SkylinePacker packer;
+	packer.Init(1024, 1024, alignment, padding);
+
+	vector<AtlasRect> rects;
+	for (const Size& size : MixedSizes(120))
+	{
+		AtlasRect rect;
+		CHECK(packer.Insert(size.width, size.height, &rect));
+		CHECK(rect.width == size.width && rect.height == size.height);
+		// the padded area starts on a block boundary
+		CHECK((rect.x - padding) % alignment == 0 && (rect.y - padding) % alignment == 0);
+		rects.push_back(rect);
+	}
+
+	CheckLayout(packer, rects, padding);
+	// padding isn't counted as used
+	uint64_t area = 0;
+	for (const AtlasRect& rect : rects)
+		area += (uint64_t)rect.width * rect.height;
+	CHECK_NEAR(packer.Occupancy(), (double)area / (1024.0 * 1024.0), 1e-6);
+}
+
+static void TestRejects()
+{
+	SkylinePacker packer;
+	packer.Init(128, 128, 1, 2);
+
+	AtlasRect rect;
+	CHECK(!packer.Insert(0, 16, &rect));
+	CHECK(!packer.Insert(16, 0, &rect));
+	CHECK(!packer.Insert(16, 16, nullptr));
+	// fits the page but not with padding either side
+	CHECK(!packer.Insert(128, 16, &rect));
+	CHECK(!packer.Insert(125, 16, &rect));
+	CHECK(packer.Insert(124, 16, &rect));
+	CHECK(rect.x == 2 && rect.y == 2);
+}
+
+int main()
+{
+	RUN_TEST(TestExactFit);
+	RUN_TEST(TestMixedOccupancy);
+	RUN_TEST(TestPaddingAndAlignment);
+	RUN_TEST(TestRejects);
+	return TestResult();
+}
@@ -0,0 +1,440 @@
+#include "Test.h"
+#include "RhiSoftware.h"
+#include "FrameImage.h"
+
+#include <string.h>
+#include <vector>
+
+using namespace std;
+
+// not a whole number of tiles either way, so the padding is drawn past and never shown
+static const uint32_t TARGET_WIDTH = 160;
+static const uint32_t TARGET_HEIGHT = 96;
+
+// B8G8R8A8 as the target stores it
+static const uint32_t BLACK = 0x00000000;
+static const uint32_t RED = 0xffff0000;
+static const uint32_t GREEN = 0xff00ff00;
+static const uint32_t BLUE = 0xff0000ff;
+static const uint32_t WHITE = 0xffffffff;
+
+struct TestVertex
+{
+	float Position[3];
+	float Colour[4];
+};
+
+static void ColourVertexShader(const uint8_t* vertex, const uint32_t* elementOffsets,
+                               const SoftwareShaderResources& resources, SoftwareVertex& output)
+{
+	memcpy(output.Position, vertex + elementOffsets[0], 3 * sizeof(float));
+	output.Position[3] = 1.0f;
+	memcpy(output.Varyings, vertex + elementOffsets[1], 4 * sizeof(float));
+}
+
+static void ColourPixelShader(const SoftwarePixelInput& input, const SoftwareShaderResources& resources, float colour[4])
+{
+	memcpy(colour, input.Varyings, 4 * sizeof(float));
+}
+
+// the colour is the pixel shader's first constant buffer
+static void ConstantPixelShader(const SoftwarePixelInput& input, const SoftwareShaderResources& resources, float colour[4])
+{
+	memcpy(colour, resources.ConstantBuffers[0], 4 * sizeof(float));
+}
+
+// the first texture at the uv in the first two varyings
+static void TexturePixelShader(const SoftwarePixelInput& input, const SoftwareShaderResources& resources, float colour[4])
+{
+	SampleSoftwareTexture(*resources.Textures[0], input.Varyings[0], input.Varyings[1], 0, input.TexCoordArea, colour);
+}
+
+struct TestTarget
+{
+	SoftwareRhiDevice device;
+	RhiShader* vertexShader;
+	RhiShader* pixelShader;
+
+	TestTarget(JobSystem* jobs = nullptr, SoftwarePixelShader shader = ColourPixelShader)
+	{
+		CHECK(device.Init(TARGET_WIDTH, TARGET_HEIGHT, jobs));
+		vertexShader = device.CreateVertexShader(ColourVertexShader, 4, -1);
+		pixelShader = device.CreatePixelShader(shader);
+		CHECK(vertexShader && pixelShader);
+	}
+
+	~TestTarget()
+	{
+		delete vertexShader;
+		delete pixelShader;
+	}
+
+	RhiPipelineState* CreatePipeline(RhiCullMode cull, bool depthTest, bool depthWrite)
+	{
+		RhiPipelineStateDesc desc = {};
+		desc.VertexShader = vertexShader;
+		desc.PixelShader = pixelShader;
+		desc.Elements[0] = { "POSITION", 0, RHI_FORMAT_R32G32B32_FLOAT, 0 };
+		desc.Elements[1] = { "COLOR", 0, RHI_FORMAT_R32G32B32A32_FLOAT, RHI_APPEND_ALIGNED };
+		desc.ElementCount = 2;
+		desc.Cull = cull;
+		desc.DepthClip = true;
+		desc.DepthTest = depthTest;
+		desc.DepthWrite = depthWrite;
+		return device.CreatePipelineState(desc);
+	}
+
+	// corners in pixels, y down
+	static TestVertex Vertex(float x, float y, float z, const float colour[4])
+	{
+		TestVertex vertex = { { x * 2.0f / TARGET_WIDTH - 1.0f, 1.0f - y * 2.0f / TARGET_HEIGHT, z }, {} };
+		memcpy(vertex.Colour, colour, sizeof(vertex.Colour));
+		return vertex;
+	}
+
+	void DrawTriangles(RhiPipelineState* pipeline, const vector<TestVertex>& vertices)
+	{
+		RhiBuffer* buffer = device.CreateBuffer({ RHI_BUFFER_VERTEX, (uint32_t)(vertices.size() * sizeof(TestVertex)), sizeof(TestVertex) },
+		                                        vertices.data());
+		RhiCommandList* commands = device.GetImmediateCommandList();
+		commands->SetPipelineState(pipeline);
+		commands->SetVertexBuffer(0, buffer, 0);
+		commands->Draw((uint32_t)vertices.size(), 0);
+		delete buffer;
+	}
+
+	// two triangles sharing the diagonal from the top left corner to the bottom right
+	void DrawRect(RhiPipelineState* pipeline, float left, float top, float right, float bottom, float z, const float colour[4])
+	{
+		DrawTriangles(pipeline, { Vertex(left, top, z, colour), Vertex(right, top, z, colour), Vertex(right, bottom, z, colour),
+		                          Vertex(left, top, z, colour), Vertex(right, bottom, z, colour), Vertex(left, bottom, z, colour) });
+	}
+
+	uint32_t Pixel(uint32_t x, uint32_t y) const
+	{
+		const SoftwareRasterizer& rasterizer = device.GetRasterizer();
+		return rasterizer.GetPixels()[y * rasterizer.GetPitch() + x];
+	}
+
+	// pixels not matching expected(x, y)
+	template <typename Expected>
+	uint32_t CountWrong(Expected expected) const
+	{
+		uint32_t wrong = 0;
+		for (uint32_t y = 0; y < TARGET_HEIGHT; ++y)
+		{
+			for (uint32_t x = 0; x < TARGET_WIDTH; ++x)
+				wrong += Pixel(x, y) != expected(x, y);
+		}
+		return wrong;
+	}
+
+	uint64_t Checksum() const
+	{
+		const SoftwareRasterizer& rasterizer = device.GetRasterizer();
+		return ChecksumFrame((const uint8_t*)rasterizer.GetPixels(), TARGET_WIDTH, TARGET_HEIGHT, rasterizer.GetPitch() * 4);
+	}
+};
+
+static const float CLEAR_COLOUR[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+static const float RED_COLOUR[4] = { 1.0f, 0.0f, 0.0f, 1.0f };
+static const float GREEN_COLOUR[4] = { 0.0f, 1.0f, 0.0f, 1.0f };
+static const float BLUE_COLOUR[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+static const float WHITE_COLOUR[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+static void TestClear()
+{
+	TestTarget target;
+	target.device.Clear(BLUE_COLOUR, 1.0f);
+	target.device.Flush();
+	CHECK(target.CountWrong([](uint32_t, uint32_t) { return BLUE; }) == 0);
+
+	// a clear waits for the next flush, where the last one given wins
+	target.device.Clear(RED_COLOUR, 1.0f);
+	CHECK(target.Pixel(0, 0) == BLUE);
+	target.device.Clear(GREEN_COLOUR, 1.0f);
+	target.device.Flush();
+	CHECK(target.CountWrong([](uint32_t, uint32_t) { return GREEN; }) == 0);
+}
+
+static void TestFillRule()
+{
+	TestTarget target;
+	RhiPipelineState* pipeline = target.CreatePipeline(RHI_CULL_NONE, false, false);
+
+	// four rects meeting on pixel centres, each overdrawing the ones before wherever it
+	// draws a pixel it shouldn't. the top-left rule gives the shared column and row to the
+	// rects right of and below them, and every pixel to exactly one of the diagonal's triangles
+	target.device.Clear(CLEAR_COLOUR, 1.0f);
+	target.DrawRect(pipeline, 80.5f, 48.5f, 160.0f, 96.0f, 0.5f, WHITE_COLOUR);
+	target.DrawRect(pipeline, 0.0f, 48.5f, 80.5f, 96.0f, 0.5f, BLUE_COLOUR);
+	target.DrawRect(pipeline, 80.5f, 0.0f, 160.0f, 48.5f, 0.5f, GREEN_COLOUR);
+	target.DrawRect(pipeline, 0.0f, 0.0f, 80.5f, 48.5f, 0.5f, RED_COLOUR);
+	CHECK(target.device.GetRasterizer().GetTriangleCount() == 8);
+	target.device.Flush();
+	CHECK(target.device.GetRasterizer().GetTriangleCount() == 0);
+
+	CHECK(target.CountWrong([](uint32_t x, uint32_t y) { return y < 48 ? (x < 80 ? RED : GREEN) : (x < 80 ? BLUE : WHITE); }) == 0);
+	CHECK(target.Pixel(79, 47) == RED && target.Pixel(80, 47) == GREEN);
+	CHECK(target.Pixel(79, 48) == BLUE && target.Pixel(80, 48) == WHITE);
+
+	// a triangle whose edge misses every pixel centre covers the centres inside it
+	target.device.Clear(CLEAR_COLOUR, 1.0f);
+	float colour[4] = { 1.0f, 0.0f, 0.0f, 1.0f };
+	target.DrawTriangles(pipeline, { TestTarget::Vertex(0.0f, 0.0f, 0.5f, colour), TestTarget::Vertex(160.0f, 96.0f, 0.5f, colour),
+	                                 TestTarget::Vertex(0.0f, 96.0f, 0.5f, colour) });
+	target.device.Flush();
+	CHECK(target.CountWrong([](uint32_t x, uint32_t y) { return (y + 0.5f) * 160.0f > (x + 0.5f) * 96.0f ? RED : BLACK; }) == 0);
+
+	delete pipeline;
+}
+
+static void TestDepth()
+{
+	TestTarget target;
+	RhiPipelineState* depth = target.CreatePipeline(RHI_CULL_NONE, true, true);
+	RhiPipelineState* noWrite = target.CreatePipeline(RHI_CULL_NONE, true, false);
+	RhiPipelineState* noTest = target.CreatePipeline(RHI_CULL_NONE, false, false);
+
+	// the nearer rect wins whichever is drawn first, and equal depth fails LESS
+	target.device.Clear(CLEAR_COLOUR, 1.0f);
+	target.DrawRect(depth, 40.0f, 24.0f, 120.0f, 72.0f, 0.25f, GREEN_COLOUR);
+	target.DrawRect(depth, 0.0f, 0.0f, 160.0f, 96.0f, 0.75f, RED_COLOUR);
+	target.DrawRect(depth, 0.0f, 0.0f, 160.0f, 96.0f, 0.75f, BLUE_COLOUR);
+	target.device.Flush();
+	auto inner = [](uint32_t x, uint32_t y) { return x >= 40 && x < 120 && y >= 24 && y < 72; };
+	CHECK(target.CountWrong([&](uint32_t x, uint32_t y) { return inner(x, y) ? GREEN : RED; }) == 0);
+
+	// without depth writes the nearest draw doesn't hide what follows it
+	target.device.Clear(CLEAR_COLOUR, 1.0f);
+	target.DrawRect(noWrite, 0.0f, 0.0f, 160.0f, 96.0f, 0.1f, RED_COLOUR);
+	target.DrawRect(depth, 0.0f, 0.0f, 160.0f, 96.0f, 0.5f, GREEN_COLOUR);
+	// and nothing past the clear depth draws
+	target.DrawRect(depth, 0.0f, 0.0f, 160.0f, 96.0f, 1.0f, WHITE_COLOUR);
+	target.device.Flush();
+	CHECK(target.CountWrong([](uint32_t, uint32_t) { return GREEN; }) == 0);
+
+	// without the test everything draws in order, the depth buffer is kept between frames
+	target.DrawRect(noTest, 40.0f, 24.0f, 120.0f, 72.0f, 0.9f, BLUE_COLOUR);
+	target.DrawRect(depth, 0.0f, 0.0f, 160.0f, 96.0f, 0.6f, RED_COLOUR);
+	target.device.Flush();
+	CHECK(target.CountWrong([&](uint32_t x, uint32_t y) { return inner(x, y) ? BLUE : GREEN; }) == 0);
+
+	delete depth;
+	delete noWrite;
+	delete noTest;
+}
+
+static void TestCulling()
+{
+	TestTarget target;
+	RhiPipelineState* back = target.CreatePipeline(RHI_CULL_BACK, false, false);
+	RhiPipelineState* front = target.CreatePipeline(RHI_CULL_FRONT, false, false);
+
+	// top left, top right, bottom left runs clockwise on screen and faces the front
+	vector<TestVertex> clockwise = { TestTarget::Vertex(0.0f, 0.0f, 0.5f, RED_COLOUR), TestTarget::Vertex(160.0f, 0.0f, 0.5f, RED_COLOUR),
+	                                 TestTarget::Vertex(0.0f, 96.0f, 0.5f, RED_COLOUR) };
+	vector<TestVertex> anticlockwise = { TestTarget::Vertex(160.0f, 0.0f, 0.5f, GREEN_COLOUR), TestTarget::Vertex(0.0f, 96.0f, 0.5f, GREEN_COLOUR),
+	                                     TestTarget::Vertex(160.0f, 96.0f, 0.5f, GREEN_COLOUR) };
+
+	target.device.Clear(CLEAR_COLOUR, 1.0f);
+	target.DrawTriangles(back, clockwise);
+	target.DrawTriangles(back, anticlockwise);
+	CHECK(target.device.GetRasterizer().GetTriangleCount() == 1);
+	target.device.Flush();
+	CHECK(target.Pixel(0, 0) == RED && target.Pixel(159, 95) == BLACK);
+
+	target.device.Clear(CLEAR_COLOUR, 1.0f);
+	target.DrawTriangles(front, clockwise);
+	target.DrawTriangles(front, anticlockwise);
+	CHECK(target.device.GetRasterizer().GetTriangleCount() == 1);
+	target.device.Flush();
+	CHECK(target.Pixel(0, 0) == BLACK && target.Pixel(159, 95) == GREEN);
+
+	delete back;
+	delete front;
+}
+
+static void TestClipping()
+{
+	TestTarget target;
+	RhiPipelineState* pipeline = target.CreatePipeline(RHI_CULL_NONE, true, true);
+
+	// one triangle well past every edge fills the target
+	target.device.Clear(CLEAR_COLOUR, 1.0f);
+	target.DrawTriangles(pipeline, { TestTarget::Vertex(-1000.0f, -1000.0f, 0.5f, RED_COLOUR), TestTarget::Vertex(5000.0f, -1000.0f, 0.5f, RED_COLOUR),
+	                                 TestTarget::Vertex(-1000.0f, 5000.0f, 0.5f, RED_COLOUR) });
+	uint32_t binned = target.device.GetRasterizer().GetTriangleCount();
+	CHECK(binned >= 1);
+	// off the target, or behind the far plane, nothing is binned
+	target.DrawRect(pipeline, 200.0f, 0.0f, 300.0f, 96.0f, 0.5f, GREEN_COLOUR);
+	target.DrawRect(pipeline, 0.0f, 0.0f, 160.0f, 96.0f, 1.5f, GREEN_COLOUR);
+	CHECK(target.device.GetRasterizer().GetTriangleCount() == binned);
+	target.device.Flush();
+	CHECK(target.CountWrong([](uint32_t, uint32_t) { return RED; }) == 0);
+
+	delete pipeline;
+}
+
+static void TestInterpolation()
+{
+	TestTarget target;
+	RhiPipelineState* pipeline = target.CreatePipeline(RHI_CULL_NONE, false, false);
+
+	// red from 0 at the left edge to 1 at the right, green down the target
+	const float topLeft[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	const float topRight[4] = { 1.0f, 0.0f, 0.0f, 1.0f };
+	const float bottomRight[4] = { 1.0f, 1.0f, 0.0f, 1.0f };
+	const float bottomLeft[4] = { 0.0f, 1.0f, 0.0f, 1.0f };
+	target.device.Clear(CLEAR_COLOUR, 1.0f);
+	target.DrawTriangles(pipeline, { TestTarget::Vertex(0.0f, 0.0f, 0.5f, topLeft), TestTarget::Vertex(160.0f, 0.0f, 0.5f, topRight),
+	                                 TestTarget::Vertex(160.0f, 96.0f, 0.5f, bottomRight), TestTarget::Vertex(0.0f, 0.0f, 0.5f, topLeft),
+	                                 TestTarget::Vertex(160.0f, 96.0f, 0.5f, bottomRight), TestTarget::Vertex(0.0f, 96.0f, 0.5f, bottomLeft) });
+	target.device.Flush();
+
+	uint32_t wrong = 0;
+	for (uint32_t y = 0; y < TARGET_HEIGHT; y += 5)
+	{
+		for (uint32_t x = 0; x < TARGET_WIDTH; x += 7)
+		{
+			uint32_t pixel = target.Pixel(x, y);
+			double red = (pixel >> 16) & 0xff;
+			double green = (pixel >> 8) & 0xff;
+			wrong += fabs(red - (x + 0.5) / TARGET_WIDTH * 255.0) > 1.0;
+			wrong += fabs(green - (y + 0.5) / TARGET_HEIGHT * 255.0) > 1.0;
+			wrong += (pixel & 0xff000000) != 0xff000000 || (pixel & 0xff) != 0;
+		}
+	}
+	CHECK(wrong == 0);
+
+	delete pipeline;
+}
+
+static void TestShaderResources()
+{
+	// each draw sees its constants as they were when it was submitted, not at the flush
+	{
+		TestTarget target(nullptr, ConstantPixelShader);
+		RhiPipelineState* pipeline = target.CreatePipeline(RHI_CULL_NONE, false, false);
+		RhiBuffer* constants = target.device.CreateBuffer({ RHI_BUFFER_CONSTANT, 16, 0 }, RED_COLOUR);
+		RhiCommandList* commands = target.device.GetImmediateCommandList();
+		commands->SetConstantBuffer(RHI_STAGE_PIXEL, 0, constants);
+
+		target.device.Clear(CLEAR_COLOUR, 1.0f);
+		target.DrawRect(pipeline, 0.0f, 0.0f, 80.0f, 96.0f, 0.5f, WHITE_COLOUR);
+		commands->UpdateBuffer(constants, GREEN_COLOUR, 16);
+		target.DrawRect(pipeline, 80.0f, 0.0f, 160.0f, 96.0f, 0.5f, WHITE_COLOUR);
+		commands->UpdateBuffer(constants, BLUE_COLOUR, 16);
+		target.device.Flush();
+		CHECK(target.CountWrong([](uint32_t x, uint32_t) { return x < 80 ? RED : GREEN; }) == 0);
+
+		// and a copy made last frame isn't used again
+		target.DrawRect(pipeline, 0.0f, 0.0f, 160.0f, 96.0f, 0.5f, WHITE_COLOUR);
+		target.device.Flush();
+		CHECK(target.CountWrong([](uint32_t, uint32_t) { return BLUE; }) == 0);
+
+		delete constants;
+		delete pipeline;
+	}
+
+	// a BGRA texture samples the same as the RGBA one with its bytes swapped
+	{
+		TestTarget target(nullptr, TexturePixelShader);
+		RhiPipelineState* pipeline = target.CreatePipeline(RHI_CULL_NONE, false, false);
+		const uint8_t rgba[4] = { 0xff, 0x00, 0x00, 0xff };
+		const uint8_t bgra[4] = { 0x00, 0x00, 0xff, 0xff };
+		RhiSubresourceData rgbaData = { rgba, 4 };
+		RhiSubresourceData bgraData = { bgra, 4 };
+		RhiTexture* rgbaTexture = target.device.CreateTexture({ 1, 1, 1, 1, RHI_FORMAT_R8G8B8A8_UNORM }, &rgbaData);
+		RhiTexture* bgraTexture = target.device.CreateTexture({ 1, 1, 1, 1, RHI_FORMAT_B8G8R8A8_UNORM }, &bgraData);
+		CHECK(rgbaTexture && bgraTexture);
+		CHECK(!target.device.CreateTexture({ 1, 1, 1, 1, RHI_FORMAT_BC1_UNORM }, nullptr));
+
+		RhiCommandList* commands = target.device.GetImmediateCommandList();
+		target.device.Clear(CLEAR_COLOUR, 1.0f);
+		commands->SetTexture(RHI_STAGE_PIXEL, 0, rgbaTexture);
+		target.DrawRect(pipeline, 0.0f, 0.0f, 80.0f, 96.0f, 0.5f, CLEAR_COLOUR);
+		commands->SetTexture(RHI_STAGE_PIXEL, 0, bgraTexture);
+		target.DrawRect(pipeline, 80.0f, 0.0f, 160.0f, 96.0f, 0.5f, WHITE_COLOUR);
+		target.device.Flush();
+		CHECK(target.CountWrong([](uint32_t, uint32_t) { return RED; }) == 0);
+
+		delete rgbaTexture;
+		delete bgraTexture;
+		delete pipeline;
+	}
+}
+
+// overlapping triangles of every size across tile edges, with depth and varyings
+static void DrawBusyFrame(TestTarget& target, RhiPipelineState* pipeline)
+{
+	uint32_t seed = 12345;
+	auto next = [&seed]() { seed = seed * 1664525 + 1013904223; return (seed >> 8) / 16777216.0f; };
+
+	vector<TestVertex> vertices;
+	for (uint32_t i = 0; i < 300; ++i)
+	{
+		float x = next() * 200.0f - 20.0f;
+		float y = next() * 130.0f - 17.0f;
+		float size = 2.0f + next() * (i % 10 == 0 ? 150.0f : 30.0f);
+		for (uint32_t corner = 0; corner < 3; ++corner)
+		{
+			float colour[4] = { next(), next(), next(), 1.0f };
+			vertices.push_back(TestTarget::Vertex(x + (next() - 0.5f) * size, y + (next() - 0.5f) * size, next(), colour));
+		}
+	}
+
+	const float grey[4] = { 0.25f, 0.25f, 0.25f, 1.0f };
+	target.device.Clear(grey, 1.0f);
+	target.DrawTriangles(pipeline, vertices);
+}
+
+static void TestThreads()
+{
+	// every tile drawn on this thread, or spread over four, gives the same image
+	TestTarget single;
+	RhiPipelineState* singlePipeline = single.CreatePipeline(RHI_CULL_NONE, true, true);
+	DrawBusyFrame(single, singlePipeline);
+	uint32_t triangles = single.device.GetRasterizer().GetTriangleCount();
+	single.device.Flush();
+
+	JobSystem jobs;
+	jobs.Init(3);
+	TestTarget threaded(&jobs);
+	RhiPipelineState* threadedPipeline = threaded.CreatePipeline(RHI_CULL_NONE, true, true);
+	for (uint32_t frame = 0; frame < 3; ++frame)
+	{
+		DrawBusyFrame(threaded, threadedPipeline);
+		CHECK(threaded.device.GetRasterizer().GetTriangleCount() == triangles);
+		threaded.device.Flush();
+		CHECK(threaded.Checksum() == single.Checksum());
+	}
+	CHECK(triangles > 150);
+	CHECK(threaded.CountWrong([&](uint32_t x, uint32_t y) { return single.Pixel(x, y); }) == 0);
+
+	// and something was drawn
+	uint32_t cleared = 0;
+	for (uint32_t y = 0; y < TARGET_HEIGHT; ++y)
+	{
+		for (uint32_t x = 0; x < TARGET_WIDTH; ++x)
+			cleared += single.Pixel(x, y) == 0xff404040;
+	}
+	CHECK(cleared < TARGET_WIDTH * TARGET_HEIGHT / 2);
+
+	delete singlePipeline;
+	delete threadedPipeline;
+	jobs.Shutdown();
+}
+
+int main()
+{
+	RUN_TEST(TestClear);
+	RUN_TEST(TestFillRule);
+	RUN_TEST(TestDepth);
+	RUN_TEST(TestCulling);
+	RUN_TEST(TestClipping);
+	RUN_TEST(TestInterpolation);
+	RUN_TEST(TestShaderResources);
+	RUN_TEST(TestThreads);
+	return TestResult();
+}
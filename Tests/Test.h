@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdio.h>
+#include <math.h>
+
+// checks for the tests of the modules that build without windows.h. each test file is
+// its own executable, runs its TEST functions from main and returns TestResult(), ctest
+// counts a non-zero exit as a failure
+
+static int s_testFailures = 0;
+
+#define CHECK(condition) \
+	do { if (!(condition)) { printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition); ++s_testFailures; } } while (0)
+
+#define CHECK_NEAR(value, expected, tolerance) \
+	do { double checkValue = (double)(value), checkExpected = (double)(expected); \
+	     if (!(fabs(checkValue - checkExpected) <= (double)(tolerance))) { \
+	         printf("%s(%d): CHECK_NEAR(%s, %s) failed, %g vs %g\n", __FILE__, __LINE__, #value, #expected, checkValue, checkExpected); \
+	         ++s_testFailures; } } while (0)
+
+#define RUN_TEST(test) \
+	do { int failuresBefore = s_testFailures; test(); printf("%s %s\n", failuresBefore == s_testFailures ? "passed" : "FAILED", #test); } while (0)
+
+static int TestResult()
+{
+	return s_testFailures ? 1 : 0;
+}
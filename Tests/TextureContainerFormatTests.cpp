@@ -0,0 +1,215 @@
+#include "Test.h"
+#include "TextureContainerFormat.h"
+
+#include <string.h>
+#include <vector>
+
+using namespace std;
+
+static const uint32_t TILE_SIZE = 64 * 1024;
+static const uint32_t HEADER_SIZE = 148;
+
+static uint32_t NextRandom(uint32_t& seed)
+{
+	seed = seed * 1664525u + 1013904223u;
+	return seed >> 8;
+}
+
+// a stand-in dds file: header bytes, then a smooth mip that compresses, a noisy one that
+// doesn't and a tail mip smaller than any tile, one after the other
+struct TestTexture
+{
+	vector<uint8_t> dds;
+	vector<TextureContainerSurface> surfaces;
+
+	TestTexture()
+	{
+		const uint32_t sizes[] = { 200 * 1024, 10 * 1024, 100 };
+		dds.resize(HEADER_SIZE + sizes[0] + sizes[1] + sizes[2]);
+
+		uint32_t seed = 5;
+		for (uint32_t i = 0; i < HEADER_SIZE; ++i)
+			dds[i] = (uint8_t)i;
+		for (uint32_t i = 0; i < sizes[0]; ++i)
+			dds[HEADER_SIZE + i] = (uint8_t)(i / 256);
+		for (uint32_t i = 0; i < sizes[1] + sizes[2]; ++i)
+			dds[HEADER_SIZE + sizes[0] + i] = (uint8_t)NextRandom(seed);
+
+		uint32_t offset = HEADER_SIZE;
+		for (uint32_t size : sizes)
+		{
+			surfaces.push_back({ dds.data() + offset, size });
+			offset += size;
+		}
+	}
+};
+
+// the index follows the dds header, so it is rarely aligned for the struct
+static size_t ChunkOffset(const vector<uint8_t>& container, uint32_t index)
+{
+	TextureContainerHeader header;
+	memcpy(&header, container.data(), sizeof(header));
+	return sizeof(header) + header.HeaderSize + index * sizeof(TextureContainerChunk);
+}
+
+static TextureContainerChunk GetChunk(const vector<uint8_t>& container, uint32_t index)
+{
+	TextureContainerChunk chunk;
+	memcpy(&chunk, container.data() + ChunkOffset(container, index), sizeof(chunk));
+	return chunk;
+}
+
+static void SetChunk(vector<uint8_t>& container, uint32_t index, const TextureContainerChunk& chunk)
+{
+	memcpy(container.data() + ChunkOffset(container, index), &chunk, sizeof(chunk));
+}
+
+static bool Decodes(const vector<uint8_t>& container)
+{
+	unique_ptr<uint8_t[]> dds;
+	size_t ddsSize = 0;
+	return DecodeTextureContainer(container.data(), container.size(), nullptr, dds, &ddsSize);
+}
+
+static void TestRoundTrip()
+{
+	TestTexture texture;
+	vector<uint8_t> container;
+	EncodeTextureContainer(texture.dds.data(), HEADER_SIZE, texture.surfaces, TILE_SIZE, container);
+	CHECK(container.size() < texture.dds.size() / 2);
+
+	// the big mip in four tiles, then one chunk for each of the others
+	TextureContainerHeader header;
+	vector<TextureContainerChunk> chunks;
+	CHECK(ReadTextureContainerIndex(container.data(), container.size(), header, chunks));
+	CHECK(header.HeaderSize == HEADER_SIZE && header.PayloadSize == texture.dds.size() - HEADER_SIZE);
+	CHECK(chunks.size() == 6);
+	if (chunks.size() == 6)
+	{
+		CHECK(chunks[0].Subresource == 0 && chunks[3].Subresource == 0 && chunks[3].Size == 200 * 1024 - 3 * TILE_SIZE);
+		CHECK(chunks[0].Codec == TEXTURE_CHUNK_LZ4 && chunks[0].CompressedSize < chunks[0].Size);
+		CHECK(chunks[4].Subresource == 1 && chunks[4].Codec == TEXTURE_CHUNK_STORED);
+		CHECK(chunks[4].CompressedSize == chunks[4].Size);
+		CHECK(chunks[5].Subresource == 2 && chunks[5].Size == 100);
+	}
+
+	// the same dds file back, one chunk at a time or spread over jobs
+	JobSystem jobs;
+	jobs.Init(3);
+	JobSystem* paths[] = { nullptr, &jobs };
+	for (JobSystem* path : paths)
+	{
+		unique_ptr<uint8_t[]> dds;
+		size_t ddsSize = 0;
+		CHECK(DecodeTextureContainer(container.data(), container.size(), path, dds, &ddsSize));
+		CHECK(ddsSize == texture.dds.size() && memcmp(dds.get(), texture.dds.data(), ddsSize) == 0);
+	}
+}
+
+static void TestEmptyTexture()
+{
+	// a header and no pixel data is a valid, if useless, container
+	TestTexture texture;
+	vector<uint8_t> container;
+	EncodeTextureContainer(texture.dds.data(), HEADER_SIZE, vector<TextureContainerSurface>(), TILE_SIZE, container);
+	CHECK(container.size() == sizeof(TextureContainerHeader) + HEADER_SIZE);
+
+	unique_ptr<uint8_t[]> dds;
+	size_t ddsSize = 0;
+	CHECK(DecodeTextureContainer(container.data(), container.size(), nullptr, dds, &ddsSize));
+	CHECK(ddsSize == HEADER_SIZE && memcmp(dds.get(), texture.dds.data(), HEADER_SIZE) == 0);
+}
+
+static void TestValidation()
+{
+	TestTexture texture;
+	vector<uint8_t> good;
+	EncodeTextureContainer(texture.dds.data(), HEADER_SIZE, texture.surfaces, TILE_SIZE, good);
+	CHECK(Decodes(good));
+
+	TextureContainerHeader header;
+	vector<TextureContainerChunk> chunks;
+	TextureContainerChunk chunk;
+	CHECK(!ReadTextureContainerIndex(nullptr, 0, header, chunks));
+	CHECK(!ReadTextureContainerIndex(good.data(), sizeof(TextureContainerHeader) - 1, header, chunks));
+
+	vector<uint8_t> bad = good;
+	((TextureContainerHeader*)bad.data())->Magic = 0x20534444;
+	CHECK(!Decodes(bad));
+
+	bad = good;
+	((TextureContainerHeader*)bad.data())->Version = TEXTURE_CONTAINER_VERSION + 1;
+	CHECK(!Decodes(bad));
+
+	// the index has to fit in the file, and so does every chunk's data
+	bad = good;
+	((TextureContainerHeader*)bad.data())->ChunkCount = 100000;
+	CHECK(!Decodes(bad));
+
+	bad = good;
+	bad.resize(bad.size() - 1);
+	CHECK(!Decodes(bad));
+
+	bad = good;
+	chunk = GetChunk(bad, 2);
+	chunk.FileOffset = ~0ull - 10;
+	SetChunk(bad, 2, chunk);
+	CHECK(!Decodes(bad));
+
+	// a gap, an overlap, or a payload size the chunks don't add up to
+	bad = good;
+	chunk = GetChunk(bad, 1);
+	chunk.PayloadOffset += 1;
+	SetChunk(bad, 1, chunk);
+	CHECK(!Decodes(bad));
+
+	bad = good;
+	chunk = GetChunk(bad, 1);
+	chunk.PayloadOffset -= 1;
+	SetChunk(bad, 1, chunk);
+	CHECK(!Decodes(bad));
+
+	bad = good;
+	((TextureContainerHeader*)bad.data())->PayloadSize += 1;
+	CHECK(!Decodes(bad));
+
+	bad = good;
+	chunk = GetChunk(bad, 5);
+	chunk.Size += 1;
+	SetChunk(bad, 5, chunk);
+	CHECK(!Decodes(bad));
+
+	// an unknown codec, and a stored chunk whose sizes disagree
+	bad = good;
+	chunk = GetChunk(bad, 0);
+	chunk.Codec = 7;
+	SetChunk(bad, 0, chunk);
+	CHECK(!Decodes(bad));
+
+	bad = good;
+	chunk = GetChunk(bad, 4);
+	chunk.CompressedSize -= 1;
+	SetChunk(bad, 4, chunk);
+	CHECK(!Decodes(bad));
+
+	// the index is fine but the LZ4 data in a chunk isn't
+	bad = good;
+	chunk = GetChunk(bad, 1);
+	memset(bad.data() + chunk.FileOffset, 0xFF, 16);
+	CHECK(ReadTextureContainerIndex(bad.data(), bad.size(), header, chunks));
+	CHECK(!Decodes(bad));
+
+	// which throws away what was decoded so far
+	unique_ptr<uint8_t[]> dds(new uint8_t[1]);
+	size_t ddsSize = 0;
+	CHECK(!DecodeTextureContainer(bad.data(), bad.size(), nullptr, dds, &ddsSize));
+	CHECK(!dds && ddsSize == 0);
+}
+
+int main()
+{
+	RUN_TEST(TestRoundTrip);
+	RUN_TEST(TestEmptyTexture);
+	RUN_TEST(TestValidation);
+	return TestResult();
+}
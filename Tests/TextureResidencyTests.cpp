@@ -0,0 +1,212 @@
+#include "Test.h"
+#include "TextureResidency.h"
+
+static const uint64_t MB = 1024 * 1024;
+
+// a square RGBA8 texture with a full mip chain
+static uint32_t RegisterTexture(TextureResidencyManager& manager, uint32_t size)
+{
+	uint64_t mipBytes[16];
+	uint32_t mipLevels = 0;
+	for (uint32_t s = size; ; s >>= 1)
+	{
+		mipBytes[mipLevels++] = (uint64_t)s * s * 4;
+		if (s == 1)
+			break;
+	}
+
+	return manager.Register(size, size, mipBytes, mipLevels);
+}
+
+struct Simulation
+{
+	FrameArena arena;
+	TextureResidencyManager manager;
+	uint32_t units[3];
+
+	Simulation()
+	{
+		arena.Init(64 * 1024);
+		manager.SetBudget(64 * MB);
+		for (uint32_t& unit : units)
+			unit = RegisterTexture(manager, 512);
+	}
+
+	// usage < 0 leaves the unit untouched that frame
+	void Frame(float usage0, float usage1, float usage2, FrameArenaVector<ResidencyChange>* changesOut = nullptr)
+	{
+		arena.BeginFrame();
+		float usage[3] = { usage0, usage1, usage2 };
+		for (int i = 0; i < 3; ++i)
+		{
+			if (usage[i] >= 0.0f)
+				manager.ReportUsage(units[i], usage[i]);
+		}
+
+		FrameArenaVector<ResidencyChange> changes{ FrameAllocator<ResidencyChange>(&arena) };
+		manager.EndFrame(changes);
+
+		// every change reported is the unit's new state
+		for (const ResidencyChange& change : changes)
+		{
+			CHECK(change.OldTopMip != change.NewTopMip);
+			CHECK(manager.GetTopMip(change.Unit) == change.NewTopMip);
+		}
+
+		if (changesOut)
+			changesOut->assign(changes.begin(), changes.end());
+	}
+
+	// A drawn big, B small, C drawn for a while and then not at all
+	void Warm()
+	{
+		for (int frame = 0; frame < 10; ++frame)
+			Frame(1000.0f, 100.0f, 10.0f);
+		for (int frame = 0; frame < 10; ++frame)
+			Frame(1000.0f, 100.0f, -1.0f);
+	}
+};
+
+static void TestRegister()
+{
+	TextureResidencyManager manager;
+	uint32_t unit = RegisterTexture(manager, 512);
+
+	// 512 down to 1 is about 4/3 of the top level
+	CHECK(manager.GetUnitBytes(unit) == 1398100);
+	CHECK(manager.GetResidentBytes() == 1398100);
+	CHECK(manager.GetTopMip(unit) == 0);
+
+	// never reduced below the 64 texel minimum, mip 3, and undoing a change clamps to it
+	manager.SetTopMip(unit, 9);
+	CHECK(manager.GetTopMip(unit) == 3);
+}
+
+static void TestRegisterNonPowerOfTwo()
+{
+	// mips round down: 200x100, 100x50, 50x25. 100x50 is the last level at least 64
+	// on its longest edge
+	TextureResidencyManager manager;
+	const uint64_t wideBytes[] = { 200 * 100 * 4, 100 * 50 * 4, 50 * 25 * 4, 25 * 12 * 4 };
+	uint32_t wide = manager.Register(200, 100, wideBytes, 4);
+	manager.SetTopMip(wide, 9);
+	CHECK(manager.GetTopMip(wide) == 1);
+
+	// 127 halves to 63, already under the minimum, so it can't drop at all
+	const uint64_t oddBytes[] = { 127 * 127 * 4, 63 * 63 * 4, 31 * 31 * 4 };
+	uint32_t odd = manager.Register(127, 127, oddBytes, 3);
+	manager.SetTopMip(odd, 9);
+	CHECK(manager.GetTopMip(odd) == 0);
+
+	// and exactly the minimum is still allowed, 129 to 64
+	const uint64_t tallBytes[] = { 20 * 129 * 4, 10 * 64 * 4, 5 * 32 * 4 };
+	uint32_t tall = manager.Register(20, 129, tallBytes, 3);
+	manager.SetTopMip(tall, 9);
+	CHECK(manager.GetTopMip(tall) == 1);
+}
+
+static void TestNoPressure()
+{
+	Simulation sim;
+	FrameArenaVector<ResidencyChange> changes{ FrameAllocator<ResidencyChange>(&sim.arena) };
+	for (int frame = 0; frame < 5; ++frame)
+	{
+		sim.Frame(1000.0f, 100.0f, 10.0f, &changes);
+		CHECK(changes.empty());
+	}
+	CHECK(sim.manager.GetResidentBytes() == 3 * 1398100);
+}
+
+static void TestEvictionOrder()
+{
+	Simulation sim;
+	sim.Warm();
+	uint64_t total = sim.manager.GetResidentBytes();
+
+	// one byte over, one top mip goes and it's the least recently used texture's
+	sim.manager.SetBudget(total - 1);
+	FrameArenaVector<ResidencyChange> changes{ FrameAllocator<ResidencyChange>(&sim.arena) };
+	sim.Frame(1000.0f, 100.0f, -1.0f, &changes);
+	CHECK(changes.size() == 1);
+	CHECK(changes.size() == 1 && changes[0].Unit == sim.units[2] && changes[0].OldTopMip == 0 && changes[0].NewTopMip == 1);
+	CHECK(sim.manager.GetTopMip(sim.units[0]) == 0);
+	CHECK(sim.manager.GetTopMip(sim.units[1]) == 0);
+
+	// past what C can give up, C goes down to its minimum and then the less visible B pays
+	sim.manager.SetBudget(total - 3 * MB / 2);
+	sim.Frame(1000.0f, 100.0f, -1.0f);
+	CHECK(sim.manager.GetTopMip(sim.units[2]) == 3);
+	CHECK(sim.manager.GetTopMip(sim.units[1]) == 1);
+	CHECK(sim.manager.GetTopMip(sim.units[0]) == 0);
+	CHECK(sim.manager.GetResidentBytes() <= sim.manager.GetBudget());
+}
+
+static void TestBudgetEnforced()
+{
+	Simulation sim;
+	sim.Warm();
+
+	for (uint64_t budget : { 3 * MB, 2 * MB, 1 * MB, MB / 4 })
+	{
+		sim.manager.SetBudget(budget);
+		sim.Frame(1000.0f, 100.0f, 10.0f);
+		CHECK(sim.manager.GetResidentBytes() <= budget);
+	}
+
+	// below what every texture at its minimum size takes, they all stop there
+	sim.manager.SetBudget(1024);
+	sim.Frame(1000.0f, 100.0f, 10.0f);
+	for (uint32_t unit : sim.units)
+		CHECK(sim.manager.GetTopMip(unit) == 3);
+	CHECK(sim.manager.GetResidentBytes() > 1024);
+}
+
+static void TestRestoreOnTouch()
+{
+	Simulation sim;
+	sim.Warm();
+	uint64_t total = sim.manager.GetResidentBytes();
+	sim.manager.SetBudget(total - 3 * MB / 2);
+	sim.Frame(1000.0f, 100.0f, -1.0f);
+	CHECK(sim.manager.GetTopMip(sim.units[2]) == 3);
+	CHECK(sim.manager.GetTopMip(sim.units[1]) == 1);
+
+	// room again, but not with the 10% headroom restores need, so nothing comes back
+	sim.manager.SetBudget(sim.manager.GetResidentBytes() + 64 * 1024);
+	FrameArenaVector<ResidencyChange> changes{ FrameAllocator<ResidencyChange>(&sim.arena) };
+	sim.Frame(1000.0f, 100.0f, 5000.0f, &changes);
+	CHECK(changes.empty());
+
+	// plenty of room: C is drawn biggest now, so it gets its mips back first, one a frame
+	sim.manager.SetBudget(64 * MB);
+	uint32_t restoredFrames = 0;
+	for (int frame = 0; frame < 20 && sim.manager.GetTopMip(sim.units[2]) > 0; ++frame)
+	{
+		sim.Frame(1000.0f, 100.0f, 5000.0f, &changes);
+		CHECK(changes.size() <= 1);
+		if (!changes.empty())
+		{
+			CHECK(changes[0].Unit == sim.units[2] && changes[0].NewTopMip + 1 == changes[0].OldTopMip);
+			++restoredFrames;
+		}
+		CHECK(sim.manager.GetTopMip(sim.units[1]) == 1);
+	}
+	CHECK(sim.manager.GetTopMip(sim.units[2]) == 0);
+	CHECK(restoredFrames == 3);
+
+	// then B
+	sim.Frame(1000.0f, 100.0f, 5000.0f, &changes);
+	CHECK(changes.size() == 1 && changes[0].Unit == sim.units[1] && changes[0].NewTopMip == 0);
+	CHECK(sim.manager.GetResidentBytes() == total);
+}
+
+int main()
+{
+	RUN_TEST(TestRegister);
+	RUN_TEST(TestRegisterNonPowerOfTwo);
+	RUN_TEST(TestNoPressure);
+	RUN_TEST(TestEvictionOrder);
+	RUN_TEST(TestBudgetEnforced);
+	RUN_TEST(TestRestoreOnTouch);
+	return TestResult();
+}
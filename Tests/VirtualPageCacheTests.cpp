@@ -0,0 +1,253 @@
+#include "Test.h"
+#include "VirtualPageCache.h"
+
+#include <map>
+
+static uint32_t Allocate(VirtualPageCache& cache, uint32_t pageId, uint64_t frame, uint32_t* evicted)
+{
+	uint32_t slot = VT_INVALID_PAGE;
+	CHECK(cache.Allocate(pageId, frame, &slot, evicted));
+	CHECK(cache.GetSlotPage(slot) == pageId);
+	return slot;
+}
+
+static bool IsResident(const VirtualPageCache& cache, uint32_t pageId)
+{
+	uint32_t slot;
+	return cache.Lookup(pageId, &slot) && cache.GetSlotPage(slot) == pageId;
+}
+
+// count mip 0 pages whose entry in a table of 1 << bits starts at home
+static vector<uint32_t> CollidingPages(uint32_t home, uint32_t bits, uint32_t count)
+{
+	vector<uint32_t> pages;
+	for (uint32_t x = 0; pages.size() < count; ++x)
+	{
+		uint32_t pageId = MakePageId(0, x & 0xFFF, x >> 12);
+		if (HashPage(pageId, bits) == home)
+			pages.push_back(pageId);
+	}
+	return pages;
+}
+
+static void TestLeastRecentlyUsed()
+{
+	VirtualPageCache cache;
+	cache.Init(4);
+
+	uint32_t evicted;
+	for (uint32_t x = 0; x < 4; ++x)
+	{
+		Allocate(cache, MakePageId(0, x, 0), x + 1, &evicted);
+		CHECK(evicted == VT_INVALID_PAGE);
+	}
+
+	// full, the oldest goes
+	Allocate(cache, MakePageId(0, 4, 0), 5, &evicted);
+	CHECK(evicted == MakePageId(0, 0, 0));
+	CHECK(!IsResident(cache, MakePageId(0, 0, 0)));
+
+	// touching moves a page to the front, so the next oldest goes instead
+	uint32_t slot;
+	CHECK(cache.Lookup(MakePageId(0, 1, 0), &slot));
+	cache.Touch(slot, 6);
+	Allocate(cache, MakePageId(0, 5, 0), 6, &evicted);
+	CHECK(evicted == MakePageId(0, 2, 0));
+
+	for (uint32_t x : { 1, 3, 4, 5 })
+		CHECK(IsResident(cache, MakePageId(0, x, 0)));
+}
+
+static void TestPinnedAndCurrentFrame()
+{
+	VirtualPageCache cache;
+	cache.Init(3);
+
+	uint32_t evicted;
+	uint32_t a = Allocate(cache, MakePageId(2, 0, 0), 1, &evicted);
+	Allocate(cache, MakePageId(0, 1, 0), 2, &evicted);
+	Allocate(cache, MakePageId(0, 2, 0), 3, &evicted);
+	cache.Pin(a);
+
+	// the pinned page is the oldest but stays
+	Allocate(cache, MakePageId(0, 3, 0), 4, &evicted);
+	CHECK(evicted == MakePageId(0, 1, 0));
+	Allocate(cache, MakePageId(0, 4, 0), 5, &evicted);
+	CHECK(evicted == MakePageId(0, 2, 0));
+	CHECK(IsResident(cache, MakePageId(2, 0, 0)));
+
+	// everything else was used this frame, so there's no slot rather than a page pulled
+	// out from under the frame being drawn
+	uint32_t slot;
+	CHECK(cache.Lookup(MakePageId(0, 3, 0), &slot));
+	cache.Touch(slot, 6);
+	CHECK(cache.Lookup(MakePageId(0, 4, 0), &slot));
+	cache.Touch(slot, 6);
+	slot = 0;
+	CHECK(!cache.Allocate(MakePageId(0, 5, 0), 6, &slot, &evicted));
+	CHECK(evicted == VT_INVALID_PAGE);
+	for (uint32_t pageId : { MakePageId(2, 0, 0), MakePageId(0, 3, 0), MakePageId(0, 4, 0) })
+		CHECK(IsResident(cache, pageId));
+
+	// next frame the older of the two can go
+	Allocate(cache, MakePageId(0, 5, 0), 7, &evicted);
+	CHECK(evicted == MakePageId(0, 3, 0));
+}
+
+// a run of pages with the same home, with pages homed just after it, erasing the first
+// has to shift the rest back or lookups for them stop at the hole
+static void TestBackwardShiftErase(uint32_t home)
+{
+	// 8 slots index into a table of 16
+	VirtualPageCache cache;
+	cache.Init(8);
+	const uint32_t bits = 4;
+
+	vector<uint32_t> pages = CollidingPages(home, bits, 4);
+	for (uint32_t pageId : CollidingPages((home + 1) & 15, bits, 2))
+		pages.push_back(pageId);
+	pages.push_back(CollidingPages((home + 3) & 15, bits, 1)[0]);
+
+	uint32_t evicted;
+	uint64_t frame = 1;
+	for (uint32_t pageId : pages)
+		Allocate(cache, pageId, frame++, &evicted);
+	Allocate(cache, MakePageId(1, 0, 0), frame++, &evicted);
+
+	// push them out in the order they came in, from the front of the run
+	for (size_t i = 0; i < pages.size(); ++i)
+	{
+		uint32_t newPage = MakePageId(1, (uint32_t)i + 1, 0);
+		Allocate(cache, newPage, frame++, &evicted);
+		CHECK(evicted == pages[i]);
+		CHECK(!IsResident(cache, pages[i]));
+		for (size_t j = i + 1; j < pages.size(); ++j)
+			CHECK(IsResident(cache, pages[j]));
+		CHECK(IsResident(cache, newPage));
+	}
+}
+
+static void TestBackwardShiftEraseMiddle()
+{
+	TestBackwardShiftErase(5);
+}
+
+static void TestBackwardShiftEraseWrapped()
+{
+	// the run wraps from the end of the table to the start
+	TestBackwardShiftErase(14);
+}
+
+static void TestIndexMatchesSlots()
+{
+	VirtualPageCache cache;
+	cache.Init(16);
+
+	// many more pages than slots from a small range, so entries keep colliding and moving
+	map<uint32_t, uint32_t> resident;
+	uint32_t seed = 7;
+	for (uint64_t frame = 1; frame < 4000; ++frame)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		uint32_t pageId = MakePageId(0, (seed >> 8) % 64, 0);
+
+		uint32_t slot;
+		if (cache.Lookup(pageId, &slot))
+		{
+			CHECK(resident.count(pageId) && resident[pageId] == slot);
+			cache.Touch(slot, frame);
+			continue;
+		}
+
+		CHECK(!resident.count(pageId));
+		uint32_t evicted;
+		slot = Allocate(cache, pageId, frame, &evicted);
+		if (evicted != VT_INVALID_PAGE)
+		{
+			CHECK(resident.count(evicted) && resident[evicted] == slot);
+			resident.erase(evicted);
+		}
+		resident[pageId] = slot;
+	}
+
+	CHECK(resident.size() == 16);
+	for (const auto& entry : resident)
+	{
+		uint32_t slot;
+		CHECK(cache.Lookup(entry.first, &slot) && slot == entry.second);
+	}
+}
+
+static void TestResolveOrder()
+{
+	PageRequestScheduler scheduler;
+	scheduler.BeginFrame();
+
+	for (int i = 0; i < 10; ++i)
+		scheduler.Request(MakePageId(0, 1, 1));
+	for (int i = 0; i < 3; ++i)
+		scheduler.Request(MakePageId(1, 0, 0));
+	for (int i = 0; i < 5; ++i)
+		scheduler.Request(MakePageId(1, 1, 0));
+	scheduler.Request(MakePageId(2, 0, 0));
+	for (int i = 0; i < 5; ++i)
+		scheduler.Request(MakePageId(1, 0, 1));
+
+	// coarsest first however few asked for it, then most requested, ties by id
+	vector<uint32_t> pages;
+	scheduler.Resolve(pages);
+	vector<uint32_t> expected = { MakePageId(2, 0, 0), MakePageId(1, 1, 0), MakePageId(1, 0, 1),
+	                              MakePageId(1, 0, 0), MakePageId(0, 1, 1) };
+	CHECK(pages == expected);
+
+	// the counts start again each frame
+	scheduler.BeginFrame();
+	scheduler.Request(MakePageId(0, 1, 1));
+	scheduler.Resolve(pages);
+	CHECK(pages.size() == 1 && pages[0] == MakePageId(0, 1, 1));
+
+	scheduler.BeginFrame();
+	scheduler.Resolve(pages);
+	CHECK(pages.empty());
+}
+
+static void TestResolveAfterGrow()
+{
+	PageRequestScheduler scheduler;
+
+	// enough distinct pages to grow the table twice part way through the frame
+	for (int frame = 0; frame < 2; ++frame)
+	{
+		scheduler.BeginFrame();
+		for (uint32_t round = 0; round < 7; ++round)
+		{
+			for (uint32_t x = 0; x < 300; ++x)
+			{
+				if (round < x % 7 + 1)
+					scheduler.Request(MakePageId(0, x, 0));
+			}
+		}
+
+		vector<uint32_t> pages;
+		scheduler.Resolve(pages);
+		CHECK(pages.size() == 300);
+		for (size_t i = 1; i < pages.size(); ++i)
+		{
+			uint32_t a = PageX(pages[i - 1]) % 7;
+			uint32_t b = PageX(pages[i]) % 7;
+			CHECK(a > b || (a == b && pages[i - 1] < pages[i]));
+		}
+	}
+}
+
+int main()
+{
+	RUN_TEST(TestLeastRecentlyUsed);
+	RUN_TEST(TestPinnedAndCurrentFrame);
+	RUN_TEST(TestBackwardShiftEraseMiddle);
+	RUN_TEST(TestBackwardShiftEraseWrapped);
+	RUN_TEST(TestIndexMatchesSlots);
+	RUN_TEST(TestResolveOrder);
+	RUN_TEST(TestResolveAfterGrow);
+	return TestResult();
+}
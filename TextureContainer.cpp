@@ -0,0 +1,166 @@
+#include "TextureContainer.h"
+#include "DDSTextureLoader.h"
+#include <stdio.h>
+#include <wchar.h>
+
+using namespace DirectX;
+
+static HRESULT ReadWholeFile(const wchar_t* fileName, unique_ptr<uint8_t[]>& data, size_t* size)
+{
+    HANDLE file = CreateFileW(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    LARGE_INTEGER fileSize = { 0 };
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.HighPart > 0)
+    {
+        CloseHandle(file);
+        return E_FAIL;
+    }
+
+    data.reset(new (std::nothrow) uint8_t[fileSize.LowPart]);
+    if (!data)
+    {
+        CloseHandle(file);
+        return E_OUTOFMEMORY;
+    }
+
+    DWORD bytesRead = 0;
+    BOOL ok = ReadFile(file, data.get(), fileSize.LowPart, &bytesRead, nullptr);
+    CloseHandle(file);
+
+    if (!ok || bytesRead != fileSize.LowPart)
+        return E_FAIL;
+
+    *size = fileSize.LowPart;
+    return S_OK;
+}
+
+static bool WriteBytes(HANDLE file, const void* data, size_t size)
+{
+    DWORD written = 0;
+    return WriteFile(file, data, (DWORD)size, &written, nullptr) && written == size;
+}
+
+HRESULT WriteTextureContainer(const wchar_t* ddsFileName, const wchar_t* containerFileName, UINT tileSize)
+{
+    if (!ddsFileName || !containerFileName || tileSize == 0)
+        return E_INVALIDARG;
+
+    unique_ptr<uint8_t[]> ddsData;
+    D3D11_TEXTURE2D_DESC desc;
+    vector<D3D11_SUBRESOURCE_DATA> initData;
+    HRESULT hr = LoadDDSTextureDataFromFile(ddsFileName, ddsData, &desc, initData);
+
+    if (FAILED(hr))
+        return hr;
+
+    if (initData.empty())
+        return E_FAIL;
+
+    // subresources follow each other in the file, slice by slice and mip by mip
+    const uint8_t* payload = (const uint8_t*)initData[0].pSysMem;
+    vector<TextureContainerSurface> surfaces;
+    for (const D3D11_SUBRESOURCE_DATA& subresource : initData)
+        surfaces.push_back({ (const uint8_t*)subresource.pSysMem, subresource.SysMemSlicePitch });
+
+    vector<uint8_t> container;
+    EncodeTextureContainer(ddsData.get(), (UINT)(payload - ddsData.get()), surfaces, tileSize, container);
+
+    HANDLE file = CreateFileW(containerFileName, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    bool ok = WriteBytes(file, container.data(), container.size());
+    CloseHandle(file);
+
+    return ok ? S_OK : E_FAIL;
+}
+
+HRESULT LoadTextureContainer(const wchar_t* fileName, JobSystem* jobs, unique_ptr<uint8_t[]>& ddsData, size_t* ddsSize)
+{
+    if (!fileName || !ddsSize)
+        return E_INVALIDARG;
+
+    unique_ptr<uint8_t[]> file;
+    size_t fileSize = 0;
+    HRESULT hr = ReadWholeFile(fileName, file, &fileSize);
+
+    if (FAILED(hr))
+        return hr;
+
+    return DecodeTextureContainer(file.get(), fileSize, jobs, ddsData, ddsSize) ? S_OK : E_FAIL;
+}
+
+HRESULT CreateTextureFromContainer(ID3D11Device* device, const wchar_t* fileName, JobSystem* jobs,
+                                   ID3D11Resource** texture, ID3D11ShaderResourceView** textureView, size_t maxsize)
+{
+    unique_ptr<uint8_t[]> ddsData;
+    size_t ddsSize = 0;
+    HRESULT hr = LoadTextureContainer(fileName, jobs, ddsData, &ddsSize);
+
+    if (FAILED(hr))
+        return hr;
+
+    return CreateDDSTextureFromMemory(device, ddsData.get(), ddsSize, texture, textureView, maxsize);
+}
+
+bool IsTextureContainerFile(const wchar_t* fileName)
+{
+    if (!fileName)
+        return false;
+
+    const wchar_t* extension = wcsrchr(fileName, L'.');
+    return extension && _wcsicmp(extension, L".ddsz") == 0;
+}
+
+void BenchmarkTextureContainer(const wchar_t* ddsFileName, const wchar_t* containerFileName, JobSystem* jobs, UINT iterations)
+{
+    LARGE_INTEGER frequency, start, end;
+    QueryPerformanceFrequency(&frequency);
+    iterations = max(iterations, 1u);
+
+    // the files stay in the os cache after the first pass, so this measures the cpu side
+    // of each path rather than the disk
+    double rawTime = 0.0;
+    double serialTime = 0.0;
+    double parallelTime = 0.0;
+
+    for (UINT i = 0; i < iterations; ++i)
+    {
+        unique_ptr<uint8_t[]> ddsData;
+        D3D11_TEXTURE2D_DESC desc;
+        vector<D3D11_SUBRESOURCE_DATA> initData;
+        size_t ddsSize = 0;
+
+        QueryPerformanceCounter(&start);
+        if (FAILED(LoadDDSTextureDataFromFile(ddsFileName, ddsData, &desc, initData)))
+            return;
+        QueryPerformanceCounter(&end);
+        rawTime += (double)(end.QuadPart - start.QuadPart) / frequency.QuadPart;
+
+        QueryPerformanceCounter(&start);
+        if (FAILED(LoadTextureContainer(containerFileName, nullptr, ddsData, &ddsSize)))
+            return;
+        QueryPerformanceCounter(&end);
+        serialTime += (double)(end.QuadPart - start.QuadPart) / frequency.QuadPart;
+
+        QueryPerformanceCounter(&start);
+        if (FAILED(LoadTextureContainer(containerFileName, jobs, ddsData, &ddsSize)))
+            return;
+        QueryPerformanceCounter(&end);
+        parallelTime += (double)(end.QuadPart - start.QuadPart) / frequency.QuadPart;
+    }
+
+    WIN32_FILE_ATTRIBUTE_DATA rawInfo, containerInfo;
+    GetFileAttributesExW(ddsFileName, GetFileExInfoStandard, &rawInfo);
+    GetFileAttributesExW(containerFileName, GetFileExInfoStandard, &containerInfo);
+
+    wchar_t line[512];
+    swprintf_s(line, L"%s: raw %u bytes %.3f ms, container %u bytes serial %.3f ms, parallel (%u threads) %.3f ms\n",
+               ddsFileName, rawInfo.nFileSizeLow, rawTime * 1000.0 / iterations,
+               containerInfo.nFileSizeLow, serialTime * 1000.0 / iterations,
+               jobs ? jobs->GetThreadCount() : 1, parallelTime * 1000.0 / iterations);
+    OutputDebugStringW(line);
+}
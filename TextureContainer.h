@@ -0,0 +1,28 @@
+#pragma once
+
+#include <windows.h>
+#include <d3d11_1.h>
+#include <memory>
+#include <vector>
+
+#include "TextureContainerFormat.h"
+
+using namespace std;
+
+// reading and writing .ddsz files, the format itself is in TextureContainerFormat.h
+
+// offline, compresses a 2D dds file into a container
+HRESULT WriteTextureContainer(const wchar_t* ddsFileName, const wchar_t* containerFileName, UINT tileSize = 256 * 1024);
+
+// decompresses a container back into an in-memory dds file, chunks are spread over jobs when given
+HRESULT LoadTextureContainer(const wchar_t* fileName, JobSystem* jobs, unique_ptr<uint8_t[]>& ddsData, size_t* ddsSize);
+
+HRESULT CreateTextureFromContainer(ID3D11Device* device, const wchar_t* fileName, JobSystem* jobs,
+                                   ID3D11Resource** texture, ID3D11ShaderResourceView** textureView, size_t maxsize = 0);
+
+// containers are recognised by their .ddsz extension
+bool IsTextureContainerFile(const wchar_t* fileName);
+
+// times loading the raw dds against loading its container (cpu side only, no device
+// upload) and writes the averages to the debug output
+void BenchmarkTextureContainer(const wchar_t* ddsFileName, const wchar_t* containerFileName, JobSystem* jobs, UINT iterations);
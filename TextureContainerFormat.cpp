@@ -0,0 +1,177 @@
+#include "TextureContainerFormat.h"
+#include "LZ4.h"
+#include <algorithm>
+#include <atomic>
+#include <limits.h>
+#include <string.h>
+
+static void Append(vector<uint8_t>& data, const void* bytes, size_t size)
+{
+    data.insert(data.end(), (const uint8_t*)bytes, (const uint8_t*)bytes + size);
+}
+
+void EncodeTextureContainer(const uint8_t* ddsHeader, uint32_t headerSize, const vector<TextureContainerSurface>& surfaces,
+                            uint32_t tileSize, vector<uint8_t>& container)
+{
+    tileSize = max(tileSize, 1u);
+
+    TextureContainerHeader header;
+    header.Magic = TEXTURE_CONTAINER_MAGIC;
+    header.Version = TEXTURE_CONTAINER_VERSION;
+    header.HeaderSize = headerSize;
+    header.ChunkCount = 0;
+    header.PayloadSize = 0;
+
+    vector<TextureContainerChunk> chunks;
+    vector<vector<uint8_t>> chunkData;
+
+    for (uint32_t subresource = 0; subresource < surfaces.size(); ++subresource)
+    {
+        const uint8_t* surface = surfaces[subresource].Data;
+        uint32_t surfaceSize = surfaces[subresource].Size;
+
+        for (uint32_t offset = 0; offset < surfaceSize; offset += tileSize)
+        {
+            TextureContainerChunk chunk;
+            chunk.FileOffset = 0;
+            chunk.PayloadOffset = header.PayloadSize;
+            chunk.Size = min(tileSize, surfaceSize - offset);
+            chunk.Subresource = subresource;
+            chunk.Codec = TEXTURE_CHUNK_LZ4;
+
+            vector<uint8_t> compressed(LZ4CompressBound(chunk.Size));
+            size_t compressedSize = LZ4CompressBlock(surface + offset, chunk.Size, compressed.data(), compressed.size());
+
+            // noisy data can come out bigger, keep it as it is
+            if (compressedSize == 0 || compressedSize >= chunk.Size)
+            {
+                chunk.Codec = TEXTURE_CHUNK_STORED;
+                compressed.assign(surface + offset, surface + offset + chunk.Size);
+            }
+            else
+            {
+                compressed.resize(compressedSize);
+            }
+
+            chunk.CompressedSize = (uint32_t)compressed.size();
+            header.PayloadSize += chunk.Size;
+            chunks.push_back(chunk);
+            chunkData.push_back(move(compressed));
+        }
+    }
+
+    header.ChunkCount = (uint32_t)chunks.size();
+
+    uint64_t fileOffset = sizeof(header) + headerSize + chunks.size() * sizeof(TextureContainerChunk);
+    for (TextureContainerChunk& chunk : chunks)
+    {
+        chunk.FileOffset = fileOffset;
+        fileOffset += chunk.CompressedSize;
+    }
+
+    container.clear();
+    container.reserve((size_t)fileOffset);
+    Append(container, &header, sizeof(header));
+    Append(container, ddsHeader, headerSize);
+    Append(container, chunks.data(), chunks.size() * sizeof(TextureContainerChunk));
+    for (const vector<uint8_t>& data : chunkData)
+        Append(container, data.data(), data.size());
+}
+
+bool ReadTextureContainerIndex(const uint8_t* container, size_t containerSize, TextureContainerHeader& header,
+                               vector<TextureContainerChunk>& chunks)
+{
+    chunks.clear();
+
+    if (!container || containerSize < sizeof(TextureContainerHeader))
+        return false;
+
+    memcpy(&header, container, sizeof(header));
+
+    if (header.Magic != TEXTURE_CONTAINER_MAGIC || header.Version != TEXTURE_CONTAINER_VERSION)
+        return false;
+
+    uint64_t indexOffset = sizeof(header) + (uint64_t)header.HeaderSize;
+    if (indexOffset + (uint64_t)header.ChunkCount * sizeof(TextureContainerChunk) > containerSize ||
+        header.PayloadSize > UINT_MAX || header.HeaderSize + header.PayloadSize > UINT_MAX)
+    {
+        return false;
+    }
+
+    chunks.resize(header.ChunkCount);
+    if (header.ChunkCount)
+        memcpy(chunks.data(), container + indexOffset, chunks.size() * sizeof(TextureContainerChunk));
+
+    // chunks have to cover the payload exactly once, so the parallel writes never overlap
+    uint64_t expectedOffset = 0;
+    for (const TextureContainerChunk& chunk : chunks)
+    {
+        if (chunk.PayloadOffset != expectedOffset || chunk.FileOffset > containerSize ||
+            chunk.CompressedSize > containerSize - chunk.FileOffset ||
+            (chunk.Codec != TEXTURE_CHUNK_LZ4 && (chunk.Codec != TEXTURE_CHUNK_STORED || chunk.CompressedSize != chunk.Size)))
+        {
+            chunks.clear();
+            return false;
+        }
+
+        expectedOffset += chunk.Size;
+    }
+
+    if (expectedOffset != header.PayloadSize)
+    {
+        chunks.clear();
+        return false;
+    }
+
+    return true;
+}
+
+bool DecodeTextureContainer(const uint8_t* container, size_t containerSize, JobSystem* jobs,
+                            unique_ptr<uint8_t[]>& ddsData, size_t* ddsSize)
+{
+    TextureContainerHeader header;
+    vector<TextureContainerChunk> chunks;
+    if (!ddsSize || !ReadTextureContainerIndex(container, containerSize, header, chunks))
+        return false;
+
+    size_t size = (size_t)(header.HeaderSize + header.PayloadSize);
+    ddsData.reset(new (std::nothrow) uint8_t[size]);
+    if (!ddsData)
+        return false;
+
+    memcpy(ddsData.get(), container + sizeof(header), header.HeaderSize);
+
+    uint8_t* payload = ddsData.get() + header.HeaderSize;
+    atomic<bool> failed(false);
+
+    auto decompress = [&](uint32_t index)
+    {
+        const TextureContainerChunk& chunk = chunks[index];
+        uint8_t* dst = payload + chunk.PayloadOffset;
+        const uint8_t* src = container + chunk.FileOffset;
+
+        if (chunk.Codec == TEXTURE_CHUNK_STORED)
+            memcpy(dst, src, chunk.Size);
+        else if (!LZ4DecompressBlock(src, chunk.CompressedSize, dst, chunk.Size))
+            failed = true;
+    };
+
+    if (jobs)
+    {
+        jobs->ParallelFor(header.ChunkCount, decompress);
+    }
+    else
+    {
+        for (uint32_t i = 0; i < header.ChunkCount; ++i)
+            decompress(i);
+    }
+
+    if (failed)
+    {
+        ddsData.reset();
+        return false;
+    }
+
+    *ddsSize = size;
+    return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <vector>
+
+#include "JobSystem.h"
+
+using namespace std;
+
+// compressed wrapper around a dds file. the dds header is kept as is and the pixel data
+// is split per subresource (large ones further into tiles) with each piece compressed
+// on its own, so pieces can be decompressed in parallel straight into the final image.
+// kept free of windows and d3d headers so the format builds and can be checked anywhere
+//
+// layout: TextureContainerHeader, dds header bytes, TextureContainerChunk[ChunkCount], chunk data
+static const uint32_t TEXTURE_CONTAINER_MAGIC = 0x5A534444; // "DDSZ"
+static const uint32_t TEXTURE_CONTAINER_VERSION = 1;
+
+enum TextureChunkCodec
+{
+	TEXTURE_CHUNK_STORED = 0,
+	TEXTURE_CHUNK_LZ4 = 1,
+};
+
+struct TextureContainerHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	// bytes of dds header (magic, DDS_HEADER and the DX10 extension if any)
+	uint32_t HeaderSize;
+	uint32_t ChunkCount;
+	uint64_t PayloadSize;
+};
+
+// index table entry, offsets into the container file and into the dds pixel data
+struct TextureContainerChunk
+{
+	uint64_t FileOffset;
+	uint64_t PayloadOffset;
+	uint32_t CompressedSize;
+	uint32_t Size;
+	uint32_t Subresource;
+	uint32_t Codec;
+};
+
+// a subresource's pixel data, they follow each other in the dds file
+struct TextureContainerSurface
+{
+	const uint8_t* Data;
+	uint32_t Size;
+};
+
+// the whole container in memory, tiles that don't get smaller are stored as they are
+void EncodeTextureContainer(const uint8_t* ddsHeader, uint32_t headerSize, const vector<TextureContainerSurface>& surfaces,
+                            uint32_t tileSize, vector<uint8_t>& container);
+
+// checks the header and that the chunks cover the payload exactly once from inside the
+// file, false for anything that doesn't
+bool ReadTextureContainerIndex(const uint8_t* container, size_t containerSize, TextureContainerHeader& header,
+                               vector<TextureContainerChunk>& chunks);
+
+// back into the dds file it was made from, chunks are spread over jobs when given
+bool DecodeTextureContainer(const uint8_t* container, size_t containerSize, JobSystem* jobs,
+                            unique_ptr<uint8_t[]>& ddsData, size_t* ddsSize);
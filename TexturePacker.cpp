@@ -0,0 +1,443 @@
+#include "TexturePacker.h"
+#include "DDSTextureLoader.h"
+#include "TextureContainer.h"
+#include <algorithm>
+
+static bool IsBlockCompressed(DXGI_FORMAT format)
+{
+    return (format >= DXGI_FORMAT_BC1_TYPELESS && format <= DXGI_FORMAT_BC5_SNORM) ||
+           (format >= DXGI_FORMAT_BC6H_TYPELESS && format <= DXGI_FORMAT_BC7_UNORM_SRGB);
+}
+
+static UINT AlignUp(UINT value, UINT alignment)
+{
+    return ((value + alignment - 1) / alignment) * alignment;
+}
+
+// texels kept clear round each atlas rectangle so filtering doesn't reach a neighbour,
+// a whole block for BC formats
+static const UINT ATLAS_PADDING = 2;
+static const UINT ATLAS_BLOCK_PADDING = 4;
+
+//--------------------------------------------------------------------------------------
+// TexturePacker
+//--------------------------------------------------------------------------------------
+TexturePacker::TexturePacker()
+{
+    _atlasPageSize = 2048;
+    _atlasThreshold = 256;
+    _jobs = nullptr;
+}
+
+TexturePacker::~TexturePacker()
+{
+    Release();
+}
+
+HRESULT TexturePacker::SetAtlasParameters(UINT pageSize, UINT threshold)
+{
+    // A texture at the threshold has to fit on a page with its padding, whatever its format
+    if (AlignUp(threshold + ATLAS_BLOCK_PADDING * 2, 4) > pageSize)
+        return E_INVALIDARG;
+
+    _atlasPageSize = pageSize;
+    _atlasThreshold = threshold;
+    return S_OK;
+}
+
+HRESULT TexturePacker::AddTexture(ID3D11Device* device, const wchar_t* fileName, UINT* handle)
+{
+    if (!device || !fileName || !handle)
+        return E_INVALIDARG;
+
+    Entry entry;
+    entry.fileName = fileName;
+    entry.source = nullptr;
+    ZeroMemory(&entry.material, sizeof(entry.material));
+    HRESULT hr = LoadSource(device, entry.fileName, 0, &entry.source);
+
+    if (FAILED(hr))
+        return hr;
+
+    entry.source->GetDesc(&entry.desc);
+
+    // cube maps and arrays keep their own resource
+    if (entry.desc.ArraySize != 1)
+    {
+        entry.source->Release();
+        return E_INVALIDARG;
+    }
+
+    *handle = (UINT)_entries.size();
+    _entries.push_back(entry);
+
+    return S_OK;
+}
+
+HRESULT TexturePacker::LoadSource(ID3D11Device* device, const wstring& fileName, size_t maxsize, ID3D11Texture2D** texture)
+{
+    ID3D11Resource* resource = nullptr;
+    HRESULT hr;
+
+    // a packed container next to the dds (written by -packtextures) is used in its place
+    wstring containerName = IsTextureContainerFile(fileName.c_str()) ? fileName : fileName + L"z";
+    if (IsTextureContainerFile(containerName.c_str()) && GetFileAttributesW(containerName.c_str()) != INVALID_FILE_ATTRIBUTES)
+        hr = CreateTextureFromContainer(device, containerName.c_str(), _jobs, &resource, nullptr, maxsize);
+    else
+        hr = CreateDDSTextureFromFile(device, fileName.c_str(), &resource, nullptr, maxsize);
+
+    if (FAILED(hr))
+        return hr;
+
+    hr = resource->QueryInterface(__uuidof(ID3D11Texture2D), (void**)texture);
+    resource->Release();
+
+    return hr;
+}
+
+HRESULT TexturePacker::PackAtlas(Group& group)
+{
+    UINT alignment = IsBlockCompressed(group.format) ? 4 : 1;
+    UINT padding = alignment > 1 ? ATLAS_BLOCK_PADDING : ATLAS_PADDING;
+
+    // tallest first packs noticeably tighter with a skyline
+    vector<UINT> order(group.members.size());
+    for (UINT i = 0; i < order.size(); ++i)
+        order[i] = i;
+
+    sort(order.begin(), order.end(), [&](UINT a, UINT b)
+    {
+        const D3D11_TEXTURE2D_DESC& da = _entries[group.members[a]].desc;
+        const D3D11_TEXTURE2D_DESC& db = _entries[group.members[b]].desc;
+        if (da.Height != db.Height)
+            return da.Height > db.Height;
+        return da.Width > db.Width;
+    });
+
+    group.rects.resize(group.members.size());
+    group.rectSlices.resize(group.members.size());
+    group.pageOccupancy.clear();
+
+    vector<SkylinePacker> pages;
+    for (UINT i : order)
+    {
+        const D3D11_TEXTURE2D_DESC& desc = _entries[group.members[i]].desc;
+
+        bool placed = false;
+        for (UINT page = 0; page < pages.size() && !placed; ++page)
+        {
+            if (pages[page].Insert(desc.Width, desc.Height, &group.rects[i]))
+            {
+                group.rectSlices[i] = page;
+                placed = true;
+            }
+        }
+
+        if (!placed)
+        {
+            pages.push_back(SkylinePacker());
+            pages.back().Init(_atlasPageSize, _atlasPageSize, alignment, padding);
+            if (!pages.back().Insert(desc.Width, desc.Height, &group.rects[i]))
+                return E_FAIL;
+
+            group.rectSlices[i] = (UINT)pages.size() - 1;
+        }
+    }
+
+    for (const SkylinePacker& page : pages)
+        group.pageOccupancy.push_back(page.Occupancy());
+
+    return S_OK;
+}
+
+HRESULT TexturePacker::BuildArray(ID3D11Device* device, ID3D11DeviceContext* context, Group& group)
+{
+    HRESULT hr;
+
+    D3D11_TEXTURE2D_DESC desc;
+    ZeroMemory(&desc, sizeof(desc));
+    desc.Format = group.format;
+    desc.SampleDesc.Count = 1;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+    if (group.atlas)
+    {
+        hr = PackAtlas(group);
+        if (FAILED(hr))
+            return hr;
+
+        // atlas pages only carry the top mip, a mip chain would bleed neighbours together
+        desc.Width = _atlasPageSize;
+        desc.Height = _atlasPageSize;
+        desc.MipLevels = 1;
+        desc.ArraySize = (UINT)group.pageOccupancy.size();
+    }
+    else
+    {
+        desc.Width = group.width;
+        desc.Height = group.height;
+        desc.MipLevels = group.mipLevels;
+        desc.ArraySize = (UINT)group.members.size();
+    }
+
+    hr = device->CreateTexture2D(&desc, nullptr, &group.texture);
+    if (FAILED(hr))
+        return hr;
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+    ZeroMemory(&srvDesc, sizeof(srvDesc));
+    srvDesc.Format = desc.Format;
+    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+    srvDesc.Texture2DArray.MipLevels = desc.MipLevels;
+    srvDesc.Texture2DArray.ArraySize = desc.ArraySize;
+
+    hr = device->CreateShaderResourceView(group.texture, &srvDesc, &group.view);
+    if (FAILED(hr))
+        return hr;
+
+    UINT groupIndex = (UINT)(&group - &_groups[0]);
+
+    for (UINT i = 0; i < group.members.size(); ++i)
+    {
+        Entry& entry = _entries[group.members[i]];
+        MaterialTexture& material = entry.material;
+        material.Group = groupIndex;
+
+        if (group.atlas)
+        {
+            const AtlasRect& rect = group.rects[i];
+            D3D11_BOX box = { 0, 0, 0, rect.width, rect.height, 1 };
+            context->CopySubresourceRegion(group.texture, D3D11CalcSubresource(0, group.rectSlices[i], 1),
+                                           rect.x, rect.y, 0, entry.source, 0, &box);
+
+            float page = (float)_atlasPageSize;
+            material.Slice = group.rectSlices[i];
+            material.UVTransform = XMFLOAT4(rect.width / page, rect.height / page, rect.x / page, rect.y / page);
+        }
+        else
+        {
+            for (UINT mip = 0; mip < group.mipLevels; ++mip)
+            {
+                context->CopySubresourceRegion(group.texture, D3D11CalcSubresource(mip, i, group.mipLevels),
+                                               0, 0, 0, entry.source, mip, nullptr);
+            }
+
+            material.Slice = i;
+            material.UVTransform = XMFLOAT4(1.0f, 1.0f, 0.0f, 0.0f);
+        }
+
+        // the copies are queued on the context which holds its own reference
+        entry.source->Release();
+        entry.source = nullptr;
+    }
+
+    return S_OK;
+}
+
+HRESULT TexturePacker::Build(ID3D11Device* device, ID3D11DeviceContext* context)
+{
+    if (!device || !context)
+        return E_INVALIDARG;
+
+    for (UINT i = 0; i < _entries.size(); ++i)
+    {
+        const D3D11_TEXTURE2D_DESC& desc = _entries[i].desc;
+        if (!_entries[i].source)
+            continue;
+
+        bool atlas = desc.Width <= _atlasThreshold && desc.Height <= _atlasThreshold;
+
+        Group* match = nullptr;
+        for (Group& group : _groups)
+        {
+            if (group.texture || group.atlas != atlas || group.format != desc.Format)
+                continue;
+
+            if (atlas || (group.width == desc.Width && group.height == desc.Height && group.mipLevels == desc.MipLevels))
+            {
+                match = &group;
+                break;
+            }
+        }
+
+        if (!match)
+        {
+            Group group;
+            group.format = desc.Format;
+            group.width = desc.Width;
+            group.height = desc.Height;
+            group.mipLevels = desc.MipLevels;
+            group.fullWidth = desc.Width;
+            group.fullHeight = desc.Height;
+            group.fullMipLevels = desc.MipLevels;
+            group.atlas = atlas;
+            group.texture = nullptr;
+            group.view = nullptr;
+            _groups.push_back(group);
+            match = &_groups.back();
+        }
+
+        match->members.push_back(i);
+    }
+
+    for (Group& group : _groups)
+    {
+        if (group.texture)
+            continue;
+
+        HRESULT hr = BuildArray(device, context, group);
+        if (FAILED(hr))
+            return hr;
+    }
+
+    return S_OK;
+}
+
+HRESULT TexturePacker::ReloadGroup(ID3D11Device* device, ID3D11DeviceContext* context, UINT groupIndex, UINT topMip)
+{
+    if (!device || !context || groupIndex >= _groups.size())
+        return E_INVALIDARG;
+
+    Group& group = _groups[groupIndex];
+    if (group.atlas || topMip >= group.fullMipLevels)
+        return E_INVALIDARG;
+
+    // the loader skips every mip bigger than maxsize
+    size_t maxsize = max(group.fullWidth, group.fullHeight) >> topMip;
+
+    HRESULT hr = S_OK;
+    for (UINT member : group.members)
+    {
+        Entry& entry = _entries[member];
+
+        hr = LoadSource(device, entry.fileName, topMip ? maxsize : 0, &entry.source);
+
+        if (FAILED(hr))
+            break;
+
+        entry.source->GetDesc(&entry.desc);
+    }
+
+    // every slice has to come back at the same size to share the array
+    for (UINT member : group.members)
+    {
+        const Entry& entry = _entries[member];
+        const Entry& first = _entries[group.members[0]];
+        if (SUCCEEDED(hr) && (!entry.source || entry.desc.Width != first.desc.Width ||
+                              entry.desc.Height != first.desc.Height || entry.desc.MipLevels != first.desc.MipLevels))
+        {
+            hr = E_FAIL;
+        }
+    }
+
+    if (FAILED(hr))
+    {
+        for (UINT member : group.members)
+        {
+            if (_entries[member].source) _entries[member].source->Release();
+            _entries[member].source = nullptr;
+        }
+
+        return hr;
+    }
+
+    ID3D11Texture2D* oldTexture = group.texture;
+    ID3D11ShaderResourceView* oldView = group.view;
+    UINT oldWidth = group.width;
+    UINT oldHeight = group.height;
+    UINT oldMipLevels = group.mipLevels;
+
+    const D3D11_TEXTURE2D_DESC& desc = _entries[group.members[0]].desc;
+    group.width = desc.Width;
+    group.height = desc.Height;
+    group.mipLevels = desc.MipLevels;
+    group.texture = nullptr;
+    group.view = nullptr;
+
+    hr = BuildArray(device, context, group);
+    if (FAILED(hr))
+    {
+        if (group.view) group.view->Release();
+        if (group.texture) group.texture->Release();
+        for (UINT member : group.members)
+        {
+            if (_entries[member].source) _entries[member].source->Release();
+            _entries[member].source = nullptr;
+        }
+
+        group.texture = oldTexture;
+        group.view = oldView;
+        group.width = oldWidth;
+        group.height = oldHeight;
+        group.mipLevels = oldMipLevels;
+        return hr;
+    }
+
+    if (oldView) oldView->Release();
+    if (oldTexture) oldTexture->Release();
+
+    return S_OK;
+}
+
+void TexturePacker::GetGroupDesc(UINT groupIndex, D3D11_TEXTURE2D_DESC* desc) const
+{
+    const Group& group = _groups[groupIndex];
+
+    ZeroMemory(desc, sizeof(D3D11_TEXTURE2D_DESC));
+    desc->Format = group.format;
+    desc->SampleDesc.Count = 1;
+    desc->Usage = D3D11_USAGE_DEFAULT;
+    desc->BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+    if (group.atlas)
+    {
+        desc->Width = _atlasPageSize;
+        desc->Height = _atlasPageSize;
+        desc->MipLevels = 1;
+        desc->ArraySize = (UINT)group.pageOccupancy.size();
+    }
+    else
+    {
+        desc->Width = group.fullWidth;
+        desc->Height = group.fullHeight;
+        desc->MipLevels = group.fullMipLevels;
+        desc->ArraySize = (UINT)group.members.size();
+    }
+}
+
+float TexturePacker::GetAtlasOccupancy() const
+{
+    float total = 0.0f;
+    UINT pages = 0;
+    for (const Group& group : _groups)
+    {
+        for (float occupancy : group.pageOccupancy)
+        {
+            total += occupancy;
+            ++pages;
+        }
+    }
+
+    return pages ? total / pages : 0.0f;
+}
+
+void TexturePacker::Release()
+{
+    for (Entry& entry : _entries)
+    {
+        if (entry.source) entry.source->Release();
+        entry.source = nullptr;
+    }
+
+    for (Group& group : _groups)
+    {
+        if (group.view) group.view->Release();
+        if (group.texture) group.texture->Release();
+        group.view = nullptr;
+        group.texture = nullptr;
+    }
+
+    _groups.clear();
+    _entries.clear();
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <windows.h>
+#include <d3d11_1.h>
+#include <directxmath.h>
+#include <vector>
+#include <string>
+
+#include "JobSystem.h"
+#include "SkylinePacker.h"
+
+using namespace DirectX;
+using namespace std;
+
+// what a material needs to find its texels: which array to bind, which slice of it
+// and how to remap the mesh UVs into the packed region
+struct MaterialTexture
+{
+	UINT Group;
+	UINT Slice;
+	//xy = scale, zw = offset
+	XMFLOAT4 UVTransform;
+};
+
+// groups textures so that a pass can bind one SRV for every draw in it:
+// same format/size/mip count textures become slices of a Texture2DArray and
+// textures no bigger than the atlas threshold are packed into atlas pages
+// (each page being one slice of an atlas array)
+class TexturePacker
+{
+public:
+	TexturePacker();
+	~TexturePacker();
+
+	// fails when a texture at the threshold wouldn't fit on a page with its padding
+	HRESULT SetAtlasParameters(UINT pageSize, UINT threshold);
+	// used to decompress .ddsz containers in parallel
+	void SetJobSystem(JobSystem* jobs) { _jobs = jobs; }
+
+	// queue a dds file (or .ddsz container) to be packed, handle is used to look up the material texture after Build
+	HRESULT AddTexture(ID3D11Device* device, const wchar_t* fileName, UINT* handle);
+	HRESULT Build(ID3D11Device* device, ID3D11DeviceContext* context);
+	void Release();
+
+	// reload a texture array group from disk with its first topMip levels skipped,
+	// atlas groups only have the one level and cannot be reduced
+	HRESULT ReloadGroup(ID3D11Device* device, ID3D11DeviceContext* context, UINT group, UINT topMip);
+	// full resolution description of the group's array
+	void GetGroupDesc(UINT group, D3D11_TEXTURE2D_DESC* desc) const;
+
+	const MaterialTexture& GetMaterialTexture(UINT handle) const { return _entries[handle].material; }
+	ID3D11ShaderResourceView* GetGroupView(UINT group) const { return _groups[group].view; }
+	UINT GetGroupCount() const { return (UINT)_groups.size(); }
+
+	// average occupancy of all atlas pages built so far
+	float GetAtlasOccupancy() const;
+
+private:
+	struct Entry
+	{
+		wstring fileName;
+		ID3D11Texture2D* source;
+		D3D11_TEXTURE2D_DESC desc;
+		MaterialTexture material;
+	};
+
+	struct Group
+	{
+		DXGI_FORMAT format;
+		UINT width;
+		UINT height;
+		UINT mipLevels;
+		UINT fullWidth;
+		UINT fullHeight;
+		UINT fullMipLevels;
+		bool atlas;
+		vector<UINT> members;
+		vector<AtlasRect> rects;
+		vector<UINT> rectSlices;
+		vector<float> pageOccupancy;
+		ID3D11Texture2D* texture;
+		ID3D11ShaderResourceView* view;
+	};
+
+	HRESULT BuildArray(ID3D11Device* device, ID3D11DeviceContext* context, Group& group);
+	HRESULT PackAtlas(Group& group);
+	HRESULT LoadSource(ID3D11Device* device, const wstring& fileName, size_t maxsize, ID3D11Texture2D** texture);
+
+	UINT _atlasPageSize;
+	UINT _atlasThreshold;
+	JobSystem* _jobs;
+	vector<Entry> _entries;
+	vector<Group> _groups;
+};
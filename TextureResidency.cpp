@@ -0,0 +1,164 @@
+#include "TextureResidency.h"
+
+#include <algorithm>
+
+// weight given to the latest frame when smoothing screen usage
+static const float USAGE_SMOOTHING = 0.1f;
+
+TextureResidencyManager::TextureResidencyManager()
+{
+    _budget = 256ull * 1024 * 1024;
+    _frame = 0;
+    _restoreHeadroom = 0.1f;
+    _minimumSize = 64;
+    _maxRestoresPerFrame = 1;
+}
+
+void TextureResidencyManager::SetBudget(uint64_t budgetBytes)
+{
+    _budget = budgetBytes;
+}
+
+uint32_t TextureResidencyManager::Register(uint32_t width, uint32_t height, const uint64_t* mipBytes, uint32_t mipLevels)
+{
+    Unit unit;
+    unit.topMip = 0;
+    unit.maxTopMip = 0;
+    unit.lastUsedFrame = _frame;
+    unit.frameUsage = 0.0f;
+    unit.priority = 0.0f;
+    unit.oldTopMip = 0;
+    unit.demoted = false;
+
+    uint32_t w = width;
+    uint32_t h = height;
+    for (uint32_t mip = 0; mip < mipLevels; ++mip)
+    {
+        unit.mipBytes.push_back(mipBytes[mip]);
+
+        // the last level still at least _minimumSize on its longest edge is as far as we
+        // drop. mip sizes round down, so it is the next level's own size that counts
+        w = max(w >> 1, 1u);
+        h = max(h >> 1, 1u);
+        if (mip + 1 < mipLevels && max(w, h) >= _minimumSize)
+            unit.maxTopMip = mip + 1;
+    }
+
+    _units.push_back(unit);
+    return (uint32_t)_units.size() - 1;
+}
+
+void TextureResidencyManager::ReportUsage(uint32_t unit, float screenPixels)
+{
+    _units[unit].frameUsage += screenPixels;
+    _units[unit].lastUsedFrame = _frame;
+}
+
+void TextureResidencyManager::SetTopMip(uint32_t unit, uint32_t topMip)
+{
+    _units[unit].topMip = min(topMip, _units[unit].maxTopMip);
+}
+
+uint64_t TextureResidencyManager::ResidentBytes(const Unit& unit, uint32_t topMip) const
+{
+    uint64_t bytes = 0;
+    for (size_t mip = topMip; mip < unit.mipBytes.size(); ++mip)
+        bytes += unit.mipBytes[mip];
+
+    return bytes;
+}
+
+uint64_t TextureResidencyManager::GetResidentBytes() const
+{
+    uint64_t bytes = 0;
+    for (const Unit& unit : _units)
+        bytes += ResidentBytes(unit, unit.topMip);
+
+    return bytes;
+}
+
+float TextureResidencyManager::Score(const Unit& unit) const
+{
+    // visible textures rank by their smoothed screen area, anything not drawn
+    // recently falls away with age so the least recently used goes first
+    uint64_t age = _frame - unit.lastUsedFrame;
+    return unit.priority / (1.0f + (float)age);
+}
+
+void TextureResidencyManager::EndFrame(FrameArenaVector<ResidencyChange>& changes)
+{
+    changes.clear();
+    changes.reserve(_units.size());
+
+    for (Unit& unit : _units)
+    {
+        unit.priority += (unit.frameUsage - unit.priority) * USAGE_SMOOTHING;
+        unit.frameUsage = 0.0f;
+        unit.oldTopMip = unit.topMip;
+        unit.demoted = false;
+    }
+
+    uint64_t resident = GetResidentBytes();
+
+    // over budget, take a mip off the lowest scoring texture until we fit
+    while (resident > _budget)
+    {
+        size_t victim = _units.size();
+        for (size_t i = 0; i < _units.size(); ++i)
+        {
+            const Unit& unit = _units[i];
+            if (unit.topMip >= unit.maxTopMip)
+                continue;
+
+            if (victim == _units.size() || Score(unit) < Score(_units[victim]) ||
+                (Score(unit) == Score(_units[victim]) && unit.lastUsedFrame < _units[victim].lastUsedFrame))
+            {
+                victim = i;
+            }
+        }
+
+        if (victim == _units.size())
+            break;
+
+        resident -= _units[victim].mipBytes[_units[victim].topMip];
+        _units[victim].topMip++;
+        _units[victim].demoted = true;
+    }
+
+    // enough headroom, hand a mip back to the highest scoring reduced texture
+    uint64_t restoreLimit = (uint64_t)(_budget * (1.0f - _restoreHeadroom));
+    for (uint32_t restores = 0; restores < _maxRestoresPerFrame; ++restores)
+    {
+        size_t best = _units.size();
+        for (size_t i = 0; i < _units.size(); ++i)
+        {
+            const Unit& unit = _units[i];
+            if (unit.topMip == 0 || unit.demoted)
+                continue;
+
+            if (best == _units.size() || Score(unit) > Score(_units[best]))
+                best = i;
+        }
+
+        if (best == _units.size())
+            break;
+
+        uint64_t grow = _units[best].mipBytes[_units[best].topMip - 1];
+        if (resident + grow > restoreLimit)
+            break;
+
+        resident += grow;
+        _units[best].topMip--;
+    }
+
+    for (size_t i = 0; i < _units.size(); ++i)
+    {
+        if (_units[i].topMip != _units[i].oldTopMip)
+        {
+            ResidencyChange change = { (uint32_t)i, _units[i].oldTopMip, _units[i].topMip };
+            changes.push_back(change);
+        }
+    }
+
+    ++_frame;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "FrameArena.h"
+
+using namespace std;
+
+// a texture (or texture array) whose top mip has to move
+struct ResidencyChange
+{
+	uint32_t Unit;
+	uint32_t OldTopMip;
+	uint32_t NewTopMip;
+};
+
+// keeps the textures it tracks under a GPU memory budget by dropping their top mips.
+// textures are ranked by recent on-screen usage, the least recently / least visibly used
+// lose resolution first and the most visible get it back once there is headroom again.
+// only the policy lives here, the caller reloads whatever EndFrame reports as changed,
+// so it runs on sizes alone without a device
+class TextureResidencyManager
+{
+public:
+	TextureResidencyManager();
+
+	void SetBudget(uint64_t budgetBytes);
+	// fraction of the budget that must be free before anything is restored
+	void SetRestoreHeadroom(float headroom) { _restoreHeadroom = headroom; }
+	// textures are never dropped below this many texels on their longest edge
+	void SetMinimumSize(uint32_t size) { _minimumSize = size; }
+	void SetMaxRestoresPerFrame(uint32_t count) { _maxRestoresPerFrame = count; }
+
+	// mipBytes has the size of each of the mipLevels levels, every array slice included
+	uint32_t Register(uint32_t width, uint32_t height, const uint64_t* mipBytes, uint32_t mipLevels);
+
+	// screen area in pixels the unit was drawn with this frame, can be called once per draw
+	void ReportUsage(uint32_t unit, float screenPixels);
+
+	// ages usage, then rebalances against the budget. changes is per frame scratch, it is
+	// cleared and reserved for every unit so the rebalance never grows it
+	void EndFrame(FrameArenaVector<ResidencyChange>& changes);
+
+	// undo a change the caller could not apply
+	void SetTopMip(uint32_t unit, uint32_t topMip);
+
+	uint32_t GetTopMip(uint32_t unit) const { return _units[unit].topMip; }
+	uint64_t GetUnitBytes(uint32_t unit) const { return ResidentBytes(_units[unit], _units[unit].topMip); }
+	uint64_t GetResidentBytes() const;
+	uint64_t GetBudget() const { return _budget; }
+	uint64_t GetFrame() const { return _frame; }
+
+private:
+	struct Unit
+	{
+		// bytes of every mip level across all array slices
+		vector<uint64_t> mipBytes;
+		uint32_t topMip;
+		uint32_t maxTopMip;
+		uint64_t lastUsedFrame;
+		float frameUsage;
+		float priority;
+		// EndFrame's bookkeeping, kept here so a rebalance doesn't allocate
+		uint32_t oldTopMip;
+		bool demoted;
+	};
+
+	uint64_t ResidentBytes(const Unit& unit, uint32_t topMip) const;
+	float Score(const Unit& unit) const;
+
+	vector<Unit> _units;
+	uint64_t _budget;
+	uint64_t _frame;
+	float _restoreHeadroom;
+	uint32_t _minimumSize;
+	uint32_t _maxRestoresPerFrame;
+};
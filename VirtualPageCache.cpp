@@ -0,0 +1,227 @@
+#include "VirtualPageCache.h"
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------
+// VirtualPageCache
+//--------------------------------------------------------------------------------------
+void VirtualPageCache::Init(uint32_t slotCount)
+{
+    _slots.resize(slotCount);
+
+    _indexBits = 4;
+    while ((1u << _indexBits) < slotCount * 2)
+        ++_indexBits;
+
+    PageSlot empty = { VT_INVALID_PAGE, 0 };
+    _pageToSlot.assign((size_t)1 << _indexBits, empty);
+
+    for (uint32_t i = 0; i < slotCount; ++i)
+    {
+        _slots[i].page = VT_INVALID_PAGE;
+        _slots[i].lastUsed = 0;
+        _slots[i].pinned = false;
+        _slots[i].prev = i - 1;
+        _slots[i].next = i + 1;
+    }
+
+    _head = slotCount ? 0 : VT_INVALID_PAGE;
+    _tail = slotCount ? slotCount - 1 : VT_INVALID_PAGE;
+    if (slotCount)
+    {
+        _slots[0].prev = VT_INVALID_PAGE;
+        _slots[slotCount - 1].next = VT_INVALID_PAGE;
+    }
+}
+
+void VirtualPageCache::Unlink(uint32_t slot)
+{
+    Slot& s = _slots[slot];
+    if (s.prev != VT_INVALID_PAGE) _slots[s.prev].next = s.next; else _head = s.next;
+    if (s.next != VT_INVALID_PAGE) _slots[s.next].prev = s.prev; else _tail = s.prev;
+    s.prev = VT_INVALID_PAGE;
+    s.next = VT_INVALID_PAGE;
+}
+
+void VirtualPageCache::PushFront(uint32_t slot)
+{
+    Slot& s = _slots[slot];
+    s.prev = VT_INVALID_PAGE;
+    s.next = _head;
+    if (_head != VT_INVALID_PAGE) _slots[_head].prev = slot;
+    _head = slot;
+    if (_tail == VT_INVALID_PAGE) _tail = slot;
+}
+
+uint32_t VirtualPageCache::FindIndex(uint32_t pageId) const
+{
+    uint32_t mask = (uint32_t)_pageToSlot.size() - 1;
+    uint32_t index = HashPage(pageId, _indexBits);
+    while (_pageToSlot[index].page != pageId && _pageToSlot[index].page != VT_INVALID_PAGE)
+        index = (index + 1) & mask;
+
+    return index;
+}
+
+void VirtualPageCache::EraseIndex(uint32_t pageId)
+{
+    uint32_t hole = FindIndex(pageId);
+    if (_pageToSlot[hole].page == VT_INVALID_PAGE)
+        return;
+
+    // shift later entries of the run back into the hole when it is on their probe path,
+    // so lookups never need tombstones
+    uint32_t mask = (uint32_t)_pageToSlot.size() - 1;
+    uint32_t next = hole;
+    for (;;)
+    {
+        next = (next + 1) & mask;
+        if (_pageToSlot[next].page == VT_INVALID_PAGE)
+            break;
+
+        uint32_t home = HashPage(_pageToSlot[next].page, _indexBits);
+        if (((next - home) & mask) >= ((next - hole) & mask))
+        {
+            _pageToSlot[hole] = _pageToSlot[next];
+            hole = next;
+        }
+    }
+
+    _pageToSlot[hole].page = VT_INVALID_PAGE;
+}
+
+bool VirtualPageCache::Lookup(uint32_t pageId, uint32_t* slot) const
+{
+    if (_pageToSlot.empty())
+        return false;
+
+    uint32_t index = FindIndex(pageId);
+    if (_pageToSlot[index].page == VT_INVALID_PAGE)
+        return false;
+
+    *slot = _pageToSlot[index].slot;
+    return true;
+}
+
+void VirtualPageCache::Touch(uint32_t slot, uint64_t frame)
+{
+    _slots[slot].lastUsed = frame;
+    if (_head != slot)
+    {
+        Unlink(slot);
+        PushFront(slot);
+    }
+}
+
+void VirtualPageCache::Pin(uint32_t slot)
+{
+    _slots[slot].pinned = true;
+}
+
+bool VirtualPageCache::Allocate(uint32_t pageId, uint64_t frame, uint32_t* slot, uint32_t* evicted)
+{
+    *evicted = VT_INVALID_PAGE;
+
+    // walk up from the least recently used end, anything used this frame is still on screen
+    uint32_t victim = _tail;
+    while (victim != VT_INVALID_PAGE)
+    {
+        const Slot& s = _slots[victim];
+        if (s.page == VT_INVALID_PAGE || (!s.pinned && s.lastUsed != frame))
+            break;
+
+        victim = s.prev;
+    }
+
+    if (victim == VT_INVALID_PAGE)
+        return false;
+
+    Slot& s = _slots[victim];
+    if (s.page != VT_INVALID_PAGE)
+    {
+        EraseIndex(s.page);
+        *evicted = s.page;
+    }
+
+    s.page = pageId;
+    uint32_t index = FindIndex(pageId);
+    _pageToSlot[index].page = pageId;
+    _pageToSlot[index].slot = victim;
+    Touch(victim, frame);
+
+    *slot = victim;
+    return true;
+}
+
+//--------------------------------------------------------------------------------------
+// PageRequestScheduler
+//--------------------------------------------------------------------------------------
+PageRequestScheduler::PageRequestScheduler()
+{
+    _tableBits = 0;
+}
+
+void PageRequestScheduler::BeginFrame()
+{
+    for (uint32_t index : _used)
+        _table[index].page = VT_INVALID_PAGE;
+
+    _used.clear();
+}
+
+void PageRequestScheduler::Grow()
+{
+    vector<PageCount> counts;
+    for (uint32_t index : _used)
+        counts.push_back(_table[index]);
+
+    _tableBits = max(_tableBits + 1, 8u);
+    PageCount empty = { VT_INVALID_PAGE, 0 };
+    _table.assign((size_t)1 << _tableBits, empty);
+    _used.clear();
+
+    for (const PageCount& count : counts)
+    {
+        Request(count.page);
+        _table[_used.back()].count = count.count;
+    }
+}
+
+void PageRequestScheduler::Request(uint32_t pageId)
+{
+    if ((_used.size() + 1) * 2 > _table.size())
+        Grow();
+
+    uint32_t mask = (uint32_t)_table.size() - 1;
+    uint32_t index = HashPage(pageId, _tableBits);
+    while (_table[index].page != pageId && _table[index].page != VT_INVALID_PAGE)
+        index = (index + 1) & mask;
+
+    if (_table[index].page == VT_INVALID_PAGE)
+    {
+        _table[index].page = pageId;
+        _table[index].count = 0;
+        _used.push_back(index);
+    }
+
+    _table[index].count++;
+}
+
+void PageRequestScheduler::Resolve(vector<uint32_t>& pages)
+{
+    _sorted.clear();
+    for (uint32_t index : _used)
+        _sorted.push_back(_table[index]);
+
+    sort(_sorted.begin(), _sorted.end(), [](const PageCount& a, const PageCount& b)
+    {
+        if (PageMip(a.page) != PageMip(b.page))
+            return PageMip(a.page) > PageMip(b.page);
+        if (a.count != b.count)
+            return a.count > b.count;
+        return a.page < b.page;
+    });
+
+    pages.clear();
+    for (const PageCount& request : _sorted)
+        pages.push_back(request.page);
+}
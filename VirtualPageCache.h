@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+// page ids pack the mip and page coordinates of a virtual texture page, the top bit
+// marks a valid id so the cleared feedback target (0) reads back as "no request"
+static const uint32_t VT_PAGE_VALID = 0x80000000;
+static const uint32_t VT_INVALID_PAGE = 0xFFFFFFFF;
+
+inline uint32_t MakePageId(uint32_t mip, uint32_t x, uint32_t y) { return VT_PAGE_VALID | (mip << 24) | (y << 12) | x; }
+inline uint32_t PageMip(uint32_t pageId) { return (pageId >> 24) & 0x7F; }
+inline uint32_t PageX(uint32_t pageId) { return pageId & 0xFFF; }
+inline uint32_t PageY(uint32_t pageId) { return (pageId >> 12) & 0xFFF; }
+
+// fibonacci hashing for the page id tables, the top bits of the product are the well mixed ones
+inline uint32_t HashPage(uint32_t pageId, uint32_t bits) { return (pageId * 2654435769u) >> (32 - bits); }
+
+// fixed number of physical page slots, least recently used page is evicted first
+class VirtualPageCache
+{
+public:
+	void Init(uint32_t slotCount);
+
+	bool Lookup(uint32_t pageId, uint32_t* slot) const;
+	void Touch(uint32_t slot, uint64_t frame);
+	void Pin(uint32_t slot);
+
+	// finds a slot for pageId, evicting the least recently used unpinned page that was
+	// not touched this frame. evicted receives the page thrown out (or VT_INVALID_PAGE)
+	bool Allocate(uint32_t pageId, uint64_t frame, uint32_t* slot, uint32_t* evicted);
+
+	uint32_t GetSlotPage(uint32_t slot) const { return _slots[slot].page; }
+	uint32_t GetSlotCount() const { return (uint32_t)_slots.size(); }
+
+private:
+	struct Slot
+	{
+		uint32_t page;
+		uint64_t lastUsed;
+		bool pinned;
+		uint32_t prev;
+		uint32_t next;
+	};
+
+	struct PageSlot
+	{
+		uint32_t page;
+		uint32_t slot;
+	};
+
+	void Unlink(uint32_t slot);
+	void PushFront(uint32_t slot);
+	// entry holding pageId, or the free entry it would go in
+	uint32_t FindIndex(uint32_t pageId) const;
+	void EraseIndex(uint32_t pageId);
+
+	// doubly linked list through the slots, head is most recently used
+	vector<Slot> _slots;
+	uint32_t _head;
+	uint32_t _tail;
+	// page to slot, open addressed with at least twice as many entries as there are
+	// slots so streaming a page in never allocates. VT_INVALID_PAGE marks a free entry
+	vector<PageSlot> _pageToSlot;
+	uint32_t _indexBits;
+};
+
+// turns the raw feedback readback into an ordered list of pages to stream in. counts go
+// into an open addressed table that keeps its size from frame to frame, so once it has
+// grown to the usual number of distinct pages a frame's requests never allocate
+class PageRequestScheduler
+{
+public:
+	PageRequestScheduler();
+
+	void BeginFrame();
+	void Request(uint32_t pageId);
+
+	// coarse mips go first so a fallback is always close, then the most requested pages
+	void Resolve(vector<uint32_t>& pages);
+
+private:
+	struct PageCount
+	{
+		uint32_t page;
+		uint32_t count;
+	};
+
+	void Grow();
+
+	// power of two size, kept under half full. VT_INVALID_PAGE marks a free entry
+	vector<PageCount> _table;
+	uint32_t _tableBits;
+	// entries used this frame, all that BeginFrame has to clear
+	vector<uint32_t> _used;
+	vector<PageCount> _sorted;
+};
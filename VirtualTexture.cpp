@@ -0,0 +1,468 @@
+#include "VirtualTexture.h"
+#include "DDSTextureLoader.h"
+#include "CpuProfiler.h"
+#include <algorithm>
+#include <math.h>
+
+using namespace DirectX;
+
+// texels of neighbouring pages copied around each page so bilinear filtering doesn't seam
+static const UINT PAGE_BORDER = 1;
+
+//--------------------------------------------------------------------------------------
+// VirtualTexture
+//--------------------------------------------------------------------------------------
+VirtualTexture::VirtualTexture()
+{
+    ZeroMemory(&_desc, sizeof(_desc));
+    ZeroMemory(&_params, sizeof(_params));
+    ZeroMemory(&_savedViewport, sizeof(_savedViewport));
+    _bytesPerTexel = 0;
+    _ddsBytes = 0;
+    _pageSize = 0;
+    _slotSize = 0;
+    _slotsPerSide = 0;
+    _maxUploadsPerFrame = 8;
+    _frame = 0;
+    _pageTableDirty = false;
+    _pageCache = nullptr;
+    _pageCacheView = nullptr;
+    _pageTable = nullptr;
+    _pageTableView = nullptr;
+    _paramsBuffer = nullptr;
+    _feedbackWidth = 0;
+    _feedbackHeight = 0;
+    _feedbackTarget = nullptr;
+    _feedbackView = nullptr;
+    _feedbackDepth = nullptr;
+    _feedbackDepthView = nullptr;
+    for (UINT i = 0; i < FEEDBACK_LATENCY; ++i)
+        _feedbackReadback[i] = nullptr;
+    _feedbackFrames = 0;
+    for (UINT i = 0; i < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT; ++i)
+        _savedTargets[i] = nullptr;
+    _savedDepth = nullptr;
+}
+
+VirtualTexture::~VirtualTexture()
+{
+    Release();
+}
+
+HRESULT VirtualTexture::Initialise(ID3D11Device* device, const wchar_t* fileName, UINT pageSize, UINT cacheSlotsPerSide,
+                                   UINT feedbackWidth, UINT feedbackHeight, float feedbackScale)
+{
+    HRESULT hr = LoadDDSTextureDataFromFile(fileName, _ddsData, &_desc, _mips);
+    if (FAILED(hr))
+        return hr;
+
+    // the whole mip chain stays in memory for pages to be cut from
+    for (const D3D11_SUBRESOURCE_DATA& mip : _mips)
+        _ddsBytes += mip.SysMemSlicePitch;
+    MemoryTracker::TrackExternal(MEMORY_TAG_TEXTURE, _ddsBytes);
+
+    // pages are cut on texel boundaries, block compressed data would need 4x4 aligned borders
+    size_t texelBytes = GetSurfaceByteSize(1, 1, _desc.Format);
+    if (GetSurfaceByteSize(4, 4, _desc.Format) != texelBytes * 16 ||
+        _desc.Width % pageSize || _desc.Height % pageSize)
+    {
+        return E_INVALIDARG;
+    }
+
+    _bytesPerTexel = (UINT)texelBytes;
+    _pageSize = pageSize;
+    _slotSize = pageSize + PAGE_BORDER * 2;
+    _slotsPerSide = cacheSlotsPerSide;
+    _feedbackWidth = feedbackWidth;
+    _feedbackHeight = feedbackHeight;
+
+    // mips smaller than a page are left out, the coarsest virtual mip is kept resident instead
+    UINT mipCount = 0;
+    while (mipCount < _desc.MipLevels && (_desc.Width >> mipCount) >= pageSize && (_desc.Height >> mipCount) >= pageSize)
+        ++mipCount;
+
+    UINT pagesWide = _desc.Width / pageSize;
+    UINT pagesHigh = _desc.Height / pageSize;
+
+    _params.VirtualWidth = (float)_desc.Width;
+    _params.VirtualHeight = (float)_desc.Height;
+    _params.PageSize = (float)pageSize;
+    _params.MipCount = (float)mipCount;
+    _params.PagesWide = (float)pagesWide;
+    _params.PagesHigh = (float)pagesHigh;
+    _params.CacheWidth = (float)(_slotsPerSide * _slotSize);
+    _params.CacheHeight = (float)(_slotsPerSide * _slotSize);
+    _params.SlotSize = (float)_slotSize;
+    _params.PageBorder = (float)PAGE_BORDER;
+    // the feedback target is smaller than the screen so its derivatives are larger
+    _params.FeedbackBias = log2f(feedbackScale);
+
+    _residentSlots.resize(mipCount);
+    for (UINT mip = 0; mip < mipCount; ++mip)
+        _residentSlots[mip].assign(max(pagesWide >> mip, 1u) * max(pagesHigh >> mip, 1u), VT_INVALID_PAGE);
+
+    UINT coarsestPages = (UINT)_residentSlots[mipCount - 1].size();
+    if (_slotsPerSide * _slotsPerSide <= coarsestPages)
+        return E_INVALIDARG;
+
+    _cache.Init(_slotsPerSide * _slotsPerSide);
+    _pageScratch.resize(_slotSize * _slotSize * _bytesPerTexel);
+
+    D3D11_TEXTURE2D_DESC desc;
+    ZeroMemory(&desc, sizeof(desc));
+    desc.Width = _slotsPerSide * _slotSize;
+    desc.Height = _slotsPerSide * _slotSize;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = _desc.Format;
+    desc.SampleDesc.Count = 1;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    hr = device->CreateTexture2D(&desc, nullptr, &_pageCache);
+    if (FAILED(hr))
+        return hr;
+
+    hr = device->CreateShaderResourceView(_pageCache, nullptr, &_pageCacheView);
+    if (FAILED(hr))
+        return hr;
+
+    desc.Width = pagesWide;
+    desc.Height = pagesHigh;
+    desc.MipLevels = mipCount;
+    desc.Format = DXGI_FORMAT_R8G8B8A8_UINT;
+    hr = device->CreateTexture2D(&desc, nullptr, &_pageTable);
+    if (FAILED(hr))
+        return hr;
+
+    hr = device->CreateShaderResourceView(_pageTable, nullptr, &_pageTableView);
+    if (FAILED(hr))
+        return hr;
+
+    desc.Width = feedbackWidth;
+    desc.Height = feedbackHeight;
+    desc.MipLevels = 1;
+    desc.Format = DXGI_FORMAT_R32_UINT;
+    desc.BindFlags = D3D11_BIND_RENDER_TARGET;
+    hr = device->CreateTexture2D(&desc, nullptr, &_feedbackTarget);
+    if (FAILED(hr))
+        return hr;
+
+    hr = device->CreateRenderTargetView(_feedbackTarget, nullptr, &_feedbackView);
+    if (FAILED(hr))
+        return hr;
+
+    desc.Usage = D3D11_USAGE_STAGING;
+    desc.BindFlags = 0;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    for (UINT i = 0; i < FEEDBACK_LATENCY; ++i)
+    {
+        hr = device->CreateTexture2D(&desc, nullptr, &_feedbackReadback[i]);
+        if (FAILED(hr))
+            return hr;
+    }
+
+    desc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
+    desc.CPUAccessFlags = 0;
+    hr = device->CreateTexture2D(&desc, nullptr, &_feedbackDepth);
+    if (FAILED(hr))
+        return hr;
+
+    hr = device->CreateDepthStencilView(_feedbackDepth, nullptr, &_feedbackDepthView);
+    if (FAILED(hr))
+        return hr;
+
+    D3D11_BUFFER_DESC bd;
+    ZeroMemory(&bd, sizeof(bd));
+    bd.Usage = D3D11_USAGE_DEFAULT;
+    bd.ByteWidth = sizeof(VirtualTextureParams);
+    bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+
+    D3D11_SUBRESOURCE_DATA InitData;
+    ZeroMemory(&InitData, sizeof(InitData));
+    InitData.pSysMem = &_params;
+
+    hr = device->CreateBuffer(&bd, &InitData, &_paramsBuffer);
+    if (FAILED(hr))
+        return hr;
+
+    // the coarsest mip stays resident so every lookup has something to fall back to
+    ID3D11DeviceContext* context = nullptr;
+    device->GetImmediateContext(&context);
+
+    UINT coarsestMip = mipCount - 1;
+    UINT coarsestWide = max(pagesWide >> coarsestMip, 1u);
+    for (UINT i = 0; i < coarsestPages; ++i)
+    {
+        UINT pageId = MakePageId(coarsestMip, i % coarsestWide, i / coarsestWide);
+        UINT slot;
+        UINT evicted;
+        _cache.Allocate(pageId, _frame, &slot, &evicted);
+        _cache.Pin(slot);
+        UploadPage(context, pageId, slot);
+        _residentSlots[coarsestMip][i] = slot;
+    }
+
+    RebuildPageTable(context);
+    context->Release();
+
+    return S_OK;
+}
+
+void VirtualTexture::Release()
+{
+    if (_pageCacheView) _pageCacheView->Release();
+    if (_pageCache) _pageCache->Release();
+    if (_pageTableView) _pageTableView->Release();
+    if (_pageTable) _pageTable->Release();
+    if (_paramsBuffer) _paramsBuffer->Release();
+    if (_feedbackView) _feedbackView->Release();
+    if (_feedbackTarget) _feedbackTarget->Release();
+    if (_feedbackDepthView) _feedbackDepthView->Release();
+    if (_feedbackDepth) _feedbackDepth->Release();
+    for (UINT i = 0; i < FEEDBACK_LATENCY; ++i)
+    {
+        if (_feedbackReadback[i]) _feedbackReadback[i]->Release();
+        _feedbackReadback[i] = nullptr;
+    }
+
+    _pageCacheView = nullptr;
+    _pageCache = nullptr;
+    _pageTableView = nullptr;
+    _pageTable = nullptr;
+    _paramsBuffer = nullptr;
+    _feedbackView = nullptr;
+    _feedbackTarget = nullptr;
+    _feedbackDepthView = nullptr;
+    _feedbackDepth = nullptr;
+
+    if (_ddsData)
+        MemoryTracker::ReleaseExternal(MEMORY_TAG_TEXTURE, _ddsBytes);
+    _ddsData.reset();
+    _ddsBytes = 0;
+    _mips.clear();
+}
+
+void VirtualTexture::UploadPage(ID3D11DeviceContext* context, UINT pageId, UINT slot)
+{
+    UINT mip = PageMip(pageId);
+    const D3D11_SUBRESOURCE_DATA& source = _mips[mip];
+    int mipWidth = (int)max(_desc.Width >> mip, 1u);
+    int mipHeight = (int)max(_desc.Height >> mip, 1u);
+
+    int originX = (int)(PageX(pageId) * _pageSize) - (int)PAGE_BORDER;
+    int originY = (int)(PageY(pageId) * _pageSize) - (int)PAGE_BORDER;
+    UINT rowBytes = _slotSize * _bytesPerTexel;
+
+    // copy the page plus its border, clamping at the edges of the mip
+    for (UINT row = 0; row < _slotSize; ++row)
+    {
+        int y = min(max(originY + (int)row, 0), mipHeight - 1);
+        const uint8_t* srcRow = (const uint8_t*)source.pSysMem + y * source.SysMemPitch;
+        uint8_t* dstRow = &_pageScratch[row * rowBytes];
+
+        for (UINT column = 0; column < _slotSize; ++column)
+        {
+            int x = min(max(originX + (int)column, 0), mipWidth - 1);
+            memcpy(dstRow + column * _bytesPerTexel, srcRow + x * _bytesPerTexel, _bytesPerTexel);
+        }
+    }
+
+    UINT left = (slot % _slotsPerSide) * _slotSize;
+    UINT top = (slot / _slotsPerSide) * _slotSize;
+    D3D11_BOX box = { left, top, 0, left + _slotSize, top + _slotSize, 1 };
+    context->UpdateSubresource(_pageCache, 0, &box, _pageScratch.data(), rowBytes, 0);
+}
+
+UINT VirtualTexture::TranslatePage(UINT pageId) const
+{
+    UINT mip = PageMip(pageId);
+    UINT x = PageX(pageId);
+    UINT y = PageY(pageId);
+    UINT pagesWide = (UINT)_params.PagesWide;
+
+    for (; mip < _residentSlots.size(); ++mip, x >>= 1, y >>= 1)
+    {
+        UINT wide = max(pagesWide >> mip, 1u);
+        if (_residentSlots[mip][y * wide + x] != VT_INVALID_PAGE)
+            return MakePageId(mip, x, y);
+    }
+
+    return VT_INVALID_PAGE;
+}
+
+void VirtualTexture::RebuildPageTable(ID3D11DeviceContext* context)
+{
+    UINT pagesWide = (UINT)_params.PagesWide;
+    UINT pagesHigh = (UINT)_params.PagesHigh;
+    UINT mipCount = (UINT)_residentSlots.size();
+
+    // coarse to fine so a missing page can copy its parent's (already resolved) entry
+    vector<UINT>& parent = _parentEntries;
+    vector<UINT>& entries = _tableEntries;
+    for (UINT mip = mipCount; mip-- > 0; )
+    {
+        UINT wide = max(pagesWide >> mip, 1u);
+        UINT high = max(pagesHigh >> mip, 1u);
+        UINT parentWide = max(pagesWide >> (mip + 1), 1u);
+
+        entries.resize(wide * high);
+        for (UINT y = 0; y < high; ++y)
+        {
+            for (UINT x = 0; x < wide; ++x)
+            {
+                UINT slot = _residentSlots[mip][y * wide + x];
+                if (slot != VT_INVALID_PAGE)
+                {
+                    // R8G8B8A8_UINT: slot x, slot y, resident mip
+                    entries[y * wide + x] = (slot % _slotsPerSide) | ((slot / _slotsPerSide) << 8) | (mip << 16) | 0xFF000000;
+                }
+                else
+                {
+                    entries[y * wide + x] = parent[(y >> 1) * parentWide + (x >> 1)];
+                }
+            }
+        }
+
+        context->UpdateSubresource(_pageTable, D3D11CalcSubresource(mip, 0, mipCount), nullptr,
+                                   entries.data(), wide * sizeof(UINT), 0);
+        parent.swap(entries);
+    }
+
+    _pageTableDirty = false;
+}
+
+void VirtualTexture::BeginFeedback(ID3D11DeviceContext* context)
+{
+    context->OMGetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, _savedTargets, &_savedDepth);
+    UINT viewports = 1;
+    context->RSGetViewports(&viewports, &_savedViewport);
+
+    float clear[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    context->ClearRenderTargetView(_feedbackView, clear);
+    context->ClearDepthStencilView(_feedbackDepthView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+    context->OMSetRenderTargets(1, &_feedbackView, _feedbackDepthView);
+
+    D3D11_VIEWPORT vp;
+    vp.Width = (FLOAT)_feedbackWidth;
+    vp.Height = (FLOAT)_feedbackHeight;
+    vp.MinDepth = 0.0f;
+    vp.MaxDepth = 1.0f;
+    vp.TopLeftX = 0;
+    vp.TopLeftY = 0;
+    context->RSSetViewports(1, &vp);
+
+    context->VSSetConstantBuffers(1, 1, &_paramsBuffer);
+    context->PSSetConstantBuffers(1, 1, &_paramsBuffer);
+}
+
+void VirtualTexture::EndFeedback(ID3D11DeviceContext* context)
+{
+    context->CopyResource(_feedbackReadback[_feedbackFrames % FEEDBACK_LATENCY], _feedbackTarget);
+    ++_feedbackFrames;
+
+    context->OMSetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, _savedTargets, _savedDepth);
+    context->RSSetViewports(1, &_savedViewport);
+
+    for (UINT i = 0; i < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT; ++i)
+    {
+        if (_savedTargets[i]) _savedTargets[i]->Release();
+        _savedTargets[i] = nullptr;
+    }
+    if (_savedDepth) _savedDepth->Release();
+    _savedDepth = nullptr;
+}
+
+void VirtualTexture::ReadFeedback(const UINT* texels, UINT rowPitch)
+{
+    UINT mipCount = (UINT)_residentSlots.size();
+    for (UINT y = 0; y < _feedbackHeight; ++y)
+    {
+        const UINT* row = (const UINT*)((const uint8_t*)texels + y * rowPitch);
+        for (UINT x = 0; x < _feedbackWidth; ++x)
+        {
+            UINT pageId = row[x];
+            if (!(pageId & VT_PAGE_VALID) || PageMip(pageId) >= mipCount)
+                continue;
+
+            UINT mip = PageMip(pageId);
+            if (PageX(pageId) >= max((UINT)_params.PagesWide >> mip, 1u) ||
+                PageY(pageId) >= max((UINT)_params.PagesHigh >> mip, 1u))
+                continue;
+
+            _scheduler.Request(pageId);
+        }
+    }
+}
+
+void VirtualTexture::Update(ID3D11DeviceContext* context)
+{
+    CPU_PROFILE_FUNCTION();
+
+    _scheduler.BeginFrame();
+
+    // only read a copy old enough that mapping it won't stall on the GPU
+    if (_feedbackFrames >= FEEDBACK_LATENCY)
+    {
+        ID3D11Texture2D* readback = _feedbackReadback[_feedbackFrames % FEEDBACK_LATENCY];
+        D3D11_MAPPED_SUBRESOURCE mapped;
+        if (SUCCEEDED(context->Map(readback, 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped)))
+        {
+            ReadFeedback((const UINT*)mapped.pData, mapped.RowPitch);
+            context->Unmap(readback, 0);
+        }
+    }
+
+    _scheduler.Resolve(_requests);
+
+    // keep everything still in view from being evicted before streaming anything new
+    _missing.clear();
+    for (UINT pageId : _requests)
+    {
+        UINT slot;
+        if (_cache.Lookup(pageId, &slot))
+            _cache.Touch(slot, _frame);
+        else
+            _missing.push_back(pageId);
+    }
+
+    UINT pagesWide = (UINT)_params.PagesWide;
+    UINT uploads = 0;
+    for (UINT pageId : _missing)
+    {
+        if (uploads >= _maxUploadsPerFrame)
+            break;
+
+        UINT slot;
+        UINT evicted;
+        if (!_cache.Allocate(pageId, _frame, &slot, &evicted))
+            break;
+
+        if (evicted != VT_INVALID_PAGE)
+        {
+            UINT evictedWide = max(pagesWide >> PageMip(evicted), 1u);
+            _residentSlots[PageMip(evicted)][PageY(evicted) * evictedWide + PageX(evicted)] = VT_INVALID_PAGE;
+        }
+
+        UploadPage(context, pageId, slot);
+
+        UINT wide = max(pagesWide >> PageMip(pageId), 1u);
+        _residentSlots[PageMip(pageId)][PageY(pageId) * wide + PageX(pageId)] = slot;
+        _pageTableDirty = true;
+        ++uploads;
+    }
+
+    if (_pageTableDirty)
+        RebuildPageTable(context);
+
+    ++_frame;
+}
+
+void VirtualTexture::Bind(ID3D11DeviceContext* context)
+{
+    ID3D11ShaderResourceView* views[2] = { _pageTableView, _pageCacheView };
+    context->PSSetShaderResources(1, 2, views);
+    context->VSSetConstantBuffers(1, 1, &_paramsBuffer);
+    context->PSSetConstantBuffers(1, 1, &_paramsBuffer);
+}
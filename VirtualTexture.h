@@ -0,0 +1,114 @@
+#pragma once
+
+#include <windows.h>
+#include <d3d11_1.h>
+#include <memory>
+#include <vector>
+
+#include "MemoryTracker.h"
+#include "VirtualPageCache.h"
+
+using namespace std;
+
+// mirrors cbuffer VirtualTextureParams in DX11 Framework.fx
+struct VirtualTextureParams
+{
+	float VirtualWidth;
+	float VirtualHeight;
+	float PageSize;
+	float MipCount;
+
+	float PagesWide;
+	float PagesHigh;
+	float CacheWidth;
+	float CacheHeight;
+
+	float SlotSize;
+	float PageBorder;
+	float FeedbackBias;
+	float Padding;
+};
+
+// virtual texture backed by a DDS file kept in system memory. only the pages the
+// feedback pass asks for are copied into a fixed size physical cache texture, and a
+// page table texture (one mip per virtual mip) tells the shader where each page lives
+class VirtualTexture
+{
+public:
+	VirtualTexture();
+	~VirtualTexture();
+
+	HRESULT Initialise(ID3D11Device* device, const wchar_t* fileName, UINT pageSize, UINT cacheSlotsPerSide,
+	                   UINT feedbackWidth, UINT feedbackHeight, float feedbackScale);
+	void Release();
+
+	// feedback pass, draw the virtually textured meshes with the feedback pixel shader in between
+	void BeginFeedback(ID3D11DeviceContext* context);
+	void EndFeedback(ID3D11DeviceContext* context);
+
+	// reads back an older feedback frame, streams requested pages and refreshes the page table
+	void Update(ID3D11DeviceContext* context);
+
+	// page table on t1, page cache on t2, parameters on b1
+	void Bind(ID3D11DeviceContext* context);
+
+	void SetMaxUploadsPerFrame(UINT count) { _maxUploadsPerFrame = count; }
+	const VirtualTextureParams& GetParams() const { return _params; }
+
+	// where the shader should read pageId from, falls back to the nearest resident parent
+	UINT TranslatePage(UINT pageId) const;
+
+private:
+	static const UINT FEEDBACK_LATENCY = 3;
+
+	void UploadPage(ID3D11DeviceContext* context, UINT pageId, UINT slot);
+	void RebuildPageTable(ID3D11DeviceContext* context);
+	void ReadFeedback(const UINT* texels, UINT rowPitch);
+
+	unique_ptr<uint8_t[]> _ddsData;
+	// charged to the texture tag while _ddsData holds it
+	size_t _ddsBytes;
+	D3D11_TEXTURE2D_DESC _desc;
+	vector<D3D11_SUBRESOURCE_DATA> _mips;
+	UINT _bytesPerTexel;
+
+	UINT _pageSize;
+	UINT _slotSize;
+	UINT _slotsPerSide;
+	UINT _maxUploadsPerFrame;
+	UINT64 _frame;
+
+	VirtualTextureParams _params;
+	VirtualPageCache _cache;
+	PageRequestScheduler _scheduler;
+	// slot per page of each mip, VT_INVALID_PAGE when not resident
+	vector<vector<UINT>> _residentSlots;
+	TextureVector<uint8_t> _pageScratch;
+	// per frame lists kept as members so they stop allocating once grown
+	vector<UINT> _requests;
+	vector<UINT> _missing;
+	vector<UINT> _tableEntries;
+	vector<UINT> _parentEntries;
+	bool _pageTableDirty;
+
+	ID3D11Texture2D* _pageCache;
+	ID3D11ShaderResourceView* _pageCacheView;
+	ID3D11Texture2D* _pageTable;
+	ID3D11ShaderResourceView* _pageTableView;
+	ID3D11Buffer* _paramsBuffer;
+
+	UINT _feedbackWidth;
+	UINT _feedbackHeight;
+	ID3D11Texture2D* _feedbackTarget;
+	ID3D11RenderTargetView* _feedbackView;
+	ID3D11Texture2D* _feedbackDepth;
+	ID3D11DepthStencilView* _feedbackDepthView;
+	ID3D11Texture2D* _feedbackReadback[FEEDBACK_LATENCY];
+	UINT64 _feedbackFrames;
+
+	// render state saved across the feedback pass
+	// every slot so a G-buffer pass gets all of its targets back
+	ID3D11RenderTargetView* _savedTargets[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT];
+	ID3D11DepthStencilView* _savedDepth;
+	D3D11_VIEWPORT _savedViewport;
+};